@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include "cookie.h"
+#include "notification_queue.h"
 #include "settings.h"
 
 #include <cJSON.h>
@@ -230,6 +231,26 @@ public:
         Connection::next = next;
     }
 
+    /**
+     * The status of the last engine operation notified complete (see
+     * notify_io_complete()) which the worker thread hasn't picked up yet.
+     */
+    ENGINE_ERROR_CODE getNotifiedAiostat() const {
+        return notified_aiostat.load();
+    }
+
+    void setNotifiedAiostat(ENGINE_ERROR_CODE status) {
+        notified_aiostat.store(status);
+    }
+
+    /** @return true if the connection is on its thread's notification queue */
+    bool isNotificationQueued() const {
+        return notification_hook.queued.load();
+    }
+
+    /** Link for the owning thread's ConnectionNotificationQueue */
+    NotificationQueueHook<Connection> notification_hook;
+
     LIBEVENT_THREAD* getThread() const {
         return thread.load(std::memory_order_relaxed);
     }
@@ -410,6 +431,22 @@ public:
      */
     void addCpuTime(std::chrono::nanoseconds ns);
 
+    std::chrono::nanoseconds getTotalCpuTime() const {
+        return total_cpu_time;
+    }
+
+    /**
+     * The total CPU time as of when the worker thread last measured the
+     * load of its connections (to pick one to move to another thread).
+     */
+    std::chrono::nanoseconds getBalanceCpuMark() const {
+        return balance_cpu_mark;
+    }
+
+    void setBalanceCpuMark(std::chrono::nanoseconds mark) {
+        balance_cpu_mark = mark;
+    }
+
     /**
      * Enqueue a new server event
      *
@@ -558,6 +595,21 @@ protected:
      * The longest time this connection was occupying the thread
      */
     std::chrono::nanoseconds max_sched_time = std::chrono::nanoseconds::zero();
+    /**
+     * total_cpu_time as of the last connection rebalancing check
+     */
+    std::chrono::nanoseconds balance_cpu_mark = std::chrono::nanoseconds::zero();
+
+    /** See getNotifiedAiostat() */
+    std::atomic<ENGINE_ERROR_CODE> notified_aiostat{ENGINE_SUCCESS};
+};
+
+/**
+ * The connections of a worker thread which have been notified by another
+ * thread (see notify_io_complete()) and are waiting to be run.
+ */
+class ConnectionNotificationQueue
+    : public NotificationQueue<Connection, &Connection::notification_hook> {
 };
 
 /**
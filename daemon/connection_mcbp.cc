@@ -165,6 +165,44 @@ bool McbpConnection::reapplyEventmask() {
     return updateEvent(ev_flags);
 }
 
+bool McbpConnection::isMigratable() {
+    const auto state = getState();
+    if (state != McbpStateMachine::State::waiting &&
+        state != McbpStateMachine::State::read_packet_header) {
+        return false;
+    }
+
+    return !isEwouldblock() && !isDCP() && getRefcount() == 1 &&
+           getNext() == nullptr && !isNotificationQueued() &&
+           server_events.empty() &&
+           (!read || read->empty()) && (!write || write->empty()) &&
+           !ssl.havePendingInputData() &&
+           socketDescriptor != INVALID_SOCKET;
+}
+
+bool McbpConnection::migrateTo(LIBEVENT_THREAD& thread) {
+    if (registered_in_libevent && !unregisterEvent()) {
+        return false;
+    }
+
+    // Give any (empty) loaned buffers back to the thread we're leaving
+    conn_return_buffers(this);
+
+    base = thread.base;
+    setThread(&thread);
+    if (event_assign(&event, base, socketDescriptor, ev_flags, event_handler,
+                     reinterpret_cast<void*>(this)) == -1) {
+        LOG_WARNING(this,
+                    "Failed to set up event notification while moving to "
+                    "worker thread %d. Shutting down connection %s",
+                    thread.index,
+                    getDescription().c_str());
+        return false;
+    }
+
+    return registerEvent();
+}
+
 bool McbpConnection::initializeEvent() {
     short event_flags = (EV_READ | EV_PERSIST);
 
@@ -201,6 +201,26 @@ public:
         return registered_in_libevent;
     }
 
+    /**
+     * Can the connection be moved to another worker thread? Only a
+     * connection idle between commands, with no partial input or pending
+     * output, no outstanding engine operation and no references held by
+     * the engine (such as DCP) may be moved.
+     */
+    bool isMigratable();
+
+    /**
+     * Move the connection to another worker thread's event base.
+     *
+     * Must be called from the connection's current worker thread, holding
+     * the locks of both threads, and only when isMigratable() is true.
+     *
+     * @param thread the thread to move to
+     * @return true if success, false otherwise (the connection is then
+     *         bound to the new thread but not registered in libevent)
+     */
+    bool migrateTo(LIBEVENT_THREAD& thread);
+
     short getEventFlags() const {
         return ev_flags;
     }
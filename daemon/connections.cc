@@ -166,6 +166,8 @@ void run_event_loop(Connection* c, short which) {
     auto* thread = c->getThread();
     if (thread != nullptr) {
         scheduler_info[thread->index].add(ns);
+        thread->busy_time += ns.count();
+        ++thread->num_events;
     }
 
     if (c->shouldDelete()) {
@@ -226,6 +228,7 @@ Connection* conn_new(const SOCKET sfd, in_port_t parent_port,
     associate_initial_bucket(*c);
 
     c->setThread(thread);
+    ++thread->num_connections;
     MEMCACHED_CONN_ALLOCATE(c->getId());
 
     if (settings.getVerbose() > 1) {
@@ -249,6 +252,10 @@ static void conn_cleanup(McbpConnection& connection) {
     connection.getCookieObject().reset();
     connection.setEngineStorage(nullptr);
 
+    auto* thread = connection.getThread();
+    if (thread != nullptr) {
+        --thread->num_connections;
+    }
     connection.setThread(nullptr);
     cb_assert(connection.getNext() == nullptr);
     connection.setSocketDescriptor(INVALID_SOCKET);
@@ -269,7 +276,9 @@ void conn_close(McbpConnection& connection) {
     if (thread == nullptr) {
         throw std::logic_error("conn_close: unable to obtain non-NULL thread from connection");
     }
-    /* remove from pending-io list */
+    /* remove from pending-io list (moving it there first if it's been
+     * notified) */
+    drain_notifications(thread);
     if (settings.getVerbose() > 1 &&
         list_contains(thread->pending_io, &connection)) {
         LOG_WARNING(
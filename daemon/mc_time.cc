@@ -158,6 +158,10 @@ static void mc_time_clock_event_handler(evutil_socket_t fd, short which, void *a
     evtimer_add(&clockevent, &t);
 
     mc_time_clock_tick();
+
+    // Rebalance worker threads; done here (rather than in
+    // mc_time_clock_tick) as it must run on the dispatcher thread.
+    threads_rebalance();
 }
 
 /*
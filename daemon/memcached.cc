@@ -1006,8 +1006,11 @@ void event_handler(evutil_socket_t fd, short which, void *arg) {
     /*
      * Remove the list from the list of pending io's (in case the
      * object was scheduled to run in the dispatcher before the
-     * callback for the worker thread is executed.
+     * callback for the worker thread is executed. Pick up any
+     * notifications first so that the connection sees the status of
+     * an engine operation which has completed.
      */
+    drain_notifications(thr);
     thr->pending_io = list_remove(thr->pending_io, c);
 
     /* sanity */
@@ -2,6 +2,7 @@
 #ifndef MEMCACHED_H
 #define MEMCACHED_H
 
+#include <atomic>
 #include <functional>
 #include <mutex>
 #include <vector>
@@ -14,6 +15,7 @@
 #include <event.h>
 #include <platform/pipe.h>
 #include <platform/platform.h>
+#include <platform/processclock.h>
 #include <subdoc/operations.h>
 
 #include <memcached/openssl.h>
@@ -70,17 +72,30 @@ enum class ThreadType {
 };
 
 class Connection;
+class ConnectionNotificationQueue;
 class ConnectionQueue;
 
 struct LIBEVENT_THREAD {
     cb_thread_t thread_id;      /* unique ID of this thread */
     struct event_base *base;    /* libevent handle this thread uses */
     struct event notify_event;  /* listen event for notify pipe */
-    SOCKET notify[2];           /* notification pipes */
+    SOCKET notify[2];           /* notification pipes (on Linux both are the
+                                   same eventfd) */
     ConnectionQueue *new_conn_queue; /* queue of new connections to handle */
     cb_mutex_t mutex;      /* Mutex to lock protect access to the pending_io */
     bool is_locked;
     Connection *pending_io;    /* List of connection with pending async io ops */
+
+    /**
+     * Connections notified by other threads (see notify_io_complete()).
+     * Pushing onto the queue doesn't need the thread lock; the thread moves
+     * the connections onto pending_io itself (see drain_notifications()).
+     */
+    std::unique_ptr<ConnectionNotificationQueue> notifications;
+    /** Number of notifications received by notify_io_complete() */
+    std::atomic<uint64_t> num_notifications;
+    /** Number of times the thread woke up to process its notify pipe */
+    std::atomic<uint64_t> num_wakeups;
     int index;                  /* index of this thread in the threads array */
     ThreadType type;      /* Type of IO this thread processes */
 
@@ -105,8 +120,52 @@ struct LIBEVENT_THREAD {
     int deleting_buckets;
 
     JSON_checker::Validator *validator;
+
+    /*
+     * Load accounting, used to dispatch new connections to (and move
+     * connections towards) the least loaded worker threads.
+     */
+
+    /** Total time spent running connection event loops (ns) */
+    std::atomic<uint64_t> busy_time;
+    /** Number of times a connection event loop has been run */
+    std::atomic<uint64_t> num_events;
+    /** Number of connections bound to this thread */
+    std::atomic<uint32_t> num_connections;
+    /**
+     * Recent fraction of time this thread spent busy, in permille
+     * (exponentially weighted; updated every clock tick)
+     */
+    std::atomic<uint32_t> load;
+    /** busy_time as of the last clock tick (only used by the dispatcher) */
+    uint64_t last_busy_time;
+    /** Connections dispatched since the last tick (only used by dispatcher) */
+    uint32_t dispatched_since_tick;
+
+    /**
+     * Index of the thread the rebalancer asked this thread to move a
+     * connection to, or -1
+     */
+    std::atomic<int> migrate_to;
+    /** Maximum load (permille) of the connection to move to migrate_to */
+    std::atomic<uint32_t> migrate_allowance;
+    /** When the connections' balance marks were last taken (see
+     *  Connection::getBalanceCpuMark()); only used by this thread */
+    ProcessClock::time_point balance_mark_time;
+    /** Number of connections moved to / from this thread */
+    std::atomic<uint64_t> migrated_in;
+    std::atomic<uint64_t> migrated_out;
 };
 
+/*
+ * Lock ordering: a thread lock may be held while taking the connections
+ * mutex (see iterate_thread_connections()), but a thread lock must never
+ * be taken while holding the connections mutex. Release hooks run under
+ * the connections mutex (close_all_connections()) may take a thread lock
+ * themselves, so whoever holds two thread locks (only migrate_connection())
+ * must not touch the connections mutex while doing so, and takes the two
+ * in index order.
+ */
 #define LOCK_THREAD(t) \
     cb_mutex_enter(&t->mutex); \
     cb_assert(!t->is_locked); \
@@ -158,6 +217,48 @@ void threads_cleanup(void);
 
 void dispatch_conn_new(SOCKET sfd, int parent_port);
 
+/**
+ * Update the load of each worker thread and, if the busiest thread is more
+ * than settings.getConnectionRebalanceThreshold() percent busier than the
+ * least busy, ask it to move one of its connections across. Called once a
+ * second from the dispatcher thread.
+ */
+void threads_rebalance(void);
+
+/**
+ * Select the worker thread to serve a new connection: the one with the
+ * lowest recent load, counting the connections dispatched to it since the
+ * load was last measured as if each adds load_estimate (so a burst of
+ * connections is spread out rather than all sent to the same thread). Ties
+ * go to the thread with the fewest connections, then to the first one
+ * found searching from index `start`.
+ *
+ * @param thread_array the worker threads
+ * @param count number of entries in thread_array
+ * @param start index of the thread to consider first
+ * @param load_estimate estimated load (permille) of a new connection
+ */
+LIBEVENT_THREAD* select_least_loaded_thread(LIBEVENT_THREAD* thread_array,
+                                            int count,
+                                            int start,
+                                            uint32_t load_estimate);
+
+/** A snapshot of the load on one worker thread */
+struct WorkerThreadLoad {
+    int index;
+    uint32_t connections;
+    uint32_t load;
+    uint64_t busy_time;
+    uint64_t events;
+    uint64_t migrated_in;
+    uint64_t migrated_out;
+    uint64_t notifications;
+    uint64_t wakeups;
+};
+
+/** Get the current load of each of the worker threads */
+std::vector<WorkerThreadLoad> threads_get_load(void);
+
 /* Lock wrappers for cache functions that are called from main loop. */
 int is_listen_thread(void);
 
@@ -177,6 +278,13 @@ bool load_extension(const char *soname, const char *config);
 
 int add_conn_to_pending_io_list(Connection *c);
 
+/**
+ * Move the connections on the thread's notification queue onto its
+ * pending_io list, applying the status they were notified with. Must be
+ * called by the thread itself, holding the thread lock.
+ */
+void drain_notifications(LIBEVENT_THREAD* thr);
+
 /* connection state machine */
 bool conn_listening(ListenConnection *c);
 
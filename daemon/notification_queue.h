@@ -0,0 +1,119 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * The link an object needs to be put on a NotificationQueue.
+ */
+template <typename T>
+struct NotificationQueueHook {
+    /// Set while the object is on a queue
+    std::atomic<bool> queued{false};
+    /// Next object on the queue; only valid while queued
+    T* next = nullptr;
+};
+
+/**
+ * A lock-free multi-producer, single-consumer queue of objects which have
+ * been notified (for example connections whose engine operation has
+ * completed, see notify_io_complete()).
+ *
+ * Any thread may push() an object; only the owning thread may drain() the
+ * queue. The queue is intrusive (the link lives in the object, at the
+ * member `Hook`) so pushing never allocates, and an object already on the
+ * queue is not added again, so notifying the same object many times before
+ * the consumer gets to it costs one queue entry.
+ *
+ * push() reports whether the queue was empty, so producers only need to
+ * wake the consumer for the first object of each batch: a producer which
+ * finds the queue non-empty knows a wakeup is already outstanding for it.
+ *
+ * The caller is responsible for keeping objects alive while they are on
+ * the queue.
+ */
+template <typename T, NotificationQueueHook<T> T::*Hook>
+class NotificationQueue {
+public:
+    /**
+     * Add an object to the queue (unless it is already queued).
+     *
+     * @return true if the queue was empty, in which case the caller must
+     *         wake the consumer
+     */
+    bool push(T& object) {
+        auto& hook = object.*Hook;
+        if (hook.queued.exchange(true)) {
+            return false;
+        }
+
+        T* old = head.load(std::memory_order_relaxed);
+        do {
+            hook.next = old;
+        } while (!head.compare_exchange_weak(old,
+                                             &object,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+        return old == nullptr;
+    }
+
+    /**
+     * Remove everything currently on the queue, calling `callback` with each
+     * object in the order they were pushed. Only to be called by the
+     * consumer.
+     *
+     * The object is marked as no longer queued before the callback is
+     * called, so a notification which arrives while it is being handled
+     * queues it again rather than being lost.
+     *
+     * @return the number of objects removed
+     */
+    template <typename Callback>
+    size_t drain(Callback callback) {
+        T* list = head.exchange(nullptr, std::memory_order_acquire);
+
+        // The queue is a stack; reverse it to handle objects in FIFO order
+        T* fifo = nullptr;
+        while (list != nullptr) {
+            T* next = (list->*Hook).next;
+            (list->*Hook).next = fifo;
+            fifo = list;
+            list = next;
+        }
+
+        size_t count = 0;
+        while (fifo != nullptr) {
+            T* object = fifo;
+            auto& hook = object->*Hook;
+            fifo = hook.next;
+            hook.next = nullptr;
+            hook.queued.store(false);
+            callback(*object);
+            ++count;
+        }
+        return count;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == nullptr;
+    }
+
+private:
+    std::atomic<T*> head{nullptr};
+};
@@ -16,6 +16,7 @@
  */
 #include "dcp_deletion.h"
 #include "engine_wrapper.h"
+#include "ship_dcp_log.h"
 #include "utilities.h"
 #include "../../mcbp.h"
 
@@ -186,6 +187,7 @@ ENGINE_ERROR_CODE dcp_message_deletion(gsl::not_null<const void*> void_cookie,
             c->addIov(buffer.data() + packetlen, nmeta);
         }
 
+        dcp_message_produced(*c, packetlen + nmeta);
         return packetlen + nmeta;
     });
 
@@ -17,6 +17,7 @@
 
 #include "dcp_mutation.h"
 #include "engine_wrapper.h"
+#include "ship_dcp_log.h"
 #include "utilities.h"
 #include "../../mcbp.h"
 
@@ -116,6 +117,7 @@ ENGINE_ERROR_CODE dcp_message_mutation(gsl::not_null<const void*> void_cookie,
             c->addIov(wbuf.data() + packetlen, nmeta);
         }
 
+        dcp_message_produced(*c, packetlen + nmeta);
         return packetlen + nmeta;
     });
 
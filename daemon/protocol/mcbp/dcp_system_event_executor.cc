@@ -15,6 +15,7 @@
  *   limitations under the License.
  */
 #include "dcp_system_event_executor.h"
+#include "ship_dcp_log.h"
 #include "../../mcbp.h"
 #include "engine_wrapper.h"
 #include "utilities.h"
@@ -70,6 +71,7 @@ void dcp_system_event_executor(Cookie& cookie) {
 
 ENGINE_ERROR_CODE dcp_message_system_event(gsl::not_null<const void*> cookie,
                                            uint32_t opaque,
+                                           item* it,
                                            uint16_t vbucket,
                                            mcbp::systemevent::id event,
                                            uint64_t bySeqno,
@@ -77,25 +79,54 @@ ENGINE_ERROR_CODE dcp_message_system_event(gsl::not_null<const void*> cookie,
                                            cb::const_byte_buffer eventData) {
     auto* c = cookie2mcbp(cookie, __func__);
 
+    // Use a unique_ptr to make sure we release the item in all error paths
+    cb::unique_item_ptr item(it, cb::ItemDeleter{c->getBucketEngineAsV0()});
+
+    // The key may be sent from the engine's memory as long as we hold on
+    // to the item owning it until it's sent. Otherwise it (like the event
+    // data, which the engine builds on the fly) has to be copied into the
+    // send pipe, as the engine is free to release it once we return.
+    const bool copyKey = (it == nullptr);
+    if (!copyKey) {
+        if (!c->reserveItem(it)) {
+            LOG_WARNING(c,
+                        "%u: dcp_message_system_event: Failed to grow item "
+                        "array",
+                        c->getId());
+            return ENGINE_FAILED;
+        }
+        // we've reserved the item, and it'll be released when we're done
+        // sending the message.
+        item.release();
+    }
+
     protocol_binary_request_dcp_system_event packet(
             opaque, vbucket, key.size(), eventData.size(), event, bySeqno);
 
     ENGINE_ERROR_CODE ret = ENGINE_SUCCESS;
-    c->write->produce([&c, &packet, &key, &eventData, &ret](
+    c->write->produce([&c, &packet, &key, &eventData, copyKey, &ret](
                               cb::byte_buffer buffer) -> size_t {
-        if (buffer.size() < sizeof(packet.bytes)) {
+        const size_t needed = sizeof(packet.bytes) + eventData.size() +
+                              (copyKey ? key.size() : 0);
+        if (buffer.size() < needed) {
             ret = ENGINE_E2BIG;
             return 0;
         }
 
-        std::copy(packet.bytes,
-                  packet.bytes + sizeof(packet.bytes),
-                  buffer.begin());
+        auto* header = buffer.data();
+        auto* data = std::copy(
+                packet.bytes, packet.bytes + sizeof(packet.bytes), header);
+        auto* keyData = std::copy(eventData.begin(), eventData.end(), data);
+        if (copyKey) {
+            std::copy(key.begin(), key.end(), keyData);
+        }
+
+        c->addIov(header, sizeof(packet.bytes));
+        c->addIov(copyKey ? keyData : key.data(), key.size());
+        c->addIov(data, eventData.size());
 
-        c->addIov(buffer.data(), sizeof(packet.bytes));
-        c->addIov(key.data(), key.size());
-        c->addIov(eventData.data(), eventData.size());
-        return sizeof(packet.bytes);
+        dcp_message_produced(*c, needed);
+        return needed;
     });
 
     return ret;
@@ -25,6 +25,8 @@
  * @param cookie The cookie provided from the frontend representing the
  *               connection.
  * @param opaque The opaque value the other end requested to be in the packets
+ * @param it An item owning the memory the key refers to (reserved until the
+ *           packet is sent, so the key isn't copied), or nullptr
  * @param vbucket The vbucket the object resides in
  * @param event The engine's system event ID
  * @param bySeqno The by_seqno value the data is stored in the vbucket
@@ -34,6 +36,7 @@
  */
 ENGINE_ERROR_CODE dcp_message_system_event(gsl::not_null<const void*> cookie,
                                            uint32_t opaque,
+                                           item* it,
                                            uint16_t vbucket,
                                            mcbp::systemevent::id event,
                                            uint64_t bySeqno,
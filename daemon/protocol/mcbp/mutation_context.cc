@@ -21,6 +21,7 @@
 
 #include <memcached/protocol_binary.h>
 #include <memcached/types.h>
+#include <utilities/json_validator.h>
 #include <xattr/utils.h>
 
 MutationCommandContext::MutationCommandContext(Cookie& cookie,
@@ -103,7 +104,8 @@ ENGINE_ERROR_CODE MutationCommandContext::validateInput() {
         auto* validator = connection.getThread()->validator;
         try {
             auto* ptr = reinterpret_cast<const uint8_t*>(value.buf);
-            if (validator->validate(ptr, value.len)) {
+            if (cb::json::isObjectOrArray(ptr, value.len) ||
+                validator->validate(ptr, value.len)) {
                 datatype = PROTOCOL_BINARY_DATATYPE_JSON;
             }
         } catch (const std::bad_alloc&) {
@@ -33,6 +33,7 @@ static ENGINE_ERROR_CODE add_packet_to_pipe(McbpConnection* c,
 
         std::copy(packet.begin(), packet.end(), buffer.begin());
         c->addIov(buffer.data(), packet.size());
+        dcp_message_produced(*c, packet.size());
         return packet.size();
     });
 
@@ -291,12 +292,19 @@ static ENGINE_ERROR_CODE dcp_message_control(
                   static_cast<uint8_t*>(ptr) + sizeof(packet.bytes) + nkey);
 
         c->addIov(ptr, sizeof(packet.bytes) + nkey + nvalue);
+        dcp_message_produced(*c, sizeof(packet.bytes) + nkey + nvalue);
         return sizeof(packet.bytes) + nkey + nvalue;
     });
 
     return ret;
 }
 
+void dcp_message_produced(McbpConnection& c, size_t copied) {
+    auto* thread_stats = get_thread_stats(&c);
+    thread_stats->dcp_msgs_sent++;
+    thread_stats->bytes_dcp_msgs_copied += copied;
+}
+
 void ship_dcp_log(McbpConnection& c) {
     static struct dcp_message_producers producers = {
             dcp_message_get_failover_log,
@@ -19,3 +19,12 @@
 #include <daemon/connection_mcbp.h>
 
 void ship_dcp_log(McbpConnection& c);
+
+/**
+ * Account for a DCP message queued for sending to `c`.
+ *
+ * @param copied the number of bytes of the message which were copied into
+ *               the connection's send pipe (the rest is sent directly from
+ *               memory owned by the engine)
+ */
+void dcp_message_produced(McbpConnection& c, size_t copied);
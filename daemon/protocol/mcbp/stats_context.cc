@@ -195,6 +195,11 @@ static ENGINE_ERROR_CODE server_stats(ADD_STAT add_stat_callback,
         add_stat(cookie, add_stat_callback, "bytes_subdoc_mutation_inserted",
                  thread_stats.bytes_subdoc_mutation_inserted);
 
+        add_stat(cookie, add_stat_callback, "dcp_msgs_sent",
+                 thread_stats.dcp_msgs_sent);
+        add_stat(cookie, add_stat_callback, "bytes_dcp_msgs_copied",
+                 thread_stats.bytes_dcp_msgs_copied);
+
         // index 0 contains the aggregated timings for all buckets
         auto& timings = all_buckets[0].timings;
         uint64_t total_mutations = timings.get_aggregated_mutation_stats();
@@ -379,6 +384,11 @@ static void process_stat_settings(ADD_STAT add_stat_callback, Cookie& cookie) {
 
     add_stat(cookie, add_stat_callback, "connection_idle_time",
              std::to_string(settings.getConnectionIdleTime()).c_str());
+    add_stat(cookie,
+             add_stat_callback,
+             "connection_rebalance_threshold",
+             std::to_string(settings.getConnectionRebalanceThreshold())
+                     .c_str());
     add_stat(cookie,
              add_stat_callback,
              "datatype_json",
@@ -540,6 +550,49 @@ static ENGINE_ERROR_CODE stat_sched_executor(const std::string& arg,
     }
 }
 
+/**
+ * Handler for the <code>stats threads</code> used to get the load on each
+ * of the worker threads (to verify connections are balanced across them).
+ *
+ * @param arg - should be empty
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_threads_executor(const std::string& arg,
+                                               Cookie& cookie) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    for (const auto& worker : threads_get_load()) {
+        // Bytes transferred are tracked per bucket; sum them up
+        uint64_t bytes_read = 0;
+        uint64_t bytes_written = 0;
+        for (const auto& bucket : all_buckets) {
+            if (size_t(worker.index) < bucket.stats.size()) {
+                bytes_read += bucket.stats[worker.index].bytes_read;
+                bytes_written += bucket.stats[worker.index].bytes_written;
+            }
+        }
+
+        const std::string prefix = "worker_" + std::to_string(worker.index);
+        auto add = [&cookie, &prefix](const char* name, uint64_t value) {
+            const std::string key = prefix + ":" + name;
+            add_stat(cookie, append_stats, key.c_str(), value);
+        };
+        add("connections", worker.connections);
+        add("load_permille", worker.load);
+        add("busy_time_ns", worker.busy_time);
+        add("events", worker.events);
+        add("bytes_read", bytes_read);
+        add("bytes_written", bytes_written);
+        add("migrated_in", worker.migrated_in);
+        add("migrated_out", worker.migrated_out);
+        add("notifications", worker.notifications);
+        add("wakeups", worker.wakeups);
+    }
+    return ENGINE_SUCCESS;
+}
+
 /**
  * Handler for the <code>stats settings</code> used to get the current
  * settings.
@@ -827,6 +880,7 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
     static std::unordered_map<std::string, struct stat_handler> handlers = {
             {"reset", {true, stat_reset_executor}},
             {"worker_thread_info", {false, stat_sched_executor}},
+            {"threads", {false, stat_threads_executor}},
             {"settings", {false, stat_settings_executor}},
             {"audit", {true, stat_audit_executor}},
             {"bucket_details", {true, stat_bucket_details_executor}},
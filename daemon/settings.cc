@@ -54,6 +54,7 @@ Settings::Settings()
 
     verbose.store(0);
     connection_idle_time.reset();
+    connection_rebalance_threshold.reset();
     dedupe_nmvb_maps.store(false);
     xattr_enabled.store(false);
     privilege_debug.store(false);
@@ -280,6 +281,22 @@ static void handle_connection_idle_time(Settings& s, cJSON* obj) {
     s.setConnectionIdleTime(obj->valueint);
 }
 
+/**
+ * Handle the "connection_rebalance_threshold" tag in the settings
+ *
+ *  The value must be a numeric value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_connection_rebalance_threshold(Settings& s, cJSON* obj) {
+    if (obj->type != cJSON_Number) {
+        throw std::invalid_argument(
+            "\"connection_rebalance_threshold\" must be an integer");
+    }
+    s.setConnectionRebalanceThreshold(obj->valueint);
+}
+
 /**
  * Handle the "bio_drain_buffer_sz" tag in the settings
  *
@@ -650,6 +667,8 @@ void Settings::reconfigure(const unique_cJSON_ptr& json) {
             {"reqs_per_event_low_priority", handle_reqs_event},
             {"verbosity", handle_verbosity},
             {"connection_idle_time", handle_connection_idle_time},
+            {"connection_rebalance_threshold",
+             handle_connection_rebalance_threshold},
             {"bio_drain_buffer_sz", handle_bio_drain_buffer_sz},
             {"datatype_json", handle_datatype_json},
             {"datatype_snappy", handle_datatype_snappy},
@@ -1073,6 +1092,17 @@ void Settings::updateSettings(const Settings& other, bool apply) {
             setConnectionIdleTime(other.connection_idle_time);
         }
     }
+    if (other.has.connection_rebalance_threshold) {
+        if (other.connection_rebalance_threshold !=
+            connection_rebalance_threshold) {
+            logit(EXTENSION_LOG_NOTICE,
+                  "Change connection rebalance threshold from %u to %u",
+                  connection_rebalance_threshold.load(),
+                  other.connection_rebalance_threshold.load());
+            setConnectionRebalanceThreshold(
+                    other.connection_rebalance_threshold);
+        }
+    }
     if (other.has.max_packet_size) {
         if (other.max_packet_size != max_packet_size) {
             logit(EXTENSION_LOG_NOTICE,
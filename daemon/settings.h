@@ -495,6 +495,30 @@ public:
         notify_changed("connection_idle_time");
     }
 
+    /**
+     * Get the load imbalance between worker threads at which connections
+     * are moved from the busiest to the least busy thread.
+     *
+     * @return the difference in load, in percent of a thread's time (0
+     *         means connections are never moved)
+     */
+    size_t getConnectionRebalanceThreshold() const {
+        return connection_rebalance_threshold;
+    }
+
+    /**
+     * Set the connection rebalance threshold
+     *
+     * @param value the difference in load (percent) between the busiest
+     *              and least busy worker thread which triggers moving a
+     *              connection, or 0 to disable
+     */
+    void setConnectionRebalanceThreshold(size_t value) {
+        Settings::connection_rebalance_threshold = value;
+        has.connection_rebalance_threshold = true;
+        notify_changed("connection_rebalance_threshold");
+    }
+
     /**
      * Get the root directory of the couchbase installation
      *
@@ -1014,6 +1038,12 @@ protected:
      */
     Couchbase::RelaxedAtomic<size_t> connection_idle_time;
 
+    /**
+     * The load difference (percent) between worker threads which triggers
+     * moving a connection between them
+     */
+    Couchbase::RelaxedAtomic<size_t> connection_rebalance_threshold;
+
     /**
      * The root directory of the installation
      */
@@ -1145,6 +1175,7 @@ public:
         bool default_reqs_per_event;
         bool verbose;
         bool connection_idle_time;
+        bool connection_rebalance_threshold;
         bool bio_drain_buffer_sz;
         bool datatype_json;
         bool datatype_snappy;
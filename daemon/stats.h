@@ -60,6 +60,9 @@ struct thread_stats {
         bytes_subdoc_mutation_total = 0;
         bytes_subdoc_mutation_inserted = 0;
 
+        dcp_msgs_sent = 0;
+        bytes_dcp_msgs_copied = 0;
+
         rbufs_allocated = 0;
         rbufs_loaned = 0;
         rbufs_existing = 0;
@@ -102,6 +105,9 @@ struct thread_stats {
         bytes_subdoc_mutation_total += other.bytes_subdoc_mutation_total;
         bytes_subdoc_mutation_inserted += other.bytes_subdoc_mutation_inserted;
 
+        dcp_msgs_sent += other.dcp_msgs_sent;
+        bytes_dcp_msgs_copied += other.bytes_dcp_msgs_copied;
+
         rbufs_allocated += other.rbufs_allocated;
         rbufs_loaned += other.rbufs_loaned;
         rbufs_existing += other.rbufs_existing;
@@ -165,6 +171,13 @@ struct thread_stats {
        received from the client). */
     Couchbase::RelaxedAtomic<uint64_t> bytes_subdoc_mutation_inserted;
 
+    /* # of DCP messages queued for sending by DCP producers */
+    Couchbase::RelaxedAtomic<uint64_t> dcp_msgs_sent;
+    /* # of bytes of those messages which were copied into the send pipe
+       (headers, and any data the engine couldn't keep alive until the
+       message was sent). Compare with 'dcp_msgs_sent' */
+    Couchbase::RelaxedAtomic<uint64_t> bytes_dcp_msgs_copied;
+
     /* # of read buffers allocated. */
     Couchbase::RelaxedAtomic<uint64_t> rbufs_allocated;
     /* # of read buffers which could be loaned (and hence didn't need to be allocated). */
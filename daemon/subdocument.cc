@@ -24,6 +24,7 @@
 #include "protocol/mcbp/engine_wrapper.h"
 #include "subdoc/util.h"
 #include "subdocument_context.h"
+#include "subdocument_multipath.h"
 #include "subdocument_traits.h"
 #include "subdocument_validators.h"
 #include "timings.h"
@@ -691,6 +692,137 @@ static protocol_binary_response_status subdoc_operate_wholedoc(
     }
 }
 
+/**
+ * Resolve the GET and EXISTS lookups of a multi-lookup in one pass over the
+ * document (rather than one subjson parse per path). Lookups which can't be
+ * resolved that way (unsupported paths, or ones which fail) are left for
+ * subjson.
+ *
+ * @param done set for each of the operations resolved
+ */
+static void subdoc_resolve_lookups(SubdocCmdContext& context,
+                                   const cb::const_char_buffer& doc,
+                                   std::vector<bool>& done) {
+    auto& operations = context.getOperations();
+    SubdocMultiPathLookup lookup;
+    std::vector<size_t> specs;
+
+    for (size_t ii = 0; ii < operations.size(); ++ii) {
+        const auto& spec = operations[ii];
+        if (spec.traits.scope == CommandScope::SubJSON &&
+            (spec.traits.subdocCommand == Subdoc::Command::GET ||
+             spec.traits.subdocCommand == Subdoc::Command::EXISTS) &&
+            lookup.addPath(spec.path)) {
+            specs.push_back(ii);
+        }
+    }
+
+    if (specs.size() < 2) {
+        // Not worth it; subjson is as quick for a single path
+        return;
+    }
+
+    lookup.execute(doc);
+    for (size_t ii = 0; ii < specs.size(); ++ii) {
+        const auto match = lookup.getMatch(ii);
+        if (match.buf == nullptr) {
+            continue;
+        }
+        auto& spec = operations[specs[ii]];
+        if (spec.traits.subdocCommand == Subdoc::Command::GET) {
+            spec.result.set_matchloc({match.buf, match.len});
+        }
+        spec.status = PROTOCOL_BINARY_RESPONSE_SUCCESS;
+        done[specs[ii]] = true;
+    }
+}
+
+/**
+ * Apply all of the mutations of a multi-mutation to the document at once:
+ * each is located and performed by subjson against the original document
+ * and the results are spliced together into a single new document, rather
+ * than building a new document (to be parsed again) after every mutation.
+ *
+ * Only done for mutations which can't interfere with each other other than
+ * by touching the same part of the document (which
+ * subdoc_merge_splices() detects): no mkdir_p or macros, and no array
+ * insertions or removals alongside paths with array indices.
+ *
+ * @return true if the mutations were applied (doc then refers to the new
+ *         document, in temp_buffer), false if they must be applied in turn
+ * @throws std::bad_alloc if allocation fails
+ */
+static bool subdoc_batch_mutations(SubdocCmdContext& context,
+                                   cb::const_char_buffer& doc,
+                                   std::unique_ptr<char[]>& temp_buffer) {
+    auto& operations = context.getOperations();
+    if (operations.size() < 2) {
+        return false;
+    }
+
+    bool indexed = false;
+    bool reshapes = false;
+    for (const auto& spec : operations) {
+        if (spec.traits.scope != CommandScope::SubJSON ||
+            (spec.flags & (SUBDOC_FLAG_MKDIR_P | SUBDOC_FLAG_EXPAND_MACROS))) {
+            return false;
+        }
+
+        switch (spec.traits.subdocCommand) {
+        case Subdoc::Command::REPLACE:
+        case Subdoc::Command::COUNTER:
+            break;
+        case Subdoc::Command::DICT_UPSERT:
+        case Subdoc::Command::DICT_ADD:
+        case Subdoc::Command::REMOVE:
+        case Subdoc::Command::ARRAY_APPEND:
+        case Subdoc::Command::ARRAY_PREPEND:
+        case Subdoc::Command::ARRAY_ADD_UNIQUE:
+            reshapes = true;
+            break;
+        default:
+            return false;
+        }
+
+        if (std::memchr(spec.path.buf, '[', spec.path.len) != nullptr) {
+            indexed = true;
+        }
+    }
+
+    if (indexed && reshapes) {
+        // An element's index may depend on the mutations before it
+        return false;
+    }
+
+    std::vector<const Subdoc::Result*> results;
+    results.reserve(operations.size());
+    for (auto& spec : operations) {
+        spec.status = subdoc_operate_one_path(context, spec, doc);
+        if (spec.status != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+            break;
+        }
+        results.push_back(&spec.result);
+    }
+
+    std::unique_ptr<char[]> newdoc;
+    size_t newlen;
+    if (results.size() != operations.size() ||
+        !subdoc_merge_splices(doc, results, newdoc, newlen)) {
+        // Let the sequential path work out what happens (and which mutation
+        // fails)
+        for (auto& spec : operations) {
+            spec.result.clear();
+            spec.status = PROTOCOL_BINARY_RESPONSE_EINTERNAL;
+        }
+        return false;
+    }
+
+    temp_buffer.swap(newdoc);
+    doc.buf = temp_buffer.get();
+    doc.len = newlen;
+    return true;
+}
+
 /**
  * Run through all of the subdoc operations for the current phase on
  * a single 'document' (either the user document, or a XATTR).
@@ -716,8 +848,28 @@ static bool operate_single_doc(SubdocCmdContext& context,
     modified = false;
     auto& operations = context.getOperations();
 
+    // 1. Perform as much of the work as possible in one go on the document
+    // body (XATTRs are small, and have their own semantics).
+    std::vector<bool> done(operations.size());
+    if (context.getCurrentPhase() == SubdocCmdContext::Phase::Body &&
+        context.traits.path == SubdocPath::MULTI &&
+        mcbp::datatype::is_json(doc_datatype)) {
+        if (context.traits.is_mutator) {
+            if (subdoc_batch_mutations(context, doc, temp_buffer)) {
+                modified = true;
+                return true;
+            }
+        } else {
+            subdoc_resolve_lookups(context, doc, done);
+        }
+    }
+
     // 2. Perform each of the operations on document.
     for (auto op = operations.begin(); op != operations.end(); op++) {
+        if (done[op - operations.begin()]) {
+            continue;
+        }
+
         switch (op->traits.scope) {
         case CommandScope::SubJSON:
             if (mcbp::datatype::is_json(doc_datatype)) {
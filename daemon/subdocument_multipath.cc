@@ -0,0 +1,468 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "subdocument_multipath.h"
+
+#include <algorithm>
+#include <cstring>
+
+static bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char* skipWhitespace(const char* p, const char* end) {
+    while (p < end && isWhitespace(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+/**
+ * Skip the string starting (with its opening quote) at p.
+ *
+ * @param escaped set to true if the string contains escape sequences
+ * @return the position after the closing quote, or nullptr if there is none
+ */
+static const char* skipString(const char* p, const char* end, bool& escaped) {
+    ++p;
+    while (p < end) {
+        if (*p == '"') {
+            return p + 1;
+        }
+        if (*p == '\\') {
+            escaped = true;
+            ++p;
+        }
+        ++p;
+    }
+    return nullptr;
+}
+
+bool SubdocMultiPathLookup::addPath(cb::const_char_buffer path) {
+    if (paths.size() == maxPaths || path.len == 0) {
+        return false;
+    }
+
+    const char* p = path.buf;
+    const char* const pathEnd = path.buf + path.len;
+    const size_t first = components.size();
+
+    while (p < pathEnd) {
+        Component comp{{nullptr, 0}, 0, false};
+        if (*p == '[') {
+            const char* digits = ++p;
+            while (p < pathEnd && *p >= '0' && *p <= '9') {
+                comp.index = comp.index * 10 + (*p - '0');
+                ++p;
+            }
+            // No negative (from the end) or zero-padded indices
+            if (p == digits || p == pathEnd || *p != ']' ||
+                (p - digits > 1 && *digits == '0') || p - digits > 9) {
+                components.resize(first);
+                return false;
+            }
+            ++p;
+            comp.isIndex = true;
+        } else {
+            const char* key = p;
+            while (p < pathEnd && *p != '.' && *p != '[') {
+                if (*p == '`' || *p == ']') {
+                    components.resize(first);
+                    return false;
+                }
+                ++p;
+            }
+            if (p == key) {
+                components.resize(first);
+                return false;
+            }
+            comp.key = {key, size_t(p - key)};
+        }
+        components.push_back(comp);
+
+        if (p < pathEnd && *p == '.') {
+            // A key must follow
+            if (++p == pathEnd || *p == '[' || *p == '.') {
+                components.resize(first);
+                return false;
+            }
+        }
+    }
+
+    const size_t count = components.size() - first;
+    if (count > maxDepth) {
+        components.resize(first);
+        return false;
+    }
+    paths.push_back({first, count, {nullptr, 0}});
+    return true;
+}
+
+void SubdocMultiPathLookup::execute(cb::const_char_buffer doc) {
+    for (auto& path : paths) {
+        path.match = {nullptr, 0};
+    }
+    if (paths.empty()) {
+        return;
+    }
+
+    end = doc.buf + doc.len;
+    const uint64_t all =
+            paths.size() == 64 ? ~uint64_t(0) : (uint64_t(1) << paths.size()) - 1;
+    pending = all;
+    if (scanValue(doc.buf, 0, all) == nullptr) {
+        // Not what we expected; leave it all to subjson
+        for (auto& path : paths) {
+            path.match = {nullptr, 0};
+        }
+    }
+}
+
+/*
+ * Scan the value at p, which the paths in `active` have matched (up to
+ * `depth` components) so far. Paths which end here match the value; the
+ * others continue into it.
+ *
+ * Returns the position after the value, or nullptr if the document isn't
+ * as expected. Once all paths have been resolved (pending is empty) the
+ * scan stops, returning a position which is no longer meaningful.
+ */
+const char* SubdocMultiPathLookup::scanValue(const char* p,
+                                             size_t depth,
+                                             uint64_t active) {
+    p = skipWhitespace(p, end);
+    if (p == end) {
+        return nullptr;
+    }
+
+    uint64_t exact = 0;
+    uint64_t deeper = 0;
+    for (size_t ii = 0; ii < paths.size(); ++ii) {
+        const uint64_t bit = uint64_t(1) << ii;
+        if (active & bit) {
+            if (paths[ii].count == depth) {
+                exact |= bit;
+            } else {
+                deeper |= bit;
+            }
+        }
+    }
+
+    const char* start = p;
+    const char* next;
+    if (deeper != 0 && *p == '{') {
+        next = scanObject(p, depth, deeper);
+    } else if (deeper != 0 && *p == '[') {
+        next = scanArray(p, depth, deeper);
+    } else {
+        // Paths into a primitive don't resolve
+        pending &= ~deeper;
+        next = skipValue(p, depth);
+    }
+
+    if (next == nullptr || pending == 0) {
+        return next;
+    }
+
+    if (exact != 0) {
+        for (size_t ii = 0; ii < paths.size(); ++ii) {
+            if (exact & (uint64_t(1) << ii)) {
+                paths[ii].match = {start, size_t(next - start)};
+            }
+        }
+        pending &= ~exact;
+    }
+    return next;
+}
+
+const char* SubdocMultiPathLookup::scanObject(const char* p,
+                                              size_t depth,
+                                              uint64_t active) {
+    // Only the first occurrence of a key is looked into (as subjson does)
+    uint64_t remaining = 0;
+    for (size_t ii = 0; ii < paths.size(); ++ii) {
+        const uint64_t bit = uint64_t(1) << ii;
+        if ((active & bit) && !component(ii, depth).isIndex) {
+            remaining |= bit;
+        }
+    }
+    pending &= ~(active & ~remaining);
+
+    p = skipWhitespace(p + 1, end);
+    if (p < end && *p == '}') {
+        pending &= ~remaining;
+        return p + 1;
+    }
+
+    while (p < end) {
+        if (*p != '"') {
+            return nullptr;
+        }
+        bool escaped = false;
+        const char* key = p + 1;
+        p = skipString(p, end, escaped);
+        if (p == nullptr) {
+            return nullptr;
+        }
+        const size_t keylen = size_t(p - 1 - key);
+
+        uint64_t matching = 0;
+        if (escaped) {
+            // Can't tell (without unescaping) if the key matches
+            pending &= ~remaining;
+            remaining = 0;
+        } else {
+            for (size_t ii = 0; ii < paths.size(); ++ii) {
+                const uint64_t bit = uint64_t(1) << ii;
+                if (remaining & bit) {
+                    const auto& comp = component(ii, depth).key;
+                    if (comp.len == keylen &&
+                        std::memcmp(comp.buf, key, keylen) == 0) {
+                        matching |= bit;
+                    }
+                }
+            }
+            remaining &= ~matching;
+        }
+
+        p = skipWhitespace(p, end);
+        if (p == end || *p != ':') {
+            return nullptr;
+        }
+        ++p;
+
+        if (matching != 0) {
+            p = scanValue(p, depth + 1, matching);
+        } else {
+            p = skipValue(skipWhitespace(p, end), depth + 1);
+        }
+        if (p == nullptr || pending == 0) {
+            return p;
+        }
+
+        p = skipWhitespace(p, end);
+        if (p == end) {
+            return nullptr;
+        }
+        if (*p == '}') {
+            pending &= ~remaining;
+            return p + 1;
+        }
+        if (*p != ',') {
+            return nullptr;
+        }
+        p = skipWhitespace(p + 1, end);
+    }
+    return nullptr;
+}
+
+const char* SubdocMultiPathLookup::scanArray(const char* p,
+                                             size_t depth,
+                                             uint64_t active) {
+    uint64_t remaining = 0;
+    for (size_t ii = 0; ii < paths.size(); ++ii) {
+        const uint64_t bit = uint64_t(1) << ii;
+        if ((active & bit) && component(ii, depth).isIndex) {
+            remaining |= bit;
+        }
+    }
+    pending &= ~(active & ~remaining);
+
+    p = skipWhitespace(p + 1, end);
+    if (p < end && *p == ']') {
+        pending &= ~remaining;
+        return p + 1;
+    }
+
+    for (size_t index = 0; p < end; ++index) {
+        uint64_t matching = 0;
+        for (size_t ii = 0; ii < paths.size(); ++ii) {
+            const uint64_t bit = uint64_t(1) << ii;
+            if ((remaining & bit) && component(ii, depth).index == index) {
+                matching |= bit;
+            }
+        }
+        remaining &= ~matching;
+
+        if (matching != 0) {
+            p = scanValue(p, depth + 1, matching);
+        } else {
+            p = skipValue(p, depth + 1);
+        }
+        if (p == nullptr || pending == 0) {
+            return p;
+        }
+
+        p = skipWhitespace(p, end);
+        if (p == end) {
+            return nullptr;
+        }
+        if (*p == ']') {
+            pending &= ~remaining;
+            return p + 1;
+        }
+        if (*p != ',') {
+            return nullptr;
+        }
+        p = skipWhitespace(p + 1, end);
+    }
+    return nullptr;
+}
+
+/*
+ * Skip the value at p (at the given depth of the document) without looking
+ * into it. Returns nullptr if the document isn't as expected, or nests
+ * deeper than maxDepth (where subjson would fail).
+ */
+const char* SubdocMultiPathLookup::skipValue(const char* p, size_t depth) {
+    if (p == end) {
+        return nullptr;
+    }
+
+    bool escaped;
+    if (*p == '"') {
+        return skipString(p, end, escaped);
+    }
+
+    if (*p != '{' && *p != '[') {
+        // A number, true, false or null
+        const char* start = p;
+        while (p < end && !isWhitespace(*p) && *p != ',' && *p != '}' &&
+               *p != ']') {
+            ++p;
+        }
+        return p == start ? nullptr : p;
+    }
+
+    size_t level = 0;
+    while (p < end) {
+        switch (*p) {
+        case '"':
+            p = skipString(p, end, escaped);
+            if (p == nullptr) {
+                return nullptr;
+            }
+            continue;
+        case '{':
+        case '[':
+            if (depth + ++level > maxDepth) {
+                return nullptr;
+            }
+            break;
+        case '}':
+        case ']':
+            if (--level == 0) {
+                return p + 1;
+            }
+            break;
+        }
+        ++p;
+    }
+    return nullptr;
+}
+
+bool subdoc_merge_splices(cb::const_char_buffer doc,
+                          const std::vector<const Subdoc::Result*>& results,
+                          std::unique_ptr<char[]>& newdoc,
+                          size_t& newlen) {
+    struct Splice {
+        size_t offset; // start of the region replaced
+        size_t end; // end of the region replaced
+        std::vector<cb::const_char_buffer> content;
+    };
+
+    std::vector<Splice> splices;
+    splices.reserve(results.size());
+
+    for (const auto* result : results) {
+        std::vector<cb::const_char_buffer> locs;
+        for (const auto& loc : result->newdoc()) {
+            locs.push_back({loc.at, loc.length});
+        }
+
+        // The leading pieces which are the start of the document...
+        size_t first = 0;
+        size_t offset = 0;
+        while (first < locs.size() && locs[first].buf == doc.buf + offset &&
+               offset + locs[first].len <= doc.len) {
+            offset += locs[first].len;
+            ++first;
+        }
+
+        // ... and the trailing ones which are the rest of it
+        size_t last = locs.size();
+        size_t end = doc.len;
+        while (last > first && locs[last - 1].buf >= doc.buf + offset &&
+               locs[last - 1].buf + locs[last - 1].len == doc.buf + end) {
+            end = size_t(locs[last - 1].buf - doc.buf);
+            --last;
+        }
+
+        if (offset > end) {
+            return false;
+        }
+        splices.push_back({offset,
+                           end,
+                           {locs.begin() + first, locs.begin() + last}});
+    }
+
+    std::stable_sort(splices.begin(),
+                     splices.end(),
+                     [](const Splice& a, const Splice& b) {
+                         return a.offset < b.offset;
+                     });
+
+    // The regions must be disjoint. Regions which touch are fine, unless
+    // one of them is an insertion (which could go on either side).
+    size_t length = doc.len;
+    for (size_t ii = 0; ii < splices.size(); ++ii) {
+        const auto& s = splices[ii];
+        if (ii > 0) {
+            const auto& prev = splices[ii - 1];
+            if (prev.end > s.offset ||
+                (prev.end == s.offset &&
+                 (prev.offset == prev.end || s.offset == s.end))) {
+                return false;
+            }
+        }
+        length -= s.end - s.offset;
+        for (const auto& piece : s.content) {
+            length += piece.len;
+        }
+    }
+
+    // Allocate an extra byte to make sure we can zero term it (as the
+    // sequential path does)
+    std::unique_ptr<char[]> buffer(new char[length + 1]);
+    buffer[length] = '\0';
+
+    char* out = buffer.get();
+    size_t from = 0;
+    for (const auto& s : splices) {
+        std::memcpy(out, doc.buf + from, s.offset - from);
+        out += s.offset - from;
+        for (const auto& piece : s.content) {
+            std::memcpy(out, piece.buf, piece.len);
+            out += piece.len;
+        }
+        from = s.end;
+    }
+    std::memcpy(out, doc.buf + from, doc.len - from);
+
+    newdoc.swap(buffer);
+    newlen = length;
+    return true;
+}
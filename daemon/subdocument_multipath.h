@@ -0,0 +1,124 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/sized_buffer.h>
+#include <subdoc/operations.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Looks up many paths of a JSON document in a single pass over it, rather
+ * than running a subjson operation (which parses the document up to the
+ * match) for each of them.
+ *
+ * Only paths made of plain dictionary keys (no backticks or escapes) and
+ * non-negative array indices are handled, and only successful lookups are
+ * reported: a path which doesn't exist, runs into a value of the wrong
+ * type or isn't handled is left unresolved, for the caller to look up with
+ * subjson (which knows how to report the error).
+ */
+class SubdocMultiPathLookup {
+public:
+    /// Max depth (of a path, or of the document scanned)
+    static const size_t maxDepth = 32;
+
+    /// Max number of paths
+    static const size_t maxPaths = 64;
+
+    /**
+     * Add a path to look up.
+     *
+     * @return false if the path isn't handled (and wasn't added)
+     */
+    bool addPath(cb::const_char_buffer path);
+
+    /**
+     * Look up all of the paths added in one pass over the document, which
+     * must be valid JSON. The scan stops as soon as all of them have been
+     * resolved.
+     */
+    void execute(cb::const_char_buffer doc);
+
+    /**
+     * Get the value (as subjson would match it) of the n'th path added, or
+     * {nullptr, 0} if it wasn't resolved.
+     */
+    cb::const_char_buffer getMatch(size_t index) const {
+        return paths[index].match;
+    }
+
+    size_t size() const {
+        return paths.size();
+    }
+
+private:
+    struct Component {
+        cb::const_char_buffer key;
+        size_t index;
+        bool isIndex;
+    };
+
+    struct Path {
+        size_t first;
+        size_t count;
+        cb::const_char_buffer match;
+    };
+
+    const Component& component(size_t path, size_t depth) const {
+        return components[paths[path].first + depth];
+    }
+
+    const char* scanValue(const char* p, size_t depth, uint64_t active);
+    const char* scanObject(const char* p, size_t depth, uint64_t active);
+    const char* scanArray(const char* p, size_t depth, uint64_t active);
+    const char* skipValue(const char* p, size_t depth);
+
+    std::vector<Component> components;
+    std::vector<Path> paths;
+
+    const char* end = nullptr;
+    /// Paths which are still to be resolved
+    uint64_t pending = 0;
+};
+
+/**
+ * Merge the results of mutations which were each applied (by subjson) to
+ * the same, original document into one new document, as if they had been
+ * applied one after the other. This is the case when every mutation
+ * rewrote a separate region of the document: each result is then a splice
+ * of it (the document up to the region, the new content, and the rest of
+ * the document), and the splices may be applied in one go.
+ *
+ * Whether the mutations depend on each other in a way that doesn't show as
+ * overlapping regions (such as a mutation of an array element by index
+ * after an insertion into the array) is for the caller to rule out.
+ *
+ * @param doc the document the mutations were applied to
+ * @param results the subjson results of the mutations
+ * @param newdoc where to store the new document
+ * @param newlen where to store the length of the new document
+ * @return false if the regions overlap (or a result isn't a splice of the
+ *         document), in which case the mutations must be applied in turn
+ * @throws std::bad_alloc if allocation fails
+ */
+bool subdoc_merge_splices(cb::const_char_buffer doc,
+                          const std::vector<const Subdoc::Result*>& results,
+                          std::unique_ptr<char[]>& newdoc,
+                          size_t& newlen);
@@ -20,6 +20,12 @@
 #include <platform/strerror.h>
 #include <queue>
 #include <memory>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 #define ITEMS_PER_ALLOC 64
 
@@ -153,6 +159,32 @@ bool create_notification_pipe(LIBEVENT_THREAD *me)
     return true;
 }
 
+/*
+ * Create the channel other threads use to wake up a worker thread. On Linux
+ * this is an eventfd (stored in both notify[0] and notify[1]): a wakeup is
+ * a single counter update rather than a byte queued on a socket, and the
+ * thread consumes any number of them with one read. Elsewhere it is a
+ * socketpair as for the dispatcher.
+ */
+static bool create_worker_notification_channel(LIBEVENT_THREAD* me) {
+#ifdef __linux__
+    const int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd != -1) {
+        me->notify[0] = me->notify[1] = efd;
+        return true;
+    }
+    log_system_error(EXTENSION_LOG_WARNING, NULL,
+                     "Can't create eventfd, using notify pipe: %s");
+#endif
+    return create_notification_pipe(me);
+}
+
+#ifdef __linux__
+static bool is_eventfd(const LIBEVENT_THREAD* me) {
+    return me->notify[0] == me->notify[1];
+}
+#endif
+
 static void setup_dispatcher(struct event_base *main_base,
                              void (*dispatcher_callback)(evutil_socket_t, short, void *))
 {
@@ -198,6 +230,7 @@ static void setup_thread(LIBEVENT_THREAD *me) {
 
     try {
         me->new_conn_queue = new ConnectionQueue;
+        me->notifications.reset(new ConnectionNotificationQueue);
     } catch (const std::bad_alloc&) {
         FATAL_ERROR(EXIT_FAILURE, "Failed to allocate memory for connection queue");
     }
@@ -245,8 +278,22 @@ static int number_of_pending(Connection *c, Connection *list) {
     return rv;
 }
 
-static void drain_notification_channel(evutil_socket_t fd)
+static void drain_notification_channel(LIBEVENT_THREAD* me,
+                                       evutil_socket_t fd)
 {
+#ifdef __linux__
+    if (is_eventfd(me)) {
+        // A single read resets the eventfd counter, however many times
+        // we've been notified.
+        uint64_t count;
+        if (read(fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+            log_system_error(EXTENSION_LOG_WARNING, NULL,
+                             "Can't read from notify eventfd: %s");
+        }
+        return;
+    }
+#endif
+
     /* Every time we want to notify a thread, we send 1 byte to its
      * notification pipe. When the thread wakes up, it tries to drain
      * it's notification channel before executing any other events.
@@ -269,6 +316,95 @@ static void drain_notification_channel(evutil_socket_t fd)
     }
 }
 
+/*
+ * Move one of this thread's connections to the thread the rebalancer asked
+ * us to (if any). Must be called without holding the thread lock; the
+ * connection's event is removed from our event base, which is only safe
+ * from our own thread.
+ */
+static void migrate_connection(LIBEVENT_THREAD* me) {
+    const int target = me->migrate_to.exchange(-1);
+    if (target < 0 || target >= nthreads || target == me->index) {
+        return;
+    }
+    LIBEVENT_THREAD* dest = threads + target;
+
+    // Measure each connection's load since the last time we looked, and
+    // pick the busiest one which fits within the allowance (moving more
+    // than half the imbalance would just make the target the busiest).
+    // This is done before taking the thread locks: iterating takes the
+    // connections mutex, which must never be acquired while holding two
+    // thread locks (see LOCK_THREAD). Only this thread releases its
+    // connections, so the candidate stays valid until we're done.
+    const auto now = ProcessClock::now();
+    const bool haveMarks =
+            me->balance_mark_time.time_since_epoch().count() != 0;
+    const auto window = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - me->balance_mark_time);
+    const uint64_t allowance = me->migrate_allowance.load();
+    McbpConnection* candidate = nullptr;
+    uint64_t candidateLoad = 0;
+    iterate_thread_connections(me, [&](Connection& c) {
+        const auto cpu = c.getTotalCpuTime();
+        const auto used = cpu - c.getBalanceCpuMark();
+        c.setBalanceCpuMark(cpu);
+        if (!haveMarks || window.count() <= 0) {
+            return;
+        }
+        auto* mcbp = dynamic_cast<McbpConnection*>(&c);
+        if (mcbp == nullptr || !mcbp->isMigratable()) {
+            return;
+        }
+        const uint64_t load = used.count() * 1000 / window.count();
+        if (load > candidateLoad && load <= allowance) {
+            candidate = mcbp;
+            candidateLoad = load;
+        }
+    });
+    me->balance_mark_time = now;
+
+    if (candidate == nullptr) {
+        return;
+    }
+
+    // Lock the two threads in index order (see LOCK_THREAD)
+    LIBEVENT_THREAD* first = (me->index < dest->index) ? me : dest;
+    LIBEVENT_THREAD* second = (me->index < dest->index) ? dest : me;
+    LOCK_THREAD(first);
+    LOCK_THREAD(second);
+
+    // Someone may have notified (or taken a reference to) the connection
+    // since we picked it
+    if (candidate->isMigratable()) {
+        const bool moved = candidate->migrateTo(*dest);
+        auto* owner = candidate->getThread();
+        if (owner == dest) {
+            --me->num_connections;
+            ++dest->num_connections;
+        }
+        if (moved) {
+            ++me->migrated_out;
+            ++dest->migrated_in;
+            LOG_INFO(candidate,
+                     "%u: Moved connection from worker thread %d to %d "
+                     "(load %" PRIu64 " permille)",
+                     candidate->getId(),
+                     me->index,
+                     dest->index,
+                     candidateLoad);
+        } else {
+            // Have the owning thread run the connection (and close it)
+            candidate->setState(McbpStateMachine::State::closing);
+            if (add_conn_to_pending_io_list(candidate)) {
+                notify_thread(owner);
+            }
+        }
+    }
+
+    UNLOCK_THREAD(second);
+    UNLOCK_THREAD(first);
+}
+
 void dispatch_new_connections(LIBEVENT_THREAD* me) {
     std::unique_ptr<ConnectionQueueItem> item;
     while ((item = me->new_conn_queue->pop()) != nullptr) {
@@ -293,7 +429,8 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
     // tries to notify us while we're doing the work below (so we don't have
     // to care about race conditions for stuff people try to notify us
     // about.
-    drain_notification_channel(fd);
+    drain_notification_channel(me, fd);
+    ++me->num_wakeups;
 
     if (memcached_shutdown) {
         // Someone requested memcached to shut down. The listen thread should
@@ -312,8 +449,10 @@ static void thread_libevent_process(evutil_socket_t fd, short which, void *arg)
     }
 
     dispatch_new_connections(me);
+    migrate_connection(me);
 
     LOCK_THREAD(me);
+    drain_notifications(me);
     Connection* pending = me->pending_io;
     me->pending_io = NULL;
     while (pending != NULL) {
@@ -432,35 +571,88 @@ void notify_io_complete(gsl::not_null<const void*> void_cookie,
             "notify_io_complete: connection should be bound to a thread");
     }
 
-    int notify;
-
     LOG_DEBUG(NULL,
               "Got notify from %u, status 0x%x",
               cookie->getConnection().getId(),
               status);
 
-    LOCK_THREAD(thr);
-    cookie->getConnection().setAiostat(status);
-    notify = add_conn_to_pending_io_list(&cookie->getConnection());
-    UNLOCK_THREAD(thr);
-
-    /* kick the thread in the butt */
-    if (notify) {
+    // The status is picked up by the worker thread when it drains the
+    // queue (under its lock; the state machine expects the aiostat to
+    // only change while it holds the thread lock). If the connection is
+    // already queued the new status simply replaces the old one, as
+    // setting the aiostat directly would.
+    auto& connection = cookie->getConnection();
+    connection.setNotifiedAiostat(status);
+    ++thr->num_notifications;
+
+    /* kick the thread in the butt - but only once per batch; if the queue
+     * wasn't empty the thread has already been notified */
+    if (thr->notifications->push(connection)) {
         notify_thread(thr);
     }
 }
 
+void drain_notifications(LIBEVENT_THREAD* thr) {
+    cb_assert(thr->is_locked);
+    thr->notifications->drain([thr](Connection& c) {
+        cb_assert(c.getThread() == thr);
+        auto* mcbp = dynamic_cast<McbpConnection*>(&c);
+        if (mcbp != nullptr) {
+            mcbp->setAiostat(c.getNotifiedAiostat());
+        }
+        add_conn_to_pending_io_list(&c);
+    });
+}
+
 /* Which thread we assigned a connection to most recently. */
 static int last_thread = -1;
 
+/*
+ * Estimated load (permille) a new connection adds to a thread; updated
+ * every clock tick. Only used by the dispatcher thread.
+ */
+static uint32_t connection_load_estimate = 1;
+
+LIBEVENT_THREAD* select_least_loaded_thread(LIBEVENT_THREAD* thread_array,
+                                            int count,
+                                            int start,
+                                            uint32_t load_estimate) {
+    LIBEVENT_THREAD* best = nullptr;
+    uint64_t bestLoad = 0;
+    uint32_t bestConnections = 0;
+    for (int ii = 0; ii < count; ++ii) {
+        LIBEVENT_THREAD* thr = thread_array + ((start + ii) % count);
+        const uint64_t load =
+                thr->load.load() +
+                uint64_t(thr->dispatched_since_tick) * load_estimate;
+        const uint32_t connections = thr->num_connections.load();
+        if (best == nullptr || load < bestLoad ||
+            (load == bestLoad && connections < bestConnections)) {
+            best = thr;
+            bestLoad = load;
+            bestConnections = connections;
+        }
+    }
+    return best;
+}
+
+/*
+ * Select the worker thread to serve a new connection, starting the search
+ * after the thread we picked last time so ties go round-robin.
+ */
+static LIBEVENT_THREAD* select_worker_thread() {
+    return select_least_loaded_thread(
+            threads, nthreads, last_thread + 1, connection_load_estimate);
+}
+
 /*
  * Dispatches a new connection to another thread. This is only ever called
  * from the main thread, or because of an incoming connection.
  */
 void dispatch_conn_new(SOCKET sfd, int parent_port) {
-    int tid = (last_thread + 1) % settings.getNumWorkerThreads();
-    LIBEVENT_THREAD* thread = threads + tid;
-    last_thread = tid;
+    LIBEVENT_THREAD* thread = select_worker_thread();
+    last_thread = thread->index;
+    ++thread->dispatched_since_tick;
 
     try {
         std::unique_ptr<ConnectionQueueItem> item(
@@ -489,6 +681,84 @@ void notify_dispatcher(void) {
     notify_thread(&dispatcher_thread);
 }
 
+void threads_rebalance(void) {
+    static ProcessClock::time_point last_tick;
+    const auto now = ProcessClock::now();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - last_tick);
+    const bool first = last_tick.time_since_epoch().count() == 0;
+    last_tick = now;
+    if (first || elapsed.count() <= 0) {
+        for (int ii = 0; ii < nthreads; ++ii) {
+            threads[ii].last_busy_time = threads[ii].busy_time.load();
+        }
+        return;
+    }
+
+    // Update the load of each thread (the average of the previous load
+    // and the fraction of the last interval spent busy).
+    uint64_t total_load = 0;
+    uint64_t total_connections = 0;
+    LIBEVENT_THREAD* busiest = nullptr;
+    LIBEVENT_THREAD* idlest = nullptr;
+    for (int ii = 0; ii < nthreads; ++ii) {
+        LIBEVENT_THREAD* thr = threads + ii;
+        const uint64_t busy = thr->busy_time.load();
+        const uint64_t sample = std::min(
+                uint64_t(1000),
+                (busy - thr->last_busy_time) * 1000 / elapsed.count());
+        thr->last_busy_time = busy;
+        thr->dispatched_since_tick = 0;
+        const uint32_t load = uint32_t((thr->load.load() + sample) / 2);
+        thr->load.store(load);
+
+        total_load += load;
+        total_connections += thr->num_connections.load();
+        if (busiest == nullptr || load > busiest->load.load()) {
+            busiest = thr;
+        }
+        if (idlest == nullptr || load < idlest->load.load()) {
+            idlest = thr;
+        }
+    }
+    connection_load_estimate = uint32_t(std::max(
+            uint64_t(1), total_load / std::max(uint64_t(1), total_connections)));
+
+    const uint64_t threshold = settings.getConnectionRebalanceThreshold() * 10;
+    if (threshold == 0 || busiest == nullptr || busiest == idlest ||
+        busiest->num_connections.load() < 2) {
+        return;
+    }
+
+    const uint32_t imbalance = busiest->load.load() - idlest->load.load();
+    if (imbalance >= threshold) {
+        busiest->migrate_allowance.store(imbalance / 2);
+        int expected = -1;
+        if (busiest->migrate_to.compare_exchange_strong(expected,
+                                                        idlest->index)) {
+            notify_thread(busiest);
+        }
+    }
+}
+
+std::vector<WorkerThreadLoad> threads_get_load(void) {
+    std::vector<WorkerThreadLoad> ret;
+    ret.reserve(nthreads);
+    for (int ii = 0; ii < nthreads; ++ii) {
+        const LIBEVENT_THREAD& thr = threads[ii];
+        ret.push_back({thr.index,
+                       thr.num_connections.load(),
+                       thr.load.load(),
+                       thr.busy_time.load(),
+                       thr.num_events.load(),
+                       thr.migrated_in.load(),
+                       thr.migrated_out.load(),
+                       thr.num_notifications.load(),
+                       thr.num_wakeups.load()});
+    }
+    return ret;
+}
+
 /******************************* GLOBAL STATS ******************************/
 
 void threadlocal_stats_reset(std::vector<thread_stats>& thread_stats) {
@@ -526,10 +796,11 @@ void thread_init(int nthr, struct event_base *main_base,
     setup_dispatcher(main_base, dispatcher_callback);
 
     for (i = 0; i < nthreads; i++) {
-        if (!create_notification_pipe(&threads[i])) {
+        if (!create_worker_notification_channel(&threads[i])) {
             FATAL_ERROR(EXIT_FAILURE, "Cannot create notification pipe");
         }
         threads[i].index = i;
+        threads[i].migrate_to = -1;
 
         setup_thread(&threads[i]);
     }
@@ -563,9 +834,17 @@ void threads_cleanup(void)
 {
     int ii;
     for (ii = 0; ii < nthreads; ++ii) {
-        safe_close(threads[ii].notify[0]);
-        safe_close(threads[ii].notify[1]);
+#ifdef __linux__
+        if (is_eventfd(&threads[ii])) {
+            close(threads[ii].notify[0]);
+        } else
+#endif
+        {
+            safe_close(threads[ii].notify[0]);
+            safe_close(threads[ii].notify[1]);
+        }
         event_base_free(threads[ii].base);
+        threads[ii].notifications.reset();
         threads[ii].read.reset();
         threads[ii].write.reset();
         subdoc_op_free(threads[ii].subdoc_op);
@@ -606,6 +885,17 @@ void threads_initiate_bucket_deletion(void)
 }
 
 void notify_thread(LIBEVENT_THREAD *thread) {
+#ifdef __linux__
+    if (is_eventfd(thread)) {
+        const uint64_t one = 1;
+        if (write(thread->notify[1], &one, sizeof(one)) == -1 &&
+            errno != EAGAIN) {
+            log_system_error(EXTENSION_LOG_WARNING, NULL,
+                             "Failed to notify thread: %s");
+        }
+        return;
+    }
+#endif
     if (send(thread->notify[1], "", 1, 0) != 1 &&
             !is_blocking(GetLastNetworkError())) {
         log_socket_error(EXTENSION_LOG_WARNING, NULL,
@@ -4,12 +4,15 @@
  *
  */
 #include "config.h"
+#include <array>
+#include <atomic>
 #include <fcntl.h>
 #include <errno.h>
 #include <mutex>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <platform/cacheline_padded.h>
 #include <platform/platform.h>
 #include <platform/crc32c.h>
 #include <platform/strerror.h>
@@ -20,13 +23,34 @@
 #define hashsize(n) ((size_t)1<<(n))
 #define hashmask(n) (hashsize(n)-1)
 
+/*
+ * The hashtable is protected by ASSOC_LOCK_STRIPES locks rather than one
+ * lock for the whole table; a bucket is covered by the stripe given by the
+ * low bits of the hash. The stripe count must not exceed the size of the
+ * table before its first expansion, so that a key's bucket in both the old
+ * and the new table (during expansion) is covered by the same stripe.
+ */
+#define ASSOC_LOCK_STRIPES 1024
+#define ASSOC_LOCK_STRIPE_BITS 10
+#define ASSOC_INITIAL_HASHPOWER 16
+#define stripe_of(hash) ((hash) & (ASSOC_LOCK_STRIPES - 1))
+
+static_assert(hashsize(ASSOC_LOCK_STRIPE_BITS) == ASSOC_LOCK_STRIPES,
+              "ASSOC_LOCK_STRIPE_BITS must match ASSOC_LOCK_STRIPES");
+static_assert(ASSOC_LOCK_STRIPE_BITS < ASSOC_INITIAL_HASHPOWER,
+              "Too many lock stripes for the initial hashtable size");
+
 struct Assoc {
     Assoc(unsigned int hp) : hashpower(hp) {
         primary_hashtable.resize(hashsize(hashpower));
+        expand_bucket.fill(0);
     }
 
-    /* how many powers of 2's worth of buckets we use */
-    unsigned int hashpower;
+    /*
+     * how many powers of 2's worth of buckets we use. Only changed with
+     * all of the stripe locks held.
+     */
+    std::atomic<unsigned int> hashpower;
 
 
     /* Main hash table. This is where we look except during expansion. */
@@ -39,21 +63,29 @@ struct Assoc {
     std::vector<hash_item*> old_hashtable;
 
     /* Number of items in the hash table. */
-    unsigned int hash_items{0};
+    std::atomic<unsigned int> hash_items{0};
 
     /* Flag: Are we in the middle of expanding now? */
-    bool expanding{false};
+    std::atomic<bool> expanding{false};
 
     /*
-     * During expansion we migrate values with bucket granularity; this is how
-     * far we've gotten so far. Ranges from 0 .. hashsize(hashpower - 1) - 1.
+     * During expansion we migrate values stripe by stripe, with bucket
+     * granularity within a stripe; this is how far we've gotten so far in
+     * each stripe, counted in the stripe's buckets of the old table (old
+     * bucket b is bucket b >> ASSOC_LOCK_STRIPE_BITS of stripe
+     * stripe_of(b)). Protected by the stripe's lock.
      */
-    unsigned int expand_bucket{0};
+    std::array<unsigned int, ASSOC_LOCK_STRIPES> expand_bucket;
 
     /*
-     * serialise access to the hashtable
+     * serialise access to the buckets covered by each stripe
      */
-    std::mutex mutex;
+    std::array<cb::CachelinePadded<std::mutex>, ASSOC_LOCK_STRIPES> stripes;
+
+    /*
+     * serialise starting and finishing an expansion
+     */
+    std::mutex expand_mutex;
 };
 
 /* One hashtable for all */
@@ -74,7 +106,7 @@ ENGINE_ERROR_CODE assoc_init(struct default_engine *engine) {
         construct and save away one assoc for use by all buckets.
     */
     if (global_assoc == nullptr) {
-        global_assoc = assoc_consruct(16);
+        global_assoc = assoc_consruct(ASSOC_INITIAL_HASHPOWER);
         if (engine != nullptr) {
             logger = static_cast<EXTENSION_LOGGER_DESCRIPTOR*>
             (engine->server.extension->get_extension(EXTENSION_LOGGER));
@@ -93,19 +125,41 @@ void assoc_destroy() {
     }
 }
 
+static void assoc_lock_all_stripes() {
+    for (auto& stripe : global_assoc->stripes) {
+        stripe->lock();
+    }
+}
+
+static void assoc_unlock_all_stripes() {
+    for (auto it = global_assoc->stripes.rbegin();
+         it != global_assoc->stripes.rend(); ++it) {
+        (*it)->unlock();
+    }
+}
+
+/*
+    returns the address of the bucket the hash maps to (in the old table if
+    the bucket hasn't been migrated yet).
+    the lock for stripe_of(hash) is assumed to be held by the caller.
+*/
+static hash_item** _hashbucket(uint32_t hash) {
+    if (global_assoc->expanding) {
+        const unsigned int oldbucket = hash & hashmask(global_assoc->hashpower - 1);
+        if ((oldbucket >> ASSOC_LOCK_STRIPE_BITS) >=
+            global_assoc->expand_bucket[stripe_of(hash)]) {
+            return &global_assoc->old_hashtable[oldbucket];
+        }
+    }
+    return &global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
+}
+
 hash_item *assoc_find(uint32_t hash, const hash_key *key) {
     hash_item *it;
-    unsigned int oldbucket;
     hash_item *ret = NULL;
     int depth = 0;
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
-    {
-        it = global_assoc->old_hashtable[oldbucket];
-    } else {
-        it = global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
-    }
+    std::lock_guard<std::mutex> guard(*global_assoc->stripes[stripe_of(hash)]);
+    it = *_hashbucket(hash);
 
     while (it) {
         const hash_key* it_key = item_get_key(it);
@@ -126,19 +180,10 @@ hash_item *assoc_find(uint32_t hash, const hash_key *key) {
 /*
     returns the address of the item pointer before the key.  if *item == 0,
     the item wasn't found
-    assoc->lock is assumed to be held by the caller.
+    the lock for stripe_of(hash) is assumed to be held by the caller.
 */
 static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
-    hash_item **pos;
-    unsigned int oldbucket;
-
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
-    {
-        pos = &global_assoc->old_hashtable[oldbucket];
-    } else {
-        pos = &global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
-    }
+    hash_item **pos = _hashbucket(hash);
 
     while (*pos) {
         const hash_key* pos_key = item_get_key(*pos);
@@ -157,17 +202,31 @@ static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
 
 static void assoc_maintenance_thread(void *arg);
 
+static bool assoc_needs_expand() {
+    return !global_assoc->expanding &&
+           global_assoc->hash_items > (hashsize(global_assoc->hashpower) * 3) / 2;
+}
+
 /*
     grows the hashtable to the next power of 2.
-    assoc->lock is assumed to be held by the caller.
+    takes all of the stripe locks while swapping the tables, so none of them
+    may be held by the caller.
 */
 static void assoc_expand() {
+    std::lock_guard<std::mutex> guard(global_assoc->expand_mutex);
+    if (!assoc_needs_expand()) {
+        /* Someone else got here first */
+        return;
+    }
+
+    assoc_lock_all_stripes();
     global_assoc->old_hashtable.swap(global_assoc->primary_hashtable);
 
     try {
         global_assoc->primary_hashtable.resize(hashsize(global_assoc->hashpower + 1));
     } catch (const std::bad_alloc&) {
         global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
+        assoc_unlock_all_stripes();
         /* Bad news, but we can keep running. */
         return;
     }
@@ -177,9 +236,12 @@ static void assoc_expand() {
 
     global_assoc->hashpower++;
     global_assoc->expanding = true;
-    global_assoc->expand_bucket = 0;
+    global_assoc->expand_bucket.fill(0);
 
-    /* start a thread to do the expansion */
+    /*
+     * start a thread to do the expansion. It blocks on the first stripe
+     * until we've released the locks.
+     */
     if ((ret = cb_create_named_thread(&tid, assoc_maintenance_thread,
                                       nullptr, 1, "mc:assoc_maint")) != 0)
     {
@@ -193,35 +255,30 @@ static void assoc_expand() {
         global_assoc->old_hashtable.resize(0);
         global_assoc->old_hashtable.shrink_to_fit();
     }
+    assoc_unlock_all_stripes();
 }
 
 /* Note: this isn't an assoc_update.  The key must not already exist to call this */
 int assoc_insert(uint32_t hash, hash_item *it) {
-    unsigned int oldbucket;
-
     cb_assert(assoc_find(hash, item_get_key(it)) == 0);  /* shouldn't have duplicately named things defined */
 
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
     {
-        it->h_next = global_assoc->old_hashtable[oldbucket];
-        global_assoc->old_hashtable[oldbucket] = it;
-    } else {
-        it->h_next = global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
-        global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)] = it;
+        std::lock_guard<std::mutex> guard(*global_assoc->stripes[stripe_of(hash)]);
+        hash_item** bucket = _hashbucket(hash);
+        it->h_next = *bucket;
+        *bucket = it;
+        global_assoc->hash_items++;
     }
 
-    global_assoc->hash_items++;
-    if (! global_assoc->expanding && global_assoc->hash_items > (hashsize(global_assoc->hashpower) * 3) / 2) {
+    if (assoc_needs_expand()) {
         assoc_expand();
     }
-    MEMCACHED_ASSOC_INSERT(hash_key_get_key(item_get_key(it)), hash_key_get_key_len(item_get_key(it)), global_assoc->hash_items);
+    MEMCACHED_ASSOC_INSERT(hash_key_get_key(item_get_key(it)), hash_key_get_key_len(item_get_key(it)), global_assoc->hash_items.load());
     return 1;
 }
 
 void assoc_delete(uint32_t hash, const hash_key *key) {
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
+    std::lock_guard<std::mutex> guard(*global_assoc->stripes[stripe_of(hash)]);
     hash_item **before = _hashitem_before(hash, key);
 
     if (*before) {
@@ -232,7 +289,7 @@ void assoc_delete(uint32_t hash, const hash_key *key) {
          */
         MEMCACHED_ASSOC_DELETE(hash_key_get_key(key),
                                hash_key_get_key_len(key),
-                               global_assoc->hash_items);
+                               global_assoc->hash_items.load());
         nxt = (*before)->h_next;
         (*before)->h_next = 0;   /* probably pointless, but whatever. */
         *before = nxt;
@@ -249,45 +306,63 @@ void assoc_delete(uint32_t hash, const hash_key *key) {
 int hash_bulk_move = DEFAULT_HASH_BULK_MOVE;
 
 static void assoc_maintenance_thread(void *arg) {
-    bool done = false;
-    do {
-        int ii;
-        std::lock_guard<std::mutex> guard(global_assoc->mutex);
-
-        for (ii = 0; ii < hash_bulk_move && global_assoc->expanding; ++ii) {
-            hash_item *it, *next;
-            int bucket;
-
-            for (it = global_assoc->old_hashtable[global_assoc->expand_bucket];
-                 NULL != it; it = next) {
-                next = it->h_next;
-                const hash_key* key = item_get_key(it);
-                bucket = crc32c(hash_key_get_key(key),
-                                hash_key_get_key_len(key),
-                                0) & hashmask(global_assoc->hashpower);
-                it->h_next = global_assoc->primary_hashtable[bucket];
-                global_assoc->primary_hashtable[bucket] = it;
-            }
-
-            global_assoc->old_hashtable[global_assoc->expand_bucket] = NULL;
-            global_assoc->expand_bucket++;
-            if (global_assoc->expand_bucket == hashsize(global_assoc->hashpower - 1)) {
-                global_assoc->expanding = false;
-                global_assoc->old_hashtable.resize(0);
-                global_assoc->old_hashtable.shrink_to_fit();
-                if (logger != nullptr) {
-                    logger->log(EXTENSION_LOG_INFO, NULL,
-                                "Hash table expansion done");
+    /*
+     * Migrate one stripe at a time, taking only that stripe's lock (and
+     * only for hash_bulk_move buckets at a time) so lookups in the other
+     * stripes carry on unhindered. The stripe of an old bucket and of
+     * both of the new buckets it splits into is the same.
+     */
+    for (unsigned int stripe = 0; stripe < ASSOC_LOCK_STRIPES; ++stripe) {
+        bool done = false;
+        do {
+            int ii;
+            std::lock_guard<std::mutex> guard(*global_assoc->stripes[stripe]);
+            const size_t stripe_buckets =
+                    hashsize(global_assoc->hashpower - 1) >> ASSOC_LOCK_STRIPE_BITS;
+
+            for (ii = 0; ii < hash_bulk_move && !done; ++ii) {
+                hash_item *it, *next;
+                int bucket;
+                const size_t oldbucket =
+                        (size_t(global_assoc->expand_bucket[stripe]) << ASSOC_LOCK_STRIPE_BITS) |
+                        stripe;
+
+                for (it = global_assoc->old_hashtable[oldbucket];
+                     NULL != it; it = next) {
+                    next = it->h_next;
+                    const hash_key* key = item_get_key(it);
+                    bucket = crc32c(hash_key_get_key(key),
+                                    hash_key_get_key_len(key),
+                                    0) & hashmask(global_assoc->hashpower);
+                    it->h_next = global_assoc->primary_hashtable[bucket];
+                    global_assoc->primary_hashtable[bucket] = it;
                 }
+
+                global_assoc->old_hashtable[oldbucket] = NULL;
+                global_assoc->expand_bucket[stripe]++;
+                done = global_assoc->expand_bucket[stripe] == stripe_buckets;
             }
-        }
-        if (!global_assoc->expanding) {
-            done = true;
-        }
-    } while (!done);
+        } while (!done);
+    }
+
+    /*
+     * Every stripe now looks in the primary table only, so the old table
+     * may be released without the stripe locks.
+     */
+    std::lock_guard<std::mutex> guard(global_assoc->expand_mutex);
+    global_assoc->old_hashtable.resize(0);
+    global_assoc->old_hashtable.shrink_to_fit();
+    global_assoc->expanding = false;
+    if (logger != nullptr) {
+        logger->log(EXTENSION_LOG_INFO, NULL,
+                    "Hash table expansion done");
+    }
 }
 
 bool assoc_expanding() {
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
     return global_assoc->expanding;
 }
+
+unsigned int assoc_hashpower() {
+    return global_assoc->hashpower;
+}
@@ -8,4 +8,5 @@ hash_item *assoc_find(uint32_t hash, const hash_key* key);
 int assoc_insert(uint32_t hash, hash_item *item);
 void assoc_delete(uint32_t hash, const hash_key* key);
 bool assoc_expanding();
+unsigned int assoc_hashpower();
 #endif
@@ -15,15 +15,26 @@
  *   limitations under the License.
  */
 
+/*
+ * Benchmarks of the memcached bucket's hashtable (assoc.cc), run with 1 to
+ * 16 threads to show how lookups, inserts and deletes scale with the number
+ * of threads accessing the (lock striped) table.
+ */
+
 #include "items.h"
 #include "assoc.h"
 
 #include <platform/crc32c.h>
 #include <benchmark/benchmark.h>
 #include <random>
+#include <utility>
+#include <vector>
 
 const uint32_t max_items = 100000;
 
+/* Number of private keys each thread inserts and deletes */
+const uint32_t keys_per_thread = 1000;
+
 hash_key* item_get_key(const hash_item* item) {
     const char *ret = reinterpret_cast<const char*>(item + 1);
     return (hash_key*)ret;
@@ -77,6 +88,34 @@ hash_item *item_alloc(uint32_t key) {
     return it;
 }
 
+static uint32_t item_hash(const hash_item* it) {
+    const hash_key* key = item_get_key(it);
+    return crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0);
+}
+
+/*
+ * Allocate the keys private to the calling thread, numbered after the keys
+ * the cache is populated with.
+ */
+static std::vector<std::pair<uint32_t, hash_item*>> thread_items_alloc(
+        const benchmark::State& state) {
+    std::vector<std::pair<uint32_t, hash_item*>> items;
+    const uint32_t first = max_items + state.thread_index * keys_per_thread;
+    for (uint32_t ii = 0; ii < keys_per_thread; ++ii) {
+        auto* it = item_alloc(first + ii);
+        items.emplace_back(item_hash(it), it);
+    }
+    return items;
+}
+
+static void thread_items_free(
+        std::vector<std::pair<uint32_t, hash_item*>>& items) {
+    for (auto& entry : items) {
+        free(static_cast<void*>(entry.second));
+    }
+    items.clear();
+}
+
 void AccessSingleItem(benchmark::State& state) {
     hash_key hkey;
     hash_key_create(&hkey, 0);
@@ -87,6 +126,7 @@ void AccessSingleItem(benchmark::State& state) {
             throw std::logic_error("AccessSingleItem: Expected to find key");
         }
     }
+    state.SetItemsProcessed(state.iterations());
 }
 
 void AccessRandomItems(benchmark::State& state) {
@@ -104,10 +144,67 @@ void AccessRandomItems(benchmark::State& state) {
             throw std::logic_error("AccessRandomItems: Expected to find key");
         }
     }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Each thread inserts and deletes its own keys, so the threads only
+ * contend on the hashtable's locks.
+ */
+void InsertDeleteItems(benchmark::State& state) {
+    auto items = thread_items_alloc(state);
+    size_t next = 0;
+
+    while (state.KeepRunning()) {
+        auto& entry = items[next];
+        assoc_insert(entry.first, entry.second);
+        assoc_delete(entry.first, item_get_key(entry.second));
+        next = (next + 1) % items.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    thread_items_free(items);
+}
+
+/*
+ * A read-mostly mix: 9 out of 10 operations look up a random item, the
+ * 10th inserts and deletes one of the thread's own keys.
+ */
+void MixedAccess(benchmark::State& state) {
+    std::random_device rd;
+    std::minstd_rand0 gen(rd());
+    std::uniform_int_distribution<uint32_t> dis;
+    auto items = thread_items_alloc(state);
+    size_t next = 0;
+    uint64_t ops = 0;
+
+    while (state.KeepRunning()) {
+        if (++ops % 10 == 0) {
+            auto& entry = items[next];
+            assoc_insert(entry.first, entry.second);
+            assoc_delete(entry.first, item_get_key(entry.second));
+            next = (next + 1) % items.size();
+            continue;
+        }
+
+        uint32_t id = dis(gen) % max_items;
+        hash_key hkey;
+        hash_key_create(&hkey, id);
+        if (assoc_find(crc32c(hash_key_get_key(&hkey),
+                              hash_key_get_key_len(&hkey), 0),
+                       &hkey) == nullptr) {
+            throw std::logic_error("MixedAccess: Expected to find key");
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    thread_items_free(items);
 }
 
-BENCHMARK(AccessSingleItem)->ThreadRange(1, 16);
-BENCHMARK(AccessRandomItems)->ThreadRange(1, 16);
+BENCHMARK(AccessSingleItem)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(AccessRandomItems)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(InsertDeleteItems)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(MixedAccess)->ThreadRange(1, 16)->UseRealTime();
 
 int main(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
@@ -184,7 +184,12 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
     memset(engine, 0, sizeof(*engine));
 
     cb_mutex_initialize(&engine->slabs.lock);
-    cb_mutex_initialize(&engine->items.lock);
+    for (auto& lock : engine->items.lru_locks) {
+        cb_mutex_initialize(&lock);
+    }
+    for (auto& lock : engine->items.item_locks) {
+        cb_mutex_initialize(&lock);
+    }
     cb_mutex_initialize(&engine->stats.lock);
     cb_mutex_initialize(&engine->scrubber.lock);
 
@@ -222,6 +227,7 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
     engine->config.chunk_size = 48;
     engine->config.item_size_max= 1024 * 1024;
     engine->config.xattr_enabled = true;
+    engine->config.slab_automove = 1;
     engine->info.engine.description = "Default engine v0.1";
     engine->info.engine.num_features = 1;
     engine->info.engine.features[0].feature = ENGINE_FEATURE_LRU;
@@ -306,7 +312,12 @@ void destroy_engine_instance(struct default_engine* engine) {
         cb_free(engine->config.uuid);
 
         /* Clean up the mutexes */
-        cb_mutex_destroy(&engine->items.lock);
+        for (auto& lock : engine->items.lru_locks) {
+            cb_mutex_destroy(&lock);
+        }
+        for (auto& lock : engine->items.item_locks) {
+            cb_mutex_destroy(&lock);
+        }
         cb_mutex_destroy(&engine->stats.lock);
         cb_mutex_destroy(&engine->slabs.lock);
         cb_mutex_destroy(&engine->scrubber.lock);
@@ -642,6 +653,10 @@ static ENGINE_ERROR_CODE default_get_stats(gsl::not_null<ENGINE_HANDLE*> handle,
         len = sprintf(val, "%" PRIu64, (uint64_t)engine->config.maxbytes);
         add_stat("engine_maxbytes", 15, val, len, cookie);
         cb_mutex_exit(&engine->stats.lock);
+        len = sprintf(val, "%u", assoc_hashpower());
+        add_stat("hash_power_level", 16, val, len, cookie);
+        len = sprintf(val, "%u", assoc_expanding() ? 1 : 0);
+        add_stat("hash_is_expanding", 17, val, len, cookie);
     } else if (key == "slabs"_ccb) {
         slabs_stats(engine, add_stat, cookie);
     } else if (key == "items"_ccb) {
@@ -785,7 +800,7 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
    se->config.vb0 = true;
 
    if (cfg_str != NULL) {
-       struct config_item items[13];
+       struct config_item items[14];
        int ii = 0;
 
        memset(&items, 0, sizeof(items));
@@ -848,9 +863,14 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
        items[ii].value.dt_bool = &se->config.keep_deleted;
        ++ii;
 
+       items[ii].key = "slab_automove";
+       items[ii].datatype = DT_SIZE;
+       items[ii].value.dt_size = &se->config.slab_automove;
+       ++ii;
+
        items[ii].key = NULL;
        ++ii;
-       cb_assert(ii == 13);
+       cb_assert(ii == 14);
        ret = ENGINE_ERROR_CODE(se->server.core->parse_config(cfg_str,
                                                              items,
                                                              stderr));
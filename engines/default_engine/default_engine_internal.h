@@ -47,9 +47,12 @@ struct default_engine;
 /** The item is deleted (may only be accessed if explicitly asked for) */
 #define ITEM_ZOMBIE (4)
 
+/** The item has been accessed since the LRU maintainer last moved it */
+#define ITEM_ACTIVE (8)
+
 struct config {
    size_t verbose;
-   rel_time_t oldest_live;
+   std::atomic<rel_time_t> oldest_live;
    bool evict_to_free;
    size_t maxbytes;
    bool preallocate;
@@ -61,6 +64,8 @@ struct config {
    char *uuid;
    bool keep_deleted;
    std::atomic<bool> xattr_enabled;
+   /* slab page rebalancing: 0 off, 1 conservative, 2 aggressive */
+   size_t slab_automove;
 };
 
 /**
@@ -29,6 +29,7 @@
 
 #include <chrono>
 #include <memory>
+#include <vector>
 
 static std::unique_ptr<EngineManager> engineManager;
 
@@ -158,6 +159,23 @@ void EngineManager::notifyScrubComplete(struct default_engine* engine,
     cond.notify_one();
 }
 
+size_t EngineManager::maintainLru() {
+    std::vector<struct default_engine*> snapshot;
+    {
+        std::lock_guard<std::mutex> lck(lock);
+        if (shuttingdown) {
+            return 0;
+        }
+        snapshot.assign(engines.begin(), engines.end());
+    }
+
+    size_t moved = 0;
+    for (auto* engine : snapshot) {
+        moved += item_lru_maintainer(engine);
+    }
+    return moved;
+}
+
 EngineManager& getEngineManager() {
     static std::mutex createLock;
     if (engineManager.get() == nullptr) {
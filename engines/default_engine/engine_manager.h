@@ -69,6 +69,15 @@ public:
      */
     void notifyScrubComplete(struct default_engine* engine, bool destroy);
 
+    /**
+     * Run the LRU maintainer over all of the engines. Called by the
+     * scrubber task (which is also the one deleting engines, so the engines
+     * stay valid while being maintained).
+     *
+     * @return the number of items moved or reclaimed
+     */
+    size_t maintainLru();
+
 protected:
     /**
      * Wait for the scrubber task to be idle. You <b>must</b> hold the
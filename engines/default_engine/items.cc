@@ -7,6 +7,8 @@
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
+#include <atomic>
+#include <thread>
 
 #include <memcached/server_api.h>
 #include <platform/cb_malloc.h>
@@ -15,21 +17,24 @@
 #include "engine_manager.h"
 
 /* Forward Declarations */
-static void item_link_q(struct default_engine *engine, hash_item *it);
+static void item_link_q(struct default_engine *engine, hash_item *it,
+                        lru_segment segment);
 static void item_unlink_q(struct default_engine *engine, hash_item *it);
 static hash_item *do_item_alloc(struct default_engine *engine,
                                 const hash_key *key,
                                 const int flags, const rel_time_t exptime,
                                 const int nbytes,
                                 const void *cookie,
-                                uint8_t datatype);
+                                uint8_t datatype,
+                                cb_mutex_t *item_lock);
 static hash_item* do_item_get(struct default_engine* engine,
                               const hash_key* key,
                               const DocStateFilter document_state);
 static int do_item_link(struct default_engine *engine,
                         const void* cookie,
                         hash_item *it);
-static void do_item_unlink(struct default_engine *engine, hash_item *it);
+static void do_item_unlink(struct default_engine *engine, hash_item *it,
+                           bool lru_locked = false);
 static ENGINE_ERROR_CODE do_safe_item_unlink(struct default_engine *engine,
                                              hash_item *it);
 static void do_item_release(struct default_engine *engine, hash_item *it);
@@ -49,22 +54,79 @@ static bool hash_key_create(hash_key* hkey,
 static void hash_key_destroy(hash_key* hkey);
 static void hash_key_copy_to_item(hash_item* dst, const hash_key* src);
 
-/*
- * We only reposition items in the LRU queue if they haven't been repositioned
- * in this many seconds. That saves us from churning on frequently-accessed
- * items.
- */
-#define ITEM_UPDATE_INTERVAL 60
 /*
  * To avoid scanning through the complete cache in some circumstances we'll
  * just give up and return an error after inspecting a fixed number of objects.
  */
 static const int search_items = 50;
 
+/*
+ * The allocation path doesn't search the LRU; it only pulls this many
+ * items off the tail of each segment when it has to evict.
+ */
+static const int lru_pull_tries = 5;
+
+/* Share (in percent) of a slab class' items HOT and WARM may hold */
+static const unsigned int lru_hot_percent = 20;
+static const unsigned int lru_warm_percent = 40;
+
+/*
+ * Max number of items the LRU maintainer looks at in each segment of a
+ * slab class per pass (with the class' LRU lock held).
+ */
+static const int lru_maintainer_batch = 64;
+
 void item_stats_reset(struct default_engine *engine) {
-    cb_mutex_enter(&engine->items.lock);
-    memset(engine->items.itemstats, 0, sizeof(engine->items.itemstats));
-    cb_mutex_exit(&engine->items.lock);
+    for (int ii = 0; ii < POWER_LARGEST; ii++) {
+        cb_mutex_enter(&engine->items.lru_locks[ii]);
+        memset(&engine->items.itemstats[ii], 0,
+               sizeof(engine->items.itemstats[ii]));
+        cb_mutex_exit(&engine->items.lru_locks[ii]);
+    }
+}
+
+static uint32_t item_hash(const hash_key* key) {
+    return crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0);
+}
+
+/* The lock serialising operations on items with the given key hash */
+static cb_mutex_t* item_lock(struct default_engine *engine, uint32_t hash) {
+    return &engine->items.item_locks[hash % ITEM_LOCK_STRIPES];
+}
+
+static bool item_is_cursor(const hash_item* it) {
+    return item_get_key(it)->header.len == 0 && it->nbytes == 0;
+}
+
+/*
+ * Try to lock an item found on an LRU while holding the LRU lock (which
+ * comes after the item locks in the lock order, so we can't block on them).
+ * `held` is the item lock already held by the caller (if any); items
+ * covered by it need no further locking.
+ *
+ * Returns false if the item's lock is busy. Otherwise *taken is set to the
+ * lock acquired (or NULL), to be released with item_trylock_release().
+ */
+static bool item_trylock(struct default_engine *engine,
+                         const hash_item* it,
+                         cb_mutex_t* held,
+                         cb_mutex_t** taken) {
+    cb_mutex_t* lock = item_lock(engine, item_hash(item_get_key(it)));
+    *taken = NULL;
+    if (lock == held) {
+        return true;
+    }
+    if (cb_mutex_try_enter(lock) != 0) {
+        return false;
+    }
+    *taken = lock;
+    return true;
+}
+
+static void item_trylock_release(cb_mutex_t* taken) {
+    if (taken != NULL) {
+        cb_mutex_exit(taken);
+    }
 }
 
 
@@ -77,7 +139,7 @@ static size_t ITEM_ntotal(struct default_engine *engine,
 
 /* Get the next CAS id for a new item. */
 static uint64_t get_cas_id(void) {
-    static uint64_t cas_id = 0;
+    static std::atomic<uint64_t> cas_id{0};
     return ++cas_id;
 }
 
@@ -93,142 +155,205 @@ static uint64_t get_cas_id(void) {
 #endif
 
 
-/*@null@*/
-hash_item *do_item_alloc(struct default_engine *engine,
-                         const hash_key *key,
-                         const int flags,
-                         const rel_time_t exptime,
-                         const int nbytes,
-                         const void *cookie,
-                         uint8_t datatype) {
-    hash_item *it = NULL;
-    int tries = search_items;
-    hash_item *search;
-    rel_time_t oldest_live;
-    rel_time_t current_time;
-    unsigned int id;
+static bool item_is_reclaimable(const hash_item* it,
+                                rel_time_t oldest_live,
+                                rel_time_t current_time) {
+    return it->refcount == 0 &&
+           ((it->time < oldest_live) || /* dead by flush */
+            (it->exptime != 0 && it->exptime < current_time)) &&
+           (it->locktime <= current_time);
+}
 
-    size_t ntotal = sizeof(hash_item) + hash_key_get_alloc_size(key) + nbytes;
+/* Dead by flush_all (and not to be revived by moving it in the LRU) */
+static bool item_is_flushed(const hash_item* it,
+                            rel_time_t oldest_live,
+                            rel_time_t current_time) {
+    return oldest_live != 0 && oldest_live <= current_time &&
+           it->time <= oldest_live;
+}
 
-    if ((id = slabs_clsid(engine, ntotal)) == 0) {
-        return 0;
-    }
+/*
+ * Move an item to the head of another (or the same) segment of its slab
+ * class' LRU. Linking at the head refreshes the item's time, which keeps
+ * each segment in decreasing time order.
+ *
+ * The item's lock and the LRU lock of its class are assumed to be held.
+ */
+static void item_lru_move(struct default_engine *engine, hash_item *it,
+                          lru_segment segment) {
+    item_unlink_q(engine, it);
+    it->iflag &= ~ITEM_ACTIVE;
+    it->time = engine->server.core->get_current_time();
+    item_link_q(engine, it, segment);
+}
 
-    /* do a quick check if we have any expired items in the tail.. */
-    oldest_live = engine->config.oldest_live;
-    current_time = engine->server.core->get_current_time();
+/*
+ * Find the memory for a new item of slab class `id`: allocate from the slab
+ * allocator, evicting from the tail of the class' LRU if needed.
+ *
+ * The LRU lock of the class must be held. Expired items are reclaimed (and
+ * items moved between the segments) by the LRU maintainer, so this only
+ * looks at a few items at the tail of each segment, coldest first. The
+ * candidates are checked without their item lock (to not take it for every
+ * candidate) and then re-checked once the lock has been acquired.
+ */
+static hash_item *do_item_alloc_from_lru(struct default_engine *engine,
+                                         unsigned int id,
+                                         size_t ntotal,
+                                         const void *cookie,
+                                         cb_mutex_t *item_lock) {
+    static const lru_segment pull_order[] = {LRU_COLD, LRU_WARM, LRU_HOT};
+    hash_item *it;
+    hash_item *search, *prev;
+    cb_mutex_t *taken;
+    rel_time_t current_time;
+    int tries;
 
-    for (search = engine->items.tails[id];
-         tries > 0 && search != NULL;
-         tries--, search=search->prev) {
-        if (search->refcount == 0 &&
-            ((search->time < oldest_live) || /* dead by flush */
-             (search->exptime != 0 && search->exptime < current_time)) &&
-            (search->locktime <= current_time)) {
-            it = search;
-            /* I don't want to actually free the object, just steal
-             * the item to avoid to grab the slab mutex twice ;-)
-             */
-            cb_mutex_enter(&engine->stats.lock);
-            engine->stats.reclaimed++;
-            cb_mutex_exit(&engine->stats.lock);
-            engine->items.itemstats[id].reclaimed++;
-            it->refcount = 1;
-            slabs_adjust_mem_requested(engine, it->slabs_clsid, ITEM_ntotal(engine, it), ntotal);
-            do_item_unlink(engine, it);
-            /* Initialize the item block: */
-            it->slabs_clsid = 0;
-            it->refcount = 0;
-            break;
-        }
+    if ((it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id))) != NULL) {
+        return it;
     }
 
-    if (it == NULL &&
-        (it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id))) == NULL) {
-        /*
-        ** Could not find an expired item at the tail, and memory allocation
-        ** failed. Try to evict some items!
-        */
-        tries = search_items;
-
-        /* If requested to not push old items out of cache when memory runs out,
-         * we're out of luck at this point...
-         */
-
-        if (engine->config.evict_to_free == 0) {
-            engine->items.itemstats[id].outofmemory++;
-            return NULL;
-        }
+    /*
+    ** Memory allocation failed. Try to evict some items!
+    */
 
-        /*
-         * try to get one off the right LRU
-         * don't necessariuly unlink the tail because it may be locked: refcount>0
-         * search up from tail an item with refcount==0 and unlink it; give up after search_items
-         * tries
-         */
+    /* If requested to not push old items out of cache when memory runs out,
+     * we're out of luck at this point...
+     */
 
-        if (engine->items.tails[id] == 0) {
-            engine->items.itemstats[id].outofmemory++;
-            return NULL;
-        }
+    if (engine->config.evict_to_free == 0) {
+        engine->items.itemstats[id].outofmemory++;
+        return NULL;
+    }
 
-        for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=search->prev) {
-            if (search->refcount == 0 && search->locktime <= current_time) {
-                if (search->exptime == 0 || search->exptime > current_time) {
-                    engine->items.itemstats[id].evicted++;
-                    engine->items.itemstats[id].evicted_time = current_time - search->time;
-                    if (search->exptime != 0) {
-                        engine->items.itemstats[id].evicted_nonzero++;
-                    }
-                    cb_mutex_enter(&engine->stats.lock);
-                    engine->stats.evictions++;
-                    cb_mutex_exit(&engine->stats.lock);
-                    const hash_key* search_key = item_get_key(search);
-                    engine->server.stat->evicting(cookie,
-                                                  hash_key_get_client_key(search_key),
-                                                  hash_key_get_client_key_len(search_key));
-                } else {
-                    engine->items.itemstats[id].reclaimed++;
-                    cb_mutex_enter(&engine->stats.lock);
-                    engine->stats.reclaimed++;
-                    cb_mutex_exit(&engine->stats.lock);
+    /*
+     * try to get one off the tail of the coldest segment
+     * don't necessariuly unlink the tail because it may be locked: refcount>0
+     * look at the lru_pull_tries items at the tail for one with refcount==0
+     * and unlink it; an accessed item at the tail of COLD gets a second
+     * chance in WARM instead
+     */
+    current_time = engine->server.core->get_current_time();
+    bool evicted = false;
+    for (auto segment : pull_order) {
+        tries = lru_pull_tries;
+        for (search = engine->items.tails[id][segment];
+             !evicted && tries > 0 && search != NULL;
+             tries--, search = prev) {
+            prev = search->prev;
+            if (search->refcount != 0 || search->locktime > current_time ||
+                !item_trylock(engine, search, item_lock, &taken)) {
+                continue;
+            }
+            if (search->refcount != 0 || search->locktime > current_time) {
+                item_trylock_release(taken);
+                continue;
+            }
+            const bool expired = search->exptime != 0 &&
+                                 search->exptime <= current_time;
+            if (segment == LRU_COLD && !expired &&
+                (search->iflag & ITEM_ACTIVE) != 0 &&
+                !item_is_flushed(search, engine->config.oldest_live,
+                                 current_time)) {
+                item_lru_move(engine, search, LRU_WARM);
+                engine->items.itemstats[id].moves_to_warm++;
+                item_trylock_release(taken);
+                continue;
+            }
+            if (!expired) {
+                engine->items.itemstats[id].evicted++;
+                engine->items.itemstats[id].evicted_time = current_time - search->time;
+                if (search->exptime != 0) {
+                    engine->items.itemstats[id].evicted_nonzero++;
                 }
-                do_item_unlink(engine, search);
-                break;
+                cb_mutex_enter(&engine->stats.lock);
+                engine->stats.evictions++;
+                cb_mutex_exit(&engine->stats.lock);
+                const hash_key* search_key = item_get_key(search);
+                engine->server.stat->evicting(cookie,
+                                              hash_key_get_client_key(search_key),
+                                              hash_key_get_client_key_len(search_key));
+            } else {
+                engine->items.itemstats[id].reclaimed++;
+                cb_mutex_enter(&engine->stats.lock);
+                engine->stats.reclaimed++;
+                cb_mutex_exit(&engine->stats.lock);
             }
+            do_item_unlink(engine, search, true);
+            item_trylock_release(taken);
+            evicted = true;
         }
-        it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
-        if (it == 0) {
-            engine->items.itemstats[id].outofmemory++;
-            /* Last ditch effort. There is a very rare bug which causes
-             * refcount leaks. We've fixed most of them, but it still happens,
-             * and it may happen in the future.
-             * We can reasonably assume no item can stay locked for more than
-             * three hours, so if we find one in the tail which is that old,
-             * free it anyway.
-             */
+        if (evicted) {
+            break;
+        }
+    }
+
+    if (!evicted &&
+        engine->items.tails[id][LRU_HOT] == NULL &&
+        engine->items.tails[id][LRU_WARM] == NULL &&
+        engine->items.tails[id][LRU_COLD] == NULL) {
+        engine->items.itemstats[id].outofmemory++;
+        return NULL;
+    }
+
+    it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
+    if (it == 0) {
+        engine->items.itemstats[id].outofmemory++;
+        /* Last ditch effort. There is a very rare bug which causes
+         * refcount leaks. We've fixed most of them, but it still happens,
+         * and it may happen in the future.
+         * We can reasonably assume no item can stay locked for more than
+         * three hours, so if we find one in the tail which is that old,
+         * free it anyway.
+         */
+        for (auto segment : pull_order) {
             tries = search_items;
-            for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=search->prev) {
-                if (search->refcount != 0 && search->time + TAIL_REPAIR_TIME < current_time) {
+            for (search = engine->items.tails[id][segment]; tries > 0 && search != NULL; tries--, search=search->prev) {
+                if (search->refcount != 0 && search->time + TAIL_REPAIR_TIME < current_time &&
+                    !item_is_cursor(search) &&
+                    item_trylock(engine, search, item_lock, &taken)) {
                     engine->items.itemstats[id].tailrepairs++;
                     search->refcount = 0;
-                    do_item_unlink(engine, search);
-                    break;
+                    do_item_unlink(engine, search, true);
+                    item_trylock_release(taken);
+                    it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
+                    return it;
                 }
             }
-            it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
-            if (it == 0) {
-                return NULL;
-            }
         }
     }
+    return it;
+}
+
+/*@null@*/
+hash_item *do_item_alloc(struct default_engine *engine,
+                         const hash_key *key,
+                         const int flags,
+                         const rel_time_t exptime,
+                         const int nbytes,
+                         const void *cookie,
+                         uint8_t datatype,
+                         cb_mutex_t *item_lock) {
+    hash_item *it;
+    unsigned int id;
+
+    size_t ntotal = sizeof(hash_item) + hash_key_get_alloc_size(key) + nbytes;
+
+    if ((id = slabs_clsid(engine, ntotal)) == 0) {
+        return 0;
+    }
+
+    cb_mutex_enter(&engine->items.lru_locks[id]);
+    it = do_item_alloc_from_lru(engine, id, ntotal, cookie, item_lock);
+    cb_mutex_exit(&engine->items.lru_locks[id]);
+    if (it == NULL) {
+        return NULL;
+    }
 
     cb_assert(it->slabs_clsid == 0);
 
     it->slabs_clsid = id;
 
-    cb_assert(it != engine->items.heads[it->slabs_clsid]);
-
     it->next = it->prev = it->h_next = 0;
     it->refcount = 1;     /* the caller will have a reference */
     DEBUG_REFCNT(it, '*');
@@ -246,8 +371,8 @@ static void item_free(struct default_engine *engine, hash_item *it) {
     size_t ntotal = ITEM_ntotal(engine, it);
     unsigned int clsid;
     cb_assert((it->iflag & ITEM_LINKED) == 0);
-    cb_assert(it != engine->items.heads[it->slabs_clsid]);
-    cb_assert(it != engine->items.tails[it->slabs_clsid]);
+    cb_assert(it != engine->items.heads[it->slabs_clsid][it->lru_segment]);
+    cb_assert(it != engine->items.tails[it->slabs_clsid][it->lru_segment]);
     cb_assert(it->refcount == 0 || engine->scrubber.force_delete);
 
     /* so slab size changer can tell later if item is already free or not */
@@ -258,13 +383,16 @@ static void item_free(struct default_engine *engine, hash_item *it) {
     slabs_free(engine, it, ntotal, clsid);
 }
 
-static void item_link_q(struct default_engine *engine, hash_item *it) { /* item is the new head */
+/* The LRU lock of the item's slab class is assumed to be held */
+static void item_link_q(struct default_engine *engine, hash_item *it,
+                        lru_segment segment) { /* item is the new head */
     hash_item **head, **tail;
     cb_assert(it->slabs_clsid < POWER_LARGEST);
     cb_assert((it->iflag & ITEM_SLABBED) == 0);
 
-    head = &engine->items.heads[it->slabs_clsid];
-    tail = &engine->items.tails[it->slabs_clsid];
+    it->lru_segment = segment;
+    head = &engine->items.heads[it->slabs_clsid][segment];
+    tail = &engine->items.tails[it->slabs_clsid][segment];
     cb_assert(it != *head);
     cb_assert((*head && *tail) || (*head == 0 && *tail == 0));
     it->prev = 0;
@@ -272,15 +400,17 @@ static void item_link_q(struct default_engine *engine, hash_item *it) { /* item
     if (it->next) it->next->prev = it;
     *head = it;
     if (*tail == 0) *tail = it;
-    engine->items.sizes[it->slabs_clsid]++;
+    engine->items.sizes[it->slabs_clsid][segment]++;
     return;
 }
 
+/* The LRU lock of the item's slab class is assumed to be held */
 static void item_unlink_q(struct default_engine *engine, hash_item *it) {
     hash_item **head, **tail;
     cb_assert(it->slabs_clsid < POWER_LARGEST);
-    head = &engine->items.heads[it->slabs_clsid];
-    tail = &engine->items.tails[it->slabs_clsid];
+    cb_assert(it->lru_segment < LRU_SEGMENTS);
+    head = &engine->items.heads[it->slabs_clsid][it->lru_segment];
+    tail = &engine->items.tails[it->slabs_clsid][it->lru_segment];
 
     if (*head == it) {
         cb_assert(it->prev == 0);
@@ -295,7 +425,7 @@ static void item_unlink_q(struct default_engine *engine, hash_item *it) {
 
     if (it->next) it->next->prev = it->prev;
     if (it->prev) it->prev->next = it->next;
-    engine->items.sizes[it->slabs_clsid]--;
+    engine->items.sizes[it->slabs_clsid][it->lru_segment]--;
     return;
 }
 
@@ -337,12 +467,19 @@ int do_item_link(struct default_engine *engine,
         return 0;
     }
 
-    item_link_q(engine, it);
+    cb_mutex_enter(&engine->items.lru_locks[it->slabs_clsid]);
+    item_link_q(engine, it, LRU_HOT);
+    cb_mutex_exit(&engine->items.lru_locks[it->slabs_clsid]);
 
     return 1;
 }
 
-void do_item_unlink(struct default_engine *engine, hash_item *it) {
+/*
+ * The item's lock is assumed to be held, and if lru_locked the LRU lock of
+ * its slab class too.
+ */
+void do_item_unlink(struct default_engine *engine, hash_item *it,
+                    bool lru_locked) {
     const hash_key* key = item_get_key(it);
     MEMCACHED_ITEM_UNLINK(hash_key_get_client_key(key),
                           hash_key_get_client_key_len(key),
@@ -355,7 +492,13 @@ void do_item_unlink(struct default_engine *engine, hash_item *it) {
         cb_mutex_exit(&engine->stats.lock);
         assoc_delete(crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0),
                      key);
-        item_unlink_q(engine, it);
+        if (lru_locked) {
+            item_unlink_q(engine, it);
+        } else {
+            cb_mutex_enter(&engine->items.lru_locks[it->slabs_clsid]);
+            item_unlink_q(engine, it);
+            cb_mutex_exit(&engine->items.lru_locks[it->slabs_clsid]);
+        }
         if (it->refcount == 0 || engine->scrubber.force_delete) {
             item_free(engine, it);
         }
@@ -387,7 +530,9 @@ ENGINE_ERROR_CODE do_safe_item_unlink(struct default_engine* engine,
             assoc_delete(crc32c(hash_key_get_key(key),
                                 hash_key_get_key_len(key), 0),
                          key);
+            cb_mutex_enter(&engine->items.lru_locks[stored->slabs_clsid]);
             item_unlink_q(engine, stored);
+            cb_mutex_exit(&engine->items.lru_locks[stored->slabs_clsid]);
             if (stored->refcount == 0 || engine->scrubber.force_delete) {
                 item_free(engine, stored);
             }
@@ -413,19 +558,19 @@ void do_item_release(struct default_engine *engine, hash_item *it) {
     }
 }
 
+/*
+ * Record an access to the item. The item isn't moved in the LRU here (so
+ * reads never take the LRU lock); the LRU maintainer moves active items
+ * to WARM when it finds them at the tail of their segment.
+ */
 void do_item_update(struct default_engine *engine, hash_item *it) {
-    rel_time_t current_time = engine->server.core->get_current_time();
     MEMCACHED_ITEM_UPDATE(hash_key_get_client_key(item_get_key(it)),
                           hash_key_get_client_key_len(item_get_key(it)),
                           it->nbytes);
-    if (it->time < current_time - ITEM_UPDATE_INTERVAL) {
-        cb_assert((it->iflag & ITEM_SLABBED) == 0);
+    cb_assert((it->iflag & ITEM_SLABBED) == 0);
 
-        if ((it->iflag & ITEM_LINKED) != 0) {
-            item_unlink_q(engine, it);
-            it->time = current_time;
-            item_link_q(engine, it);
-        }
+    if ((it->iflag & ITEM_ACTIVE) == 0) {
+        it->iflag |= ITEM_ACTIVE;
     }
 }
 
@@ -445,50 +590,70 @@ int do_item_replace(struct default_engine *engine,
     return do_item_link(engine, cookie, new_it);
 }
 
+/* Total number of items in a slab class' LRU (its LRU lock held) */
+static unsigned int lru_size(struct default_engine *engine, int clsid) {
+    unsigned int size = 0;
+    for (int segment = 0; segment < LRU_SEGMENTS; ++segment) {
+        size += engine->items.sizes[clsid][segment];
+    }
+    return size;
+}
+
+/* The tail of the coldest non-empty segment (its LRU lock held) */
+static hash_item* lru_oldest_tail(struct default_engine *engine, int clsid) {
+    for (int segment = LRU_COLD; segment >= LRU_HOT; --segment) {
+        if (engine->items.tails[clsid][segment] != NULL) {
+            return engine->items.tails[clsid][segment];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Expired (and flushed) items at the LRU tails are reclaimed by the LRU
+ * maintainer, so unlike the LRU walk of the allocation path these stats
+ * don't unlink them.
+ */
 static void do_item_stats(struct default_engine *engine,
                           ADD_STAT add_stats, const void *c) {
     int i;
-    rel_time_t current_time = engine->server.core->get_current_time();
     for (i = 0; i < POWER_LARGEST; i++) {
-        if (engine->items.tails[i] != NULL) {
+        cb_mutex_enter(&engine->items.lru_locks[i]);
+        hash_item *tail = lru_oldest_tail(engine, i);
+        if (tail != NULL) {
             const char *prefix = "items";
-            int search = search_items;
-            while (search > 0 &&
-                   engine->items.tails[i] != NULL &&
-                   ((engine->config.oldest_live != 0 && /* Item flushd */
-                     engine->config.oldest_live <= current_time &&
-                     engine->items.tails[i]->time <= engine->config.oldest_live) ||
-                    (engine->items.tails[i]->exptime != 0 && /* and not expired */
-                     engine->items.tails[i]->exptime < current_time))) {
-                --search;
-                if (engine->items.tails[i]->refcount == 0) {
-                    do_item_unlink(engine, engine->items.tails[i]);
-                } else {
-                    break;
-                }
-            }
-            if (engine->items.tails[i] == NULL) {
-                /* We removed all of the items in this slab class */
-                continue;
-            }
+            const itemstats_t& itemstats = engine->items.itemstats[i];
 
             add_statistics(c, add_stats, prefix, i, "number", "%u",
-                           engine->items.sizes[i]);
+                           lru_size(engine, i));
+            add_statistics(c, add_stats, prefix, i, "number_hot", "%u",
+                           engine->items.sizes[i][LRU_HOT]);
+            add_statistics(c, add_stats, prefix, i, "number_warm", "%u",
+                           engine->items.sizes[i][LRU_WARM]);
+            add_statistics(c, add_stats, prefix, i, "number_cold", "%u",
+                           engine->items.sizes[i][LRU_COLD]);
             add_statistics(c, add_stats, prefix, i, "age", "%u",
-                           engine->items.tails[i]->time);
+                           tail->time);
             add_statistics(c, add_stats, prefix, i, "evicted",
-                           "%u", engine->items.itemstats[i].evicted);
+                           "%u", itemstats.evicted);
             add_statistics(c, add_stats, prefix, i, "evicted_nonzero",
-                           "%u", engine->items.itemstats[i].evicted_nonzero);
+                           "%u", itemstats.evicted_nonzero);
             add_statistics(c, add_stats, prefix, i, "evicted_time",
-                           "%u", engine->items.itemstats[i].evicted_time);
+                           "%u", itemstats.evicted_time);
             add_statistics(c, add_stats, prefix, i, "outofmemory",
-                           "%u", engine->items.itemstats[i].outofmemory);
+                           "%u", itemstats.outofmemory);
             add_statistics(c, add_stats, prefix, i, "tailrepairs",
-                           "%u", engine->items.itemstats[i].tailrepairs);;
+                           "%u", itemstats.tailrepairs);
             add_statistics(c, add_stats, prefix, i, "reclaimed",
-                           "%u", engine->items.itemstats[i].reclaimed);;
+                           "%u", itemstats.reclaimed);
+            add_statistics(c, add_stats, prefix, i, "moves_to_cold",
+                           "%u", itemstats.moves_to_cold);
+            add_statistics(c, add_stats, prefix, i, "moves_to_warm",
+                           "%u", itemstats.moves_to_warm);
+            add_statistics(c, add_stats, prefix, i, "moves_within_lru",
+                           "%u", itemstats.moves_within_lru);
         }
+        cb_mutex_exit(&engine->items.lru_locks[i]);
     }
 }
 
@@ -507,18 +672,22 @@ static void do_item_stats_sizes(struct default_engine *engine,
 
         /* build the histogram */
         for (i = 0; i < POWER_LARGEST; i++) {
-            hash_item *iter = engine->items.heads[i];
-            while (iter) {
-                size_t ntotal = ITEM_ntotal(engine, iter);
-                size_t bucket = ntotal / 32;
-                if ((ntotal % 32) != 0) {
-                    bucket++;
-                }
-                if (bucket < num_buckets) {
-                    histogram[bucket]++;
+            cb_mutex_enter(&engine->items.lru_locks[i]);
+            for (int segment = 0; segment < LRU_SEGMENTS; ++segment) {
+                hash_item *iter = engine->items.heads[i][segment];
+                while (iter) {
+                    size_t ntotal = ITEM_ntotal(engine, iter);
+                    size_t bucket = ntotal / 32;
+                    if ((ntotal % 32) != 0) {
+                        bucket++;
+                    }
+                    if (bucket < num_buckets) {
+                        histogram[bucket]++;
+                    }
+                    iter = iter->next;
                 }
-                iter = iter->next;
             }
+            cb_mutex_exit(&engine->items.lru_locks[i]);
         }
 
         /* write the buffer */
@@ -569,7 +738,7 @@ hash_item* do_item_get(struct default_engine* engine,
     if (it != NULL && engine->config.oldest_live != 0 &&
         engine->config.oldest_live <= current_time &&
         it->time <= engine->config.oldest_live) {
-        do_item_unlink(engine, it);           /* MTSAFE - items.lock held */
+        do_item_unlink(engine, it);           /* MTSAFE - item lock held */
         it = NULL;
     }
 
@@ -582,7 +751,7 @@ hash_item* do_item_get(struct default_engine* engine,
     }
 
     if (it != NULL && it->exptime != 0 && it->exptime <= current_time) {
-        do_item_unlink(engine, it);           /* MTSAFE - items.lock held */
+        do_item_unlink(engine, it);           /* MTSAFE - item lock held */
         it = NULL;
     }
 
@@ -712,9 +881,8 @@ hash_item *item_alloc(struct default_engine *engine,
     if (!hash_key_create(&hkey, key, nkey, engine, cookie)) {
         return NULL;
     }
-    cb_mutex_enter(&engine->items.lock);
-    it = do_item_alloc(engine, &hkey, flags, exptime, nbytes, cookie, datatype);
-    cb_mutex_exit(&engine->items.lock);
+    it = do_item_alloc(engine, &hkey, flags, exptime, nbytes, cookie, datatype,
+                       NULL);
     hash_key_destroy(&hkey);
     return it;
 }
@@ -746,9 +914,10 @@ hash_item* item_get(struct default_engine* engine,
                     const void* cookie,
                     const hash_key& key,
                     const DocStateFilter state) {
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(&key));
+    cb_mutex_enter(lock);
     auto* it = do_item_get(engine, &key, state);
-    cb_mutex_exit(&engine->items.lock);
+    cb_mutex_exit(lock);
     return it;
 }
 
@@ -757,25 +926,28 @@ hash_item* item_get(struct default_engine* engine,
  * needed.
  */
 void item_release(struct default_engine *engine, hash_item *item) {
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(item_get_key(item)));
+    cb_mutex_enter(lock);
     do_item_release(engine, item);
-    cb_mutex_exit(&engine->items.lock);
+    cb_mutex_exit(lock);
 }
 
 /*
  * Unlinks an item from the LRU and hashtable.
  */
 void item_unlink(struct default_engine *engine, hash_item *item) {
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(item_get_key(item)));
+    cb_mutex_enter(lock);
     do_item_unlink(engine, item);
-    cb_mutex_exit(&engine->items.lock);
+    cb_mutex_exit(lock);
 }
 
 ENGINE_ERROR_CODE safe_item_unlink(struct default_engine *engine,
                                    hash_item *it) {
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(item_get_key(it)));
+    cb_mutex_enter(lock);
     auto ret = do_safe_item_unlink(engine, it);
-    cb_mutex_exit(&engine->items.lock);
+    cb_mutex_exit(lock);
     return ret;
 }
 
@@ -794,12 +966,13 @@ ENGINE_ERROR_CODE store_item(struct default_engine *engine,
         item->iflag |= ITEM_ZOMBIE;
     }
 
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(item_get_key(item)));
+    cb_mutex_enter(lock);
     ret = do_store_item(engine, item, operation, cookie, &stored_item);
     if (ret == ENGINE_SUCCESS) {
         *cas = stored_item->cas;
     }
-    cb_mutex_exit(&engine->items.lock);
+    cb_mutex_exit(lock);
     return ret;
 }
 
@@ -807,7 +980,8 @@ ENGINE_ERROR_CODE do_item_get_locked(struct default_engine* engine,
                                      const void* cookie,
                                      hash_item** it,
                                      const hash_key* hkey,
-                                     rel_time_t locktime) {
+                                     rel_time_t locktime,
+                                     cb_mutex_t* item_lock) {
     hash_item* item = do_item_get(engine, hkey, DocStateFilter::Alive);
     if (item == nullptr) {
         return ENGINE_KEY_ENOENT;
@@ -845,7 +1019,8 @@ ENGINE_ERROR_CODE do_item_get_locked(struct default_engine* engine,
         // Unfortunately I can't return the actual object as that'll cause
         // the item's cas to be masked out ;-)
         auto* clone = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                    item->nbytes, cookie, item->datatype);
+                                    item->nbytes, cookie, item->datatype,
+                                    item_lock);
         if (clone == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
@@ -866,14 +1041,16 @@ ENGINE_ERROR_CODE do_item_get_locked(struct default_engine* engine,
         // Multiple entities holds a reference to the object. We
         // need to do a copy/replace.
         auto* clone1 = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                     item->nbytes, cookie, item->datatype);
+                                     item->nbytes, cookie, item->datatype,
+                                     item_lock);
         if (clone1 == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
         }
 
         auto* clone2 = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                     item->nbytes, cookie, item->datatype);
+                                     item->nbytes, cookie, item->datatype,
+                                     item_lock);
         if (clone2 == nullptr) {
             do_item_release(engine, item);
             do_item_release(engine, clone1);
@@ -910,10 +1087,11 @@ ENGINE_ERROR_CODE item_get_locked(struct default_engine* engine,
         return ENGINE_TMPFAIL;
     }
 
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(&hkey));
+    cb_mutex_enter(lock);
     ENGINE_ERROR_CODE ret = do_item_get_locked(engine, cookie, it, &hkey,
-                                               locktime);
-    cb_mutex_exit(&engine->items.lock);
+                                               locktime, lock);
+    cb_mutex_exit(lock);
     hash_key_destroy(&hkey);
 
     return ret;
@@ -922,7 +1100,8 @@ ENGINE_ERROR_CODE item_get_locked(struct default_engine* engine,
 static ENGINE_ERROR_CODE do_item_unlock(struct default_engine* engine,
                                         const void* cookie,
                                         const hash_key* hkey,
-                                        uint64_t cas) {
+                                        uint64_t cas,
+                                        cb_mutex_t* item_lock) {
     hash_item* item = do_item_get(engine, hkey, DocStateFilter::Alive);
     if (item == nullptr) {
         return ENGINE_KEY_ENOENT;
@@ -951,7 +1130,8 @@ static ENGINE_ERROR_CODE do_item_unlock(struct default_engine* engine,
     } else {
         // Someone else holds a reference to the object.
         auto* clone = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                    item->nbytes, cookie, item->datatype);
+                                    item->nbytes, cookie, item->datatype,
+                                    item_lock);
         if (clone == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
@@ -979,9 +1159,10 @@ ENGINE_ERROR_CODE item_unlock(struct default_engine* engine,
         return ENGINE_TMPFAIL;
     }
 
-    cb_mutex_enter(&engine->items.lock);
-    ENGINE_ERROR_CODE ret = do_item_unlock(engine, cookie, &hkey, cas);
-    cb_mutex_exit(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(&hkey));
+    cb_mutex_enter(lock);
+    ENGINE_ERROR_CODE ret = do_item_unlock(engine, cookie, &hkey, cas, lock);
+    cb_mutex_exit(lock);
     hash_key_destroy(&hkey);
 
     return ret;
@@ -991,7 +1172,8 @@ ENGINE_ERROR_CODE do_item_get_and_touch(struct default_engine* engine,
                                         const void* cookie,
                                         hash_item** it,
                                         const hash_key* hkey,
-                                        rel_time_t exptime) {
+                                        rel_time_t exptime,
+                                        cb_mutex_t* item_lock) {
     hash_item* item = do_item_get(engine, hkey, DocStateFilter::Alive);
     if (item == nullptr) {
         return ENGINE_KEY_ENOENT;
@@ -1025,7 +1207,8 @@ ENGINE_ERROR_CODE do_item_get_and_touch(struct default_engine* engine,
         // Multiple entities holds a reference to the object. We
         // need to do a copy/replace.
         auto* clone = do_item_alloc(engine, hkey, item->flags, exptime,
-                                    item->nbytes, cookie, item->datatype);
+                                    item->nbytes, cookie, item->datatype,
+                                    item_lock);
         if (clone == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
@@ -1055,10 +1238,11 @@ ENGINE_ERROR_CODE item_get_and_touch(struct default_engine* engine,
         return ENGINE_TMPFAIL;
     }
 
-    cb_mutex_enter(&engine->items.lock);
+    cb_mutex_t* lock = item_lock(engine, item_hash(&hkey));
+    cb_mutex_enter(lock);
     ENGINE_ERROR_CODE ret = do_item_get_and_touch(engine, cookie, it, &hkey,
-                                                  exptime);
-    cb_mutex_exit(&engine->items.lock);
+                                                  exptime, lock);
+    cb_mutex_exit(lock);
     hash_key_destroy(&hkey);
 
     return ret;
@@ -1068,8 +1252,6 @@ ENGINE_ERROR_CODE item_get_and_touch(struct default_engine* engine,
  * Flushes expired items after a flush_all call
  */
 void item_flush_expired(struct default_engine *engine) {
-    cb_mutex_enter(&engine->items.lock);
-
     rel_time_t now = engine->server.core->get_current_time();
     if (now > engine->config.oldest_live) {
         engine->config.oldest_live = now - 1;
@@ -1077,54 +1259,302 @@ void item_flush_expired(struct default_engine *engine) {
 
     for (int ii = 0; ii < POWER_LARGEST; ii++) {
         hash_item *iter, *next;
+        cb_mutex_t *taken;
+        bool busy;
         /*
-         * The LRU is sorted in decreasing time order, and an item's
-         * timestamp is never newer than its last access time, so we
+         * Each LRU segment is sorted in decreasing time order (items are
+         * only ever linked at the head, which sets their time), so we
          * only need to walk back until we hit an item older than the
          * oldest_live time.
          * The oldest_live checking will auto-expire the remaining items.
          */
-        for (iter = engine->items.heads[ii]; iter != NULL; iter = next) {
-            if (iter->time >= engine->config.oldest_live) {
-                next = iter->next;
-                if ((iter->iflag & ITEM_SLABBED) == 0) {
-                    do_item_unlink(engine, iter);
+        do {
+            busy = false;
+            cb_mutex_enter(&engine->items.lru_locks[ii]);
+            for (int segment = 0; !busy && segment < LRU_SEGMENTS; ++segment) {
+                for (iter = engine->items.heads[ii][segment]; iter != NULL; iter = next) {
+                    if (iter->time >= engine->config.oldest_live) {
+                        next = iter->next;
+                        if (!item_trylock(engine, iter, NULL, &taken)) {
+                            /* Let the holder of the item's lock finish (it
+                             * may be waiting for the LRU lock) and start over */
+                            busy = true;
+                            break;
+                        }
+                        if ((iter->iflag & ITEM_SLABBED) == 0) {
+                            do_item_unlink(engine, iter, true);
+                        }
+                        item_trylock_release(taken);
+                    } else {
+                        /* We've hit the first old item. Continue to the next queue. */
+                        break;
+                    }
                 }
-            } else {
-                /* We've hit the first old item. Continue to the next queue. */
-                break;
             }
-        }
+            cb_mutex_exit(&engine->items.lru_locks[ii]);
+            if (busy) {
+                std::this_thread::yield();
+            }
+        } while (busy);
     }
-    cb_mutex_exit(&engine->items.lock);
 }
 
 void item_stats(struct default_engine *engine,
                    ADD_STAT add_stat, const void *cookie)
 {
-    cb_mutex_enter(&engine->items.lock);
     do_item_stats(engine, add_stat, cookie);
-    cb_mutex_exit(&engine->items.lock);
 }
 
 
 void item_stats_sizes(struct default_engine *engine,
                       ADD_STAT add_stat, const void *cookie)
 {
-    cb_mutex_enter(&engine->items.lock);
     do_item_stats_sizes(engine, add_stat, cookie);
-    cb_mutex_exit(&engine->items.lock);
+}
+
+/*
+ * Move (or reclaim) items from the tail of one segment of a slab class' LRU
+ * until the segment is down to `limit` items (only done for HOT and WARM),
+ * looking at no more than lru_maintainer_batch items:
+ *  - expired and flushed items are reclaimed,
+ *  - items accessed since they were last moved go to WARM (for COLD this
+ *    is the only move made, leaving the rest to be evicted),
+ *  - the others go to COLD.
+ *
+ * The LRU lock of the class is assumed to be held.
+ *
+ * @return the number of items moved or reclaimed
+ */
+static size_t lru_juggle(struct default_engine *engine, int clsid,
+                         lru_segment segment, unsigned int limit) {
+    const rel_time_t oldest_live = engine->config.oldest_live;
+    const rel_time_t current_time = engine->server.core->get_current_time();
+    itemstats_t& itemstats = engine->items.itemstats[clsid];
+    hash_item *search, *prev;
+    cb_mutex_t *taken;
+    int tries = lru_maintainer_batch;
+    size_t moved = 0;
+
+    for (search = engine->items.tails[clsid][segment];
+         tries > 0 && search != NULL;
+         tries--, search = prev) {
+        prev = search->prev;
+        if (segment != LRU_COLD &&
+            engine->items.sizes[clsid][segment] <= limit) {
+            break;
+        }
+        if (item_is_cursor(search) ||
+            !item_trylock(engine, search, NULL, &taken)) {
+            continue;
+        }
+
+        if (item_is_reclaimable(search, oldest_live, current_time)) {
+            itemstats.reclaimed++;
+            cb_mutex_enter(&engine->stats.lock);
+            engine->stats.reclaimed++;
+            cb_mutex_exit(&engine->stats.lock);
+            do_item_unlink(engine, search, true);
+            ++moved;
+        } else if (item_is_flushed(search, oldest_live, current_time)) {
+            /* In use; leave it be rather than refresh its time */
+        } else if ((search->iflag & ITEM_ACTIVE) != 0) {
+            if (segment == LRU_WARM) {
+                itemstats.moves_within_lru++;
+            } else {
+                itemstats.moves_to_warm++;
+            }
+            item_lru_move(engine, search, LRU_WARM);
+            ++moved;
+        } else if (segment != LRU_COLD) {
+            itemstats.moves_to_cold++;
+            item_lru_move(engine, search, LRU_COLD);
+            ++moved;
+        }
+        item_trylock_release(taken);
+    }
+
+    return moved;
+}
+
+/*
+ * Relocate a linked item of the slab page being moved by the rebalancer to
+ * a free chunk of its slab class (if there is one), at the head of its LRU
+ * segment.
+ *
+ * The item's lock and the LRU lock of its class are assumed to be held.
+ */
+static bool item_relocate(struct default_engine *engine, hash_item *it) {
+    const size_t ntotal = ITEM_ntotal(engine, it);
+    const hash_key* key = item_get_key(it);
+    hash_item *new_it = static_cast<hash_item*>(
+            slabs_alloc_free(engine, ntotal, it->slabs_clsid));
+    if (new_it == NULL) {
+        return false;
+    }
+
+    new_it->next = new_it->prev = new_it->h_next = 0;
+    new_it->cas = it->cas;
+    new_it->time = engine->server.core->get_current_time();
+    new_it->exptime = it->exptime;
+    new_it->locktime = it->locktime;
+    new_it->nbytes = it->nbytes;
+    new_it->flags = it->flags;
+    new_it->refcount = 0;
+    new_it->iflag = it->iflag.load();
+    new_it->slabs_clsid = it->slabs_clsid;
+    new_it->datatype = it->datatype;
+    hash_key_copy_to_item(new_it, key);
+    memcpy(item_get_data(new_it), item_get_data(it), it->nbytes);
+
+    const uint32_t hash = item_hash(key);
+    const lru_segment segment = lru_segment(it->lru_segment);
+    assoc_delete(hash, key);
+    assoc_insert(hash, new_it);
+    item_unlink_q(engine, it);
+    item_link_q(engine, new_it, segment);
+
+    it->iflag &= ~ITEM_LINKED;
+    item_free(engine, it);
+    return true;
+}
+
+enum rebalance_result {
+    REBALANCE_BUSY,
+    REBALANCE_RECLAIMED,
+    REBALANCE_RESCUED,
+    REBALANCE_EVICTED
+};
+
+/*
+ * Free a chunk of the slab page being moved which is in use: reclaim the
+ * item on it if it's expired, or else relocate or evict it. Items which are
+ * referenced (or not linked, as they're being stored or were unlinked while
+ * referenced) are busy, and left for the next pass.
+ *
+ * The LRU lock of the page's slab class is assumed to be held (and keeps a
+ * linked item from being freed while it's looked at).
+ */
+static rebalance_result item_rebalance_chunk(struct default_engine *engine,
+                                             hash_item *it) {
+    const rel_time_t oldest_live = engine->config.oldest_live;
+    const rel_time_t current_time = engine->server.core->get_current_time();
+    rebalance_result result = REBALANCE_BUSY;
+    cb_mutex_t *taken;
+
+    if ((it->iflag & ITEM_LINKED) == 0 ||
+        !item_trylock(engine, it, NULL, &taken)) {
+        return REBALANCE_BUSY;
+    }
+
+    if ((it->iflag & ITEM_LINKED) != 0 && it->refcount == 0) {
+        if (item_is_reclaimable(it, oldest_live, current_time) ||
+            item_is_flushed(it, oldest_live, current_time)) {
+            engine->items.itemstats[it->slabs_clsid].reclaimed++;
+            cb_mutex_enter(&engine->stats.lock);
+            engine->stats.reclaimed++;
+            cb_mutex_exit(&engine->stats.lock);
+            do_item_unlink(engine, it, true);
+            result = REBALANCE_RECLAIMED;
+        } else if (item_relocate(engine, it)) {
+            result = REBALANCE_RESCUED;
+        } else if (it->locktime <= current_time) {
+            do_item_unlink(engine, it, true);
+            result = REBALANCE_EVICTED;
+        }
+    }
+    item_trylock_release(taken);
+    return result;
+}
+
+/*
+ * Drive the slab page rebalancer (see slabs_automove()): decide whether a
+ * page should be moved to another slab class, and make a pass over the
+ * page being moved (if any) freeing its chunks.
+ *
+ * @return the number of chunks freed, or still to be freed
+ */
+static size_t item_slab_rebalance(struct default_engine *engine) {
+    uint64_t evicted[MAX_NUMBER_OF_SLAB_CLASSES] = {0};
+    unsigned int id, perslab, size;
+    size_t rescues = 0, evictions = 0, reclaimed = 0, busy = 0;
+    char *page;
+
+    if (engine->config.slab_automove == 0) {
+        return 0;
+    }
+
+    /* The classes under eviction pressure are the ones to give pages to */
+    for (int ii = POWER_SMALLEST; ii < POWER_LARGEST; ii++) {
+        cb_mutex_enter(&engine->items.lru_locks[ii]);
+        evicted[ii] = engine->items.itemstats[ii].evicted +
+                      engine->items.itemstats[ii].outofmemory;
+        cb_mutex_exit(&engine->items.lru_locks[ii]);
+    }
+
+    if (!slabs_automove(engine, evicted) ||
+        !slabs_rebalance_page(engine, &id, &page, &perslab, &size)) {
+        return 0;
+    }
+
+    for (unsigned int ii = 0; ii < perslab; ++ii) {
+        hash_item *it = reinterpret_cast<hash_item*>(page + ii * size);
+        /* Free chunks of the page stay free (they're not handed out) */
+        if ((it->iflag & ITEM_SLABBED) != 0) {
+            continue;
+        }
+        cb_mutex_enter(&engine->items.lru_locks[id]);
+        switch (item_rebalance_chunk(engine, it)) {
+        case REBALANCE_BUSY:
+            ++busy;
+            break;
+        case REBALANCE_RECLAIMED:
+            ++reclaimed;
+            break;
+        case REBALANCE_RESCUED:
+            ++rescues;
+            break;
+        case REBALANCE_EVICTED:
+            ++evictions;
+            break;
+        }
+        cb_mutex_exit(&engine->items.lru_locks[id]);
+    }
+
+    slabs_rebalance_end(engine, rescues, evictions, busy);
+    return rescues + evictions + reclaimed + busy;
+}
+
+size_t item_lru_maintainer(struct default_engine *engine) {
+    size_t moved = 0;
+
+    for (int ii = POWER_SMALLEST; ii < POWER_LARGEST; ii++) {
+        cb_mutex_enter(&engine->items.lru_locks[ii]);
+        const unsigned int total = lru_size(engine, ii);
+        if (total != 0) {
+            moved += lru_juggle(engine, ii, LRU_HOT,
+                                total * lru_hot_percent / 100);
+            moved += lru_juggle(engine, ii, LRU_WARM,
+                                total * lru_warm_percent / 100);
+            moved += lru_juggle(engine, ii, LRU_COLD, 0);
+        }
+        cb_mutex_exit(&engine->items.lru_locks[ii]);
+    }
+
+    moved += item_slab_rebalance(engine);
+    return moved;
 }
 
 static void do_item_link_cursor(struct default_engine *engine,
-                                hash_item *cursor, int ii)
+                                hash_item *cursor, int ii,
+                                lru_segment segment)
 {
     cursor->slabs_clsid = (uint8_t)ii;
+    cursor->lru_segment = segment;
     cursor->next = NULL;
-    cursor->prev = engine->items.tails[ii];
-    engine->items.tails[ii]->next = cursor;
-    engine->items.tails[ii] = cursor;
-    engine->items.sizes[ii]++;
+    cursor->prev = engine->items.tails[ii][segment];
+    engine->items.tails[ii][segment]->next = cursor;
+    engine->items.tails[ii][segment] = cursor;
+    engine->items.sizes[ii][segment]++;
 }
 
 typedef ENGINE_ERROR_CODE (*ITERFUNC)(struct default_engine *engine,
@@ -1143,12 +1573,19 @@ static bool do_item_walk_cursor(struct default_engine *engine,
     while (cursor->prev != NULL && ii < steplength) {
         /* Move cursor */
         hash_item *ptr = cursor->prev;
+        const bool is_cursor = item_is_cursor(ptr);
+        cb_mutex_t *taken = NULL;
         bool done = false;
 
+        if (!is_cursor && !item_trylock(engine, ptr, NULL, &taken)) {
+            /* The item is busy; let the caller drop the LRU lock and retry */
+            return true;
+        }
+
         ++ii;
         item_unlink_q(engine, cursor);
 
-        if (ptr == engine->items.heads[cursor->slabs_clsid]) {
+        if (ptr == engine->items.heads[cursor->slabs_clsid][cursor->lru_segment]) {
             done = true;
             cursor->prev = NULL;
         } else {
@@ -1159,10 +1596,11 @@ static bool do_item_walk_cursor(struct default_engine *engine,
         }
 
         /* Ignore cursors */
-        if (item_get_key(ptr)->header.len == 0 && ptr->nbytes == 0) {
+        if (is_cursor) {
             --ii;
         } else {
             *error = itemfunc(engine, ptr, itemdata);
+            item_trylock_release(taken);
             if (*error != ENGINE_SUCCESS) {
                 return false;
             }
@@ -1199,7 +1637,8 @@ static ENGINE_ERROR_CODE item_scrub(struct default_engine *engine,
 
     if (engine->scrubber.force_delete || (item->refcount == 0 &&
        (item->exptime != 0 && item->exptime < current_time))) {
-        do_item_unlink(engine, item);
+        /* the cursor walk holds the LRU lock (and the item's lock) */
+        do_item_unlink(engine, item, true);
         engine->scrubber.cleaned++;
     }
     return ENGINE_SUCCESS;
@@ -1210,10 +1649,11 @@ static void item_scrub_class(struct default_engine *engine,
 
     ENGINE_ERROR_CODE ret;
     bool more;
+    cb_mutex_t *lru_lock = &engine->items.lru_locks[cursor->slabs_clsid];
     do {
-        cb_mutex_enter(&engine->items.lock);
+        cb_mutex_enter(lru_lock);
         more = do_item_walk_cursor(engine, cursor, 200, item_scrub, NULL, &ret);
-        cb_mutex_exit(&engine->items.lock);
+        cb_mutex_exit(lru_lock);
         if (ret != ENGINE_SUCCESS) {
             break;
         }
@@ -1228,18 +1668,21 @@ void item_scrubber_main(struct default_engine *engine)
     memset(&cursor, 0, sizeof(cursor));
     cursor.refcount = 1;
     for (ii = 0; ii < POWER_LARGEST; ++ii) {
-        bool skip = false;
-        cb_mutex_enter(&engine->items.lock);
-        if (engine->items.heads[ii] == NULL) {
-            skip = true;
-        } else {
-            /* add the item at the tail */
-            do_item_link_cursor(engine, &cursor, ii);
-        }
-        cb_mutex_exit(&engine->items.lock);
+        for (int segment = 0; segment < LRU_SEGMENTS; ++segment) {
+            bool skip = false;
+            cb_mutex_enter(&engine->items.lru_locks[ii]);
+            if (engine->items.heads[ii][segment] == NULL) {
+                skip = true;
+            } else {
+                /* add the item at the tail */
+                do_item_link_cursor(engine, &cursor, ii,
+                                    static_cast<lru_segment>(segment));
+            }
+            cb_mutex_exit(&engine->items.lru_locks[ii]);
 
-        if (!skip) {
-            item_scrub_class(engine, &cursor);
+            if (!skip) {
+                item_scrub_class(engine, &cursor);
+            }
         }
     }
 
@@ -61,9 +61,27 @@ typedef struct _hash_item {
     /** to identify the type of the data */
     uint8_t datatype;
 
-    // There is 3 spare bytes due to alignment
+    /** which segment of the slab class' LRU we're in (see lru_segment) */
+    uint8_t lru_segment;
+
+    // There is 2 spare bytes due to alignment
 } hash_item;
 
+/*
+ * The LRU of each slab class is split in three segments. New items go to
+ * HOT; the LRU maintainer (see item_lru_maintainer()) moves items from the
+ * tails of HOT and WARM (once they exceed their share of the class) to
+ * WARM if they've been accessed since they were last moved, or to COLD
+ * otherwise, and rescues accessed items from the tail of COLD to WARM.
+ * Items are evicted from the tail of COLD.
+ */
+enum lru_segment {
+    LRU_HOT = 0,
+    LRU_WARM = 1,
+    LRU_COLD = 2,
+    LRU_SEGMENTS = 3
+};
+
 /*
     The structure of the key we hash with.
 
@@ -146,17 +164,33 @@ typedef struct {
     unsigned int outofmemory;
     unsigned int tailrepairs;
     unsigned int reclaimed;
+    unsigned int moves_to_cold;
+    unsigned int moves_to_warm;
+    unsigned int moves_within_lru;
 } itemstats_t;
 
+/* Number of locks the items are striped over (by the hash of their key) */
+#define ITEM_LOCK_STRIPES 1024
+
+/*
+ * Lock order: an item lock, then the LRU lock of a slab class. An LRU lock
+ * holder (eviction, the scrubber) may only try-lock other item locks.
+ */
 struct items {
-   hash_item *heads[POWER_LARGEST];
-   hash_item *tails[POWER_LARGEST];
+   hash_item *heads[POWER_LARGEST][LRU_SEGMENTS];
+   hash_item *tails[POWER_LARGEST][LRU_SEGMENTS];
    itemstats_t itemstats[POWER_LARGEST];
-   unsigned int sizes[POWER_LARGEST];
+   unsigned int sizes[POWER_LARGEST][LRU_SEGMENTS];
+   /*
+    * serialise access to the LRU of each slab class (all of its segments,
+    * and the itemstats of that class)
+   */
+   cb_mutex_t lru_locks[POWER_LARGEST];
    /*
-    * serialise access to the items data
+    * serialise operations on the items whose key hashes to the stripe
+    * (lookup, refcount, link and unlink)
    */
-   cb_mutex_t lock;
+   cb_mutex_t item_locks[ITEM_LOCK_STRIPES];
 };
 
 
@@ -352,4 +386,13 @@ void item_scrubber_main(struct default_engine *engine);
  */
 bool item_start_scrub(struct default_engine *engine);
 
+/**
+ * Run one pass of the LRU maintainer over all slab classes of the engine:
+ * move items between the LRU segments and reclaim expired items from their
+ * tails, and move slab pages between the classes (see slabs_automove()).
+ *
+ * @return the number of items moved or reclaimed
+ */
+size_t item_lru_maintainer(struct default_engine *engine);
+
 #endif
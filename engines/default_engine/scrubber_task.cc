@@ -19,6 +19,8 @@
 #include "default_engine_internal.h"
 #include "engine_manager.h"
 
+#include <algorithm>
+
 static void scrubber_task_main(void* arg) {
     ScrubberTask* task = reinterpret_cast<ScrubberTask*>(arg);
     task->run();
@@ -58,6 +60,7 @@ void ScrubberTask::placeOnWorkQueue(struct default_engine* engine,
 
 void ScrubberTask::run() {
     std::unique_lock<std::mutex> lck(lock);
+    auto lruMaintainerSleep = maxLruMaintainerSleep;
     while (!shuttingdown) {
         if (!workQueue.empty()) {
             auto engine = workQueue.front();
@@ -72,7 +75,24 @@ void ScrubberTask::run() {
             lck.lock();
         } else {
             state = State::Idle;
-            cvar.wait(lck);
+            if (cvar.wait_for(lck, lruMaintainerSleep) ==
+                        std::cv_status::timeout &&
+                !shuttingdown && workQueue.empty()) {
+                state = State::Maintaining;
+                lck.unlock();
+                // Run the maintainer without holding the lock
+                const size_t moved = engineManager.maintainLru();
+                lck.lock();
+
+                // Back off while there is nothing to do
+                if (moved > 0) {
+                    lruMaintainerSleep = minLruMaintainerSleep;
+                } else {
+                    lruMaintainerSleep =
+                            std::min(lruMaintainerSleep * 2,
+                                     maxLruMaintainerSleep);
+                }
+            }
         }
     }
     state = State::Stopped;
@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -57,6 +58,10 @@ public:
     /**
      * Task's run loop method. This is not a public function and should only
      * be called from the tasks constructor.
+     *
+     * When there is no scrubbing to do the task runs the LRU maintainer
+     * over all of the engines (see item_lru_maintainer()), more frequently
+     * while it keeps finding items to move.
      */
     void run();
 
@@ -76,6 +81,8 @@ private:
         Idle,
         /// The scrubber is currently scrubbing a list
         Scrubbing,
+        /// The scrubber is currently running the LRU maintainer
+        Maintaining,
         /// The scrubber task is stopped (returning from main)
         Stopped
     };
@@ -104,6 +111,10 @@ private:
      */
     std::condition_variable cvar;
 
+    /** Bounds of the time to sleep between LRU maintainer runs */
+    const std::chrono::milliseconds minLruMaintainerSleep{1};
+    const std::chrono::milliseconds maxLruMaintainerSleep{100};
+
     /**
      * The identifier to the thread handle
      */
@@ -31,6 +31,15 @@
 static int do_slabs_newslab(struct default_engine *engine, const unsigned int id);
 static void *memory_allocate(struct default_engine *engine, size_t size);
 
+/* Length (in seconds) of the windows the slab rebalancer looks at */
+static const rel_time_t slab_automove_window = 10;
+
+/*
+ * Number of passes over a page being moved which may find it still in use
+ * before the move is given up.
+ */
+static const unsigned int slab_rebalance_max_passes = 1000;
+
 #ifndef DONT_PREALLOC_SLABS
 /* Preallocate as many slab pages as possible (called from slabs_init)
    on start-up, so users don't get confused out-of-memory errors when
@@ -197,7 +206,8 @@ static int grow_slab_list (struct default_engine *engine, const unsigned int id)
 
 static int do_slabs_newslab(struct default_engine *engine, const unsigned int id) {
     slabclass_t *p = &engine->slabs.slabclass[id];
-    int len = p->size * p->perslab;
+    /* All pages have the same size so they may be moved between classes */
+    int len = (int)engine->config.item_size_max;
     char *ptr;
 
     if ((engine->slabs.mem_limit && engine->slabs.mem_malloced + len > engine->slabs.mem_limit && p->slabs > 0) ||
@@ -263,6 +273,8 @@ static void *do_slabs_alloc(struct default_engine *engine, const size_t size, un
     }
 
     if (ret) {
+        /* The chunk is in use from now on (see item_slab_rebalance()) */
+        static_cast<hash_item*>(ret)->iflag &= ~ITEM_SLABBED;
         p->requested += size;
         MEMCACHED_SLABS_ALLOCATE(size, id, p->size, ret);
     } else {
@@ -272,6 +284,27 @@ static void *do_slabs_alloc(struct default_engine *engine, const size_t size, un
     return ret;
 }
 
+static bool slab_page_contains(struct default_engine *engine,
+                               const void *page, const void *ptr) {
+    return ptr >= page &&
+           ptr < static_cast<const char*>(page) + engine->config.item_size_max;
+}
+
+/* Put a chunk on the freelist of the slab class. Returns false on ENOMEM */
+static bool do_slabs_push_free(slabclass_t *p, void *ptr) {
+    if (p->sl_curr == p->sl_total) { /* need more space on the free list */
+        int new_size = (p->sl_total != 0) ? p->sl_total * 2 : 16;  /* 16 is arbitrary */
+        void **new_slots = static_cast<void**>(cb_realloc(p->slots,
+                                               new_size * sizeof(void *)));
+        if (new_slots == 0)
+            return false;
+        p->slots = new_slots;
+        p->sl_total = new_size;
+    }
+    p->slots[p->sl_curr++] = ptr;
+    return true;
+}
+
 static void do_slabs_free(struct default_engine *engine, void *ptr, const size_t size, unsigned int id) {
     slabclass_t *p;
 
@@ -287,20 +320,197 @@ static void do_slabs_free(struct default_engine *engine, void *ptr, const size_t
     return;
 #endif
 
-    if (p->sl_curr == p->sl_total) { /* need more space on the free list */
-        int new_size = (p->sl_total != 0) ? p->sl_total * 2 : 16;  /* 16 is arbitrary */
-        void **new_slots = static_cast<void**>(cb_realloc(p->slots,
-                                               new_size * sizeof(void *)));
-        if (new_slots == 0)
-            return;
-        p->slots = new_slots;
-        p->sl_total = new_size;
+    if (p->killing != 0 &&
+        slab_page_contains(engine, p->slab_list[p->killing - 1], ptr)) {
+        /* The page is being moved; its chunks are not to be reused */
+        p->requested -= size;
+        return;
     }
-    p->slots[p->sl_curr++] = ptr;
+
+    if (!do_slabs_push_free(p, ptr))
+        return;
     p->requested -= size;
     return;
 }
 
+/* Only hand out a chunk already carved from one of the class' pages */
+static void *do_slabs_alloc_free(struct default_engine *engine, const size_t size, unsigned int id) {
+#ifdef USE_SYSTEM_MALLOC
+    return NULL;
+#endif
+    if (id < POWER_SMALLEST || id > engine->slabs.power_largest) {
+        return NULL;
+    }
+
+    slabclass_t *p = &engine->slabs.slabclass[id];
+    if (p->sl_curr == 0 && p->end_page_ptr == NULL) {
+        return NULL;
+    }
+    return do_slabs_alloc(engine, size, id);
+}
+
+/*
+ * Start moving the oldest page of slab class src to dst: take its free
+ * chunks off the freelist and stop carving chunks from it. From now on all
+ * free chunks of the page have ITEM_SLABBED set (see do_slabs_alloc()), and
+ * chunks freed on it are not reused.
+ */
+static void do_slabs_rebalance_start(struct default_engine *engine,
+                                     unsigned int src, unsigned int dst) {
+    slabclass_t *p = &engine->slabs.slabclass[src];
+    void *page = p->slab_list[0];
+    unsigned int ii, kept = 0;
+
+    p->killing = 1;
+    for (ii = 0; ii < p->sl_curr; ++ii) {
+        if (!slab_page_contains(engine, page, p->slots[ii])) {
+            p->slots[kept++] = p->slots[ii];
+        }
+    }
+    p->sl_curr = kept;
+
+    if (p->end_page_ptr != NULL && slab_page_contains(engine, page, p->end_page_ptr)) {
+        char *chunk = static_cast<char*>(p->end_page_ptr);
+        for (; p->end_page_free > 0; --p->end_page_free, chunk += p->size) {
+            reinterpret_cast<hash_item*>(chunk)->iflag |= ITEM_SLABBED;
+        }
+        p->end_page_ptr = NULL;
+    }
+
+    engine->slabs.rebalance.src = src;
+    engine->slabs.rebalance.dst = dst;
+    engine->slabs.rebalance.busy_passes = 0;
+}
+
+static bool do_slabs_automove(struct default_engine *engine, const uint64_t *evicted) {
+    const unsigned int windows = engine->config.slab_automove > 1 ? 1 : 3;
+    unsigned int id, src = 0, dst = 0;
+    uint64_t highest = 0;
+    rel_time_t now;
+
+#ifdef USE_SYSTEM_MALLOC
+    return false;
+#endif
+
+    if (engine->slabs.rebalance.src != 0) {
+        return true;
+    }
+    if (engine->config.slab_automove == 0) {
+        return false;
+    }
+
+    now = engine->server.core->get_current_time();
+    if (now < engine->slabs.rebalance.window_start + slab_automove_window) {
+        return false;
+    }
+    engine->slabs.rebalance.window_start = now;
+
+    for (id = POWER_SMALLEST; id <= engine->slabs.power_largest; id++) {
+        slabclass_t *p = &engine->slabs.slabclass[id];
+        /* The item stats may have been reset since the last window */
+        uint64_t delta = evicted[id] >= p->automove_evicted ?
+                         evicted[id] - p->automove_evicted : evicted[id];
+        p->automove_evicted = evicted[id];
+        if (delta == 0) {
+            p->automove_zero_windows++;
+        } else {
+            p->automove_zero_windows = 0;
+            if (delta > highest) {
+                highest = delta;
+                dst = id;
+            }
+        }
+    }
+
+    if (dst != 0 && dst == engine->slabs.rebalance.dst_candidate) {
+        engine->slabs.rebalance.dst_windows++;
+    } else {
+        engine->slabs.rebalance.dst_candidate = dst;
+        engine->slabs.rebalance.dst_windows = dst != 0 ? 1 : 0;
+    }
+    if (dst == 0 || engine->slabs.rebalance.dst_windows < windows) {
+        return false;
+    }
+
+    /* Take the page from the biggest class which hasn't had to evict */
+    for (id = POWER_SMALLEST; id <= engine->slabs.power_largest; id++) {
+        slabclass_t *p = &engine->slabs.slabclass[id];
+        if (p->automove_zero_windows >= windows && p->slabs > 1 &&
+            (src == 0 || p->slabs > engine->slabs.slabclass[src].slabs)) {
+            src = id;
+        }
+    }
+    if (src == 0) {
+        return false;
+    }
+
+    do_slabs_rebalance_start(engine, src, dst);
+    engine->slabs.rebalance.dst_windows = 0;
+    return true;
+}
+
+/* Carve a page freed up by the rebalancer into chunks of class dst */
+static void do_slabs_give_page(struct default_engine *engine,
+                               unsigned int dst, void *page) {
+    slabclass_t *p = &engine->slabs.slabclass[dst];
+    char *chunk = static_cast<char*>(page);
+    unsigned int ii;
+
+    memset(page, 0, engine->config.item_size_max);
+    p->slab_list[p->slabs++] = page;
+    if (p->end_page_ptr == NULL) {
+        p->end_page_ptr = page;
+        p->end_page_free = p->perslab;
+        return;
+    }
+    for (ii = 0; ii < p->perslab; ++ii, chunk += p->size) {
+        reinterpret_cast<hash_item*>(chunk)->iflag = ITEM_SLABBED;
+        if (!do_slabs_push_free(p, chunk)) {
+            return;
+        }
+    }
+}
+
+static bool do_slabs_rebalance_end(struct default_engine *engine, size_t rescues,
+                                   size_t evictions, size_t busy) {
+    auto& rebalance = engine->slabs.rebalance;
+    if (rebalance.src == 0) {
+        return true;
+    }
+
+    rebalance.rescues += rescues;
+    rebalance.evictions += evictions;
+    rebalance.busy_items += busy;
+
+    slabclass_t *p = &engine->slabs.slabclass[rebalance.src];
+    void *page = p->slab_list[p->killing - 1];
+
+    if (busy == 0 && grow_slab_list(engine, rebalance.dst) != 0) {
+        p->slab_list[p->killing - 1] = p->slab_list[--p->slabs];
+        p->killing = 0;
+        do_slabs_give_page(engine, rebalance.dst, page);
+        rebalance.pages_moved++;
+        rebalance.src = 0;
+        return true;
+    }
+
+    if (++rebalance.busy_passes < slab_rebalance_max_passes) {
+        return false;
+    }
+
+    /* Give up, and put the chunks freed so far back on the freelist */
+    char *chunk = static_cast<char*>(page);
+    for (unsigned int ii = 0; ii < p->perslab; ++ii, chunk += p->size) {
+        if ((reinterpret_cast<hash_item*>(chunk)->iflag & ITEM_SLABBED) != 0 &&
+            !do_slabs_push_free(p, chunk)) {
+            break;
+        }
+    }
+    p->killing = 0;
+    rebalance.src = 0;
+    return true;
+}
+
 void add_statistics(const void *cookie, ADD_STAT add_stats,
                     const char* prefix, int num, const char *key,
                     const char *fmt, ...) {
@@ -386,6 +596,16 @@ static void do_slabs_stats(struct default_engine *engine, ADD_STAT add_stats, co
     add_statistics(cookie, add_stats, NULL, -1, "active_slabs", "%d", total);
     add_statistics(cookie, add_stats, NULL, -1, "total_malloced", "%" PRIu64,
                    (uint64_t)engine->slabs.mem_malloced);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_running", "%u",
+                   engine->slabs.rebalance.src != 0 ? 1 : 0);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_pages_moved",
+                   "%" PRIu64, engine->slabs.rebalance.pages_moved);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_rescues",
+                   "%" PRIu64, engine->slabs.rebalance.rescues);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_evictions",
+                   "%" PRIu64, engine->slabs.rebalance.evictions);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_busy_items",
+                   "%" PRIu64, engine->slabs.rebalance.busy_items);
 }
 
 static void *memory_allocate(struct default_engine *engine, size_t size) {
@@ -426,12 +646,58 @@ void *slabs_alloc(struct default_engine *engine, size_t size, unsigned int id) {
     return ret;
 }
 
+void *slabs_alloc_free(struct default_engine *engine, size_t size, unsigned int id) {
+    void *ret;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    ret = do_slabs_alloc_free(engine, size, id);
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
 void slabs_free(struct default_engine *engine, void *ptr, size_t size, unsigned int id) {
     cb_mutex_enter(&engine->slabs.lock);
     do_slabs_free(engine, ptr, size, id);
     cb_mutex_exit(&engine->slabs.lock);
 }
 
+bool slabs_automove(struct default_engine *engine, const uint64_t *evicted) {
+    bool ret;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    ret = do_slabs_automove(engine, evicted);
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
+bool slabs_rebalance_page(struct default_engine *engine, unsigned int *id,
+                          char **page, unsigned int *perslab,
+                          unsigned int *size) {
+    bool ret = false;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    if (engine->slabs.rebalance.src != 0) {
+        slabclass_t *p = &engine->slabs.slabclass[engine->slabs.rebalance.src];
+        *id = engine->slabs.rebalance.src;
+        *page = static_cast<char*>(p->slab_list[p->killing - 1]);
+        *perslab = p->perslab;
+        *size = p->size;
+        ret = true;
+    }
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
+bool slabs_rebalance_end(struct default_engine *engine, size_t rescues,
+                         size_t evictions, size_t busy) {
+    bool ret;
+
+    cb_mutex_enter(&engine->slabs.lock);
+    ret = do_slabs_rebalance_end(engine, rescues, evictions, busy);
+    cb_mutex_exit(&engine->slabs.lock);
+    return ret;
+}
+
 void slabs_stats(struct default_engine *engine, ADD_STAT add_stats, const void *c) {
     cb_mutex_enter(&engine->slabs.lock);
     do_slabs_stats(engine, add_stats, c);
@@ -24,6 +24,9 @@ typedef struct {
 
     unsigned int killing;  /* index+1 of dying slab, or zero if none */
     size_t requested; /* The number of requested bytes */
+
+    uint64_t automove_evicted;          /* evictions seen at the last window */
+    unsigned int automove_zero_windows; /* windows in a row without any */
 } slabclass_t;
 
 struct slabs {
@@ -42,6 +45,25 @@ struct slabs {
       size_t size;
    } allocs;
 
+   /**
+    * State of the slab page rebalancer (see slabs_automove()). A page is
+    * moved from one slab class (src) to another (dst) by first taking it
+    * out of use (src's `killing` names it), then freeing all of its chunks
+    * and finally handing it over.
+    */
+   struct {
+      rel_time_t window_start;
+      unsigned int dst_candidate;  /* class with the most evictions */
+      unsigned int dst_windows;    /* windows in a row it has had them */
+      unsigned int src;            /* the move in progress, if src != 0 */
+      unsigned int dst;
+      unsigned int busy_passes;
+      uint64_t pages_moved;
+      uint64_t rescues;
+      uint64_t evictions;
+      uint64_t busy_items;
+   } rebalance;
+
    /**
     * Access to the slab allocator is protected by this lock
     */
@@ -74,12 +96,52 @@ unsigned int slabs_clsid(struct default_engine *engine, const size_t size);
 /** Allocate object of given length. 0 on error */ /*@null@*/
 void *slabs_alloc(struct default_engine *engine, size_t size, unsigned int id);
 
+/**
+ * Allocate object of given length from the free chunks of the slab class
+ * only (never a new slab page). 0 if there are none.
+ */
+void *slabs_alloc_free(struct default_engine *engine, size_t size, unsigned int id);
+
 /** Free previously allocated object */
 void slabs_free(struct default_engine *engine, void *ptr, size_t size, unsigned int id);
 
 /** Adjust the stats for memory requested */
 void slabs_adjust_mem_requested(struct default_engine *engine, unsigned int id, size_t old, size_t ntotal);
 
+/**
+ * Automatic slab page rebalancing: once per window, look at the number of
+ * evictions (from `evicted`, the running totals of each slab class) and
+ * decide whether to move a page from a class without evictions to the
+ * class with the most. How many windows in a row that has to be the case
+ * depends on the engine's slab_automove setting (0 disables it).
+ *
+ * @return true if a page move is in progress (see slabs_rebalance_page())
+ */
+bool slabs_automove(struct default_engine *engine, const uint64_t *evicted);
+
+/**
+ * Get the page being moved: the slab class it belongs to, its memory and
+ * the number and size of its chunks. The chunks are no longer handed out;
+ * the caller is to free (or relocate) the items on it, and report back
+ * with slabs_rebalance_end().
+ *
+ * @return false if there is no page move in progress
+ */
+bool slabs_rebalance_page(struct default_engine *engine, unsigned int *id,
+                          char **page, unsigned int *perslab,
+                          unsigned int *size);
+
+/**
+ * Finish (or retry later) the page move in progress after a pass over the
+ * page. `busy` is the number of chunks still in use; if there are none the
+ * page is handed to its new slab class. A move whose page stays busy for
+ * too long is given up.
+ *
+ * @return true if the move has ended
+ */
+bool slabs_rebalance_end(struct default_engine *engine, size_t rescues,
+                         size_t evictions, size_t busy);
+
 /** Fill buffer with stats */ /*@null@*/
 void slabs_stats(struct default_engine *engine, ADD_STAT add_stats, const void *c);
 
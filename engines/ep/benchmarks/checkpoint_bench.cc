@@ -0,0 +1,313 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the checkpoint queue and key index, comparing the chunked
+ * queue + open-addressing index against the previous std::list +
+ * std::unordered_map representation (modelled below), and of draining
+ * cursors item-by-item versus in batches.
+ */
+
+#include "benchmark_memory_tracker.h"
+#include "checkpoint.h"
+#include "engine_fixture.h"
+#include "item.h"
+#include "kv_bucket.h"
+#include "tests/module_tests/test_helpers.h"
+#include "vbucket.h"
+
+#include <benchmark/benchmark.h>
+#include <gtest/gtest.h>
+#include <mock/mock_synchronous_ep_engine.h>
+#include <programs/engine_testapp/mock_server.h>
+#include <valgrind/valgrind.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+
+/**
+ * The queue and index layout used by Checkpoint before the chunked queue:
+ * every item is a list node, and the index holds a copy of every key.
+ */
+class ListCheckpointModel {
+public:
+    void queueDirty(const queued_item& qi) {
+        auto it = index.find(qi->getKey());
+        if (it != index.end()) {
+            toWrite.erase(it->second.position);
+        }
+        toWrite.push_back(qi);
+        IndexEntry entry = {--toWrite.end(), qi->getBySeqno()};
+        if (it != index.end()) {
+            it->second = entry;
+        } else {
+            index.emplace(qi->getKey(), entry);
+        }
+    }
+
+    size_t size() const {
+        return toWrite.size();
+    }
+
+private:
+    struct IndexEntry {
+        std::list<queued_item>::iterator position;
+        int64_t mutation_id;
+    };
+
+    std::list<queued_item> toWrite;
+    std::unordered_map<StoredDocKey, IndexEntry> index;
+};
+
+/**
+ * Mirrors the queue / index maintenance done by Checkpoint::queueDirty.
+ */
+class ChunkedCheckpointModel {
+public:
+    ChunkedCheckpointModel() : index(toWrite) {
+    }
+
+    void queueDirty(const queued_item& qi) {
+        auto* existing = index.find(qi->getKey());
+        if (existing) {
+            toWrite.erase(toWrite.makeIterator(existing->position));
+        }
+        const CheckpointIndex::Entry entry = {toWrite.push_back(qi),
+                                              qi->getBySeqno()};
+        if (existing) {
+            *existing = entry;
+        } else {
+            index.insert(qi->getKey(), entry);
+        }
+        if (toWrite.needsCompaction()) {
+            index.remap(toWrite.compact());
+        }
+    }
+
+    size_t size() const {
+        return toWrite.size();
+    }
+
+private:
+    CheckpointQueue toWrite;
+    CheckpointIndex index;
+};
+
+class CheckpointBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+
+        // The first parameter is the number of distinct keys the mutations
+        // are spread over; fewer keys means more de-duplication.
+        const size_t numKeys = state.range(0);
+        const size_t numMutations = RUNNING_ON_VALGRIND ? 100 : 100000;
+        for (size_t i = 0; i < numMutations; i++) {
+            items.emplace_back(new Item(
+                    makeStoredDocKey("checkpoint_key_" +
+                                     std::to_string(i % numKeys)),
+                    0,
+                    queue_op::mutation,
+                    /*revSeq*/ 0,
+                    /*bySeq*/ i + 1));
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        items.clear();
+        memoryTracker->destroyInstance();
+    }
+
+protected:
+    /**
+     * Queue all items into a fresh Model each iteration, recording the
+     * throughput and the memory overhead (excluding the items themselves)
+     * per queued item.
+     */
+    template <typename Model>
+    void queueItems(benchmark::State& state) {
+        size_t bytesPerItem = 0;
+        while (state.KeepRunning()) {
+            memoryTracker->reset();
+            const size_t baseBytes = memoryTracker->getCurrentAlloc();
+            Model model;
+            for (const auto& qi : items) {
+                model.queueDirty(qi);
+            }
+            bytesPerItem = (memoryTracker->getCurrentAlloc() - baseBytes) /
+                           model.size();
+        }
+        state.SetItemsProcessed(state.iterations() * items.size());
+        state.counters["BytesPerItem"] = bytesPerItem;
+    }
+
+    BenchmarkMemoryTracker* memoryTracker = nullptr;
+    std::vector<queued_item> items;
+};
+
+BENCHMARK_DEFINE_F(CheckpointBench, QueueDirtyList)(benchmark::State& state) {
+    queueItems<ListCheckpointModel>(state);
+}
+
+BENCHMARK_DEFINE_F(CheckpointBench, QueueDirtyChunked)
+(benchmark::State& state) {
+    queueItems<ChunkedCheckpointModel>(state);
+}
+
+static void NumKeys(benchmark::internal::Benchmark* b) {
+    // All unique, some de-duplication, heavy de-duplication.
+    for (int numKeys : {100000, 10000, 100}) {
+        b->Arg(numKeys);
+    }
+}
+
+BENCHMARK_REGISTER_F(CheckpointBench, QueueDirtyList)->Apply(NumKeys);
+BENCHMARK_REGISTER_F(CheckpointBench, QueueDirtyChunked)->Apply(NumKeys);
+
+/**
+ * Drains a number of DCP-style cursors over the checkpoints of a single
+ * vBucket. Every CheckpointManager call holds the queueLock for its whole
+ * duration, so the time taken by each call is the lock hold time.
+ */
+class CheckpointCursorBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(vbid, vbucket_state_active,
+                                               false);
+        vb = engine->getKVBucket()->getVBucket(vbid);
+
+        // The first parameter is the number of cursors.
+        for (int i = 0; i < state.range(0); i++) {
+            const std::string name = "bench_cursor_" + std::to_string(i);
+            cursors.push_back(
+                    vb->checkpointManager
+                            ->registerCursorBySeqno(
+                                    name, 0, MustSendCheckpointEnd::NO)
+                            .cursor);
+        }
+
+        const int numItems = RUNNING_ON_VALGRIND ? 100 : 10000;
+        const std::string value(100, 'x');
+        for (int i = 0; i < numItems; i++) {
+            auto item = make_item(vbid, "key" + std::to_string(i), value);
+            ASSERT_EQ(ENGINE_SUCCESS, engine->getKVBucket()->set(item, cookie));
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        cursors.clear();
+        vb.reset();
+        EngineFixture::TearDown(state);
+    }
+
+    /// Move every cursor back to the start of the checkpoints.
+    void rewindCursors() {
+        for (size_t i = 0; i < cursors.size(); i++) {
+            const std::string name = "bench_cursor_" + std::to_string(i);
+            vb->checkpointManager->registerCursorBySeqno(
+                    name, 0, MustSendCheckpointEnd::NO);
+        }
+    }
+
+    /**
+     * Drain all cursors each iteration, calling drainOnce(cursor, items)
+     * until it returns false, and report items/sec plus the average and
+     * maximum time of a single call (i.e. lock hold).
+     */
+    template <typename DrainOnce>
+    void drainCursors(benchmark::State& state, DrainOnce drainOnce) {
+        size_t itemsDrained = 0;
+        size_t calls = 0;
+        std::chrono::nanoseconds totalHold{0};
+        std::chrono::nanoseconds maxHold{0};
+        std::vector<queued_item> items;
+        while (state.KeepRunning()) {
+            state.PauseTiming();
+            rewindCursors();
+            state.ResumeTiming();
+
+            for (const auto& cursor : cursors) {
+                bool more = true;
+                while (more) {
+                    const auto start = ProcessClock::now();
+                    more = drainOnce(cursor, items);
+                    const auto hold = ProcessClock::now() - start;
+                    totalHold += hold;
+                    maxHold = std::max(
+                            maxHold,
+                            std::chrono::duration_cast<
+                                    std::chrono::nanoseconds>(hold));
+                    ++calls;
+                    itemsDrained += items.size();
+                    items.clear();
+                }
+            }
+        }
+        state.SetItemsProcessed(itemsDrained);
+        state.counters["LockAcquisitions"] = calls / state.iterations();
+        state.counters["AvgLockHoldNs"] = totalHold.count() / calls;
+        state.counters["MaxLockHoldNs"] = maxHold.count();
+    }
+
+    VBucketPtr vb;
+    std::vector<CursorHandle> cursors;
+};
+
+BENCHMARK_DEFINE_F(CheckpointCursorBench, NextItem)(benchmark::State& state) {
+    auto& manager = *vb->checkpointManager;
+    drainCursors(state,
+                 [&manager](CursorHandle cursor,
+                            std::vector<queued_item>& items) {
+                     bool isLastMutationItem;
+                     auto qi = manager.nextItem(cursor, isLastMutationItem);
+                     if (qi->getOperation() == queue_op::empty) {
+                         return false;
+                     }
+                     items.push_back(qi);
+                     return true;
+                 });
+}
+
+BENCHMARK_DEFINE_F(CheckpointCursorBench, GetItemsForCursor)
+(benchmark::State& state) {
+    auto& manager = *vb->checkpointManager;
+    const auto& config = manager.getCheckpointConfig();
+    drainCursors(state,
+                 [&manager, &config](CursorHandle cursor,
+                                     std::vector<queued_item>& items) {
+                     return manager
+                             .getItemsForCursor(cursor,
+                                                items,
+                                                config.getCursorBatchItems(),
+                                                config.getCursorBatchBytes())
+                             .moreAvailable;
+                 });
+}
+
+static void NumCursors(benchmark::internal::Benchmark* b) {
+    for (int numCursors : {1, 200, 400}) {
+        b->Arg(numCursors);
+    }
+}
+
+BENCHMARK_REGISTER_F(CheckpointCursorBench, NextItem)->Apply(NumCursors);
+BENCHMARK_REGISTER_F(CheckpointCursorBench, GetItemsForCursor)
+        ->Apply(NumCursors);
@@ -0,0 +1,162 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of random BG-fetch style reads through IoUringFileOps: one
+ * synchronous pread() per document (as couchstore issues them) versus
+ * prefetching the whole batch with io_uring first.
+ *
+ * Each iteration reads a batch of documents at random (sorted, as
+ * CouchKVStore::getMulti orders them) offsets of a test file; optionally
+ * the file is dropped from the page cache before each batch so the reads
+ * go to the device.
+ */
+
+#include "couch-kvstore/couch-fs-uring.h"
+#include "kvstore.h"
+
+#include <benchmark/benchmark.h>
+#include <valgrind/valgrind.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <vector>
+
+class CouchFsUringBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        fileSize = RUNNING_ON_VALGRIND ? (4 << 20) : (256 << 20);
+
+        // Fill the file with non-zero data so it is really allocated.
+        couchstore_error_info_t errinfo;
+        auto& ops = *couchstore_get_default_file_ops();
+        auto handle = ops.constructor(&errinfo);
+        ops.open(&errinfo, &handle, fileName, O_RDWR | O_CREAT);
+        std::vector<char> chunk(1 << 20, 'x');
+        for (size_t offset = 0; offset < fileSize; offset += chunk.size()) {
+            ops.pwrite(&errinfo, handle, chunk.data(), chunk.size(), offset);
+        }
+        ops.sync(&errinfo, handle);
+        ops.close(&errinfo, handle);
+        ops.destructor(handle);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        std::remove(fileName);
+    }
+
+protected:
+    /**
+     * Read batches of `state.range(0)` documents of `docSize` bytes;
+     * state.range(1) non-zero drops the file from the page cache before
+     * each batch.
+     */
+    void readBatches(benchmark::State& state, bool prefetch) {
+        const size_t batchSize = state.range(0);
+        const bool cold = state.range(1) != 0;
+
+        FileStats stats;
+        IoUringFileOps ops(stats, *couchstore_get_default_file_ops(), 64);
+        if (prefetch && !ops.isAsync()) {
+            state.SkipWithError("io_uring not available");
+            return;
+        }
+
+        couchstore_error_info_t errinfo;
+        auto handle = ops.constructor(&errinfo);
+        ops.open(&errinfo, &handle, fileName, O_RDONLY);
+
+        std::mt19937_64 gen(1234);
+        std::uniform_int_distribution<cs_off_t> dist(0, fileSize - docSize);
+        std::vector<cs_off_t> offsets(batchSize);
+        std::vector<IoUringFileOps::Range> ranges(batchSize);
+        std::vector<char> buf(docSize);
+
+        size_t reads = 0;
+        std::chrono::nanoseconds elapsed{0};
+        while (state.KeepRunning()) {
+            state.PauseTiming();
+            for (auto& offset : offsets) {
+                offset = dist(gen);
+            }
+            std::sort(offsets.begin(), offsets.end());
+            if (cold) {
+                ops.advise(&errinfo,
+                           handle,
+                           0,
+                           fileSize,
+                           COUCHSTORE_FILE_ADVICE_DONTNEED);
+            }
+            state.ResumeTiming();
+
+            const auto start = std::chrono::steady_clock::now();
+            if (prefetch) {
+                for (size_t ii = 0; ii < batchSize; ++ii) {
+                    ranges[ii] = {offsets[ii], docSize};
+                }
+                ops.prefetch(fileName, ranges);
+            }
+            for (auto offset : offsets) {
+                ops.pread(&errinfo, handle, buf.data(), docSize, offset);
+            }
+            elapsed += std::chrono::steady_clock::now() - start;
+            reads += batchSize;
+        }
+
+        ops.close(&errinfo, handle);
+        ops.destructor(handle);
+
+        const double seconds =
+                std::chrono::duration<double>(elapsed).count();
+        state.SetItemsProcessed(reads);
+        state.counters["IOPS"] = seconds > 0 ? reads / seconds : 0;
+        state.counters["BatchLatencyUs"] =
+                state.iterations() > 0
+                        ? 1e6 * seconds / state.iterations()
+                        : 0;
+    }
+
+    static constexpr const char* fileName = "couch_fs_uring_bench.data";
+    static const size_t docSize = 1024;
+    size_t fileSize = 0;
+};
+
+constexpr const char* CouchFsUringBench::fileName;
+const size_t CouchFsUringBench::docSize;
+
+BENCHMARK_DEFINE_F(CouchFsUringBench, SyncRead)(benchmark::State& state) {
+    readBatches(state, false);
+}
+
+BENCHMARK_DEFINE_F(CouchFsUringBench, IoUringRead)(benchmark::State& state) {
+    readBatches(state, true);
+}
+
+static void BatchArgs(benchmark::internal::Benchmark* b) {
+    for (int cold : {0, 1}) {
+        for (int batch : {1, 16, 64, 256}) {
+            b->Args({batch, cold});
+        }
+    }
+    b->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_REGISTER_F(CouchFsUringBench, SyncRead)->Apply(BatchArgs);
+BENCHMARK_REGISTER_F(CouchFsUringBench, IoUringRead)->Apply(BatchArgs);
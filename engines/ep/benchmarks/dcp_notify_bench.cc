@@ -0,0 +1,155 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmark of the front-end cost of a SET against a vBucket streamed by a
+ * number of DCP producers, with seqno notifications fanned out to the
+ * producers inline (by the thread doing the SET) or batched through the
+ * connection notifier (dcp_batch_seqno_notifications).
+ *
+ * Between SETs the producers drain their streams, as if they keep up with
+ * the mutation rate, so every SET finds them idle and has to notify them.
+ * Only the SET itself is timed; the deferred fan-out is reported separately
+ * as FanOutNs.
+ */
+
+#include "dcp/dcpconnmap.h"
+#include "engine_fixture.h"
+#include "kv_bucket.h"
+
+#include <mock/mock_dcp_producer.h>
+#include <mock/mock_synchronous_ep_engine.h>
+#include <programs/engine_testapp/mock_server.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class DcpNotifyBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        // The second parameter selects batched notifications.
+        if (state.range(1) != 0) {
+            varConfig = "dcp_batch_seqno_notifications=true";
+        }
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(vbid, vbucket_state_active,
+                                               false);
+
+        // The first parameter is the number of producers streaming vbid.
+        for (int i = 0; i < state.range(0); i++) {
+            const void* producerCookie = create_mock_cookie();
+            auto producer = std::make_shared<MockDcpProducer>(
+                    *engine,
+                    producerCookie,
+                    "bench_producer_" + std::to_string(i),
+                    /*flags*/ 0,
+                    cb::const_byte_buffer() /*no json*/);
+            uint64_t rollbackSeqno;
+            ASSERT_EQ(ENGINE_SUCCESS,
+                      producer->streamRequest(/*flags*/ 0,
+                                              /*opaque*/ 0,
+                                              vbid,
+                                              /*start_seqno*/ 0,
+                                              /*end_seqno*/ ~0ull,
+                                              /*vb_uuid*/ 0,
+                                              /*snap_start*/ 0,
+                                              /*snap_end*/ 0,
+                                              &rollbackSeqno,
+                                              fakeDcpAddFailoverLog));
+            producerCookies.push_back(producerCookie);
+            producers.push_back(producer);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        for (auto& producer : producers) {
+            engine->getDcpConnMap().removeVBConnections(*producer);
+            producer->closeAllStreams();
+            producer->clearCheckpointProcessorTaskQueues();
+        }
+        producers.clear();
+        for (auto* producerCookie : producerCookies) {
+            destroy_mock_cookie(producerCookie);
+        }
+        producerCookies.clear();
+        EngineFixture::TearDown(state);
+    }
+
+    static ENGINE_ERROR_CODE fakeDcpAddFailoverLog(
+            vbucket_failover_t* entry,
+            size_t nentries,
+            gsl::not_null<const void*> cookie) {
+        return ENGINE_SUCCESS;
+    }
+
+    std::vector<const void*> producerCookies;
+    std::vector<std::shared_ptr<MockDcpProducer>> producers;
+};
+
+/*
+ * Variables:
+ *  - range(0) : Number of DCP producers streaming the vBucket
+ *  - range(1) : Notification mode (0: inline, 1: batched)
+ */
+BENCHMARK_DEFINE_F(DcpNotifyBench, SetLatency)(benchmark::State& state) {
+    state.SetLabel(state.range(1) != 0 ? "Batched" : "Inline");
+    auto& connMap = engine->getDcpConnMap();
+    const std::string value(100, 'x');
+
+    // Cycle over a fixed set of keys so the checkpoint de-duplicates them
+    // rather than growing with the number of iterations.
+    const size_t numKeys = 1000;
+    size_t next = 0;
+    std::chrono::nanoseconds fanOutTime{0};
+    while (state.KeepRunning()) {
+        auto item = make_item(
+                vbid, "key" + std::to_string(next++ % numKeys), value);
+
+        const auto start = std::chrono::steady_clock::now();
+        engine->getKVBucket()->set(item, cookie);
+        const auto end = std::chrono::steady_clock::now();
+        state.SetIterationTime(
+                std::chrono::duration<double>(end - start).count());
+
+        // Run the deferred fan-out, as the connection notifier would.
+        connMap.processPendingNotifications();
+        fanOutTime += std::chrono::steady_clock::now() - end;
+
+        for (auto& producer : producers) {
+            producer->drainReadyQueue();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["FanOutNs"] =
+            state.iterations() > 0
+                    ? double(fanOutTime.count()) / state.iterations()
+                    : 0;
+}
+
+static void ProducerArgs(benchmark::internal::Benchmark* b) {
+    for (int batched : {0, 1}) {
+        for (int producers : {0, 1, 4, 16, 40}) {
+            b->Args({producers, batched});
+        }
+    }
+    b->UseManualTime();
+}
+
+BENCHMARK_REGISTER_F(DcpNotifyBench, SetLatency)->Apply(ProducerArgs);
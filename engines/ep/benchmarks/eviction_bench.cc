@@ -0,0 +1,255 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Cache hit-rate simulation of the ItemPager eviction policies (NRU and
+ * TinyLFU) under Zipfian access traces.
+ *
+ * A cache of `capacity` resident items is driven by the trace; a miss makes
+ * the key resident (as a BG fetch would). Whenever the resident count
+ * exceeds the capacity (the high watermark) the pager makes passes over all
+ * keys, in hash table order, until the resident count is below 90% of the
+ * capacity (the low watermark), applying the same per-item decisions as
+ * PagingVisitor for the policy being modelled.
+ */
+
+#include "frequency_sketch.h"
+#include "item.h"
+#include "item_eviction.h"
+#include "item_pager.h"
+#include "stored-value.h"
+
+#include <benchmark/benchmark.h>
+#include <valgrind/valgrind.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+/// Hash of a key id, standing in for DocKey::hash().
+static uint32_t keyHash(uint32_t key) {
+    return key * 2654435761u;
+}
+
+/**
+ * Model of the NRU policy: a 2-bit NRU value per item, decremented on
+ * access; the pager alternates between evicting unreferenced (max NRU) items
+ * and ageing every item while randomly evicting those that become
+ * unreferenced.
+ */
+class NRUModel {
+public:
+    explicit NRUModel(size_t numKeys) : nru(numKeys, INITIAL_NRU_VALUE) {
+    }
+
+    void onHit(uint32_t key) {
+        if (nru[key] > MIN_NRU_VALUE) {
+            --nru[key];
+        }
+    }
+
+    void onMiss(uint32_t key) {
+        nru[key] = INITIAL_NRU_VALUE;
+    }
+
+    void beginPass() {
+    }
+
+    bool shouldEvict(uint32_t key, double percent, double r) {
+        if (phase == PAGING_UNREFERENCED) {
+            return nru[key] == MAX_NRU_VALUE;
+        }
+        if (nru[key] < MAX_NRU_VALUE) {
+            ++nru[key];
+        }
+        return nru[key] == MAX_NRU_VALUE && r <= percent;
+    }
+
+    void endPass() {
+        phase = (phase == PAGING_UNREFERENCED) ? PAGING_RANDOM
+                                               : PAGING_UNREFERENCED;
+    }
+
+private:
+    std::vector<uint8_t> nru;
+    item_pager_phase phase = PAGING_UNREFERENCED;
+};
+
+/**
+ * Model of the TinyLFU policy: as HashTable::recordAccess /
+ * unlocked_addNewStoredValue and PagingVisitor::evictByFrequency.
+ */
+class TinyLFUModel {
+public:
+    explicit TinyLFUModel(size_t numKeys)
+        : freq(numKeys, StoredValue::initialFreqCount), sketch(numKeys) {
+    }
+
+    void onHit(uint32_t key) {
+        sketch.increment(keyHash(key));
+        freq[key] = ItemEviction::incrFreqCounter(freq[key]);
+        if (freq[key] == std::numeric_limits<uint8_t>::max()) {
+            saturated = true;
+        }
+    }
+
+    void onMiss(uint32_t key) {
+        // The lookup which missed is recorded, then the fetched item is
+        // admitted with its historic frequency.
+        sketch.increment(keyHash(key));
+        freq[key] = StoredValue::initialFreqCount +
+                    sketch.frequency(keyHash(key));
+    }
+
+    void beginPass() {
+        decay = saturated;
+        saturated = false;
+        itemEviction.reset();
+    }
+
+    bool shouldEvict(uint32_t key, double percent, double r) {
+        if (decay) {
+            freq[key] /= 2;
+        }
+        itemEviction.addFreqValue(freq[key]);
+        if (itemEviction.getPopulation() % ItemEviction::learningPopulation ==
+            0) {
+            threshold = itemEviction.getFreqThreshold(percent);
+        }
+        return ItemEviction::shouldEvict(freq[key], threshold, r);
+    }
+
+    void endPass() {
+    }
+
+private:
+    std::vector<uint8_t> freq;
+    FrequencySketch sketch;
+    ItemEviction itemEviction;
+    ItemEviction::Threshold threshold;
+    bool saturated = false;
+    bool decay = false;
+};
+
+class EvictionBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        // The first parameter is the Zipf exponent (x100).
+        const double skew = state.range(0) / 100.0;
+        numKeys = RUNNING_ON_VALGRIND ? 1000 : 100000;
+        capacity = numKeys / 10;
+        const size_t traceLength = numKeys * 10;
+
+        std::mt19937 gen(1234);
+        std::vector<double> cdf(numKeys);
+        double sum = 0;
+        for (size_t rank = 0; rank < numKeys; ++rank) {
+            sum += 1.0 / std::pow(rank + 1, skew);
+            cdf[rank] = sum;
+        }
+        std::uniform_real_distribution<double> dist(0, sum);
+        trace.reserve(traceLength);
+        for (size_t ii = 0; ii < traceLength; ++ii) {
+            trace.push_back(
+                    std::lower_bound(cdf.begin(), cdf.end(), dist(gen)) -
+                    cdf.begin());
+        }
+
+        // Hash table order is unrelated to popularity.
+        pagerOrder.resize(numKeys);
+        std::iota(pagerOrder.begin(), pagerOrder.end(), 0);
+        std::shuffle(pagerOrder.begin(), pagerOrder.end(), gen);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        trace.clear();
+        pagerOrder.clear();
+    }
+
+protected:
+    template <typename Model>
+    void simulate(benchmark::State& state) {
+        size_t hits = 0;
+        size_t accesses = 0;
+        while (state.KeepRunning()) {
+            Model model(numKeys);
+            std::vector<bool> resident(numKeys, false);
+            size_t numResident = 0;
+            std::mt19937 gen(5678);
+            std::uniform_real_distribution<double> dist(0, 1);
+
+            for (auto key : trace) {
+                ++accesses;
+                if (resident[key]) {
+                    ++hits;
+                    model.onHit(key);
+                    continue;
+                }
+                model.onMiss(key);
+                resident[key] = true;
+                if (++numResident <= capacity) {
+                    continue;
+                }
+
+                // Above the high watermark; page out to the low watermark.
+                const size_t lowWat = capacity * 9 / 10;
+                for (int pass = 0; pass < 10 && numResident > lowWat;
+                     ++pass) {
+                    const double percent =
+                            double(numResident - lowWat) / numResident;
+                    model.beginPass();
+                    for (auto candidate : pagerOrder) {
+                        if (resident[candidate] &&
+                            model.shouldEvict(candidate, percent, dist(gen))) {
+                            resident[candidate] = false;
+                            --numResident;
+                        }
+                    }
+                    model.endPass();
+                }
+            }
+        }
+        state.SetItemsProcessed(accesses);
+        state.counters["HitRatePct"] = 100.0 * hits / accesses;
+    }
+
+    size_t numKeys = 0;
+    size_t capacity = 0;
+    std::vector<uint32_t> trace;
+    std::vector<uint32_t> pagerOrder;
+};
+
+BENCHMARK_DEFINE_F(EvictionBench, NRU)(benchmark::State& state) {
+    simulate<NRUModel>(state);
+}
+
+BENCHMARK_DEFINE_F(EvictionBench, TinyLFU)(benchmark::State& state) {
+    simulate<TinyLFUModel>(state);
+}
+
+static void ZipfSkew(benchmark::internal::Benchmark* b) {
+    for (int skew : {60, 80, 99, 120}) {
+        b->Arg(skew);
+    }
+    b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_REGISTER_F(EvictionBench, NRU)->Apply(ZipfSkew);
+BENCHMARK_REGISTER_F(EvictionBench, TinyLFU)->Apply(ZipfSkew);
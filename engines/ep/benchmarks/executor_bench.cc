@@ -0,0 +1,221 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the ExecutorPool scheduler: the default shared-queue mode
+ * versus work-stealing mode (executor_work_stealing).
+ *
+ * Each iteration schedules a batch of short NonIO tasks on a pool with two
+ * threads of each type and waits for them all to run. Optionally the batch
+ * also contains long running NonIO tasks which tie up the NonIO threads,
+ * leaving the short tasks to be borrowed by idle threads of other types.
+ *
+ * Reports the task throughput (items/s) and the mean and maximum dispatch
+ * latency - the time from a task being due to it starting to run, as
+ * reported to Taskable::logQTime().
+ */
+
+#include <executorpool.h>
+#include <globaltask.h>
+#include <taskable.h>
+#include <workload.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class BenchTaskable : public Taskable {
+public:
+    BenchTaskable() : policy(HIGH_BUCKET_PRIORITY, 1) {
+    }
+
+    const std::string& getName() const override {
+        return name;
+    }
+
+    task_gid_t getGID() const override {
+        return 0;
+    }
+
+    bucket_priority_t getWorkloadPriority() const override {
+        return HIGH_BUCKET_PRIORITY;
+    }
+
+    void setWorkloadPriority(bucket_priority_t prio) override {
+    }
+
+    WorkLoadPolicy& getWorkLoadPolicy() override {
+        return policy;
+    }
+
+    void logQTime(TaskId id, const ProcessClock::duration enqTime) override {
+        const uint64_t ns =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(enqTime)
+                        .count();
+        totalQTime += ns;
+        ++numQTimes;
+        uint64_t max = maxQTime;
+        while (ns > max && !maxQTime.compare_exchange_weak(max, ns)) {
+        }
+    }
+
+    void logRunTime(TaskId id, const ProcessClock::duration runTime) override {
+    }
+
+    std::atomic<uint64_t> totalQTime{0};
+    std::atomic<uint64_t> numQTimes{0};
+    std::atomic<uint64_t> maxQTime{0};
+
+private:
+    const std::string name = "executor_bench";
+    WorkLoadPolicy policy;
+};
+
+class BenchExecutorPool : public ExecutorPool {
+public:
+    BenchExecutorPool(bool workStealing)
+        : ExecutorPool(8, NUM_TASK_GROUPS, 2, 2, 2, 2, workStealing) {
+    }
+
+    ~BenchExecutorPool() = default;
+};
+
+/// Counts down the tasks of a batch, waking the benchmark thread at zero.
+class Batch {
+public:
+    void start(size_t tasks) {
+        std::lock_guard<std::mutex> lh(mutex);
+        remaining = tasks;
+    }
+
+    void taskDone() {
+        std::lock_guard<std::mutex> lh(mutex);
+        if (--remaining == 0) {
+            cv.notify_one();
+        }
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lh(mutex);
+        cv.wait(lh, [this] { return remaining == 0; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t remaining = 0;
+};
+
+class BenchTask : public GlobalTask {
+public:
+    BenchTask(Taskable& t,
+              Batch& batch,
+              std::chrono::microseconds duration,
+              std::chrono::microseconds expectedDuration)
+        : GlobalTask(t, TaskId::ItemPager, 0, true),
+          batch(batch),
+          duration(duration),
+          expectedDuration(expectedDuration) {
+    }
+
+    bool run() override {
+        if (duration.count() > 0) {
+            std::this_thread::sleep_for(duration);
+        }
+        batch.taskDone();
+        return false;
+    }
+
+    cb::const_char_buffer getDescription() override {
+        return "Executor benchmark task";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() override {
+        return expectedDuration;
+    }
+
+private:
+    Batch& batch;
+    const std::chrono::microseconds duration;
+    const std::chrono::microseconds expectedDuration;
+};
+
+/*
+ * Variables:
+ *  - range(0) : Scheduler mode (0: shared queues, 1: work stealing)
+ *  - range(1) : Number of short tasks per batch
+ *  - range(2) : Number of long running (2ms) tasks per batch
+ */
+static void BM_ExecutorDispatch(benchmark::State& state) {
+    const bool workStealing = state.range(0) != 0;
+    const size_t numShort = state.range(1);
+    const size_t numLong = state.range(2);
+    state.SetLabel(workStealing ? "WorkStealing" : "SharedQueues");
+
+    BenchTaskable taskable;
+    std::unique_ptr<BenchExecutorPool> pool(
+            new BenchExecutorPool(workStealing));
+    pool->registerTaskable(taskable);
+
+    Batch batch;
+    size_t tasksRun = 0;
+    while (state.KeepRunning()) {
+        batch.start(numShort + numLong);
+        for (size_t i = 0; i < numLong; ++i) {
+            pool->schedule(std::make_shared<BenchTask>(
+                    taskable,
+                    batch,
+                    std::chrono::milliseconds(2),
+                    std::chrono::seconds(1)));
+        }
+        for (size_t i = 0; i < numShort; ++i) {
+            pool->schedule(std::make_shared<BenchTask>(
+                    taskable,
+                    batch,
+                    std::chrono::microseconds(0),
+                    std::chrono::milliseconds(1)));
+        }
+        batch.wait();
+        tasksRun += numShort + numLong;
+    }
+    state.SetItemsProcessed(tasksRun);
+
+    pool->unregisterTaskable(taskable, false);
+
+    const uint64_t numQTimes = taskable.numQTimes;
+    state.counters["MeanDispatchUs"] =
+            numQTimes ? (taskable.totalQTime / 1000.0) / numQTimes : 0;
+    state.counters["MaxDispatchUs"] = taskable.maxQTime / 1000.0;
+}
+
+static void ExecutorDispatchArguments(benchmark::internal::Benchmark* b) {
+    for (int stealing : {0, 1}) {
+        for (int numShort : {100, 1000}) {
+            for (int numLong : {0, 2}) {
+                b->Args({stealing, numShort, numLong});
+            }
+        }
+    }
+    b->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+BENCHMARK(BM_ExecutorDispatch)->Apply(ExecutorDispatchArguments);
@@ -0,0 +1,159 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks comparing the Chained and Bucketized HashTable layouts.
+ */
+
+#include "hash_table.h"
+#include "item.h"
+#include "stats.h"
+#include "stored_value_factories.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <benchmark/benchmark.h>
+#include <gtest/gtest.h>
+#include <valgrind/valgrind.h>
+
+#include <algorithm>
+#include <random>
+
+class HashTableBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        // The first parameter specifies the layout:
+        HashTable::Layout layout;
+        switch (state.range(0)) {
+        case 0:
+            state.SetLabel("Chained");
+            layout = HashTable::Layout::Chained;
+            break;
+        case 1:
+            state.SetLabel("Bucketized");
+            layout = HashTable::Layout::Bucketized;
+            break;
+        default:
+            FAIL() << "Invalid input param(0) value:" << state.range(0);
+        }
+
+        // The second parameter is the load factor (items per hash bucket)
+        // the table is sized for; higher values mean longer chains.
+        const size_t loadFactor = state.range(1);
+        const size_t numItems = RUNNING_ON_VALGRIND ? 100 : 1000000;
+
+        ht = std::make_unique<HashTable>(
+                stats,
+                std::make_unique<StoredValueFactory>(stats),
+                std::max(size_t(1), numItems / loadFactor),
+                /*locks*/ 47,
+                layout);
+
+        const std::string value(32, 'x');
+        for (size_t i = 0; i < numItems; i++) {
+            keys.push_back(makeStoredDocKey("key" + std::to_string(i)));
+            Item item(keys.back(), 0, 0, value.data(), value.size());
+            ASSERT_EQ(MutationStatus::WasClean, ht->set(item));
+        }
+
+        // Access in random order so consecutive lookups don't share cache
+        // lines.
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(1234));
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        keys.clear();
+        ht.reset();
+    }
+
+protected:
+    EPStats stats;
+    std::unique_ptr<HashTable> ht;
+    std::vector<StoredDocKey> keys;
+};
+
+/*
+ * Lookup of keys which exist in the HashTable.
+ */
+BENCHMARK_DEFINE_F(HashTableBench, FindHit)(benchmark::State& state) {
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(ht->find(
+                keys[i], TrackReference::No, WantsDeleted::No));
+        if (++i == keys.size()) {
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["HTMemoryBytes"] = ht->memorySize();
+}
+
+/*
+ * Lookup of keys which do not exist in the HashTable - the whole bucket
+ * must be searched.
+ */
+BENCHMARK_DEFINE_F(HashTableBench, FindMiss)(benchmark::State& state) {
+    std::vector<StoredDocKey> missing;
+    for (size_t i = 0; i < 10000; i++) {
+        missing.push_back(makeStoredDocKey("missing" + std::to_string(i)));
+    }
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(ht->find(
+                missing[i], TrackReference::No, WantsDeleted::No));
+        if (++i == missing.size()) {
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Full pauseResumeVisit of the HashTable (as used by the pagers and
+ * defragmenter), to check the Bucketized layout doesn't regress visiting.
+ */
+BENCHMARK_DEFINE_F(HashTableBench, Visit)(benchmark::State& state) {
+    class CountingVisitor : public HashTableVisitor {
+    public:
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            ++visited;
+            return true;
+        }
+        size_t visited = 0;
+    } visitor;
+
+    while (state.KeepRunning()) {
+        HashTable::Position pos;
+        while (pos != ht->endPosition()) {
+            pos = ht->pauseResumeVisit(visitor, pos);
+        }
+    }
+    state.SetItemsProcessed(visitor.visited);
+}
+
+static void LayoutAndLoadFactor(benchmark::internal::Benchmark* b) {
+    for (int layout : {0, 1}) {
+        for (int loadFactor : {1, 2, 4}) {
+            b->Args({layout, loadFactor});
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(HashTableBench, FindHit)->Apply(LayoutAndLoadFactor);
+BENCHMARK_REGISTER_F(HashTableBench, FindMiss)->Apply(LayoutAndLoadFactor);
+BENCHMARK_REGISTER_F(HashTableBench, Visit)->Apply(LayoutAndLoadFactor);
@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of resuming a read of an Ephemeral vBucket's sequence list at
+ * a given seqno (as a DCP stream reconnecting does), with and without the
+ * BasicLinkedList seqno index (ephemeral_seqlist_index_interval).
+ *
+ * Each iteration reads the last 100 seqnos of the list, either with
+ * rangeRead() or by creating a range iterator and advancing it to the start
+ * seqno (as DCPBackfillMemoryBuffered does).
+ */
+
+#include "hash_table.h"
+#include "item.h"
+#include "linked_list.h"
+#include "stats.h"
+#include "stored_value_factories.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <benchmark/benchmark.h>
+#include <gtest/gtest.h>
+#include <valgrind/valgrind.h>
+
+#include <mutex>
+
+class SeqListBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        // The first parameter is the index interval (0: no index).
+        const size_t indexInterval = state.range(0);
+        state.SetLabel(indexInterval ? "Indexed" : "NoIndex");
+
+        // The second parameter is the number of items in the list.
+        numItems = RUNNING_ON_VALGRIND ? 100 : state.range(1);
+
+        ht = std::make_unique<HashTable>(
+                stats,
+                std::make_unique<OrderedStoredValueFactory>(stats),
+                numItems,
+                /*locks*/ 47);
+        list = std::make_unique<BasicLinkedList>(0, stats, indexInterval);
+
+        std::mutex fakeSeqLock;
+        std::lock_guard<std::mutex> seqLg(fakeSeqLock);
+        const std::string value(32, 'x');
+        for (seqno_t seqno = 1; seqno <= numItems; ++seqno) {
+            auto key = makeStoredDocKey("key" + std::to_string(seqno));
+            Item item(key,
+                      0,
+                      0,
+                      value.data(),
+                      value.size(),
+                      PROTOCOL_BINARY_RAW_BYTES,
+                      /*theCas*/ 0,
+                      seqno);
+            ASSERT_EQ(MutationStatus::WasClean, ht->set(item));
+            auto* osv = ht->find(key, TrackReference::No, WantsDeleted::No)
+                                ->toOrderedStoredValue();
+            std::lock_guard<std::mutex> listWriteLg(list->getListWriteLock());
+            list->appendToList(seqLg, listWriteLg, *osv);
+            list->updateHighSeqno(listWriteLg, *osv);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        // The list must go before the HashTable which owns the items.
+        list.reset();
+        ht.reset();
+    }
+
+protected:
+    seqno_t resumeSeqno() const {
+        return std::max(seqno_t(1), numItems - 99);
+    }
+
+    EPStats stats;
+    std::unique_ptr<HashTable> ht;
+    std::unique_ptr<BasicLinkedList> list;
+    seqno_t numItems = 0;
+};
+
+BENCHMARK_DEFINE_F(SeqListBench, ResumeRangeRead)(benchmark::State& state) {
+    const seqno_t start = resumeSeqno();
+    while (state.KeepRunning()) {
+        auto result = list->rangeRead(start, numItems);
+        benchmark::DoNotOptimize(std::get<1>(result).size());
+    }
+}
+
+BENCHMARK_DEFINE_F(SeqListBench, ResumeRangeIterator)
+(benchmark::State& state) {
+    const seqno_t start = resumeSeqno();
+    while (state.KeepRunning()) {
+        auto itr = list->makeRangeIterator(/*isBackfill*/ false, start);
+        size_t read = 0;
+        while (itr->curr() != itr->end()) {
+            if ((**itr).getBySeqno() >= start) {
+                ++read;
+            }
+            ++(*itr);
+        }
+        benchmark::DoNotOptimize(read);
+    }
+}
+
+static void SeqListArgs(benchmark::internal::Benchmark* b) {
+    for (int indexInterval : {0, 1024}) {
+        for (int numItems : {10000, 1000000}) {
+            b->Args({indexInterval, numItems});
+        }
+    }
+    b->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_REGISTER_F(SeqListBench, ResumeRangeRead)->Apply(SeqListArgs);
+BENCHMARK_REGISTER_F(SeqListBench, ResumeRangeIterator)->Apply(SeqListArgs);
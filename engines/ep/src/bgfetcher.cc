@@ -32,7 +32,10 @@
 #include <vector>
 
 BgFetcher::BgFetcher(KVBucket& s, KVShard& k)
-    : BgFetcher(&s, &k, s.getEPEngine().getEpStats()) {
+    : BgFetcher(&s,
+                &k,
+                s.getEPEngine().getEpStats(),
+                s.getEPEngine().getConfiguration().getBgFetchPipelineDepth()) {
 }
 
 void BgFetcher::start() {
@@ -41,12 +44,23 @@ void BgFetcher::start() {
             std::make_shared<MultiBGFetcherTask>(&(store->getEPEngine()), this);
     this->setTaskId(task->getId());
     iom->schedule(task);
+
+    for (size_t ii = 1; ii < pipelineDepth; ++ii) {
+        auto helper = std::make_shared<MultiBGFetcherTask>(
+                &(store->getEPEngine()), this, /*helper*/ true);
+        helperTaskIds.push_back(helper->getId());
+        iom->schedule(helper);
+    }
 }
 
 void BgFetcher::stop() {
     bool inverse = true;
     pendingFetch.compare_exchange_strong(inverse, false);
     ExecutorPool::get()->cancel(taskId);
+    for (auto id : helperTaskIds) {
+        ExecutorPool::get()->cancel(id);
+    }
+    helperTaskIds.clear();
 }
 
 void BgFetcher::notifyBGEvent(void) {
@@ -80,6 +94,10 @@ size_t BgFetcher::doFetch(VBucket::id_type vbId,
                 .count());
 
     shard->getROUnderlying()->getMulti(vbId, itemsToFetch);
+    const auto readTime = ProcessClock::now();
+    stats.bgFetchDiskHisto.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(readTime -
+                                                                  startTime));
 
     std::vector<bgfetched_item_t> fetchedItems;
     for (const auto& fetch : itemsToFetch) {
@@ -95,9 +113,13 @@ size_t BgFetcher::doFetch(VBucket::id_type vbId,
 
     if (fetchedItems.size() > 0) {
         store->completeBGFetchMulti(vbId, fetchedItems, startTime);
+        const auto endTime = ProcessClock::now();
+        stats.bgFetchCompleteHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        endTime - readTime));
         stats.getMultiHisto.add(
                 std::chrono::duration_cast<std::chrono::microseconds>(
-                        ProcessClock::now() - startTime),
+                        endTime - startTime),
                 fetchedItems.size());
         stats.getMultiBatchSizeHisto.add(fetchedItems.size());
     }
@@ -124,37 +146,75 @@ bool BgFetcher::run(GlobalTask *task) {
     task->snooze(INT_MAX);
     pendingFetch.store(false);
 
-    std::vector<uint16_t> bg_vbs(pendingVbs.size());
+    size_t queued;
     {
         LockHolder lh(queueMutex);
-        bg_vbs.assign(pendingVbs.begin(), pendingVbs.end());
+        const auto now = ProcessClock::now();
+        for (const auto vbId : pendingVbs) {
+            fetchQueue.emplace_back(vbId, now);
+        }
         pendingVbs.clear();
+        queued = fetchQueue.size();
     }
 
-    size_t num_fetched_items = 0;
-    for (const uint16_t vbId : bg_vbs) {
-        VBucketPtr vb = shard->getBucket(vbId);
-        if (vb) {
-            // Requeue the bg fetch task if vbucket DB file is not created yet.
-            if (vb->isBucketCreation()) {
-                {
-                    LockHolder lh(queueMutex);
-                    pendingVbs.insert(vbId);
-                }
-                wakeUpTaskIfSnoozed();
-                continue;
-            }
+    // Let the helpers fetch other vBuckets while we fetch (and complete)
+    // the first.
+    for (size_t ii = 0; ii + 1 < queued && ii < helperTaskIds.size(); ++ii) {
+        ExecutorPool::get()->wake(helperTaskIds[ii]);
+    }
+
+    drainFetchQueue();
+
+    return true;
+}
 
-            auto items = vb->getBGFetchItems();
-            if (items.size() > 0) {
-                num_fetched_items += doFetch(vbId, items);
+bool BgFetcher::runHelper(GlobalTask* task) {
+    // As run(), snooze *before* looking for work so a wake() issued after we
+    // found the queue empty isn't lost.
+    task->snooze(INT_MAX);
+    drainFetchQueue();
+    return true;
+}
+
+void BgFetcher::drainFetchQueue() {
+    while (true) {
+        VBucket::id_type vbId;
+        ProcessClock::time_point queuedTime;
+        {
+            LockHolder lh(queueMutex);
+            if (fetchQueue.empty()) {
+                return;
             }
+            std::tie(vbId, queuedTime) = fetchQueue.front();
+            fetchQueue.pop_front();
         }
+        stats.bgFetchPipelineWaitHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        ProcessClock::now() - queuedTime));
+        fetchVBucket(vbId);
     }
+}
 
-    stats.numRemainingBgItems.fetch_sub(num_fetched_items);
+void BgFetcher::fetchVBucket(VBucket::id_type vbId) {
+    VBucketPtr vb = shard->getBucket(vbId);
+    if (!vb) {
+        return;
+    }
 
-    return true;
+    // Requeue the bg fetch task if vbucket DB file is not created yet.
+    if (vb->isBucketCreation()) {
+        {
+            LockHolder lh(queueMutex);
+            pendingVbs.insert(vbId);
+        }
+        wakeUpTaskIfSnoozed();
+        return;
+    }
+
+    auto items = vb->getBGFetchItems();
+    if (items.size() > 0) {
+        stats.numRemainingBgItems.fetch_sub(doFetch(vbId, items));
+    }
 }
 
 bool BgFetcher::pendingJob() const {
@@ -20,9 +20,11 @@
 
 #include "config.h"
 
+#include <deque>
 #include <list>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "item.h"
 #include "stats.h"
@@ -36,6 +38,11 @@ class GlobalTask;
 /**
  * Dispatcher job responsible for batching data reads and push to
  * underlying storage
+ *
+ * Fetches are pipelined across vBuckets: when the BgFetcher task finds more
+ * than one vBucket with pending fetches it wakes up to
+ * (bg_fetch_pipeline_depth - 1) helper tasks, so the disk reads for one
+ * vBucket's batch overlap with completing (decoding and notifying) another's.
  */
 class BgFetcher {
 public:
@@ -45,15 +52,17 @@ public:
      * @param s  The store
      * @param k  The shard to which this background fetcher belongs
      * @param st reference to statistics
+     * @param depth number of tasks which may fetch concurrently
      */
-    BgFetcher(KVBucket* s, KVShard* k, EPStats &st) :
-        store(s), shard(k), taskId(0), stats(st), pendingFetch(false) {}
+    BgFetcher(KVBucket* s, KVShard* k, EPStats &st, size_t depth = 1) :
+        store(s), shard(k), taskId(0), stats(st), pipelineDepth(depth),
+        pendingFetch(false) {}
 
     /**
      * Construct a BgFetcher
      *
-     * Equivalent to above constructor except stats reference is obtained
-     * from KVBucket's reference to EPEngine's epstats.
+     * Equivalent to above constructor except stats reference and pipeline
+     * depth are obtained from KVBucket's reference to EPEngine.
      *
      * @param s The store
      * @param k The shard to which this background fetcher belongs
@@ -73,6 +82,13 @@ public:
     void start(void);
     void stop(void);
     bool run(GlobalTask *task);
+
+    /**
+     * Run by the pipeline's helper tasks: fetch the vBuckets queued by run()
+     * until there are none left.
+     */
+    bool runHelper(GlobalTask* task);
+
     bool pendingJob(void) const;
     void notifyBGEvent(void);
     void setTaskId(size_t newId) { taskId = newId; }
@@ -84,6 +100,12 @@ public:
 private:
     size_t doFetch(VBucket::id_type vbId, vb_bgfetch_queue_t& items);
 
+    /// Fetch the pending items of the given vBucket.
+    void fetchVBucket(VBucket::id_type vbId);
+
+    /// Fetch vBuckets from fetchQueue until it is empty.
+    void drainFetchQueue();
+
     /// If the BGFetch task is currently snoozed (not scheduled to
     /// run), wake it up. Has no effect the if the task has already
     /// been woken.
@@ -94,9 +116,15 @@ private:
     size_t taskId;
     std::mutex queueMutex;
     EPStats &stats;
+    const size_t pipelineDepth;
+    std::vector<size_t> helperTaskIds;
 
     std::atomic<bool> pendingFetch;
     std::set<VBucket::id_type> pendingVbs;
+    /// vBuckets claimed by run() but not yet fetched, and when they were
+    /// queued. Guarded by queueMutex.
+    std::deque<std::pair<VBucket::id_type, ProcessClock::time_point>>
+            fetchQueue;
 };
 
 #endif  // SRC_BGFETCHER_H_
@@ -18,6 +18,8 @@
 #include "config.h"
 
 #include <platform/checked_snprintf.h>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <utility>
 #include <vector>
@@ -39,6 +41,36 @@ const char* to_string(enum checkpoint_state s) {
     return "<unknown>";
 }
 
+CheckpointCursor::CheckpointCursor(const std::string& n)
+    : name(n),
+      persistence(n == CheckpointManager::pCursorName),
+      currentCheckpoint(),
+      currentPos(),
+      offset(0),
+      ckptMetaItemsRead(0),
+      fromBeginningOnChkCollapse(false),
+      sendCheckpointEndMetaItem(MustSendCheckpointEnd::YES) {
+}
+
+CheckpointCursor::CheckpointCursor(
+        const std::string& n,
+        CheckpointList::iterator checkpoint,
+        CheckpointQueue::iterator pos,
+        size_t offset_,
+        size_t meta_items_read,
+        bool beginningOnChkCollapse,
+        MustSendCheckpointEnd needsCheckpointEndMetaItem)
+    : name(n),
+      persistence(n == CheckpointManager::pCursorName),
+      currentCheckpoint(checkpoint),
+      currentPos(pos),
+      numVisits(0),
+      offset(offset_),
+      ckptMetaItemsRead(meta_items_read),
+      fromBeginningOnChkCollapse(beginningOnChkCollapse),
+      sendCheckpointEndMetaItem(needsCheckpointEndMetaItem) {
+}
+
 void CheckpointCursor::decrOffset(size_t decr) {
     if (offset >= decr) {
         offset.fetch_sub(decr);
@@ -75,6 +107,168 @@ std::ostream& operator<<(std::ostream& os, const CheckpointCursor& c) {
     return os;
 }
 
+size_t CheckpointQueue::push_back(const queued_item& qi) {
+    if (numSlots == chunks.size() * ChunkSize) {
+        chunks.emplace_back(new Chunk());
+    }
+    const size_t slot = numSlots++;
+    at(slot) = qi;
+    ++numLive;
+    return slot;
+}
+
+void CheckpointQueue::erase(iterator pos) {
+    at(pos.getSlot()).reset();
+    --numLive;
+}
+
+void CheckpointQueue::pop_back() {
+    const size_t slot = prevLive(numSlots);
+    at(slot).reset();
+    --numLive;
+    numSlots = slot;
+}
+
+std::vector<size_t> CheckpointQueue::rebuild(const std::vector<size_t>& order) {
+    std::vector<std::unique_ptr<Chunk>> oldChunks;
+    oldChunks.swap(chunks);
+    const size_t oldNumSlots = numSlots;
+    numSlots = 0;
+    numLive = 0;
+
+    const size_t dropped = std::numeric_limits<size_t>::max();
+    std::vector<size_t> newSlots(oldNumSlots + 1, dropped);
+    for (auto slot : order) {
+        auto& qi = (*oldChunks[slot / ChunkSize])[slot % ChunkSize];
+        if (qi) {
+            newSlots[slot] = push_back(qi);
+        }
+    }
+
+    // Tombstones and other dropped slots take the position of the closest
+    // preceding slot which was kept; the old end maps to the new end.
+    size_t preceding = 0;
+    for (size_t slot = 0; slot < oldNumSlots; ++slot) {
+        if (newSlots[slot] == dropped) {
+            newSlots[slot] = preceding;
+        } else {
+            preceding = newSlots[slot];
+        }
+    }
+    newSlots[oldNumSlots] = numSlots;
+    return newSlots;
+}
+
+std::vector<size_t> CheckpointQueue::compact() {
+    std::vector<size_t> order;
+    order.reserve(numLive);
+    for (size_t slot = 0; slot < numSlots; ++slot) {
+        if (at(slot)) {
+            order.push_back(slot);
+        }
+    }
+    return rebuild(order);
+}
+
+/// Does the item's key equal key?
+static bool keyMatches(const queued_item& qi, const DocKey& key) {
+    const auto& itemKey = qi->getKey();
+    return itemKey.size() == key.size() &&
+           itemKey.getDocNamespace() == key.getDocNamespace() &&
+           std::memcmp(itemKey.data(), key.data(), key.size()) == 0;
+}
+
+size_t CheckpointIndex::findSlot(const DocKey& key, uint32_t hash) const {
+    const size_t mask = slots.size() - 1;
+    for (size_t i = homeSlot(hash);; i = (i + 1) & mask) {
+        const auto& slot = slots[i];
+        if (slot.entry.position == EmptySlot ||
+            (slot.hash == hash &&
+             keyMatches(queue.at(slot.entry.position), key))) {
+            return i;
+        }
+    }
+}
+
+CheckpointIndex::Entry* CheckpointIndex::find(const DocKey& key) {
+    if (count == 0) {
+        return nullptr;
+    }
+    auto& slot = slots[findSlot(key, key.hash())];
+    return slot.entry.position == EmptySlot ? nullptr : &slot.entry;
+}
+
+void CheckpointIndex::insert(const DocKey& key, const Entry& entry) {
+    // Keep the load factor at or below 3/4.
+    if ((count + 1) * 4 > slots.size() * 3) {
+        grow();
+    }
+    const uint32_t hash = key.hash();
+    const size_t mask = slots.size() - 1;
+    size_t i = homeSlot(hash);
+    while (slots[i].entry.position != EmptySlot) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = {entry, hash};
+    ++count;
+}
+
+void CheckpointIndex::erase(const DocKey& key) {
+    if (count == 0) {
+        return;
+    }
+    const size_t mask = slots.size() - 1;
+    size_t hole = findSlot(key, key.hash());
+    if (slots[hole].entry.position == EmptySlot) {
+        return;
+    }
+    --count;
+
+    // Backward-shift deletion: move later entries of the probe sequence into
+    // the hole, so no tombstones are needed.
+    for (size_t i = (hole + 1) & mask; slots[i].entry.position != EmptySlot;
+         i = (i + 1) & mask) {
+        const size_t home = homeSlot(slots[i].hash);
+        // Can the entry at i move to the hole, i.e. is the hole cyclically
+        // within [home, i)?
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole].entry.position = EmptySlot;
+}
+
+void CheckpointIndex::remap(const std::vector<size_t>& newSlots) {
+    for (auto& slot : slots) {
+        if (slot.entry.position != EmptySlot) {
+            slot.entry.position = newSlots[slot.entry.position];
+        }
+    }
+}
+
+void CheckpointIndex::grow() {
+    std::vector<Slot> oldSlots(
+            slots.empty() ? InitialCapacity : slots.size() * 2,
+            Slot{{EmptySlot, 0}, 0});
+    oldSlots.swap(slots);
+    shift = 64;
+    for (size_t capacity = slots.size(); capacity > 1; capacity >>= 1) {
+        --shift;
+    }
+
+    const size_t mask = slots.size() - 1;
+    for (const auto& slot : oldSlots) {
+        if (slot.entry.position != EmptySlot) {
+            size_t i = homeSlot(slot.hash);
+            while (slots[i].entry.position != EmptySlot) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    }
+}
+
 Checkpoint::Checkpoint(EPStats& st,
                        uint64_t id,
                        uint64_t snapStart,
@@ -89,6 +283,8 @@ Checkpoint::Checkpoint(EPStats& st,
       checkpointState(CHECKPOINT_OPEN),
       numItems(0),
       numMetaItems(0),
+      keyIndex(toWrite),
+      metaKeyIndex(toWrite),
       memOverhead(0),
       effectiveMemUsage(0) {
     stats.memOverhead->fetch_add(memorySize());
@@ -131,7 +327,36 @@ void Checkpoint::popBackCheckpointEndItem() {
 }
 
 bool Checkpoint::keyExists(const DocKey& key) {
-    return keyIndex.find(key) != keyIndex.end();
+    return keyIndex.find(key) != nullptr;
+}
+
+void Checkpoint::updateMemOverhead() {
+    const size_t newOverhead = toWrite.memorySize() + keyIndex.memorySize() +
+                               metaKeyIndex.memorySize();
+    if (newOverhead > memOverhead) {
+        stats.memOverhead->fetch_add(newOverhead - memOverhead);
+    } else {
+        stats.memOverhead->fetch_sub(memOverhead - newOverhead);
+    }
+    memOverhead = newOverhead;
+    if (stats.memOverhead->load() >= GIGANTOR) {
+        LOG(EXTENSION_LOG_WARNING,
+            "Checkpoint::updateMemOverhead: stats.memOverhead (which is %" PRId64
+            ") is greater than %" PRId64, uint64_t(stats.memOverhead->load()),
+            uint64_t(GIGANTOR));
+    }
+}
+
+void Checkpoint::compact(CheckpointManager& checkpointManager) {
+    const auto newSlots = toWrite.compact();
+    keyIndex.remap(newSlots);
+    metaKeyIndex.remap(newSlots);
+    for (auto& cursor : checkpointManager.connCursors) {
+        if ((*(cursor.second.currentCheckpoint)).get() == this) {
+            auto& pos = cursor.second.currentPos;
+            pos = toWrite.makeIterator(newSlots[pos.getSlot()]);
+        }
+    }
 }
 
 queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
@@ -142,7 +367,7 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                         ") is not OPEN");
     }
     queue_dirty_t rv;
-    checkpoint_index::iterator it = keyIndex.find(qi->getKey());
+    CheckpointIndex::Entry* existing = keyIndex.find(qi->getKey());
     // Check if the item is a meta item
     if (qi->isCheckPointMetaItem()) {
         // empty items act only as a dummy element for the start of the
@@ -155,10 +380,10 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
         toWrite.push_back(qi);
     } else {
         // Check if this checkpoint already had an item for the same key
-        if (it != keyIndex.end()) {
+        if (existing) {
             rv = EXISTING_ITEM;
-            CheckpointQueue::iterator currPos = it->second.position;
-            const int64_t currMutationId{it->second.mutation_id};
+            auto currPos = toWrite.makeIterator(existing->position);
+            const int64_t currMutationId{existing->mutation_id};
 
             // Given the key already exists, need to check all cursors in this
             // Checkpoint and see if the existing item for this key is to
@@ -176,8 +401,8 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                             cursor_item->isCheckPointMetaItem() ? metaKeyIndex
                                                                 : keyIndex;
 
-                    auto cursor_item_idx = index.find(cursor_item->getKey());
-                    if (cursor_item_idx == keyIndex.end()) {
+                    auto* cursor_item_idx = index.find(cursor_item->getKey());
+                    if (!cursor_item_idx) {
                         throw std::logic_error("Checkpoint::queueDirty: Unable "
                                 "to find key with"
                                 " op:" + to_string(cursor_item->getOperation()) +
@@ -192,7 +417,7 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                     // decrement if the the existing item is strictly less than
                     // the cursor, as meta-items can share a seqno with
                     // a non-meta item but are logically before them.
-                    int64_t cursor_mutation_id{cursor_item_idx->second.mutation_id};
+                    int64_t cursor_mutation_id{cursor_item_idx->mutation_id};
                     if (cursor_item->isCheckPointMetaItem()) {
                         --cursor_mutation_id;
                     }
@@ -202,7 +427,7 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
                         // backwards one so it will pick up the new value for
                         // this key.
                         cursor.second.decrOffset(1);
-                        if (cursor.second.name == CheckpointManager::pCursorName) {
+                        if (cursor.second.isPersistence()) {
                             rv = PERSIST_AGAIN;
                         }
                     }
@@ -215,42 +440,41 @@ queue_dirty_t Checkpoint::queueDirty(const queued_item &qi,
             }
 
             toWrite.push_back(qi);
-            // Remove the existing item for the same key from the list.
+            // Tombstone the existing item for the same key.
             toWrite.erase(currPos);
         } else {
             ++numItems;
             rv = NEW_ITEM;
-            // Push the new item into the list
+            // Push the new item into the queue
             toWrite.push_back(qi);
         }
     }
 
     if (qi->getKey().size() > 0) {
-        CheckpointQueue::iterator last = toWrite.end();
-        // --last is okay as the list is not empty now.
-        index_entry entry = {--last, qi->getBySeqno()};
         // Set the index of the key to the new item that is pushed back into
-        // the list.
+        // the queue.
+        const CheckpointIndex::Entry entry = {toWrite.getNumSlots() - 1,
+                                              qi->getBySeqno()};
         if (qi->isCheckPointMetaItem()) {
             // We add a meta item only once to a checkpoint
-            metaKeyIndex[qi->getKey()] = entry;
-        } else {
-            keyIndex[qi->getKey()] = entry;
-        }
-        if (rv == NEW_ITEM) {
-            size_t newEntrySize = qi->getKey().size() +
-                                  sizeof(index_entry) + sizeof(queued_item);
-            memOverhead += newEntrySize;
-            stats.memOverhead->fetch_add(newEntrySize);
-            if (stats.memOverhead->load() >= GIGANTOR) {
-                LOG(EXTENSION_LOG_WARNING,
-                    "Checkpoint::queueDirty: stats.memOverhead (which is %" PRId64
-                    ") is greater than %" PRId64, uint64_t(stats.memOverhead->load()),
-                    uint64_t(GIGANTOR));
+            auto* metaEntry = metaKeyIndex.find(qi->getKey());
+            if (metaEntry) {
+                *metaEntry = entry;
+            } else {
+                metaKeyIndex.insert(qi->getKey(), entry);
             }
+        } else if (existing) {
+            *existing = entry;
+        } else {
+            keyIndex.insert(qi->getKey(), entry);
         }
     }
 
+    if (toWrite.needsCompaction()) {
+        compact(*checkpointManager);
+    }
+    updateMemOverhead();
+
     // Notify flusher if in case queued item is a checkpoint meta item or
     // vbpersist state.
     if (qi->getOperation() == queue_op::checkpoint_start ||
@@ -269,7 +493,6 @@ const StoredDocKey Checkpoint::SetVBucketStateKey("set_vbucket_state", DocNamesp
 
 size_t Checkpoint::mergePrevCheckpoint(Checkpoint *pPrevCheckpoint) {
     size_t numNewItems = 0;
-    size_t newEntryMemOverhead = 0;
 
     LOG(EXTENSION_LOG_INFO,
         "Collapse the checkpoint %" PRIu64 " into the checkpoint %" PRIu64
@@ -278,16 +501,19 @@ size_t Checkpoint::mergePrevCheckpoint(Checkpoint *pPrevCheckpoint) {
 
     CheckpointQueue::iterator itr = toWrite.begin();
     uint64_t seqno = pPrevCheckpoint->getMutationIdForKey(Checkpoint::DummyKey, true);
-    metaKeyIndex[Checkpoint::DummyKey].mutation_id = seqno;
+    metaKeyIndex.find(Checkpoint::DummyKey)->mutation_id = seqno;
     (*itr)->setBySeqno(seqno);
 
     seqno = pPrevCheckpoint->getMutationIdForKey(Checkpoint::CheckpointStartKey, true);
-    metaKeyIndex[Checkpoint::CheckpointStartKey].mutation_id = seqno;
+    metaKeyIndex.find(Checkpoint::CheckpointStartKey)->mutation_id = seqno;
     ++itr;
     (*itr)->setBySeqno(seqno);
 
-    // Iterate in reverse over the previous checkpoints' items, inserting them
-    // into the current checkpoint as necessary.
+    // Iterate in reverse over the previous checkpoints' items, appending
+    // the ones to keep to the queue (so they can be indexed); they are moved
+    // to just after the first two meta items (empty & checkpoint start)
+    // below.
+    const size_t numOrigSlots = toWrite.getNumSlots();
     for (auto rit = pPrevCheckpoint->rbegin(); rit != pPrevCheckpoint->rend();
             ++rit) {
         const auto key = (*rit)->getKey();
@@ -297,17 +523,14 @@ size_t Checkpoint::mergePrevCheckpoint(Checkpoint *pPrevCheckpoint) {
             // checkpoint if the key isn't already present (if it is already
             // present then it must be an older revision and hence we can
             // safely discard it).
-            if (keyIndex.find(key) == keyIndex.end()) {
-                // Skip the first two meta items (empty & checkpoint start).
-                auto pos = std::next(toWrite.begin(), 2);
-                toWrite.insert(pos, *rit);
-                index_entry entry = {
-                        --pos,
-                        static_cast<int64_t>(
-                                pPrevCheckpoint->getMutationIdForKey(key,
-                                                                     false))};
-                keyIndex[key] = entry;
-                newEntryMemOverhead += key.size() + sizeof(index_entry);
+            if (!keyIndex.find(key)) {
+                const auto slot = toWrite.push_back(*rit);
+                keyIndex.insert(
+                        key,
+                        {slot,
+                         static_cast<int64_t>(
+                                 pPrevCheckpoint->getMutationIdForKey(
+                                         key, false))});
                 ++numItems;
                 ++numNewItems;
 
@@ -339,14 +562,11 @@ size_t Checkpoint::mergePrevCheckpoint(Checkpoint *pPrevCheckpoint) {
         case queue_op::set_vbucket_state:
         case queue_op::system_event:
             // Need to re-insert these into the correct place in the index.
-            if (metaKeyIndex.find(key) == metaKeyIndex.end()) {
-                // Skip the first two meta items (empty & checkpoint start).
-                auto pos = std::next(toWrite.begin(), 2);
-                toWrite.insert(pos, *rit);
+            if (!metaKeyIndex.find(key)) {
+                const auto slot = toWrite.push_back(*rit);
                 auto mutationId = static_cast<int64_t>(
                         pPrevCheckpoint->getMutationIdForKey(key, true));
-                metaKeyIndex[key] = {--pos, mutationId};
-                newEntryMemOverhead += key.size() + sizeof(index_entry);
+                metaKeyIndex.insert(key, {slot, mutationId});
                 ++numMetaItems;
                 ++numNewItems;
 
@@ -357,6 +577,22 @@ size_t Checkpoint::mergePrevCheckpoint(Checkpoint *pPrevCheckpoint) {
         }
     }
 
+    // Rebuild the queue as: the first two meta items, the merged items in
+    // their original order (they were appended in reverse), then the rest of
+    // this checkpoint. This also drops any tombstones. The caller
+    // (collapseCheckpoints) repositions all cursors afterwards.
+    std::vector<size_t> order{0, 1};
+    order.reserve(toWrite.getNumSlots());
+    for (size_t slot = toWrite.getNumSlots(); slot > numOrigSlots; --slot) {
+        order.push_back(slot - 1);
+    }
+    for (size_t slot = 2; slot < numOrigSlots; ++slot) {
+        order.push_back(slot);
+    }
+    const auto newSlots = toWrite.rebuild(order);
+    keyIndex.remap(newSlots);
+    metaKeyIndex.remap(newSlots);
+
     /**
      * Update snapshot start of current checkpoint to the first
      * item's sequence number, after merge completed, as items
@@ -365,22 +601,17 @@ size_t Checkpoint::mergePrevCheckpoint(Checkpoint *pPrevCheckpoint) {
      */
     setSnapshotStartSeqno(getLowSeqno());
 
-    memOverhead += newEntryMemOverhead;
-    stats.memOverhead->fetch_add(newEntryMemOverhead);
-    LOG(EXTENSION_LOG_WARNING,
-        "Checkpoint::mergePrevCheckpoint: stats.memOverhead (which is %" PRId64
-        ") is greater than %" PRId64, uint64_t(stats.memOverhead->load()),
-        uint64_t(GIGANTOR));
+    updateMemOverhead();
     return numNewItems;
 }
 
 uint64_t Checkpoint::getMutationIdForKey(const DocKey& key, bool isMeta) {
     uint64_t mid = 0;
-    checkpoint_index& chkIdx = isMeta ? metaKeyIndex : keyIndex;
+    CheckpointIndex& chkIdx = isMeta ? metaKeyIndex : keyIndex;
 
-    checkpoint_index::iterator it = chkIdx.find(key);
-    if (it != chkIdx.end()) {
-        mid = it->second.mutation_id;
+    auto* entry = chkIdx.find(key);
+    if (entry) {
+        mid = entry->mutation_id;
     } else {
         throw std::invalid_argument("key{" +
                                     std::string(reinterpret_cast<const char*>(key.data())) +
@@ -392,10 +623,8 @@ uint64_t Checkpoint::getMutationIdForKey(const DocKey& key, bool isMeta) {
 }
 
 bool Checkpoint::isEligibleToBeUnreferenced() {
-    const std::set<std::string> &cursors = getCursorNameList();
-    std::set<std::string>::const_iterator cit = cursors.begin();
-    for (; cit != cursors.end(); ++cit) {
-        if ((*cit).compare(CheckpointManager::pCursorName) == 0) {
+    for (const auto* cursor : cursors) {
+        if (cursor->isPersistence()) {
             // Persistence cursor is on current checkpoint
             return false;
         }
@@ -635,12 +864,18 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
                         ")");
     }
 
-    removeCursor_UNLOCKED(name);
+    // Re-registering an existing cursor repositions it, keeping its handle.
+    auto existing = connCursors.find(name);
+    if (existing != connCursors.end()) {
+        for (const auto& checkpoint : checkpointList) {
+            checkpoint->removeCursor(existing->second);
+        }
+    }
 
     size_t skipped = 0;
     CursorRegResult result;
-    result.first = std::numeric_limits<uint64_t>::max();
-    result.second = false;
+    result.seqno = std::numeric_limits<uint64_t>::max();
+    result.startsAtFirstItem = false;
 
     auto itr = checkpointList.begin();
     for (; itr != checkpointList.end(); ++itr) {
@@ -650,12 +885,17 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
         if (startBySeqno < st) {
             // Requested sequence number is before the start of this
             // checkpoint, position cursor at the checkpoint start.
-            connCursors[name] = CheckpointCursor(name, itr, (*itr)->begin(),
-                                                 skipped, /*meta_offset*/0,
-                                                 false,
-                                                 needsCheckPointEndMetaItem);
-            (*itr)->registerCursorName(name);
-            result.first = (*itr)->getLowSeqno();
+            auto& cursor = placeCursor_UNLOCKED(
+                    CheckpointCursor(name,
+                                     itr,
+                                     (*itr)->begin(),
+                                     skipped,
+                                     /*meta_offset*/ 0,
+                                     false,
+                                     needsCheckPointEndMetaItem));
+            (*itr)->registerCursor(cursor);
+            result.seqno = (*itr)->getLowSeqno();
+            result.cursor = cursor.handle;
             break;
         } else if (startBySeqno <= en) {
             // Requested sequence number lies within this checkpoint.
@@ -673,16 +913,22 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
 
             if (iitr == (*itr)->end()) {
                 --iitr;
-                result.first = static_cast<uint64_t>((*iitr)->getBySeqno()) + 1;
+                result.seqno = static_cast<uint64_t>((*iitr)->getBySeqno()) + 1;
             } else {
-                result.first = static_cast<uint64_t>((*iitr)->getBySeqno());
+                result.seqno = static_cast<uint64_t>((*iitr)->getBySeqno());
                 --iitr;
             }
 
-            connCursors[name] = CheckpointCursor(name, itr, iitr, skipped,
-                                                 ckpt_meta_skipped, false,
-                                                 needsCheckPointEndMetaItem);
-            (*itr)->registerCursorName(name);
+            auto& cursor = placeCursor_UNLOCKED(
+                    CheckpointCursor(name,
+                                     itr,
+                                     iitr,
+                                     skipped,
+                                     ckpt_meta_skipped,
+                                     false,
+                                     needsCheckPointEndMetaItem));
+            (*itr)->registerCursor(cursor);
+            result.cursor = cursor.handle;
             break;
         } else {
             // Whole (closed) checkpoint skipped, increment by it's number
@@ -691,10 +937,10 @@ CursorRegResult CheckpointManager::registerCursorBySeqno(
         }
     }
 
-    result.second = (result.first == checkpointList.front()->getLowSeqno()) ?
-                    true : false;
+    result.startsAtFirstItem =
+            (result.seqno == checkpointList.front()->getLowSeqno());
 
-    if (result.first == std::numeric_limits<uint64_t>::max()) {
+    if (result.seqno == std::numeric_limits<uint64_t>::max()) {
         /*
          * We should never get here since this would mean that the sequence
          * number we are looking for is higher than anything currently assigned
@@ -740,7 +986,7 @@ bool CheckpointManager::registerCursor_UNLOCKED(
     // currently referenced by it.
     cursor_index::iterator map_it = connCursors.find(name);
     if (map_it != connCursors.end()) {
-        (*(map_it->second.currentCheckpoint))->removeCursorName(name);
+        (*(map_it->second.currentCheckpoint))->removeCursor(map_it->second);
     }
 
     if (!found) {
@@ -770,11 +1016,15 @@ bool CheckpointManager::registerCursor_UNLOCKED(
             offset += (*pos)->getNumItems() + (*pos)->getNumMetaItems();
         }
 
-        connCursors[name] = CheckpointCursor(name, it, (*it)->begin(), offset,
-                                             /*meta_offset*/0,
-                                             resetOnCollapse,
-                                             needsCheckpointEndMetaItem);
-        (*it)->registerCursorName(name);
+        auto& cursor = placeCursor_UNLOCKED(
+                CheckpointCursor(name,
+                                 it,
+                                 (*it)->begin(),
+                                 offset,
+                                 /*meta_offset*/ 0,
+                                 resetOnCollapse,
+                                 needsCheckpointEndMetaItem));
+        (*it)->registerCursor(cursor);
     } else {
         size_t offset = 0, meta_offset = 0;
         CheckpointQueue::iterator curr;
@@ -805,56 +1055,103 @@ bool CheckpointManager::registerCursor_UNLOCKED(
             }
         }
 
-        connCursors[name] = CheckpointCursor(name, it, curr, offset,
-                                             meta_offset,
-                                             resetOnCollapse,
-                                             needsCheckpointEndMetaItem);
-        // Register the cursor's name to the checkpoint.
-        (*it)->registerCursorName(name);
+        auto& cursor = placeCursor_UNLOCKED(
+                CheckpointCursor(name,
+                                 it,
+                                 curr,
+                                 offset,
+                                 meta_offset,
+                                 resetOnCollapse,
+                                 needsCheckpointEndMetaItem));
+        // Register the cursor to the checkpoint.
+        (*it)->registerCursor(cursor);
     }
 
     return found;
 }
 
-bool CheckpointManager::removeCursor(const std::string &name) {
-    LockHolder lh(queueLock);
-    return removeCursor_UNLOCKED(name);
+CheckpointCursor& CheckpointManager::placeCursor_UNLOCKED(
+        const CheckpointCursor& cursor) {
+    auto result = connCursors.emplace(cursor.name, cursor);
+    auto& placed = result.first->second;
+    if (result.second) {
+        uint32_t slot;
+        if (freeCursorSlots.empty()) {
+            slot = cursorSlots.size();
+            cursorSlots.emplace_back();
+        } else {
+            slot = freeCursorSlots.back();
+            freeCursorSlots.pop_back();
+        }
+        cursorSlots[slot].cursor = &placed;
+        placed.handle = CursorHandle(slot, cursorSlots[slot].generation);
+    } else {
+        const auto handle = placed.handle;
+        placed = cursor;
+        placed.handle = handle;
+    }
+
+    if (placed.isPersistence()) {
+        persistenceCursor = placed.handle;
+    }
+    return placed;
 }
 
-bool CheckpointManager::removeCursor_UNLOCKED(const std::string &name) {
-    cursor_index::iterator it = connCursors.find(name);
+CursorHandle CheckpointManager::getCursorHandle(const std::string& name) const {
+    LockHolder lh(queueLock);
+    auto it = connCursors.find(name);
     if (it == connCursors.end()) {
+        return CursorHandle();
+    }
+    return it->second.handle;
+}
+
+bool CheckpointManager::removeCursor(CursorHandle handle) {
+    LockHolder lh(queueLock);
+    auto* cursor = getCursor_UNLOCKED(handle);
+    if (!cursor) {
         return false;
     }
+    return removeCursor_UNLOCKED(*cursor);
+}
 
+bool CheckpointManager::removeCursor_UNLOCKED(CheckpointCursor& cursor) {
     LOG(EXTENSION_LOG_INFO,
         "Remove the checkpoint cursor with the name \"%s\" from vbucket %d",
-        name.c_str(), vbucketId);
+        cursor.name.c_str(), vbucketId);
 
-    // We can simply remove the cursor's name from the checkpoint to which it
+    // We can simply remove the cursor from the checkpoint to which it
     // currently belongs,
     // by calling
-    // (*(it->second.currentCheckpoint))->removeCursorName(name);
+    // (*(cursor.currentCheckpoint))->removeCursor(cursor);
     // However, we just want to do more sanity checks by looking at each
     // checkpoint. This won't
     // cause much overhead because the max number of checkpoints allowed per
     // vbucket is small.
     for (const auto& checkpoint : checkpointList) {
-        checkpoint->removeCursorName(name);
+        checkpoint->removeCursor(cursor);
+    }
+
+    // Invalidate any outstanding handles and recycle the slot.
+    auto& slot = cursorSlots[cursor.handle.slot];
+    slot.cursor = nullptr;
+    if (++slot.generation == 0) {
+        slot.generation = 1;
     }
+    freeCursorSlots.push_back(cursor.handle.slot);
 
-    connCursors.erase(it);
+    connCursors.erase(connCursors.find(cursor.name));
     return true;
 }
 
-uint64_t CheckpointManager::getCheckpointIdForCursor(const std::string &name) {
+uint64_t CheckpointManager::getCheckpointIdForCursor(CursorHandle handle) {
     LockHolder lh(queueLock);
-    cursor_index::iterator it = connCursors.find(name);
-    if (it == connCursors.end()) {
+    auto* cursor = getCursor_UNLOCKED(handle);
+    if (!cursor) {
         return 0;
     }
 
-    return (*(it->second.currentCheckpoint))->getId();
+    return (*(cursor->currentCheckpoint))->getId();
 }
 
 size_t CheckpointManager::getNumOfCursors() {
@@ -980,9 +1277,9 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
     if (checkpointConfig.isCheckpointMergeSupported() &&
         !checkpointConfig.canKeepClosedCheckpoints() &&
         vbucket.getState() == vbucket_state_replica) {
-        size_t curr_remains = getNumItemsForCursor_UNLOCKED(pCursorName);
+        size_t curr_remains = getNumItemsForCursor_UNLOCKED(persistenceCursor);
         collapseClosedCheckpoints(unrefCheckpointList);
-        size_t new_remains = getNumItemsForCursor_UNLOCKED(pCursorName);
+        size_t new_remains = getNumItemsForCursor_UNLOCKED(persistenceCursor);
         updateDiskQueueStats(vbucket, curr_remains, new_remains);
     }
     lh.unlock();
@@ -992,20 +1289,15 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
 
 void CheckpointManager::removeInvalidCursorsOnCheckpoint(
                                                      Checkpoint *pCheckpoint) {
-    std::list<std::string> invalidCursorNames;
-    const std::set<std::string> &cursors = pCheckpoint->getCursorNameList();
-    std::set<std::string>::const_iterator cit = cursors.begin();
-    for (; cit != cursors.end(); ++cit) {
-        cursor_index::iterator mit = connCursors.find(*cit);
-        if (mit == connCursors.end() ||
-            pCheckpoint != (*(mit->second.currentCheckpoint)).get()) {
-            invalidCursorNames.push_back(*cit);
+    std::list<CheckpointCursor*> invalidCursors;
+    for (auto* cursor : pCheckpoint->getCursorList()) {
+        if (pCheckpoint != (*(cursor->currentCheckpoint)).get()) {
+            invalidCursors.push_back(cursor);
         }
     }
 
-    std::list<std::string>::iterator it = invalidCursorNames.begin();
-    for (; it != invalidCursorNames.end(); ++it) {
-        pCheckpoint->removeCursorName(*it);
+    for (auto* cursor : invalidCursors) {
+        pCheckpoint->removeCursor(*cursor);
     }
 }
 
@@ -1016,29 +1308,23 @@ void CheckpointManager::collapseClosedCheckpoints(
     // closed checkpoints into one checkpoint to reduce the memory overhead.
     if (checkpointList.size() > 2) {
         CursorIdToPositionMap slowCursors;
-        std::set<std::string> fastCursors;
+        std::set<CheckpointCursor*> fastCursors;
         auto lastClosedChk = checkpointList.end();
         --lastClosedChk; --lastClosedChk; // Move to the last closed chkpt.
-        std::set<std::string>::iterator nitr =
-                (*lastClosedChk)->getCursorNameList().begin();
         // Check if there are any cursors in the last closed checkpoint, which
         // haven't yet visited any regular items belonging to the last closed
         // checkpoint. If so, then we should skip collapsing checkpoints until
         // those cursors move to the first regular item. Otherwise, those cursors will
         // visit old items from collapsed checkpoints again.
-        for (; nitr != (*lastClosedChk)->getCursorNameList().end(); ++nitr) {
-            cursor_index::iterator cc = connCursors.find(*nitr);
-            if (cc == connCursors.end()) {
-                continue;
-            }
-            queue_op qop = (*(cc->second.currentPos))->getOperation();
+        for (auto* cursor : (*lastClosedChk)->getCursorList()) {
+            queue_op qop = (*(cursor->currentPos))->getOperation();
             if (qop ==  queue_op::empty || qop == queue_op::checkpoint_start) {
                 return;
             }
         }
 
-        fastCursors.insert((*lastClosedChk)->getCursorNameList().begin(),
-                           (*lastClosedChk)->getCursorNameList().end());
+        fastCursors.insert((*lastClosedChk)->getCursorList().begin(),
+                           (*lastClosedChk)->getCursorList().end());
         auto rit = checkpointList.rbegin();
         ++rit; ++rit; //Move to the second last closed checkpoint.
         size_t numDuplicatedItems = 0, numMetaItems = 0;
@@ -1048,19 +1334,16 @@ void CheckpointManager::collapseClosedCheckpoints(
             numDuplicatedItems += ((*rit)->getNumItems() - numAddedItems);
             numMetaItems += (*rit)->getNumMetaItems();
 
-            std::set<std::string>::iterator nameItr =
-                (*rit)->getCursorNameList().begin();
-            for (; nameItr != (*rit)->getCursorNameList().end(); ++nameItr) {
-                cursor_index::iterator cc = connCursors.find(*nameItr);
-                const auto key = (*(cc->second.currentPos))->getKey();
+            for (auto* cursor : (*rit)->getCursorList()) {
+                const auto key = (*(cursor->currentPos))->getKey();
                 bool isMetaItem =
-                            (*(cc->second.currentPos))->isCheckPointMetaItem();
+                            (*(cursor->currentPos))->isCheckPointMetaItem();
                 bool cursor_on_chk_start = false;
-                if ((*(cc->second.currentPos))->getOperation() ==
+                if ((*(cursor->currentPos))->getOperation() ==
                     queue_op::checkpoint_start) {
                     cursor_on_chk_start = true;
                 }
-                slowCursors[*nameItr] =
+                slowCursors[cursor] =
                     CursorPosition{(*rit)->getMutationIdForKey(key, isMetaItem),
                                    cursor_on_chk_start};
             }
@@ -1070,17 +1353,13 @@ void CheckpointManager::collapseClosedCheckpoints(
         size_t total_items = numDuplicatedItems + numMetaItems;
         numItems.fetch_sub(total_items);
         auto& openCheckpoint = checkpointList.back();
-        const std::set<std::string>& openCheckpointCursors =
-                openCheckpoint->getCursorNameList();
+        const std::set<CheckpointCursor*>& openCheckpointCursors =
+                openCheckpoint->getCursorList();
         fastCursors.insert(openCheckpointCursors.begin(),
                            openCheckpointCursors.end());
-        std::set<std::string>::const_iterator cit = fastCursors.begin();
         // Update the offset of each fast cursor.
-        for (; cit != fastCursors.end(); ++cit) {
-            cursor_index::iterator mit = connCursors.find(*cit);
-            if (mit != connCursors.end()) {
-                mit->second.decrOffset(total_items);
-            }
+        for (auto* cursor : fastCursors) {
+            cursor->decrOffset(total_items);
         }
         collapsedChks.splice(collapsedChks.end(), checkpointList,
                              checkpointList.begin(),  lastClosedChk);
@@ -1106,8 +1385,9 @@ std::vector<std::string> CheckpointManager::getListOfCursorsToDrop() {
     auto it = checkpointList.begin();
     while (num_checkpoints_to_unref != 0 && it != checkpointList.end()) {
         if ((*it)->isEligibleToBeUnreferenced()) {
-            const std::set<std::string> &cursors = (*it)->getCursorNameList();
-            cursorsToDrop.insert(cursorsToDrop.end(), cursors.begin(), cursors.end());
+            for (const auto* cursor : (*it)->getCursorList()) {
+                cursorsToDrop.push_back(cursor->name);
+            }
         } else {
             break;
         }
@@ -1123,7 +1403,7 @@ void CheckpointManager::updateStatsForNewQueuedItem_UNLOCKED(const LockHolder&,
     ++stats.totalEnqueued;
     if (checkpointConfig.isPersistenceEnabled()) {
         ++stats.diskQueueSize;
-        vb.doStatsForQueueing(*qi, qi->size());
+        vb.doStatsForQueueing(*qi, qi->sizeWithoutCompressedValue());
     }
     // Update the checkpoint's memory usage
     checkpointList.back()->incrementMemConsumption(qi->size());
@@ -1233,47 +1513,65 @@ void CheckpointManager::queueSetVBState(VBucket& vb) {
     }
 }
 
-snapshot_range_t CheckpointManager::getAllItemsForCursor(
-                                             const std::string& name,
-                                             std::vector<queued_item> &items) {
+CheckpointManager::ItemsForCursor CheckpointManager::getItemsForCursor(
+        CursorHandle handle,
+        std::vector<queued_item>& items,
+        size_t approxLimit,
+        size_t approxBytesLimit) {
     LockHolder lh(queueLock);
-    snapshot_range_t range;
-    cursor_index::iterator it = connCursors.find(name);
-    if (it == connCursors.end()) {
-        range.start = 0;
-        range.end = 0;
-        return range;
-    }
-
-    bool moreItems;
-    range.start = (*it->second.currentCheckpoint)->getSnapshotStartSeqno();
-    while ((moreItems = incrCursor(it->second))) {
-        queued_item& qi = *(it->second.currentPos);
+    ItemsForCursor result;
+    auto* cursor = getCursor_UNLOCKED(handle);
+    if (!cursor) {
+        return result;
+    }
+
+    size_t itemCount = 0;
+    size_t itemBytes = 0;
+    auto& range = result.range;
+    range.start = (*cursor->currentCheckpoint)->getSnapshotStartSeqno();
+    range.end = 0;
+    while (incrCursor(*cursor)) {
+        queued_item& qi = *(cursor->currentPos);
         items.push_back(qi);
+        ++itemCount;
+        itemBytes += qi->size();
 
         if (qi->getOperation() == queue_op::checkpoint_end) {
-            moveCursorToNextCheckpoint(it->second);
+            if ((approxLimit && itemCount >= approxLimit) ||
+                (approxBytesLimit && itemBytes >= approxBytesLimit)) {
+                // Stop at this checkpoint boundary; the range is that of the
+                // checkpoint just completed.
+                range.end = (*cursor->currentCheckpoint)->getSnapshotEndSeqno();
+                result.moreAvailable = true;
+                moveCursorToNextCheckpoint(*cursor);
+                break;
+            }
+            moveCursorToNextCheckpoint(*cursor);
         }
     }
-    range.end = (*it->second.currentCheckpoint)->getSnapshotEndSeqno();
+    if (!result.moreAvailable) {
+        range.end = (*cursor->currentCheckpoint)->getSnapshotEndSeqno();
+    }
 
-    LOG(EXTENSION_LOG_DEBUG, "CheckpointManager::getAllItemsForCursor() "
-            "cursor:%s range:{%" PRIu64 ", %" PRIu64 "}",
-            name.c_str(), range.start, range.end);
+    LOG(EXTENSION_LOG_DEBUG, "CheckpointManager::getItemsForCursor() "
+            "cursor:%s range:{%" PRIu64 ", %" PRIu64 "} items:%" PRIu64
+            " moreAvailable:%s",
+            cursor->name.c_str(), range.start, range.end,
+            uint64_t(itemCount), result.moreAvailable ? "true" : "false");
 
-    it->second.numVisits++;
+    cursor->numVisits++;
 
-    return range;
+    return result;
 }
 
-queued_item CheckpointManager::nextItem(const std::string &name,
+queued_item CheckpointManager::nextItem(CursorHandle handle,
                                         bool &isLastMutationItem) {
     LockHolder lh(queueLock);
-    cursor_index::iterator it = connCursors.find(name);
-    if (it == connCursors.end()) {
+    auto* cursorPtr = getCursor_UNLOCKED(handle);
+    if (!cursorPtr) {
         LOG(EXTENSION_LOG_WARNING,
-        "The cursor with name \"%s\" is not found in the checkpoint of vbucket"
-        "%d.\n", name.c_str(), vbucketId);
+        "The cursor is not found in the checkpoint of vbucket %d.\n",
+        vbucketId);
         queued_item qi(new Item(DocKey("", DocNamespace::System), 0xffff,
                                 queue_op::empty, 0, 0));
         return qi;
@@ -1288,7 +1586,7 @@ queued_item CheckpointManager::nextItem(const std::string &name,
         return qi;
     }
 
-    CheckpointCursor &cursor = it->second;
+    CheckpointCursor &cursor = *cursorPtr;
     if (incrCursor(cursor)) {
         isLastMutationItem = isLastMutationItemInCheckpoint(cursor);
         return *(cursor.currentPos);
@@ -1344,7 +1642,7 @@ void CheckpointManager::clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno)
 
 void CheckpointManager::resetCursors(bool resetPersistenceCursor) {
     for (auto& cit : connCursors) {
-        if (cit.second.name.compare(pCursorName) == 0) {
+        if (cit.second.isPersistence()) {
             if (!resetPersistenceCursor) {
                 continue;
             } else {
@@ -1356,7 +1654,7 @@ void CheckpointManager::resetCursors(bool resetPersistenceCursor) {
         cit.second.currentPos = checkpointList.front()->begin();
         cit.second.offset = 0;
         cit.second.setMetaItemOffset(0);
-        checkpointList.front()->registerCursorName(cit.second.name);
+        checkpointList.front()->registerCursor(cit.second);
     }
 }
 
@@ -1379,13 +1677,13 @@ bool CheckpointManager::moveCursorToNextCheckpoint(CheckpointCursor &cursor) {
         }
     }
 
-    // Remove the cursor's name from its current checkpoint.
-    (*it)->removeCursorName(cursor.name);
+    // Remove the cursor from its current checkpoint.
+    (*it)->removeCursor(cursor);
     // Move the cursor to the next checkpoint.
     ++it;
     cursor.currentPos = (*it)->begin();
-    // Register the cursor's name to its new current checkpoint.
-    (*it)->registerCursorName(cursor.name);
+    // Register the cursor to its new current checkpoint.
+    (*it)->registerCursor(cursor);
 
     // Reset metaItemOffset as we're entering a new checkpoint.
     cursor.setMetaItemOffset(0);
@@ -1426,17 +1724,17 @@ uint64_t CheckpointManager::checkOpenCheckpoint_UNLOCKED(bool forceCreation,
     return checkpoint_id;
 }
 
-size_t CheckpointManager::getNumItemsForCursor(const std::string &name) const {
+size_t CheckpointManager::getNumItemsForCursor(CursorHandle cursor) const {
     LockHolder lh(queueLock);
-    return getNumItemsForCursor_UNLOCKED(name);
+    return getNumItemsForCursor_UNLOCKED(cursor);
 }
 
 size_t CheckpointManager::getNumItemsForCursor_UNLOCKED(
-                                                const std::string &name) const {
+                                                CursorHandle handle) const {
     size_t remains = 0;
-    cursor_index::const_iterator it = connCursors.find(name);
-    if (it != connCursors.end()) {
-        size_t offset = it->second.offset + getNumOfMetaItemsFromCursor(it->second);
+    const auto* cursor = getCursor_UNLOCKED(handle);
+    if (cursor) {
+        size_t offset = cursor->offset + getNumOfMetaItemsFromCursor(*cursor);
         remains = (numItems > offset) ? numItems - offset : 0;
     }
     return remains;
@@ -1468,13 +1766,13 @@ size_t CheckpointManager::getNumOfMetaItemsFromCursor(const CheckpointCursor &cu
     return result;
 }
 
-void CheckpointManager::decrCursorFromCheckpointEnd(const std::string &name) {
+void CheckpointManager::decrCursorFromCheckpointEnd(CursorHandle handle) {
     LockHolder lh(queueLock);
-    cursor_index::iterator it = connCursors.find(name);
-    if (it != connCursors.end() &&
-        (*(it->second.currentPos))->getOperation() ==
+    auto* cursor = getCursor_UNLOCKED(handle);
+    if (cursor &&
+        (*(cursor->currentPos))->getOperation() ==
         queue_op::checkpoint_end) {
-        it->second.decrPos();
+        cursor->decrPos();
     }
 }
 
@@ -1635,22 +1933,21 @@ void CheckpointManager::checkAndAddNewCheckpoint(uint64_t id,
             // Reposition all the cursors in the open checkpoint to the
             // begining position so that a checkpoint_start message can be
             // sent again with the correct id.
-            for (const auto& cit : checkpointList.back()->getCursorNameList()) {
-                if (cit == pCursorName) {
+            for (auto* cursor : checkpointList.back()->getCursorList()) {
+                if (cursor->isPersistence()) {
                     // Persistence cursor
                     continue;
                 } else { // Dcp/Tap cursors
-                    cursor_index::iterator mit = connCursors.find(cit);
-                    mit->second.currentPos = checkpointList.back()->begin();
+                    cursor->currentPos = checkpointList.back()->begin();
                 }
             }
         } else {
             addNewCheckpoint_UNLOCKED(id);
         }
     } else {
-        size_t curr_remains = getNumItemsForCursor_UNLOCKED(pCursorName);
+        size_t curr_remains = getNumItemsForCursor_UNLOCKED(persistenceCursor);
         collapseCheckpoints(id);
-        size_t new_remains = getNumItemsForCursor_UNLOCKED(pCursorName);
+        size_t new_remains = getNumItemsForCursor_UNLOCKED(persistenceCursor);
         updateDiskQueueStats(vbucket, curr_remains, new_remains);
     }
 }
@@ -1662,14 +1959,14 @@ void CheckpointManager::collapseCheckpoints(uint64_t id) {
     }
 
     CursorIdToPositionMap cursorMap;
-    for (const auto itr : connCursors) {
+    for (auto& itr : connCursors) {
         const bool isMetaItem = (*(itr.second.currentPos))->isCheckPointMetaItem();
         const bool cursor_on_chk_start = (*(itr.second.currentPos))->getOperation() ==
                 queue_op::checkpoint_start;
 
         auto& chk = *(itr.second.currentCheckpoint);
         auto key = (*(itr.second.currentPos))->getKey();
-        cursorMap[itr.first] = CursorPosition{chk->getMutationIdForKey(key, isMetaItem),
+        cursorMap[&itr.second] = CursorPosition{chk->getMutationIdForKey(key, isMetaItem),
                                               cursor_on_chk_start};
     }
 
@@ -1729,18 +2026,17 @@ void CheckpointManager::putCursorsInCollapsedChk(
                   cursor_pos.onCpktStart &&
                   (*last)->getOperation() == queue_op::checkpoint_start)) {
 
-                cursor_index::iterator cc = connCursors.find(mit->first);
-                if (cc == connCursors.end() ||
-                    cc->second.fromBeginningOnChkCollapse) {
+                auto* cursor = mit->first;
+                if (cursor->fromBeginningOnChkCollapse) {
                     ++mit;
                     continue;
                 }
-                cc->second.currentCheckpoint = chkItr;
-                cc->second.currentPos = last;
-                cc->second.offset = (i > 0) ? i - 1 : 0;
-                cc->second.setMetaItemOffset(last_meta_item_count);
+                cursor->currentCheckpoint = chkItr;
+                cursor->currentPos = last;
+                cursor->offset = (i > 0) ? i - 1 : 0;
+                cursor->setMetaItemOffset(last_meta_item_count);
 
-                chk->registerCursorName(cc->second.name);
+                chk->registerCursor(*cursor);
                 cursors.erase(mit++);
             } else {
                 ++mit;
@@ -1761,36 +2057,33 @@ void CheckpointManager::putCursorsInCollapsedChk(
     // position either at the checkpoint start (if
     // fromBeginningOnChkCollapse==true) or otherwise at the checkpoint end.
     for (auto& cur : cursors) {
-        cursor_index::iterator cc = connCursors.find(cur.first);
-        if (cc == connCursors.end()) {
-            continue;
-        }
-        cc->second.currentCheckpoint = chkItr;
-        if (cc->second.fromBeginningOnChkCollapse) {
-            cc->second.currentPos = chk->begin();
-            cc->second.offset = 0;
-            cc->second.setMetaItemOffset(0);
+        auto* cursor = cur.first;
+        cursor->currentCheckpoint = chkItr;
+        if (cursor->fromBeginningOnChkCollapse) {
+            cursor->currentPos = chk->begin();
+            cursor->offset = 0;
+            cursor->setMetaItemOffset(0);
         } else {
-            cc->second.currentPos = last;
-            cc->second.offset = (i > 0) ? i - 1 : 0;
-            cc->second.setMetaItemOffset(chk->getNumMetaItems());
+            cursor->currentPos = last;
+            cursor->offset = (i > 0) ? i - 1 : 0;
+            cursor->setMetaItemOffset(chk->getNumMetaItems());
         }
-        chk->registerCursorName(cc->second.name);
+        chk->registerCursor(*cursor);
     }
 }
 
-bool CheckpointManager::hasNext(const std::string &name) {
+bool CheckpointManager::hasNext(CursorHandle handle) {
     LockHolder lh(queueLock);
-    cursor_index::iterator it = connCursors.find(name);
-    if (it == connCursors.end() || getOpenCheckpointId_UNLOCKED() == 0) {
+    auto* cursor = getCursor_UNLOCKED(handle);
+    if (!cursor || getOpenCheckpointId_UNLOCKED() == 0) {
         return false;
     }
 
     bool hasMore = true;
-    CheckpointQueue::iterator curr = it->second.currentPos;
+    CheckpointQueue::iterator curr = cursor->currentPos;
     ++curr;
-    if (curr == (*(it->second.currentCheckpoint))->end() &&
-        (*(it->second.currentCheckpoint)) == checkpointList.back()) {
+    if (curr == (*(cursor->currentCheckpoint))->end() &&
+        (*(cursor->currentCheckpoint)) == checkpointList.back()) {
         hasMore = false;
     }
     return hasMore;
@@ -1847,9 +2140,9 @@ uint64_t CheckpointManager::getPersistenceCursorPreChkId() {
 
 void CheckpointManager::itemsPersisted() {
     LockHolder lh(queueLock);
-    auto persistenceCursor = connCursors.find(pCursorName);
-    if (persistenceCursor != connCursors.end()) {
-        auto itr = persistenceCursor->second.currentCheckpoint;
+    auto* cursor = getCursor_UNLOCKED(persistenceCursor);
+    if (cursor) {
+        auto itr = cursor->currentCheckpoint;
         pCursorPreCheckpointId = ((*itr)->getId() > 0) ? (*itr)->getId() - 1 : 0;
     }
 }
@@ -1871,6 +2164,20 @@ size_t CheckpointManager::getMemoryUsage() const {
     return getMemoryUsage_UNLOCKED();
 }
 
+void CheckpointManager::chargeItemMemory(int64_t seqno, size_t bytes) {
+    LockHolder lh(queueLock);
+    for (auto& checkpoint : checkpointList) {
+        if (static_cast<uint64_t>(seqno) < checkpoint->getLowSeqno()) {
+            // The item's checkpoint has already been removed.
+            return;
+        }
+        if (static_cast<uint64_t>(seqno) <= checkpoint->getHighSeqno()) {
+            checkpoint->incrementMemConsumption(bytes);
+            return;
+        }
+    }
+}
+
 size_t CheckpointManager::getMemoryUsageOfUnrefCheckpoints() const {
     LockHolder lh(queueLock);
 
@@ -1915,7 +2222,7 @@ void CheckpointManager::addStats(ADD_STAT add_stat, const void *cookie) {
         add_casted_stat(buf, checkpointList.size(), add_stat, cookie);
         checked_snprintf(buf, sizeof(buf), "vb_%d:num_items_for_persistence",
                          vbucketId);
-        add_casted_stat(buf, getNumItemsForCursor_UNLOCKED(pCursorName),
+        add_casted_stat(buf, getNumItemsForCursor_UNLOCKED(persistenceCursor),
                         add_stat, cookie);
         checked_snprintf(buf, sizeof(buf), "vb_%d:mem_usage", vbucketId);
         add_casted_stat(buf, getMemoryUsage_UNLOCKED(), add_stat, cookie);
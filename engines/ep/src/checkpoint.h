@@ -27,7 +27,10 @@
 #include "locks.h"
 #include "stats.h"
 
+#include <array>
 #include <atomic>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <map>
 #include <memory>
@@ -49,6 +52,9 @@
 #define DEFAULT_MAX_CHECKPOINTS 2
 #define MAX_CHECKPOINTS_UPPER_BOUND 5
 
+#define DEFAULT_CURSOR_BATCH_ITEMS 10000
+#define DEFAULT_CURSOR_BATCH_BYTES (10 * 1024 * 1024)
+
 /**
  * The state of a given checkpoint.
  */
@@ -59,16 +65,307 @@ enum checkpoint_state {
 
 const char* to_string(enum checkpoint_state);
 
-// List is used for queueing mutations as vector incurs shift operations for
-// deduplication.
-typedef std::list<queued_item> CheckpointQueue;
+/**
+ * Append-only queue of the items of a Checkpoint.
+ *
+ * Items are stored in fixed-size chunks, so appending never moves existing
+ * items and only allocates once per ChunkSize items. De-duplicated items are
+ * tombstoned (their slot reset to null) rather than unlinked; iteration skips
+ * tombstones. A position is a plain slot number, so iterators stay valid as
+ * the queue grows - only rebuild() (used to drop tombstones, see
+ * needsCompaction()) moves items, and it reports where each slot went.
+ */
+class CheckpointQueue {
+public:
+    static const size_t ChunkSize = 256;
+
+    /**
+     * Bidirectional iterator over the live (non-tombstoned) items.
+     */
+    template <typename Queue, typename Value>
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = queued_item;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Iterator() : queue(nullptr), slot(0) {
+        }
+
+        Iterator(Queue* queue, size_t slot) : queue(queue), slot(slot) {
+        }
+
+        // Allow iterator -> const_iterator conversion.
+        template <typename Q, typename V>
+        Iterator(const Iterator<Q, V>& other)
+            : queue(other.queue), slot(other.slot) {
+        }
+
+        reference operator*() const {
+            return queue->at(slot);
+        }
+
+        pointer operator->() const {
+            return &queue->at(slot);
+        }
+
+        Iterator& operator++() {
+            slot = queue->nextLive(slot);
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp(*this);
+            ++*this;
+            return tmp;
+        }
+
+        Iterator& operator--() {
+            slot = queue->prevLive(slot);
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp(*this);
+            --*this;
+            return tmp;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return slot == other.slot && queue == other.queue;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        /// The slot number this iterator refers to.
+        size_t getSlot() const {
+            return slot;
+        }
+
+    private:
+        template <typename Q, typename V>
+        friend class Iterator;
+
+        Queue* queue;
+        size_t slot;
+    };
+
+    using iterator = Iterator<CheckpointQueue, queued_item>;
+    using const_iterator = Iterator<const CheckpointQueue, const queued_item>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    CheckpointQueue() = default;
+
+    CheckpointQueue(const CheckpointQueue&) = delete;
+    CheckpointQueue& operator=(const CheckpointQueue&) = delete;
+
+    /// Append an item, returning its slot.
+    size_t push_back(const queued_item& qi);
+
+    /// Tombstone the item at the given position.
+    void erase(iterator pos);
+
+    /// The last live item. The queue must not be empty.
+    queued_item& back() {
+        return at(prevLive(numSlots));
+    }
+
+    /// Remove the last live item (and any tombstones after it).
+    void pop_back();
+
+    /// Number of live items.
+    size_t size() const {
+        return numLive;
+    }
+
+    bool empty() const {
+        return numLive == 0;
+    }
+
+    /// Number of slots used (live items plus tombstones).
+    size_t getNumSlots() const {
+        return numSlots;
+    }
+
+    size_t getNumTombstones() const {
+        return numSlots - numLive;
+    }
+
+    /**
+     * Are enough slots tombstoned that the queue should be rebuilt (to
+     * bound the memory used by a heavily de-duplicated checkpoint)?
+     */
+    bool needsCompaction() const {
+        return getNumTombstones() >= ChunkSize &&
+               getNumTombstones() > numLive;
+    }
+
+    /**
+     * Rebuild the queue from the live items at the given slots, in the given
+     * order; any other items are dropped.
+     *
+     * @return the new slot of every old slot (indexed by old slot, with one
+     *         extra element mapping the old end to the new end). Slots which
+     *         were dropped map to the new slot of the closest preceding slot
+     *         which was kept.
+     */
+    std::vector<size_t> rebuild(const std::vector<size_t>& order);
+
+    /// Rebuild the queue without its tombstones; see rebuild().
+    std::vector<size_t> compact();
+
+    /// Memory used by the queue itself (excluding the items).
+    size_t memorySize() const {
+        return chunks.capacity() * sizeof(std::unique_ptr<Chunk>) +
+               chunks.size() * sizeof(Chunk);
+    }
+
+    queued_item& at(size_t slot) {
+        return (*chunks[slot / ChunkSize])[slot % ChunkSize];
+    }
+
+    const queued_item& at(size_t slot) const {
+        return (*chunks[slot / ChunkSize])[slot % ChunkSize];
+    }
+
+    /// An iterator referring to the given slot.
+    iterator makeIterator(size_t slot) {
+        return iterator(this, slot);
+    }
+
+    iterator begin() {
+        return iterator(this, firstLive());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, firstLive());
+    }
+
+    iterator end() {
+        return iterator(this, numSlots);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, numSlots);
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+private:
+    using Chunk = std::array<queued_item, ChunkSize>;
+
+    size_t firstLive() const {
+        return (numSlots > 0 && !at(0)) ? nextLive(0) : 0;
+    }
+
+    size_t nextLive(size_t slot) const {
+        do {
+            ++slot;
+        } while (slot < numSlots && !at(slot));
+        return slot;
+    }
+
+    size_t prevLive(size_t slot) const {
+        while (slot > 0) {
+            --slot;
+            if (at(slot)) {
+                break;
+            }
+        }
+        return slot;
+    }
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    size_t numSlots = 0;
+    size_t numLive = 0;
+};
 
 /**
- * A checkpoint index entry.
+ * Open-addressing (linear probing) index from a key to the position and
+ * mutation id of the key's latest item in a CheckpointQueue.
+ *
+ * Keys are not copied into the index: an entry holds the key's hash and the
+ * slot of its item, and a lookup compares the key against that item's key.
  */
-struct index_entry {
-    CheckpointQueue::iterator position;
-    int64_t mutation_id;
+class CheckpointIndex {
+public:
+    struct Entry {
+        size_t position;
+        int64_t mutation_id;
+    };
+
+    explicit CheckpointIndex(const CheckpointQueue& queue) : queue(queue) {
+    }
+
+    /// @return the entry for key, or nullptr if not present.
+    Entry* find(const DocKey& key);
+
+    /**
+     * Add an entry for a key which is not present. The item at
+     * entry.position must have the given key.
+     */
+    void insert(const DocKey& key, const Entry& entry);
+
+    /// Remove the entry for key, if present.
+    void erase(const DocKey& key);
+
+    /**
+     * Update the positions of all entries after the queue was rebuilt.
+     * @param newSlots as returned by CheckpointQueue::rebuild()
+     */
+    void remap(const std::vector<size_t>& newSlots);
+
+    size_t size() const {
+        return count;
+    }
+
+    /// Memory used by the index.
+    size_t memorySize() const {
+        return slots.capacity() * sizeof(Slot);
+    }
+
+private:
+    static const size_t EmptySlot = std::numeric_limits<size_t>::max();
+    static const size_t InitialCapacity = 16;
+
+    struct Slot {
+        Entry entry;
+        uint32_t hash;
+    };
+
+    /// Home slot for a hash; slots.size() must be a power of two.
+    size_t homeSlot(uint32_t hash) const {
+        return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    size_t findSlot(const DocKey& key, uint32_t hash) const;
+
+    void grow();
+
+    const CheckpointQueue& queue;
+    std::vector<Slot> slots;
+    size_t count = 0;
+    // 64 - log2(slots.size())
+    unsigned shift = 64;
 };
 
 /**
@@ -79,11 +376,6 @@ enum class MustSendCheckpointEnd {
     YES
 };
 
-/**
- * The checkpoint index maps a key to a checkpoint index_entry.
- */
-typedef std::unordered_map<StoredDocKey, index_entry> checkpoint_index;
-
 /**
  * List of pairs containing checkpoint cursor name and corresponding flag
  * indicating whether we must send checkpoint end meta item for the cursor
@@ -101,6 +393,47 @@ class VBucket;
 // a given vBucket.
 using CheckpointList = std::list<std::unique_ptr<Checkpoint>>;
 
+/**
+ * Handle to a cursor registered with a CheckpointManager.
+ *
+ * Returned when a cursor is registered, and passed back to the per-item
+ * CheckpointManager functions so they can locate the cursor directly rather
+ * than looking it up by name (the name is only kept for stats and logging).
+ * A handle is invalidated when its cursor is removed; a function given an
+ * invalidated (or default-constructed) handle behaves as if the cursor does
+ * not exist.
+ */
+class CursorHandle {
+public:
+    CursorHandle() = default;
+
+    /// Was this handle issued by a CheckpointManager?
+    bool valid() const {
+        return generation != 0;
+    }
+
+    bool operator==(const CursorHandle& other) const {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const CursorHandle& other) const {
+        return !(*this == other);
+    }
+
+private:
+    CursorHandle(uint32_t slot, uint32_t generation)
+        : slot(slot), generation(generation) {
+    }
+
+    // Index into CheckpointManager::cursorSlots.
+    uint32_t slot = 0;
+    // Must match the slot's generation for the handle to be current; zero
+    // is never a slot generation.
+    uint32_t generation = 0;
+
+    friend class CheckpointManager;
+};
+
 /**
  * A checkpoint cursor, representing the current position in a Checkpoint
  * series.
@@ -134,14 +467,7 @@ public:
 
     CheckpointCursor() { }
 
-    CheckpointCursor(const std::string &n)
-        : name(n),
-          currentCheckpoint(),
-          currentPos(),
-          offset(0),
-          ckptMetaItemsRead(0),
-          fromBeginningOnChkCollapse(false),
-          sendCheckpointEndMetaItem(MustSendCheckpointEnd::YES) { }
+    CheckpointCursor(const std::string& n);
 
     /**
      * @param offset_ Count of items (normal+meta) already read for *all*
@@ -155,21 +481,13 @@ public:
                      size_t offset_,
                      size_t meta_items_read,
                      bool beginningOnChkCollapse,
-                     MustSendCheckpointEnd needsCheckpointEndMetaItem)
-        : name(n),
-          currentCheckpoint(checkpoint),
-          currentPos(pos),
-          numVisits(0),
-          offset(offset_),
-          ckptMetaItemsRead(meta_items_read),
-          fromBeginningOnChkCollapse(beginningOnChkCollapse),
-          sendCheckpointEndMetaItem(needsCheckpointEndMetaItem) {
-    }
+                     MustSendCheckpointEnd needsCheckpointEndMetaItem);
 
     // We need to define the copy construct explicitly due to the fact
     // that std::atomic implicitly deleted the assignment operator
     CheckpointCursor(const CheckpointCursor &other) :
-        name(other.name), currentCheckpoint(other.currentCheckpoint),
+        name(other.name), persistence(other.persistence),
+        handle(other.handle), currentCheckpoint(other.currentCheckpoint),
         currentPos(other.currentPos), numVisits(other.numVisits.load()),
         offset(other.offset.load()),
         ckptMetaItemsRead(other.ckptMetaItemsRead),
@@ -178,6 +496,8 @@ public:
 
     CheckpointCursor &operator=(const CheckpointCursor &other) {
         name.assign(other.name);
+        persistence = other.persistence;
+        handle = other.handle;
         currentCheckpoint = other.currentCheckpoint;
         currentPos = other.currentPos;
         numVisits = other.numVisits.load();
@@ -209,6 +529,11 @@ public:
      */
     size_t getCurrentCkptMetaItemsRead() const;
 
+    /// Is this the persistence cursor (CheckpointManager::pCursorName)?
+    bool isPersistence() const {
+        return persistence;
+    }
+
 protected:
     void incrMetaItemOffset(size_t incr) {
         ckptMetaItemsRead += incr;
@@ -220,6 +545,8 @@ protected:
 
 private:
     std::string                      name;
+    bool persistence = false;
+    CursorHandle handle;
     CheckpointList::iterator currentCheckpoint;
     CheckpointQueue::iterator currentPos;
 
@@ -410,30 +737,30 @@ public:
     }
 
     /**
-     * Register a cursor's name to this checkpoint
+     * Register a cursor to this checkpoint
      */
-    void registerCursorName(const std::string &name) {
-        cursors.insert(name);
+    void registerCursor(CheckpointCursor& cursor) {
+        cursors.insert(&cursor);
     }
 
     /**
-     * Remove a cursor's name from this checkpoint
+     * Remove a cursor from this checkpoint
      */
-    void removeCursorName(const std::string &name) {
-        cursors.erase(name);
+    void removeCursor(CheckpointCursor& cursor) {
+        cursors.erase(&cursor);
     }
 
     /**
-     * Return true if the cursor with a given name exists in this checkpoint
+     * Return true if the given cursor is registered to this checkpoint
      */
-    bool hasCursorName(const std::string &name) const {
-        return cursors.find(name) != cursors.end();
+    bool hasCursor(CheckpointCursor& cursor) const {
+        return cursors.find(&cursor) != cursors.end();
     }
 
     /**
-     * Return the list of all cursor names in this checkpoint
+     * Return the list of all cursors in this checkpoint
      */
-    const std::set<std::string> &getCursorNameList() const {
+    const std::set<CheckpointCursor*>& getCursorList() const {
         return cursors;
     }
 
@@ -567,21 +894,46 @@ private:
     size_t                         numItems;
     /// Number of meta items (see Item::isCheckPointMetaItem).
     size_t numMetaItems;
-    std::set<std::string>          cursors; // List of cursors with their unique names.
+    std::set<CheckpointCursor*>    cursors; // Cursors registered to this checkpoint.
     CheckpointQueue                toWrite;
-    checkpoint_index               keyIndex;
+    CheckpointIndex                keyIndex;
     /* Index for meta keys like "dummy_key" */
-    checkpoint_index               metaKeyIndex;
+    CheckpointIndex                metaKeyIndex;
     size_t                         memOverhead;
 
     // The following stat is to contain the memory consumption of all
     // the queued items in the given checkpoint.
     size_t                         effectiveMemUsage;
 
+    /**
+     * Recalculate memOverhead from the sizes of the queue and indexes,
+     * applying the difference to stats.memOverhead.
+     */
+    void updateMemOverhead();
+
+    /**
+     * Drop the tombstones from toWrite, updating the indexes and the
+     * positions of any cursors in this checkpoint.
+     */
+    void compact(CheckpointManager& checkpointManager);
+
     friend std::ostream& operator <<(std::ostream& os, const Checkpoint& m);
 };
 
-typedef std::pair<uint64_t, bool> CursorRegResult;
+/**
+ * Result of CheckpointManager::registerCursorBySeqno.
+ */
+struct CursorRegResult {
+    /// The bySeqno with which the cursor can start.
+    uint64_t seqno;
+    /**
+     * Does the cursor start with the first item of the first checkpoint? If
+     * so, earlier items may already have been removed from memory.
+     */
+    bool startsAtFirstItem;
+    /// Handle of the registered cursor.
+    CursorHandle cursor;
+};
 
 /**
  * Representation of a checkpoint manager that maintains the list of checkpoints
@@ -634,8 +986,8 @@ public:
      * @param needsCheckpointEndMetaItem indicates the CheckpointEndMetaItem
      *        must not be skipped for the cursor.
      * @return Cursor registration result which consists of (1) the bySeqno with
-     * which the cursor can start and (2) flag indicating if the cursor starts
-     * with the first item on a checkpoint.
+     * which the cursor can start, (2) flag indicating if the cursor starts
+     * with the first item on a checkpoint and (3) the cursor's handle.
      */
     CursorRegResult registerCursorBySeqno(
                             const std::string &name,
@@ -658,19 +1010,35 @@ public:
                         MustSendCheckpointEnd needsCheckpointEndMetaItem);
 
     /**
-     * Remove the cursor for a given connection.
-     * @param name the name of a given connection
+     * Look up the handle of the cursor with the given name. Per-item
+     * operations should use the handle returned at registration instead.
+     * @return the cursor's handle, or an invalid handle if there is no
+     *         cursor with that name.
+     */
+    CursorHandle getCursorHandle(const std::string& name) const;
+
+    /**
+     * Return the handle of the persistence cursor, which is registered when
+     * the manager is created.
+     */
+    CursorHandle getPersistenceCursor() const {
+        return persistenceCursor;
+    }
+
+    /**
+     * Remove the given cursor.
+     * @param cursor the handle of the cursor
      * @return true if the cursor is removed successfully.
      */
-    bool removeCursor(const std::string &name);
+    bool removeCursor(CursorHandle cursor);
 
     /**
      * Get the Id of the checkpoint where the given connections cursor is currently located.
      * If the cursor is not found, return 0 as a checkpoint Id.
-     * @param name the name of a given connection
+     * @param cursor the handle of the cursor
      * @return the checkpoint Id for a given connections cursor.
      */
-    uint64_t getCheckpointIdForCursor(const std::string &name);
+    uint64_t getCheckpointIdForCursor(CursorHandle cursor);
 
     size_t getNumOfCursors();
 
@@ -711,15 +1079,49 @@ public:
 
     /**
      * Return the next item to be sent to a given connection
-     * @param name the name of a given connection
+     * @param cursor the handle of the connection's cursor
      * @param isLastMutationItem flag indicating if the item to be returned is
      * the last mutation one in the closed checkpoint.
      * @return the next item to be sent to a given connection.
      */
-    queued_item nextItem(const std::string &name, bool &isLastMutationItem);
+    queued_item nextItem(CursorHandle cursor, bool &isLastMutationItem);
+
+    /// Result of getItemsForCursor().
+    struct ItemsForCursor {
+        /// Snapshot range covered by the returned items.
+        snapshot_range_t range = {0, 0};
+        /// True if a limit was reached, so more items may be available.
+        bool moreAvailable = false;
+    };
+
+    /**
+     * Move the given cursor forward, appending the items it passes over to
+     * items, under a single acquisition of the queueLock.
+     *
+     * The limits are approximate: once either is reached the cursor stops at
+     * the end of the current checkpoint, so that the items returned always
+     * cover whole snapshots.
+     *
+     * @param cursor the handle of the cursor
+     * @param items vector to append the items to
+     * @param approxLimit number of items after which to stop (0 for no
+     *        limit)
+     * @param approxBytesLimit size of items (see Item::size) after which to
+     *        stop (0 for no limit)
+     */
+    ItemsForCursor getItemsForCursor(CursorHandle cursor,
+                                     std::vector<queued_item>& items,
+                                     size_t approxLimit,
+                                     size_t approxBytesLimit);
 
-    snapshot_range_t getAllItemsForCursor(const std::string& name,
-                                          std::vector<queued_item> &items);
+    /**
+     * Move the given cursor to the end of the checkpoints, appending every
+     * item it passes over to items.
+     */
+    snapshot_range_t getAllItemsForCursor(CursorHandle cursor,
+                                          std::vector<queued_item> &items) {
+        return getItemsForCursor(cursor, items, 0, 0).range;
+    }
 
     /**
      * Return the total number of items (including meta items) that belong to
@@ -740,7 +1142,7 @@ public:
      * has yet to process (i.e. between the cursor's current position and the
      * end of the last checkpoint).
      */
-    size_t getNumItemsForCursor(const std::string &name) const;
+    size_t getNumItemsForCursor(CursorHandle cursor) const;
 
     void clear(vbucket_state_t vbState) {
         LockHolder lh(queueLock);
@@ -756,11 +1158,11 @@ public:
      * If a given cursor currently points to the checkpoint_end dummy item,
      * decrease its current position by 1. This function is mainly used for
      * checkpoint synchronization between the master and slave nodes.
-     * @param name the name of a given connection
+     * @param cursor the handle of the connection's cursor
      */
-    void decrCursorFromCheckpointEnd(const std::string &name);
+    void decrCursorFromCheckpointEnd(CursorHandle cursor);
 
-    bool hasNext(const std::string &name);
+    bool hasNext(CursorHandle cursor);
 
     const CheckpointConfig &getCheckpointConfig() const {
         return checkpointConfig;
@@ -794,6 +1196,18 @@ public:
 
     size_t getMemoryUsage() const;
 
+    /**
+     * Charge memory allocated for already queued items - the compressed
+     * copies of their values made for DCP (see Item::getCompressedValue())
+     * - to the checkpoint holding them. Released along with the rest of
+     * that checkpoint's memory when it is removed.
+     *
+     * @param seqno bySeqno of (one of) the items the memory belongs to; if
+     *        no checkpoint holds that seqno any more nothing is charged.
+     * @param bytes memory to charge
+     */
+    void chargeItemMemory(int64_t seqno, size_t bytes);
+
     /**
      * Return memory consumption of unreferenced checkpoints
      */
@@ -890,11 +1304,39 @@ private:
         bool onCpktStart;
     };
 
-    // Map of cursor name to position. Used when updating cursor positions
+    // Map of cursor to position. Used when updating cursor positions
     // when collapsing checkpoints.
-    using CursorIdToPositionMap = std::map<std::string, CursorPosition>;
+    using CursorIdToPositionMap = std::map<CheckpointCursor*, CursorPosition>;
+
+    // Entry of cursorSlots; see CursorHandle.
+    struct CursorSlot {
+        CheckpointCursor* cursor = nullptr;
+        // Incremented (skipping zero) whenever the slot's cursor is removed,
+        // invalidating any handles to it.
+        uint32_t generation = 1;
+    };
+
+    /**
+     * Return the cursor the given handle refers to, or nullptr if the handle
+     * is invalid or its cursor has been removed.
+     */
+    CheckpointCursor* getCursor_UNLOCKED(CursorHandle handle) const {
+        if (handle.slot < cursorSlots.size() &&
+            cursorSlots[handle.slot].generation == handle.generation) {
+            return cursorSlots[handle.slot].cursor;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Insert the given cursor into connCursors, replacing (but keeping the
+     * handle of) any existing cursor with the same name, and allocating a
+     * handle if it is new.
+     * @return the cursor as stored in connCursors.
+     */
+    CheckpointCursor& placeCursor_UNLOCKED(const CheckpointCursor& cursor);
 
-    bool removeCursor_UNLOCKED(const std::string &name);
+    bool removeCursor_UNLOCKED(CheckpointCursor& cursor);
 
     bool registerCursor_UNLOCKED(
                             const std::string &name,
@@ -902,7 +1344,7 @@ private:
                             bool alwaysFromBeginning,
                             MustSendCheckpointEnd needsCheckpointEndMetaItem);
 
-    size_t getNumItemsForCursor_UNLOCKED(const std::string &name) const;
+    size_t getNumItemsForCursor_UNLOCKED(CursorHandle cursor) const;
 
     void clear_UNLOCKED(vbucket_state_t vbState, uint64_t seqno);
 
@@ -974,6 +1416,11 @@ private:
     uint64_t                 lastClosedCheckpointId;
     uint64_t                 pCursorPreCheckpointId;
     cursor_index             connCursors;
+    // Translates CursorHandles to the cursors in connCursors.
+    std::vector<CursorSlot> cursorSlots;
+    // Indexes of unused entries in cursorSlots.
+    std::vector<uint32_t> freeCursorSlots;
+    CursorHandle persistenceCursor;
 
     FlusherCallback          flusherCB;
 
@@ -37,6 +37,10 @@ public:
             config.setCheckpointMaxItems(value);
         } else if (key.compare("max_checkpoints") == 0) {
             config.setMaxCheckpoints(value);
+        } else if (key.compare("chk_cursor_batch_items") == 0) {
+            config.setCursorBatchItems(value);
+        } else if (key.compare("chk_cursor_batch_bytes") == 0) {
+            config.setCursorBatchBytes(value);
         }
     }
 
@@ -61,7 +65,9 @@ CheckpointConfig::CheckpointConfig()
       itemNumBasedNewCheckpoint(true),
       keepClosedCheckpoints(false),
       enableChkMerge(false),
-      persistenceEnabled(true) { /* empty */
+      persistenceEnabled(true),
+      cursorBatchItems(DEFAULT_CURSOR_BATCH_ITEMS),
+      cursorBatchBytes(DEFAULT_CURSOR_BATCH_BYTES) { /* empty */
 }
 
 CheckpointConfig::CheckpointConfig(rel_time_t period,
@@ -77,7 +83,9 @@ CheckpointConfig::CheckpointConfig(rel_time_t period,
       itemNumBasedNewCheckpoint(item_based_new_ckpt),
       keepClosedCheckpoints(keep_closed_ckpts),
       enableChkMerge(enable_ckpt_merge),
-      persistenceEnabled(persistence_enabled) {
+      persistenceEnabled(persistence_enabled),
+      cursorBatchItems(DEFAULT_CURSOR_BATCH_ITEMS),
+      cursorBatchBytes(DEFAULT_CURSOR_BATCH_BYTES) {
 }
 
 CheckpointConfig::CheckpointConfig(EventuallyPersistentEngine& e) {
@@ -89,6 +97,8 @@ CheckpointConfig::CheckpointConfig(EventuallyPersistentEngine& e) {
     keepClosedCheckpoints = config.isKeepClosedChks();
     enableChkMerge = config.isEnableChkMerge();
     persistenceEnabled = config.getBucketType() == "persistent";
+    cursorBatchItems = config.getChkCursorBatchItems();
+    cursorBatchBytes = config.getChkCursorBatchBytes();
 }
 
 void CheckpointConfig::addConfigChangeListener(
@@ -110,6 +120,12 @@ void CheckpointConfig::addConfigChangeListener(
     configuration.addValueChangedListener(
             "enable_chk_merge",
             new ChangeListener(engine.getCheckpointConfig()));
+    configuration.addValueChangedListener(
+            "chk_cursor_batch_items",
+            new ChangeListener(engine.getCheckpointConfig()));
+    configuration.addValueChangedListener(
+            "chk_cursor_batch_bytes",
+            new ChangeListener(engine.getCheckpointConfig()));
 }
 
 bool CheckpointConfig::validateCheckpointMaxItemsParam(
@@ -69,6 +69,14 @@ public:
         return persistenceEnabled;
     }
 
+    size_t getCursorBatchItems() const {
+        return cursorBatchItems;
+    }
+
+    size_t getCursorBatchBytes() const {
+        return cursorBatchBytes;
+    }
+
 protected:
     friend class CheckpointConfigChangeListener;
     friend class EventuallyPersistentEngine;
@@ -93,6 +101,14 @@ protected:
         enableChkMerge = value;
     }
 
+    void setCursorBatchItems(size_t value) {
+        cursorBatchItems = value;
+    }
+
+    void setCursorBatchBytes(size_t value) {
+        cursorBatchBytes = value;
+    }
+
     static void addConfigChangeListener(EventuallyPersistentEngine& engine);
 
 private:
@@ -117,4 +133,10 @@ private:
 
     // Flag indicating if persistence is enabled.
     bool persistenceEnabled;
+
+    // Approximate number of items / bytes after which the DCP and
+    // persistence cursors stop (at a checkpoint boundary) when fetching a
+    // batch of items. Zero means no limit.
+    size_t cursorBatchItems;
+    size_t cursorBatchBytes;
 };
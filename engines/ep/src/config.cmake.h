@@ -2,6 +2,7 @@
 
 /* Header files */
 #cmakedefine HAVE_ARPA_INET_H ${HAVE_ARPA_INET_H}
+#cmakedefine HAVE_LINUX_IO_URING_H ${HAVE_LINUX_IO_URING_H}
 #cmakedefine HAVE_NETDB_H ${HAVE_NETDB_H}
 #cmakedefine HAVE_NETINET_IN_H ${HAVE_NETINET_IN_H}
 #cmakedefine HAVE_NETINET_TCP_H ${HAVE_NETINET_TCP_H}
@@ -101,6 +101,7 @@ void ConnNotifier::notifyMutationEvent(void) {
 bool ConnNotifier::notifyConnections() {
     bool inverse = true;
     pendingNotification.compare_exchange_strong(inverse, false);
+    connMap.processPendingNotifications();
     connMap.notifyAllPausedConnections();
 
     if (!pendingNotification.load()) {
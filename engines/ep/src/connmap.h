@@ -82,6 +82,14 @@ public:
 
     void notifyAllPausedConnections();
 
+    /**
+     * Deliver any notifications which were queued for the connection
+     * notifier rather than delivered by the thread which raised them.
+     * Called by the notifier task before it wakes the paused connections.
+     */
+    virtual void processPendingNotifications() {
+    }
+
     EventuallyPersistentEngine& getEngine() {
         return engine;
     }
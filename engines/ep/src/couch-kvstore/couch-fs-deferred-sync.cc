@@ -0,0 +1,324 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "common.h"
+#include "couch-kvstore/couch-fs-deferred-sync.h"
+#include "kvstore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+DeferredSyncFileOps::DeferredSyncFileOps(FileOpsInterface& ops)
+    : wrapped_ops(ops) {
+}
+
+size_t DeferredSyncFileOps::File::getReadCount() {
+    auto* stats = orig_ops->get_stats(orig_handle);
+    return stats ? stats->getReadCount() : 0;
+}
+
+size_t DeferredSyncFileOps::File::getWriteCount() {
+    auto* stats = orig_ops->get_stats(orig_handle);
+    return stats ? stats->getWriteCount() : 0;
+}
+
+DeferredSyncFileOps::File& DeferredSyncFileOps::getFile(Db& db) {
+    auto* file = dynamic_cast<File*>(couchstore_get_db_filestats(&db));
+    if (file == nullptr) {
+        throw std::logic_error(
+                "DeferredSyncFileOps::getFile: Db not opened with "
+                "DeferredSyncFileOps");
+    }
+    return *file;
+}
+
+void DeferredSyncFileOps::deferSyncs(Db& db) {
+    getFile(db).deferring = true;
+}
+
+couchstore_error_t DeferredSyncFileOps::syncDeferred(Db& db) {
+    auto& file = getFile(db);
+    if (!file.syncDue) {
+        return COUCHSTORE_SUCCESS;
+    }
+    couchstore_error_info_t errinfo;
+    const auto errCode = file.orig_ops->sync(&errinfo, file.orig_handle);
+    if (errCode == COUCHSTORE_SUCCESS) {
+        file.syncDue = false;
+    }
+    return errCode;
+}
+
+void DeferredSyncFileOps::markSynced(Db& db) {
+    getFile(db).syncDue = false;
+}
+
+couchstore_error_t DeferredSyncFileOps::writeHeld(Db& db) {
+    auto& file = getFile(db);
+    couchstore_error_info_t errinfo;
+    for (const auto& write : file.held) {
+        const ssize_t written = file.orig_ops->pwrite(&errinfo,
+                                                      file.orig_handle,
+                                                      write.data.data(),
+                                                      write.data.size(),
+                                                      write.offset);
+        if (written != ssize_t(write.data.size())) {
+            return COUCHSTORE_ERROR_WRITE;
+        }
+        file.syncDue = true;
+    }
+    file.held.clear();
+    file.holding = false;
+    file.deferring = false;
+    return COUCHSTORE_SUCCESS;
+}
+
+couch_file_handle DeferredSyncFileOps::constructor(
+        couchstore_error_info_t* errinfo) {
+    FileOpsInterface* orig_ops = &wrapped_ops;
+    File* file = new File(orig_ops, orig_ops->constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(file);
+}
+
+couchstore_error_t DeferredSyncFileOps::open(couchstore_error_info_t* errinfo,
+                                             couch_file_handle* h,
+                                             const char* path,
+                                             int flags) {
+    File* file = reinterpret_cast<File*>(*h);
+    return file->orig_ops->open(errinfo, &file->orig_handle, path, flags);
+}
+
+couchstore_error_t DeferredSyncFileOps::close(couchstore_error_info_t* errinfo,
+                                              couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    // Anything still held belongs to a commit which failed.
+    file->held.clear();
+    file->deferring = false;
+    file->holding = false;
+    file->syncDue = false;
+    return file->orig_ops->close(errinfo, file->orig_handle);
+}
+
+couchstore_error_t DeferredSyncFileOps::set_periodic_sync(
+        couch_file_handle h, uint64_t period_bytes) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->set_periodic_sync(file->orig_handle, period_bytes);
+}
+
+ssize_t DeferredSyncFileOps::pread(couchstore_error_info_t* errinfo,
+                                   couch_file_handle h,
+                                   void* buf,
+                                   size_t nbytes,
+                                   cs_off_t offset) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->pread(
+            errinfo, file->orig_handle, buf, nbytes, offset);
+}
+
+ssize_t DeferredSyncFileOps::pwrite(couchstore_error_info_t* errinfo,
+                                    couch_file_handle h,
+                                    const void* buf,
+                                    size_t nbytes,
+                                    cs_off_t offset) {
+    File* file = reinterpret_cast<File*>(h);
+    if (file->holding) {
+        file->held.push_back(
+                {offset, std::string(static_cast<const char*>(buf), nbytes)});
+        return nbytes;
+    }
+    return file->orig_ops->pwrite(
+            errinfo, file->orig_handle, buf, nbytes, offset);
+}
+
+cs_off_t DeferredSyncFileOps::goto_eof(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    cs_off_t eof = file->orig_ops->goto_eof(errinfo, file->orig_handle);
+    if (eof >= 0) {
+        for (const auto& write : file->held) {
+            eof = std::max(eof, cs_off_t(write.offset + write.data.size()));
+        }
+    }
+    return eof;
+}
+
+couchstore_error_t DeferredSyncFileOps::sync(couchstore_error_info_t* errinfo,
+                                             couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    if (!file->deferring) {
+        return file->orig_ops->sync(errinfo, file->orig_handle);
+    }
+    file->syncDue = true;
+    file->holding = true;
+    return COUCHSTORE_SUCCESS;
+}
+
+couchstore_error_t DeferredSyncFileOps::advise(
+        couchstore_error_info_t* errinfo,
+        couch_file_handle h,
+        cs_off_t offset,
+        cs_off_t len,
+        couchstore_file_advice_t advice) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->advise(
+            errinfo, file->orig_handle, offset, len, advice);
+}
+
+FileOpsInterface::FHStats* DeferredSyncFileOps::get_stats(
+        couch_file_handle h) {
+    // File implements FHStats interface directly.
+    return reinterpret_cast<File*>(h);
+}
+
+void DeferredSyncFileOps::destructor(couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    file->orig_ops->destructor(file->orig_handle);
+    delete file;
+}
+
+#ifdef __linux__
+/// @return true if the running kernel's syncfs() reports writeback errors.
+static bool syncfsReportsErrors() {
+    utsname name;
+    int major = 0;
+    int minor = 0;
+    if (uname(&name) != 0 ||
+        sscanf(name.release, "%d.%d", &major, &minor) != 2) {
+        return false;
+    }
+    return major > 5 || (major == 5 && minor >= 8);
+}
+#endif
+
+DeferredSyncThread::DeferredSyncThread(DeferredSyncFileOps& ops,
+                                       FileStats& stats,
+                                       const std::string& dir,
+                                       bool plainFiles)
+    : ops(ops), stats(stats) {
+#ifdef __linux__
+    if (plainFiles && syncfsReportsErrors()) {
+        dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+#endif
+    if (cb_create_named_thread(&thread, threadMain, this, 0, "mc:cs_sync") !=
+        0) {
+#ifdef __linux__
+        if (dirFd != -1) {
+            ::close(dirFd);
+        }
+#endif
+        throw std::runtime_error(
+                "DeferredSyncThread: Error creating sync thread");
+    }
+}
+
+DeferredSyncThread::~DeferredSyncThread() {
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    cb_join_thread(thread);
+#ifdef __linux__
+    if (dirFd != -1) {
+        ::close(dirFd);
+    }
+#endif
+}
+
+void DeferredSyncThread::submit(std::vector<Db*> dbs) {
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        if (submitted) {
+            throw std::logic_error(
+                    "DeferredSyncThread::submit: Previous submit() not "
+                    "waited for");
+        }
+        request = std::move(dbs);
+        submitted = true;
+        done = false;
+    }
+    cond.notify_all();
+}
+
+std::vector<couchstore_error_t> DeferredSyncThread::wait() {
+    std::unique_lock<std::mutex> lh(mutex);
+    cond.wait(lh, [this] { return done; });
+    submitted = false;
+    done = false;
+    return std::move(results);
+}
+
+void DeferredSyncThread::threadMain(void* arg) {
+    static_cast<DeferredSyncThread*>(arg)->run();
+}
+
+void DeferredSyncThread::run() {
+    std::unique_lock<std::mutex> lh(mutex);
+    while (true) {
+        cond.wait(lh, [this] { return stopping || (submitted && !done); });
+        if (stopping) {
+            return;
+        }
+        auto dbs = std::move(request);
+        request.clear();
+        lh.unlock();
+        auto synced = syncFiles(dbs);
+        lh.lock();
+        results = std::move(synced);
+        done = true;
+        cond.notify_all();
+    }
+}
+
+std::vector<couchstore_error_t> DeferredSyncThread::syncFiles(
+        const std::vector<Db*>& dbs) {
+#ifdef __linux__
+    if (dirFd != -1 && dbs.size() > 1) {
+        int rv;
+        {
+            BlockTimer bt(&stats.syncTimeHisto);
+            rv = syncfs(dirFd);
+        }
+        ++stats.numSyncs;
+        stats.syncRate.add();
+        if (rv == 0) {
+            for (auto* db : dbs) {
+                ops.markSynced(*db);
+            }
+            return std::vector<couchstore_error_t>(dbs.size(),
+                                                   COUCHSTORE_SUCCESS);
+        }
+        // A write to the filesystem failed; find which files it affects.
+    }
+#endif
+    std::vector<couchstore_error_t> synced;
+    synced.reserve(dbs.size());
+    for (auto* db : dbs) {
+        synced.push_back(ops.syncDeferred(*db));
+    }
+    return synced;
+}
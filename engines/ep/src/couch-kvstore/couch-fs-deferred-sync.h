@@ -0,0 +1,208 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <libcouchstore/couch_db.h>
+#include <platform/platform.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct FileStats;
+
+/**
+ * FileOpsInterface implementation which defers the syncs of the files it
+ * opens, so that the files of a group commit can be made durable together
+ * rather than one after another.
+ *
+ * couchstore_commit() syncs a file twice: once the data of the commit has
+ * been written, and again after writing the header which refers to it. A
+ * crash must never leave a durable header pointing at data which isn't, so
+ * the header may only be written once the first sync has completed. Once
+ * deferSyncs() has been called for a file (just before committing it)
+ * sync() only records that a sync is due, and every write made after it
+ * (the header) is held in memory. The owner then makes the commit durable
+ * with syncDeferred() (the data), writeHeld() (the header) and
+ * syncDeferred() again - issuing each step for all the files of the group
+ * before moving on to the next.
+ *
+ * Reads are passed straight to the wrapped ops; nothing should read back
+ * the held writes before they're written.
+ */
+class DeferredSyncFileOps : public FileOpsInterface {
+public:
+    explicit DeferredSyncFileOps(FileOpsInterface& ops);
+
+    /**
+     * Defer db's syncs (until its writeHeld()).
+     * @throws std::logic_error if db wasn't opened with these ops.
+     */
+    void deferSyncs(Db& db);
+
+    /// Issue db's deferred sync (if any) via the wrapped ops.
+    couchstore_error_t syncDeferred(Db& db);
+
+    /**
+     * Record that db's deferred sync has been made by other means (e.g.
+     * by syncing its whole filesystem).
+     */
+    void markSynced(Db& db);
+
+    /**
+     * Write the writes held back after db's deferred sync, so its next
+     * syncDeferred() makes them durable. Syncs of db are no longer
+     * deferred after this.
+     */
+    couchstore_error_t writeHeld(Db& db);
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    /// A write held back until writeHeld().
+    struct HeldWrite {
+        cs_off_t offset;
+        std::string data;
+    };
+
+    /**
+     * Per-handle state. Implements FHStats (forwarding to the wrapped
+     * ops) so the file can be found from a Db via
+     * couchstore_get_db_filestats().
+     */
+    struct File : public FileOpsInterface::FHStats {
+        File(FileOpsInterface* _orig_ops, couch_file_handle _orig_handle)
+            : orig_ops(_orig_ops), orig_handle(_orig_handle) {
+        }
+
+        size_t getReadCount() override;
+        size_t getWriteCount() override;
+
+        FileOpsInterface* orig_ops;
+        couch_file_handle orig_handle;
+
+        /// sync() is deferred (set by deferSyncs(), cleared by writeHeld()).
+        bool deferring = false;
+        /// A sync has been deferred and not yet issued.
+        bool syncDue = false;
+        /// Writes are held back (set by a sync, cleared by writeHeld()).
+        bool holding = false;
+        std::vector<HeldWrite> held;
+    };
+
+    /// @return the File underlying db.
+    static File& getFile(Db& db);
+
+    FileOpsInterface& wrapped_ops;
+};
+
+/**
+ * Thread which issues the deferred syncs of a group commit's files (see
+ * DeferredSyncFileOps), so the flusher can submit a group's syncs and
+ * release the group's vBuckets while it waits for them.
+ *
+ * When syncing more than one file and the files are plain OS files,
+ * the filesystem is synced once with syncfs(), rather than each file
+ * with its own fdatasync(). This is only done on kernels where syncfs()
+ * reports writeback errors (Linux 5.8 and later); if it reports one,
+ * the files are synced one at a time to find which failed.
+ */
+class DeferredSyncThread {
+public:
+    /**
+     * @param ops the ops the files to sync are opened with
+     * @param stats FileStats to count filesystem syncs in
+     * @param dir directory holding the files to sync
+     * @param plainFiles true if the files are plain OS files (so a
+     *        syncfs() of dir syncs them)
+     */
+    DeferredSyncThread(DeferredSyncFileOps& ops,
+                       FileStats& stats,
+                       const std::string& dir,
+                       bool plainFiles);
+
+    ~DeferredSyncThread();
+
+    /**
+     * Start issuing the deferred syncs of the given files on the thread.
+     * Each submit() must be followed by a wait() before the next.
+     */
+    void submit(std::vector<Db*> dbs);
+
+    /**
+     * Wait for the files of the last submit() to be synced.
+     * @return the result of each file's sync, in the order submitted.
+     */
+    std::vector<couchstore_error_t> wait();
+
+private:
+    static void threadMain(void* arg);
+
+    void run();
+
+    std::vector<couchstore_error_t> syncFiles(const std::vector<Db*>& dbs);
+
+    DeferredSyncFileOps& ops;
+    FileStats& stats;
+
+    /// Descriptor of the directory to syncfs(), or -1 to sync each file.
+    int dirFd = -1;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    /// Files awaiting syncing; empty unless `submitted`.
+    std::vector<Db*> request;
+    std::vector<couchstore_error_t> results;
+    bool submitted = false;
+    bool done = false;
+    bool stopping = false;
+
+    cb_thread_t thread;
+};
@@ -133,6 +133,8 @@ cs_off_t StatsOps::goto_eof(couchstore_error_info_t* errinfo,
 couchstore_error_t StatsOps::sync(couchstore_error_info_t* errinfo,
                                   couch_file_handle h) {
     StatFile* sf = reinterpret_cast<StatFile*>(h);
+    ++stats.numSyncs;
+    stats.syncRate.add();
     BlockTimer bt(&stats.syncTimeHisto);
     return sf->orig_ops->sync(errinfo, sf->orig_handle);
 }
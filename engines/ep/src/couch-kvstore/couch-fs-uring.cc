@@ -0,0 +1,486 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+
+#include "common.h"
+#include "couch-kvstore/couch-fs-uring.h"
+#include "kvstore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define EP_USE_IO_URING 1
+#endif
+#endif
+
+const size_t IoUringFileOps::blockSize;
+
+#ifdef EP_USE_IO_URING
+
+/**
+ * Minimal io_uring submission / completion ring, driven directly via the
+ * io_uring_setup / io_uring_enter syscalls. Only used by one thread at a
+ * time (see IoUringFileOps::ringMutex).
+ */
+class IoUringFileOps::Ring {
+public:
+    /// A read to submit; `result` is set to the bytes read or -errno.
+    struct Read {
+        int fd;
+        void* buf;
+        size_t len;
+        cs_off_t offset;
+        ssize_t result;
+    };
+
+    explicit Ring(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            return;
+        }
+        numEntries = params.sq_entries;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes +
+                     params.cq_entries * sizeof(io_uring_cqe);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqes = static_cast<io_uring_sqe*>(
+                mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED ||
+            sqes == MAP_FAILED) {
+            unmap();
+            ::close(ringFd);
+            ringFd = -1;
+            return;
+        }
+
+        auto* sq = static_cast<char*>(sqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~Ring() {
+        if (ringFd >= 0) {
+            unmap();
+            ::close(ringFd);
+        }
+    }
+
+    bool isValid() const {
+        return ringFd >= 0;
+    }
+
+    /**
+     * Perform all of the given reads, keeping up to the ring size in
+     * flight at once. Returns once every read has completed (or failed).
+     */
+    void readAll(std::vector<Read>& reads) {
+        std::vector<iovec> iovecs(reads.size());
+        size_t next = 0;
+        size_t inFlight = 0;
+        size_t completed = 0;
+        // Queued in the submission ring but not yet consumed by the kernel.
+        unsigned unsubmitted = 0;
+
+        while (completed < reads.size()) {
+            // Fill the submission queue.
+            unsigned tail = *sqTail;
+            while (next < reads.size() && inFlight < numEntries) {
+                auto& read = reads[next];
+                iovecs[next].iov_base = read.buf;
+                iovecs[next].iov_len = read.len;
+
+                const unsigned index = tail & sqMask;
+                io_uring_sqe* sqe = &sqes[index];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_READV;
+                sqe->fd = read.fd;
+                sqe->addr = reinterpret_cast<uint64_t>(&iovecs[next]);
+                sqe->len = 1;
+                sqe->off = read.offset;
+                sqe->user_data = next;
+                sqArray[index] = index;
+
+                ++tail;
+                ++next;
+                ++inFlight;
+                ++unsubmitted;
+            }
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+            // Submit, and wait for at least one completion.
+            int rv;
+            do {
+                rv = int(syscall(__NR_io_uring_enter, ringFd, unsubmitted, 1,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0));
+            } while (rv < 0 && errno == EINTR);
+
+            if (rv < 0) {
+                // The ring is unusable; fail whatever hasn't completed and
+                // let those reads fall back to the wrapped ops.
+                const int error = errno;
+                for (auto& read : reads) {
+                    if (read.result == inProgress) {
+                        read.result = -error;
+                    }
+                }
+                return;
+            }
+            unsubmitted -= unsigned(rv);
+
+            // Reap completions.
+            unsigned head = *cqHead;
+            const unsigned cqTailValue = __atomic_load_n(cqTail,
+                                                         __ATOMIC_ACQUIRE);
+            while (head != cqTailValue) {
+                const io_uring_cqe& cqe = cqes[head & cqMask];
+                reads[cqe.user_data].result = cqe.res;
+                ++head;
+                --inFlight;
+                ++completed;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    /// Value of Read::result while the read is outstanding.
+    static const ssize_t inProgress = std::numeric_limits<ssize_t>::min();
+
+private:
+    void unmap() {
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (cqRing != MAP_FAILED) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+    }
+
+    int ringFd = -1;
+    unsigned numEntries = 0;
+
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+};
+
+const ssize_t IoUringFileOps::Ring::inProgress;
+
+#else
+
+/// io_uring is not available on this platform; never valid.
+class IoUringFileOps::Ring {
+public:
+    explicit Ring(unsigned) {
+    }
+
+    bool isValid() const {
+        return false;
+    }
+};
+
+#endif
+
+IoUringFileOps::IoUringFileOps(FileStats& _stats,
+                               FileOpsInterface& ops,
+                               size_t queueDepth)
+    : stats(_stats), wrapped_ops(ops) {
+    std::unique_ptr<Ring> r(new Ring(unsigned(queueDepth)));
+    if (r->isValid()) {
+        ring = std::move(r);
+    }
+}
+
+IoUringFileOps::~IoUringFileOps() = default;
+
+bool IoUringFileOps::isAsync() const {
+    return ring != nullptr;
+}
+
+size_t IoUringFileOps::prefetch(const std::string& path,
+                                std::vector<Range> ranges) {
+#ifdef EP_USE_IO_URING
+    if (!ring || ranges.empty()) {
+        return 0;
+    }
+
+    File* file = nullptr;
+    {
+        std::lock_guard<std::mutex> lh(filesMutex);
+        const auto self = std::this_thread::get_id();
+        for (auto* f : openFiles) {
+            if (f->opener == self && f->path == path) {
+                file = f;
+            }
+        }
+    }
+    if (file == nullptr) {
+        return 0;
+    }
+    if (file->fd < 0) {
+        // Only files which are actually prefetched get a descriptor of
+        // their own; if it can't be opened the file is simply read via the
+        // wrapped ops.
+        if (file->openFailed) {
+            return 0;
+        }
+        file->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file->fd < 0) {
+            file->openFailed = true;
+            return 0;
+        }
+    }
+
+    // Widen each range to whole blocks, then merge overlapping / adjacent
+    // ones so neighbouring documents are read together.
+    for (auto& range : ranges) {
+        const cs_off_t start = range.offset & ~cs_off_t(blockSize - 1);
+        const cs_off_t end =
+                (range.offset + range.length + blockSize - 1) &
+                ~cs_off_t(blockSize - 1);
+        range.offset = start;
+        range.length = size_t(end - start);
+    }
+    std::sort(ranges.begin(),
+              ranges.end(),
+              [](const Range& a, const Range& b) {
+                  return a.offset < b.offset;
+              });
+    std::vector<Extent> extents;
+    for (const auto& range : ranges) {
+        if (!extents.empty()) {
+            auto& last = extents.back();
+            const cs_off_t lastEnd = last.offset + last.data.size();
+            if (range.offset <= lastEnd) {
+                const cs_off_t end = range.offset + range.length;
+                if (end > lastEnd) {
+                    last.data.resize(size_t(end - last.offset));
+                }
+                continue;
+            }
+        }
+        extents.push_back({range.offset, std::vector<char>(range.length)});
+    }
+
+    std::vector<Ring::Read> reads;
+    reads.reserve(extents.size());
+    for (auto& extent : extents) {
+        reads.push_back({file->fd,
+                         extent.data.data(),
+                         extent.data.size(),
+                         extent.offset,
+                         Ring::inProgress});
+    }
+
+    {
+        BlockTimer bt(&stats.asyncReadBatchTimeHisto);
+        std::lock_guard<std::mutex> lh(ringMutex);
+        ring->readAll(reads);
+    }
+    stats.asyncReadsSubmitted += reads.size();
+
+    // Keep what was read; a short read (end of file) keeps the part which
+    // was read, and a failed read is dropped so pread() falls back to the
+    // wrapped ops for that range.
+    file->extents.clear();
+    for (size_t ii = 0; ii < extents.size(); ++ii) {
+        if (reads[ii].result > 0) {
+            extents[ii].data.resize(size_t(reads[ii].result));
+            file->extents.push_back(std::move(extents[ii]));
+        }
+    }
+    return reads.size();
+#else
+    return 0;
+#endif
+}
+
+const IoUringFileOps::Extent* IoUringFileOps::findExtent(const File& file,
+                                                         cs_off_t offset,
+                                                         size_t nbytes) {
+    // First extent starting after offset; the one before it (if any) is
+    // the only candidate.
+    auto it = std::upper_bound(file.extents.begin(),
+                               file.extents.end(),
+                               offset,
+                               [](cs_off_t off, const Extent& extent) {
+                                   return off < extent.offset;
+                               });
+    if (it == file.extents.begin()) {
+        return nullptr;
+    }
+    --it;
+    if (offset + cs_off_t(nbytes) <=
+        it->offset + cs_off_t(it->data.size())) {
+        return &*it;
+    }
+    return nullptr;
+}
+
+couch_file_handle IoUringFileOps::constructor(
+        couchstore_error_info_t* errinfo) {
+    FileOpsInterface* orig_ops = &wrapped_ops;
+    File* file = new File(orig_ops, orig_ops->constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(file);
+}
+
+couchstore_error_t IoUringFileOps::open(couchstore_error_info_t* errinfo,
+                                        couch_file_handle* h,
+                                        const char* path,
+                                        int flags) {
+    File* file = reinterpret_cast<File*>(*h);
+    couchstore_error_t err =
+            file->orig_ops->open(errinfo, &file->orig_handle, path, flags);
+#ifdef EP_USE_IO_URING
+    // Only read-only handles (as used by BG fetches) are prefetched, so
+    // the writer's handles are never tracked. The descriptor for ring
+    // reads is opened by the first prefetch() of the handle.
+    if (err == COUCHSTORE_SUCCESS && ring && (flags & O_ACCMODE) == O_RDONLY) {
+        file->fd = -1;
+        file->openFailed = false;
+        file->path = path;
+        file->opener = std::this_thread::get_id();
+        file->extents.clear();
+        std::lock_guard<std::mutex> lh(filesMutex);
+        openFiles.push_back(file);
+    }
+#endif
+    return err;
+}
+
+couchstore_error_t IoUringFileOps::close(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+#ifdef EP_USE_IO_URING
+    if (!file->path.empty()) {
+        std::lock_guard<std::mutex> lh(filesMutex);
+        openFiles.erase(std::remove(openFiles.begin(), openFiles.end(), file),
+                        openFiles.end());
+        file->path.clear();
+    }
+    if (file->fd >= 0) {
+        ::close(file->fd);
+        file->fd = -1;
+    }
+#endif
+    file->extents.clear();
+    file->extents.shrink_to_fit();
+    return file->orig_ops->close(errinfo, file->orig_handle);
+}
+
+couchstore_error_t IoUringFileOps::set_periodic_sync(couch_file_handle h,
+                                                     uint64_t period_bytes) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->set_periodic_sync(file->orig_handle, period_bytes);
+}
+
+ssize_t IoUringFileOps::pread(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    File* file = reinterpret_cast<File*>(h);
+    if (const Extent* extent = findExtent(*file, off, sz)) {
+        memcpy(buf, extent->data.data() + (off - extent->offset), sz);
+        ++stats.asyncReadHits;
+        return ssize_t(sz);
+    }
+    return file->orig_ops->pread(errinfo, file->orig_handle, buf, sz, off);
+}
+
+ssize_t IoUringFileOps::pwrite(couchstore_error_info_t* errinfo,
+                               couch_file_handle h,
+                               const void* buf,
+                               size_t sz,
+                               cs_off_t off) {
+    File* file = reinterpret_cast<File*>(h);
+    // Couchstore only appends, but don't rely on that to keep prefetched
+    // data valid.
+    file->extents.clear();
+    return file->orig_ops->pwrite(errinfo, file->orig_handle, buf, sz, off);
+}
+
+cs_off_t IoUringFileOps::goto_eof(couchstore_error_info_t* errinfo,
+                                  couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->goto_eof(errinfo, file->orig_handle);
+}
+
+couchstore_error_t IoUringFileOps::sync(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->sync(errinfo, file->orig_handle);
+}
+
+couchstore_error_t IoUringFileOps::advise(couchstore_error_info_t* errinfo,
+                                          couch_file_handle h,
+                                          cs_off_t offs,
+                                          cs_off_t len,
+                                          couchstore_file_advice_t adv) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->advise(errinfo, file->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* IoUringFileOps::get_stats(couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    return file->orig_ops->get_stats(file->orig_handle);
+}
+
+void IoUringFileOps::destructor(couch_file_handle h) {
+    File* file = reinterpret_cast<File*>(h);
+    file->orig_ops->destructor(file->orig_handle);
+    delete file;
+}
@@ -0,0 +1,164 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <libcouchstore/couch_db.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FileStats;
+
+/**
+ * FileOpsInterface implementation which can read many ranges of a file
+ * concurrently using io_uring.
+ *
+ * Couchstore itself issues one blocking pread() at a time, so a caller
+ * which knows in advance which parts of a file it will need (for example
+ * a BG fetch, which knows the offset of every document it is about to
+ * read) calls prefetch() with those ranges. They are submitted to the
+ * ring as a single batch - keeping up to `queueDepth` reads in flight from
+ * the one calling thread - and held against the file handle; couchstore's
+ * subsequent pread()s which fall within a prefetched range are then
+ * served from memory.
+ *
+ * All other operations, and reads outside the prefetched ranges, are
+ * passed to the wrapped FileOpsInterface. If io_uring is not available
+ * (not compiled in, or refused by the kernel) isAsync() returns false and
+ * prefetch() does nothing, so the wrapped ops are used for everything.
+ */
+class IoUringFileOps : public FileOpsInterface {
+public:
+    /// A range of a file to prefetch.
+    struct Range {
+        cs_off_t offset;
+        size_t length;
+    };
+
+    /**
+     * @param stats FileStats to record prefetch activity in
+     * @param ops FileOpsInterface to wrap
+     * @param queueDepth maximum number of reads in flight at once
+     */
+    IoUringFileOps(FileStats& stats, FileOpsInterface& ops, size_t queueDepth);
+
+    ~IoUringFileOps() override;
+
+    /// @return true if reads can be submitted via io_uring.
+    bool isAsync() const;
+
+    /**
+     * Read the given ranges of `path` in one batch, replacing anything
+     * previously prefetched for it. Only a read-only handle for `path`
+     * opened by the calling thread is considered; this is intended to be
+     * called directly after the caller opens the file.
+     *
+     * Ranges are widened to whole blocks and adjacent ranges merged, so
+     * the number of reads issued may be less than ranges.size().
+     *
+     * @return the number of reads issued.
+     */
+    size_t prefetch(const std::string& path, std::vector<Range> ranges);
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+    /// Prefetched ranges are aligned to (and merged at) this granularity.
+    static const size_t blockSize = 4096;
+
+protected:
+    class Ring;
+
+    /// A prefetched, block-aligned range of a file.
+    struct Extent {
+        cs_off_t offset;
+        std::vector<char> data;
+    };
+
+    struct File {
+        File(FileOpsInterface* _orig_ops, couch_file_handle _orig_handle)
+            : orig_ops(_orig_ops), orig_handle(_orig_handle) {
+        }
+
+        FileOpsInterface* orig_ops;
+        couch_file_handle orig_handle;
+
+        /// Read-only descriptor used for ring reads; -1 until the first
+        /// prefetch() of the file.
+        int fd = -1;
+        /// Set if opening fd failed, so it isn't retried on every prefetch.
+        bool openFailed = false;
+        /// Path of the file if it is in openFiles, otherwise empty.
+        std::string path;
+        std::thread::id opener;
+
+        /// Prefetched extents, sorted by offset. Only accessed by the
+        /// thread using the handle.
+        std::vector<Extent> extents;
+    };
+
+    /// @return the extent wholly containing [offset, offset + nbytes), or
+    ///         nullptr.
+    static const Extent* findExtent(const File& file,
+                                    cs_off_t offset,
+                                    size_t nbytes);
+
+    FileStats& stats;
+    FileOpsInterface& wrapped_ops;
+
+    /// Serialises use of the ring.
+    std::mutex ringMutex;
+    std::unique_ptr<Ring> ring;
+
+    /// Files currently open, for prefetch() to find by path.
+    std::mutex filesMutex;
+    std::vector<File*> openFiles;
+};
@@ -63,9 +63,11 @@ extern "C" {
 }
 
 extern "C" {
-    static int getMultiCbC(Db *db, DocInfo *docinfo, void *ctx)
+    static int getMultiDocInfoCbC(Db *db, DocInfo *docinfo, void *ctx)
     {
-        return CouchKVStore::getMultiCb(db, docinfo, ctx);
+        static_cast<std::vector<DocInfo*>*>(ctx)->push_back(docinfo);
+        // Non-zero (positive): we take ownership of the DocInfo.
+        return 1;
     }
 }
 
@@ -104,6 +106,13 @@ static protocol_binary_datatype_t determine_datatype(sized_buf doc) {
     }
 }
 
+static std::string getDBFileName(const std::string &dbname,
+                                 uint16_t vbid,
+                                 uint64_t rev) {
+    return dbname + "/" + std::to_string(vbid) + ".couch." +
+           std::to_string(rev);
+}
+
 static bool endWithCompact(const std::string &filename) {
     size_t pos = filename.find(".compact");
     if (pos == std::string::npos ||
@@ -267,6 +276,9 @@ CouchRequest::CouchRequest(const Item& it,
     dbDocInfo.content_meta = getContentMeta(it);
 }
 
+/// Maximum number of reads in flight at once when reading via io_uring.
+static const size_t asyncIOQueueDepth = 64;
+
 CouchKVStore::CouchKVStore(KVStoreConfig& config)
     : CouchKVStore(config, *couchstore_get_default_file_ops()) {
 }
@@ -285,9 +297,24 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
       logger(config.getLogger()),
       base_ops(ops) {
     createDataDir(dbname);
-    statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
+    if (config.isAsyncIO()) {
+        asyncReadOps = std::make_unique<IoUringFileOps>(
+                st.fsStats, base_ops, asyncIOQueueDepth);
+        if (!asyncReadOps->isAsync()) {
+            logger.log(EXTENSION_LOG_NOTICE,
+                       "CouchKVStore: io_uring not available, BG fetches "
+                       "will use synchronous reads");
+            asyncReadOps.reset();
+        }
+    }
+    statCollectingFileOps = getCouchstoreStatsOps(
+            st.fsStats, asyncReadOps ? *asyncReadOps : base_ops);
     statCollectingFileOpsCompaction = getCouchstoreStatsOps(
         st.fsStatsCompaction, base_ops);
+    if (!readOnly) {
+        deferredSyncOps =
+                std::make_unique<DeferredSyncFileOps>(*statCollectingFileOps);
+    }
 
     // init db file map with default revision number, 1
     numDbFiles = configuration.getMaxVBuckets();
@@ -539,10 +566,46 @@ void CouchKVStore::getMulti(uint16_t vb, vb_bgfetch_queue_t &itms) {
         ++idx;
     }
 
+    // Look up all of the DocInfos first, then read the documents in the
+    // order they are stored in the file (rather than key order), so the
+    // reads move forwards through the file and benefit from readahead.
+    std::vector<DocInfo*> docInfos;
+    docInfos.reserve(itms.size());
+    errCode = couchstore_docinfos_by_id(db, ids.data(), itms.size(),
+                                        0, getMultiDocInfoCbC, &docInfos);
+    std::sort(docInfos.begin(),
+              docInfos.end(),
+              [](const DocInfo* a, const DocInfo* b) { return a->bp < b->bp; });
+
+    const bool fetchesBodies = std::any_of(
+            itms.begin(),
+            itms.end(),
+            [](const vb_bgfetch_queue_t::value_type& item) {
+                return item.second.isMetaOnly == GetMetaOnly::No;
+            });
+    if (asyncReadOps && fetchesBodies) {
+        // Read every document body up front as one batch of concurrent
+        // reads; couchstore's reads below are then served from memory.
+        // A body is a chunk header followed by the data, with a block
+        // marker byte at each 4K boundary it crosses.
+        std::vector<IoUringFileOps::Range> ranges;
+        ranges.reserve(docInfos.size());
+        for (const auto* docInfo : docInfos) {
+            if (docInfo->physical_size > 0) {
+                const size_t chunk = docInfo->physical_size + 8;
+                ranges.push_back({cs_off_t(docInfo->bp),
+                                  chunk + chunk / 4095 + 1});
+            }
+        }
+        asyncReadOps->prefetch(getDBFileName(dbname, vb, fileRev), ranges);
+    }
+
     GetMultiCbCtx ctx(*this, vb, itms);
+    for (auto* docInfo : docInfos) {
+        getMultiCb(db, docInfo, &ctx);
+        couchstore_free_docinfo(docInfo);
+    }
 
-    errCode = couchstore_docinfos_by_id(db, ids.data(), itms.size(),
-                                        0, getMultiCbC, &ctx);
     if (errCode != COUCHSTORE_SUCCESS) {
         st.numGetFailure += numItems;
         logger.log(EXTENSION_LOG_WARNING, "CouchKVStore::getMulti: "
@@ -659,13 +722,6 @@ void CouchKVStore::getPersistedStats(std::map<std::string,
     }
 }
 
-static std::string getDBFileName(const std::string &dbname,
-                                 uint16_t vbid,
-                                 uint64_t rev) {
-    return dbname + "/" + std::to_string(vbid) + ".couch." +
-           std::to_string(rev);
-}
-
 static int edit_docinfo_hook(DocInfo **info, const sized_buf *item) {
     // Examine the metadata of the doc
     auto documentMetaData = MetaDataFactory::createMetaData((*info)->rev_meta);
@@ -1165,6 +1221,132 @@ bool CouchKVStore::commit(const Item* collectionsManifest) {
     return !intransaction;
 }
 
+bool CouchKVStore::prepareCommit(const Item* collectionsManifest) {
+    if (isReadOnly()) {
+        throw std::logic_error("CouchKVStore::prepareCommit: Not valid on a "
+                        "read-only object.");
+    }
+
+    if (intransaction) {
+        if (commit2couchstore(collectionsManifest, true)) {
+            intransaction = false;
+            transactionCtx.reset();
+        }
+    }
+
+    return !intransaction;
+}
+
+void CouchKVStore::commitGroup() {
+    if (preparedCommits.empty()) {
+        return;
+    }
+
+    TRACE_EVENT1("CouchKVStore",
+                 "commitGroup",
+                 "vbuckets",
+                 preparedCommits.size());
+
+    if (!syncThread) {
+        syncThread = std::make_unique<DeferredSyncThread>(
+                *deferredSyncOps,
+                st.fsStats,
+                dbname,
+                &base_ops == couchstore_get_default_file_ops());
+    }
+
+    // Commit each file. Its syncs are deferred, and the header written
+    // after the first of them is held back, so only the data of each
+    // commit reaches the file.
+    std::vector<Db*> dbs;
+    for (auto& prepared : preparedCommits) {
+        deferredSyncOps->deferSyncs(*prepared.db);
+        prepared.status = commitDb(*prepared.db);
+        if (prepared.status == COUCHSTORE_SUCCESS) {
+            dbs.push_back(prepared.db);
+        }
+    }
+
+    // A file's data must be durable before its header is written, so make
+    // the data of the whole group durable first, then write the headers.
+    syncThread->submit(dbs);
+    auto results = syncThread->wait();
+    dbs.clear();
+    auto result = results.begin();
+    for (auto& prepared : preparedCommits) {
+        if (prepared.status != COUCHSTORE_SUCCESS) {
+            continue;
+        }
+        prepared.status = *result++;
+        if (prepared.status == COUCHSTORE_SUCCESS) {
+            prepared.status = deferredSyncOps->writeHeld(*prepared.db);
+        }
+        if (prepared.status == COUCHSTORE_SUCCESS) {
+            dbs.push_back(prepared.db);
+        }
+    }
+
+    // Start making the headers durable; syncGroup() waits for it.
+    syncThread->submit(std::move(dbs));
+}
+
+void CouchKVStore::syncGroup() {
+    if (preparedCommits.empty()) {
+        return;
+    }
+
+    auto results = syncThread->wait();
+    auto result = results.begin();
+    for (auto& prepared : preparedCommits) {
+        if (prepared.status == COUCHSTORE_SUCCESS) {
+            prepared.status = *result++;
+        }
+    }
+}
+
+void CouchKVStore::completeGroup() {
+    for (auto& prepared : preparedCommits) {
+        // Unless the vBucket has been reset (and so its file replaced) since
+        // the commit, update its cached state.
+        const bool sameFile = dbFileRevMap[prepared.vbid] == prepared.fileRev;
+        if (prepared.status == COUCHSTORE_SUCCESS) {
+            if (sameFile) {
+                finishCommit(prepared.vbid,
+                             *prepared.db,
+                             prepared.numDocs,
+                             prepared.maxDBSeqno);
+            }
+            st.docsCommitted = prepared.numDocs;
+        } else {
+            logger.log(EXTENSION_LOG_WARNING,
+                       "CouchKVStore::completeGroup: commit error:%s, "
+                       "vb:%" PRIu16,
+                       couchstore_strerror(prepared.status),
+                       prepared.vbid);
+            // The vBucket's state was cached ahead of the commit; nothing
+            // past what was already in the file has been persisted.
+            if (sameFile) {
+                getVBucketState(prepared.vbid)->highSeqno =
+                        prepared.committedSeqno;
+            }
+        }
+        closeDatabaseHandle(prepared.db);
+        prepared.db = nullptr;
+
+        commitCallback(prepared.reqs,
+                       *prepared.kvctx,
+                       *prepared.transactionCtx,
+                       prepared.status);
+        for (auto* req : prepared.reqs) {
+            delete req;
+        }
+    }
+    if (!preparedCommits.empty()) {
+        st.groupCommitSize.add(preparedCommits.size());
+    }
+    preparedCommits.clear();
+}
+
 bool CouchKVStore::getStat(const char* name, size_t& value)  {
     if (strcmp("failure_compaction", name) == 0) {
         value = st.numCompactionFailure.load();
@@ -1789,7 +1971,8 @@ int CouchKVStore::recordDbDump(Db *db, DocInfo *docinfo, void *ctx) {
     return COUCHSTORE_SUCCESS;
 }
 
-bool CouchKVStore::commit2couchstore(const Item* collectionsManifest) {
+bool CouchKVStore::commit2couchstore(const Item* collectionsManifest,
+                                     bool prepareOnly) {
     bool success = true;
 
     size_t pendingCommitCnt = pendingReqsQ.size();
@@ -1842,10 +2025,17 @@ bool CouchKVStore::commit2couchstore(const Item* collectionsManifest) {
     }
 
     // The docinfo callback needs to know if the DocNamespace feature is on
-    kvstats_ctx kvctx(configuration.shouldPersistDocNamespace());
+    auto kvctx = std::make_unique<kvstats_ctx>(
+            configuration.shouldPersistDocNamespace());
+    PreparedCommit prepared;
     // flush all
-    couchstore_error_t errCode = saveDocs(
-            vbucket2flush, fileRev, docs, docinfos, kvctx, collectionsManifest);
+    couchstore_error_t errCode = saveDocs(vbucket2flush,
+                                          fileRev,
+                                          docs,
+                                          docinfos,
+                                          *kvctx,
+                                          collectionsManifest,
+                                          prepareOnly ? &prepared : nullptr);
 
     if (errCode) {
         success = false;
@@ -1853,9 +2043,17 @@ bool CouchKVStore::commit2couchstore(const Item* collectionsManifest) {
                    "CouchKVStore::commit2couchstore: saveDocs error:%s, "
                    "vb:%" PRIu16 ", rev:%" PRIu64, couchstore_strerror(errCode),
                    vbucket2flush, fileRev);
+    } else if (prepareOnly) {
+        // The commit and callbacks are left to commitGroup().
+        prepared.vbid = vbucket2flush;
+        prepared.reqs.swap(pendingReqsQ);
+        prepared.kvctx = std::move(kvctx);
+        prepared.transactionCtx = std::move(transactionCtx);
+        preparedCommits.push_back(std::move(prepared));
+        return success;
     }
 
-    commitCallback(pendingReqsQ, kvctx, errCode);
+    commitCallback(pendingReqsQ, *kvctx, *transactionCtx, errCode);
 
     // clean up
     for (size_t i = 0; i < pendingCommitCnt; ++i) {
@@ -1889,18 +2087,22 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
                                           const std::vector<Doc*>& docs,
                                           std::vector<DocInfo*>& docinfos,
                                           kvstats_ctx& kvctx,
-                                          const Item* collectionsManifest) {
+                                          const Item* collectionsManifest,
+                                          PreparedCommit* prepared) {
     couchstore_error_t errCode;
     uint64_t fileRev = rev;
-    DbInfo info;
     if (rev == 0) {
         throw std::invalid_argument(
                 "CouchKVStore::saveDocs: rev must be non-zero");
     }
 
     DbHolder db(this);
-    errCode = openDB(
-            vbid, fileRev, db.getDbAddress(), COUCHSTORE_OPEN_FLAG_CREATE);
+    // A prepared commit's syncs are left to commitGroup().
+    errCode = openDB(vbid,
+                     fileRev,
+                     db.getDbAddress(),
+                     COUCHSTORE_OPEN_FLAG_CREATE,
+                     prepared ? deferredSyncOps.get() : nullptr);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.log(EXTENSION_LOG_WARNING,
                    "CouchKVStore::saveDocs: openDB error:%s, vb:%" PRIu16
@@ -1920,6 +2122,15 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
 
         uint64_t maxDBSeqno = 0;
 
+        if (prepared) {
+            // The seqno already durable in the file, for if the deferred
+            // commit fails.
+            DbInfo info;
+            couchstore_db_info(db.getDb(), &info);
+            prepared->committedSeqno = info.last_sequence;
+            prepared->fileRev = fileRev;
+        }
+
         // Only do a couchstore_save_documents if there are docs
         if (docs.size() > 0) {
             std::vector<sized_buf> ids(docs.size());
@@ -1972,38 +2183,19 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
             saveCollectionsManifest(*db.getDb(), *collectionsManifest);
         }
 
-        auto cs_begin = ProcessClock::now();
-        errCode = couchstore_commit(db.getDb());
-        st.commitHisto.add(
-                std::chrono::duration_cast<std::chrono::microseconds>(
-                        ProcessClock::now() - cs_begin));
+        if (prepared) {
+            prepared->db = db.releaseDb();
+            prepared->numDocs = docs.size();
+            prepared->maxDBSeqno = maxDBSeqno;
+            return COUCHSTORE_SUCCESS;
+        }
+
+        errCode = commitDb(*db.getDb());
         if (errCode) {
-            logger.log(
-                    EXTENSION_LOG_WARNING,
-                    "CouchKVStore::saveDocs: couchstore_commit error:%s [%s]",
-                    couchstore_strerror(errCode),
-                    couchkvstore_strerrno(db.getDb(), errCode).c_str());
             return errCode;
         }
 
-        st.batchSize.add(docs.size());
-
-        // retrieve storage system stats for file fragmentation computation
-        couchstore_db_info(db.getDb(), &info);
-        cachedSpaceUsed[vbid] = info.space_used;
-        cachedFileSize[vbid] = info.file_size;
-        cachedDeleteCount[vbid] = info.deleted_count;
-        cachedDocCount[vbid] = info.doc_count;
-
-        // Check seqno if we wrote documents
-        if (docs.size() > 0 && maxDBSeqno != info.last_sequence) {
-            logger.log(EXTENSION_LOG_WARNING,
-                       "CouchKVStore::saveDocs: Seqno in db header (%" PRIu64 ")"
-                       " is not matched with what was persisted (%" PRIu64 ")"
-                       " for vb:%" PRIu16,
-                       info.last_sequence, maxDBSeqno, vbid);
-        }
-        state->highSeqno = info.last_sequence;
+        finishCommit(vbid, *db.getDb(), docs.size(), maxDBSeqno);
     }
 
     /* update stat */
@@ -2014,6 +2206,47 @@ couchstore_error_t CouchKVStore::saveDocs(uint16_t vbid,
     return errCode;
 }
 
+couchstore_error_t CouchKVStore::commitDb(Db& db) {
+    auto cs_begin = ProcessClock::now();
+    couchstore_error_t errCode = couchstore_commit(&db);
+    st.commitHisto.add(std::chrono::duration_cast<std::chrono::microseconds>(
+            ProcessClock::now() - cs_begin));
+    if (errCode) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::commitDb: couchstore_commit error:%s [%s]",
+                   couchstore_strerror(errCode),
+                   couchkvstore_strerrno(&db, errCode).c_str());
+    }
+    return errCode;
+}
+
+void CouchKVStore::finishCommit(uint16_t vbid,
+                                Db& db,
+                                size_t numDocs,
+                                uint64_t maxDBSeqno) {
+    st.batchSize.add(numDocs);
+    ++st.numCommits;
+    st.numCommittedDocs += numDocs;
+
+    // retrieve storage system stats for file fragmentation computation
+    DbInfo info;
+    couchstore_db_info(&db, &info);
+    cachedSpaceUsed[vbid] = info.space_used;
+    cachedFileSize[vbid] = info.file_size;
+    cachedDeleteCount[vbid] = info.deleted_count;
+    cachedDocCount[vbid] = info.doc_count;
+
+    // Check seqno if we wrote documents
+    if (numDocs > 0 && maxDBSeqno != info.last_sequence) {
+        logger.log(EXTENSION_LOG_WARNING,
+                   "CouchKVStore::finishCommit: Seqno in db header (%" PRIu64
+                   ") is not matched with what was persisted (%" PRIu64 ")"
+                   " for vb:%" PRIu16,
+                   info.last_sequence, maxDBSeqno, vbid);
+    }
+    getVBucketState(vbid)->highSeqno = info.last_sequence;
+}
+
 void CouchKVStore::remVBucketFromDbFileMap(uint16_t vbucketId) {
     if (vbucketId >= numDbFiles) {
         logger.log(EXTENSION_LOG_WARNING,
@@ -2029,6 +2262,7 @@ void CouchKVStore::remVBucketFromDbFileMap(uint16_t vbucketId) {
 
 void CouchKVStore::commitCallback(std::vector<CouchRequest *> &committedReqs,
                                   kvstats_ctx &kvctx,
+                                  TransactionContext& txCtx,
                                   couchstore_error_t errCode) {
     size_t commitSize = committedReqs.size();
 
@@ -2054,8 +2288,7 @@ void CouchKVStore::commitCallback(std::vector<CouchRequest *> &committedReqs,
             } else {
                 st.delTimeHisto.add(committedReqs[index]->getDelta());
             }
-            committedReqs[index]->getDelCallback()->callback(*transactionCtx,
-                                                             rv);
+            committedReqs[index]->getDelCallback()->callback(txCtx, rv);
         } else {
             int rv = getMutationStatus(errCode);
             const auto& key = committedReqs[index]->getKey();
@@ -2067,8 +2300,7 @@ void CouchKVStore::commitCallback(std::vector<CouchRequest *> &committedReqs,
                 st.writeSizeHisto.add(dataSize + keySize);
             }
             mutation_result p(rv, insertion);
-            committedReqs[index]->getSetCallback()->callback(*transactionCtx,
-                                                             p);
+            committedReqs[index]->getSetCallback()->callback(txCtx, p);
         }
     }
 }
@@ -22,7 +22,9 @@
 
 #include "atomicqueue.h"
 #include "configuration.h"
+#include "couch-kvstore/couch-fs-deferred-sync.h"
 #include "couch-kvstore/couch-fs-stats.h"
+#include "couch-kvstore/couch-fs-uring.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
 #include "item.h"
 #include "kvstore.h"
@@ -215,6 +217,28 @@ public:
      */
     bool commit(const Item* collectionsManifest) override;
 
+    /**
+     * Write a transaction but defer its couchstore commit until
+     * commitGroup(); the vBucket file is held open until then.
+     */
+    bool prepareCommit(const Item* collectionsManifest) override;
+
+    /**
+     * Commit every prepared transaction, with the syncs of all their files
+     * batched: their data is made durable together on the sync thread,
+     * then their headers are written and a sync of them is started.
+     */
+    void commitGroup() override;
+
+    /// Wait for the sync of the headers started by commitGroup().
+    void syncGroup() override;
+
+    /**
+     * Update the cached state of each file of the group, close it and run
+     * its persistence callbacks.
+     */
+    void completeGroup() override;
+
     /**
      * Rollback a transaction (unless not currently in one).
      */
@@ -484,7 +508,33 @@ protected:
     void operator=(const CouchKVStore &from);
 
     void close();
-    bool commit2couchstore(const Item* collectionsManifest);
+    /// A transaction written by prepareCommit() awaiting commitGroup().
+    struct PreparedCommit {
+        uint16_t vbid = 0;
+        /// The vBucket's file, written to but not yet committed.
+        Db* db = nullptr;
+        size_t numDocs = 0;
+        uint64_t maxDBSeqno = 0;
+        /// Seqno of the file's last commit, before this transaction.
+        uint64_t committedSeqno = 0;
+        /// Revision of the file.
+        uint64_t fileRev = 0;
+        /// Result of the commit so far.
+        couchstore_error_t status = COUCHSTORE_SUCCESS;
+        std::vector<CouchRequest*> reqs;
+        std::unique_ptr<kvstats_ctx> kvctx;
+        std::unique_ptr<TransactionContext> transactionCtx;
+    };
+
+    /**
+     * Write the pending requests to their vBucket file.
+     *
+     * @param collectionsManifest manifest item to write (can be nullptr)
+     * @param prepareOnly if true don't commit the file; instead add it to
+     *        preparedCommits for commitGroup() to commit.
+     */
+    bool commit2couchstore(const Item* collectionsManifest,
+                           bool prepareOnly = false);
 
     uint64_t checkNewRevNum(std::string &dbname, bool newFile = false);
     void populateFileNameMap(std::vector<std::string> &filenames,
@@ -508,6 +558,9 @@ protected:
      * @param kvctx a stats context object to update
      * @param collectionsManifest a pointer to an item which contains the
      *        manifest update data (can be nullptr)
+     * @param prepared if non-null the file is written but not committed;
+     *        instead the open file is returned in prepared->db (along with
+     *        the details needed by finishCommit()).
      *
      * @returns COUCHSTORE_SUCCESS or a failure code (failure paths log)
      */
@@ -516,10 +569,24 @@ protected:
                                 const std::vector<Doc*>& docs,
                                 std::vector<DocInfo*>& docinfos,
                                 kvstats_ctx& kvctx,
-                                const Item* collectionsManifest);
+                                const Item* collectionsManifest,
+                                PreparedCommit* prepared = nullptr);
+
+    /// couchstore_commit() the given file, recording the commit time.
+    couchstore_error_t commitDb(Db& db);
+
+    /**
+     * Update the cached file info and vBucket state after numDocs documents
+     * (the highest with seqno maxDBSeqno) have been committed to db.
+     */
+    void finishCommit(uint16_t vbid,
+                      Db& db,
+                      size_t numDocs,
+                      uint64_t maxDBSeqno);
 
     void commitCallback(std::vector<CouchRequest *> &committedReqs,
                         kvstats_ctx &kvctx,
+                        TransactionContext& txCtx,
                         couchstore_error_t errCode);
     couchstore_error_t saveVBState(Db *db, const vbucket_state &vbState);
 
@@ -595,6 +662,27 @@ protected:
     bool intransaction;
     std::unique_ptr<TransactionContext> transactionCtx;
 
+    /// Transactions written by prepareCommit() awaiting commitGroup().
+    std::vector<PreparedCommit> preparedCommits;
+
+    /**
+     * FileOpsInterface implementation for the files of a group commit,
+     * wrapping statCollectingFileOps and deferring their syncs so they
+     * can be issued for the whole group at once by syncThread.
+     */
+    std::unique_ptr<DeferredSyncFileOps> deferredSyncOps;
+
+    /// Issues the syncs of group commits; started by the first of them.
+    std::unique_ptr<DeferredSyncThread> syncThread;
+
+    /**
+     * FileOpsInterface implementation which reads the documents of a
+     * getMulti() batch concurrently via io_uring. Null unless enabled
+     * (couchstore_async_io) and supported by the platform; when present
+     * statCollectingFileOps wraps it rather than base_ops.
+     */
+    std::unique_ptr<IoUringFileOps> asyncReadOps;
+
     /**
      * FileOpsInterface implementation for couchstore which tracks
      * all bytes read/written by couchstore *except* compaction.
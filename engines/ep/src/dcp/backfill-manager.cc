@@ -27,6 +27,8 @@
 
 #include <phosphor/phosphor.h>
 
+#include <algorithm>
+
 static const size_t sleepTime = 1;
 
 class BackfillManagerTask : public GlobalTask {
@@ -95,7 +97,7 @@ std::chrono::microseconds BackfillManagerTask::maxExpectedDuration() {
 }
 
 BackfillManager::BackfillManager(EventuallyPersistentEngine& e)
-    : engine(e), managerTask(NULL) {
+    : engine(e), numRunning(0) {
     Configuration& config = e.getConfiguration();
 
     scanBuffer.bytesRead = 0;
@@ -123,10 +125,10 @@ void BackfillManager::addStats(DcpProducer& conn,
 }
 
 BackfillManager::~BackfillManager() {
-    if (managerTask) {
-        managerTask->cancel();
-        managerTask.reset();
+    for (auto& task : managerTasks) {
+        task->cancel();
     }
+    managerTasks.clear();
 
     while (!activeBackfills.empty()) {
         UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
@@ -165,24 +167,51 @@ void BackfillManager::schedule(VBucket& vb,
         pendingBackfills.push_back(std::move(backfill));
     }
 
-    if (managerTask && !managerTask->isdead()) {
-        ExecutorPool::get()->wake(managerTask->getId());
-        return;
+    scheduleTasks();
+}
+
+void BackfillManager::scheduleTasks() {
+    managerTasks.erase(std::remove_if(managerTasks.begin(),
+                                      managerTasks.end(),
+                                      [](const ExTask& task) {
+                                          return task->isdead();
+                                      }),
+                       managerTasks.end());
+    for (auto& task : managerTasks) {
+        ExecutorPool::get()->wake(task->getId());
     }
 
-    managerTask.reset(new BackfillManagerTask(engine, shared_from_this()));
-    ExecutorPool::get()->schedule(managerTask);
+    const size_t numBackfills = activeBackfills.size() +
+                                snoozingBackfills.size() +
+                                pendingBackfills.size() + numRunning;
+    const size_t numTasks = std::min(
+            engine.getDcpConnMap().getBackfillParallelism(), numBackfills);
+    while (managerTasks.size() < numTasks) {
+        managerTasks.emplace_back(
+                new BackfillManagerTask(engine, shared_from_this()));
+        ExecutorPool::get()->schedule(managerTasks.back());
+    }
+}
+
+size_t BackfillManager::getNumTasks() {
+    LockHolder lh(lock);
+    return std::count_if(
+            managerTasks.begin(), managerTasks.end(), [](const ExTask& task) {
+                return !task->isdead();
+            });
 }
 
 bool BackfillManager::bytesCheckAndRead(size_t bytes) {
     LockHolder lh(lock);
-    if (scanBuffer.itemsRead >= scanBuffer.maxItems) {
+    // The scan buffer is shared by the backfills running at once.
+    const size_t numScans = std::max(numRunning, size_t(1));
+    if (scanBuffer.itemsRead >= scanBuffer.maxItems * numScans) {
         return false;
     }
 
     // Always allow an item to be backfilled if the scan buffer is empty,
     // otherwise check to see if there is room for the item.
-    if (scanBuffer.bytesRead + bytes <= scanBuffer.maxBytes ||
+    if (scanBuffer.bytesRead + bytes <= scanBuffer.maxBytes * numScans ||
         scanBuffer.bytesRead == 0) {
         scanBuffer.bytesRead += bytes;
     } else {
@@ -248,8 +277,8 @@ void BackfillManager::bytesSent(size_t bytes) {
         if (canFitNext && enoughCleared) {
             buffer.nextReadSize = 0;
             buffer.full = false;
-            if (managerTask) {
-                ExecutorPool::get()->wake(managerTask->getId());
+            for (auto& task : managerTasks) {
+                ExecutorPool::get()->wake(task->getId());
             }
         }
     }
@@ -260,7 +289,11 @@ backfill_status_t BackfillManager::backfill() {
 
     if (activeBackfills.empty() && snoozingBackfills.empty()
         && pendingBackfills.empty()) {
-        managerTask.reset();
+        // Other tasks may still be running a backfill; the last one to
+        // finish forgets them all.
+        if (numRunning == 0) {
+            managerTasks.clear();
+        }
         return backfill_finished;
     }
 
@@ -304,13 +337,16 @@ backfill_status_t BackfillManager::backfill() {
 
     UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
     activeBackfills.pop_front();
+    ++numRunning;
 
     lh.unlock();
     backfill_status_t status = backfill->run();
     lh.lock();
 
-    scanBuffer.bytesRead = 0;
-    scanBuffer.itemsRead = 0;
+    if (--numRunning == 0) {
+        scanBuffer.bytesRead = 0;
+        scanBuffer.itemsRead = 0;
+    }
 
     switch (status) {
         case backfill_success:
@@ -367,7 +403,7 @@ void BackfillManager::moveToActiveQueue() {
 
 void BackfillManager::wakeUpTask() {
     LockHolder lh(lock);
-    if (managerTask) {
-        ExecutorPool::get()->wake(managerTask->getId());
+    for (auto& task : managerTasks) {
+        ExecutorPool::get()->wake(task->getId());
     }
 }
@@ -40,6 +40,8 @@
  * - dcp_scan_byte_limit
  * - dcp_scan_item_limit
  * - dcp_backfill_byte_limit
+ * - dcp_backfill_parallelism (how many backfills, and hence
+ *   BackfillManagerTasks, a connection runs at once)
  */
 
 #ifndef SRC_DCP_BACKFILL_MANAGER_H_
@@ -49,6 +51,7 @@
 #include "dcp/backfill.h"
 
 #include <list>
+#include <vector>
 
 class EventuallyPersistentEngine;
 
@@ -86,12 +89,15 @@ public:
 
     void bytesSent(size_t bytes);
 
-    // Called by the managerTask to acutally perform backfilling & manage
+    // Called by the managerTasks to acutally perform backfilling & manage
     // backfills between the different queues.
     backfill_status_t backfill();
 
     void wakeUpTask();
 
+    /// @return the number of BackfillManagerTasks currently scheduled
+    size_t getNumTasks();
+
 protected:
     //! The buffer is the total bytes used by all backfills for this connection
     struct {
@@ -105,6 +111,13 @@ private:
 
     void moveToActiveQueue();
 
+    /**
+     * Schedule BackfillManagerTasks (up to dcp_backfill_parallelism, and
+     * no more than there are backfills to run) and wake those already
+     * scheduled. Called with the lock held.
+     */
+    void scheduleTasks();
+
     std::mutex lock;
     std::list<UniqueDCPBackfillPtr> activeBackfills;
     std::list<std::pair<rel_time_t, UniqueDCPBackfillPtr> > snoozingBackfills;
@@ -112,9 +125,12 @@ private:
     //!   threshold we use waitingBackfills
     std::list<UniqueDCPBackfillPtr> pendingBackfills;
     EventuallyPersistentEngine& engine;
-    ExTask managerTask;
+    std::vector<ExTask> managerTasks;
+    //! Number of backfills being run (by the managerTasks) right now
+    size_t numRunning;
 
-    //! The scan buffer is for the current stream being backfilled
+    //! The scan buffer is for the streams currently being backfilled; the
+    //! limits apply to each of them
     struct {
         size_t bytesRead;
         size_t itemsRead;
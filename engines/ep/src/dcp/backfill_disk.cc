@@ -18,10 +18,14 @@
 #include "config.h"
 
 #include "dcp/backfill_disk.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/stream.h"
 #include "ep_engine.h"
+#include "failover-table.h"
 #include "vbucket.h"
 
+#include <limits>
+
 static std::string backfillStateToString(backfill_state_t state) {
     switch (state) {
     case backfill_state_init:
@@ -94,6 +98,7 @@ void CacheCallback::callback(CacheLookup& lookup) {
                 if (stream_->backfillReceived(std::move(gv.item),
                                               BACKFILL_FROM_MEMORY,
                                               /*force */ false)) {
+                    engine_.getEpStats().dcpBackfillItemsRead++;
                     setStatus(ENGINE_KEY_EEXISTS);
                     return;
                 }
@@ -107,7 +112,8 @@ void CacheCallback::callback(CacheLookup& lookup) {
     }
 }
 
-DiskCallback::DiskCallback(std::shared_ptr<ActiveStream> s) : streamPtr(s) {
+DiskCallback::DiskCallback(EPStats& st, std::shared_ptr<ActiveStream> s)
+    : stats(st), streamPtr(s) {
     if (s == nullptr) {
         throw std::invalid_argument("DiskCallback(): stream is NULL");
     }
@@ -139,10 +145,268 @@ void DiskCallback::callback(GetValue& val) {
                                    /*force*/ false)) {
         setStatus(ENGINE_ENOMEM); // Pause the backfill
     } else {
+        stats.dcpBackfillItemsRead++;
         setStatus(ENGINE_SUCCESS);
     }
 }
 
+/* Callback sending the items a SharedDiskScan finds in the cache */
+class SharedCacheCallback : public StatusCallback<CacheLookup> {
+public:
+    SharedCacheCallback(SharedDiskScan& s) : scan(s) {
+    }
+
+    void callback(CacheLookup& lookup) override {
+        // Skip reading items none of the readers need
+        if (!scan.isNeeded(lookup.getBySeqno())) {
+            setStatus(ENGINE_KEY_EEXISTS);
+            return;
+        }
+
+        auto& engine = scan.getEngine();
+        VBucketPtr vb =
+                engine.getKVBucket()->getVBucket(lookup.getVBucketId());
+        if (!vb) {
+            setStatus(ENGINE_SUCCESS);
+            return;
+        }
+
+        auto collectionsRHandle = vb->lockCollections(lookup.getKey());
+        if (collectionsRHandle.isLogicallyDeleted(lookup.getBySeqno())) {
+            setStatus(ENGINE_KEY_EEXISTS);
+            return;
+        }
+
+        auto gv = vb->getInternal(
+                nullptr,
+                engine,
+                0,
+                /*options*/ NONE,
+                /*diskFlushAll*/ false,
+                scan.getValueFilter() == ValueFilter::KEYS_ONLY
+                        ? VBucket::GetKeyOnly::Yes
+                        : VBucket::GetKeyOnly::No,
+                collectionsRHandle);
+        if (gv.getStatus() == ENGINE_SUCCESS &&
+            gv.item->getBySeqno() == lookup.getBySeqno()) {
+            if (scan.deliver(std::move(gv.item), BACKFILL_FROM_MEMORY)) {
+                setStatus(ENGINE_KEY_EEXISTS);
+            } else {
+                setStatus(ENGINE_ENOMEM); // Pause the backfill
+            }
+            return;
+        }
+        setStatus(ENGINE_SUCCESS);
+    }
+
+private:
+    SharedDiskScan& scan;
+};
+
+/* Callback sending the items a SharedDiskScan reads from disk */
+class SharedDiskCallback : public StatusCallback<GetValue> {
+public:
+    SharedDiskCallback(SharedDiskScan& s) : scan(s) {
+    }
+
+    void callback(GetValue& val) override {
+        if (!val.item) {
+            throw std::invalid_argument(
+                    "SharedDiskCallback::callback: val is NULL");
+        }
+
+        // MB-26705: Make the backfilled item cold so ideally the consumer
+        // would evict this before any cached item if they get into memory
+        // pressure.
+        val.item->setNRUValue(MAX_NRU_VALUE);
+
+        if (scan.deliver(std::move(val.item), BACKFILL_FROM_DISK)) {
+            setStatus(ENGINE_SUCCESS);
+        } else {
+            setStatus(ENGINE_ENOMEM); // Pause the backfill
+        }
+    }
+
+private:
+    SharedDiskScan& scan;
+};
+
+SharedDiskScan::SharedDiskScan(EventuallyPersistentEngine& e,
+                               uint16_t vbid,
+                               uint64_t vbUuid,
+                               ValueFilter filter,
+                               std::shared_ptr<ActiveStream> leader,
+                               uint64_t startSeqno,
+                               uint64_t endSeqno)
+    : engine(e),
+      vbid(vbid),
+      vbUuid(vbUuid),
+      filter(filter),
+      endSeqno(endSeqno) {
+    readers.push_back({leader, startSeqno, ReaderState::Reading});
+}
+
+std::shared_ptr<StatusCallback<GetValue>> SharedDiskScan::makeDiskCallback() {
+    return std::make_shared<SharedDiskCallback>(*this);
+}
+
+std::shared_ptr<StatusCallback<CacheLookup>>
+SharedDiskScan::makeCacheCallback() {
+    return std::make_shared<SharedCacheCallback>(*this);
+}
+
+void SharedDiskScan::setScanContext(const ScanContext& ctx) {
+    std::lock_guard<std::mutex> lh(mutex);
+    endSeqno = std::min(endSeqno, uint64_t(ctx.maxSeqno));
+    documentCount = ctx.documentCount;
+}
+
+uint64_t SharedDiskScan::getEndSeqno() {
+    std::lock_guard<std::mutex> lh(mutex);
+    return endSeqno;
+}
+
+size_t SharedDiskScan::addReader(std::shared_ptr<ActiveStream> stream,
+                                 uint64_t startSeqno,
+                                 uint64_t lastSeqno) {
+    std::lock_guard<std::mutex> lh(mutex);
+    // The scan must not have passed startSeqno (the leader has yet to be
+    // sent anything after it, so neither has any other reader) and must
+    // read at least up to lastSeqno.
+    const auto& leader = readers.front();
+    if (finished || leader.state != ReaderState::Reading ||
+        startSeqno < leader.nextSeqno || lastSeqno > endSeqno) {
+        return 0;
+    }
+
+    // Mark the snapshot while holding the lock, so it is queued before any
+    // item the scan sends the stream.
+    stream->incrBackfillRemaining(documentCount);
+    stream->markDiskSnapshot(startSeqno, endSeqno);
+    readers.push_back({stream, startSeqno, ReaderState::Reading});
+    return readers.size() - 1;
+}
+
+void SharedDiskScan::removeReader(size_t id) {
+    std::lock_guard<std::mutex> lh(mutex);
+    readers.at(id).state = ReaderState::Cancelled;
+}
+
+SharedDiskScan::ReaderState SharedDiskScan::getReaderState(
+        size_t id, uint64_t& resumeSeqno) {
+    std::lock_guard<std::mutex> lh(mutex);
+    const auto& reader = readers.at(id);
+    resumeSeqno = reader.nextSeqno;
+    return reader.state;
+}
+
+void SharedDiskScan::finish(bool cancelled) {
+    std::lock_guard<std::mutex> lh(mutex);
+    finished = true;
+    for (auto& reader : readers) {
+        if (reader.state == ReaderState::Reading) {
+            reader.state = cancelled ? ReaderState::Detached
+                                     : ReaderState::Finished;
+        }
+    }
+}
+
+bool SharedDiskScan::isNeeded(int64_t seqno) {
+    std::lock_guard<std::mutex> lh(mutex);
+    if (uint64_t(seqno) > endSeqno) {
+        return false;
+    }
+    for (const auto& reader : readers) {
+        if (reader.state == ReaderState::Reading &&
+            uint64_t(seqno) >= reader.nextSeqno) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SharedDiskScan::deliver(std::unique_ptr<Item> item,
+                             backfill_source_t source) {
+    const uint64_t seqno = item->getBySeqno();
+    std::lock_guard<std::mutex> lh(mutex);
+    if (seqno > endSeqno) {
+        return true;
+    }
+
+    bool read = false;
+    for (size_t id = 0; id < readers.size(); ++id) {
+        auto& reader = readers[id];
+        if (reader.state != ReaderState::Reading || seqno < reader.nextSeqno) {
+            continue;
+        }
+        auto stream = reader.stream.lock();
+        if (!stream) {
+            reader.state = ReaderState::Cancelled;
+            continue;
+        }
+
+        // Each stream needs its own Item; the copies share the value.
+        auto itm = readers.size() == 1 ? std::move(item)
+                                       : std::make_unique<Item>(*item);
+        if (stream->backfillReceived(std::move(itm), source, false)) {
+            reader.nextSeqno = seqno + 1;
+            read = true;
+        } else if (id == 0) {
+            // Pause the scan; the item is read again (and only sent to the
+            // readers which did not take it) when it resumes.
+            return false;
+        } else {
+            // Don't hold up the other streams for this one; it continues
+            // from here with its own scan.
+            reader.state = ReaderState::Detached;
+        }
+    }
+
+    if (read) {
+        engine.getEpStats().dcpBackfillItemsRead++;
+    }
+    return true;
+}
+
+void SharedDiskScanRegistry::add(std::shared_ptr<SharedDiskScan> scan) {
+    std::lock_guard<std::mutex> lh(mutex);
+    scans.push_back(scan);
+}
+
+void SharedDiskScanRegistry::remove(const SharedDiskScan& scan) {
+    std::lock_guard<std::mutex> lh(mutex);
+    for (auto it = scans.begin(); it != scans.end();) {
+        auto s = it->lock();
+        if (!s || s.get() == &scan) {
+            it = scans.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<SharedDiskScan> SharedDiskScanRegistry::join(
+        std::shared_ptr<ActiveStream> stream,
+        uint64_t vbUuid,
+        ValueFilter filter,
+        uint64_t startSeqno,
+        uint64_t endSeqno,
+        size_t& readerId) {
+    std::lock_guard<std::mutex> lh(mutex);
+    for (const auto& weak : scans) {
+        auto scan = weak.lock();
+        if (scan && scan->getVBucketId() == stream->getVBucket() &&
+            scan->getVBucketUuid() == vbUuid &&
+            scan->getValueFilter() == filter) {
+            readerId = scan->addReader(stream, startSeqno, endSeqno);
+            if (readerId != 0) {
+                return scan;
+            }
+        }
+    }
+    return nullptr;
+}
+
 DCPBackfillDisk::DCPBackfillDisk(EventuallyPersistentEngine& e,
                                  std::shared_ptr<ActiveStream> s,
                                  uint64_t startSeqno,
@@ -215,22 +479,130 @@ backfill_status_t DCPBackfillDisk::create() {
         }
     }
 
-    auto cb = std::make_shared<DiskCallback>(stream);
-    auto cl = std::make_shared<CacheCallback>(engine, stream);
-    scanCtx = kvstore->initScanContext(
-            cb, cl, vbid, startSeqno, DocumentFilter::ALL_ITEMS, valFilter);
+    auto& connMap = engine.getDcpConnMap();
+    if (connMap.isBackfillSharedScanEnabled()) {
+        VBucketPtr vb = engine.getVBucket(vbid);
+        const uint64_t vbUuid = vb ? vb->failovers->getLatestUUID() : 0;
+
+        // Join another stream's scan of the vBucket if we can, otherwise
+        // start a scan other streams can join.
+        sharedScan = connMap.getSharedDiskScans().join(
+                stream, vbUuid, valFilter, startSeqno, endSeqno, readerId);
+        if (sharedScan) {
+            engine.getEpStats().dcpBackfillScansAvoided++;
+            stream->log(EXTENSION_LOG_INFO,
+                        "(vb %d) Backfill (%" PRIu64 " to %" PRIu64
+                        ") joined a disk scan in progress",
+                        vbid,
+                        startSeqno,
+                        endSeqno);
+            transitionState(backfill_state_scanning);
+            return backfill_success;
+        }
+        sharedScan = std::make_shared<SharedDiskScan>(
+                engine,
+                vbid,
+                vbUuid,
+                valFilter,
+                stream,
+                startSeqno,
+                std::numeric_limits<uint64_t>::max());
+    }
+
+    scanCtx = initScanContext(*kvstore, stream, valFilter, startSeqno);
 
     if (scanCtx) {
         stream->incrBackfillRemaining(scanCtx->documentCount);
         stream->markDiskSnapshot(startSeqno, scanCtx->maxSeqno);
+        if (sharedScan) {
+            sharedScan->setScanContext(*scanCtx);
+            connMap.getSharedDiskScans().add(sharedScan);
+        }
         transitionState(backfill_state_scanning);
     } else {
+        sharedScan.reset();
         transitionState(backfill_state_done);
     }
 
     return backfill_success;
 }
 
+ScanContext* DCPBackfillDisk::initScanContext(
+        KVStore& kvstore,
+        std::shared_ptr<ActiveStream> stream,
+        ValueFilter valFilter,
+        uint64_t startSeqno) {
+    std::shared_ptr<StatusCallback<GetValue>> cb;
+    std::shared_ptr<StatusCallback<CacheLookup>> cl;
+    if (sharedScan) {
+        cb = sharedScan->makeDiskCallback();
+        cl = sharedScan->makeCacheCallback();
+    } else {
+        cb = std::make_shared<DiskCallback>(engine.getEpStats(), stream);
+        cl = std::make_shared<CacheCallback>(engine, stream);
+    }
+
+    auto* ctx = kvstore.initScanContext(cb,
+                                        cl,
+                                        stream->getVBucket(),
+                                        startSeqno,
+                                        DocumentFilter::ALL_ITEMS,
+                                        valFilter);
+    if (ctx) {
+        engine.getEpStats().dcpBackfillScans++;
+    }
+    return ctx;
+}
+
+backfill_status_t DCPBackfillDisk::followSharedScan(
+        std::shared_ptr<ActiveStream> stream) {
+    uint64_t resumeSeqno = 0;
+    switch (sharedScan->getReaderState(readerId, resumeSeqno)) {
+    case SharedDiskScan::ReaderState::Reading:
+        return backfill_snooze;
+    case SharedDiskScan::ReaderState::Finished:
+        transitionState(backfill_state_completing);
+        return backfill_success;
+    case SharedDiskScan::ReaderState::Cancelled:
+        return complete(true);
+    case SharedDiskScan::ReaderState::Detached:
+        break;
+    }
+
+    // Carry on from where the shared scan left us with a scan of our own,
+    // limited to the disk snapshot already sent.
+    const uint64_t snapshotEnd = sharedScan->getEndSeqno();
+    stream->log(EXTENSION_LOG_NOTICE,
+                "(vb %d) Backfill detached from shared disk scan, "
+                "continuing from seqno %" PRIu64 " to %" PRIu64,
+                getVBucketId(),
+                resumeSeqno,
+                snapshotEnd);
+    if (resumeSeqno > snapshotEnd) {
+        transitionState(backfill_state_completing);
+        return backfill_success;
+    }
+
+    auto scan = std::make_shared<SharedDiskScan>(engine,
+                                                 getVBucketId(),
+                                                 sharedScan->getVBucketUuid(),
+                                                 sharedScan->getValueFilter(),
+                                                 stream,
+                                                 resumeSeqno,
+                                                 snapshotEnd);
+    sharedScan = scan;
+    readerId = 0;
+
+    KVStore* kvstore = engine.getKVBucket()->getROUnderlying(getVBucketId());
+    scanCtx = initScanContext(
+            *kvstore, stream, scan->getValueFilter(), resumeSeqno);
+    if (!scanCtx) {
+        return complete(true);
+    }
+    scan->setScanContext(*scanCtx);
+    return backfill_success;
+}
+
 backfill_status_t DCPBackfillDisk::scan() {
     auto stream = streamPtr.lock();
     if (!stream) {
@@ -243,8 +615,17 @@ backfill_status_t DCPBackfillDisk::scan() {
         return complete(true);
     }
 
+    if (sharedScan && readerId != 0) {
+        return followSharedScan(stream);
+    }
+
     KVStore* kvstore = engine.getKVBucket()->getROUnderlying(vbid);
+    const auto start = ProcessClock::now();
     scan_error_t error = kvstore->scan(scanCtx);
+    engine.getEpStats().dcpBackfillScanTime.fetch_add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    ProcessClock::now() - start)
+                    .count());
 
     if (error == scan_again) {
         return backfill_success;
@@ -260,6 +641,17 @@ backfill_status_t DCPBackfillDisk::complete(bool cancelled) {
        or not */
     KVStore* kvstore = engine.getKVBucket()->getROUnderlying(getVBucketId());
     kvstore->destroyScanContext(scanCtx);
+    scanCtx = nullptr;
+
+    if (sharedScan) {
+        if (readerId == 0) {
+            engine.getDcpConnMap().getSharedDiskScans().remove(*sharedScan);
+            sharedScan->finish(cancelled);
+        } else {
+            sharedScan->removeReader(readerId);
+        }
+        sharedScan.reset();
+    }
 
     auto stream = streamPtr.lock();
     if (!stream) {
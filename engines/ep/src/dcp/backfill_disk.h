@@ -21,6 +21,10 @@
 
 #include "callbacks.h"
 #include "dcp/backfill.h"
+#include "kvstore.h"
+
+#include <mutex>
+#include <vector>
 
 class EventuallyPersistentEngine;
 class ScanContext;
@@ -59,14 +63,183 @@ private:
 /* Callback to get the items that are found to be in the disk */
 class DiskCallback : public StatusCallback<GetValue> {
 public:
-    DiskCallback(std::shared_ptr<ActiveStream> s);
+    DiskCallback(EPStats& st, std::shared_ptr<ActiveStream> s);
 
     void callback(GetValue& val);
 
 private:
+    EPStats& stats;
     std::weak_ptr<ActiveStream> streamPtr;
 };
 
+/**
+ * A disk scan of one vBucket whose items are sent to every stream reading
+ * it (see dcp_backfill_shared_scan).
+ *
+ * The scan is started by the backfill of one stream (the leader, reader 0);
+ * while it is in progress the backfills of other streams of the vBucket may
+ * join it (as readers) if it has yet to reach the first seqno they need
+ * and will read every seqno up to the end of their backfill. Each item read
+ * is sent to all readers which need it, so N streams backfilling the vBucket
+ * at once read it from disk once rather than N times.
+ *
+ * The scan only pauses for the leader: if another reader's stream cannot
+ * take an item (its connection's backfill buffer is full) that reader is
+ * detached, and its backfill continues with a scan of its own from the seqno
+ * it had reached. Likewise all readers are detached if the leader's
+ * backfill is cancelled.
+ */
+class SharedDiskScan {
+public:
+    enum class ReaderState {
+        /// Items are being read for the reader
+        Reading,
+        /// The scan has read everything the reader needs
+        Finished,
+        /// The reader must continue with its own scan
+        Detached,
+        /// The reader's stream has gone away
+        Cancelled
+    };
+
+    /**
+     * @param e the engine
+     * @param vbid vBucket to scan
+     * @param vbUuid latest failover UUID of the vBucket when the scan was
+     *        created; only streams of the same vBucket history may join
+     * @param filter the values to read
+     * @param leader stream of the backfill creating the scan
+     * @param startSeqno first seqno the leader needs
+     * @param endSeqno last seqno any reader may be sent
+     */
+    SharedDiskScan(EventuallyPersistentEngine& e,
+                   uint16_t vbid,
+                   uint64_t vbUuid,
+                   ValueFilter filter,
+                   std::shared_ptr<ActiveStream> leader,
+                   uint64_t startSeqno,
+                   uint64_t endSeqno);
+
+    /// @return the callback to give KVStore::initScanContext for disk reads
+    std::shared_ptr<StatusCallback<GetValue>> makeDiskCallback();
+
+    /// @return the callback to give KVStore::initScanContext for items
+    ///         found in memory
+    std::shared_ptr<StatusCallback<CacheLookup>> makeCacheCallback();
+
+    /**
+     * Called once the scan context has been created; limits the scan to the
+     * seqnos it will read.
+     */
+    void setScanContext(const ScanContext& ctx);
+
+    /**
+     * Try to add a stream needing seqnos startSeqno..endSeqno as a reader.
+     * On success the stream's disk snapshot is marked (before any item can
+     * be sent to it) as startSeqno to the end of the scan.
+     *
+     * @return the reader's id, or 0 if the stream cannot join the scan
+     */
+    size_t addReader(std::shared_ptr<ActiveStream> stream,
+                     uint64_t startSeqno,
+                     uint64_t endSeqno);
+
+    /// Stop sending items to a reader whose backfill has been cancelled.
+    void removeReader(size_t id);
+
+    /**
+     * @param id a reader id returned by addReader
+     * @param[out] resumeSeqno if Detached, the first seqno the reader's own
+     *             scan must read
+     */
+    ReaderState getReaderState(size_t id, uint64_t& resumeSeqno);
+
+    /**
+     * Called by the leader's backfill when the scan has ended, to tell the
+     * other readers whether to finish or continue on their own.
+     *
+     * @param cancelled true if the scan did not reach its end
+     */
+    void finish(bool cancelled);
+
+    /**
+     * Send an item read by the scan to all the readers which need it.
+     *
+     * @return false if the leader could not take the item and the scan must
+     *         pause
+     */
+    bool deliver(std::unique_ptr<Item> item, backfill_source_t source);
+
+    /// @return true if any reader still needs the given seqno
+    bool isNeeded(int64_t seqno);
+
+    uint16_t getVBucketId() const {
+        return vbid;
+    }
+
+    uint64_t getVBucketUuid() const {
+        return vbUuid;
+    }
+
+    uint64_t getEndSeqno();
+
+    ValueFilter getValueFilter() const {
+        return filter;
+    }
+
+    EventuallyPersistentEngine& getEngine() {
+        return engine;
+    }
+
+private:
+    struct Reader {
+        std::weak_ptr<ActiveStream> stream;
+        /// The next seqno the reader needs
+        uint64_t nextSeqno;
+        ReaderState state;
+    };
+
+    EventuallyPersistentEngine& engine;
+    const uint16_t vbid;
+    const uint64_t vbUuid;
+    const ValueFilter filter;
+
+    std::mutex mutex;
+    uint64_t endSeqno;
+    uint64_t documentCount = 0;
+    std::vector<Reader> readers;
+    bool finished = false;
+};
+
+/**
+ * The scans of a bucket which other backfills may join; owned by the
+ * DcpConnMap.
+ */
+class SharedDiskScanRegistry {
+public:
+    void add(std::shared_ptr<SharedDiskScan> scan);
+
+    void remove(const SharedDiskScan& scan);
+
+    /**
+     * Add the stream as a reader of a scan of its vBucket in progress if
+     * there is one it can join.
+     *
+     * @param[out] readerId the id of the stream in the scan joined
+     * @return the scan joined, or nullptr
+     */
+    std::shared_ptr<SharedDiskScan> join(std::shared_ptr<ActiveStream> stream,
+                                         uint64_t vbUuid,
+                                         ValueFilter filter,
+                                         uint64_t startSeqno,
+                                         uint64_t endSeqno,
+                                         size_t& readerId);
+
+private:
+    std::mutex mutex;
+    std::vector<std::weak_ptr<SharedDiskScan>> scans;
+};
+
 /**
  * Concrete class that does backfill from the disk and informs the DCP stream
  * of the backfill progress.
@@ -109,6 +282,22 @@ private:
      */
     backfill_status_t complete(bool cancelled);
 
+    /**
+     * Creates the scan context for a scan from startSeqno; with a shared
+     * scan the callbacks send the items read to all the scan's readers.
+     */
+    ScanContext* initScanContext(KVStore& kvstore,
+                                 std::shared_ptr<ActiveStream> stream,
+                                 ValueFilter valFilter,
+                                 uint64_t startSeqno);
+
+    /**
+     * Run the backfill of a stream which joined another stream's scan;
+     * waits for that scan and takes over reading if the stream is detached
+     * from it.
+     */
+    backfill_status_t followSharedScan(std::shared_ptr<ActiveStream> stream);
+
     /**
      * Makes transitions to the state machine to backfill from the disk
      * asynchronously and to inform the DCP stream of the backfill progress.
@@ -124,5 +313,10 @@ private:
 
     ScanContext* scanCtx;
     backfill_state_t state;
+
+    /// The scan (if shared) this backfill is reading, and its reader id in
+    /// it; 0 if it is the scan's leader.
+    std::shared_ptr<SharedDiskScan> sharedScan;
+    size_t readerId = 0;
     std::mutex lock;
 };
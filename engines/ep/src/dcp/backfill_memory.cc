@@ -163,7 +163,8 @@ backfill_status_t DCPBackfillMemoryBuffered::create() {
 
     /* Create range read cursor */
     try {
-        auto rangeItrOptional = evb->makeRangeIterator(true /*isBackfill*/);
+        auto rangeItrOptional =
+                evb->makeRangeIterator(true /*isBackfill*/, startSeqno);
         if (rangeItrOptional) {
             rangeItr = std::move(*rangeItrOptional);
         } else {
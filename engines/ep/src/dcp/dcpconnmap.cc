@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include "configuration.h"
+#include "dcp/backfill_disk.h"
 #include "dcp/consumer.h"
 #include "dcp/producer.h"
 #include "dcpconnmap.h"
@@ -33,6 +34,7 @@ public:
     virtual ~DcpConfigChangeListener() {
     }
     virtual void sizeValueChanged(const std::string& key, size_t value);
+    virtual void booleanValueChanged(const std::string& key, bool value);
 
 private:
     DcpConnMap& myConnMap;
@@ -40,11 +42,23 @@ private:
 
 DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     : ConnMap(e),
+      sharedDiskScans(std::make_unique<SharedDiskScanRegistry>()),
+      vbNotifications(e.getConfiguration().getMaxVbuckets()),
       aggrDcpConsumerBufferSize(0) {
     backfills.numActiveSnoozing = 0;
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
     minCompressionRatioForProducer.store(
                     engine.getConfiguration().getDcpMinCompressionRatio());
+    producerBatchBytes.store(
+            engine.getConfiguration().getDcpProducerBatchBytes());
+    compressionCacheEnabled.store(
+            engine.getConfiguration().isDcpCompressionCacheEnabled());
+    backfillParallelism.store(
+            engine.getConfiguration().getDcpBackfillParallelism());
+    backfillSharedScan.store(
+            engine.getConfiguration().isDcpBackfillSharedScan());
+    batchSeqnoNotifications.store(
+            engine.getConfiguration().isDcpBatchSeqnoNotifications());
 
     // Note: these allocations are deleted by ~Configuration
     engine.getConfiguration().
@@ -53,6 +67,18 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     engine.getConfiguration().
         addValueChangedListener("dcp_consumer_process_buffered_messages_batch_size",
                                 new DcpConfigChangeListener(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_producer_batch_bytes", new DcpConfigChangeListener(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_compression_cache_enabled",
+            new DcpConfigChangeListener(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_backfill_parallelism", new DcpConfigChangeListener(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_backfill_shared_scan", new DcpConfigChangeListener(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "dcp_batch_seqno_notifications",
+            new DcpConfigChangeListener(*this));
 }
 
 DcpConnMap::~DcpConnMap() {
@@ -370,6 +396,37 @@ void DcpConnMap::removeVBConnections(DcpProducer& prod) {
 }
 
 void DcpConnMap::notifyVBConnections(uint16_t vbid, uint64_t bySeqno) {
+    if (!batchSeqnoNotifications.load()) {
+        notifyVBProducers(vbid, bySeqno);
+        return;
+    }
+
+    auto& pending = vbNotifications[vbid];
+    pending.seqno.store(bySeqno);
+    if (!pending.queued.exchange(true)) {
+        pendingVBNotifications.push(vbid);
+        if (connNotifier_) {
+            connNotifier_->notifyMutationEvent();
+        }
+    }
+}
+
+void DcpConnMap::processPendingNotifications() {
+    std::queue<uint16_t> vbids;
+    pendingVBNotifications.getAll(vbids);
+    while (!vbids.empty()) {
+        const auto vbid = vbids.front();
+        vbids.pop();
+        auto& pending = vbNotifications[vbid];
+        // Clear queued before reading the seqno, so a notification racing
+        // with us either sees it clear and queues the vbucket again, or
+        // has already stored a seqno we read.
+        pending.queued.store(false);
+        notifyVBProducers(vbid, pending.seqno.load());
+    }
+}
+
+void DcpConnMap::notifyVBProducers(uint16_t vbid, uint64_t bySeqno) {
     size_t lock_num = vbid % vbConnLockNum;
     std::lock_guard<SpinLock> lh(vbConnLocks[lock_num]);
 
@@ -456,6 +513,21 @@ void DcpConnMap::DcpConfigChangeListener::sizeValueChanged(const std::string &ke
         myConnMap.consumerYieldConfigChanged(value);
     } else if (key == "dcp_consumer_process_buffered_messages_batch_size") {
         myConnMap.consumerBatchSizeConfigChanged(value);
+    } else if (key == "dcp_producer_batch_bytes") {
+        myConnMap.producerBatchBytes.store(value);
+    } else if (key == "dcp_backfill_parallelism") {
+        myConnMap.backfillParallelism.store(value);
+    }
+}
+
+void DcpConnMap::DcpConfigChangeListener::booleanValueChanged(
+        const std::string& key, bool value) {
+    if (key == "dcp_compression_cache_enabled") {
+        myConnMap.compressionCacheEnabled.store(value);
+    } else if (key == "dcp_backfill_shared_scan") {
+        myConnMap.backfillSharedScan.store(value);
+    } else if (key == "dcp_batch_seqno_notifications") {
+        myConnMap.batchSeqnoNotifications.store(value);
     }
 }
 
@@ -26,10 +26,13 @@
 
 #include <atomic>
 #include <list>
+#include <memory>
 #include <string>
+#include <vector>
 
 class DcpProducer;
 class DcpConsumer;
+class SharedDiskScanRegistry;
 
 class DcpConnMap : public ConnMap {
 
@@ -61,8 +64,19 @@ public:
      */
     DcpConsumer *newConsumer(const void* cookie, const std::string &name);
 
+    /**
+     * Notify the producers streaming the given vbucket that seqnos up to
+     * bySeqno are available.
+     *
+     * With dcp_batch_seqno_notifications the notification is only recorded
+     * here, and the connection notifier task fans it out to the producers;
+     * notifications of a vbucket which arrive before the task gets to it
+     * are coalesced into one.
+     */
     void notifyVBConnections(uint16_t vbid, uint64_t bySeqno);
 
+    void processPendingNotifications() override;
+
     void notifyBackfillManagerTasks();
 
     void removeVBConnections(DcpProducer& prod);
@@ -134,6 +148,40 @@ public:
 
     float getMinCompressionRatio();
 
+    /* The most bytes a producer hands to the core in one step (0 to send
+     * one message per step) */
+    size_t getProducerBatchBytes() const {
+        return producerBatchBytes.load();
+    }
+
+    /* Whether streams share one compressed copy of each checkpoint item's
+     * value rather than compressing it for each stream */
+    bool isCompressionCacheEnabled() const {
+        return compressionCacheEnabled.load();
+    }
+
+    /* The most backfills each producer runs at once */
+    size_t getBackfillParallelism() const {
+        return backfillParallelism.load();
+    }
+
+    /* Whether seqno notifications are fanned out by the connection notifier
+     * rather than by the thread which queued the item */
+    bool isBatchSeqnoNotifications() const {
+        return batchSeqnoNotifications.load();
+    }
+
+    /* Whether disk backfills may join a scan of the vBucket already in
+     * progress for another stream */
+    bool isBackfillSharedScanEnabled() const {
+        return backfillSharedScan.load();
+    }
+
+    /* The disk backfill scans of this bucket which other backfills may join */
+    SharedDiskScanRegistry& getSharedDiskScans() {
+        return *sharedDiskScans;
+    }
+
     std::shared_ptr<ConnHandler> findByName(const std::string& name);
 
     bool isConnections() {
@@ -171,6 +219,11 @@ protected:
 
     bool isPassiveStreamConnected_UNLOCKED(uint16_t vbucket);
 
+    /*
+     * Call notifySeqnoAvailable on each producer streaming vbid.
+     */
+    void notifyVBProducers(uint16_t vbid, uint64_t bySeqno);
+
     /*
      * Closes all streams associated with each connection in `map`.
      */
@@ -198,6 +251,32 @@ protected:
 
     std::atomic<float> minCompressionRatioForProducer;
 
+    std::atomic<size_t> producerBatchBytes;
+
+    std::atomic<bool> compressionCacheEnabled;
+
+    std::atomic<size_t> backfillParallelism;
+
+    std::atomic<bool> backfillSharedScan;
+
+    std::unique_ptr<SharedDiskScanRegistry> sharedDiskScans;
+
+    std::atomic<bool> batchSeqnoNotifications;
+
+    /* A vbucket's seqno notification waiting for the connection notifier */
+    struct PendingVBNotification {
+        /* Set while the vbucket is on pendingVBNotifications */
+        std::atomic<bool> queued{false};
+        /* The latest seqno notified */
+        std::atomic<uint64_t> seqno{0};
+    };
+
+    /* Indexed by vbucket id */
+    std::vector<PendingVBNotification> vbNotifications;
+
+    /* The vbuckets with a notification waiting, each at most once */
+    AtomicQueue<uint16_t> pendingVBNotifications;
+
     /* Total memory used by all DCP consumer buffers */
     std::atomic<size_t> aggrDcpConsumerBufferSize;
 
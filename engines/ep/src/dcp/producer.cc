@@ -51,6 +51,7 @@ void DcpProducer::BufferLog::setBufferSize(size_t maxBytes) {
     if (maxBytes == 0) {
         bytesSent = 0;
         ackedBytes = 0;
+        avgAckBytes = 0;
     }
 }
 
@@ -105,6 +106,10 @@ void DcpProducer::BufferLog::acknowledge(size_t bytes) {
     if (state != Disabled) {
         release_UNLOCKED(bytes);
         ackedBytes += bytes;
+        // Weight the latest ack by 1/8th so the batch target follows changes
+        // in the consumer's behaviour without jumping on one odd ack.
+        avgAckBytes = (avgAckBytes == 0) ? bytes
+                                         : (avgAckBytes * 7 + bytes) / 8;
         if (state == Full) {
             LOG(EXTENSION_LOG_NOTICE,
                 "%s Notifying paused connection now that "
@@ -119,12 +124,27 @@ void DcpProducer::BufferLog::acknowledge(size_t bytes) {
     }
 }
 
+size_t DcpProducer::BufferLog::getBatchTarget(size_t maxBatch) {
+    ReaderLockHolder rlh(logLock);
+    if (!isEnabled_UNLOCKED()) {
+        return maxBatch;
+    }
+
+    size_t target = std::min(maxBatch,
+                             isFull_UNLOCKED() ? 0 : maxBytes - bytesSent);
+    if (avgAckBytes != 0) {
+        target = std::min(target, avgAckBytes);
+    }
+    return target;
+}
+
 void DcpProducer::BufferLog::addStats(ADD_STAT add_stat, const void *c) {
     ReaderLockHolder rlh(logLock);
     if (isEnabled_UNLOCKED()) {
         producer.addStat("max_buffer_bytes", maxBytes, add_stat, c);
         producer.addStat("unacked_bytes", bytesSent, add_stat, c);
         producer.addStat("total_acked_bytes", ackedBytes, add_stat, c);
+        producer.addStat("avg_ack_bytes", avgAckBytes, add_stat, c);
         producer.addStat("flow_control", "enabled", add_stat, c);
     } else {
         producer.addStat("flow_control", "disabled", add_stat, c);
@@ -502,6 +522,44 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         return ret;
     }
 
+    // Hand the core as many responses as fit in this step's batch target,
+    // so they go out in a single fill of the connection's write buffer
+    // rather than one write (and one trip through the core's state machine)
+    // per response. The batch is not ended directly after a snapshot marker,
+    // so the consumer always receives a marker together with its first item.
+    const size_t target = log.getBatchTarget(
+            engine_.getDcpConnMap().getProducerBatchBytes());
+    size_t batchBytes = 0;
+    size_t batchMessages = 0;
+    DcpResponse::Event event;
+    do {
+        ret = sendNextResponse(producers, event, batchBytes);
+        if (ret != ENGINE_WANT_MORE) {
+            break;
+        }
+        ++batchMessages;
+    } while (batchBytes < target ||
+             (target != 0 && event == DcpResponse::Event::SnapshotMarker));
+
+    if (batchMessages == 0) {
+        return ret;
+    }
+
+    stepBatchBytes.add(batchBytes);
+    stepBatchMessages.add(batchMessages);
+
+    // Running out of responses, or of space in the core's write buffer (the
+    // rejected response is retried on the next step), just ends the batch.
+    if (ret == ENGINE_SUCCESS || ret == ENGINE_E2BIG) {
+        ret = ENGINE_WANT_MORE;
+    }
+    return ret;
+}
+
+ENGINE_ERROR_CODE DcpProducer::sendNextResponse(
+        struct dcp_message_producers* producers,
+        DcpResponse::Event& event,
+        size_t& bytes) {
     std::unique_ptr<DcpResponse> resp;
     if (rejectResp) {
         resp = std::move(rejectResp);
@@ -512,6 +570,7 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
     }
 
+    ENGINE_ERROR_CODE ret;
     std::unique_ptr<Item> itmCpy;
     totalUncompressedDataSize.fetch_add(resp->getMessageSize());
 
@@ -534,6 +593,13 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
                 }
             }
         }
+    } else if (resp->getEvent() == DcpResponse::Event::SystemEvent) {
+        // The event's key refers to the item's value, so hand the core a
+        // copy of the item (sharing the value) to keep it alive until the
+        // message is sent; then the key needn't be copied.
+        itmCpy = std::make_unique<Item>(
+                *static_cast<SystemEventProducerMessage*>(resp.get())
+                         ->getItem());
     }
 
     EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL,
@@ -552,7 +618,8 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         {
             if (itmCpy == nullptr) {
                 throw std::logic_error(
-                    "DcpProducer::step(Mutation): itmCpy must be != nullptr");
+                    "DcpProducer::sendNextResponse(Mutation): itmCpy must be "
+                    "!= nullptr");
             }
             std::pair<const char*, uint16_t> meta{nullptr, 0};
             if (mutationResponse->getExtMetaData()) {
@@ -576,7 +643,8 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         {
             if (itmCpy == nullptr) {
                 throw std::logic_error(
-                    "DcpProducer::step(Deletion): itmCpy must be != nullptr");
+                    "DcpProducer::sendNextResponse(Deletion): itmCpy must be "
+                    "!= nullptr");
             }
             std::pair<const char*, uint16_t> meta{nullptr, 0};
             if (mutationResponse->getExtMetaData()) {
@@ -616,6 +684,7 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
             ret = producers->system_event(
                     getCookie(),
                     s->getOpaque(),
+                    itmCpy.release(),
                     s->getVBucket(),
                     s->getSystemEvent(),
                     *s->getBySeqno(),
@@ -649,6 +718,8 @@ ENGINE_ERROR_CODE DcpProducer::step(struct dcp_message_producers* producers) {
         }
 
         totalBytesSent.fetch_add(resp->getMessageSize());
+        event = resp->getEvent();
+        bytes += resp->getMessageSize();
     }
 
     lastSendTime = ep_current_time();
@@ -872,6 +943,13 @@ void DcpProducer::addStats(ADD_STAT add_stat, const void *c) {
     addStat("items_sent", getItemsSent(), add_stat, c);
     addStat("items_remaining", getItemsRemaining(), add_stat, c);
     addStat("total_bytes_sent", getTotalBytesSent(), add_stat, c);
+    add_prefixed_stat(
+            getName().c_str(), "step_batch_bytes", stepBatchBytes, add_stat, c);
+    add_prefixed_stat(getName().c_str(),
+                      "step_batch_messages",
+                      stepBatchMessages,
+                      add_stat,
+                      c);
     if (enableValueCompression) {
         addStat("total_uncompressed_data_size", getTotalUncompressedDataSize(),
                 add_stat, c);
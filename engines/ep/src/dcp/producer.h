@@ -25,9 +25,11 @@
 #include "collections/filter.h"
 #include "connhandler.h"
 #include "dcp/dcp-types.h"
+#include "dcp/response.h"
+
+#include <platform/histogram.h>
 
 class BackfillManager;
-class DcpResponse;
 
 class DcpProducer : public ConnHandler,
                     public std::enable_shared_from_this<DcpProducer> {
@@ -167,7 +169,12 @@ public:
         };
 
         BufferLog(DcpProducer& p)
-            : producer(p), maxBytes(0), bytesSent(0), ackedBytes(0) {}
+            : producer(p),
+              maxBytes(0),
+              bytesSent(0),
+              ackedBytes(0),
+              avgAckBytes(0) {
+        }
 
         void setBufferSize(size_t maxBytes);
 
@@ -197,6 +204,18 @@ public:
         */
         void unpauseIfSpaceAvailable();
 
+        /*
+            Return how many bytes the producer should send in one step,
+              given the configured maximum (maxBatch).
+
+            With flow control disabled this is maxBatch. Otherwise it is
+              limited to the space left in the consumer's buffer and to the
+              average size of the consumer's acknowledgements (how much it
+              drains per round trip); sending more than that at once only
+              queues it ahead of other connections.
+        */
+        size_t getBatchTarget(size_t maxBatch);
+
 private:
 
         bool isEnabled_UNLOCKED() {
@@ -216,6 +235,8 @@ private:
         size_t maxBytes;
         size_t bytesSent;
         size_t ackedBytes;
+        // Moving average of the bytes acknowledged by each buffer ack
+        size_t avgAckBytes;
     };
 
     /*
@@ -262,6 +283,21 @@ protected:
      */
     ENGINE_ERROR_CODE maybeSendNoop(struct dcp_message_producers* producers);
 
+    /**
+     * Send the next response (a previously rejected one, or the next from
+     * the ready streams) to the core.
+     *
+     * @param producers the core's message producers
+     * @param [out] event the event of the response, if one was sent
+     * @param [out] bytes incremented by the size of the response sent
+     * @return ENGINE_WANT_MORE if a response was sent, ENGINE_SUCCESS if
+     *         there was nothing to send, else the core's error (the
+     *         response is kept for retry on ENGINE_E2BIG)
+     */
+    ENGINE_ERROR_CODE sendNextResponse(struct dcp_message_producers* producers,
+                                       DcpResponse::Event& event,
+                                       size_t& bytes);
+
     /**
      * Create the ActiveStreamCheckpointProcessorTask and assign to
      * checkpointCreatorTask
@@ -318,6 +354,11 @@ protected:
     std::atomic<size_t> totalBytesSent;
     std::atomic<size_t> totalUncompressedDataSize;
 
+    // The bytes and number of messages handed to the core by each step()
+    Histogram<size_t> stepBatchBytes{ExponentialGenerator<size_t>(64, 2), 20};
+    Histogram<size_t> stepBatchMessages{ExponentialGenerator<size_t>(1, 2),
+                                        16};
+
     ExTask checkpointCreatorTask;
     static const std::chrono::seconds defaultDcpNoopTxInterval;
 
@@ -598,6 +598,11 @@ public:
         return item->size();
     }
 
+    /// @returns the item the event (and its key) was created from
+    const queued_item& getItem() const {
+        return item;
+    }
+
 protected:
     SystemEventProducerMessage(uint32_t opaque,
                                queued_item& itm,
@@ -22,6 +22,7 @@
 #include "dcp/backfill-manager.h"
 #include "dcp/backfill.h"
 #include "dcp/consumer.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
 #include "dcp/stream.h"
@@ -256,7 +257,9 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
       backfillRemaining(0),
       lastReadSeqnoUnSnapshotted(st_seqno),
       lastSentSeqno(st_seqno),
+      notifiedSeqno(st_seqno),
       curChkSeqno(st_seqno),
+      cursor(CursorHandle()),
       takeoverState(vbucket_state_pending),
       itemsFromMemoryPhase(0),
       firstMarkerSent(false),
@@ -391,10 +394,11 @@ void ActiveStream::registerCursor(CheckpointManager& chkptmgr,
          * on a checkpoint.
          */
         const uint64_t nextRequiredSeqno = lastProcessedSeqno + 1;
-        if (result.first > nextRequiredSeqno && result.second) {
+        if (result.seqno > nextRequiredSeqno && result.startsAtFirstItem) {
             pendingBackfill = true;
         }
-        curChkSeqno = result.first;
+        curChkSeqno = result.seqno;
+        cursor = result.cursor;
     } catch(std::exception& error) {
         log(EXTENSION_LOG_WARNING,
             "(vb %" PRIu16 ") Failed to register cursor: %s",
@@ -798,6 +802,9 @@ void ActiveStream::addStats(ADD_STAT add_stat, const void *c) {
         checked_snprintf(buffer, bsize, "%s:stream_%d_last_read_seqno",
                          name_.c_str(), vb_);
         add_casted_stat(buffer, lastReadSeqno.load(), add_stat, c);
+        checked_snprintf(buffer, bsize, "%s:stream_%d_notified_seqno",
+                         name_.c_str(), vb_);
+        add_casted_stat(buffer, notifiedSeqno.load(), add_stat, c);
         checked_snprintf(buffer, bsize, "%s:stream_%d_ready_queue_memory",
                          name_.c_str(), vb_);
         add_casted_stat(buffer, getReadyQueueMemory(), add_stat, c);
@@ -805,6 +812,9 @@ void ActiveStream::addStats(ADD_STAT add_stat, const void *c) {
                          name_.c_str(), vb_);
         add_casted_stat(buffer, itemsReady.load() ? "true" : "false", add_stat,
                         c);
+        checked_snprintf(buffer, bsize, "%s:stream_%d_memory_snapshot_bytes",
+                         name_.c_str(), vb_);
+        add_casted_stat(buffer, memorySnapshotBytes, add_stat, c);
         checked_snprintf(buffer, bsize, "%s:stream_%d_backfill_buffer_bytes",
                          name_.c_str(), vb_);
         add_casted_stat(buffer, bufferedBackfill.bytes, add_stat, c);
@@ -857,7 +867,7 @@ void ActiveStream::addTakeoverStats(ADD_STAT add_stat, const void *cookie,
 
     size_t vb_items = vb.getNumItems();
     size_t chk_items =
-            vb_items > 0 ? vb.checkpointManager->getNumItemsForCursor(name_)
+            vb_items > 0 ? vb.checkpointManager->getNumItemsForCursor(cursor)
                          : 0;
 
     size_t del_items = 0;
@@ -917,7 +927,7 @@ std::unique_ptr<DcpResponse> ActiveStream::nextQueuedItem() {
 bool ActiveStream::nextCheckpointItem() {
     VBucketPtr vbucket = engine->getVBucket(vb_);
     if (vbucket &&
-        vbucket->checkpointManager->getNumItemsForCursor(name_) > 0) {
+        vbucket->checkpointManager->getNumItemsForCursor(cursor) > 0) {
         // schedule this stream to build the next checkpoint
         auto producer = producerPtr.lock();
         if (!producer) {
@@ -1008,8 +1018,14 @@ void ActiveStream::getOutstandingItems(VBucketPtr &vb,
     // Commencing item processing - set guard flag.
     chkptItemsExtractionInProgress.store(true);
 
+    // Fetch a bounded batch; any remainder is picked up on a later
+    // nextCheckpointItemTask run as the cursor still has items to read.
+    auto& chkConfig = vb->checkpointManager->getCheckpointConfig();
     auto _begin_ = ProcessClock::now();
-    vb->checkpointManager->getAllItemsForCursor(name_, items);
+    vb->checkpointManager->getItemsForCursor(cursor,
+                                             items,
+                                             chkConfig.getCursorBatchItems(),
+                                             chkConfig.getCursorBatchBytes());
     engine->getEpStats().dcpCursorsGetItemsHisto.add(
             std::chrono::duration_cast<std::chrono::microseconds>(
                     ProcessClock::now() - _begin_));
@@ -1073,10 +1089,7 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
             finalItem->pruneValueAndOrXattrs(includeValue, includeXattributes);
 
             if (isCompressionEnabled()) {
-                if (!finalItem->compressValue()) {
-                    LOG(EXTENSION_LOG_WARNING,
-                        "Failed to snappy compress an uncompressed value");
-                }
+                compressItemValue(*item, *finalItem);
             } else {
                 if (!finalItem->decompressValue()) {
                     LOG(EXTENSION_LOG_WARNING,
@@ -1105,6 +1118,61 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
     }
 }
 
+void ActiveStream::compressItemValue(const Item& item, Item& finalItem) {
+    auto& stats = engine->getEpStats();
+    const size_t uncompressedSize = finalItem.getNBytes();
+    if (mcbp::datatype::is_snappy(finalItem.getDataType()) ||
+        uncompressedSize == 0) {
+        return;
+    }
+
+    // If pruning left the value as it is in the checkpoint, use (or make)
+    // the copy compressed once for all streams.
+    const bool useCache =
+            finalItem.getValue().get() == item.getValue().get() &&
+            engine->getDcpConnMap().isCompressionCacheEnabled();
+
+    const auto start = ProcessClock::now();
+    bool compressedNow = true;
+    bool compressed;
+    if (useCache) {
+        auto value = item.getCompressedValue(compressedNow);
+        compressed = bool(value);
+        if (compressed) {
+            finalItem.setValue(value);
+            finalItem.setDataType(finalItem.getDataType() |
+                                  PROTOCOL_BINARY_DATATYPE_SNAPPY);
+        }
+    } else {
+        if (!finalItem.compressValue()) {
+            LOG(EXTENSION_LOG_WARNING,
+                "Failed to snappy compress an uncompressed value");
+        }
+        compressed = mcbp::datatype::is_snappy(finalItem.getDataType());
+    }
+
+    if (compressedNow) {
+        stats.dcpValuesCompressed++;
+        stats.dcpCompressionTime.fetch_add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        ProcessClock::now() - start)
+                        .count());
+    } else {
+        stats.dcpCompressionCacheHits++;
+    }
+    if (compressed) {
+        stats.dcpCompressionBytesSaved.fetch_add(uncompressedSize -
+                                                 finalItem.getNBytes());
+    }
+}
+
+void ActiveStream::chargeCompressedValues(int64_t seqno, size_t bytes) {
+    VBucketPtr vb = engine->getVBucket(vb_);
+    if (vb) {
+        vb->checkpointManager->chargeItemMemory(seqno, bytes);
+    }
+}
+
 void ActiveStream::processItems(std::vector<queued_item>& items) {
     if (!items.empty()) {
         bool mark = false;
@@ -1112,6 +1180,12 @@ void ActiveStream::processItems(std::vector<queued_item>& items) {
             mark = true;
         }
 
+        // Compressed copies of values made for these items are charged to
+        // their checkpoint once per checkpoint, rather than taking the
+        // checkpoint lock for every item.
+        size_t compressedBytes = 0;
+        int64_t compressedSeqno = 0;
+
         std::deque<std::unique_ptr<DcpResponse>> mutations;
         for (auto& qi : items) {
             if (SystemEventReplicate::process(*qi) == ProcessStatus::Continue) {
@@ -1119,8 +1193,17 @@ void ActiveStream::processItems(std::vector<queued_item>& items) {
                 lastReadSeqnoUnSnapshotted = qi->getBySeqno();
                 if (filter.allow(*qi)) {
                     mutations.push_back(makeResponseFromItem(qi));
+                    const size_t bytes = qi->claimCompressedValueMemSize();
+                    if (bytes) {
+                        compressedBytes += bytes;
+                        compressedSeqno = qi->getBySeqno();
+                    }
                 }
             } else if (qi->getOperation() == queue_op::checkpoint_start) {
+                if (compressedBytes) {
+                    chargeCompressedValues(compressedSeqno, compressedBytes);
+                    compressedBytes = 0;
+                }
                 /* if there are already other mutations, then they belong to the
                    previous checkpoint and hence we must create a snapshot and
                    put them onto readyQ */
@@ -1135,6 +1218,10 @@ void ActiveStream::processItems(std::vector<queued_item>& items) {
             }
         }
 
+        if (compressedBytes) {
+            chargeCompressedValues(compressedSeqno, compressedBytes);
+        }
+
         if (mutations.empty()) {
             // If we only got checkpoint start or ends check to see if there are
             // any more snapshots before pausing the stream.
@@ -1171,6 +1258,12 @@ void ActiveStream::snapshot(std::deque<std::unique_ptr<DcpResponse>>& items,
     /* This assumes that all items in the "items deque" is put onto readyQ */
     lastReadSeqno.store(lastReadSeqnoUnSnapshotted);
 
+    size_t snapshotBytes = 0;
+    for (const auto& item : items) {
+        snapshotBytes += item->getMessageSize();
+    }
+    memorySnapshotBytes.add(snapshotBytes);
+
     if (isCurrentSnapshotCompleted()) {
         uint32_t flags = MARKER_FLAG_MEMORY;
 
@@ -1228,7 +1321,12 @@ uint32_t ActiveStream::setDead(end_stream_status_t status) {
 
 void ActiveStream::notifySeqnoAvailable(uint64_t seqno) {
     if (isActive()) {
-        notifyStreamReady();
+        atomic_setIfBigger(notifiedSeqno, seqno);
+        // While items are ready the producer will step this stream again
+        // anyway, so skip taking a reference on it to notify it.
+        if (!itemsReady.load()) {
+            notifyStreamReady();
+        }
     }
 }
 
@@ -1339,11 +1437,14 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
         tryBackfill = true;
     } else {
         try {
-            std::tie(curChkSeqno, tryBackfill) =
+            CursorRegResult result =
                     vbucket->checkpointManager->registerCursorBySeqno(
                             name_,
                             lastReadSeqno.load(),
                             MustSendCheckpointEnd::NO);
+            curChkSeqno = result.seqno;
+            tryBackfill = result.startsAtFirstItem;
+            cursor = result.cursor;
         } catch(std::exception& error) {
             log(EXTENSION_LOG_WARNING,
                 "(vb %" PRIu16
@@ -1447,7 +1548,8 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
                                 lastReadSeqno.load(),
                                 MustSendCheckpointEnd::NO);
 
-                curChkSeqno = result.first;
+                curChkSeqno = result.seqno;
+                cursor = result.cursor;
             } catch (std::exception& error) {
                 log(EXTENSION_LOG_WARNING,
                     "(vb %" PRIu16
@@ -1666,7 +1768,7 @@ size_t ActiveStream::getItemsRemaining() {
     // Items remaining is the sum of:
     // (a) Items outstanding in checkpoints
     // (b) Items pending in our readyQ, excluding any meta items.
-    return vbucket->checkpointManager->getNumItemsForCursor(name_) +
+    return vbucket->checkpointManager->getNumItemsForCursor(cursor) +
            readyQ_non_meta_items;
 }
 
@@ -1678,6 +1780,10 @@ uint64_t ActiveStream::getLastSentSeqno() const {
     return lastSentSeqno.load();
 }
 
+uint64_t ActiveStream::getNotifiedSeqno() const {
+    return notifiedSeqno.load();
+}
+
 void ActiveStream::log(EXTENSION_LOG_LEVEL severity,
                        const char* fmt,
                        ...) const {
@@ -1715,7 +1821,7 @@ bool ActiveStream::dropCheckpointCursor_UNLOCKED() {
         notifyStreamReady();
     }
     /* Drop the existing cursor */
-    return vbucket->checkpointManager->removeCursor(name_);
+    return vbucket->checkpointManager->removeCursor(cursor);
 }
 
 EXTENSION_LOG_LEVEL ActiveStream::getTransitionStateLogLevel(
@@ -1757,7 +1863,7 @@ void ActiveStream::notifyStreamReady(bool force) {
 void ActiveStream::removeCheckpointCursor() {
     VBucketPtr vb = engine->getVBucket(vb_);
     if (vb) {
-        vb->checkpointManager->removeCursor(name_);
+        vb->checkpointManager->removeCursor(cursor);
     }
 }
 
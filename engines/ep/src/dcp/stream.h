@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include "checkpoint.h"
 #include "collections/vbucket_filter.h"
 #include "dcp/dcp-types.h"
 #include "dcp/producer.h"
@@ -278,6 +279,8 @@ public:
 
     uint64_t getLastSentSeqno() const;
 
+    uint64_t getNotifiedSeqno() const;
+
     void log(EXTENSION_LOG_LEVEL severity, const char* fmt, ...) const override;
 
     // Runs on ActiveStreamCheckpointProcessorTask
@@ -322,6 +325,20 @@ protected:
      */
     std::unique_ptr<DcpResponse> makeResponseFromItem(queued_item& item);
 
+    /**
+     * Snappy compress the value of finalItem, a copy of the checkpoint item
+     * `item` which may have had its value pruned, and account for it in the
+     * DCP compression stats.
+     */
+    void compressItemValue(const Item& item, Item& finalItem);
+
+    /**
+     * Charge the memory of compressed values made for checkpoint items (see
+     * Item::claimCompressedValueMemSize()) to the checkpoint holding the
+     * item with the given seqno.
+     */
+    void chargeCompressedValues(int64_t seqno, size_t bytes);
+
     /* The transitionState function is protected (as opposed to private) for
      * testing purposes.
      */
@@ -453,15 +470,25 @@ private:
     //! The last sequence number sent to the network layer
     std::atomic<uint64_t> lastSentSeqno;
 
+    //! The highest seqno the vBucket has notified this stream of
+    std::atomic<uint64_t> notifiedSeqno;
+
     //! The last known seqno pointed to by the checkpoint cursor
     std::atomic<uint64_t> curChkSeqno;
 
+    //! Handle of the checkpoint cursor, set when the cursor is registered
+    std::atomic<CursorHandle> cursor;
+
     //! The current vbucket state to send in the takeover stream
     vbucket_state_t takeoverState;
 
     //! The amount of items that have been sent during the memory phase
     std::atomic<size_t> itemsFromMemoryPhase;
 
+    //! The size in bytes of each snapshot queued during the memory phase
+    Histogram<size_t> memorySnapshotBytes{ExponentialGenerator<size_t>(64, 2),
+                                          20};
+
     //! Whether or not this is the first snapshot marker sent
     bool firstMarkerSent;
 
@@ -221,217 +221,335 @@ int EPBucket::flushVBucket(uint16_t vbid) {
         }
     }
 
-    int items_flushed = 0;
-    const auto flush_start = ProcessClock::now();
-
     auto vb = getLockedVBucket(vbid, std::try_to_lock);
     if (!vb.owns_lock()) { // Try another bucket if this one is locked
         return RETRY_FLUSH_VBUCKET; // to avoid blocking flusher
     }
-    if (vb) {
-        std::vector<queued_item> items;
-        KVStore *rwUnderlying = getRWUnderlying(vbid);
-
-        while (!vb->rejectQueue.empty()) {
-            items.push_back(vb->rejectQueue.front());
-            vb->rejectQueue.pop();
-        }
-
-        // Append any 'backfill' items (mutations added by a DCP stream).
-        vb->getBackfillItems(items);
-
-        // Append all items outstanding for the persistence cursor.
-        snapshot_range_t range;
-        auto _begin_ = ProcessClock::now();
-        range = vb->checkpointManager->getAllItemsForCursor(
-                CheckpointManager::pCursorName, items);
-        stats.persistenceCursorGetItemsHisto.add(
-                std::chrono::duration_cast<std::chrono::microseconds>(
-                        ProcessClock::now() - _begin_));
-
-        if (!items.empty()) {
-            while (!rwUnderlying->begin(
-                    std::make_unique<EPTransactionContext>(stats, *vb))) {
-                ++stats.beginFailed;
-                LOG(EXTENSION_LOG_WARNING, "Failed to start a transaction!!! "
-                    "Retry in 1 sec ...");
-                sleep(1);
+    if (!vb) {
+        return 0;
+    }
+
+    FlushBatch batch(std::move(vb));
+    if (writeFlushBatch(batch, false) == RETRY_FLUSH_VBUCKET) {
+        return RETRY_FLUSH_VBUCKET;
+    }
+    return completeFlush(batch);
+}
+
+int EPBucket::flushVBuckets(std::vector<uint16_t>& vbids,
+                            std::chrono::microseconds maxDelay) {
+    std::vector<uint16_t> retry;
+    if (diskDeleteAll) {
+        // Leave flushVBucket to coordinate the delete-all.
+        int items_flushed = 0;
+        for (auto vbid : vbids) {
+            const int rv = flushVBucket(vbid);
+            if (rv == RETRY_FLUSH_VBUCKET) {
+                retry.push_back(vbid);
+            } else {
+                items_flushed += rv;
             }
-            rwUnderlying->optimizeWrites(items);
+        }
+        vbids.swap(retry);
+        return items_flushed;
+    }
 
-            Item *prev = NULL;
-            auto vbstate = vb->getVBucketState();
-            uint64_t maxSeqno = 0;
-            range.start = std::max(range.start, vbstate.lastSnapStart);
+    // Write each vBucket's batch, holding the vBuckets locked until their
+    // flush completes (other than while commitGroup() waits for the
+    // group's sync).
+    std::vector<FlushBatch> batches;
+    ProcessClock::time_point groupStart;
+    size_t next = 0;
+    for (; next < vbids.size(); ++next) {
+        if (!batches.empty() &&
+            ProcessClock::now() - groupStart >= maxDelay) {
+            break;
+        }
+        const uint16_t vbid = vbids[next];
+        auto vb = getLockedVBucket(vbid, std::try_to_lock);
+        if (!vb.owns_lock()) {
+            retry.push_back(vbid);
+            continue;
+        }
+        if (!vb) {
+            continue;
+        }
+        FlushBatch batch(std::move(vb));
+        if (writeFlushBatch(batch, true) == RETRY_FLUSH_VBUCKET) {
+            retry.push_back(vbid);
+            continue;
+        }
+        if (batches.empty()) {
+            groupStart = ProcessClock::now();
+        }
+        batches.push_back(std::move(batch));
+    }
+    // vBuckets not reached within maxDelay are flushed by a later group.
+    retry.insert(retry.end(), vbids.begin() + next, vbids.end());
 
-            bool mustCheckpointVBState = false;
-            auto& pcbs = rwUnderlying->getPersistenceCbList();
+    if (!batches.empty()) {
+        commitGroup(batches);
+    }
 
-            SystemEventFlush sef;
+    int items_flushed = 0;
+    for (auto& batch : batches) {
+        const uint16_t vbid = batch.vb->getId();
+        const int rv = completeFlush(batch);
+        batch.vb->setGroupSyncPending(false);
+        if (rv == RETRY_FLUSH_VBUCKET) {
+            retry.push_back(vbid);
+        } else {
+            items_flushed += rv;
+        }
+    }
 
-            for (const auto& item : items) {
+    vbids.swap(retry);
+    return items_flushed;
+}
 
-                if (!item->shouldPersist()) {
-                    continue;
-                }
+int EPBucket::writeFlushBatch(FlushBatch& batch, bool groupCommit) {
+    auto& vb = batch.vb;
+    const uint16_t vbid = vb->getId();
+    int items_flushed = 0;
 
-                // Pass the Item through the SystemEventFlush which may filter
-                // the item away (return Skip).
-                if (sef.process(item) == ProcessStatus::Skip) {
-                    // The item has no further flushing actions i.e. we've
-                    // absorbed it in the process function.
-                    // Update stats and carry-on
-                    --stats.diskQueueSize;
-                    vb->doStatsForFlushing(*item, item->size());
-                    continue;
-                }
+    std::vector<queued_item> items;
+    KVStore *rwUnderlying = getRWUnderlying(vbid);
+    batch.rwUnderlying = rwUnderlying;
 
-                if (item->getOperation() == queue_op::set_vbucket_state) {
-                    // No actual item explicitly persisted to (this op exists
-                    // to ensure a commit occurs with the current vbstate);
-                    // flag that we must trigger a snapshot even if there are
-                    // no 'real' items in the checkpoint.
-                    mustCheckpointVBState = true;
-
-                    // Update queuing stats how this item has logically been
-                    // processed.
-                    --stats.diskQueueSize;
-                    vb->doStatsForFlushing(*item, item->size());
-
-                } else if (!prev || prev->getKey() != item->getKey()) {
-                    prev = item.get();
-                    ++items_flushed;
-                    auto cb = flushOneDelOrSet(item, vb.getVB());
-                    if (cb) {
-                        pcbs.emplace_back(std::move(cb));
-                    }
+    while (!vb->rejectQueue.empty()) {
+        items.push_back(vb->rejectQueue.front());
+        vb->rejectQueue.pop();
+    }
 
-                    maxSeqno = std::max(maxSeqno, (uint64_t)item->getBySeqno());
-                    vbstate.maxCas = std::max(vbstate.maxCas, item->getCas());
-                    if (item->isDeleted()) {
-                        vbstate.maxDeletedSeqno =
-                                std::max(vbstate.maxDeletedSeqno,
-                                         item->getRevSeqno());
-                    }
-                    ++stats.flusher_todo;
+    // Append any 'backfill' items (mutations added by a DCP stream).
+    vb->getBackfillItems(items);
+
+    // Append the next batch of items outstanding for the persistence
+    // cursor.
+    auto& chkConfig = vb->checkpointManager->getCheckpointConfig();
+    auto _begin_ = ProcessClock::now();
+    auto toFlush = vb->checkpointManager->getItemsForCursor(
+            vb->checkpointManager->getPersistenceCursor(),
+            items,
+            chkConfig.getCursorBatchItems(),
+            chkConfig.getCursorBatchBytes());
+    snapshot_range_t range = toFlush.range;
+    batch.moreAvailable = toFlush.moreAvailable;
+    stats.persistenceCursorGetItemsHisto.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    ProcessClock::now() - _begin_));
+
+    if (!items.empty()) {
+        batch.nonEmpty = true;
+        while (!rwUnderlying->begin(
+                std::make_unique<EPTransactionContext>(stats, *vb))) {
+            ++stats.beginFailed;
+            LOG(EXTENSION_LOG_WARNING, "Failed to start a transaction!!! "
+                "Retry in 1 sec ...");
+            sleep(1);
+        }
+        rwUnderlying->optimizeWrites(items);
 
-                } else {
-                    // Item is the same key as the previous[1] one - don't need
-                    // to flush to disk.
-                    // [1] Previous here really means 'next' - optimizeWrites()
-                    //     above has actually re-ordered items such that items
-                    //     with the same key are ordered from high->low seqno.
-                    //     This means we only write the highest (i.e. newest)
-                    //     item for a given key, and discard any duplicate,
-                    //     older items.
-                    --stats.diskQueueSize;
-                    vb->doStatsForFlushing(*item, item->size());
-                }
+        Item *prev = NULL;
+        auto vbstate = vb->getVBucketState();
+        uint64_t maxSeqno = 0;
+        range.start = std::max(range.start, vbstate.lastSnapStart);
+
+        bool mustCheckpointVBState = false;
+        auto& pcbs = rwUnderlying->getPersistenceCbList();
+
+        SystemEventFlush sef;
+
+        for (const auto& item : items) {
+
+            if (!item->shouldPersist()) {
+                continue;
             }
 
+            // Pass the Item through the SystemEventFlush which may filter
+            // the item away (return Skip).
+            if (sef.process(item) == ProcessStatus::Skip) {
+                // The item has no further flushing actions i.e. we've
+                // absorbed it in the process function.
+                // Update stats and carry-on
+                --stats.diskQueueSize;
+                vb->doStatsForFlushing(*item,
+                                       item->sizeWithoutCompressedValue());
+                continue;
+            }
 
-            {
-                ReaderLockHolder rlh(vb->getStateLock());
-                if (vb->getState() == vbucket_state_active) {
-                    if (maxSeqno) {
-                        range.start = maxSeqno;
-                        range.end = maxSeqno;
-                    }
+            if (item->getOperation() == queue_op::set_vbucket_state) {
+                // No actual item explicitly persisted to (this op exists
+                // to ensure a commit occurs with the current vbstate);
+                // flag that we must trigger a snapshot even if there are
+                // no 'real' items in the checkpoint.
+                mustCheckpointVBState = true;
+
+                // Update queuing stats how this item has logically been
+                // processed.
+                --stats.diskQueueSize;
+                vb->doStatsForFlushing(*item,
+                                       item->sizeWithoutCompressedValue());
+
+            } else if (!prev || prev->getKey() != item->getKey()) {
+                prev = item.get();
+                ++items_flushed;
+                auto cb = flushOneDelOrSet(item, vb.getVB());
+                if (cb) {
+                    pcbs.emplace_back(std::move(cb));
                 }
 
-                // Update VBstate based on the changes we have just made,
-                // then tell the rwUnderlying the 'new' state
-                // (which will persisted as part of the commit() below).
-                vbstate.lastSnapStart = range.start;
-                vbstate.lastSnapEnd = range.end;
-
-                // Track the lowest seqno written in spock and record it as
-                // the HLC epoch, a seqno which we can be sure the value has a
-                // HLC CAS.
-                vbstate.hlcCasEpochSeqno = vb->getHLCEpochSeqno();
-                if (vbstate.hlcCasEpochSeqno == HlcCasSeqnoUninitialised) {
-                    vbstate.hlcCasEpochSeqno = range.start;
-                    vb->setHLCEpochSeqno(range.start);
+                maxSeqno = std::max(maxSeqno, (uint64_t)item->getBySeqno());
+                vbstate.maxCas = std::max(vbstate.maxCas, item->getCas());
+                if (item->isDeleted()) {
+                    vbstate.maxDeletedSeqno =
+                            std::max(vbstate.maxDeletedSeqno,
+                                     item->getRevSeqno());
                 }
+                ++stats.flusher_todo;
 
-                // Track if the VB has xattrs present
-                vbstate.mightContainXattrs = vb->mightContainXattrs();
+            } else {
+                // Item is the same key as the previous[1] one - don't need
+                // to flush to disk.
+                // [1] Previous here really means 'next' - optimizeWrites()
+                //     above has actually re-ordered items such that items
+                //     with the same key are ordered from high->low seqno.
+                //     This means we only write the highest (i.e. newest)
+                //     item for a given key, and discard any duplicate,
+                //     older items.
+                --stats.diskQueueSize;
+                vb->doStatsForFlushing(*item,
+                                       item->sizeWithoutCompressedValue());
+            }
+        }
 
-                // Do we need to trigger a persist of the state?
-                // If there are no "real" items to flush, and we encountered
-                // a set_vbucket_state meta-item.
-                auto options = VBStatePersist::VBSTATE_CACHE_UPDATE_ONLY;
-                if ((items_flushed == 0) && mustCheckpointVBState) {
-                    options = VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT;
-                }
 
-                if (rwUnderlying->snapshotVBucket(vb->getId(), vbstate,
-                                                  options) != true) {
-                    return RETRY_FLUSH_VBUCKET;
+        {
+            ReaderLockHolder rlh(vb->getStateLock());
+            if (vb->getState() == vbucket_state_active) {
+                if (maxSeqno) {
+                    range.start = maxSeqno;
+                    range.end = maxSeqno;
                 }
+            }
 
-                if (vb->setBucketCreation(false)) {
-                    LOG(EXTENSION_LOG_INFO, "VBucket %" PRIu16 " created", vbid);
-                }
+            // Update VBstate based on the changes we have just made,
+            // then tell the rwUnderlying the 'new' state
+            // (which will persisted as part of the commit() below).
+            vbstate.lastSnapStart = range.start;
+            vbstate.lastSnapEnd = range.end;
+
+            // Track the lowest seqno written in spock and record it as
+            // the HLC epoch, a seqno which we can be sure the value has a
+            // HLC CAS.
+            vbstate.hlcCasEpochSeqno = vb->getHLCEpochSeqno();
+            if (vbstate.hlcCasEpochSeqno == HlcCasSeqnoUninitialised) {
+                vbstate.hlcCasEpochSeqno = range.start;
+                vb->setHLCEpochSeqno(range.start);
             }
 
-            /* Perform an explicit commit to disk if the commit
-             * interval reaches zero and if there is a non-zero number
-             * of items to flush.
-             * Or if there is a manifest item
-             */
-            if (items_flushed > 0 || sef.getCollectionsManifestItem()) {
-                commit(*rwUnderlying, sef.getCollectionsManifestItem());
+            // Track if the VB has xattrs present
+            vbstate.mightContainXattrs = vb->mightContainXattrs();
 
-                // Now the commit is complete, vBucket file must exist.
-                if (vb->setBucketCreation(false)) {
-                    LOG(EXTENSION_LOG_INFO, "VBucket %" PRIu16 " created", vbid);
-                }
+            // Do we need to trigger a persist of the state?
+            // If there are no "real" items to flush, and we encountered
+            // a set_vbucket_state meta-item.
+            auto options = VBStatePersist::VBSTATE_CACHE_UPDATE_ONLY;
+            if ((items_flushed == 0) && mustCheckpointVBState) {
+                options = VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT;
             }
 
-            if (vb->rejectQueue.empty()) {
-                vb->setPersistedSnapshot(range.start, range.end);
-                uint64_t highSeqno = rwUnderlying->getLastPersistedSeqno(vbid);
-                if (highSeqno > 0 && highSeqno != vb->getPersistenceSeqno()) {
-                    vb->setPersistenceSeqno(highSeqno);
-                }
+            if (rwUnderlying->snapshotVBucket(vb->getId(), vbstate,
+                                              options) != true) {
+                return RETRY_FLUSH_VBUCKET;
             }
 
-            auto flush_end = ProcessClock::now();
-            uint64_t trans_time =
-                    std::chrono::duration_cast<std::chrono::milliseconds>(
-                            flush_end - flush_start)
-                            .count();
+            if (vb->setBucketCreation(false)) {
+                LOG(EXTENSION_LOG_INFO, "VBucket %" PRIu16 " created", vbid);
+            }
+        }
 
-            lastTransTimePerItem.store((items_flushed == 0) ? 0 :
-                                       static_cast<double>(trans_time) /
-                                       static_cast<double>(items_flushed));
-            stats.cumulativeFlushTime.fetch_add(trans_time);
-            stats.flusher_todo.store(0);
-            stats.totalPersistVBState++;
+        /* Perform an explicit commit to disk if the commit
+         * interval reaches zero and if there is a non-zero number
+         * of items to flush.
+         * Or if there is a manifest item
+         */
+        if (items_flushed > 0 || sef.getCollectionsManifestItem()) {
+            if (groupCommit) {
+                // Made durable by commitGroup() along with the other
+                // vBuckets in the group.
+                prepareCommit(*rwUnderlying, sef.getCollectionsManifestItem());
+            } else {
+                commit(*rwUnderlying, sef.getCollectionsManifestItem());
+            }
+            batch.committed = true;
         }
+    }
+
+    batch.range = range;
+    batch.itemsFlushed = items_flushed;
+    return items_flushed;
+}
 
-        rwUnderlying->pendingTasks();
+int EPBucket::completeFlush(FlushBatch& batch) {
+    auto& vb = batch.vb;
+    const uint16_t vbid = vb->getId();
+    KVStore* rwUnderlying = batch.rwUnderlying;
+    const int items_flushed = batch.itemsFlushed;
 
-        if (vb->checkpointManager->getNumCheckpoints() > 1) {
-            wakeUpCheckpointRemover();
+    if (batch.nonEmpty) {
+        // Now the commit is complete, vBucket file must exist.
+        if (batch.committed && vb->setBucketCreation(false)) {
+            LOG(EXTENSION_LOG_INFO, "VBucket %" PRIu16 " created", vbid);
         }
 
         if (vb->rejectQueue.empty()) {
-            vb->checkpointManager->itemsPersisted();
-            uint64_t seqno = vb->getPersistenceSeqno();
-            uint64_t chkid =
-                    vb->checkpointManager->getPersistenceCursorPreChkId();
-            vb->notifyHighPriorityRequests(
-                    engine, seqno, HighPriorityVBNotify::Seqno);
-            vb->notifyHighPriorityRequests(
-                    engine, chkid, HighPriorityVBNotify::ChkPersistence);
-            if (chkid > 0 && chkid != vb->getPersistenceCheckpointId()) {
-                vb->setPersistenceCheckpointId(chkid);
+            vb->setPersistedSnapshot(batch.range.start, batch.range.end);
+            uint64_t highSeqno = rwUnderlying->getLastPersistedSeqno(vbid);
+            if (highSeqno > 0 && highSeqno != vb->getPersistenceSeqno()) {
+                vb->setPersistenceSeqno(highSeqno);
             }
-        } else {
-            return RETRY_FLUSH_VBUCKET;
         }
+
+        auto flush_end = ProcessClock::now();
+        uint64_t trans_time =
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                        flush_end - batch.start)
+                        .count();
+
+        lastTransTimePerItem.store((items_flushed == 0) ? 0 :
+                                   static_cast<double>(trans_time) /
+                                   static_cast<double>(items_flushed));
+        stats.cumulativeFlushTime.fetch_add(trans_time);
+        stats.flusher_todo.store(0);
+        stats.totalPersistVBState++;
+    }
+
+    rwUnderlying->pendingTasks();
+
+    if (vb->checkpointManager->getNumCheckpoints() > 1) {
+        wakeUpCheckpointRemover();
+    }
+
+    if (vb->rejectQueue.empty()) {
+        vb->checkpointManager->itemsPersisted();
+        uint64_t seqno = vb->getPersistenceSeqno();
+        uint64_t chkid =
+                vb->checkpointManager->getPersistenceCursorPreChkId();
+        vb->notifyHighPriorityRequests(
+                engine, seqno, HighPriorityVBNotify::Seqno);
+        vb->notifyHighPriorityRequests(
+                engine, chkid, HighPriorityVBNotify::ChkPersistence);
+        if (chkid > 0 && chkid != vb->getPersistenceCheckpointId()) {
+            vb->setPersistenceCheckpointId(chkid);
+        }
+        if (batch.moreAvailable) {
+            // The batch limit was hit; get the vBucket scheduled for
+            // flushing again to pick up the remaining items.
+            vb->checkpointManager->notifyFlusher();
+        }
+    } else {
+        return RETRY_FLUSH_VBUCKET;
     }
 
     return items_flushed;
@@ -461,6 +579,52 @@ void EPBucket::commit(KVStore& kvstore, const Item* collectionsManifest) {
     stats.cumulativeCommitTime.fetch_add(commit_time);
 }
 
+void EPBucket::prepareCommit(KVStore& kvstore,
+                             const Item* collectionsManifest) {
+    while (!kvstore.prepareCommit(collectionsManifest)) {
+        ++stats.commitFailed;
+        LOG(EXTENSION_LOG_WARNING,
+            "KVBucket::prepareCommit: kvstore.prepareCommit failed!!! "
+            "Retry in 1 sec...");
+        sleep(1);
+    }
+}
+
+void EPBucket::commitGroup(std::vector<FlushBatch>& batches) {
+    auto& kvstore = *batches.front().rwUnderlying;
+    auto& pcbs = kvstore.getPersistenceCbList();
+    BlockTimer timer(&stats.diskCommitHisto, "disk_commit", stats.timingLog);
+    auto commit_start = ProcessClock::now();
+
+    kvstore.commitGroup();
+
+    // Don't hold the vBuckets locked while waiting for the commits to be
+    // durable. Until their flushes complete they're marked so that nothing
+    // which rewrites their files (compaction, rollback) runs meanwhile.
+    for (auto& batch : batches) {
+        batch.vb->setGroupSyncPending(true);
+        batch.vb.getLock().unlock();
+    }
+    kvstore.syncGroup();
+    for (auto& batch : batches) {
+        batch.vb.getLock().lock();
+    }
+
+    kvstore.completeGroup();
+
+    // The persistence callbacks of every vBucket in the group have now run.
+    pcbs.clear();
+    pcbs.shrink_to_fit();
+
+    ++stats.flusherCommits;
+    auto commit_end = ProcessClock::now();
+    auto commit_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               commit_end - commit_start)
+                               .count();
+    stats.commit_time.store(commit_time);
+    stats.cumulativeCommitTime.fetch_add(commit_time);
+}
+
 void EPBucket::startFlusher() {
     for (const auto& shard : vbMap.shards) {
         shard->getFlusher()->start();
@@ -707,8 +871,9 @@ bool EPBucket::doCompact(compaction_ctx* ctx, const void* cookie) {
      */
     if (concWriteCompact == false) {
         auto vb = getLockedVBucket(vbid, std::try_to_lock);
-        if (!vb.owns_lock()) {
-            // VB currently locked; try again later.
+        if (!vb.owns_lock() || (vb && vb->isGroupSyncPending())) {
+            // VB currently locked (or its flush is still completing); try
+            // again later.
             return true;
         }
 
@@ -964,8 +1129,8 @@ RollbackResult EPBucket::doRollback(uint16_t vbid, uint64_t rollbackSeqno) {
 
 void EPBucket::rollbackUnpersistedItems(VBucket& vb, int64_t rollbackSeqno) {
     std::vector<queued_item> items;
-    vb.checkpointManager->getAllItemsForCursor(CheckpointManager::pCursorName,
-                                               items);
+    vb.checkpointManager->getAllItemsForCursor(
+            vb.checkpointManager->getPersistenceCursor(), items);
     for (const auto& item : items) {
         if (item->getBySeqno() > rollbackSeqno &&
             !item->isCheckPointMetaItem()) {
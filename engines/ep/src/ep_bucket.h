@@ -45,6 +45,27 @@ public:
      */
     int flushVBucket(uint16_t vbid);
 
+    /**
+     * Flushes the items waiting for persistence in a group of vbuckets
+     * (which must all belong to the same shard), committing them together.
+     *
+     * Each vbucket's batch is written to disk in turn, then all of them are
+     * committed back to back; persistence callbacks run only once every
+     * vbucket in the group is durable. A vbucket whose commit fails has its
+     * items re-queued and is returned for retry, without affecting the
+     * others in the group.
+     *
+     * @param vbids The vbuckets to flush. On return, holds those which
+     *        should be retried: vbuckets which were locked, failed to flush,
+     *        or were not reached within maxDelay.
+     * @param maxDelay Stop adding vbuckets to the group once this long has
+     *        passed since the first batch was written, bounding how long the
+     *        earliest batch waits to be committed.
+     * @return The number of items flushed
+     */
+    int flushVBuckets(std::vector<uint16_t>& vbids,
+                      std::chrono::microseconds maxDelay);
+
     void commit(KVStore& kvstore, const Item* collectionsManifest);
 
     /// Start the Flusher for all shards in this bucket.
@@ -133,6 +154,55 @@ public:
     }
 
 protected:
+    /// State of one vbucket's flush between writing and completing it.
+    struct FlushBatch {
+        explicit FlushBatch(LockedVBucketPtr&& vb) : vb(std::move(vb)) {
+        }
+
+        LockedVBucketPtr vb;
+        KVStore* rwUnderlying = nullptr;
+        ProcessClock::time_point start = ProcessClock::now();
+        snapshot_range_t range{0, 0};
+        int itemsFlushed = 0;
+        /// More items remain for the persistence cursor.
+        bool moreAvailable = false;
+        /// Items were taken for flushing (even if none were written).
+        bool nonEmpty = false;
+        /// A commit was issued (or prepared) for the batch.
+        bool committed = false;
+    };
+
+    /**
+     * Write the next batch of items for the vbucket to disk and commit it -
+     * or, if groupCommit is set, prepare the commit for a subsequent
+     * commitGroup().
+     *
+     * @return The number of items written, or RETRY_FLUSH_VBUCKET if the
+     *         vbucket state could not be snapshotted.
+     */
+    int writeFlushBatch(FlushBatch& batch, bool groupCommit);
+
+    /**
+     * Update the vbucket's persisted snapshot, notify waiters and update
+     * stats once the batch is committed.
+     *
+     * @return The number of items flushed, or RETRY_FLUSH_VBUCKET if any
+     *         items were rejected.
+     */
+    int completeFlush(FlushBatch& batch);
+
+    /// As commit(), but only prepare the commit; see KVStore::prepareCommit.
+    void prepareCommit(KVStore& kvstore, const Item* collectionsManifest);
+
+    /**
+     * Commit the prepared commits of the batches (all of one KVStore)
+     * together. The batches' vBuckets are unlocked while the commits are
+     * made durable, then locked again to run their persistence callbacks;
+     * the caller clears their group sync pending flag once it has
+     * completed their flushes.
+     */
+    void commitGroup(std::vector<FlushBatch>& batches);
+
     void flushOneDeleteAll();
 
     std::unique_ptr<PersistenceCallback> flushOneDelOrSet(const queued_item& qi,
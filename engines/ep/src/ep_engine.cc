@@ -55,6 +55,7 @@
 #include <platform/platform.h>
 #include <platform/processclock.h>
 #include <tracing/trace_helpers.h>
+#include <utilities/json_validator.h>
 #include <xattr/utils.h>
 
 #include <cstdio>
@@ -400,7 +401,11 @@ protocol_binary_response_status EventuallyPersistentEngine::setCheckpointParam(
     protocol_binary_response_status rv = PROTOCOL_BINARY_RESPONSE_SUCCESS;
 
     try {
-        if (strcmp(keyz, "chk_max_items") == 0) {
+        if (strcmp(keyz, "chk_cursor_batch_bytes") == 0) {
+            getConfiguration().setChkCursorBatchBytes(std::stoull(valz));
+        } else if (strcmp(keyz, "chk_cursor_batch_items") == 0) {
+            getConfiguration().setChkCursorBatchItems(std::stoull(valz));
+        } else if (strcmp(keyz, "chk_max_items") == 0) {
             size_t v = std::stoull(valz);
             validate(v, size_t(MIN_CHECKPOINT_ITEMS),
                      size_t(MAX_CHECKPOINT_ITEMS));
@@ -519,6 +524,14 @@ protocol_binary_response_status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setAlogTaskTime(std::stoull(valz));
         } else if (strcmp(keyz, "pager_active_vb_pcnt") == 0) {
             getConfiguration().setPagerActiveVbPcnt(std::stoull(valz));
+        } else if (strcmp(keyz, "pager_concurrent_visitors") == 0) {
+            getConfiguration().setPagerConcurrentVisitors(std::stoull(valz));
+        } else if (strcmp(keyz, "flusher_group_commit_vbuckets") == 0) {
+            getConfiguration().setFlusherGroupCommitVbuckets(
+                    std::stoull(valz));
+        } else if (strcmp(keyz, "flusher_group_commit_max_delay_ms") == 0) {
+            getConfiguration().setFlusherGroupCommitMaxDelayMs(
+                    std::stoull(valz));
         } else if (strcmp(keyz, "warmup_min_memory_threshold") == 0) {
             getConfiguration().setWarmupMinMemoryThreshold(std::stoull(valz));
         } else if (strcmp(keyz, "warmup_min_items_threshold") == 0) {
@@ -561,10 +574,24 @@ protocol_binary_response_status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setDefragmenterChunkDuration(std::stoull(valz));
         } else if (strcmp(keyz, "defragmenter_run") == 0) {
             runDefragmenterTask();
+        } else if (strcmp(keyz, "ht_resize_mode") == 0) {
+            getConfiguration().setHtResizeMode(valz);
+        } else if (strcmp(keyz, "ht_resize_step_budget_us") == 0) {
+            getConfiguration().setHtResizeStepBudgetUs(std::stoull(valz));
         } else if (strcmp(keyz, "compaction_write_queue_cap") == 0) {
             getConfiguration().setCompactionWriteQueueCap(std::stoull(valz));
         } else if (strcmp(keyz, "dcp_min_compression_ratio") == 0) {
             getConfiguration().setDcpMinCompressionRatio(std::stof(valz));
+        } else if (strcmp(keyz, "dcp_compression_cache_enabled") == 0) {
+            getConfiguration().setDcpCompressionCacheEnabled(cb_stob(valz));
+        } else if (strcmp(keyz, "dcp_producer_batch_bytes") == 0) {
+            getConfiguration().setDcpProducerBatchBytes(std::stoull(valz));
+        } else if (strcmp(keyz, "dcp_backfill_parallelism") == 0) {
+            getConfiguration().setDcpBackfillParallelism(std::stoull(valz));
+        } else if (strcmp(keyz, "dcp_backfill_shared_scan") == 0) {
+            getConfiguration().setDcpBackfillSharedScan(cb_stob(valz));
+        } else if (strcmp(keyz, "dcp_batch_seqno_notifications") == 0) {
+            getConfiguration().setDcpBatchSeqnoNotifications(cb_stob(valz));
         } else if (strcmp(keyz, "dcp_noop_mandatory_for_v5_features") == 0) {
             getConfiguration().setDcpNoopMandatoryForV5Features(cb_stob(valz));
         } else if (strcmp(keyz, "access_scanner_run") == 0) {
@@ -2990,6 +3017,18 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doHashStats(const void *cookie,
                 checked_snprintf(buf, sizeof(buf), "vb_%d:mem_size_counted",
                                  vbid);
                 add_casted_stat(buf, depthVisitor.memUsed, add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:resize_buckets_migrated", vbid);
+                add_casted_stat(buf, vb->ht.getResizeBucketsMigrated(),
+                                add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:resize_buckets_total", vbid);
+                add_casted_stat(buf, vb->ht.getResizeBucketsTotal(),
+                                add_stat, cookie);
+                checked_snprintf(buf, sizeof(buf),
+                                 "vb_%d:resize_max_stall_us", vbid);
+                add_casted_stat(buf, vb->ht.getMaxResizeStall().count(),
+                                add_stat, cookie);
             } catch (std::exception& error) {
                 LOG(EXTENSION_LOG_WARNING,
                     "StatVBucketVisitor::visitBucket: Failed to build stat: %s",
@@ -3300,6 +3339,29 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doDcpStats(const void *cookie,
                     dcpConnMap_->getNumActiveSnoozingBackfills(), add_stat, cookie);
     add_casted_stat("ep_dcp_max_running_backfills",
                     dcpConnMap_->getMaxActiveSnoozingBackfills(), add_stat, cookie);
+    add_casted_stat("ep_dcp_values_compressed",
+                    stats.dcpValuesCompressed, add_stat, cookie);
+    add_casted_stat("ep_dcp_compression_cache_hits",
+                    stats.dcpCompressionCacheHits, add_stat, cookie);
+    add_casted_stat("ep_dcp_compression_time",
+                    stats.dcpCompressionTime, add_stat, cookie);
+    add_casted_stat("ep_dcp_compression_bytes_saved",
+                    stats.dcpCompressionBytesSaved, add_stat, cookie);
+    add_casted_stat("ep_dcp_backfill_scans",
+                    stats.dcpBackfillScans, add_stat, cookie);
+    add_casted_stat("ep_dcp_backfill_scans_avoided",
+                    stats.dcpBackfillScansAvoided, add_stat, cookie);
+    add_casted_stat("ep_dcp_backfill_items_read",
+                    stats.dcpBackfillItemsRead, add_stat, cookie);
+    add_casted_stat("ep_dcp_backfill_scan_time",
+                    stats.dcpBackfillScanTime, add_stat, cookie);
+    const size_t backfillScanTime = stats.dcpBackfillScanTime;
+    add_casted_stat("ep_dcp_backfill_items_per_sec",
+                    backfillScanTime == 0
+                            ? 0
+                            : stats.dcpBackfillItemsRead * 1000000 /
+                                      backfillScanTime,
+                    add_stat, cookie);
 
     dcpConnMap_->addStats(add_stat, cookie);
     return ENGINE_SUCCESS;
@@ -3411,6 +3473,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
     add_casted_stat("access_scanner", stats.accessScannerHisto, add_stat, cookie);
     add_casted_stat("checkpoint_remover", stats.checkpointRemoverHisto, add_stat, cookie);
     add_casted_stat("item_pager", stats.itemPagerHisto, add_stat, cookie);
+    add_casted_stat("item_pager_time_to_low_wat",
+                    stats.itemPagerTimeToLowWatHisto,
+                    add_stat,
+                    cookie);
     add_casted_stat("expiry_pager", stats.expiryPagerHisto, add_stat, cookie);
 
     add_casted_stat("storage_age", stats.dirtyAgeHisto, add_stat, cookie);
@@ -3429,6 +3495,15 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(const void *cookie,
     // Misc
     add_casted_stat("notify_io", stats.notifyIOHisto, add_stat, cookie);
     add_casted_stat("batch_read", stats.getMultiHisto, add_stat, cookie);
+    add_casted_stat("bg_fetch_pipeline_wait",
+                    stats.bgFetchPipelineWaitHisto,
+                    add_stat,
+                    cookie);
+    add_casted_stat("bg_fetch_disk", stats.bgFetchDiskHisto, add_stat, cookie);
+    add_casted_stat("bg_fetch_complete",
+                    stats.bgFetchCompleteHisto,
+                    add_stat,
+                    cookie);
 
     // Disk stats
     add_casted_stat("disk_insert", stats.diskInsertHisto, add_stat, cookie);
@@ -3774,6 +3849,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(const void* cookie,
     } else if (statKey == "kvstore") {
         getKVBucket()->addKVStoreStats(add_stat, cookie);
         rv = ENGINE_SUCCESS;
+    } else if (statKey == "pager") {
+        getKVBucket()->addItemPagerStats(add_stat, cookie);
+        rv = ENGINE_SUCCESS;
     } else if (statKey == "warmup") {
         const auto* warmup = getKVBucket()->getWarmup();
         if (warmup != nullptr) {
@@ -4327,8 +4405,9 @@ protocol_binary_datatype_t EventuallyPersistentEngine::checkForDatatypeJson(
             body = cb::xattr::get_body(body);
         }
 
-        if (checkUTF8JSON(reinterpret_cast<const uint8_t*>(body.data()),
-                          body.size())) {
+        auto* ptr = reinterpret_cast<const uint8_t*>(body.data());
+        if (cb::json::isObjectOrArray(ptr, body.size()) ||
+            checkUTF8JSON(ptr, body.size())) {
             datatype |= PROTOCOL_BINARY_DATATYPE_JSON;
         }
     }
@@ -445,7 +445,7 @@ void EPVBucket::queueBackfillItem(queued_item& qi,
     ++stats.diskQueueSize;
     ++stats.vbBackfillQueueSize;
     ++stats.totalEnqueued;
-    doStatsForQueueing(*qi, qi->size());
+    doStatsForQueueing(*qi, qi->sizeWithoutCompressedValue());
     stats.memOverhead->fetch_add(sizeof(queued_item));
 }
 
@@ -62,7 +62,8 @@ EphemeralVBucket::EphemeralVBucket(id_type i,
               0, // Every item in ephemeral has a HLC cas
               mightContainXattrs,
               collectionsManifest),
-      seqList(std::make_unique<BasicLinkedList>(i, st)),
+      seqList(std::make_unique<BasicLinkedList>(
+              i, st, config.getEphemeralSeqlistIndexInterval())),
       backfillType(BackfillType::None) {
     /* Get the flow control policy */
     std::string dcpBackfillType = config.getDcpEphemeralBackfillType();
@@ -275,8 +276,8 @@ EphemeralVBucket::inMemoryBackfill(uint64_t start, uint64_t end) {
 }
 
 boost::optional<SequenceList::RangeIterator>
-EphemeralVBucket::makeRangeIterator(bool isBackfill) {
-    return seqList->makeRangeIterator(isBackfill);
+EphemeralVBucket::makeRangeIterator(bool isBackfill, seqno_t start) {
+    return seqList->makeRangeIterator(isBackfill, start);
 }
 
 /* Vb level backfill queue is for items in a huge snapshot (disk backfill
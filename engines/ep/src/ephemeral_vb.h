@@ -138,12 +138,13 @@ public:
      * the SequenceList, new range iterator will not be allowed
      *
      * @param isBackfill indicates if the iterator is for backfill (for debug)
+     * @param start the lowest seqno the caller is interested in
      *
      * @return range iterator object when possible
      *         null when not possible
      */
     boost::optional<SequenceList::RangeIterator> makeRangeIterator(
-            bool isBackfill);
+            bool isBackfill, seqno_t start = 0);
 
     void dump() const override;
 
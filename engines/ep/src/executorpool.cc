@@ -138,7 +138,8 @@ ExecutorPool *ExecutorPool::get(void) {
                                    config.getNumReaderThreads(),
                                    config.getNumWriterThreads(),
                                    config.getNumAuxioThreads(),
-                                   config.getNumNonioThreads());
+                                   config.getNumNonioThreads(),
+                                   config.isExecutorWorkStealing());
             ObjectRegistry::onSwitchThread(epe);
             instance.store(tmp);
         }
@@ -157,11 +158,15 @@ void ExecutorPool::shutdown(void) {
 
 ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
                            size_t maxReaders, size_t maxWriters,
-                           size_t maxAuxIO,   size_t maxNonIO) :
+                           size_t maxAuxIO,   size_t maxNonIO,
+                           bool workStealing) :
                   numTaskSets(nTaskSets), totReadyTasks(0),
                   isHiPrioQset(false), isLowPrioQset(false), numBuckets(0),
                   numSleepers(0), curWorkers(nTaskSets), numWorkers(nTaskSets),
-                  numReadyTasks(nTaskSets) {
+                  numReadyTasks(nTaskSets), workStealing(workStealing),
+                  numLocalTasks(nTaskSets), numBorrowers(nTaskSets),
+                  numStolenTasks(0), numBorrowedTasks(0),
+                  slowRuntimeHisto(GlobalTask::allTaskIds.size()) {
     size_t numCPU = Couchbase::get_available_cpu_count();
     size_t numThreads = (size_t)((numCPU * 3)/4);
     numThreads = (numThreads < EP_MIN_NUM_THREADS) ?
@@ -170,6 +175,8 @@ ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
     for (size_t i = 0; i < nTaskSets; i++) {
         curWorkers[i] = 0;
         numReadyTasks[i] = 0;
+        numLocalTasks[i] = 0;
+        numBorrowers[i] = 0;
     }
     numWorkers[WRITER_TASK_IDX] = maxWriters;
     numWorkers[READER_TASK_IDX] = maxReaders;
@@ -196,6 +203,17 @@ ExecutorPool::~ExecutorPool(void) {
 // polling frequencies as follows ...
 #define LOW_PRIORITY_FREQ 5 // 1 out of 5 times threads check low priority Q
 
+// Work-stealing mode: the most ready tasks a thread takes from each of its
+// type's queues at a time. Small, so that a thread which picks up a long
+// running task holds on to little work (which idle siblings may steal anyway).
+static const size_t STEALING_BATCH_SIZE = 4;
+
+// Work-stealing mode: how many threads may run tasks borrowed from one task
+// type at once, and the longest maxExpectedDuration of a task that may be
+// borrowed - so a borrowing thread is soon back to serve its own type.
+static const uint16_t MAX_BORROWERS_PER_TYPE = 1;
+static const std::chrono::milliseconds MAX_BORROWED_TASK_DURATION(100);
+
 TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
     if (!tick) {
         return NULL;
@@ -214,6 +232,9 @@ TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
                 (isLowPrioQset ? lpTaskQ[myq] : NULL);
         checkNextQ = isLowPrioQset ? lpTaskQ[myq] : checkQ;
     }
+    if (workStealing) {
+        return _nextTaskStealing(t, checkQ, checkNextQ);
+    }
     while (t.state == EXECUTOR_RUNNING) {
         if (checkQ &&
             checkQ->fetchNextTask(t, false)) {
@@ -234,6 +255,153 @@ TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
     return NULL;
 }
 
+TaskQueue* ExecutorPool::_nextTaskStealing(ExecutorThread& t,
+                                            TaskQueue* checkQ,
+                                            TaskQueue* checkNextQ) {
+    const task_type_t myq = t.taskType;
+
+    if (t.borrowedFrom != NO_TASK_TYPE) {
+        // Finished running a borrowed task
+        --numBorrowers[t.borrowedFrom];
+        t.borrowedFrom = NO_TASK_TYPE;
+    }
+
+    if (t.state != EXECUTOR_RUNNING) {
+        return NULL;
+    }
+
+    // Top up the local queue if it is empty, if more tasks have become ready
+    // (which may be of higher priority than those we hold), or if a future
+    // task is now due.
+    t.updateCurrentTime();
+    if (t.getNumLocalTasks() == 0 || numReadyTasks[myq] > 0 ||
+        t.getCurTime() >= t.getWaketime()) {
+        t.setWaketime(ProcessClock::time_point::max());
+        TaskQueue* nextQ = checkNextQ == checkQ ? NULL : checkNextQ;
+        for (TaskQueue* q : {checkQ, nextQ}) {
+            if (q) {
+                std::vector<ExTask> tasks;
+                if (q->fetchTasks(t, tasks, STEALING_BATCH_SIZE)) {
+                    numLocalTasks[myq] += tasks.size();
+                    t.addLocalTasks(tasks, q);
+                }
+            }
+        }
+    }
+
+    if (TaskQueue* q = t.popLocalTask()) {
+        --numLocalTasks[myq];
+        return q;
+    }
+    if (TaskQueue* q = _stealTask(t)) {
+        return q;
+    }
+    if (TaskQueue* q = _borrowTask(t)) {
+        return q;
+    }
+
+    TaskQueue* sleepQ = getSleepQ(myq);
+    return sleepQ->fetchNextTask(t, true) ? sleepQ : NULL;
+}
+
+TaskQueue* ExecutorPool::_stealTask(ExecutorThread& t) {
+    std::deque<std::pair<ExTask, TaskQueue*>> stolen;
+    {
+        // Only try for the lock: _unregisterTaskable joins threads while
+        // holding it, and another thief will get to the work anyway.
+        std::unique_lock<std::mutex> lh(tMutex, std::try_to_lock);
+        if (!lh.owns_lock()) {
+            return NULL;
+        }
+
+        ExecutorThread* victim = NULL;
+        size_t most = 0;
+        for (auto* other : threadQ) {
+            if (other != &t && other->taskType == t.taskType) {
+                const size_t size = other->getNumLocalTasks();
+                if (size > most) {
+                    most = size;
+                    victim = other;
+                }
+            }
+        }
+        if (!victim) {
+            return NULL;
+        }
+        stolen = victim->stealLocalTasks();
+    }
+
+    if (stolen.empty()) {
+        return NULL;
+    }
+    numStolenTasks += stolen.size();
+
+    // Run the highest priority of the stolen tasks, keep the rest.
+    auto next = std::move(stolen.front());
+    stolen.pop_front();
+    if (!stolen.empty()) {
+        std::lock_guard<std::mutex> lh(t.localMutex);
+        t.localTasks = std::move(stolen);
+    }
+    --numLocalTasks[t.taskType];
+    t.setCurrentTask(next.first);
+    return next.second;
+}
+
+TaskQueue* ExecutorPool::_borrowTask(ExecutorThread& t) {
+    for (size_t i = 1; i < numTaskSets; ++i) {
+        const auto type = task_type_t((t.taskType + i) % numTaskSets);
+
+        // Only borrow from a type all of whose threads are busy.
+        if (numWorkers[type] == 0 || curWorkers[type] < numWorkers[type]) {
+            continue;
+        }
+        if (++numBorrowers[type] > MAX_BORROWERS_PER_TYPE) {
+            --numBorrowers[type];
+            continue;
+        }
+        for (TaskQueue* q : {isHiPrioQset ? hpTaskQ[type] : NULL,
+                             isLowPrioQset ? lpTaskQ[type] : NULL}) {
+            if (q && q->fetchBorrowedTask(t, MAX_BORROWED_TASK_DURATION)) {
+                t.borrowedFrom = type;
+                ++numBorrowedTasks;
+                return q;
+            }
+        }
+        --numBorrowers[type];
+    }
+    return NULL;
+}
+
+void ExecutorPool::wakeBorrower(task_type_t type) {
+    if (!workStealing) {
+        return;
+    }
+    for (size_t i = 1; i < numTaskSets; ++i) {
+        size_t numToWake = 1;
+        getSleepQ((type + i) % numTaskSets)->doWake(numToWake);
+        if (numToWake == 0) {
+            return;
+        }
+    }
+}
+
+void ExecutorPool::returnLocalTasks(ExecutorThread& t) {
+    if (t.borrowedFrom != NO_TASK_TYPE) {
+        --numBorrowers[t.borrowedFrom];
+        t.borrowedFrom = NO_TASK_TYPE;
+    }
+
+    auto tasks = t.takeLocalTasks();
+    numLocalTasks[t.taskType] -= tasks.size();
+    for (auto& entry : tasks) {
+        // The tasks were ready to run, so wake a thread to run them.
+        entry.second->reschedule(entry.first);
+        size_t numToWake = 1;
+        getSleepQ(entry.second->getQueueType())->doWake(numToWake);
+    }
+}
+
 TaskQueue *ExecutorPool::nextTask(ExecutorThread &t, uint8_t tick) {
     EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
     TaskQueue *tq = _nextTask(t, tick);
@@ -777,6 +945,16 @@ void ExecutorPool::doTaskQStat(EventuallyPersistentEngine *engine,
                 }
             }
         }
+        if (workStealing) {
+            add_casted_stat("ep_workload:stolen_tasks",
+                            numStolenTasks.load(),
+                            add_stat,
+                            cookie);
+            add_casted_stat("ep_workload:borrowed_tasks",
+                            numBorrowedTasks.load(),
+                            add_stat,
+                            cookie);
+        }
     } catch (std::exception& error) {
         LOG(EXTENSION_LOG_WARNING,
             "ExecutorPool::doTaskQStat: Failed to build stats: %s",
@@ -874,6 +1052,11 @@ void ExecutorPool::doWorkerStat(EventuallyPersistentEngine *engine,
     ObjectRegistry::onSwitchThread(epe);
 }
 
+void ExecutorPool::logSlowRunTime(TaskId id, ProcessClock::duration runtime) {
+    slowRuntimeHisto[static_cast<int>(id)].add(
+            std::chrono::duration_cast<std::chrono::microseconds>(runtime));
+}
+
 void ExecutorPool::doTasksStat(EventuallyPersistentEngine* engine,
                                const void* cookie,
                                ADD_STAT add_stat) {
@@ -935,6 +1118,12 @@ void ExecutorPool::doTasksStat(EventuallyPersistentEngine* engine,
                 engine->getEpStats()
                         .taskRuntimeHisto[static_cast<int>(task->getTypeId())]
                         .total());
+        cJSON_AddNumberToObject(
+                obj.get(), "num_yields", task->getNumYields());
+        cJSON_AddNumberToObject(
+                obj.get(),
+                "num_slow_runs",
+                slowRuntimeHisto[static_cast<int>(task->getTypeId())].total());
         cJSON_AddStringToObject(
                 obj.get(),
                 "type",
@@ -957,6 +1146,19 @@ void ExecutorPool::doTasksStat(EventuallyPersistentEngine* engine,
     checked_snprintf(statname, sizeof(statname), "%s:uptime_s", prefix);
     add_casted_stat(statname, ep_current_time(), add_stat, cookie);
 
+    // Runtimes of the executions which overran their budget, per task
+    for (TaskId id : GlobalTask::allTaskIds) {
+        auto& histo = slowRuntimeHisto[static_cast<int>(id)];
+        if (histo.total() > 0) {
+            checked_snprintf(statname,
+                             sizeof(statname),
+                             "%s:slow_runtime:%s",
+                             prefix,
+                             GlobalTask::getTaskName(id));
+            add_casted_stat(statname, histo, add_stat, cookie);
+        }
+    }
+
     ObjectRegistry::onSwitchThread(epe);
 }
 
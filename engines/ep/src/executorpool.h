@@ -68,12 +68,16 @@
 
 #include "config.h"
 
+#include "globaltask.h"
 #include "syncobject.h"
 #include "task_type.h"
 #include "taskable.h"
 
+#include <platform/histogram.h>
+
 #include <map>
 #include <set>
+#include <vector>
 
 // Forward decl
 class TaskQueue;
@@ -96,7 +100,7 @@ public:
     void doneWork(task_type_t taskType);
 
     bool trySleep(task_type_t task_type) {
-        if (!numReadyTasks[task_type]) {
+        if (!numReadyTasks[task_type] && !numLocalTasks[task_type]) {
             numSleepers++;
             return true;
         }
@@ -113,6 +117,23 @@ public:
         return isHiPrioQset ? hpTaskQ[curTaskType] : lpTaskQ[curTaskType];
     }
 
+    bool isWorkStealing() const {
+        return workStealing;
+    }
+
+    /**
+     * Work-stealing mode: wake a sleeping thread of another type to borrow
+     * a task which has become ready on the given type's queues. A no-op
+     * otherwise.
+     */
+    void wakeBorrower(task_type_t type);
+
+    /**
+     * Work-stealing mode: put the tasks left in an exiting thread's local
+     * queue back into the queues they were fetched from.
+     */
+    void returnLocalTasks(ExecutorThread& t);
+
     bool cancel(size_t taskId, bool eraseTask=false);
 
     bool stopTaskGroup(task_gid_t taskGID, task_type_t qidx, bool force);
@@ -148,6 +169,13 @@ public:
     void doTaskQStat(EventuallyPersistentEngine *engine, const void *cookie,
                      ADD_STAT add_stat);
 
+    /**
+     * Record the runtime of a task execution which exceeded the task's
+     * maxExpectedDuration (its runtime budget); reported per task by
+     * doTasksStat.
+     */
+    void logSlowRunTime(TaskId id, ProcessClock::duration runtime);
+
     size_t getNumWorkersStat(void) {
         LockHolder lh(tMutex);
         return threadQ.size();
@@ -206,10 +234,26 @@ public:
 protected:
 
     ExecutorPool(size_t t, size_t nTaskSets, size_t r, size_t w, size_t a,
-                 size_t n);
+                 size_t n, bool workStealing = false);
     virtual ~ExecutorPool(void);
 
     TaskQueue* _nextTask(ExecutorThread &t, uint8_t tick);
+
+    /**
+     * Work-stealing mode version of _nextTask. In order, the thread:
+     *  1. tops up its local queue with a batch of ready tasks from its type's
+     *     queues (if it is empty, or more tasks have become ready);
+     *  2. runs the highest priority task from its local queue;
+     *  3. steals half of the largest local queue of another thread of the
+     *     same type;
+     *  4. borrows a short task from a type whose threads are all busy;
+     *  5. sleeps on its type's queue, as _nextTask would.
+     */
+    TaskQueue* _nextTaskStealing(ExecutorThread& t,
+                                 TaskQueue* checkQ,
+                                 TaskQueue* checkNextQ);
+    TaskQueue* _stealTask(ExecutorThread& t);
+    TaskQueue* _borrowTask(ExecutorThread& t);
     bool _cancel(size_t taskId, bool eraseTask=false);
     bool _wake(size_t taskId);
     virtual bool _startWorkers(void);
@@ -259,6 +303,18 @@ protected:
     std::vector<std::atomic<uint16_t>> numWorkers; // and limit it to the value set here
     std::vector<std::atomic<size_t>> numReadyTasks; // number of ready tasks per task set
 
+    // Work-stealing mode; see _nextTaskStealing. Not altered after creation.
+    const bool workStealing;
+    // number of tasks in threads' local queues per task set
+    std::vector<std::atomic<size_t>> numLocalTasks;
+    // number of threads running a task borrowed from each task set
+    std::vector<std::atomic<uint16_t>> numBorrowers;
+    std::atomic<uint64_t> numStolenTasks;
+    std::atomic<uint64_t> numBorrowedTasks;
+
+    // Runtimes of slow task executions, one histogram per TaskId
+    std::vector<MicrosecondHistogram> slowRuntimeHisto;
+
     // Set of all known task owners
     std::set<void *> taskOwners;
 
@@ -17,7 +17,9 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <chrono>
+#include <iterator>
 #include <queue>
 
 #include "common.h"
@@ -107,6 +109,7 @@ void ExecutorThread::run() {
                                            getCurTime() - woketime :
                                            ProcessClock::duration::zero());
             updateTaskStart();
+            currentTask->startRunBudget(getTaskStart());
             rel_time_t startReltime = ep_current_time();
 
             const auto curTaskDescr = currentTask->getDescription();
@@ -132,6 +135,7 @@ void ExecutorThread::run() {
             // Note: This is done before we call onSwitchThread(NULL)
             // so the bucket name is included in the Log message.
             if (runtime > currentTask->maxExpectedDuration()) {
+                manager->logSlowRunTime(currentTask->getTypeId(), runtime);
                 auto description = currentTask->getDescription();
                 LOG(EXTENSION_LOG_WARNING,
                     "Slow runtime for '%.*s' on thread %s: %s",
@@ -154,6 +158,11 @@ void ExecutorThread::run() {
                 ObjectRegistry::onSwitchThread(engine);
             }
 
+            if (again && currentTask->yielded) {
+                // Rescheduled below to carry on where it left off.
+                ++currentTask->numYields;
+            }
+
             // Check if task is run once or needs to be rescheduled..
             if (!again || currentTask->isdead()) {
                 manager->cancel(currentTask->uid, true);
@@ -185,6 +194,10 @@ void ExecutorThread::run() {
             manager->doneWork(taskType);
         }
     }
+    // Hand back any tasks still waiting in our local queue, so the
+    // remaining threads run them.
+    manager->returnLocalTasks(*this);
+
     // Thread is about to terminate - disassociate it from any engine.
     ObjectRegistry::onSwitchThread(nullptr);
 
@@ -212,6 +225,58 @@ void ExecutorThread::resetCurrentTask() {
     resetThisObject.reset();
 }
 
+void ExecutorThread::addLocalTasks(const std::vector<ExTask>& tasks,
+                                   TaskQueue* q) {
+    // Same order as the readyQueue: lowest priority value first, then by uid
+    auto runsBefore = [](const ExTask& a,
+                         const std::pair<ExTask, TaskQueue*>& b) {
+        return (a->getQueuePriority() == b.first->getQueuePriority())
+                       ? (a->uid < b.first->uid)
+                       : (a->getQueuePriority() < b.first->getQueuePriority());
+    };
+
+    std::lock_guard<std::mutex> lh(localMutex);
+    for (const auto& task : tasks) {
+        localTasks.emplace(std::upper_bound(localTasks.begin(),
+                                            localTasks.end(),
+                                            task,
+                                            runsBefore),
+                           task,
+                           q);
+    }
+}
+
+TaskQueue* ExecutorThread::popLocalTask() {
+    std::pair<ExTask, TaskQueue*> next;
+    {
+        std::lock_guard<std::mutex> lh(localMutex);
+        if (localTasks.empty()) {
+            return NULL;
+        }
+        next = std::move(localTasks.front());
+        localTasks.pop_front();
+    }
+    setCurrentTask(next.first);
+    return next.second;
+}
+
+std::deque<std::pair<ExTask, TaskQueue*>> ExecutorThread::stealLocalTasks() {
+    std::lock_guard<std::mutex> lh(localMutex);
+    const size_t count = (localTasks.size() + 1) / 2;
+    std::deque<std::pair<ExTask, TaskQueue*>> stolen(
+            std::make_move_iterator(localTasks.end() - count),
+            std::make_move_iterator(localTasks.end()));
+    localTasks.erase(localTasks.end() - count, localTasks.end());
+    return stolen;
+}
+
+std::deque<std::pair<ExTask, TaskQueue*>> ExecutorThread::takeLocalTasks() {
+    std::lock_guard<std::mutex> lh(localMutex);
+    std::deque<std::pair<ExTask, TaskQueue*>> taken;
+    taken.swap(localTasks);
+    return taken;
+}
+
 cb::const_char_buffer ExecutorThread::getTaskName() {
     LockHolder lh(currentTaskMutex);
     if (currentTask) {
@@ -93,7 +93,8 @@ public:
           now(ProcessClock::now()),
           waketime(ProcessClock::time_point::max()),
           taskStart(),
-          currentTask(NULL) {
+          currentTask(NULL),
+          borrowedFrom(NO_TASK_TYPE) {
     }
 
     ~ExecutorThread() {
@@ -168,6 +169,35 @@ public:
         now.setTimePoint(ProcessClock::now());
     }
 
+    /**
+     * Work-stealing mode: add tasks (fetched from the given queue) to this
+     * thread's local queue, keeping it sorted by task priority.
+     */
+    void addLocalTasks(const std::vector<ExTask>& tasks, TaskQueue* q);
+
+    /**
+     * Work-stealing mode: make the highest priority task in the local queue
+     * the current task.
+     *
+     * @return the queue the task was fetched from, or NULL if the local
+     *         queue is empty
+     */
+    TaskQueue* popLocalTask();
+
+    /**
+     * Work-stealing mode: remove the lowest priority half (rounded up) of
+     * the local queue, for another thread of the same type to run.
+     */
+    std::deque<std::pair<ExTask, TaskQueue*>> stealLocalTasks();
+
+    /// Work-stealing mode: remove everything from the local queue.
+    std::deque<std::pair<ExTask, TaskQueue*>> takeLocalTasks();
+
+    size_t getNumLocalTasks() {
+        std::lock_guard<std::mutex> lh(localMutex);
+        return localTasks.size();
+    }
+
 protected:
 
     cb_thread_t thread;
@@ -185,6 +215,17 @@ protected:
     std::mutex currentTaskMutex; // Protects currentTask
     ExTask currentTask;
 
+    // Work-stealing mode: tasks this thread has taken from the task queues
+    // but not yet run, sorted by priority, each with the queue it was
+    // fetched from. Other threads of the same type may steal from the back.
+    std::mutex localMutex; // Protects localTasks
+    std::deque<std::pair<ExTask, TaskQueue*>> localTasks;
+
+    // Work-stealing mode: the task type of the current task if it was
+    // borrowed from another type's queues, otherwise NO_TASK_TYPE. Only
+    // accessed by the thread itself.
+    task_type_t borrowedFrom;
+
     std::mutex logMutex;
     cb::RingBuffer<TaskLogEntry, TASK_LOG_SIZE> tasklog;
     cb::RingBuffer<TaskLogEntry, TASK_LOG_SIZE> slowjobs;
@@ -19,12 +19,14 @@
 
 #include "common.h"
 #include "ep_bucket.h"
+#include "ep_engine.h"
 #include "tasks.h"
 
 #include <platform/timeutils.h>
 
 #include <stdlib.h>
 #include <sstream>
+#include <vector>
 
 Flusher::Flusher(EPBucket* st, KVShard* k)
     : store(st),
@@ -286,6 +288,15 @@ void Flusher::flushVB(void) {
             hpVbs.push(vbid);
         }
     } else {
+        auto& config = store->getEPEngine().getConfiguration();
+        const size_t groupSize = config.getFlusherGroupCommitVbuckets();
+        if (groupSize > 1) {
+            flushVBGroup(groupSize,
+                         std::chrono::milliseconds(
+                                 config.getFlusherGroupCommitMaxDelayMs()));
+            return;
+        }
+
         if (doHighPriority && --numHighPriority == 0) {
             doHighPriority = false;
         }
@@ -296,3 +307,28 @@ void Flusher::flushVB(void) {
         }
     }
 }
+
+void Flusher::flushVBGroup(size_t groupSize,
+                           std::chrono::microseconds maxDelay) {
+    std::vector<uint16_t> vbids;
+    while (!lpVbs.empty() && vbids.size() < groupSize) {
+        vbids.push_back(lpVbs.front());
+        lpVbs.pop();
+    }
+
+    if (doHighPriority) {
+        if (numHighPriority <= vbids.size()) {
+            numHighPriority = 0;
+            doHighPriority = false;
+        } else {
+            numHighPriority -= vbids.size();
+        }
+    }
+
+    store->flushVBuckets(vbids, maxDelay);
+
+    // Whatever was not flushed goes to the back of the queue.
+    for (auto vbid : vbids) {
+        lpVbs.push(vbid);
+    }
+}
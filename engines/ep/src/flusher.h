@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include <chrono>
 #include <list>
 #include <map>
 #include <queue>
@@ -87,6 +88,8 @@ private:
     bool transitionState(State to);
     bool validTransition(State to) const;
     void flushVB();
+    /// Flush (and group-commit) up to groupSize low priority vbuckets.
+    void flushVBGroup(size_t groupSize, std::chrono::microseconds maxDelay);
     void completeFlush();
     void initialize();
     void schedule_UNLOCKED();
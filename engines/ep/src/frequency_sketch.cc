@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "frequency_sketch.h"
+
+#include <algorithm>
+
+const size_t FrequencySketch::Depth;
+const uint8_t FrequencySketch::MaxCount;
+
+// Odd multipliers giving each row an independent(ish) hash of the key.
+static const uint64_t rowSeeds[FrequencySketch::Depth] = {
+        0x9e3779b97f4a7c15ULL,
+        0xc2b2ae3d27d4eb4fULL,
+        0x165667b19e3779f9ULL,
+        0xd6e8feb86659fd93ULL};
+
+static size_t roundUpWidth(size_t width) {
+    size_t result = 64;
+    while (result < width) {
+        result <<= 1;
+    }
+    return result;
+}
+
+FrequencySketch::FrequencySketch(size_t w)
+    : width(roundUpWidth(w)),
+      resetThreshold(10 * width),
+      table(new std::atomic<uint64_t>[numWords()]),
+      additions(0),
+      numResets(0) {
+    for (size_t ii = 0; ii < numWords(); ++ii) {
+        table[ii].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t FrequencySketch::counterIndex(uint32_t hash, size_t row) const {
+    uint64_t h = (uint64_t(hash) + 1) * rowSeeds[row];
+    h ^= h >> 32;
+    return row * width + (h & (width - 1));
+}
+
+uint8_t FrequencySketch::getCounter(size_t index) const {
+    const auto word = table[index / CountersPerWord].load(
+            std::memory_order_relaxed);
+    return (word >> ((index % CountersPerWord) * 4)) & 0xf;
+}
+
+uint8_t FrequencySketch::frequency(uint32_t hash) const {
+    uint8_t result = MaxCount;
+    for (size_t row = 0; row < Depth; ++row) {
+        result = std::min(result, getCounter(counterIndex(hash, row)));
+    }
+    return result;
+}
+
+uint8_t FrequencySketch::increment(uint32_t hash) {
+    size_t indexes[Depth];
+    uint8_t current = MaxCount;
+    for (size_t row = 0; row < Depth; ++row) {
+        indexes[row] = counterIndex(hash, row);
+        current = std::min(current, getCounter(indexes[row]));
+    }
+    if (current == MaxCount) {
+        return current;
+    }
+
+    // Conservative update: only bump the counters at the minimum.
+    for (size_t row = 0; row < Depth; ++row) {
+        auto& word = table[indexes[row] / CountersPerWord];
+        const auto shift = (indexes[row] % CountersPerWord) * 4;
+        auto expected = word.load(std::memory_order_relaxed);
+        while (((expected >> shift) & 0xf) == current &&
+               !word.compare_exchange_weak(expected,
+                                           expected + (uint64_t(1) << shift),
+                                           std::memory_order_relaxed)) {
+        }
+    }
+
+    if (++additions == resetThreshold) {
+        halve();
+        additions.fetch_sub(resetThreshold);
+    }
+    return current + 1;
+}
+
+void FrequencySketch::halve() {
+    for (size_t ii = 0; ii < numWords(); ++ii) {
+        auto expected = table[ii].load(std::memory_order_relaxed);
+        while (!table[ii].compare_exchange_weak(
+                expected,
+                (expected >> 1) & 0x7777777777777777ULL,
+                std::memory_order_relaxed)) {
+        }
+    }
+    ++numResets;
+}
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * A count-min sketch of key access frequencies, as used by TinyLFU.
+ *
+ * Each key maps to one 4-bit counter in each of `Depth` rows (counters are
+ * packed sixteen to a 64-bit word); its estimated frequency is the minimum
+ * of those counters. Increments are conservative - only the counters at the
+ * current minimum are bumped - which keeps over-estimation low.
+ *
+ * Once `10 * width` increments have been recorded every counter is halved,
+ * so the sketch reflects recent popularity rather than all history.
+ *
+ * The sketch records accesses to keys whether or not they are currently
+ * resident, which is what lets a key which has been evicted (and later
+ * fetched back) be re-admitted with its previous frequency.
+ *
+ * Thread-safety: counters are read and written with relaxed atomics; an
+ * increment racing with another increment to the same word may be lost,
+ * which only makes the (already approximate) estimate slightly lower.
+ */
+class FrequencySketch {
+public:
+    /// Number of rows (hash functions).
+    static const size_t Depth = 4;
+
+    /// Largest value a counter can hold.
+    static const uint8_t MaxCount = 15;
+
+    /**
+     * @param width number of counters per row; rounded up to a power of two
+     *        (minimum 64).
+     */
+    explicit FrequencySketch(size_t width);
+
+    /**
+     * Record an access to the key with the given hash.
+     *
+     * @return the estimated frequency of the key after the access.
+     */
+    uint8_t increment(uint32_t hash);
+
+    /// @return the estimated frequency of the key with the given hash.
+    uint8_t frequency(uint32_t hash) const;
+
+    size_t getWidth() const {
+        return width;
+    }
+
+    /// @return how many times the counters have been halved.
+    size_t getNumResets() const {
+        return numResets;
+    }
+
+    size_t memorySize() const {
+        return sizeof(FrequencySketch) + numWords() * sizeof(uint64_t);
+    }
+
+private:
+    static const size_t CountersPerWord = 16;
+
+    size_t numWords() const {
+        return (Depth * width) / CountersPerWord;
+    }
+
+    /// Index (over all rows) of the counter for the given hash in `row`.
+    size_t counterIndex(uint32_t hash, size_t row) const;
+
+    uint8_t getCounter(size_t index) const;
+
+    void halve();
+
+    const size_t width;
+    const size_t resetThreshold;
+    std::unique_ptr<std::atomic<uint64_t>[]> table;
+    std::atomic<size_t> additions;
+    std::atomic<size_t> numResets;
+};
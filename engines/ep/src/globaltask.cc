@@ -17,6 +17,8 @@
 
 #include <limits.h>
 
+#include <limits>
+
 #include "globaltask.h"
 #include "ep_engine.h"
 
@@ -41,7 +43,10 @@ GlobalTask::GlobalTask(Taskable& t,
       taskable(t),
       totalRuntime(0),
       previousRuntime(0),
-      lastStartTime(0) {
+      lastStartTime(0),
+      runDeadline(std::numeric_limits<int64_t>::max()),
+      yielded(false),
+      numYields(0) {
     priority = getTaskPriority(taskId);
     snooze(sleeptime);
 }
@@ -77,6 +82,28 @@ void GlobalTask::wakeUp() {
     updateWaketime(ProcessClock::now());
 }
 
+bool GlobalTask::shouldYield() {
+    if (to_ns_since_epoch(ProcessClock::now()).count() < runDeadline) {
+        return false;
+    }
+    yielded = true;
+    return true;
+}
+
+void GlobalTask::startRunBudget(ProcessClock::time_point start) {
+    yielded = false;
+
+    // Tasks with no meaningful limit on their runtime (e.g. one-off startup
+    // tasks) are never asked to yield.
+    const auto budget = maxExpectedDuration();
+    if (budget <= std::chrono::microseconds::zero() ||
+        budget >= std::chrono::hours(1)) {
+        runDeadline = std::numeric_limits<int64_t>::max();
+    } else {
+        runDeadline = to_ns_since_epoch(start + budget).count();
+    }
+}
+
 /*
  * Generate a switch statement from tasks.def.h that maps TaskId to a
  * stringified value of the task's name.
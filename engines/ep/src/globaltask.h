@@ -121,6 +121,30 @@ public:
      */
     virtual std::chrono::microseconds maxExpectedDuration() = 0;
 
+    /**
+     * Cooperative yielding: returns true once the current execution of run()
+     * has used up its runtime budget - the time slice the ExecutorThread
+     * gives it, which is its maxExpectedDuration().
+     *
+     * A task which works through a large amount of state should check this
+     * between (small) pieces of work and, when it returns true, record where
+     * it got to and return true from run(). The task is then rescheduled to
+     * run again immediately, after any higher priority tasks which are
+     * ready, and should carry on from where it stopped.
+     *
+     * Reads the clock, so should not be called for every item of a tight
+     * loop.
+     */
+    bool shouldYield();
+
+    /**
+     * Returns how many times this task has been rescheduled after yielding
+     * (see shouldYield()).
+     */
+    uint64_t getNumYields() const {
+        return numYields;
+    }
+
     /**
      * test if a task is dead
      */
@@ -268,6 +292,18 @@ protected:
     atomic_duration previousRuntime;
     atomic_time_point lastStartTime;
 
+    /**
+     * Start the runtime budget for an execution of run() beginning at the
+     * given time (see shouldYield()). Called by the ExecutorThread.
+     */
+    void startRunBudget(ProcessClock::time_point start);
+
+    // When the current execution of run() should yield
+    atomic_time_point runDeadline;
+    // Set if shouldYield() returned true during the current run()
+    std::atomic<bool> yielded;
+    std::atomic<uint64_t> numYields;
+
 private:
     atomic_time_point waketime; // used for priority_queue
 };
@@ -23,7 +23,10 @@
 
 #include <phosphor/phosphor.h>
 
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <limits>
 
 static const ssize_t prime_size_table[] = {
     3, 7, 13, 23, 47, 97, 193, 383, 769, 1531, 3079, 6143, 12289, 24571, 49157,
@@ -33,6 +36,46 @@ static const ssize_t prime_size_table[] = {
 };
 
 
+HashTable::Layout HashTable::layoutFromString(const std::string& layout) {
+    if (layout == "chained") {
+        return Layout::Chained;
+    } else if (layout == "bucketized") {
+        return Layout::Bucketized;
+    }
+    throw std::invalid_argument(
+            "HashTable::layoutFromString: unknown layout '" + layout + "'");
+}
+
+HashTable::EvictionPolicy HashTable::evictionPolicyFromString(
+        const std::string& policy) {
+    if (policy == "nru") {
+        return EvictionPolicy::NRU;
+    } else if (policy == "tinylfu") {
+        return EvictionPolicy::TinyLFU;
+    }
+    throw std::invalid_argument(
+            "HashTable::evictionPolicyFromString: unknown policy '" + policy +
+            "'");
+}
+
+void HashTable::TagDirectory::reset(size_t n) {
+    // Over-allocate by one line so the first TagBucket can be aligned to a
+    // cache line boundary; a probe then only ever touches a single line.
+    storageSize = (n + 1) * CacheLineSize;
+    storage.reset(new uint8_t[storageSize]);
+    auto addr = reinterpret_cast<uintptr_t>(storage.get());
+    addr = (addr + CacheLineSize - 1) & ~uintptr_t(CacheLineSize - 1);
+    base = reinterpret_cast<TagBucket*>(addr);
+    numBuckets = n;
+    clear();
+}
+
+void HashTable::TagDirectory::clear() {
+    for (size_t ii = 0; ii < numBuckets; ++ii) {
+        base[ii].count = 0;
+    }
+}
+
 std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
     os << "{lock:" << pos.lock << " bucket:" << pos.hash_bucket << "/" << pos.ht_size << "}";
     return os;
@@ -41,12 +84,15 @@ std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
 HashTable::HashTable(EPStats& st,
                      std::unique_ptr<AbstractStoredValueFactory> svFactory,
                      size_t initialSize,
-                     size_t locks)
+                     size_t locks,
+                     Layout layout,
+                     EvictionPolicy evictionPolicy)
     : datatypeCounts(),
       cacheSize(0),
       metaDataMemory(0),
       initialSize(initialSize),
       size(initialSize),
+      layout(layout),
       mutexes(locks),
       stats(st),
       valFact(std::move(svFactory)),
@@ -58,8 +104,19 @@ HashTable::HashTable(EPStats& st,
       numResizes(0),
       numTempItems(0),
       memSize(0),
-      maxDeletedRevSeqno(0) {
+      maxDeletedRevSeqno(0),
+      oldSize(0),
+      numMigrated(0),
+      migrateCursor(0),
+      resizeGeneration(0),
+      maxResizeStallUs(0),
+      evictionPolicy(evictionPolicy),
+      freqSketch(makeFreqSketch(initialSize)),
+      freqCounterSaturated(false) {
     values.resize(size);
+    if (layout == Layout::Bucketized) {
+        tags.reset(size);
+    }
     activeState = true;
 }
 
@@ -112,6 +169,17 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
             values[i] = std::move(v->getNext());
         }
     }
+    // The old buckets of an in-progress incremental resize are emptied but
+    // kept; resizeStep() completes the resize as usual.
+    for (auto& chain : oldValues) {
+        while (chain) {
+            auto v = std::move(chain);
+            clearedMemSize += v->size();
+            clearedValSize += v->valuelen();
+            chain = std::move(v->getNext());
+        }
+    }
+    tags.clear();
 
     stats.currentSize.fetch_sub(clearedMemSize - clearedValSize);
 
@@ -136,7 +204,7 @@ static bool isCurrently(size_t size, ssize_t a, ssize_t b) {
     return (current == a || current == b);
 }
 
-void HashTable::resize() {
+size_t HashTable::getTargetSize() {
     size_t ni = getNumInMemoryItems();
     int i(0);
     size_t new_size(0);
@@ -164,7 +232,11 @@ void HashTable::resize() {
         new_size = nearest(ni, prime_size_table[i-1], prime_size_table[i]);
     }
 
-    resize(new_size);
+    return new_size;
+}
+
+void HashTable::resize() {
+    resize(getTargetSize());
 }
 
 void HashTable::resize(size_t newSize) {
@@ -195,6 +267,11 @@ void HashTable::resize(size_t newSize) {
         // locks at this point).
         return;
     }
+    if (oldSize != 0) {
+        // An incremental resize is in progress; let it finish.
+        return;
+    }
+    const auto start = ProcessClock::now();
 
     // Get a place for the new items.
     table_type newValues(newSize);
@@ -203,11 +280,11 @@ void HashTable::resize(size_t newSize) {
     ++numResizes;
 
     // Set the new size so all the hashy stuff works.
-    size_t oldSize = size;
+    size_t prevSize = size;
     size.store(newSize);
 
     // Move existing records into the new space.
-    for (size_t i = 0; i < oldSize; i++) {
+    for (size_t i = 0; i < prevSize; i++) {
         while (values[i]) {
             // unlink the front element from the hash chain at values[i].
             auto v = std::move(values[i]);
@@ -223,7 +300,238 @@ void HashTable::resize(size_t newSize) {
     // Finally assign the new table to values.
     values = std::move(newValues);
 
+    if (layout == Layout::Bucketized) {
+        tags.reset(newSize);
+        for (size_t i = 0; i < newSize; i++) {
+            tagRebuild(i);
+        }
+    }
+    if (freqSketch) {
+        freqSketch = makeFreqSketch(newSize);
+    }
+    ++resizeGeneration;
+
     stats.memOverhead->fetch_add(memorySize());
+    recordResizeStall(ProcessClock::now() - start);
+}
+
+bool HashTable::beginIncrementalResize() {
+    return beginIncrementalResize(getTargetSize());
+}
+
+bool HashTable::beginIncrementalResize(size_t newSize) {
+    if (!isActive()) {
+        throw std::logic_error("HashTable::beginIncrementalResize: Cannot "
+                "call on a non-active object");
+    }
+
+    // Old buckets are addressed as `size + old bucket`, so both tables
+    // together must fit in an int.
+    const size_t currSize = size;
+    if (newSize > static_cast<size_t>(std::numeric_limits<int>::max()) -
+                          currSize) {
+        return false;
+    }
+
+    if (newSize == currSize || oldSize != 0) {
+        return false;
+    }
+
+    TRACE_EVENT2("HashTable",
+                 "beginIncrementalResize",
+                 "size",
+                 currSize,
+                 "newSize",
+                 newSize);
+
+    // Allocate everything up front so the locks are only held for the swap.
+    table_type newValues(newSize);
+    TagDirectory newTags;
+    if (layout == Layout::Bucketized) {
+        newTags.reset(newSize);
+    }
+    std::vector<std::atomic<bool>> newMigrated(currSize);
+    auto newSketch = makeFreqSketch(newSize);
+
+    MultiLockHolder mlh(mutexes);
+    if (visitors.load() > 0 || oldSize != 0 || size != currSize) {
+        // Visitors iterate by bucket number; they (and any concurrent
+        // resize) must see a stable layout. Try again next time.
+        return false;
+    }
+    const auto start = ProcessClock::now();
+
+    stats.memOverhead->fetch_sub(memorySize());
+    ++numResizes;
+
+    oldValues = std::move(values);
+    values = std::move(newValues);
+    tags = std::move(newTags);
+    migrated = std::move(newMigrated);
+    // The old sketch is freed once the locks are released.
+    std::swap(freqSketch, newSketch);
+    numMigrated = 0;
+    migrateCursor = 0;
+    size.store(newSize);
+    oldSize.store(currSize);
+    ++resizeGeneration;
+
+    stats.memOverhead->fetch_add(memorySize());
+    recordResizeStall(ProcessClock::now() - start);
+    return true;
+}
+
+bool HashTable::resizeStep(std::chrono::microseconds budget) {
+    if (!isActive()) {
+        throw std::logic_error("HashTable::resizeStep: Cannot call on a "
+                "non-active object");
+    }
+    if (oldSize == 0) {
+        return false;
+    }
+
+    // Destroyed after the locks are released.
+    table_type freedValues;
+    std::vector<std::atomic<bool>> freedMigrated;
+
+    MultiLockHolder mlh(mutexes);
+    if (visitors.load() > 0 || oldSize == 0) {
+        return false;
+    }
+    const auto start = ProcessClock::now();
+
+    size_t ob = migrateCursor;
+    while (ob < oldSize) {
+        if (!migrated[ob]) {
+            migrateBucket(ob);
+        }
+        ++ob;
+        // Reading the clock is not free; only check it periodically.
+        if ((ob % 64) == 0 && (ProcessClock::now() - start) >= budget) {
+            break;
+        }
+    }
+    migrateCursor = ob;
+
+    if (ob == oldSize) {
+        // Every old bucket has been migrated - complete the resize.
+        stats.memOverhead->fetch_sub(memorySize());
+        freedValues.swap(oldValues);
+        freedMigrated.swap(migrated);
+        oldSize.store(0);
+        numMigrated = 0;
+        migrateCursor = 0;
+        ++resizeGeneration;
+        stats.memOverhead->fetch_add(memorySize());
+    }
+
+    recordResizeStall(ProcessClock::now() - start);
+    return true;
+}
+
+HashTable::HashBucketLock HashTable::getLockedBucketDuringResize(int h) {
+    const auto generation = resizeGeneration.load();
+    const size_t currOldSize = oldSize;
+    if (currOldSize == 0) {
+        return {};
+    }
+    const int oldBucket = abs(h % static_cast<int>(currOldSize));
+    HashBucketLock oldLock(size + oldBucket,
+                           mutexes[oldBucket % mutexes.size()]);
+    if (generation != resizeGeneration) {
+        // The resize completed (and maybe another started) meanwhile.
+        return {};
+    }
+
+    if (!migrated[oldBucket] && !tryMigrateBucket(oldBucket)) {
+        // Key (if present) is still in the old bucket.
+        return oldLock;
+    }
+
+    // Migrated; the key lives in the new table. Migrated flags are never
+    // cleared within a generation so this stays valid after unlocking.
+    oldLock.getHTLock().unlock();
+    const int bucket = getBucketForHash(h);
+    HashBucketLock rv(bucket, mutexes[mutexForBucket(bucket)]);
+    if (generation != resizeGeneration) {
+        return {};
+    }
+    return rv;
+}
+
+bool HashTable::tryMigrateBucket(size_t old_bucket) {
+    // Collect the locks of the new buckets the chain's items map to. Chains
+    // are short; one needing more locks than this is left for the resizer.
+    const size_t heldLock = old_bucket % mutexes.size();
+    std::array<size_t, maxMigrateLocks> needed;
+    size_t numNeeded = 0;
+    for (StoredValue* v = oldValues[old_bucket].get(); v;
+         v = v->getNext().get()) {
+        const size_t l =
+                getBucketForHash(v->getKey().hash()) % mutexes.size();
+        if (l == heldLock ||
+            std::find(needed.begin(), needed.begin() + numNeeded, l) !=
+                    needed.begin() + numNeeded) {
+            continue;
+        }
+        if (numNeeded == maxMigrateLocks) {
+            return false;
+        }
+        needed[numNeeded++] = l;
+    }
+
+    // Front-end threads never wait here; if any lock is contended (or out of
+    // order with one held elsewhere) leave the bucket for the resizer.
+    std::array<std::unique_lock<std::mutex>, maxMigrateLocks> locks;
+    for (size_t ii = 0; ii < numNeeded; ++ii) {
+        locks[ii] = std::unique_lock<std::mutex>(mutexes[needed[ii]],
+                                                 std::try_to_lock);
+        if (!locks[ii]) {
+            return false;
+        }
+    }
+
+    // The items must not move under a visitor. Visitors register before
+    // taking any bucket lock, so one which could have passed any of the
+    // buckets we hold is counted by now.
+    if (visitors.load() > 0) {
+        return false;
+    }
+
+    migrateBucket(old_bucket);
+    return true;
+}
+
+void HashTable::migrateBucket(size_t old_bucket) {
+    auto& chain = oldValues[old_bucket];
+    while (chain) {
+        auto v = std::move(chain);
+        chain = std::move(v->getNext());
+
+        int newBucket = getBucketForHash(v->getKey().hash());
+        v->setNext(std::move(values[newBucket]));
+        tagInsert(newBucket, *v);
+        values[newBucket] = std::move(v);
+    }
+    migrated[old_bucket] = true;
+    ++numMigrated;
+}
+
+int HashTable::locateBucket(int h) {
+    if (oldSize != 0) {
+        const int oldBucket = getOldBucketForHash(h);
+        if (!migrated[oldBucket]) {
+            return size + oldBucket;
+        }
+    }
+    return getBucketForHash(h);
+}
+
+void HashTable::recordResizeStall(ProcessClock::duration stall) {
+    const uint64_t us =
+            std::chrono::duration_cast<std::chrono::microseconds>(stall)
+                    .count();
+    atomic_setIfBigger(maxResizeStallUs, us);
 }
 
 StoredValue* HashTable::find(const DocKey& key,
@@ -238,14 +546,16 @@ StoredValue* HashTable::find(const DocKey& key,
 }
 
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
-    /* Try to locate a partition */
-    size_t start = rnd % size;
+    /* Try to locate a partition (including the old buckets of an
+       in-progress incremental resize) */
+    const size_t total = size + oldSize;
+    size_t start = rnd % total;
     size_t curr = start;
     std::unique_ptr<Item> ret;
 
     do {
         ret = getRandomKeyFromSlot(curr++);
-        if (curr == size) {
+        if (curr == total) {
             curr = 0;
         }
     } while (ret == NULL && curr != start);
@@ -311,12 +621,21 @@ StoredValue* HashTable::unlocked_addNewStoredValue(const HashBucketLock& hbl,
     }
 
     // Create a new StoredValue and link it into the head of the bucket chain.
-    auto v = (*valFact)(itm, std::move(values[hbl.getBucketNum()]));
+    auto& chain = chainFor(hbl.getBucketNum());
+    auto v = (*valFact)(itm, std::move(chain));
+    if (freqSketch) {
+        // Admit the key with the frequency it had previously (e.g. before
+        // it was evicted) so it is not immediately an eviction candidate
+        // again.
+        v->setFreqCounterValue(StoredValue::initialFreqCount +
+                               freqSketch->frequency(itm.getKey().hash()));
+    }
 
     statsEpilogue(*v);
+    tagInsert(hbl.getBucketNum(), *v);
 
-    values[hbl.getBucketNum()] = std::move(v);
-    return values[hbl.getBucketNum()].get();
+    chain = std::move(v);
+    return chain.get();
 }
 
 void HashTable::statsPrologue(const StoredValue& v) {
@@ -380,14 +699,15 @@ HashTable::unlocked_replaceByCopy(const HashBucketLock& hbl,
     auto releasedSv = unlocked_release(hbl, vToCopy.getKey());
 
     /* Copy the StoredValue and link it into the head of the bucket chain. */
-    auto newSv = valFact->copyStoredValue(
-            vToCopy, std::move(values[hbl.getBucketNum()]));
+    auto& chain = chainFor(hbl.getBucketNum());
+    auto newSv = valFact->copyStoredValue(vToCopy, std::move(chain));
 
     // Adding a new item into the HashTable; update stats.
     statsEpilogue(*newSv);
+    tagInsert(hbl.getBucketNum(), *newSv);
 
-    values[hbl.getBucketNum()] = std::move(newSv);
-    return {values[hbl.getBucketNum()].get(), std::move(releasedSv)};
+    chain = std::move(newSv);
+    return {chain.get(), std::move(releasedSv)};
 }
 
 void HashTable::unlocked_softDelete(const std::unique_lock<std::mutex>& htLock,
@@ -408,21 +728,113 @@ StoredValue* HashTable::unlocked_find(const DocKey& key,
                                       int bucket_num,
                                       WantsDeleted wantsDeleted,
                                       TrackReference trackReference) {
-    for (StoredValue* v = values[bucket_num].get(); v; v = v->getNext().get()) {
-        if (v->hasKey(key)) {
-            if (trackReference == TrackReference::Yes && !v->isDeleted()) {
-                v->referenced();
-            }
-            if (wantsDeleted == WantsDeleted::Yes || !v->isDeleted()) {
-                return v;
-            } else {
-                return NULL;
-            }
+    // Old buckets of an incremental resize have no tag directory.
+    StoredValue* v = (layout == Layout::Bucketized &&
+                      bucket_num < static_cast<int>(size))
+                             ? tagFind(bucket_num, key)
+                             : chainFind(bucket_num, key);
+    if (trackReference == TrackReference::Yes && freqSketch) {
+        recordAccess(key, v);
+    }
+    if (v) {
+        if (trackReference == TrackReference::Yes && !v->isDeleted()) {
+            v->referenced();
+        }
+        if (wantsDeleted == WantsDeleted::Yes || !v->isDeleted()) {
+            return v;
         }
     }
     return NULL;
 }
 
+void HashTable::recordAccess(const DocKey& key, StoredValue* v) {
+    freqSketch->increment(key.hash());
+    if (v && !v->isDeleted() &&
+        v->incrFreqCounterValue() == std::numeric_limits<uint8_t>::max()) {
+        freqCounterSaturated = true;
+    }
+}
+
+std::unique_ptr<FrequencySketch> HashTable::makeFreqSketch(
+        size_t tableSize) const {
+    if (evictionPolicy != EvictionPolicy::TinyLFU) {
+        return nullptr;
+    }
+    // One counter per row per bucket; the table is resized to roughly one
+    // item per bucket so this tracks the resident population.
+    return std::make_unique<FrequencySketch>(tableSize);
+}
+
+StoredValue* HashTable::chainFind(int bucket_num, const DocKey& key) {
+    for (StoredValue* v = chainFor(bucket_num).get(); v;
+         v = v->getNext().get()) {
+        if (v->hasKey(key)) {
+            return v;
+        }
+    }
+    return nullptr;
+}
+
+StoredValue* HashTable::tagFind(int bucket_num, const DocKey& key) {
+    const TagBucket& tb = tags[bucket_num];
+    const uint8_t tag = tagForHash(key.hash());
+    const uint8_t used = tb.numUsed();
+    for (uint8_t i = 0; i < used; ++i) {
+        if (tb.tag[i] == tag && tb.sv[i]->hasKey(key)) {
+            return tb.sv[i];
+        }
+    }
+    if (tb.isOverflowed()) {
+        return chainFind(bucket_num, key);
+    }
+    return nullptr;
+}
+
+void HashTable::tagInsert(int bucket_num, StoredValue& v) {
+    if (layout != Layout::Bucketized || bucket_num >= static_cast<int>(size)) {
+        return;
+    }
+    TagBucket& tb = tags[bucket_num];
+    const uint8_t used = tb.numUsed();
+    if (used < TagBucket::Slots) {
+        tb.tag[used] = tagForHash(v.getKey().hash());
+        tb.sv[used] = &v;
+        ++tb.count;
+    } else {
+        tb.count |= TagBucket::Overflow;
+    }
+}
+
+void HashTable::tagRemove(int bucket_num, const StoredValue& v) {
+    if (layout != Layout::Bucketized || bucket_num >= static_cast<int>(size)) {
+        return;
+    }
+    TagBucket& tb = tags[bucket_num];
+    if (tb.isOverflowed()) {
+        // An item not in the directory may now fit; rare enough (chains
+        // longer than Slots) to simply rebuild from the chain.
+        tagRebuild(bucket_num);
+        return;
+    }
+    const uint8_t used = tb.numUsed();
+    for (uint8_t i = 0; i < used; ++i) {
+        if (tb.sv[i] == &v) {
+            // Fill the hole with the last entry.
+            tb.tag[i] = tb.tag[used - 1];
+            tb.sv[i] = tb.sv[used - 1];
+            --tb.count;
+            return;
+        }
+    }
+}
+
+void HashTable::tagRebuild(int bucket_num) {
+    tags[bucket_num].count = 0;
+    for (StoredValue* v = values[bucket_num].get(); v; v = v->getNext().get()) {
+        tagInsert(bucket_num, *v);
+    }
+}
+
 void HashTable::unlocked_del(const HashBucketLock& hbl, const DocKey& key) {
     unlocked_release(hbl, key).reset();
 }
@@ -443,7 +855,7 @@ StoredValue::UniquePtr HashTable::unlocked_release(
 
     // Remove the first (should only be one) StoredValue with the given key.
     auto released = hashChainRemoveFirst(
-            values[hbl.getBucketNum()],
+            chainFor(hbl.getBucketNum()),
             [key](const StoredValue* v) { return v->hasKey(key); });
 
     if (!released) {
@@ -453,6 +865,7 @@ StoredValue::UniquePtr HashTable::unlocked_release(
                 "HashTable::unlocked_release: StoredValue to be released "
                 "not found in HashTable; possibly HashTable leak");
     }
+    tagRemove(hbl.getBucketNum(), *released);
 
     // Update statistics for the item which is now gone.
     statsPrologue(*released);
@@ -528,17 +941,20 @@ void HashTable::visit(HashTableVisitor &visitor) {
     lh.unlock();
 
     size_t visited = 0;
+    // Includes the old buckets of an in-progress incremental resize; they
+    // can't be migrated while we are visiting.
+    const int total = size + oldSize;
     for (int l = 0; isActive() && l < static_cast<int>(mutexes.size()); l++) {
-        for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
+        for (int i = l; i < total; i = nextBucketForLock(i, l)) {
             // (re)acquire mutex on each HashBucket, to minimise any impact
             // on front-end threads.
             HashBucketLock lh(i, mutexes[l]);
 
-            StoredValue* v = values[i].get();
+            StoredValue* v = chainFor(i).get();
             if (v) {
                 // TODO: Perf: This check seems costly - do we think it's still
                 // worth keeping?
-                auto hashbucket = getBucketForHash(v->getKey().hash());
+                auto hashbucket = locateBucket(v->getKey().hash());
                 if (i != hashbucket) {
                     throw std::logic_error("HashTable::visit: inconsistency "
                             "between StoredValue's calculated hashbucket "
@@ -562,17 +978,22 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
         return;
     }
     size_t visited = 0;
+    // As visit(); acquire a mutex so no (incremental) resize can be
+    // midway through changing the bucket layout we are about to walk.
+    std::unique_lock<std::mutex> guard(mutexes[0]);
     VisitorTracker vt(&visitors);
+    guard.unlock();
 
+    const int total = size + oldSize;
     for (int l = 0; l < static_cast<int>(mutexes.size()); l++) {
         LockHolder lh(mutexes[l]);
-        for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
+        for (int i = l; i < total; i = nextBucketForLock(i, l)) {
             size_t depth = 0;
-            StoredValue* p = values[i].get();
+            StoredValue* p = chainFor(i).get();
             if (p) {
                 // TODO: Perf: This check seems costly - do we think it's still
                 // worth keeping?
-                auto hashbucket = getBucketForHash(p->getKey().hash());
+                auto hashbucket = locateBucket(p->getKey().hash());
                 if (i != hashbucket) {
                     throw std::logic_error("HashTable::visit: inconsistency "
                             "between StoredValue's calculated hashbucket "
@@ -617,28 +1038,53 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
     VisitorTracker vt(&visitors);
     lh.unlock();
 
+    // During an incremental resize the old buckets (numbered from `size`) of
+    // every lock are visited before any of the new buckets. Migration only
+    // moves items from old buckets to new ones - from earlier in the visit
+    // order to later - so however many buckets are migrated while we are
+    // paused nothing can be skipped; an item migrated out of an old bucket
+    // we have already visited is just visited again. Only a resize beginning
+    // or completing since the position was taken changes the layout under
+    // it, in which case start again from the beginning.
+    const uint64_t generation = resizeGeneration;
+    Position start = start_pos;
+    if (start.lock < mutexes.size() && start.generation != generation) {
+        start = Position();
+    }
+
     // Start from the requested lock number if in range.
-    size_t lock = (start_pos.lock < mutexes.size()) ? start_pos.lock : 0;
+    size_t lock = (start.lock < mutexes.size()) ? start.lock : 0;
     size_t hash_bucket = 0;
+    bool old_buckets =
+            oldSize != 0 && (start.lock >= mutexes.size() ||
+                             start.ht_size != size || start.old_buckets);
+
+    const size_t total = size + oldSize;
 
-    for (; isActive() && !paused && lock < mutexes.size(); lock++) {
+    while (isActive() && !paused && lock < mutexes.size()) {
+        const size_t first = old_buckets ? size + lock : lock;
+        const size_t end = old_buckets ? total : size.load();
 
         // If the bucket position is *this* lock, then start from the
         // recorded bucket (as long as we haven't resized).
-        hash_bucket = lock;
-        if (start_pos.lock == lock &&
-            start_pos.ht_size == size &&
-            start_pos.hash_bucket < size) {
-            hash_bucket = start_pos.hash_bucket;
+        hash_bucket = first;
+        if (start.lock == lock &&
+            start.ht_size == size &&
+            start.old_buckets == old_buckets &&
+            start.hash_bucket >= first &&
+            start.hash_bucket < end &&
+            mutexForBucket(start.hash_bucket) == lock) {
+            hash_bucket = start.hash_bucket;
         }
 
         // Iterate across all values in the hash buckets owned by this lock.
         // Note: we don't record how far into the bucket linked-list we
         // pause at; so any restart will begin from the next bucket.
-        for (; !paused && hash_bucket < size; hash_bucket += mutexes.size()) {
+        for (; !paused && hash_bucket < end;
+             hash_bucket += mutexes.size()) {
             HashBucketLock lh(hash_bucket, mutexes[lock]);
 
-            StoredValue* v = values[hash_bucket].get();
+            StoredValue* v = chainFor(hash_bucket).get();
             while (!paused && v) {
                 StoredValue* tmp = v->getNext().get();
                 paused = !visitor.visit(lh, *v);
@@ -648,22 +1094,29 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
 
         // If the visitor paused us before we visited all hash buckets owned
         // by this lock, we don't want to skip the remaining hash buckets, so
-        // stop the outer for loop from advancing to the next lock.
-        if (paused && hash_bucket < size) {
+        // stop the outer loop from advancing to the next lock.
+        if (paused && hash_bucket < end) {
             break;
         }
 
-        // Finished all buckets owned by this lock. Set hash_bucket to 'size'
-        // to give a consistent marker for "end of lock".
+        // Finished all buckets owned by this lock; move on to the next lock,
+        // or from the old buckets on to the new ones. Set hash_bucket to
+        // 'size' to give a consistent marker for "start of lock".
+        if (++lock == mutexes.size() && old_buckets) {
+            lock = 0;
+            old_buckets = false;
+        }
         hash_bucket = size;
     }
 
     // Return the *next* location that should be visited.
-    return HashTable::Position(size, lock, hash_bucket);
+    return HashTable::Position(
+            size, lock, hash_bucket, generation, old_buckets);
 }
 
 HashTable::Position HashTable::endPosition() const  {
-    return HashTable::Position(size, mutexes.size(), size);
+    return HashTable::Position(
+            size, mutexes.size(), size, resizeGeneration, false);
 }
 
 bool HashTable::unlocked_ejectItem(StoredValue*& vptr,
@@ -688,12 +1141,13 @@ bool HashTable::unlocked_ejectItem(StoredValue*& vptr,
         if (vptr->eligibleForEviction(policy)) {
             reduceMetaDataSize(stats, vptr->metaDataSize());
             reduceCacheSize(vptr->size());
-            int bucket_num = getBucketForHash(vptr->getKey().hash());
+            int bucket_num = locateBucket(vptr->getKey().hash());
 
             // Remove the item from the hash table.
             auto removed = hashChainRemoveFirst(
-                    values[bucket_num],
+                    chainFor(bucket_num),
                     [vptr](const StoredValue* v) { return v == vptr; });
+            tagRemove(bucket_num, *removed);
 
             if (removed->isResident()) {
                 ++stats.numValueEjects;
@@ -717,7 +1171,12 @@ bool HashTable::unlocked_ejectItem(StoredValue*& vptr,
 
 std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
     auto lh = getLockedBucket(slot);
-    for (StoredValue* v = values[slot].get(); v; v = v->getNext().get()) {
+    // The table may have been resized since the slot was chosen.
+    if (slot >= static_cast<int>(size + oldSize) ||
+        lh.getHTLock().mutex() != &mutexes[mutexForBucket(slot)]) {
+        return nullptr;
+    }
+    for (StoredValue* v = chainFor(slot).get(); v; v = v->getNext().get()) {
         if (!v->isTempItem() && !v->isDeleted() && v->isResident()) {
             return v->toItem(false, 0);
         }
@@ -806,6 +1265,9 @@ std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
        << " numDeleted:" << ht.getNumDeletedItems()
        << " numNonResident:" << ht.getNumInMemoryNonResItems()
        << " numTemp:" << ht.getNumTempItems()
+       << " layout:"
+       << (ht.getLayout() == HashTable::Layout::Bucketized ? "bucketized"
+                                                            : "chained")
        << " values: " << std::endl;
     for (const auto& chain : ht.values) {
         if (chain) {
@@ -815,5 +1277,15 @@ std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
             }
         }
     }
+    if (ht.oldSize != 0) {
+        os << "  resizing from " << ht.oldSize << " buckets ("
+           << ht.numMigrated << " migrated), old values: " << std::endl;
+        for (const auto& chain : ht.oldValues) {
+            for (StoredValue* sv = chain.get(); sv != nullptr;
+                 sv = sv->getNext().get()) {
+                os << "    " << *sv << std::endl;
+            }
+        }
+    }
     return os;
 }
@@ -18,11 +18,15 @@
 #pragma once
 
 #include "config.h"
+#include "frequency_sketch.h"
 #include "storeddockey.h"
 #include "stored-value.h"
 
 #include <platform/histogram.h>
 #include <platform/non_negative_counter.h>
+#include <platform/processclock.h>
+
+#include <chrono>
 
 class AbstractStoredValueFactory;
 class HashTableStatVisitor;
@@ -95,6 +99,50 @@ enum class TempAddStatus : uint8_t {
 class HashTable {
 public:
 
+    /**
+     * Physical layout of the hash buckets.
+     *
+     * Chained: each hash bucket is a singly-linked chain of StoredValues, a
+     * lookup dereferences every StoredValue in the chain until the key
+     * matches.
+     *
+     * Bucketized: the chains still own the StoredValues (so visiting,
+     * Position and HashBucketLock semantics are unchanged), but every hash
+     * bucket additionally has a cache-line sized TagBucket holding a short
+     * hash tag and pointer for each StoredValue in the chain. A probe scans
+     * the tags in a single cache line and only dereferences StoredValues
+     * whose tag matches.
+     */
+    enum class Layout : uint8_t { Chained, Bucketized };
+
+    /**
+     * Convert the "ht_layout" configuration string to a Layout.
+     *
+     * @throws std::invalid_argument if the string is not a known layout.
+     */
+    static Layout layoutFromString(const std::string& layout);
+
+    /**
+     * How the ItemPager chooses which items of this HashTable to evict.
+     *
+     * NRU: the 2-bit not-recently-used value of each StoredValue, together
+     * with a random phase which evicts referenced items.
+     *
+     * TinyLFU: each StoredValue has a logarithmic access frequency counter,
+     * and the HashTable keeps a FrequencySketch of accesses to all keys
+     * (resident or not) which seeds the counter of newly created
+     * StoredValues. The pager evicts the least frequently used items.
+     */
+    enum class EvictionPolicy : uint8_t { NRU, TinyLFU };
+
+    /**
+     * Convert the "ht_eviction_policy" configuration string to an
+     * EvictionPolicy.
+     *
+     * @throws std::invalid_argument if the string is not a known policy.
+     */
+    static EvictionPolicy evictionPolicyFromString(const std::string& policy);
+
     /**
      * Represents a position within the hashtable.
      *
@@ -105,7 +153,13 @@ public:
     public:
         // Allow default construction positioned at the start,
         // but nothing else.
-        Position() : ht_size(0), lock(0), hash_bucket(0) {}
+        Position()
+            : ht_size(0),
+              lock(0),
+              hash_bucket(0),
+              generation(0),
+              old_buckets(false) {
+        }
 
         bool operator==(const Position& other) const {
             return (ht_size == other.ht_size) &&
@@ -118,10 +172,17 @@ public:
         }
 
     private:
-        Position(size_t ht_size_, int lock_, int hash_bucket_)
-          : ht_size(ht_size_),
-            lock(lock_),
-            hash_bucket(hash_bucket_) {}
+        Position(size_t ht_size_,
+                 int lock_,
+                 int hash_bucket_,
+                 uint64_t generation_,
+                 bool old_buckets_)
+            : ht_size(ht_size_),
+              lock(lock_),
+              hash_bucket(hash_bucket_),
+              generation(generation_),
+              old_buckets(old_buckets_) {
+        }
 
         // Size of the hashtable when the position was created.
         size_t ht_size;
@@ -129,6 +190,13 @@ public:
         size_t lock;
         // hash bucket ID (under the given lock) we are up to.
         size_t hash_bucket;
+        // Resize generation when the position was created; a position is
+        // only valid for the bucket layout it was created with. Not part of
+        // the comparison.
+        uint64_t generation;
+        // Are we up to the old buckets of an incremental resize (visited
+        // before the new ones)?
+        bool old_buckets;
 
         friend class HashTable;
         friend std::ostream& operator<<(std::ostream& os, const Position& pos);
@@ -179,18 +247,45 @@ public:
      * @param svFactory Factory to use for constructing stored values
      * @param initialSize the number of hash table buckets to initially create.
      * @param locks the number of locks in the hash table
+     * @param layout the physical layout of the hash buckets
+     * @param evictionPolicy how the ItemPager selects items to evict
      */
     HashTable(EPStats& st,
               std::unique_ptr<AbstractStoredValueFactory> svFactory,
               size_t initialSize,
-              size_t locks);
+              size_t locks,
+              Layout layout = Layout::Chained,
+              EvictionPolicy evictionPolicy = EvictionPolicy::NRU);
 
     ~HashTable();
 
     size_t memorySize() {
         return sizeof(HashTable)
             + (size * sizeof(StoredValue*))
-            + (mutexes.size() * sizeof(std::mutex));
+            + (oldSize * (sizeof(StoredValue*) + sizeof(std::atomic<bool>)))
+            + (mutexes.size() * sizeof(std::mutex))
+            + tags.memorySize()
+            + (freqSketch ? freqSketch->memorySize() : 0);
+    }
+
+    /**
+     * Get the physical layout of the hash buckets.
+     */
+    Layout getLayout() const {
+        return layout;
+    }
+
+    EvictionPolicy getEvictionPolicy() const {
+        return evictionPolicy;
+    }
+
+    /**
+     * Has any StoredValue's frequency counter saturated since the last call?
+     * If so the ItemPager should decay (halve) the counters when it next
+     * visits this HashTable. Clears the flag.
+     */
+    bool testAndClearFreqCounterSaturated() {
+        return freqCounterSaturated.exchange(false);
     }
 
     /**
@@ -289,9 +384,75 @@ public:
 
     /**
      * Resize to the specified size.
+     *
+     * All items are moved to the new table while holding every lock of the
+     * HashTable. Does nothing if an incremental resize is in progress.
      */
     void resize(size_t to);
 
+    /**
+     * Begin an incremental resize to fit the current data.
+     *
+     * @return true if a resize was started.
+     */
+    bool beginIncrementalResize();
+
+    /**
+     * Begin an incremental resize to the specified size.
+     *
+     * Only swaps in a new, empty bucket array (allocated before the locks
+     * are taken); the items stay in the old array until their bucket is
+     * migrated, either by resizeStep() or by a front-end operation which
+     * finds its key in a not yet migrated bucket. Lookups consult the old
+     * bucket for a key until it has been migrated, and the new bucket
+     * afterwards.
+     *
+     * @return true if a resize was started; false if the size is unchanged,
+     *         another resize is in progress or visitors are active.
+     */
+    bool beginIncrementalResize(size_t to);
+
+    /**
+     * Migrate old buckets of an in-progress incremental resize to the new
+     * table, holding all locks for no longer than (approximately) the given
+     * budget. Completes the resize once every old bucket has been migrated.
+     *
+     * @return true if progress was made; false if there is no resize in
+     *         progress or it could not proceed as visitors are active.
+     */
+    bool resizeStep(std::chrono::microseconds budget);
+
+    /**
+     * Is an incremental resize in progress?
+     */
+    bool isResizing() const {
+        return oldSize != 0;
+    }
+
+    /**
+     * Get the number of old buckets of an in-progress incremental resize
+     * (zero if none is in progress).
+     */
+    size_t getResizeBucketsTotal() const {
+        return oldSize;
+    }
+
+    /**
+     * Get the number of old buckets migrated so far by an in-progress
+     * incremental resize.
+     */
+    size_t getResizeBucketsMigrated() const {
+        return numMigrated;
+    }
+
+    /**
+     * Get the longest time all locks of this HashTable have been held by a
+     * resize (or a single incremental resize step).
+     */
+    std::chrono::microseconds getMaxResizeStall() const {
+        return std::chrono::microseconds(maxResizeStallUs.load());
+    }
+
     /**
      * Find the item with the given key.
      *
@@ -420,9 +581,16 @@ public:
                 throw std::logic_error("HashTable::getLockedBucket: "
                         "Cannot call on a non-active object");
             }
+            if (oldSize != 0) {
+                HashBucketLock rv = getLockedBucketDuringResize(h);
+                if (rv.getHTLock()) {
+                    return rv;
+                }
+                continue;
+            }
             int bucket = getBucketForHash(h);
             HashBucketLock rv(bucket, mutexes[mutexForBucket(bucket)]);
-            if (bucket == getBucketForHash(h)) {
+            if (oldSize == 0 && bucket == getBucketForHash(h)) {
                 return rv;
             }
         }
@@ -655,6 +823,62 @@ private:
     // The container for actually holding the StoredValues.
     using table_type = std::vector<StoredValue::UniquePtr>;
 
+    /**
+     * Per hash bucket directory used by the Bucketized layout. Exactly one
+     * cache line; holds the tag and address of up to `Slots` StoredValues
+     * of the bucket's chain. If the chain is longer than that the Overflow
+     * flag is set in `count` and lookups which miss in the directory fall
+     * back to walking the chain.
+     */
+    struct TagBucket {
+        static const uint8_t Slots = 7;
+        static const uint8_t Overflow = 0x80;
+
+        uint8_t numUsed() const {
+            return count & ~Overflow;
+        }
+
+        bool isOverflowed() const {
+            return (count & Overflow) != 0;
+        }
+
+        std::array<uint8_t, Slots> tag;
+        uint8_t count;
+        std::array<StoredValue*, Slots> sv;
+    };
+
+    /**
+     * Cache-line aligned array of TagBuckets, one per hash bucket. Empty
+     * (and zero-sized) for the Chained layout.
+     */
+    class TagDirectory {
+    public:
+        static const size_t CacheLineSize = 64;
+
+        /// (Re)allocate the directory for n buckets, all empty.
+        void reset(size_t n);
+
+        /// Mark every bucket as empty without reallocating.
+        void clear();
+
+        size_t memorySize() const {
+            return storageSize;
+        }
+
+        TagBucket& operator[](size_t bucket) {
+            return base[bucket];
+        }
+
+    private:
+        std::unique_ptr<uint8_t[]> storage;
+        size_t storageSize = 0;
+        TagBucket* base = nullptr;
+        size_t numBuckets = 0;
+    };
+
+    static_assert(sizeof(TagBucket) <= TagDirectory::CacheLineSize,
+                  "HashTable::TagBucket must fit in a single cache line");
+
     friend class StoredValue;
     friend std::ostream& operator<<(std::ostream& os, const HashTable& ht);
 
@@ -668,6 +892,10 @@ private:
     // in `values`
     std::atomic<size_t> size;
     table_type values;
+    const Layout layout;
+    // Tag directory for the Bucketized layout; same number of buckets as
+    // `values` and protected by the same locks.
+    TagDirectory tags;
     std::vector<std::mutex> mutexes;
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
@@ -690,20 +918,139 @@ private:
     std::atomic<uint64_t> maxDeletedRevSeqno;
     bool                 activeState;
 
+    /*
+     * Incremental resize state. While a resize is in progress the previous
+     * bucket array is kept in `oldValues`; an old bucket is addressed
+     * (HashBucketLock, Position, visitors) as `size + old bucket` and guarded
+     * by the lock of its old bucket number. The sizes and arrays only change
+     * while holding all locks; migrated flags only change from false to true
+     * while holding the locks of the old bucket and of every new bucket its
+     * items move to.
+     */
+    // Number of buckets in `oldValues`; zero if no resize is in progress.
+    std::atomic<size_t> oldSize;
+    table_type oldValues;
+    std::vector<std::atomic<bool>> migrated;
+    std::atomic<size_t> numMigrated;
+    // Next old bucket resizeStep() will migrate.
+    size_t migrateCursor;
+    // Incremented whenever a resize begins or completes.
+    std::atomic<uint64_t> resizeGeneration;
+    // Longest time all locks were held by a resize.
+    std::atomic<uint64_t> maxResizeStallUs;
+
+    const EvictionPolicy evictionPolicy;
+    // Access frequency of keys, for the TinyLFU eviction policy (null
+    // otherwise). Only used while holding a bucket lock, and sized (and
+    // replaced) with the table while holding all locks.
+    std::unique_ptr<FrequencySketch> freqSketch;
+    // Set when a frequency counter reaches its maximum.
+    std::atomic<bool> freqCounterSaturated;
+
+    /// Create a FrequencySketch for a table of the given size, or null if
+    /// the eviction policy does not use one.
+    std::unique_ptr<FrequencySketch> makeFreqSketch(size_t tableSize) const;
+
+    /// Record an access to the given key, which may not be resident.
+    void recordAccess(const DocKey& key, StoredValue* v);
+
     int getBucketForHash(int h) {
         return abs(h % static_cast<int>(size));
     }
 
+    int getOldBucketForHash(int h) {
+        return abs(h % static_cast<int>(oldSize));
+    }
+
     inline size_t mutexForBucket(size_t bucket_num) {
         if (!isActive()) {
             throw std::logic_error("HashTable::mutexForBucket: Cannot call on a "
                     "non-active object");
         }
+        if (bucket_num >= size) {
+            // Old bucket of an incremental resize.
+            bucket_num -= size;
+        }
         return bucket_num % mutexes.size();
     }
 
+    /// The chain of the given (new or old) bucket.
+    StoredValue::UniquePtr& chainFor(int bucket_num) {
+        if (bucket_num < static_cast<int>(size)) {
+            return values[bucket_num];
+        }
+        return oldValues[bucket_num - size];
+    }
+
+    /**
+     * The (new or old) bucket the given hash currently lives in. The caller
+     * must hold the lock of that bucket.
+     */
+    int locateBucket(int h);
+
+    /**
+     * The bucket following `bucket_num` which is guarded by the given lock,
+     * moving on to the old buckets (if any) after the new ones.
+     */
+    size_t nextBucketForLock(size_t bucket_num, size_t lock) {
+        size_t next = bucket_num + mutexes.size();
+        if (bucket_num < size && next >= size) {
+            next = size + lock;
+        }
+        return next;
+    }
+
+    /// Size resize() / beginIncrementalResize() should resize to.
+    size_t getTargetSize();
+
+    /**
+     * getLockedBucketForHash() while an incremental resize is in progress.
+     * Returns an unlocked HashBucketLock if the resize state changed and the
+     * caller should retry.
+     */
+    HashBucketLock getLockedBucketDuringResize(int h);
+
+    /**
+     * Migrate the given old bucket if the locks of all its destination
+     * buckets can be acquired without blocking. The caller holds the lock
+     * of the old bucket.
+     *
+     * @return true if the bucket was migrated.
+     */
+    bool tryMigrateBucket(size_t old_bucket);
+
+    /// Max number of locks (besides its own) tryMigrateBucket() takes.
+    static const size_t maxMigrateLocks = 8;
+
+    /// Move the items of the given old bucket to the new table.
+    void migrateBucket(size_t old_bucket);
+
+    void recordResizeStall(ProcessClock::duration stall);
+
     std::unique_ptr<Item> getRandomKeyFromSlot(int slot);
 
+    /// Compute the TagBucket tag for the given key hash.
+    static uint8_t tagForHash(uint32_t h) {
+        // Use different bits to the bucket selection (h % size), mixed so
+        // that similar keys don't share tags.
+        return static_cast<uint8_t>((h * 0x9E3779B1u) >> 24);
+    }
+
+    /// Search the given bucket's chain for key.
+    StoredValue* chainFind(int bucket_num, const DocKey& key);
+
+    /// Search the given bucket's TagBucket (then chain if overflowed) for key.
+    StoredValue* tagFind(int bucket_num, const DocKey& key);
+
+    /// Record a StoredValue newly linked into the given bucket's chain.
+    void tagInsert(int bucket_num, StoredValue& v);
+
+    /// Forget a StoredValue just unlinked from the given bucket's chain.
+    void tagRemove(int bucket_num, const StoredValue& v);
+
+    /// Recreate the given bucket's TagBucket from its chain.
+    void tagRebuild(int bucket_num);
+
     /** Searches for the first element in the specified hashChain which matches
      * predicate p, and unlinks it from the chain.
      *
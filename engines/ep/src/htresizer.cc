@@ -24,6 +24,7 @@
 #include <phosphor/phosphor.h>
 #include <platform/make_unique.h>
 
+#include <chrono>
 #include <memory>
 
 /**
@@ -31,11 +32,36 @@
  */
 class ResizingVisitor : public VBucketVisitor {
 public:
-    ResizingVisitor() { }
+    ResizingVisitor(bool incremental, std::chrono::microseconds stepBudget)
+        : incremental(incremental), stepBudget(stepBudget) {
+    }
 
     void visitBucket(VBucketPtr &vb) override {
-        vb->ht.resize();
+        if (!incremental) {
+            vb->ht.resize();
+            return;
+        }
+
+        if (!vb->ht.isResizing()) {
+            vb->ht.beginIncrementalResize();
+        }
+        // Take one step per run of the task, so the NonIO thread is given
+        // back between steps; carry on with this vBucket in the next run
+        // until it is done. Give up (until the next resizer run) if
+        // visitors block the migration; lookups continue migrating
+        // meanwhile.
+        yielded = vb->ht.isResizing() && vb->ht.resizeStep(stepBudget) &&
+                  vb->ht.isResizing();
     }
+
+    bool yieldedMidBucket() override {
+        return yielded;
+    }
+
+private:
+    const bool incremental;
+    const std::chrono::microseconds stepBudget;
+    bool yielded = false;
 };
 
 HashtableResizerTask::HashtableResizerTask(KVBucketIface* s, double sleepTime)
@@ -48,13 +74,18 @@ HashtableResizerTask::HashtableResizerTask(KVBucketIface* s, double sleepTime)
 
 bool HashtableResizerTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "HashtableResizerTask");
-    auto pv = std::make_unique<ResizingVisitor>();
+    auto& config = engine->getConfiguration();
+    auto pv = std::make_unique<ResizingVisitor>(
+            config.getHtResizeMode() == "incremental",
+            std::chrono::microseconds(config.getHtResizeStepBudgetUs()));
 
-    // [per-VBucket Task] While a Hashtable is resizing no user
-    // requests can be performed (the resizing process needs to
+    // [per-VBucket Task] While a Hashtable is resizing in blocking mode no
+    // user requests can be performed (the resizing process needs to
     // acquire all HT locks). As such we are sensitive to the duration
     // of this task - we want to log anything which has a
-    // non-negligible impact on frontend operations.
+    // non-negligible impact on frontend operations. (In incremental mode
+    // the locks are only held for ht_resize_step_budget_us at a time; see
+    // the resize_max_stall_us hash stat.)
     const auto maxExpectedDuration = std::chrono::milliseconds(50);
 
     store->visit(std::move(pv),
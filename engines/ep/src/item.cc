@@ -26,6 +26,7 @@
 #include <xattr/utils.h>
 
 #include  <iomanip>
+#include <memory>
 
 std::atomic<uint64_t> Item::casCounter(1);
 const uint32_t Item::metaDataSize(2*sizeof(uint32_t) + 2*sizeof(uint64_t) + 2);
@@ -40,11 +41,11 @@ Item::Item(const DocKey& k,
            uint16_t vbid,
            uint64_t sno,
            uint8_t nru_value)
-    : metaData(theCas, sno, fl, exp),
+    : queuedTime(ep_current_time()),
+      metaData(theCas, sno, fl, exp),
       value(val),
       key(k),
       bySeqno(i),
-      queuedTime(ep_current_time()),
       vbucketId(vbid),
       deleted(false),
       op(k.getDocNamespace() == DocNamespace::System ? queue_op::system_event
@@ -69,10 +70,10 @@ Item::Item(const DocKey& k,
            uint16_t vbid,
            uint64_t sno,
            uint8_t nru_value)
-    : metaData(theCas, sno, fl, exp),
+    : queuedTime(ep_current_time()),
+      metaData(theCas, sno, fl, exp),
       key(k),
       bySeqno(i),
-      queuedTime(ep_current_time()),
       vbucketId(vbid),
       deleted(false),
       op(k.getDocNamespace() == DocNamespace::System ? queue_op::system_event
@@ -93,10 +94,10 @@ Item::Item(const DocKey& k,
            const uint64_t revSeq,
            const int64_t bySeq,
            uint8_t nru_value)
-    : metaData(),
+    : queuedTime(ep_current_time()),
+      metaData(),
       key(k),
       bySeqno(bySeq),
-      queuedTime(ep_current_time()),
       vbucketId(vb),
       deleted(false),
       op(o),
@@ -109,11 +110,11 @@ Item::Item(const DocKey& k,
 }
 
 Item::Item(const Item& other)
-    : metaData(other.metaData),
+    : queuedTime(other.queuedTime),
+      metaData(other.metaData),
       value(other.value),
       key(other.key),
       bySeqno(other.bySeqno.load()),
-      queuedTime(other.queuedTime),
       vbucketId(other.vbucketId),
       deleted(other.deleted),
       op(other.op),
@@ -123,6 +124,7 @@ Item::Item(const Item& other)
 }
 
 Item::~Item() {
+    delete compressedValue.load();
     ObjectRegistry::onDeleteItem(this);
 }
 
@@ -245,6 +247,47 @@ bool Item::compressValue() {
     return true;
 }
 
+value_t Item::getCompressedValue(bool& compressedNow) const {
+    compressedNow = false;
+    auto* cached = compressedValue.load(std::memory_order_acquire);
+    if (cached == nullptr) {
+        auto compressed = std::make_unique<CompressedValue>();
+        cb::compression::Buffer deflated;
+        if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
+                                     {getData(), getNBytes()},
+                                     deflated) &&
+            deflated.size() <= getNBytes()) {
+            compressed->value.reset(TaggedPtr<Blob>(
+                    Blob::New(deflated.data(), deflated.size())));
+        }
+        compressedNow = true;
+
+        // If another thread got there first use its copy (and drop ours).
+        if (compressedValue.compare_exchange_strong(
+                    cached, compressed.get(), std::memory_order_acq_rel)) {
+            cached = compressed.release();
+        }
+    }
+    return cached->value;
+}
+
+size_t Item::getCompressedValueMemSize() const {
+    const auto* cached = compressedValue.load(std::memory_order_acquire);
+    if (cached == nullptr) {
+        return 0;
+    }
+    return sizeof(CompressedValue) +
+           (cached->value ? cached->value->getSize() : 0);
+}
+
+size_t Item::claimCompressedValueMemSize() const {
+    auto* cached = compressedValue.load(std::memory_order_acquire);
+    if (cached == nullptr || cached->claimed.exchange(true)) {
+        return 0;
+    }
+    return getCompressedValueMemSize();
+}
+
 bool Item::decompressValue() {
     uint8_t datatype = getDataType();
     if (mcbp::datatype::is_snappy(datatype)) {
@@ -190,6 +190,37 @@ public:
     /* Snappy uncompress value and update datatype */
     bool decompressValue();
 
+    /**
+     * Get a snappy compressed copy of this item's (uncompressed) value.
+     *
+     * The first call compresses the value and keeps the result with the
+     * item, so everyone sending the same (checkpoint) item - for example
+     * every DCP stream which negotiated compression - shares a single
+     * compression. Safe to call concurrently.
+     *
+     * @param [out] compressedNow true if this call performed the compression
+     * @return the compressed value, or an empty value_t if the value doesn't
+     *         compress (or compression failed)
+     */
+    value_t getCompressedValue(bool& compressedNow) const;
+
+    /**
+     * Memory used by the compressed copy of the value kept by
+     * getCompressedValue(), or zero if there isn't one. Included in size().
+     */
+    size_t getCompressedValueMemSize() const;
+
+    /**
+     * Claim the memory of the compressed copy of the value (if any) so the
+     * checkpoint holding this item can charge it to its memory usage; the
+     * copy is made after the item was queued (and charged) to the
+     * checkpoint. Only the first call after the copy is made returns
+     * non-zero, however many streams share it.
+     *
+     * @return bytes to charge to the item's checkpoint
+     */
+    size_t claimCompressedValueMemSize() const;
+
     const char *getData() const {
         return value.get() ? value->getData() : NULL;
     }
@@ -279,7 +310,21 @@ public:
         return false;
     }
 
+    /**
+     * Memory used by this item, including any compressed copy of its value
+     * kept for DCP.
+     */
     size_t size(void) const {
+        return sizeWithoutCompressedValue() + getCompressedValueMemSize();
+    }
+
+    /**
+     * Memory used by this item excluding the compressed copy of its value,
+     * which is only made after the item is queued. This is what the disk
+     * write queue stats count for the item, both when it is queued and
+     * when it is flushed.
+     */
+    size_t sizeWithoutCompressedValue() const {
         return sizeof(Item) + key.size() + getValMemSize();
     }
 
@@ -433,6 +478,8 @@ private:
         setValue(TaggedPtr<Blob>(data));
     }
 
+    // Declared first so it packs alongside the RCValue refcount.
+    uint32_t queuedTime;
     ItemMetaData metaData;
     value_t value;
     StoredDocKey key;
@@ -442,7 +489,6 @@ private:
     // checkpoints when updating a the open checkpointID - see
     // CheckpointManager::setOpenCheckpointId_UNLOCKED
     std::atomic<int64_t> bySeqno;
-    uint32_t queuedTime;
     uint16_t vbucketId;
     bool deleted;
     queue_op op;
@@ -455,6 +501,15 @@ private:
     // this cached version.
     mutable protocol_binary_datatype_t datatype = PROTOCOL_BINARY_RAW_BYTES;
 
+    // Compressed copy of the value, created on demand by
+    // getCompressedValue(). Not copied with the item.
+    struct CompressedValue {
+        value_t value;
+        // Has the copy's memory been claimed by claimCompressedValueMemSize()?
+        std::atomic<bool> claimed{false};
+    };
+    mutable std::atomic<CompressedValue*> compressedValue{nullptr};
+
     static std::atomic<uint64_t> casCounter;
     static const uint32_t metaDataSize;
     DISALLOW_ASSIGN(Item);
@@ -0,0 +1,68 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "item_eviction.h"
+
+#include "stored-value.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+const size_t ItemEviction::learningPopulation;
+
+uint8_t ItemEviction::incrFreqCounter(uint8_t freq) {
+    // Each increment is 10% less likely than the last (once past the
+    // initial value), so ~3000 accesses are needed to saturate the counter.
+    static const double incFactor = 0.1;
+    static thread_local std::minstd_rand generator(std::random_device{}());
+
+    if (freq == std::numeric_limits<uint8_t>::max()) {
+        return freq;
+    }
+    const double base =
+            std::max(int(freq) - int(StoredValue::initialFreqCount), 0) *
+            incFactor;
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    if (distribution(generator) * (base + 1) < 1.0) {
+        ++freq;
+    }
+    return freq;
+}
+
+ItemEviction::Threshold ItemEviction::getFreqThreshold(double percent) const {
+    Threshold threshold;
+    if (population == 0 || percent <= 0) {
+        return threshold;
+    }
+
+    const double target = percent * population;
+    size_t below = 0;
+    for (size_t freq = 0; freq < freqHistogram.size(); ++freq) {
+        const auto atFreq = freqHistogram[freq];
+        if (below + atFreq >= target) {
+            threshold.value = static_cast<uint8_t>(freq);
+            threshold.probabilityAtValue = (target - below) / atFreq;
+            return threshold;
+        }
+        below += atFreq;
+    }
+    // percent >= 1; evict everything.
+    threshold.value = 255;
+    threshold.probabilityAtValue = 1;
+    return threshold;
+}
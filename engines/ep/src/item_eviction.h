@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "config.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Chooses which items the ItemPager evicts under the TinyLFU eviction
+ * policy.
+ *
+ * As the pager visits items it records their frequency counters in a
+ * histogram; an item is evicted if its counter falls within the lowest
+ * `percent` of the counters seen so far. The threshold is recomputed every
+ * `learningPopulation` items, so the first items visited are judged against
+ * the threshold of the previous pager run rather than an empty histogram.
+ */
+class ItemEviction {
+public:
+    /// Number of items seen between recomputing the threshold.
+    static const size_t learningPopulation = 100;
+
+    /**
+     * Eviction threshold for a given percentage: items with a lower
+     * frequency than `value` should be evicted, and items with exactly
+     * `value` evicted with probability `probabilityAtValue` (so that a
+     * large number of items sharing a counter value are not all evicted).
+     */
+    struct Threshold {
+        uint8_t value = 0;
+        double probabilityAtValue = 0;
+    };
+
+    /**
+     * Logarithmically increment an item frequency counter: the larger the
+     * counter the less likely it is to be incremented.
+     *
+     * @return the new counter value (255 once saturated)
+     */
+    static uint8_t incrFreqCounter(uint8_t freq);
+
+    /// Record the frequency counter of a visited item.
+    void addFreqValue(uint8_t freq) {
+        ++freqHistogram[freq];
+        ++population;
+    }
+
+    /// @return the number of items recorded.
+    size_t getPopulation() const {
+        return population;
+    }
+
+    /**
+     * Compute the threshold below which the given proportion of the recorded
+     * items lie.
+     *
+     * @param percent proportion of items to evict (0-1)
+     */
+    Threshold getFreqThreshold(double percent) const;
+
+    /**
+     * Should an item with the given frequency be evicted?
+     *
+     * @param freq the item's frequency counter
+     * @param threshold the current eviction threshold
+     * @param r uniform random number in [0, 1]
+     */
+    static bool shouldEvict(uint8_t freq, Threshold threshold, double r) {
+        return freq < threshold.value ||
+               (freq == threshold.value && r < threshold.probabilityAtValue);
+    }
+
+    void reset() {
+        freqHistogram.fill(0);
+        population = 0;
+    }
+
+private:
+    std::array<size_t, 256> freqHistogram{};
+    size_t population = 0;
+};
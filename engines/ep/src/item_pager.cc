@@ -23,8 +23,11 @@
 #include "ep_engine.h"
 #include "ep_time.h"
 #include "item.h"
+#include "item_eviction.h"
 #include "kv_bucket_iface.h"
+#include "statwriter.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
@@ -43,6 +46,23 @@ enum pager_type_t {
     EXPIRY_PAGER
 };
 
+/**
+ * State shared by the PagingVisitors started by one ItemPager run.
+ */
+struct PagerRun {
+    explicit PagerRun(size_t visitors) : remainingVisitors(visitors) {
+    }
+
+    /// Number of visitors which have not yet completed.
+    std::atomic<size_t> remainingVisitors;
+    /// Set once memory usage has been seen below the low watermark; all
+    /// visitors then stop evicting.
+    std::atomic<bool> reachedLowWat{false};
+    /// Cleared if any visitor skipped some of its vBuckets.
+    std::atomic<bool> completePhase{true};
+    const ProcessClock::time_point start = ProcessClock::now();
+};
+
 /**
  * As part of the ItemPager, visit all of the objects in memory and
  * eject some within a constrained probability
@@ -63,6 +83,13 @@ public:
      *              visits
      * @param bias active vbuckets eviction probability bias multiplier (0-1)
      * @param phase pointer to an item_pager_phase to be set
+     * @param threshold pointer to the TinyLFU eviction threshold, carried
+     *                  from one run to the next (null if not evicting)
+     * @param filter the vBuckets to visit
+     * @param pagerRun state shared with the other visitors of the same
+     *                 ItemPager run (null if not evicting)
+     * @param progress where to record this visitor's progress (null if not
+     *                 evicting)
      */
     PagingVisitor(KVBucket& s,
                   EPStats& st,
@@ -71,8 +98,13 @@ public:
                   pager_type_t caller,
                   bool pause,
                   double bias,
-                  std::atomic<item_pager_phase>* phase)
-        : store(s),
+                  std::atomic<item_pager_phase>* phase,
+                  ItemEviction::Threshold* threshold,
+                  const VBucketFilter& filter,
+                  std::shared_ptr<PagerRun> pagerRun,
+                  std::shared_ptr<PagingVisitorProgress> progress)
+        : VBucketVisitor(filter),
+          store(s),
           stats(st),
           percent(pcnt),
           activeBias(bias),
@@ -81,25 +113,54 @@ public:
           stateFinalizer(sfin),
           owner(caller),
           canPause(pause),
-          completePhase(true),
           wasHighMemoryUsage(s.isMemoryUsageTooHigh()),
           taskStart(ProcessClock::now()),
-          pager_phase(phase) {
+          pager_phase(phase),
+          pagerRun(std::move(pagerRun)),
+          progress(std::move(progress)),
+          freqThresholdOut(threshold) {
+        if (threshold) {
+            freqThreshold = *threshold;
+        }
     }
 
     bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        visitItem(lh, v);
+
+        // Stop once the task's runtime budget is used up; visitBucket() is
+        // called again in its next run to carry on. The clock is only
+        // checked every yieldCheckInterval items.
+        if (++itemsSinceYieldCheck < yieldCheckInterval) {
+            return true;
+        }
+        itemsSinceYieldCheck = 0;
+        return !shouldYield();
+    }
+
+    void visitItem(const HashTable::HashBucketLock& lh, StoredValue& v) {
         // Delete expired items for an active vbucket.
         bool isExpired = (currentBucket->getState() == vbucket_state_active) &&
                          v.isExpired(startTime) && !v.isDeleted();
         if (isExpired || v.isTempNonExistentItem() || v.isTempDeletedItem()) {
             std::unique_ptr<Item> it = v.toItem(false, currentBucket->getId());
             expired.push_back(*it.get());
-            return true;
+            return;
         }
 
         // return if not ItemPager, which uses valid eviction percentage
         if (percent <= 0 || !pager_phase) {
-            return true;
+            return;
+        }
+
+        // Another visitor has already got us below the low watermark.
+        if (pagerRun->reachedLowWat.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        if (currentBucket->ht.getEvictionPolicy() ==
+            HashTable::EvictionPolicy::TinyLFU) {
+            evictByFrequency(lh, v);
+            return;
         }
 
         // always evict unreferenced items, or randomly evict referenced item
@@ -114,29 +175,36 @@ public:
                    v.incrNRUValue() == MAX_NRU_VALUE && r <= percent) {
             doEviction(lh, &v);
         }
-
-        return true;
     }
 
     void visitBucket(VBucketPtr &vb) override {
         update();
 
-        bool newCheckpointCreated = false;
-        size_t removed = vb->checkpointManager->removeClosedUnrefCheckpoints(
-                *vb, newCheckpointCreated);
-        stats.itemsRemovedFromCheckpoints.fetch_add(removed);
-        // If the new checkpoint is created, notify this event to the
-        // corresponding paused DCP connections.
-        if (newCheckpointCreated) {
-            store.getEPEngine().getDcpConnMap().notifyVBConnections(
-                    vb->getId(), vb->checkpointManager->getHighSeqno());
+        // Are we carrying on with a vBucket we yielded part way through?
+        const bool resuming = yielded && currentBucket &&
+                              currentBucket->getId() == vb->getId();
+        yielded = false;
+        if (!resuming) {
+            htPosition = HashTable::Position();
+
+            bool newCheckpointCreated = false;
+            size_t removed =
+                    vb->checkpointManager->removeClosedUnrefCheckpoints(
+                            *vb, newCheckpointCreated);
+            stats.itemsRemovedFromCheckpoints.fetch_add(removed);
+            // If the new checkpoint is created, notify this event to the
+            // corresponding paused DCP connections.
+            if (newCheckpointCreated) {
+                store.getEPEngine().getDcpConnMap().notifyVBConnections(
+                        vb->getId(), vb->checkpointManager->getHighSeqno());
+            }
         }
 
         // fast path for expiry item pager
         if (percent <= 0 || !pager_phase) {
             if (vBucketFilter(vb->getId())) {
                 currentBucket = vb;
-                vb->ht.visit(*this);
+                visitHashTable(*vb);
             }
             return;
         }
@@ -152,16 +220,43 @@ public:
             return;
         }
 
-        if (current > lower) {
+        if (current > lower && !pagerRun->reachedLowWat &&
+            progress->bytesFreed < progress->bytesToFree) {
             double p = (current - static_cast<double>(lower)) / current;
             adjustPercent(p, vb->getState());
             if (vBucketFilter(vb->getId())) {
                 currentBucket = vb;
-                vb->ht.visit(*this);
+                if (!resuming) {
+                    decayFreqCounters =
+                            vb->ht.testAndClearFreqCounterSaturated();
+                }
+                const size_t ejectedBefore = ejected;
+                const size_t memBefore = vb->ht.getItemMemory();
+                visitHashTable(*vb);
+                const size_t memAfter = vb->ht.getItemMemory();
+                if (memBefore > memAfter) {
+                    progress->bytesFreed += memBefore - memAfter;
+                }
+                progress->itemsEjected += ejected - ejectedBefore;
+                if (!yielded) {
+                    ++progress->vbucketsVisited;
+                }
             }
 
-        } else { // stop eviction whenever memory usage is below low watermark
-            completePhase = false;
+        } else {
+            // stop eviction whenever memory usage is below low watermark (or
+            // this visitor has freed its share).
+            pagerRun->completePhase = false;
+            if (current <= lower) {
+                bool expected = false;
+                if (pagerRun->reachedLowWat.compare_exchange_strong(expected,
+                                                               true)) {
+                    stats.itemPagerTimeToLowWatHisto.add(
+                            std::chrono::duration_cast<
+                                    std::chrono::microseconds>(
+                                    ProcessClock::now() - pagerRun->start));
+                }
+            }
         }
     }
 
@@ -186,22 +281,40 @@ public:
         return canPause && queueSize >= MAX_PERSISTENCE_QUEUE_SIZE;
     }
 
+    bool yieldedMidBucket() override {
+        return yielded;
+    }
+
     void complete() override {
         update();
 
+        if (progress) {
+            progress->completed = true;
+        }
+        // Only the last of an ItemPager run's visitors to complete finishes
+        // the run.
+        if (pagerRun && pagerRun->remainingVisitors.fetch_sub(1) != 1) {
+            return;
+        }
+
         auto elapsed_time =
                 std::chrono::duration_cast<std::chrono::microseconds>(
-                        ProcessClock::now() - taskStart);
+                        ProcessClock::now() -
+                        (pagerRun ? pagerRun->start : taskStart));
         if (owner == ITEM_PAGER) {
             stats.itemPagerHisto.add(elapsed_time);
         } else if (owner == EXPIRY_PAGER) {
             stats.expiryPagerHisto.add(elapsed_time);
         }
 
+        if (freqThresholdOut) {
+            *freqThresholdOut = freqThreshold;
+        }
+
         bool inverse = false;
         (*stateFinalizer).compare_exchange_strong(inverse, true);
 
-        if (pager_phase && completePhase) {
+        if (pager_phase && pagerRun->completePhase) {
             if (*pager_phase == PAGING_UNREFERENCED) {
                 *pager_phase = PAGING_RANDOM;
             } else {
@@ -231,6 +344,17 @@ public:
     size_t numEjected() { return ejected; }
 
 private:
+    /**
+     * Visit the vBucket's HashTable, carrying on from where the last call
+     * stopped if that yielded. As the visit resumes from the next hash
+     * bucket, the rest of the chain the visit stopped in is not visited in
+     * this pass.
+     */
+    void visitHashTable(VBucket& vb) {
+        htPosition = vb.ht.pauseResumeVisit(*this, htPosition);
+        yielded = htPosition != vb.ht.endPosition();
+    }
+
     void adjustPercent(double prob, vbucket_state_t state) {
         if (state == vbucket_state_replica ||
             state == vbucket_state_dead)
@@ -244,6 +368,37 @@ private:
         }
     }
 
+    /**
+     * TinyLFU eviction: evict the item if its frequency counter is amongst
+     * the lowest `percent` of the (eligible) items seen by this visitor.
+     */
+    void evictByFrequency(const HashTable::HashBucketLock& lh,
+                          StoredValue& v) {
+        uint8_t freq = v.getFreqCounterValue();
+        if (decayFreqCounters) {
+            freq /= 2;
+            v.setFreqCounterValue(freq);
+        }
+        if (!v.eligibleForEviction(store.getItemEvictionPolicy())) {
+            return;
+        }
+
+        itemEviction.addFreqValue(freq);
+        // Until enough items have been seen the previous visitor's threshold
+        // is used; always skipping the first items would make whichever
+        // items the HashTable visits first immune from eviction. The
+        // histogram changes slowly so isn't recomputed for every item.
+        if (itemEviction.getPopulation() % ItemEviction::learningPopulation ==
+            0) {
+            freqThreshold = itemEviction.getFreqThreshold(percent);
+        }
+        const double r =
+                static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX);
+        if (ItemEviction::shouldEvict(freq, freqThreshold, r)) {
+            doEviction(lh, &v);
+        }
+    }
+
     void doEviction(const HashTable::HashBucketLock& lh, StoredValue* v) {
         item_eviction_policy_t policy = store.getItemEvictionPolicy();
         StoredDocKey key(v->getKey());
@@ -272,11 +427,26 @@ private:
     std::shared_ptr<std::atomic<bool>> stateFinalizer;
     pager_type_t owner;
     bool canPause;
-    bool completePhase;
     bool wasHighMemoryUsage;
     ProcessClock::time_point taskStart;
     std::atomic<item_pager_phase>* pager_phase;
     VBucketPtr currentBucket;
+    std::shared_ptr<PagerRun> pagerRun;
+    std::shared_ptr<PagingVisitorProgress> progress;
+
+    // TinyLFU state.
+    ItemEviction::Threshold freqThreshold;
+    ItemEviction::Threshold* freqThresholdOut;
+    ItemEviction itemEviction;
+    // Should the frequency counters of the current vBucket be halved?
+    bool decayFreqCounters = false;
+
+    // Where to resume visiting the current vBucket's HashTable, and whether
+    // the last visitBucket() yielded before finishing it.
+    HashTable::Position htPosition;
+    bool yielded = false;
+    static const size_t yieldCheckInterval = 64;
+    size_t itemsSinceYieldCheck = 0;
 };
 
 ItemPager::ItemPager(EventuallyPersistentEngine& e, EPStats& st)
@@ -336,28 +506,126 @@ bool ItemPager::run(void) {
         size_t activeEvictPerc = cfg.getPagerActiveVbPcnt();
         double bias = static_cast<double>(activeEvictPerc) / 50;
 
-        auto pv = std::make_unique<PagingVisitor>(*kvBucket,
-                                                  stats,
-                                                  toKill,
-                                                  available,
-                                                  ITEM_PAGER,
-                                                  false,
-                                                  bias,
-                                                  &phase);
+        // Split the vBuckets between the visitors, each freeing its share of
+        // the memory above the low watermark.
+        std::vector<std::pair<size_t, uint16_t>> vbMemory;
+        for (auto vbid : kvBucket->getVBuckets().getBuckets()) {
+            auto vb = kvBucket->getVBucket(vbid);
+            if (vb) {
+                vbMemory.emplace_back(vb->ht.getItemMemory(), vbid);
+            }
+        }
+        size_t numVisitors = std::min(
+                {cfg.getPagerConcurrentVisitors(),
+                 ExecutorPool::get()->getNumNonIO(),
+                 vbMemory.size()});
+        numVisitors = std::max(numVisitors, size_t(1));
+        auto partitions = partitionVBuckets(std::move(vbMemory), numVisitors);
+
+        size_t totalMemory = 0;
+        for (const auto& partition : partitions) {
+            totalMemory += partition.second;
+        }
+        const double bytesToFree = current - lower;
+
+        auto pagerRun = std::make_shared<PagerRun>(partitions.size());
+        std::vector<std::shared_ptr<PagingVisitorProgress>> progress;
+        for (const auto& partition : partitions) {
+            auto p = std::make_shared<PagingVisitorProgress>();
+            p->vbuckets = partition.first.size();
+            p->bytesToFree = static_cast<size_t>(
+                    totalMemory ? bytesToFree * partition.second / totalMemory
+                                : bytesToFree / partitions.size());
+            progress.push_back(std::move(p));
+        }
+        {
+            std::lock_guard<std::mutex> lh(visitorProgressMutex);
+            visitorProgress = progress;
+        }
 
         // p99.99 is ~50ms
         const auto maxExpectedDuration = std::chrono::milliseconds(50);
 
-        kvBucket->visit(std::move(pv),
-                        "Item pager",
-                        TaskId::ItemPagerVisitor,
-                        /*sleepTime*/ 0,
-                        maxExpectedDuration);
+        for (size_t ii = 0; ii < partitions.size(); ++ii) {
+            auto pv = std::make_unique<PagingVisitor>(
+                    *kvBucket,
+                    stats,
+                    toKill,
+                    available,
+                    ITEM_PAGER,
+                    false,
+                    bias,
+                    &phase,
+                    &freqThreshold,
+                    VBucketFilter(partitions[ii].first),
+                    pagerRun,
+                    progress[ii]);
+
+            kvBucket->visit(std::move(pv),
+                            "Item pager",
+                            TaskId::ItemPagerVisitor,
+                            /*sleepTime*/ 0,
+                            maxExpectedDuration);
+        }
     }
 
     return true;
 }
 
+std::vector<std::pair<std::vector<uint16_t>, size_t>>
+ItemPager::partitionVBuckets(std::vector<std::pair<size_t, uint16_t>> vbMemory,
+                             size_t numVisitors) {
+    std::vector<std::pair<std::vector<uint16_t>, size_t>> partitions(
+            numVisitors);
+    // Largest first, each to the visitor with the least memory so far.
+    std::sort(vbMemory.rbegin(), vbMemory.rend());
+    for (const auto& vb : vbMemory) {
+        auto smallest = std::min_element(
+                partitions.begin(),
+                partitions.end(),
+                [](const std::pair<std::vector<uint16_t>, size_t>& a,
+                   const std::pair<std::vector<uint16_t>, size_t>& b) {
+                    return a.second < b.second;
+                });
+        smallest->first.push_back(vb.second);
+        smallest->second += vb.first;
+    }
+    // A visitor with no vBuckets would visit all of them (an empty
+    // VBucketFilter accepts everything).
+    partitions.erase(
+            std::remove_if(partitions.begin(),
+                           partitions.end(),
+                           [](const std::pair<std::vector<uint16_t>, size_t>&
+                                      p) { return p.first.empty(); }),
+            partitions.end());
+    if (partitions.empty()) {
+        partitions.emplace_back();
+    }
+    return partitions;
+}
+
+void ItemPager::addStats(ADD_STAT add_stat, const void* cookie) {
+    std::lock_guard<std::mutex> lh(visitorProgressMutex);
+    add_casted_stat("ep_pager_visitors", visitorProgress.size(), add_stat,
+                    cookie);
+    for (size_t ii = 0; ii < visitorProgress.size(); ++ii) {
+        const auto& p = *visitorProgress[ii];
+        const std::string prefix = "ep_pager_visitor_" + std::to_string(ii);
+        add_casted_stat((prefix + "_vbuckets").c_str(), p.vbuckets, add_stat,
+                        cookie);
+        add_casted_stat((prefix + "_vbuckets_visited").c_str(),
+                        p.vbucketsVisited, add_stat, cookie);
+        add_casted_stat((prefix + "_bytes_to_free").c_str(), p.bytesToFree,
+                        add_stat, cookie);
+        add_casted_stat((prefix + "_bytes_freed").c_str(), p.bytesFreed,
+                        add_stat, cookie);
+        add_casted_stat((prefix + "_items_ejected").c_str(), p.itemsEjected,
+                        add_stat, cookie);
+        add_casted_stat((prefix + "_completed").c_str(), p.completed.load(),
+                        add_stat, cookie);
+    }
+}
+
 void ItemPager::scheduleNow() {
     bool expected = false;
     if (notified.compare_exchange_strong(expected, true)) {
@@ -423,6 +691,10 @@ bool ExpiredItemPager::run(void) {
                                                   EXPIRY_PAGER,
                                                   true,
                                                   1,
+                                                  nullptr,
+                                                  nullptr,
+                                                  VBucketFilter(),
+                                                  nullptr,
                                                   nullptr);
 
         // p99.99 is ~50ms (same as ItemPager).
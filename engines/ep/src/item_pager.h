@@ -21,6 +21,12 @@
 #include "config.h"
 
 #include "globaltask.h"
+#include "item_eviction.h"
+
+#include <memcached/engine.h>
+
+#include <mutex>
+#include <vector>
 
 typedef std::pair<int64_t, int64_t> row_range_t;
 
@@ -36,9 +42,28 @@ enum item_pager_phase {
     PAGING_RANDOM
 };
 
+/**
+ * Progress of one of the PagingVisitors started by an ItemPager run. Each
+ * visitor is given a subset of the vBuckets and a share of the bytes the run
+ * needs to free.
+ */
+struct PagingVisitorProgress {
+    std::atomic<size_t> vbuckets{0};
+    std::atomic<size_t> vbucketsVisited{0};
+    std::atomic<size_t> bytesToFree{0};
+    std::atomic<size_t> bytesFreed{0};
+    std::atomic<size_t> itemsEjected{0};
+    std::atomic<bool> completed{false};
+};
+
 /**
  * Dispatcher job responsible for periodically pushing data out of
  * memory.
+ *
+ * Each run splits the vBuckets between up to pager_concurrent_visitors
+ * PagingVisitor tasks (no more than there are NonIO threads), balancing the
+ * memory used by each visitor's vBuckets. All visitors stop as soon as memory
+ * usage drops below the low watermark.
  */
 class ItemPager : public GlobalTask {
 public:
@@ -75,7 +100,25 @@ public:
      */
     void scheduleNow();
 
+    /**
+     * Add the progress of the PagingVisitors of the most recent run to the
+     * given stats.
+     */
+    void addStats(ADD_STAT add_stat, const void* cookie);
+
 private:
+    /**
+     * Split the given vBuckets between PagingVisitors such that the item
+     * memory of each visitor's vBuckets is roughly equal.
+     *
+     * @param vbMemory (item memory, vBucket id) of each vBucket to visit
+     * @param numVisitors number of visitors to split between
+     * @return the vBuckets for each visitor, and their total item memory
+     */
+    static std::vector<std::pair<std::vector<uint16_t>, size_t>>
+    partitionVBuckets(std::vector<std::pair<size_t, uint16_t>> vbMemory,
+                      size_t numVisitors);
+
     EventuallyPersistentEngine& engine;
     EPStats& stats;
     std::shared_ptr<std::atomic<bool>> available;
@@ -85,6 +128,16 @@ private:
     std::atomic<item_pager_phase> phase;
     bool doEvict;
 
+    // TinyLFU eviction threshold from the previous run; used by the
+    // PagingVisitors of the next run until they have seen enough items to
+    // compute their own. Only written by the last visitor of a run to
+    // complete, before it sets `available`.
+    ItemEviction::Threshold freqThreshold;
+
+    // Progress of each PagingVisitor of the most recent run.
+    std::mutex visitorProgressMutex;
+    std::vector<std::shared_ptr<PagingVisitorProgress>> visitorProgress;
+
     /**
      * How long this task sleeps for if not requested to run. Initialised from
      * the configuration parameter - pager_sleep_time_ms
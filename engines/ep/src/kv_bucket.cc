@@ -1707,6 +1707,8 @@ void KVBucket::reset() {
     for (auto vbid : buckets) {
         auto vb = getLockedVBucket(vbid);
         if (vb) {
+            // Let any flush waiting for its group commit complete first.
+            vb->waitForGroupSync(vb.getLock());
             vb->ht.clear();
             vb->checkpointManager->clear(vb->getState());
             vb->resetStats();
@@ -2105,8 +2107,9 @@ VBCBAdaptor::VBCBAdaptor(KVBucket* s,
       visitor(std::move(v)),
       label(l),
       sleepTime(sleep),
-      maxDuration(std::chrono::seconds::max()),
+      maxDuration(std::chrono::microseconds::max()),
       currentvb(0) {
+    visitor->setTask(*this);
     updateDescription();
     const VBucketFilter& vbFilter = visitor->getVBucketFilter();
     for (auto vbid : store->getVBuckets().getBuckets()) {
@@ -2127,6 +2130,10 @@ bool VBCBAdaptor::run(void) {
                 return true;
             }
             visitor->visitBucket(vb);
+            if (visitor->yieldedMidBucket()) {
+                // Carry on with this vBucket in our next run.
+                return true;
+            }
         }
         vbList.pop();
     }
@@ -2221,7 +2228,9 @@ TaskStatus KVBucket::rollback(uint16_t vbid, uint64_t rollbackSeqno) {
 
     auto vb = getLockedVBucket(vbid, std::try_to_lock);
 
-    if (!vb.owns_lock()) {
+    // A flush waiting for its group commit must complete before the
+    // vBucket's file can be rolled back.
+    if (!vb.owns_lock() || (vb && vb->isGroupSyncPending())) {
         return TaskStatus::Reschedule; // Reschedule a vbucket rollback task.
     }
 
@@ -2276,6 +2285,10 @@ void KVBucket::attemptToFreeMemory() {
     static_cast<ItemPager*>(itemPagerTask.get())->scheduleNow();
 }
 
+void KVBucket::addItemPagerStats(ADD_STAT add_stat, const void* cookie) {
+    static_cast<ItemPager*>(itemPagerTask.get())->addStats(add_stat, cookie);
+}
+
 void KVBucket::runDefragmenterTask() {
     defragmenterTask->run();
 }
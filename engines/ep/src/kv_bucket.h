@@ -686,6 +686,8 @@ public:
 
     void addKVStoreStats(ADD_STAT add_stat, const void* cookie);
 
+    void addItemPagerStats(ADD_STAT add_stat, const void* cookie);
+
     void addKVStoreTimingStats(ADD_STAT add_stat, const void* cookie);
 
     /* Given a named KVStore statistic, return the value of that statistic,
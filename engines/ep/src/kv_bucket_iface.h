@@ -644,6 +644,9 @@ public:
 
     virtual void addKVStoreStats(ADD_STAT add_stat, const void* cookie) = 0;
 
+    /// Add the progress of the item pager's most recent run to stats.
+    virtual void addItemPagerStats(ADD_STAT add_stat, const void* cookie) = 0;
+
     virtual void addKVStoreTimingStats(ADD_STAT add_stat,
                                        const void* cookie) = 0;
 
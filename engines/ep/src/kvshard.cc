@@ -66,6 +66,10 @@ KVShard::KVShard(uint16_t id, KVBucket& kvBucket)
 // unique_ptrs of forward-declared items
 KVShard::~KVShard() = default;
 
+void KVShard::setRWUnderlying(std::unique_ptr<KVStore> store) {
+    rwStore = std::move(store);
+}
+
 Flusher *KVShard::getFlusher() {
     return flusher.get();
 }
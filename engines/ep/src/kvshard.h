@@ -75,6 +75,12 @@ public:
         return rwStore.get();
     }
 
+    /**
+     * Replace the read-write KVStore. Only for use by tests, before the
+     * shard's vBuckets are flushed.
+     */
+    void setRWUnderlying(std::unique_ptr<KVStore> store);
+
     Flusher *getFlusher();
     BgFetcher *getBgFetcher();
 
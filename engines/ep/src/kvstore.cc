@@ -63,6 +63,8 @@ ScanContext::ScanContext(std::shared_ptr<StatusCallback<GetValue>> cb,
       config(_config) {
 }
 
+const int64_t WindowedRate::windowSecs;
+
 void FileStats::reset() {
     readTimeHisto.reset();
     readSeekHisto.reset();
@@ -74,6 +76,11 @@ void FileStats::reset() {
     writeCountHisto.reset();
     totalBytesRead = 0;
     totalBytesWritten = 0;
+    numSyncs = 0;
+    syncRate.reset();
+    asyncReadBatchTimeHisto.reset();
+    asyncReadsSubmitted = 0;
+    asyncReadHits = 0;
 }
 
 KVStoreRWRO KVStoreFactory::create(KVStoreConfig& config) {
@@ -285,6 +292,30 @@ void KVStore::addStats(ADD_STAT add_stat, const void *c) {
     addStat(prefix, "io_compaction_write_bytes",
             st.fsStatsCompaction.totalBytesWritten, add_stat, c);
 
+    const size_t syncs = st.fsStats.numSyncs.load() +
+                         st.fsStatsCompaction.numSyncs.load();
+    addStat(prefix, "io_num_sync", syncs, add_stat, c);
+    const double syncsPerSec = st.fsStats.syncRate.getRate() +
+                               st.fsStatsCompaction.syncRate.getRate();
+    addStat(prefix, "io_syncs_per_sec", syncsPerSec, add_stat, c);
+
+    const size_t commits = st.numCommits;
+    const double itemsPerCommit =
+            commits > 0 ? double(st.numCommittedDocs) / commits : 0;
+    addStat(prefix, "io_num_commit", commits, add_stat, c);
+    addStat(prefix, "io_items_per_commit", itemsPerCommit, add_stat, c);
+
+    addStat(prefix,
+            "io_async_reads_submitted",
+            st.fsStats.asyncReadsSubmitted,
+            add_stat,
+            c);
+    addStat(prefix,
+            "io_async_read_hits",
+            st.fsStats.asyncReadHits,
+            add_stat,
+            c);
+
     // Specific to RocksDB. Per-shard stats.
     size_t value = 0;
     // Memory Usage
@@ -401,6 +432,7 @@ void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
     addStat(prefix, "writeTime",   st.writeTimeHisto,   add_stat, c);
     addStat(prefix, "writeSize",   st.writeSizeHisto,   add_stat, c);
     addStat(prefix, "saveDocCount",   st.batchSize,     add_stat, c);
+    addStat(prefix, "groupCommitSize", st.groupCommitSize, add_stat, c);
 
     addStat(prefix, "getMultiFsReadCount", st.getMultiFsReadHisto, add_stat, c);
     addStat(prefix,
@@ -416,6 +448,11 @@ void KVStore::addTimingStats(ADD_STAT add_stat, const void *c) {
     addStat(prefix, "fsReadSize",  st.fsStats.readSizeHisto,  add_stat, c);
     addStat(prefix, "fsWriteSize", st.fsStats.writeSizeHisto, add_stat, c);
     addStat(prefix, "fsReadSeek",  st.fsStats.readSeekHisto,  add_stat, c);
+    addStat(prefix,
+            "fsAsyncReadBatchTime",
+            st.fsStats.asyncReadBatchTimeHisto,
+            add_stat,
+            c);
     addStat(prefix, "fsReadCount", st.fsStats.readCountHisto, add_stat, c);
     addStat(prefix, "fsWriteCount", st.fsStats.writeCountHisto, add_stat, c);
 }
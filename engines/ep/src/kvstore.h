@@ -28,11 +28,13 @@
 #include <platform/processclock.h>
 
 #include <relaxed_atomic.h>
+#include <array>
 #include <atomic>
 #include <cstring>
 #include <deque>
 #include <list>
 #include <map>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -201,6 +203,61 @@ public:
     const KVStoreConfig& config;
 };
 
+/**
+ * Counts events over the last windowSecs seconds, to report their current
+ * rate rather than an average since the count was last reset.
+ */
+class WindowedRate {
+public:
+    static const int64_t windowSecs = 10;
+
+    void add(size_t count = 1,
+             ProcessClock::time_point now = ProcessClock::now()) {
+        const int64_t second = toSeconds(now);
+        std::lock_guard<std::mutex> lh(mutex);
+        auto& slot = slots[second % slots.size()];
+        if (slot.second != second) {
+            slot.second = second;
+            slot.count = 0;
+        }
+        slot.count += count;
+    }
+
+    /// @return events per second over the last windowSecs whole seconds.
+    double getRate(ProcessClock::time_point now = ProcessClock::now()) {
+        const int64_t second = toSeconds(now);
+        size_t total = 0;
+        std::lock_guard<std::mutex> lh(mutex);
+        for (const auto& slot : slots) {
+            if (slot.second < second && slot.second >= second - windowSecs) {
+                total += slot.count;
+            }
+        }
+        return double(total) / windowSecs;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lh(mutex);
+        slots.fill({});
+    }
+
+private:
+    static int64_t toSeconds(ProcessClock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                       time.time_since_epoch())
+                .count();
+    }
+
+    struct Slot {
+        int64_t second = -1;
+        size_t count = 0;
+    };
+
+    std::mutex mutex;
+    /// One slot per second of the window, plus the current second.
+    std::array<Slot, windowSecs + 1> slots;
+};
+
 struct FileStats {
     // Read time length
     MicrosecondHistogram readTimeHisto;
@@ -226,6 +283,18 @@ struct FileStats {
     // Total bytes written to disk.
     std::atomic<size_t> totalBytesWritten{0};
 
+    // Number of sync() calls
+    std::atomic<size_t> numSyncs{0};
+    // Recent sync() calls, for the current rate
+    WindowedRate syncRate;
+
+    // Time spent performing a batch of asynchronous (io_uring) reads
+    MicrosecondHistogram asyncReadBatchTimeHisto;
+    // Number of asynchronous reads submitted
+    std::atomic<size_t> asyncReadsSubmitted{0};
+    // Number of read()s served from asynchronously read data
+    std::atomic<size_t> asyncReadHits{0};
+
     void reset();
 };
 
@@ -257,7 +326,10 @@ public:
       writeSizeHisto(ExponentialGenerator<size_t>(1, 2), 25),
       getMultiFsReadCount(0),
       getMultiFsReadHisto(ExponentialGenerator<uint32_t>(6, 1.2), 50),
-      getMultiFsReadPerDocHisto(ExponentialGenerator<uint32_t>(6, 1.2),50) {
+      getMultiFsReadPerDocHisto(ExponentialGenerator<uint32_t>(6, 1.2),50),
+      numCommits(0),
+      numCommittedDocs(0),
+      groupCommitSize(ExponentialGenerator<size_t>(1, 2), 10) {
     }
 
     KVStoreStats(const KVStoreStats &copyFrom) {}
@@ -287,6 +359,9 @@ public:
         getMultiFsReadCount = 0;
         getMultiFsReadHisto.reset();
         getMultiFsReadPerDocHisto.reset();
+        numCommits = 0;
+        numCommittedDocs = 0;
+        groupCommitSize.reset();
         fsStats.reset();
     }
 
@@ -352,6 +427,13 @@ public:
     // per fetched document.
     Histogram<uint32_t> getMultiFsReadPerDocHisto;
 
+    // Number of (flusher) commits, and the documents they committed
+    Couchbase::RelaxedAtomic<size_t> numCommits;
+    Couchbase::RelaxedAtomic<size_t> numCommittedDocs;
+
+    // Number of vBucket commits made durable together by each group commit
+    Histogram<size_t> groupCommitSize;
+
     // Stats from the underlying OS file operations
     FileStats fsStats;
 
@@ -521,6 +603,45 @@ public:
      */
     virtual bool commit(const Item* collectionsManifest) = 0;
 
+    /**
+     * Write a transaction (unless not currently in one) as commit() does,
+     * but defer making it durable - and running its persistence callbacks -
+     * until commitGroup(). This allows the transactions of several
+     * vBuckets to be written before any of them is committed.
+     *
+     * KVStores which don't support group commit just commit.
+     *
+     * @param collectionsManifest as for commit()
+     * @return false if the transaction could not be written
+     */
+    virtual bool prepareCommit(const Item* collectionsManifest) {
+        return commit(collectionsManifest);
+    }
+
+    /**
+     * Commit every transaction written by prepareCommit(); the commits
+     * may not be durable until syncGroup() returns. The caller must have
+     * exclusive access to the transactions' vBuckets.
+     */
+    virtual void commitGroup() {
+    }
+
+    /**
+     * Wait for the commits made by commitGroup() to be durable. Unlike
+     * commitGroup() and completeGroup(), this doesn't need exclusive access
+     * to the vBuckets.
+     */
+    virtual void syncGroup() {
+    }
+
+    /**
+     * Run the persistence callbacks of the transactions committed by
+     * commitGroup(), once syncGroup() has returned. The caller must have
+     * exclusive access to the transactions' vBuckets.
+     */
+    virtual void completeGroup() {
+    }
+
     /**
      * Rollback the current transaction.
      */
@@ -44,6 +44,7 @@ KVStoreConfig::KVStoreConfig(Configuration& config, uint16_t shardid)
                     config.getRocksdbCfOptions(),
                     config.getRocksdbBbtOptions()) {
     setPeriodicSyncBytes(config.getFsyncAfterEveryNBytesWritten());
+    setAsyncIO(config.isCouchstoreAsyncIo());
     config.addValueChangedListener("fsync_after_every_n_bytes_written",
                                    new ConfigChangeListener(*this));
     rocksDbLowPriBackgroundThreads = config.getRocksdbLowPriBackgroundThreads();
@@ -95,6 +95,21 @@ public:
      */
     KVStoreConfig& setBuffered(bool _buffered);
 
+    /**
+     * Indicates whether reads may be batched and submitted asynchronously
+     * (via io_uring) where the platform supports it.
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool isAsyncIO() const {
+        return asyncIO;
+    }
+
+    KVStoreConfig& setAsyncIO(bool _asyncIO) {
+        asyncIO = _asyncIO;
+        return *this;
+    }
+
     bool shouldPersistDocNamespace() const {
         return persistDocNamespace;
     }
@@ -191,6 +206,7 @@ private:
     uint16_t shardId;
     Logger* logger;
     bool buffered;
+    bool asyncIO = false;
     bool persistDocNamespace;
 
     /**
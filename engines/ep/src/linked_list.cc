@@ -19,9 +19,12 @@
 
 #include "stats.h"
 
+#include <limits>
 #include <mutex>
 
-BasicLinkedList::BasicLinkedList(uint16_t vbucketId, EPStats& st)
+BasicLinkedList::BasicLinkedList(uint16_t vbucketId,
+                                 EPStats& st,
+                                 size_t indexInterval)
     : SequenceList(),
       readRange(0, 0),
       staleSize(0),
@@ -33,7 +36,10 @@ BasicLinkedList::BasicLinkedList(uint16_t vbucketId, EPStats& st)
       numDeletedItems(0),
       vbid(vbucketId),
       st(st),
-      pausedPurgePoint(seqList.end()) {
+      pausedPurgePoint(seqList.end()),
+      indexInterval(indexInterval),
+      lastIndexedSeqno(0),
+      lowestStaleSeqno(std::numeric_limits<seqno_t>::max()) {
 }
 
 BasicLinkedList::~BasicLinkedList() {
@@ -51,6 +57,7 @@ BasicLinkedList::~BasicLinkedList() {
 
     /* Erase all the list elements (does not destroy elements, just removes
        them from the list) */
+    seqnoIndex.clear();
     seqList.clear();
 }
 
@@ -75,6 +82,7 @@ SequenceList::UpdateStatus BasicLinkedList::updateListElem(
 
     /* Since there is no other reads or writes happenning in this range, we can
        move the item to the end of the list */
+    removeFromIndex(v);
     auto it = seqList.iterator_to(v);
     /* If the list is being updated at 'pausedPurgePoint', then we must save
        the new 'pausedPurgePoint' */
@@ -103,6 +111,7 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
     /* Allows only 1 rangeRead for now */
     std::lock_guard<std::mutex> lckGd(rangeReadLock);
 
+    OrderedLL::iterator startIt;
     {
         std::lock_guard<std::mutex> listWriteLg(getListWriteLock());
         std::lock_guard<SpinLock> lh(rangeLock);
@@ -119,16 +128,20 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
                     ENGINE_ERANGE, std::vector<UniqueItemPtr>(), 0);
         }
 
-        /* Mark the initial read range */
+        /* Mark the initial read range, from where we start walking the list.
+           Elements before that can be moved freely as we never read them */
         end = std::min(end, static_cast<seqno_t>(highSeqno));
         end = std::max(end, static_cast<seqno_t>(highestDedupedSeqno));
-        readRange = SeqRange(1, end);
+        startIt = findStart(start);
+        readRange = SeqRange(
+                (startIt == seqList.begin()) ? 1 : startIt->getBySeqno(), end);
     }
 
     /* Read items in the range */
     std::vector<UniqueItemPtr> items;
 
-    for (const auto& osv : seqList) {
+    for (auto it = startIt; it != seqList.end(); ++it) {
+        const auto& osv = *it;
         int64_t currSeqno(osv.getBySeqno());
 
         if (currSeqno > end || currSeqno < 0) {
@@ -201,6 +214,14 @@ void BasicLinkedList::updateHighSeqno(std::lock_guard<std::mutex>& listWriteLg,
                                     " which is < 1");
     }
     highSeqno = v.getBySeqno();
+
+    if (indexInterval && v.seqno_hook.is_linked() &&
+        v.getBySeqno() >= lastIndexedSeqno + seqno_t(indexInterval)) {
+        /* The list owns the element (it is linked into seqList), the index
+           just refers to it */
+        seqnoIndex.emplace(v.getBySeqno(), const_cast<OrderedStoredValue*>(&v));
+        lastIndexedSeqno = v.getBySeqno();
+    }
 }
 void BasicLinkedList::updateHighestDedupedSeqno(
         std::lock_guard<std::mutex>& listWriteLg, const OrderedStoredValue& v) {
@@ -228,6 +249,7 @@ void BasicLinkedList::markItemStale(std::lock_guard<std::mutex>& listWriteLg,
     st.currentSize.fetch_add(v->metaDataSize());
 
     ++numStaleItems;
+    lowestStaleSeqno = std::min(lowestStaleSeqno, v->getBySeqno());
     v->toOrderedStoredValue()->markStale(listWriteLg, newSv);
 }
 
@@ -278,10 +300,15 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
             startIt = pausedPurgePoint;
             pausedPurgePoint = seqList.end();
         } else {
-            startIt = seqList.begin();
+            // Nothing before the lowest element marked stale since the last
+            // purge started can be stale, so start from there.
+            startIt = findStart(lowestStaleSeqno);
+            lowestStaleSeqno = std::numeric_limits<seqno_t>::max();
         }
         if (startIt->getBySeqno() > purgeUpToSeqno) {
-            /* Nothing to purge */
+            /* Nothing to purge; a later purge must start from here */
+            lowestStaleSeqno =
+                    std::min(lowestStaleSeqno, startIt->getBySeqno());
             return 0;
         }
 
@@ -294,9 +321,16 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
     // for stale items.
     size_t purgedCount = 0;
     bool stale;
+    // Stale items from this seqno on have not been looked at (stale items
+    // are never moved, so they cannot end up behind it)
+    seqno_t stopSeqno = std::numeric_limits<seqno_t>::max();
     for (auto it = startIt; it != seqList.end();) {
-        if ((it->getBySeqno() > purgeUpToSeqno) ||
-            (it->getBySeqno() <= 0) /* last item with no valid seqno yet */) {
+        if (it->getBySeqno() > purgeUpToSeqno) {
+            stopSeqno = purgeUpToSeqno + 1;
+            break;
+        }
+        if (it->getBySeqno() <= 0) {
+            /* last item with no valid seqno yet */
             break;
         }
 
@@ -307,6 +341,7 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
             std::lock_guard<SpinLock> rangeGuard(rangeLock);
             readRange.setBegin(it->getBySeqno());
         }
+        const seqno_t currSeqno = it->getBySeqno();
 
         {
             std::lock_guard<std::mutex> writeGuard(getListWriteLock());
@@ -323,12 +358,16 @@ size_t BasicLinkedList::purgeTombstones(seqno_t purgeUpToSeqno,
 
         if (shouldPause()) {
             pausedPurgePoint = it;
+            stopSeqno = currSeqno;
             break;
         }
     }
 
-    // Complete; reset the readRange.
+    // Complete; reset the readRange. A later purge starting from the
+    // beginning must not start after where we stopped.
     {
+        std::lock_guard<std::mutex> writeGuard(getListWriteLock());
+        lowestStaleSeqno = std::min(lowestStaleSeqno, stopSeqno);
         std::lock_guard<SpinLock> lh(rangeLock);
         readRange.reset();
     }
@@ -393,12 +432,17 @@ std::mutex& BasicLinkedList::getListWriteLock() const {
 }
 
 boost::optional<SequenceList::RangeIterator> BasicLinkedList::makeRangeIterator(
-        bool isBackfill) {
-    auto pRangeItr = RangeIteratorLL::create(*this, isBackfill);
+        bool isBackfill, seqno_t start) {
+    auto pRangeItr = RangeIteratorLL::create(*this, isBackfill, start);
     return pRangeItr ? RangeIterator(std::move(pRangeItr))
                      : boost::optional<SequenceList::RangeIterator>{};
 }
 
+size_t BasicLinkedList::getIndexSize() const {
+    std::lock_guard<std::mutex> lckGd(getListWriteLock());
+    return seqnoIndex.size();
+}
+
 void BasicLinkedList::dump() const {
     std::cerr << *this << std::endl;
 }
@@ -422,6 +466,7 @@ OrderedLL::iterator BasicLinkedList::purgeListElem(OrderedLL::iterator it) {
     StoredValue::UniquePtr purged(&*it);
     {
         std::lock_guard<std::mutex> lckGd(getListWriteLock());
+        removeFromIndex(*it);
         it = seqList.erase(it);
     }
 
@@ -443,17 +488,43 @@ OrderedLL::iterator BasicLinkedList::purgeListElem(OrderedLL::iterator it) {
     return it;
 }
 
+OrderedLL::iterator BasicLinkedList::findStart(seqno_t seqno) {
+    auto entry = seqnoIndex.upper_bound(seqno);
+    while (entry != seqnoIndex.begin()) {
+        --entry;
+        OrderedStoredValue& osv = *entry->second;
+        if (osv.getBySeqno() == entry->first) {
+            return seqList.iterator_to(osv);
+        }
+        /* The element has been given a new seqno without being moved in the
+           list (it cannot have left the list, that would have removed it
+           from the index); it can no longer be trusted as a position */
+        entry = seqnoIndex.erase(entry);
+    }
+    return seqList.begin();
+}
+
+void BasicLinkedList::removeFromIndex(const OrderedStoredValue& v) {
+    auto entry = seqnoIndex.find(v.getBySeqno());
+    if (entry != seqnoIndex.end() && entry->second == &v) {
+        seqnoIndex.erase(entry);
+    }
+}
+
 std::unique_ptr<BasicLinkedList::RangeIteratorLL>
-BasicLinkedList::RangeIteratorLL::create(BasicLinkedList& ll, bool isBackfill) {
+BasicLinkedList::RangeIteratorLL::create(BasicLinkedList& ll,
+                                         bool isBackfill,
+                                         seqno_t start) {
     /* Note: cannot use std::make_unique because the constructor of
        RangeIteratorLL is private */
     std::unique_ptr<BasicLinkedList::RangeIteratorLL> pRangeItr(
-            new BasicLinkedList::RangeIteratorLL(ll, isBackfill));
+            new BasicLinkedList::RangeIteratorLL(ll, isBackfill, start));
     return pRangeItr->tryLater() ? nullptr : std::move(pRangeItr);
 }
 
 BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
-                                                  bool isBackfill)
+                                                  bool isBackfill,
+                                                  seqno_t start)
     : list(ll),
       /* Try to get range read lock, do not block */
       readLockHolder(list.rangeReadLock, std::try_to_lock),
@@ -475,11 +546,19 @@ BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
         return;
     }
 
-    /* Iterator to the beginning of linked list */
-    currIt = list.seqList.begin();
+    /* Iterator to the beginning of linked list, or (with a start seqno) to
+       the closest indexed element before that seqno */
+    currIt = list.findStart(start);
 
-    /* Number of items that can be iterated over */
+    /* Number of items that can be iterated over. When starting part way
+       through the list this is an upper bound */
     numRemaining = list.seqList.size();
+    if (currIt != list.seqList.begin()) {
+        numRemaining = std::min(
+                numRemaining,
+                uint64_t(list.seqList.back().getBySeqno() -
+                         currIt->getBySeqno() + 1));
+    }
 
     /* The minimum seqno in the iterator that must be read to get a consistent
        read snapshot */
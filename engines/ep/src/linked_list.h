@@ -33,6 +33,8 @@
 #include <platform/non_negative_counter.h>
 #include <relaxed_atomic.h>
 
+#include <map>
+
 /* This option will configure "list" to use the member hook */
 using MemberHookOption =
         boost::intrusive::member_hook<OrderedStoredValue,
@@ -145,10 +147,25 @@ private:
  * 'writeLock' and 'rangeLock' are held for short durations, typically for
  * single list element writes and reads.
  * 'rangeReadLock' is held for longer duration on the list (for entire range).
+ *
+ * Seqno Index:
+ * ===========
+ * Optionally the list keeps a sparse index from seqno to list element (an
+ * entry for roughly every 'indexInterval' seqnos appended), so a range read
+ * or range iterator starting at a high seqno, and the tombstone purger, can
+ * start walking the list near where they need to be rather than at its head.
+ * An element is dropped from the index when it is moved to the end of the
+ * list or removed from it; the index is guarded by the writeLock.
  */
 class BasicLinkedList : public SequenceList {
 public:
-    BasicLinkedList(uint16_t vbucketId, EPStats& st);
+    /**
+     * @param vbucketId the vbucket the list belongs to (for logging)
+     * @param st the stats to account memory to
+     * @param indexInterval index one element every this many seqnos; 0
+     *        disables the seqno index
+     */
+    BasicLinkedList(uint16_t vbucketId, EPStats& st, size_t indexInterval = 0);
 
     ~BasicLinkedList();
 
@@ -204,7 +221,12 @@ public:
     std::mutex& getListWriteLock() const override;
 
     boost::optional<SequenceList::RangeIterator> makeRangeIterator(
-            bool isBackfill) override;
+            bool isBackfill, seqno_t start = 0) override;
+
+    /**
+     * Returns the number of elements in the seqno index
+     */
+    size_t getIndexSize() const;
 
     void dump() const override;
 
@@ -259,6 +281,20 @@ protected:
 private:
     OrderedLL::iterator purgeListElem(OrderedLL::iterator it);
 
+    /**
+     * Returns the position to start walking the list from to reach the
+     * first element with seqno >= 'seqno': the indexed element with the
+     * highest seqno <= 'seqno', else the head of the list.
+     * The caller must hold the writeLock.
+     */
+    OrderedLL::iterator findStart(seqno_t seqno);
+
+    /**
+     * Drop 'v' from the seqno index if it is indexed.
+     * The caller must hold the writeLock.
+     */
+    void removeFromIndex(const OrderedStoredValue& v);
+
     /**
      * We need to keep track of the highest seqno separately because there is a
      * small window wherein the last element of the list (though in correct
@@ -311,6 +347,20 @@ private:
     /* Point at which the tombstone purging was paused */
     OrderedLL::iterator pausedPurgePoint;
 
+    /* Index one element every 'indexInterval' seqnos; 0 disables the index */
+    const size_t indexInterval;
+
+    /* Sparse index of seqno => list element. Guarded by writeLock */
+    std::map<seqno_t, OrderedStoredValue*> seqnoIndex;
+
+    /* Seqno of the element last added to seqnoIndex. Guarded by writeLock */
+    seqno_t lastIndexedSeqno;
+
+    /* The lowest seqno of an element marked stale since a purge last started
+       from the beginning; purges need not look at anything before it.
+       Guarded by writeLock */
+    seqno_t lowestStaleSeqno;
+
     friend std::ostream& operator<<(std::ostream& os,
                                     const BasicLinkedList& ll);
 
@@ -325,12 +375,15 @@ private:
          * @param ll ref to the linkedlist on which the iterator is created
          * @param isBackfill indicates if the iterator is for backfill (for
          *                   debug)
+         * @param start the lowest seqno the client is interested in; the
+         *              iterator starts at or before it
          *
          * @return Non-null pointer on success, or null if a RangeIteratorLL
          *         already exists.
          */
         static std::unique_ptr<RangeIteratorLL> create(BasicLinkedList& ll,
-                                                       bool isBackfill);
+                                                       bool isBackfill,
+                                                       seqno_t start = 0);
 
         ~RangeIteratorLL();
 
@@ -364,7 +417,7 @@ private:
     private:
         /* We have a private constructor because we want to create the iterator
            optionally, that is, only when it is possible to get a read lock */
-        RangeIteratorLL(BasicLinkedList& ll, bool isBackfill);
+        RangeIteratorLL(BasicLinkedList& ll, bool isBackfill, seqno_t start);
 
         /**
          * Indicates if the client should try creating the iterator at a later
@@ -61,7 +61,8 @@ void PersistenceCallback::callback(TransactionContext& txCtx,
             }
         }
 
-        vbucket.doStatsForFlushing(*queuedItem, queuedItem->size());
+        vbucket.doStatsForFlushing(*queuedItem,
+                                   queuedItem->sizeWithoutCompressedValue());
         --epCtx.stats.diskQueueSize;
         epCtx.stats.totalPersisted++;
     } else {
@@ -87,7 +88,8 @@ void PersistenceCallback::callback(TransactionContext& txCtx,
                     queuedItem->getVBucketId());
             }
 
-            vbucket.doStatsForFlushing(*queuedItem, queuedItem->size());
+            vbucket.doStatsForFlushing(
+                    *queuedItem, queuedItem->sizeWithoutCompressedValue());
             --epCtx.stats.diskQueueSize;
         } else {
             LOG(EXTENSION_LOG_WARNING,
@@ -134,7 +136,8 @@ void PersistenceCallback::redirty(EPStats& stats, VBucket& vbucket) {
     if (vbucket.isDeletionDeferred()) {
         // updating the member stats for the vbucket is not really necessary
         // as the vbucket is about to be deleted
-        vbucket.doStatsForFlushing(*queuedItem, queuedItem->size());
+        vbucket.doStatsForFlushing(*queuedItem,
+                                   queuedItem->sizeWithoutCompressedValue());
         // the following is a global stat and so is worth updating
         --stats.diskQueueSize;
         return;
@@ -74,7 +74,8 @@ protected:
      * (c) Reading all the items from the iterator results in point-in-time
      *     snapshot.
      * (d) Only 1 iterator can be created for now.
-     * (e) Currently iterator can be created only from start till end
+     * (e) Currently iterator can be created only from (at or before) a given
+     *     seqno till end
      */
     class RangeIteratorImpl {
     public:
@@ -421,12 +422,15 @@ public:
      * the SequenceList, new range iterator will not be allowed
      *
      * @param isBackfill indicates if the iterator is for backfill (for debug)
+     * @param start hint that the caller is only interested in items with
+     *              seqno >= start; the iterator may begin at any item at or
+     *              before it (0 begins at the start of the list)
      *
      * @return range iterator object when possible
      *         null when not possible
      */
     virtual boost::optional<SequenceList::RangeIterator> makeRangeIterator(
-            bool isBackfill) = 0;
+            bool isBackfill, seqno_t start = 0) = 0;
 
     /**
      * Debug - prints a representation of the list to stderr.
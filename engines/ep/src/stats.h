@@ -301,6 +301,27 @@ public:
     //! Number of cursors dropped by checkpoint remover
     Counter cursorsDropped;
 
+    //! Number of values compressed for sending by DCP producers
+    Counter dcpValuesCompressed;
+    //! Number of values sent by DCP producers using a compressed copy
+    //! already made for another stream
+    Counter dcpCompressionCacheHits;
+    //! Total time spent compressing values for DCP (in microseconds)
+    Counter dcpCompressionTime;
+    //! Total bytes DCP producers saved by sending values compressed
+    Counter dcpCompressionBytesSaved;
+
+    //! Number of disk scans started by DCP backfills
+    Counter dcpBackfillScans;
+    //! Number of DCP backfills which joined a disk scan already in progress
+    //! for another stream instead of starting their own
+    Counter dcpBackfillScansAvoided;
+    //! Number of items read by DCP disk backfills (once per item read, however
+    //! many streams it is sent to)
+    Counter dcpBackfillItemsRead;
+    //! Total time spent in KVStore::scan by DCP backfills (in microseconds)
+    Counter dcpBackfillScanTime;
+
     //! Number of times we needed to kick in the pager
     Counter pagerRuns;
     //! Number of times the expiry pager runs for purging expired items
@@ -410,6 +431,9 @@ public:
     MicrosecondHistogram checkpointRemoverHisto;
     //! Histogram of item pager run times
     MicrosecondHistogram itemPagerHisto;
+    //! Histogram of the time from an item pager run starting to memory usage
+    //! dropping below the low watermark
+    MicrosecondHistogram itemPagerTimeToLowWatHisto;
     //! Histogram of expiry pager run times
     MicrosecondHistogram expiryPagerHisto;
 
@@ -536,6 +560,14 @@ public:
 
     //! Historgram of batch reads
     MicrosecondHistogram getMultiHisto;
+    //! Histogram of the time a vBucket's bg fetches waited in the BgFetcher
+    //! pipeline before a fetcher task started reading them
+    MicrosecondHistogram bgFetchPipelineWaitHisto;
+    //! Histogram of the time spent reading a batch of bg fetches from disk
+    MicrosecondHistogram bgFetchDiskHisto;
+    //! Histogram of the time spent completing a batch of bg fetches (after
+    //! reading it from disk)
+    MicrosecondHistogram bgFetchCompleteHisto;
 
     // ! Histograms of various task wait times, one per Task.
     std::vector<MicrosecondHistogram> schedulingHisto;
@@ -556,6 +588,14 @@ public:
         dirtyAgeHighWat.store(0);
         commit_time.store(0);
         cursorsDropped.store(0);
+        dcpValuesCompressed.store(0);
+        dcpCompressionCacheHits.store(0);
+        dcpCompressionTime.store(0);
+        dcpCompressionBytesSaved.store(0);
+        dcpBackfillScans.store(0);
+        dcpBackfillScansAvoided.store(0);
+        dcpBackfillItemsRead.store(0);
+        dcpBackfillScanTime.store(0);
         pagerRuns.store(0);
         itemsRemovedFromCheckpoints.store(0);
         numValueEjects.store(0);
@@ -591,6 +631,7 @@ public:
         accessScannerHisto.reset();
         checkpointRemoverHisto.reset();
         itemPagerHisto.reset();
+        itemPagerTimeToLowWatHisto.reset();
         expiryPagerHisto.reset();
         getVbucketCmdHisto.reset();
         setVbucketCmdHisto.reset();
@@ -611,6 +652,9 @@ public:
         dirtyAgeHisto.reset();
         mlogCompactorHisto.reset();
         getMultiHisto.reset();
+        bgFetchPipelineWaitHisto.reset();
+        bgFetchDiskHisto.reset();
+        bgFetchCompleteHisto.reset();
         persistenceCursorGetItemsHisto.reset();
         dcpCursorsGetItemsHisto.reset();
     }
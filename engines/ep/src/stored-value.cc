@@ -21,6 +21,7 @@
 
 #include "ep_time.h"
 #include "item.h"
+#include "item_eviction.h"
 #include "objectregistry.h"
 #include "stats.h"
 
@@ -31,6 +32,7 @@ const int64_t StoredValue::state_deleted_key = -3;
 const int64_t StoredValue::state_non_existent_key = -4;
 const int64_t StoredValue::state_temp_init = -5;
 const int64_t StoredValue::state_collection_open = -6;
+const uint8_t StoredValue::initialFreqCount;
 
 StoredValue::StoredValue(const Item& itm,
                          UniquePtr n,
@@ -44,7 +46,8 @@ StoredValue::StoredValue(const Item& itm,
       lock_expiry_or_delete_time(0),
       exptime(itm.getExptime()),
       flags(itm.getFlags()),
-      datatype(itm.getDataType()) {
+      datatype(itm.getDataType()),
+      freqCounter(initialFreqCount) {
     // Initialise bit fields
     setDeletedPriv(itm.isDeleted());
     setNewCacheItem(true);
@@ -84,7 +87,8 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
       lock_expiry_or_delete_time(other.lock_expiry_or_delete_time),
       exptime(other.exptime),
       flags(other.flags),
-      datatype(other.datatype) {
+      datatype(other.datatype),
+      freqCounter(other.freqCounter) {
     setDirty(other.isDirty());
     setDeletedPriv(other.isDeleted());
     setNewCacheItem(other.isNewCacheItem());
@@ -135,6 +139,11 @@ uint8_t StoredValue::incrNRUValue() {
     return ret;
 }
 
+uint8_t StoredValue::incrFreqCounterValue() {
+    freqCounter = ItemEviction::incrFreqCounter(freqCounter);
+    return freqCounter;
+}
+
 uint8_t StoredValue::getNRUValue() const {
     return getNru();
 }
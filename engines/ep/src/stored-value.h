@@ -136,6 +136,30 @@ public:
 
     uint8_t incrNRUValue();
 
+    /// Frequency counter value given to a newly created StoredValue.
+    static const uint8_t initialFreqCount = 4;
+
+    /**
+     * Get the access frequency counter used by the TinyLFU eviction policy.
+     * Callers should hold the HashBucketLock.
+     */
+    uint8_t getFreqCounterValue() const {
+        return freqCounter;
+    }
+
+    void setFreqCounterValue(uint8_t freq) {
+        freqCounter = freq;
+    }
+
+    /**
+     * Record an access in the frequency counter. The counter is logarithmic:
+     * the larger it is the less likely an access is to increment it, so
+     * 8 bits span several orders of magnitude of access counts.
+     *
+     * @return the new counter value (255 once saturated)
+     */
+    uint8_t incrFreqCounterValue();
+
     // Sets the top 16-bits of the chain_next_or_replacement pointer to the
     // u16int input value.
     void setChainTag(uint16_t v) {
@@ -762,6 +786,10 @@ protected:
 
     folly::AtomicBitSet<sizeof(uint8_t)> bits;
 
+    // Access frequency counter (TinyLFU eviction policy). Fits in what was
+    // previously tail padding so does not change sizeof(StoredValue).
+    uint8_t freqCounter;
+
     friend std::ostream& operator<<(std::ostream& os, const StoredValue& sv);
 };
 
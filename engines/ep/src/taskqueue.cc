@@ -157,6 +157,80 @@ bool TaskQueue::fetchNextTask(ExecutorThread &thread, bool toSleep) {
     return rv;
 }
 
+size_t TaskQueue::_fetchTasks(ExecutorThread& t,
+                              std::vector<ExTask>& tasks,
+                              size_t max) {
+    std::unique_lock<std::mutex> lh(mutex);
+
+    size_t numToWake = _moveReadyTasks(t.getCurTime());
+
+    if (!futureQueue.empty() && t.taskType == queueType &&
+        futureQueue.top()->getWaketime() < t.getWaketime()) {
+        // record earliest waketime
+        t.setWaketime(futureQueue.top()->getWaketime());
+    }
+
+    size_t fetched = 0;
+    while (fetched < max) {
+        if (readyQueue.empty() && pendingQueue.empty()) {
+            break;
+        }
+        // As in _fetchNextTask(): dead tasks are cleaned out first, otherwise
+        // any pending task is considered alongside the ready ones.
+        if (readyQueue.empty() || !readyQueue.top()->isdead()) {
+            _checkPendingQueue();
+        }
+        tasks.push_back(_popReadyTask());
+        ++fetched;
+    }
+
+    if (fetched == 0) {
+        numToWake = numToWake ? numToWake - 1 : 0; // 1 fewer task ready
+    }
+    _doWake_UNLOCKED(numToWake);
+
+    return fetched;
+}
+
+size_t TaskQueue::fetchTasks(ExecutorThread& thread,
+                             std::vector<ExTask>& tasks,
+                             size_t max) {
+    EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
+    size_t rv = _fetchTasks(thread, tasks, max);
+    ObjectRegistry::onSwitchThread(epe);
+    return rv;
+}
+
+bool TaskQueue::_fetchBorrowedTask(ExecutorThread& t,
+                                   std::chrono::microseconds maxDuration) {
+    bool ret = false;
+    std::unique_lock<std::mutex> lh(mutex);
+
+    size_t numToWake = _moveReadyTasks(t.getCurTime());
+
+    // Only ready tasks are borrowed; pending tasks are left for this
+    // queue's own threads.
+    if (!readyQueue.empty() &&
+        (readyQueue.top()->isdead() ||
+         readyQueue.top()->maxExpectedDuration() <= maxDuration)) {
+        t.setCurrentTask(_popReadyTask());
+        ret = true;
+    } else {
+        numToWake = numToWake ? numToWake - 1 : 0; // 1 fewer task ready
+    }
+
+    _doWake_UNLOCKED(numToWake);
+    return ret;
+}
+
+bool TaskQueue::fetchBorrowedTask(ExecutorThread& thread,
+                                  std::chrono::microseconds maxDuration) {
+    EventuallyPersistentEngine *epe = ObjectRegistry::onSwitchThread(NULL, true);
+    bool rv = _fetchBorrowedTask(thread, maxDuration);
+    ObjectRegistry::onSwitchThread(epe);
+    return rv;
+}
+
 size_t TaskQueue::_moveReadyTasks(const ProcessClock::time_point tv) {
     if (!readyQueue.empty()) {
         return 0;
@@ -229,6 +303,10 @@ void TaskQueue::_schedule(ExTask &task) {
     if (this != sleepQ) {
         sleepQ->doWake(numToWake);
     }
+    if (numToWake && task->getWaketime() <= ProcessClock::now()) {
+        // No thread of our type was asleep to run the task
+        manager->wakeBorrower(queueType);
+    }
 }
 
 void TaskQueue::schedule(ExTask &task) {
@@ -284,6 +362,10 @@ void TaskQueue::_wake(ExTask &task) {
     if (this != sleepQ) {
         sleepQ->doWake(readyCount);
     }
+    if (readyCount) {
+        // No thread of our type was asleep to run the task
+        manager->wakeBorrower(queueType);
+    }
 }
 
 void TaskQueue::wake(ExTask &task) {
@@ -25,8 +25,10 @@
 
 #include <platform/processclock.h>
 
+#include <chrono>
 #include <list>
 #include <queue>
+#include <vector>
 
 class ExecutorPool;
 class ExecutorThread;
@@ -47,6 +49,24 @@ public:
 
     bool fetchNextTask(ExecutorThread &thread, bool toSleep);
 
+    /**
+     * Work-stealing mode: move up to `max` ready tasks, highest priority
+     * first, into `tasks` for the given thread to run.
+     *
+     * @return the number of tasks fetched
+     */
+    size_t fetchTasks(ExecutorThread& thread,
+                      std::vector<ExTask>& tasks,
+                      size_t max);
+
+    /**
+     * Work-stealing mode: make the highest priority ready task the current
+     * task of a thread of another type, provided the task is not expected to
+     * run for longer than maxDuration.
+     */
+    bool fetchBorrowedTask(ExecutorThread& thread,
+                           std::chrono::microseconds maxDuration);
+
     void wake(ExTask &task);
 
     static const std::string taskType2Str(task_type_t type);
@@ -70,6 +90,11 @@ private:
     ProcessClock::time_point _reschedule(ExTask &task);
     void _checkPendingQueue(void);
     bool _fetchNextTask(ExecutorThread &thread, bool toSleep);
+    size_t _fetchTasks(ExecutorThread& thread,
+                       std::vector<ExTask>& tasks,
+                       size_t max);
+    bool _fetchBorrowedTask(ExecutorThread& thread,
+                            std::chrono::microseconds maxDuration);
     void _wake(ExTask &task);
     bool _doSleep(ExecutorThread &thread, std::unique_lock<std::mutex>& lock);
     void _doWake_UNLOCKED(size_t &numToWake);
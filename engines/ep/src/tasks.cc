@@ -67,17 +67,19 @@ bool StatSnap::run() {
 }
 
 MultiBGFetcherTask::MultiBGFetcherTask(EventuallyPersistentEngine* e,
-                                       BgFetcher* b)
+                                       BgFetcher* b,
+                                       bool helper)
     : GlobalTask(e,
                  TaskId::MultiBGFetcherTask,
                  /*sleeptime*/ INT_MAX,
                  /*completeBeforeShutdown*/ false),
-      bgfetcher(b) {
+      bgfetcher(b),
+      helper(helper) {
 }
 
 bool MultiBGFetcherTask::run() {
     TRACE_EVENT0("ep-engine/task", "MultiBGFetcherTask");
-    return bgfetcher->run(this);
+    return helper ? bgfetcher->runHelper(this) : bgfetcher->run(this);
 }
 
 bool DeleteAllTask::run() {
@@ -131,7 +131,13 @@ private:
 class BgFetcher;
 class MultiBGFetcherTask : public GlobalTask {
 public:
-    MultiBGFetcherTask(EventuallyPersistentEngine* e, BgFetcher* b);
+    /**
+     * @param helper if true, only fetch the vBuckets queued by the
+     *               BgFetcher's primary task (see BgFetcher::runHelper)
+     */
+    MultiBGFetcherTask(EventuallyPersistentEngine* e,
+                       BgFetcher* b,
+                       bool helper = false);
 
     bool run();
 
@@ -152,6 +158,7 @@ public:
 
 private:
     BgFetcher *bgfetcher;
+    const bool helper;
 };
 
 /**
@@ -17,8 +17,13 @@
 
 #include "vb_visitors.h"
 
+#include "globaltask.h"
 #include "vbucket.h"
 
+bool VBucketVisitor::shouldYield() {
+    return task && task->shouldYield();
+}
+
 PauseResumeVBAdapter::PauseResumeVBAdapter(
         std::unique_ptr<VBucketAwareHTVisitor> htVisitor)
     : htVisitor(std::move(htVisitor)) {
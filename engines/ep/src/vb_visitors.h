@@ -22,6 +22,7 @@
 #include "hash_table.h"
 #include "vb_filter.h"
 
+class GlobalTask;
 class HashTableVisitor;
 class VBucket;
 
@@ -63,8 +64,30 @@ public:
         return false;
     }
 
+    /**
+     * Set the task running this visitor, whose runtime budget a long
+     * visitBucket() should respect (see shouldYield()).
+     */
+    void setTask(GlobalTask& t) {
+        task = &t;
+    }
+
+    /**
+     * Return true if the last visitBucket() returned before it had finished
+     * with the vBucket, as the task's runtime budget was used up. The same
+     * vBucket is then passed to visitBucket() again, in the task's next
+     * run, to carry on from where it stopped.
+     */
+    virtual bool yieldedMidBucket() {
+        return false;
+    }
+
 protected:
+    /// @return true if the task running this visitor should yield.
+    bool shouldYield();
+
     VBucketFilter vBucketFilter;
+    GlobalTask* task = nullptr;
 };
 
 /**
@@ -151,7 +151,12 @@ VBucket::VBucket(id_type i,
                  int64_t hlcEpochSeqno,
                  bool mightContainXattrs,
                  const std::string& collectionsManifest)
-    : ht(st, std::move(valFact), config.getHtSize(), config.getHtLocks()),
+    : ht(st,
+         std::move(valFact),
+         config.getHtSize(),
+         config.getHtLocks(),
+         HashTable::layoutFromString(config.getHtLayout()),
+         HashTable::evictionPolicyFromString(config.getHtEvictionPolicy())),
       checkpointManager(std::make_unique<CheckpointManager>(st,
                                                             i,
                                                             chkConfig,
@@ -2017,7 +2022,7 @@ void VBucket::deletedOnDiskCbk(const Item& queuedItem, bool deleted) {
         ++stats.totalPersisted;
         ++opsDelete;
     }
-    doStatsForFlushing(queuedItem, queuedItem.size());
+    doStatsForFlushing(queuedItem, queuedItem.sizeWithoutCompressedValue());
     --stats.diskQueueSize;
     decrMetaDataDisk(queuedItem);
 }
@@ -34,6 +34,8 @@
 #include <platform/non_negative_counter.h>
 #include <relaxed_atomic.h>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <queue>
 
 class EPStats;
@@ -282,6 +284,30 @@ public:
         return deferredDeletionCookie;
     }
 
+    /**
+     * Set while a flush of this vBucket waits for its group commit to be
+     * made durable with the vBucket lock released (see
+     * EPBucket::commitGroup). Only changed with the vBucket lock held.
+     */
+    void setGroupSyncPending(bool pending) {
+        groupSyncPending = pending;
+        if (!pending) {
+            groupSyncDone.notify_all();
+        }
+    }
+
+    bool isGroupSyncPending() const {
+        return groupSyncPending;
+    }
+
+    /**
+     * Wait until no flush of this vBucket is waiting for its group commit.
+     * @param vbLock the held vBucket lock, released while waiting
+     */
+    void waitForGroupSync(std::unique_lock<std::mutex>& vbLock) {
+        groupSyncDone.wait(vbLock, [this] { return !groupSyncPending; });
+    }
+
     /**
      * Setup deferred deletion, this is where deletion of the vbucket is
      * deferred and completed by an AUXIO/NONIO task. AUXIO for EPVBucket
@@ -1728,6 +1754,9 @@ private:
     /// A cookie that can be set when the vbucket is deletion is deferred, the
     /// cookie will be notified when the deferred deletion completes
     const void* deferredDeletionCookie;
+    /// A flush is waiting for its group commit (guarded by the vBucket lock)
+    bool groupSyncPending = false;
+    std::condition_variable groupSyncDone;
 
     // Ptr to the item conflict resolution module
     std::unique_ptr<ConflictResolution> conflictResolver;
@@ -1790,6 +1819,11 @@ public:
         return lock.owns_lock();
     }
 
+    /// @return the lock on the VBucket's mutex.
+    std::unique_lock<std::mutex>& getLock() {
+        return lock;
+    }
+
 private:
     VBucketPtr vb;
     std::unique_lock<std::mutex> lock;
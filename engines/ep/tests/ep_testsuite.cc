@@ -6333,6 +6333,9 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "vb_0:mem_size_counted",
               "vb_0:min_depth",
               "vb_0:reported",
+              "vb_0:resize_buckets_migrated",
+              "vb_0:resize_buckets_total",
+              "vb_0:resize_max_stall_us",
               "vb_0:resized",
               "vb_0:size",
               "vb_0:state"}},
@@ -6424,8 +6427,11 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                         "ep_bfilter_key_count",
                         "ep_bfilter_residency_threshold",
                         "ep_bg_fetch_delay",
+                        "ep_bg_fetch_pipeline_depth",
                         "ep_bucket_type",
                         "ep_cache_size",
+                        "ep_chk_cursor_batch_bytes",
+                        "ep_chk_cursor_batch_items",
                         "ep_chk_max_items",
                         "ep_chk_period",
                         "ep_chk_remover_stime",
@@ -6437,11 +6443,16 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                         "ep_conflict_resolution_type",
                         "ep_connection_manager_interval",
                         "ep_couch_bucket",
+                        "ep_couchstore_async_io",
                         "ep_cursor_dropping_lower_mark",
                         "ep_cursor_dropping_upper_mark",
                         "ep_data_traffic_enabled",
                         "ep_dbname",
                         "ep_dcp_backfill_byte_limit",
+                        "ep_dcp_backfill_parallelism",
+                        "ep_dcp_backfill_shared_scan",
+                        "ep_dcp_batch_seqno_notifications",
+                        "ep_dcp_compression_cache_enabled",
                         "ep_dcp_conn_buffer_size",
                         "ep_dcp_conn_buffer_size_aggr_mem_threshold",
                         "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6455,6 +6466,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                         "ep_dcp_idle_timeout",
                         "ep_dcp_noop_mandatory_for_v5_features",
                         "ep_dcp_noop_tx_interval",
+                        "ep_dcp_producer_batch_bytes",
                         "ep_dcp_producer_snapshot_marker_yield_limit",
                         "ep_dcp_consumer_process_buffered_messages_yield_limit",
                         "ep_dcp_consumer_process_buffered_messages_batch_size",
@@ -6467,18 +6479,25 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                         "ep_defragmenter_interval",
                         "ep_enable_chk_merge",
                         "ep_enable_dcp_consumer_snappy_compression",
+                        "ep_executor_work_stealing",
                         "ep_exp_pager_enabled",
                         "ep_exp_pager_initial_run_time",
                         "ep_exp_pager_stime",
                         "ep_failpartialwarmup",
                         "ep_flushall_enabled",
+                        "ep_flusher_group_commit_max_delay_ms",
+                        "ep_flusher_group_commit_vbuckets",
                         "ep_fsync_after_every_n_bytes_written",
                         "ep_getl_default_timeout",
                         "ep_getl_max_timeout",
                         "ep_hlc_drift_ahead_threshold_us",
                         "ep_hlc_drift_behind_threshold_us",
+                        "ep_ht_eviction_policy",
+                        "ep_ht_layout",
                         "ep_ht_locks",
                         "ep_ht_resize_interval",
+                        "ep_ht_resize_mode",
+                        "ep_ht_resize_step_budget_us",
                         "ep_ht_size",
                         "ep_initfile",
                         "ep_item_num_based_new_chk",
@@ -6506,6 +6525,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                         "ep_num_reader_threads",
                         "ep_num_writer_threads",
                         "ep_pager_active_vb_pcnt",
+                        "ep_pager_concurrent_visitors",
                         "ep_pager_sleep_time_ms",
                         "ep_postInitfile",
                         "ep_replication_throttle_cap_pcnt",
@@ -6589,6 +6609,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_bfilter_residency_threshold",
               "ep_bg_fetch_avg_read_amplification",
               "ep_bg_fetch_delay",
+              "ep_bg_fetch_pipeline_depth",
               "ep_bg_fetched",
               "ep_bg_meta_fetched",
               "ep_bg_remaining_items",
@@ -6598,6 +6619,8 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_bucket_priority",
               "ep_bucket_type",
               "ep_cache_size",
+              "ep_chk_cursor_batch_bytes",
+              "ep_chk_cursor_batch_items",
               "ep_chk_max_items",
               "ep_chk_period",
               "ep_chk_persistence_remains",
@@ -6611,6 +6634,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_conflict_resolution_type",
               "ep_connection_manager_interval",
               "ep_couch_bucket",
+              "ep_couchstore_async_io",
               "ep_cursor_dropping_lower_mark",
               "ep_cursor_dropping_lower_threshold",
               "ep_cursor_dropping_upper_mark",
@@ -6621,6 +6645,10 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_parallelism",
+              "ep_dcp_backfill_shared_scan",
+              "ep_dcp_batch_seqno_notifications",
+              "ep_dcp_compression_cache_enabled",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
@@ -6636,6 +6664,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_dcp_min_compression_ratio",
               "ep_dcp_noop_mandatory_for_v5_features",
               "ep_dcp_noop_tx_interval",
+              "ep_dcp_producer_batch_bytes",
               "ep_dcp_producer_snapshot_marker_yield_limit",
               "ep_dcp_scan_byte_limit",
               "ep_dcp_scan_item_limit",
@@ -6654,6 +6683,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_diskqueue_pending",
               "ep_enable_chk_merge",
               "ep_enable_dcp_consumer_snappy_compression",
+              "ep_executor_work_stealing",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
@@ -6665,13 +6695,19 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_flush_all",
               "ep_flush_duration_total",
               "ep_flushall_enabled",
+              "ep_flusher_group_commit_max_delay_ms",
+              "ep_flusher_group_commit_vbuckets",
               "ep_fsync_after_every_n_bytes_written",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_ht_eviction_policy",
+              "ep_ht_layout",
               "ep_ht_locks",
               "ep_ht_resize_interval",
+              "ep_ht_resize_mode",
+              "ep_ht_resize_step_budget_us",
               "ep_ht_size",
               "ep_initfile",
               "ep_io_bg_fetch_read_count",
@@ -6733,6 +6769,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
               "ep_oom_errors",
               "ep_overhead",
               "ep_pager_active_vb_pcnt",
+              "ep_pager_concurrent_visitors",
               "ep_pager_sleep_time_ms",
               "ep_pending_compactions",
               "ep_pending_ops",
@@ -6954,6 +6991,7 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                           "ep_ephemeral_metadata_purge_age",
                           "ep_ephemeral_metadata_purge_interval",
                           "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                          "ep_ephemeral_seqlist_index_interval",
 
                           "vb_active_auto_delete_count",
                           "vb_active_ht_tombstone_purged_count",
@@ -7008,7 +7046,8 @@ static enum test_result test_mb19687_fixed(ENGINE_HANDLE* h,
                  "ep_ephemeral_metadata_mark_stale_chunk_duration",
                  "ep_ephemeral_metadata_purge_age",
                  "ep_ephemeral_metadata_purge_interval",
-                 "ep_ephemeral_metadata_purge_stale_chunk_duration"});
+                 "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                 "ep_ephemeral_seqlist_index_interval"});
     }
 
     // In addition to the exact stat keys above, we also use regex patterns
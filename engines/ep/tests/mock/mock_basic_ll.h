@@ -29,7 +29,8 @@
 
 class MockBasicLinkedList : public BasicLinkedList {
 public:
-    MockBasicLinkedList(EPStats& st) : BasicLinkedList(0, st) {
+    MockBasicLinkedList(EPStats& st, size_t indexInterval = 0)
+        : BasicLinkedList(0, st, indexInterval) {
     }
 
     OrderedLL& getSeqList() {
@@ -322,6 +322,7 @@ static ENGINE_ERROR_CODE mock_control(gsl::not_null<const void*> cookie,
 
 static ENGINE_ERROR_CODE mock_system_event(gsl::not_null<const void*> cookie,
                                            uint32_t opaque,
+                                           item* itm,
                                            uint16_t vbucket,
                                            mcbp::systemevent::id event,
                                            uint64_t bySeqno,
@@ -329,6 +330,9 @@ static ENGINE_ERROR_CODE mock_system_event(gsl::not_null<const void*> cookie,
                                            cb::const_byte_buffer eventData) {
     (void)cookie;
     clear_dcp_data();
+    if (itm != nullptr && engine_handle_v1 && engine_handle) {
+        engine_handle_v1->release(engine_handle, itm);
+    }
     return ENGINE_SUCCESS;
 }
 }
@@ -104,6 +104,26 @@ public:
         return DcpProducer::findStream(vbid);
     }
 
+    /**
+     * Model steps of the producer which send everything its streams have
+     * ready: take each vbucket off the ready queue and run its stream until
+     * it has nothing more to send.
+     */
+    void drainReadyQueue() {
+        uint16_t vbid;
+        while (ready.popFront(vbid)) {
+            auto stream = findStream(vbid);
+            if (stream) {
+                while (stream->next()) {
+                }
+            }
+        }
+    }
+
+    size_t getReadyQueueSize() {
+        return ready.size();
+    }
+
     std::string getCurrentSeparatorForStream(uint16_t vbid) {
         auto stream = findStream(vbid);
         if (stream) {
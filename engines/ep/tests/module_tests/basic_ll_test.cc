@@ -1037,3 +1037,126 @@ TEST_F(BasicLinkedListTest, PurgePauseResumeWithUpdateAtPausedPoint) {
     EXPECT_GE(numPaused, 1);
     EXPECT_EQ(numItems, basicLL->getNumItems());
 }
+
+/* The same list operations with the seqno index enabled, indexing (at most)
+   every other seqno */
+class BasicLinkedListIndexTest : public BasicLinkedListTest {
+protected:
+    void SetUp() override {
+        basicLL = std::make_unique<MockBasicLinkedList>(global_stats, 2);
+    }
+
+    std::vector<seqno_t> readWithIterator(seqno_t start) {
+        auto itrOptional = basicLL->makeRangeIterator(true /*isBackfill*/,
+                                                      start);
+        EXPECT_TRUE(itrOptional);
+        auto& itr = *itrOptional;
+        if (start > 0) {
+            EXPECT_LE(itr.curr(), start);
+        }
+
+        std::vector<seqno_t> seqnos;
+        while (itr.curr() != itr.end()) {
+            if ((*itr).getBySeqno() >= start) {
+                seqnos.push_back((*itr).getBySeqno());
+            }
+            ++itr;
+        }
+        return seqnos;
+    }
+};
+
+TEST_F(BasicLinkedListIndexTest, RangeReadFromMid) {
+    const int numItems = 10;
+    addNewItemsToList(1, std::string("key"), numItems);
+    EXPECT_EQ(numItems / 2, basicLL->getIndexSize());
+
+    ENGINE_ERROR_CODE status;
+    std::vector<UniqueItemPtr> items;
+    seqno_t endSeqno;
+    std::tie(status, items, endSeqno) = basicLL->rangeRead(7, numItems);
+
+    EXPECT_EQ(ENGINE_SUCCESS, status);
+    ASSERT_EQ(4, items.size());
+    EXPECT_EQ(7, items.front()->getBySeqno());
+    EXPECT_EQ(numItems, items.back()->getBySeqno());
+    EXPECT_EQ(numItems, endSeqno);
+}
+
+/* Moving an indexed element to the end of the list must drop it from the
+   index */
+TEST_F(BasicLinkedListIndexTest, RangeReadAfterUpdate) {
+    const int numItems = 10;
+    addNewItemsToList(1, std::string("key"), numItems);
+
+    /* key4 is indexed; it moves to the end with seqno 11 (too close to the
+       last indexed seqno to be indexed again) */
+    updateItem(numItems, std::string("key4"));
+    EXPECT_EQ(numItems / 2 - 1, basicLL->getIndexSize());
+
+    ENGINE_ERROR_CODE status;
+    std::vector<UniqueItemPtr> items;
+    seqno_t endSeqno;
+    std::tie(status, items, endSeqno) = basicLL->rangeRead(5, numItems + 1);
+
+    EXPECT_EQ(ENGINE_SUCCESS, status);
+    std::vector<seqno_t> expectedSeqno = {5, 6, 7, 8, 9, 10, 11};
+    std::vector<seqno_t> actualSeqno;
+    for (const auto& item : items) {
+        actualSeqno.push_back(item->getBySeqno());
+    }
+    EXPECT_EQ(expectedSeqno, actualSeqno);
+}
+
+TEST_F(BasicLinkedListIndexTest, RangeIteratorFromSeqno) {
+    const int numItems = 10;
+    addNewItemsToList(1, std::string("key"), numItems);
+
+    std::vector<seqno_t> expectedSeqno = {7, 8, 9, 10};
+    EXPECT_EQ(expectedSeqno, readWithIterator(7));
+
+    /* Starting from 0 (or before the first index entry) reads everything */
+    EXPECT_EQ(numItems, readWithIterator(0).size());
+    EXPECT_EQ(numItems, readWithIterator(1).size());
+}
+
+/* Purging a stale element drops it from the index, and a purge after items
+   have been marked stale finds them all */
+TEST_F(BasicLinkedListIndexTest, Purge) {
+    const std::string keyPrefix("key");
+    addNewItemsToList(1, keyPrefix, 5);
+    addStaleItem("stale6", 6);
+    addNewItemsToList(7, keyPrefix, 4);
+    ASSERT_EQ(1, basicLL->getNumStaleItems());
+
+    EXPECT_EQ(1, basicLL->purgeTombstones(10));
+    EXPECT_EQ(0, basicLL->getNumStaleItems());
+    EXPECT_EQ(4, basicLL->getIndexSize());
+
+    /* Nothing left to purge */
+    EXPECT_EQ(0, basicLL->purgeTombstones(10));
+
+    /* Mark another item stale */
+    addStaleItem("stale11", 11);
+    addNewItemsToList(12, keyPrefix, 2);
+    EXPECT_EQ(1, basicLL->purgeTombstones(13));
+
+    std::vector<seqno_t> expectedSeqno = {1, 2, 3, 4, 5, 7, 8, 9, 10, 12, 13};
+    EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
+}
+
+/* A purge which stops at purgeUpToSeqno must not lose track of stale items
+   after that point */
+TEST_F(BasicLinkedListIndexTest, PurgeBeyondPurgeUpToSeqno) {
+    const std::string keyPrefix("key");
+    addNewItemsToList(1, keyPrefix, 4);
+    addStaleItem("stale5", 5);
+    addNewItemsToList(6, keyPrefix, 4);
+
+    /* The stale item is beyond the purge seqno */
+    EXPECT_EQ(0, basicLL->purgeTombstones(4));
+    EXPECT_EQ(1, basicLL->getNumStaleItems());
+
+    EXPECT_EQ(1, basicLL->purgeTombstones(9));
+    EXPECT_EQ(0, basicLL->getNumStaleItems());
+}
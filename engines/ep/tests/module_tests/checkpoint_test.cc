@@ -84,6 +84,11 @@ protected:
         createManager();
     }
 
+    // Handle of the current manager's persistence cursor.
+    CursorHandle persistenceCursor() const {
+        return manager->getPersistenceCursor();
+    }
+
     void createManager(int64_t last_seqno = 1000) {
         manager.reset(new CheckpointManager(global_stats,
                                             this->vbucket->getId(),
@@ -127,7 +132,7 @@ protected:
 struct thread_args {
     VBucket* vbucket;
     CheckpointManager *checkpoint_manager;
-    std::string name;
+    CursorHandle cursor;
     ThreadGate& gate;
 };
 
@@ -139,8 +144,8 @@ static void launch_persistence_thread(void *arg) {
     while(true) {
         size_t itemPos;
         std::vector<queued_item> items;
-        const std::string cursor(CheckpointManager::pCursorName);
-        args->checkpoint_manager->getAllItemsForCursor(cursor, items);
+        args->checkpoint_manager->getAllItemsForCursor(
+                args->checkpoint_manager->getPersistenceCursor(), items);
         for(itemPos = 0; itemPos < items.size(); ++itemPos) {
             queued_item qi = items.at(itemPos);
             if (qi->getOperation() == queue_op::flush) {
@@ -173,7 +178,7 @@ static void launch_dcp_client_thread(void* arg) {
     bool flush = false;
     bool isLastItem = false;
     while(true) {
-        queued_item qi = args->checkpoint_manager->nextItem(args->name,
+        queued_item qi = args->checkpoint_manager->nextItem(args->cursor,
                                                             isLastItem);
         if (qi->getOperation() == queue_op::flush) {
             flush = true;
@@ -259,10 +264,13 @@ TYPED_TEST(CheckpointTest, basic_chk_test) {
     std::vector<thread_args> dcp_t_args;
     for (size_t i = 0; i < n_dcp_threads; ++i) {
         std::string name(DCP_CURSOR_PREFIX + std::to_string(i));
-        dcp_t_args.emplace_back(thread_args{
-                this->vbucket.get(), this->manager.get(), name, gate});
         this->manager->registerCursor(
                 name, 1, false, MustSendCheckpointEnd::YES);
+        dcp_t_args.emplace_back(
+                thread_args{this->vbucket.get(),
+                            this->manager.get(),
+                            this->manager->getCursorHandle(name),
+                            gate});
     }
 
     rc = cb_create_thread(&persistence_thread, launch_persistence_thread, &t_args, 0);
@@ -306,9 +314,7 @@ TYPED_TEST(CheckpointTest, basic_chk_test) {
     for (size_t i = 0; i < n_dcp_threads; ++i) {
         rc = cb_join_thread(dcp_threads[i]);
         EXPECT_EQ(0, rc);
-        std::stringstream name;
-        name << "dcp-client-" << i;
-        this->manager->removeCursor(name.str());
+        EXPECT_TRUE(this->manager->removeCursor(dcp_t_args[i].cursor));
     }
 
     rc = cb_join_thread(checkpoint_cleanup_thread);
@@ -323,14 +329,14 @@ TYPED_TEST(CheckpointTest, reset_checkpoint_id) {
     EXPECT_EQ(10, this->manager->getNumOpenChkItems());
     EXPECT_EQ(10,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     EXPECT_EQ(2, this->manager->createNewCheckpoint());
 
     size_t itemPos;
     size_t lastMutationId = 0;
     std::vector<queued_item> items;
-    const std::string cursor(CheckpointManager::pCursorName);
+    const auto cursor = this->persistenceCursor();
     auto range = this->manager->getAllItemsForCursor(cursor, items);
     EXPECT_EQ(0, range.start);
     EXPECT_EQ(1010, range.end);
@@ -370,12 +376,12 @@ TYPED_TEST(CheckpointTest, CheckFixture) {
     // Should initially be zero items to persist.
     EXPECT_EQ(0,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Check that the items fetched matches the number we were told to expect.
     std::vector<queued_item> items;
     auto result = this->manager->getAllItemsForCursor(
-            CheckpointManager::pCursorName, items);
+            this->persistenceCursor(), items);
     EXPECT_EQ(0, result.start);
     EXPECT_EQ(0, result.end);
     EXPECT_EQ(1, items.size());
@@ -407,7 +413,7 @@ TYPED_TEST(CheckpointTest, OneOpenCkpt) {
     EXPECT_EQ(20, qi->getRevSeqno());
     EXPECT_EQ(1,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Adding the same key again shouldn't increase the size.
     queued_item qi2(new Item(makeStoredDocKey("key1"),
@@ -426,7 +432,7 @@ TYPED_TEST(CheckpointTest, OneOpenCkpt) {
     EXPECT_EQ(21, qi2->getRevSeqno());
     EXPECT_EQ(1,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Adding a different key should increase size.
     queued_item qi3(new Item(makeStoredDocKey("key2"),
@@ -445,12 +451,12 @@ TYPED_TEST(CheckpointTest, OneOpenCkpt) {
     EXPECT_EQ(0, qi3->getRevSeqno());
     EXPECT_EQ(2,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Check that the items fetched matches the number we were told to expect.
     std::vector<queued_item> items;
     auto result = this->manager->getAllItemsForCursor(
-            CheckpointManager::pCursorName, items);
+            this->persistenceCursor(), items);
     EXPECT_EQ(0, result.start);
     EXPECT_EQ(1003, result.end);
     EXPECT_EQ(3, items.size());
@@ -483,7 +489,7 @@ TYPED_TEST(CheckpointTest, Delete) {
     // Check that the items fetched matches what was enqueued.
     std::vector<queued_item> items;
     auto result = this->manager->getAllItemsForCursor
-            (CheckpointManager::pCursorName, items);
+            (this->persistenceCursor(), items);
 
     EXPECT_EQ(0, result.start);
     EXPECT_EQ(1001, result.end);
@@ -524,12 +530,12 @@ TYPED_TEST(CheckpointTest, OneOpenOneClosed) {
     // Examine the items - should be 2 lots of two keys.
     EXPECT_EQ(4,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Check that the items fetched matches the number we were told to expect.
     std::vector<queued_item> items;
     auto result = this->manager->getAllItemsForCursor(
-            CheckpointManager::pCursorName, items);
+            this->persistenceCursor(), items);
     EXPECT_EQ(0, result.start);
     EXPECT_EQ(1004, result.end);
     EXPECT_EQ(7, items.size());
@@ -596,7 +602,7 @@ TYPED_TEST(CheckpointTest, ItemBasedCheckpointCreation) {
     EXPECT_EQ(1, this->manager->getNumOfCursors());
     snapshot_range_t range;
     std::vector<queued_item> items;
-    range = this->manager->getAllItemsForCursor(CheckpointManager::pCursorName,
+    range = this->manager->getAllItemsForCursor(this->persistenceCursor(),
                                                 items);
 
     EXPECT_EQ(0, range.start);
@@ -627,7 +633,7 @@ TYPED_TEST(CheckpointTest, CursorOffsetOnCheckpointClose) {
     // Use the existing persistence cursor for this test:
     EXPECT_EQ(
             2,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Cursor should initially have two items pending";
 
     // Check de-dupe counting - after adding another item with the same key,
@@ -638,7 +644,7 @@ TYPED_TEST(CheckpointTest, CursorOffsetOnCheckpointClose) {
 
     EXPECT_EQ(
             2,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected 2 items for cursor (2x op_set) after adding a "
                "duplicate.";
 
@@ -648,28 +654,28 @@ TYPED_TEST(CheckpointTest, CursorOffsetOnCheckpointClose) {
     EXPECT_EQ(2, this->manager->getNumCheckpoints());
     EXPECT_EQ(
             2,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected 2 items for cursor after creating new checkpoint";
 
     // Advance cursor - first to get the 'checkpoint_start' meta item,
     // and a second time to get the a 'proper' mutation.
     bool isLastMutationItem;
-    auto item = this->manager->nextItem(CheckpointManager::pCursorName,
+    auto item = this->manager->nextItem(this->persistenceCursor(),
                                         isLastMutationItem);
     EXPECT_TRUE(item->isCheckPointMetaItem());
     EXPECT_FALSE(isLastMutationItem);
     EXPECT_EQ(
             2,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected 2 items for cursor after advancing one item";
 
-    item = this->manager->nextItem(CheckpointManager::pCursorName,
+    item = this->manager->nextItem(this->persistenceCursor(),
                                    isLastMutationItem);
     EXPECT_FALSE(item->isCheckPointMetaItem());
     EXPECT_FALSE(isLastMutationItem);
     EXPECT_EQ(
             1,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected 1 item for cursor after advancing by 1";
 
     // Add two items to the newly-opened checkpoint. Same keys as 1st ckpt,
@@ -680,22 +686,22 @@ TYPED_TEST(CheckpointTest, CursorOffsetOnCheckpointClose) {
 
     EXPECT_EQ(
             3,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected 3 items for cursor after adding 2 more to new "
                "checkpoint";
 
     // Advance the cursor 'out' of the first checkpoint.
-    item = this->manager->nextItem(CheckpointManager::pCursorName,
+    item = this->manager->nextItem(this->persistenceCursor(),
                                    isLastMutationItem);
     EXPECT_FALSE(item->isCheckPointMetaItem());
     EXPECT_TRUE(isLastMutationItem);
 
     // Now at the end of the first checkpoint, move into the next checkpoint.
-    item = this->manager->nextItem(CheckpointManager::pCursorName,
+    item = this->manager->nextItem(this->persistenceCursor(),
                                    isLastMutationItem);
     EXPECT_TRUE(item->isCheckPointMetaItem());
     EXPECT_TRUE(isLastMutationItem);
-    item = this->manager->nextItem(CheckpointManager::pCursorName,
+    item = this->manager->nextItem(this->persistenceCursor(),
                                    isLastMutationItem);
     EXPECT_TRUE(item->isCheckPointMetaItem());
     EXPECT_FALSE(isLastMutationItem);
@@ -716,21 +722,21 @@ TYPED_TEST(CheckpointTest, CursorOffsetOnCheckpointClose) {
 
     EXPECT_EQ(2,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Drain the remaining items.
-    item = this->manager->nextItem(CheckpointManager::pCursorName,
+    item = this->manager->nextItem(this->persistenceCursor(),
                                    isLastMutationItem);
     EXPECT_FALSE(item->isCheckPointMetaItem());
     EXPECT_FALSE(isLastMutationItem);
-    item = this->manager->nextItem(CheckpointManager::pCursorName,
+    item = this->manager->nextItem(this->persistenceCursor(),
                                    isLastMutationItem);
     EXPECT_FALSE(item->isCheckPointMetaItem());
     EXPECT_TRUE(isLastMutationItem);
 
     EXPECT_EQ(0,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 }
 
 // Test the getAllItemsForCursor()
@@ -762,12 +768,12 @@ TYPED_TEST(CheckpointTest, ItemsForCheckpointCursor) {
 
     /* Register DCP replication cursor */
     std::string dcp_cursor(DCP_CURSOR_PREFIX + std::to_string(1));
-    this->manager->registerCursorBySeqno(
-            dcp_cursor.c_str(), 0, MustSendCheckpointEnd::NO);
+    auto dcpCursor = this->manager->registerCursorBySeqno(
+            dcp_cursor.c_str(), 0, MustSendCheckpointEnd::NO).cursor;
 
     /* Get items for persistence*/
     std::vector<queued_item> items;
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
 
     /* We should have got (2 * MIN_CHECKPOINT_ITEMS + 3) items. 3 additional are
        op_ckpt_start, op_ckpt_end and op_ckpt_start */
@@ -775,10 +781,62 @@ TYPED_TEST(CheckpointTest, ItemsForCheckpointCursor) {
 
     /* Get items for DCP replication cursor */
     items.clear();
-    this->manager->getAllItemsForCursor(dcp_cursor.c_str(), items);
+    this->manager->getAllItemsForCursor(dcpCursor, items);
     EXPECT_EQ(2 * MIN_CHECKPOINT_ITEMS + 3, items.size());
 }
 
+// Test that getItemsForCursor() with batch limits only stops at checkpoint
+// boundaries and reports whether more items remain.
+TYPED_TEST(CheckpointTest, ItemsForCursorBatchLimits) {
+    // Three checkpoints of 10 mutations each (seqnos 1001..1030).
+    for (int chk = 0; chk < 3; chk++) {
+        if (chk > 0) {
+            this->manager->createNewCheckpoint();
+        }
+        for (int ii = 0; ii < 10; ii++) {
+            EXPECT_TRUE(this->queueNewItem("key" + std::to_string(chk) + "_" +
+                                           std::to_string(ii)));
+        }
+    }
+    ASSERT_EQ(3, this->manager->getNumCheckpoints());
+
+    const auto cursor = this->persistenceCursor();
+    std::vector<queued_item> items;
+
+    // An item limit of 1 still returns the whole of the first checkpoint:
+    // checkpoint_start, 10 mutations, checkpoint_end.
+    auto result = this->manager->getItemsForCursor(cursor, items, 1, 0);
+    EXPECT_TRUE(result.moreAvailable);
+    EXPECT_EQ(0, result.range.start);
+    EXPECT_EQ(1010, result.range.end);
+    ASSERT_EQ(12, items.size());
+    EXPECT_EQ(queue_op::checkpoint_start, items.front()->getOperation());
+    EXPECT_EQ(queue_op::checkpoint_end, items.back()->getOperation());
+
+    // Likewise for a byte limit, with the second checkpoint.
+    items.clear();
+    result = this->manager->getItemsForCursor(cursor, items, 0, 1);
+    EXPECT_TRUE(result.moreAvailable);
+    EXPECT_EQ(1020, result.range.end);
+    ASSERT_EQ(12, items.size());
+    EXPECT_EQ(1011, items.at(1)->getBySeqno());
+    EXPECT_EQ(queue_op::checkpoint_end, items.back()->getOperation());
+
+    // The open checkpoint has no end, so the remainder is returned.
+    items.clear();
+    result = this->manager->getItemsForCursor(cursor, items, 1, 1);
+    EXPECT_FALSE(result.moreAvailable);
+    EXPECT_EQ(1030, result.range.end);
+    ASSERT_EQ(11, items.size());
+    EXPECT_EQ(1030, items.back()->getBySeqno());
+    EXPECT_EQ(0, this->manager->getNumItemsForCursor(cursor));
+
+    items.clear();
+    result = this->manager->getItemsForCursor(cursor, items, 1, 1);
+    EXPECT_FALSE(result.moreAvailable);
+    EXPECT_TRUE(items.empty());
+}
+
 // Test the checkpoint cursor movement
 TYPED_TEST(CheckpointTest, CursorMovement) {
     /* We want to have items across 2 checkpoints. Size down the default number
@@ -809,19 +867,19 @@ TYPED_TEST(CheckpointTest, CursorMovement) {
 
     /* Register DCP replication cursor */
     std::string dcp_cursor(DCP_CURSOR_PREFIX + std::to_string(1));
-    this->manager->registerCursorBySeqno(
-            dcp_cursor.c_str(), 0, MustSendCheckpointEnd::NO);
+    auto dcpCursor = this->manager->registerCursorBySeqno(
+            dcp_cursor.c_str(), 0, MustSendCheckpointEnd::NO).cursor;
 
     /* Get items for persistence cursor */
     std::vector<queued_item> items;
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
 
     /* We should have got (MIN_CHECKPOINT_ITEMS + op_ckpt_start) items. */
     EXPECT_EQ(MIN_CHECKPOINT_ITEMS + 1, items.size());
 
     /* Get items for DCP replication cursor */
     items.clear();
-    this->manager->getAllItemsForCursor(dcp_cursor.c_str(), items);
+    this->manager->getAllItemsForCursor(dcpCursor, items);
     EXPECT_EQ(MIN_CHECKPOINT_ITEMS + 1, items.size());
 
     uint64_t curr_open_chkpt_id = this->manager->getOpenCheckpointId_UNLOCKED();
@@ -836,10 +894,10 @@ TYPED_TEST(CheckpointTest, CursorMovement) {
     /* Get items for persistence cursor */
     EXPECT_EQ(
             0,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected to have no normal (only meta) items";
     items.clear();
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
 
     /* We should have got op_ckpt_start item */
     EXPECT_EQ(1, items.size());
@@ -848,10 +906,10 @@ TYPED_TEST(CheckpointTest, CursorMovement) {
     /* Get items for DCP replication cursor */
     EXPECT_EQ(
             0,
-            this->manager->getNumItemsForCursor(CheckpointManager::pCursorName))
+            this->manager->getNumItemsForCursor(this->persistenceCursor()))
             << "Expected to have no normal (only meta) items";
     items.clear();
-    this->manager->getAllItemsForCursor(dcp_cursor.c_str(), items);
+    this->manager->getAllItemsForCursor(dcpCursor, items);
     /* Expecting only 1 op_ckpt_start item */
     EXPECT_EQ(1, items.size());
     EXPECT_EQ(queue_op::checkpoint_start, items.at(0)->getOperation());
@@ -887,11 +945,11 @@ TYPED_TEST(CheckpointTest, CursorMovementReplicaMerge) {
     // Register DCP replication cursor, which will be moved into the middle of
     // first checkpoint and then left there.
     std::string dcp_cursor{DCP_CURSOR_PREFIX + std::to_string(1)};
-    this->manager->registerCursorBySeqno(
-            dcp_cursor.c_str(), 0, MustSendCheckpointEnd::NO);
+    auto dcpCursor = this->manager->registerCursorBySeqno(
+            dcp_cursor.c_str(), 0, MustSendCheckpointEnd::NO).cursor;
 
     std::vector<queued_item> items;
-    this->manager->getAllItemsForCursor(dcp_cursor.c_str(), items);
+    this->manager->getAllItemsForCursor(dcpCursor, items);
     EXPECT_EQ((MIN_CHECKPOINT_ITEMS / 2) + 1, items.size());
 
     // Add more items so this checkpoint is now full.
@@ -908,7 +966,7 @@ TYPED_TEST(CheckpointTest, CursorMovementReplicaMerge) {
      * out of the initial checkpoint.
      */
     items.clear();
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
 
     /* We should have got (MIN_CHECKPOINT_ITEMS + op_ckpt_start) items. */
     EXPECT_EQ(MIN_CHECKPOINT_ITEMS + 1, items.size());
@@ -927,9 +985,9 @@ TYPED_TEST(CheckpointTest, CursorMovementReplicaMerge) {
     // Move the persistence cursor through these new items.
     EXPECT_EQ(MIN_CHECKPOINT_ITEMS,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
     items.clear();
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
     EXPECT_EQ(MIN_CHECKPOINT_ITEMS + 1, items.size());
 
     // Create a third checkpoint.
@@ -937,7 +995,7 @@ TYPED_TEST(CheckpointTest, CursorMovementReplicaMerge) {
 
     // Move persistence cursor into third checkpoint.
     items.clear();
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
     EXPECT_EQ(1, items.size())
         << "Expected to get a single meta item";
     EXPECT_EQ(queue_op::checkpoint_start, items.at(0)->getOperation());
@@ -950,12 +1008,12 @@ TYPED_TEST(CheckpointTest, CursorMovementReplicaMerge) {
 
     /* Get items for DCP cursor */
     EXPECT_EQ(MIN_CHECKPOINT_ITEMS / 2 + MIN_CHECKPOINT_ITEMS,
-              this->manager->getNumItemsForCursor(dcp_cursor))
+              this->manager->getNumItemsForCursor(dcpCursor))
             << "DCP cursor remaining items should have been recalculated after "
                "close of unref checkpoints.";
 
     items.clear();
-    auto range = this->manager->getAllItemsForCursor(dcp_cursor.c_str(), items);
+    auto range = this->manager->getAllItemsForCursor(dcpCursor, items);
     EXPECT_EQ(1001, range.start);
     EXPECT_EQ(1020, range.end);
 
@@ -998,8 +1056,9 @@ TYPED_TEST(CheckpointTest, MB25056_backfill_not_required) {
     // Request to register the cursor with a seqno that has been de-duped away
     CursorRegResult result = this->manager->registerCursorBySeqno(
             dcp_cursor.c_str(), 1005, MustSendCheckpointEnd::NO);
-    EXPECT_EQ(1011, result.first) << "Returned seqno is not expected value.";
-    EXPECT_FALSE(result.second) << "Backfill is unexpectedly required.";
+    EXPECT_EQ(1011, result.seqno) << "Returned seqno is not expected value.";
+    EXPECT_FALSE(result.startsAtFirstItem)
+            << "Backfill is unexpectedly required.";
 }
 
 //
@@ -1082,7 +1141,7 @@ TYPED_TEST(CheckpointTest, SeqnoAndHLCOrdering) {
     // Now a final check, iterate the checkpoint and also check for increasing
     // HLC.
     std::vector<queued_item> items;
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
 
     /* We should have got (n_threads*n_items + op_ckpt_start) items. */
     EXPECT_EQ(n_threads*n_items + 1, items.size());
@@ -1119,11 +1178,11 @@ TYPED_TEST(CheckpointTest, CursorUpdateForExistingItemWithMetaItemAtHead) {
 
     // Advance persistence cursor so all items have been consumed.
     std::vector<queued_item> items;
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
     ASSERT_EQ(3, items.size());
     ASSERT_EQ(0,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Queue an item with a duplicate key.
     this->queueNewItem("key");
@@ -1131,11 +1190,11 @@ TYPED_TEST(CheckpointTest, CursorUpdateForExistingItemWithMetaItemAtHead) {
     // Test: Should have one item for cursor (the one we just added).
     EXPECT_EQ(1,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Should have another item to read (new version of 'key')
     items.clear();
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
     EXPECT_EQ(1, items.size());
 }
 
@@ -1161,17 +1220,17 @@ TYPED_TEST(CheckpointTest, CursorUpdateForExistingItemWithNonMetaItemAtHead) {
 
     // Advance persistence cursor so all items have been consumed.
     std::vector<queued_item> items;
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
     ASSERT_EQ(2, items.size());
     ASSERT_EQ(0,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Queue a set (cursor will now be one behind).
     ASSERT_TRUE(this->queueNewItem("key"));
     ASSERT_EQ(1,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Test: queue an item with a duplicate key.
     this->queueNewItem("key");
@@ -1179,11 +1238,11 @@ TYPED_TEST(CheckpointTest, CursorUpdateForExistingItemWithNonMetaItemAtHead) {
     // Test: Should have one item for cursor (the one we just added).
     EXPECT_EQ(1,
               this->manager->getNumItemsForCursor(
-                      CheckpointManager::pCursorName));
+                      this->persistenceCursor()));
 
     // Should an item to read (new version of 'key')
     items.clear();
-    this->manager->getAllItemsForCursor(CheckpointManager::pCursorName, items);
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
     EXPECT_EQ(1, items.size());
     EXPECT_EQ(1002, items.at(0)->getBySeqno());
     EXPECT_EQ(makeStoredDocKey("key"), items.at(0)->getKey());
@@ -1206,3 +1265,147 @@ TYPED_TEST(CheckpointTest,
     // Test - second item (duplicate key) should return false.
     EXPECT_FALSE(this->queueNewItem("key"));
 }
+
+// Test that repeatedly de-duplicating the same keys (which tombstones their
+// previous items) compacts the checkpoint queue, and that the persistence
+// cursor keeps its logical position across the compaction.
+TYPED_TEST(CheckpointTest, DedupCompaction) {
+    const int numKeys = 10;
+    for (int i = 0; i < numKeys; i++) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(i)));
+    }
+
+    // Advance persistence cursor so all items have been consumed.
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
+    ASSERT_EQ(numKeys + 1, items.size());
+
+    // Some new keys the cursor hasn't read yet.
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(this->queueNewItem("new" + std::to_string(i)));
+    }
+
+    // Update every key many times - far more tombstones than a chunk.
+    const int rounds = CheckpointQueue::ChunkSize;
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < numKeys; i++) {
+            ASSERT_FALSE(this->queueNewItem("key" + std::to_string(i)));
+        }
+    }
+    EXPECT_EQ(numKeys + 5 + 1, this->manager->getNumOpenChkItems());
+    EXPECT_EQ(numKeys + 5,
+              this->manager->getNumItemsForCursor(
+                      this->persistenceCursor()));
+
+    // Cursor should read the new keys, then the latest version of each
+    // updated key, in seqno order.
+    items.clear();
+    this->manager->getAllItemsForCursor(this->persistenceCursor(), items);
+    ASSERT_EQ(numKeys + 5, items.size());
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(makeStoredDocKey("new" + std::to_string(i)),
+                  items.at(i)->getKey());
+    }
+    const int64_t lastSeqno = 1000 + numKeys + 5 + rounds * numKeys;
+    for (int i = 0; i < numKeys; i++) {
+        EXPECT_EQ(makeStoredDocKey("key" + std::to_string(i)),
+                  items.at(5 + i)->getKey());
+        EXPECT_EQ(lastSeqno - numKeys + 1 + i, items.at(5 + i)->getBySeqno());
+    }
+}
+
+// Test the open-addressing checkpoint key index, including removal of keys
+// in the middle of probe sequences.
+TEST(CheckpointIndexTest, InsertFindErase) {
+    CheckpointQueue queue;
+    CheckpointIndex index(queue);
+
+    const int numKeys = 1000;
+    for (int i = 0; i < numKeys; i++) {
+        queued_item qi{new Item(makeStoredDocKey("key" + std::to_string(i)),
+                                0,
+                                queue_op::mutation,
+                                /*revSeq*/ 0,
+                                /*bySeq*/ i)};
+        const size_t slot = queue.push_back(qi);
+        index.insert(qi->getKey(), {slot, i});
+    }
+    EXPECT_EQ(numKeys, index.size());
+
+    for (int i = 0; i < numKeys; i += 2) {
+        index.erase(makeStoredDocKey("key" + std::to_string(i)));
+    }
+    EXPECT_EQ(numKeys / 2, index.size());
+
+    for (int i = 0; i < numKeys; i++) {
+        auto* entry = index.find(makeStoredDocKey("key" + std::to_string(i)));
+        if (i % 2) {
+            ASSERT_NE(nullptr, entry) << "key" << i;
+            EXPECT_EQ(i, entry->mutation_id);
+            EXPECT_EQ(i, queue.at(entry->position)->getBySeqno());
+        } else {
+            EXPECT_EQ(nullptr, entry) << "key" << i;
+        }
+    }
+    EXPECT_EQ(nullptr, index.find(makeStoredDocKey("missing")));
+}
+
+// Test that cursor handles remain valid when a cursor is re-registered, and
+// are invalidated (without affecting other cursors) when it is removed.
+TYPED_TEST(CheckpointTest, CursorHandles) {
+    ASSERT_TRUE(this->queueNewItem("key"));
+
+    const std::string name(DCP_CURSOR_PREFIX);
+    auto result = this->manager->registerCursorBySeqno(
+            name, 0, MustSendCheckpointEnd::NO);
+    ASSERT_TRUE(result.cursor.valid());
+    EXPECT_EQ(result.cursor, this->manager->getCursorHandle(name));
+    EXPECT_NE(result.cursor, this->persistenceCursor());
+    EXPECT_EQ(1, this->manager->getNumItemsForCursor(result.cursor));
+
+    // Re-registering the same name keeps the handle.
+    auto again = this->manager->registerCursorBySeqno(
+            name, 0, MustSendCheckpointEnd::NO);
+    EXPECT_EQ(result.cursor, again.cursor);
+
+    // Once removed, the handle no longer refers to a cursor.
+    EXPECT_TRUE(this->manager->removeCursor(result.cursor));
+    EXPECT_FALSE(this->manager->removeCursor(result.cursor));
+    EXPECT_FALSE(this->manager->getCursorHandle(name).valid());
+    EXPECT_EQ(0, this->manager->getNumItemsForCursor(result.cursor));
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForCursor(result.cursor, items);
+    EXPECT_TRUE(items.empty());
+
+    // A new cursor may reuse the slot, but not the old handle.
+    auto other = this->manager->registerCursorBySeqno(
+            name, 0, MustSendCheckpointEnd::NO);
+    EXPECT_NE(result.cursor, other.cursor);
+    EXPECT_EQ(0, this->manager->getNumItemsForCursor(result.cursor));
+    EXPECT_EQ(1, this->manager->getNumItemsForCursor(other.cursor));
+
+    // The persistence cursor is unaffected.
+    EXPECT_EQ(1,
+              this->manager->getNumItemsForCursor(this->persistenceCursor()));
+}
+
+// Memory allocated for an item after it was queued (a compressed copy of its
+// value made for DCP) is charged to the checkpoint holding it.
+TYPED_TEST(CheckpointTest, ChargeItemMemory) {
+    ASSERT_TRUE(this->queueNewItem("key1"));
+    const int64_t seqno = this->manager->getHighSeqno();
+    this->manager->createNewCheckpoint();
+    ASSERT_TRUE(this->queueNewItem("key2"));
+    ASSERT_EQ(2, this->manager->getNumCheckpoints());
+    const size_t memUsage = this->manager->getMemoryUsage();
+
+    this->manager->chargeItemMemory(seqno, 100);
+    EXPECT_EQ(memUsage + 100, this->manager->getMemoryUsage());
+    this->manager->chargeItemMemory(this->manager->getHighSeqno(), 100);
+    EXPECT_EQ(memUsage + 200, this->manager->getMemoryUsage());
+
+    // Nothing is charged for seqnos no checkpoint holds.
+    this->manager->chargeItemMemory(seqno - 1, 100);
+    this->manager->chargeItemMemory(this->manager->getHighSeqno() + 1, 100);
+    EXPECT_EQ(memUsage + 200, this->manager->getMemoryUsage());
+}
@@ -196,6 +196,7 @@ public:
      */
     static ENGINE_ERROR_CODE sendSystemEvent(gsl::not_null<const void*> cookie,
                                              uint32_t opaque,
+                                             item* itm,
                                              uint16_t vbucket,
                                              mcbp::systemevent::id event,
                                              uint64_t bySeqno,
@@ -203,6 +204,16 @@ public:
                                              cb::const_byte_buffer eventData) {
         (void)cookie;
         (void)vbucket; // ignored as we are connecting VBn to VBn+1
+        // The key refers to the item, which we now own (so the core can send
+        // it without copying)
+        std::unique_ptr<Item> item(reinterpret_cast<Item*>(itm));
+        EXPECT_NE(nullptr, item.get());
+        if (item) {
+            const auto* data =
+                    reinterpret_cast<const uint8_t*>(item->getData());
+            EXPECT_GE(key.data(), data);
+            EXPECT_LE(key.data() + key.size(), data + item->getNBytes());
+        }
         dcp_last_op = PROTOCOL_BINARY_CMD_DCP_SYSTEM_EVENT;
         dcp_last_key.assign(reinterpret_cast<const char*>(key.data()),
                             key.size());
@@ -386,7 +386,7 @@ public:
                                         std::vector<queued_item>& events) {
         std::vector<queued_item> items;
         vb.checkpointManager->getAllItemsForCursor(
-                CheckpointManager::pCursorName, items);
+                vb.checkpointManager->getPersistenceCursor(), items);
         for (const auto& qi : items) {
             if (qi->getOperation() == queue_op::system_event) {
                 events.push_back(qi);
@@ -45,6 +45,8 @@
 #include <platform/compress.h>
 #include <xattr/utils.h>
 
+#include <thread>
+
 class DCPTest : public EventuallyPersistentEngineTest {
 protected:
     void SetUp() override {
@@ -649,6 +651,58 @@ TEST_P(StreamTest, test_verifyProducerStats) {
     destroy_dcp_stream();
 }
 
+/*
+ * Test that with dcp_producer_batch_bytes set the producer hands several
+ * messages to the core in one step, and that running out of space in the
+ * core's write buffer part way through ends the batch (rather than failing
+ * the step) with the rejected message sent by the next step.
+ */
+TEST_P(StreamTest, test_producerBatchesMessages) {
+    engine->getConfiguration().setDcpProducerBatchBytes(1024 * 1024);
+    VBucketPtr vb = engine->getKVBucket()->getVBucket(vbid);
+    setup_dcp_stream(0, IncludeValue::No, IncludeXattrs::No);
+    store_item(vbid, "key1", "value1");
+    store_item(vbid, "key2", "value2");
+    store_item(vbid, "key3", "value3");
+    auto producers = get_dcp_producers(reinterpret_cast<ENGINE_HANDLE*>(engine),
+                                       reinterpret_cast<ENGINE_HANDLE_V1*>(engine));
+    uint64_t rollbackSeqno;
+    auto err = producer->streamRequest(/*flags*/ 0,
+                                       /*opaque*/ 0,
+                                       /*vbucket*/ 0,
+                                       /*start_seqno*/ 0,
+                                       /*end_seqno*/ ~0,
+                                       /*vb_uuid*/ 0,
+                                       /*snap_start*/ 0,
+                                       /*snap_end*/ ~0,
+                                       &rollbackSeqno,
+                                       DCPTest::fakeDcpAddFailoverLog);
+
+    EXPECT_EQ(ENGINE_SUCCESS, err);
+    producer->notifySeqnoAvailable(vbid, vb->getHighSeqno());
+    EXPECT_EQ(ENGINE_SUCCESS, producer->step(producers.get()));
+    producer->getCheckpointSnapshotTask().run();
+
+    /* The core's buffer fills up after the snapshot marker */
+    auto mutation_callback = producers->mutation;
+    producers->mutation = mock_mutation_return_engine_e2big;
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(0, producer->getItemsSent());
+    const auto markerBytes = producer->getTotalBytesSent();
+    EXPECT_GT(markerBytes, 0);
+
+    /* All three mutations then go in one step */
+    producers->mutation = mutation_callback;
+    EXPECT_EQ(ENGINE_WANT_MORE, producer->step(producers.get()));
+    EXPECT_EQ(3, producer->getItemsSent());
+    EXPECT_GT(producer->getTotalBytesSent(), markerBytes);
+
+    EXPECT_EQ(ENGINE_SUCCESS, producer->step(producers.get()));
+    EXPECT_EQ(3, producer->getItemsSent());
+
+    destroy_dcp_stream();
+}
+
 /*
  * Test that when have a producer with IncludeValue set to Yes and IncludeXattrs
  * set to No an active stream created via a streamRequest returns false for
@@ -2418,6 +2472,132 @@ TEST_F(NotifyTest, test_mb19503_connmap_notify_paused) {
     EXPECT_EQ(1, notifyTest.getCallbacks());
 }
 
+/*
+ * Tests of dcp_batch_seqno_notifications, where seqno notifications are
+ * only recorded by DcpConnMap::notifyVBConnections() and fanned out to the
+ * producers by processPendingNotifications() (called directly here, as the
+ * connection notifier task doesn't run).
+ */
+class BatchedSeqnoNotifyTest : public DCPTest {
+protected:
+    void SetUp() override {
+        DCPTest::SetUp();
+        engine->getConfiguration().setDcpBatchSeqnoNotifications(true);
+        ASSERT_TRUE(engine->getDcpConnMap().isBatchSeqnoNotifications());
+
+        producer = std::make_shared<MockDcpProducer>(
+                *engine,
+                cookie,
+                "test_producer",
+                /*flags*/ 0,
+                cb::const_byte_buffer() /*no json*/);
+        uint64_t rollbackSeqno;
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  producer->streamRequest(/*flags*/ 0,
+                                          /*opaque*/ 0,
+                                          vbid,
+                                          /*start_seqno*/ 0,
+                                          /*end_seqno*/ ~0,
+                                          /*vb_uuid*/ 0,
+                                          /*snap_start*/ 0,
+                                          /*snap_end*/ 0,
+                                          &rollbackSeqno,
+                                          fakeDcpAddFailoverLog));
+
+        // Let the stream send what it has (nothing) so it is idle
+        producer->drainReadyQueue();
+        ASSERT_EQ(0, producer->getReadyQueueSize());
+    }
+
+    void TearDown() override {
+        engine->getDcpConnMap().removeVBConnections(*producer);
+        producer->closeAllStreams();
+        producer->clearCheckpointProcessorTaskQueues();
+        producer.reset();
+        DCPTest::TearDown();
+    }
+
+    uint64_t getNotifiedSeqno() {
+        auto stream = producer->findStream(vbid);
+        return static_cast<ActiveStream*>(stream.get())->getNotifiedSeqno();
+    }
+
+    std::shared_ptr<MockDcpProducer> producer;
+};
+
+TEST_F(BatchedSeqnoNotifyTest, NotificationsCoalesce) {
+    auto& connMap = engine->getDcpConnMap();
+    for (uint64_t seqno = 1; seqno <= 10; ++seqno) {
+        connMap.notifyVBConnections(vbid, seqno);
+    }
+
+    // Nothing reaches the stream until the notifications are processed
+    EXPECT_EQ(0, producer->getReadyQueueSize());
+    EXPECT_EQ(0, getNotifiedSeqno());
+
+    // ... which wakes the stream once, with the latest seqno
+    connMap.processPendingNotifications();
+    EXPECT_EQ(1, producer->getReadyQueueSize());
+    EXPECT_EQ(10, getNotifiedSeqno());
+
+    // The vbucket was only queued once, so there is nothing left to do
+    producer->drainReadyQueue();
+    connMap.processPendingNotifications();
+    EXPECT_EQ(0, producer->getReadyQueueSize());
+    EXPECT_EQ(10, getNotifiedSeqno());
+}
+
+TEST_F(BatchedSeqnoNotifyTest, NotificationAfterFlushIsNotLost) {
+    auto& connMap = engine->getDcpConnMap();
+    connMap.notifyVBConnections(vbid, 1);
+    connMap.processPendingNotifications();
+    EXPECT_EQ(1, getNotifiedSeqno());
+    EXPECT_EQ(1, producer->getReadyQueueSize());
+
+    // A notification arriving after the batch was processed queues the
+    // vbucket again
+    connMap.notifyVBConnections(vbid, 2);
+    EXPECT_EQ(1, getNotifiedSeqno());
+    connMap.processPendingNotifications();
+    EXPECT_EQ(2, getNotifiedSeqno());
+
+    // The producer hasn't stepped the stream since it was woken, so it isn't
+    // woken again, but the seqno is recorded
+    EXPECT_EQ(1, producer->getReadyQueueSize());
+
+    // Once the producer has caught up the next notification wakes it again
+    producer->drainReadyQueue();
+    EXPECT_EQ(0, producer->getReadyQueueSize());
+    connMap.notifyVBConnections(vbid, 3);
+    connMap.processPendingNotifications();
+    EXPECT_EQ(1, producer->getReadyQueueSize());
+    EXPECT_EQ(3, getNotifiedSeqno());
+}
+
+TEST_F(BatchedSeqnoNotifyTest, ConcurrentNotificationsAreNotLost) {
+    auto& connMap = engine->getDcpConnMap();
+    const uint64_t lastSeqno = 100000;
+    std::atomic<bool> done{false};
+
+    // A front-end thread notifies while the notifier repeatedly processes
+    // (and the producer drains) whatever is pending
+    std::thread frontEnd([&connMap, &done, lastSeqno, this]() {
+        for (uint64_t seqno = 1; seqno <= lastSeqno; ++seqno) {
+            connMap.notifyVBConnections(vbid, seqno);
+        }
+        done = true;
+    });
+    while (!done) {
+        connMap.processPendingNotifications();
+        producer->drainReadyQueue();
+    }
+    frontEnd.join();
+
+    // The last notification is delivered by the next batch at the latest
+    connMap.processPendingNotifications();
+    EXPECT_EQ(lastSeqno, getNotifiedSeqno());
+}
+
 // Tests that the MutationResponse created for the deletion response is of the
 // correct size.
 TEST_P(ConnectionTest, test_mb24424_deleteResponse) {
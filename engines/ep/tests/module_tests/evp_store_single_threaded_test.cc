@@ -23,10 +23,13 @@
 #include "../mock/mock_stream.h"
 #include "bgfetcher.h"
 #include "checkpoint.h"
+#include "couch-kvstore/couch-kvstore.h"
 #include "dcp/dcpconnmap.h"
 #include "ep_time.h"
 #include "evp_store_test.h"
 #include "fakes/fake_executorpool.h"
+#include "kvshard.h"
+#include "kvstore_config.h"
 #include "programs/engine_testapp/mock_server.h"
 #include "taskqueue.h"
 #include "tests/module_tests/test_helpers.h"
@@ -37,6 +40,8 @@
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
+#include <functional>
+#include <map>
 #include <thread>
 
 ProcessClock::time_point SingleThreadedKVBucketTest::runNextTask(
@@ -801,6 +806,97 @@ TEST_F(SingleThreadedEPBucketTest, test_mb22451) {
     producer->closeAllStreams();
 }
 
+/*
+ * With dcp_backfill_shared_scan enabled, a second stream backfilling the
+ * same vBucket joins the first stream's disk scan rather than starting its
+ * own, and both streams are sent every item.
+ */
+TEST_F(SingleThreadedEPBucketTest, SharedDiskBackfillScan) {
+    engine->getConfiguration().setDcpBackfillSharedScan(true);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+
+    // Persist three items and remove them from the checkpoints, so
+    // streaming them needs a backfill.
+    for (int ii = 0; ii < 3; ii++) {
+        store_item(vbid,
+                   makeStoredDocKey("key" + std::to_string(ii)),
+                   "value");
+    }
+    auto vb = store->getVBuckets().getBucket(vbid);
+    auto& ckpt_mgr = *vb->checkpointManager;
+    ckpt_mgr.createNewCheckpoint();
+    EXPECT_EQ(3, getEPBucket().flushVBucket(vbid));
+    bool new_ckpt_created;
+    EXPECT_EQ(1, ckpt_mgr.removeClosedUnrefCheckpoints(*vb, new_ckpt_created));
+
+    auto cookie2 = create_mock_cookie();
+    std::vector<std::shared_ptr<MockDcpProducer>> producers;
+    std::vector<std::shared_ptr<MockActiveStream>> streams;
+    for (auto* c : {cookie, cookie2}) {
+        producers.push_back(std::make_shared<MockDcpProducer>(
+                *engine,
+                c,
+                "test_producer" + std::to_string(producers.size()),
+                /*flags*/ 0,
+                cb::const_byte_buffer() /*no json*/));
+        streams.push_back(std::make_shared<MockActiveStream>(
+                static_cast<EventuallyPersistentEngine*>(engine.get()),
+                producers.back(),
+                /*flags*/ 0,
+                /*opaque*/ 0,
+                *vb,
+                /*st_seqno*/ 0,
+                /*en_seqno*/ ~0,
+                /*vb_uuid*/ 0xabcd,
+                /*snap_start_seqno*/ 0,
+                /*snap_end_seqno*/ ~0));
+    }
+
+    auto& stats = engine->getEpStats();
+
+    // The first backfill's create() starts the scan...
+    streams[0]->transitionStateToBackfilling();
+    auto& leader = producers[0]->getBFM();
+    leader.backfill();
+    EXPECT_EQ(1, stats.dcpBackfillScans);
+
+    // ... which the second joins, as it has yet to read anything.
+    streams[1]->transitionStateToBackfilling();
+    auto& follower = producers[1]->getBFM();
+    follower.backfill();
+    EXPECT_EQ(1, stats.dcpBackfillScans);
+    EXPECT_EQ(1, stats.dcpBackfillScansAvoided);
+
+    // scan() reads each item once, sending it to both streams
+    leader.backfill();
+    EXPECT_EQ(3, stats.dcpBackfillItemsRead);
+    // complete()
+    leader.backfill();
+
+    // The follower sees the scan has finished and completes too.
+    follower.backfill();
+    follower.backfill();
+    EXPECT_EQ(1, stats.dcpBackfillScans);
+
+    for (auto& stream : streams) {
+        auto resp = stream->public_nextQueuedItem();
+        ASSERT_TRUE(resp);
+        EXPECT_EQ(DcpResponse::Event::SnapshotMarker, resp->getEvent());
+        for (int ii = 0; ii < 3; ii++) {
+            resp = stream->public_nextQueuedItem();
+            ASSERT_TRUE(resp);
+            EXPECT_EQ(DcpResponse::Event::Mutation, resp->getEvent());
+            EXPECT_EQ(uint64_t(ii + 1), *resp->getBySeqno());
+        }
+        EXPECT_FALSE(stream->public_nextQueuedItem());
+    }
+
+    for (auto& producer : producers) {
+        producer->closeAllStreams();
+    }
+    destroy_mock_cookie(cookie2);
+}
+
 /* Regression / reproducer test for MB-19815 - an exception is thrown
  * (and connection disconnected) if a couchstore file hasn't been re-created
  * yet when doDcpVbTakeoverStats() is called.
@@ -1782,3 +1878,305 @@ TEST_F(SingleThreadedEPBucketTest, mb25273) {
     EXPECT_EQ(3, gv.item->getCas());
     EXPECT_EQ(value.size(), gv.item->getValue()->valueSize());
 }
+
+/**
+ * FileOps which (once armed) fail every sync() of the files of one vBucket,
+ * so that vBucket's couchstore commits fail. Everything else is passed to
+ * couchstore's default FileOps.
+ */
+class FailVBucketSyncOps : public FileOpsInterface {
+public:
+    /// Fail the syncs of vbid's files from now on.
+    void arm(uint16_t vbid) {
+        failPrefix = "/" + std::to_string(vbid) + ".couch.";
+        armed = true;
+    }
+
+    void disarm() {
+        armed = false;
+    }
+
+    /// Called with the file's path before each sync().
+    std::function<void(const std::string&)> syncHook;
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override {
+        return ops.constructor(errinfo);
+    }
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override {
+        paths[*handle] = path;
+        return ops.open(errinfo, handle, path, oflag);
+    }
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override {
+        return ops.close(errinfo, handle);
+    }
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override {
+        return ops.set_periodic_sync(handle, period_bytes);
+    }
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override {
+        return ops.pread(errinfo, handle, buf, nbytes, offset);
+    }
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override {
+        return ops.pwrite(errinfo, handle, buf, nbytes, offset);
+    }
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override {
+        return ops.goto_eof(errinfo, handle);
+    }
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override {
+        if (syncHook) {
+            syncHook(paths[handle]);
+        }
+        if (armed &&
+            paths[handle].find(failPrefix) != std::string::npos) {
+            return COUCHSTORE_ERROR_WRITE;
+        }
+        return ops.sync(errinfo, handle);
+    }
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override {
+        return ops.advise(errinfo, handle, offset, len, advice);
+    }
+    FHStats* get_stats(couch_file_handle handle) override {
+        return ops.get_stats(handle);
+    }
+    void destructor(couch_file_handle handle) override {
+        paths.erase(handle);
+        ops.destructor(handle);
+    }
+
+private:
+    FileOpsInterface& ops = *couchstore_get_default_file_ops();
+    std::map<couch_file_handle, std::string> paths;
+    std::string failPrefix;
+    bool armed = false;
+};
+
+/**
+ * Test fixture for flushing vBuckets as a group commit. Uses a single shard
+ * so any vBuckets can be flushed together, with the shard's KVStore using
+ * FailVBucketSyncOps.
+ */
+class GroupCommitTest : public SingleThreadedEPBucketTest {
+protected:
+    void SetUp() override {
+        config_string += "max_num_shards=1;flusher_group_commit_vbuckets=4";
+        SingleThreadedEPBucketTest::SetUp();
+
+        kvConfig = std::make_unique<KVStoreConfig>(engine->getConfiguration(),
+                                                   /*shardId*/ 0);
+        store->getVBuckets().getShard(0)->setRWUnderlying(
+                std::make_unique<CouchKVStore>(*kvConfig, ops));
+
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            setVBucketStateAndRunPersistTask(vb, vbucket_state_active);
+        }
+    }
+
+    /**
+     * Store the same mutations in the given vBucket as any other: some
+     * sets, a key set twice (de-duplicated by the flusher) and a deletion
+     * of a key which has already been persisted.
+     */
+    void storeMutations(uint16_t vb) {
+        store_item(vb, makeStoredDocKey("deleted"), "value");
+        flush_vbucket_to_disk(vb);
+        for (int ii = 0; ii < 5; ++ii) {
+            store_item(vb,
+                       makeStoredDocKey("key" + std::to_string(ii)),
+                       "value" + std::to_string(ii));
+        }
+        store_item(vb, makeStoredDocKey("key0"), "updated");
+        delete_item(vb, makeStoredDocKey("deleted"));
+    }
+
+    /// @return true if none of the vBucket's items await persistence.
+    bool allClean(uint16_t vb) {
+        auto vbucket = store->getVBucket(vb);
+        for (int ii = 0; ii < 5; ++ii) {
+            auto* v = vbucket->ht.find(
+                    makeStoredDocKey("key" + std::to_string(ii)),
+                    TrackReference::No,
+                    WantsDeleted::Yes);
+            if (v == nullptr || v->isDirty()) {
+                return false;
+            }
+        }
+        return vbucket->rejectQueue.empty();
+    }
+
+    /// Expect everything persisted for vbA to match that for vbB.
+    void expectSamePersistedState(uint16_t vbA, uint16_t vbB) {
+        auto a = store->getVBucket(vbA);
+        auto b = store->getVBucket(vbB);
+        EXPECT_EQ(a->getHighSeqno(), b->getHighSeqno());
+        EXPECT_EQ(a->getHighSeqno(), int64_t(a->getPersistenceSeqno()));
+        EXPECT_EQ(a->getPersistenceSeqno(), b->getPersistenceSeqno());
+        EXPECT_EQ(a->getPersistenceCheckpointId(),
+                  b->getPersistenceCheckpointId());
+        EXPECT_EQ(a->getNumItems(), b->getNumItems());
+
+        auto* kvstore = store->getRWUnderlying(vbA);
+        EXPECT_EQ(kvstore->getLastPersistedSeqno(vbA),
+                  kvstore->getLastPersistedSeqno(vbB));
+        const auto* stateA = kvstore->getVBucketState(vbA);
+        const auto* stateB = kvstore->getVBucketState(vbB);
+        ASSERT_NE(nullptr, stateA);
+        ASSERT_NE(nullptr, stateB);
+        EXPECT_EQ(a->getHighSeqno(), stateA->highSeqno);
+        EXPECT_EQ(stateA->highSeqno, stateB->highSeqno);
+        EXPECT_EQ(stateA->lastSnapStart, stateB->lastSnapStart);
+        EXPECT_EQ(stateA->lastSnapEnd, stateB->lastSnapEnd);
+        EXPECT_EQ(kvstore->getItemCount(vbA), kvstore->getItemCount(vbB));
+
+        EXPECT_TRUE(allClean(vbA));
+        EXPECT_TRUE(allClean(vbB));
+    }
+
+    /// vBuckets 0..3 are flushed as a group, 4..7 individually.
+    static const uint16_t numVBuckets = 8;
+    static const uint16_t groupSize = 4;
+
+    FailVBucketSyncOps ops;
+    std::unique_ptr<KVStoreConfig> kvConfig;
+};
+
+const uint16_t GroupCommitTest::numVBuckets;
+const uint16_t GroupCommitTest::groupSize;
+
+// Flushing vBuckets as a group should leave each vBucket (its persisted
+// seqno, persistence callbacks and persisted state) exactly as flushing it
+// on its own does.
+TEST_F(GroupCommitTest, MatchesUngroupedFlush) {
+    for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+        storeMutations(vb);
+    }
+    auto& stats = engine->getEpStats();
+    const size_t persistedBefore = stats.totalPersisted;
+
+    // Key0 twice only counts once; the deletion counts.
+    const int itemsPerVBucket = 6;
+    for (uint16_t vb = groupSize; vb < numVBuckets; ++vb) {
+        EXPECT_EQ(itemsPerVBucket, getEPBucket().flushVBucket(vb));
+    }
+    const size_t persistedUngrouped = stats.totalPersisted - persistedBefore;
+
+    std::vector<uint16_t> vbids;
+    for (uint16_t vb = 0; vb < groupSize; ++vb) {
+        vbids.push_back(vb);
+    }
+    EXPECT_EQ(itemsPerVBucket * groupSize,
+              getEPBucket().flushVBuckets(vbids, std::chrono::hours(1)));
+    EXPECT_TRUE(vbids.empty());
+
+    // Every persistence callback of the group ran, as for the individual
+    // flushes.
+    EXPECT_EQ(persistedUngrouped,
+              stats.totalPersisted - persistedBefore - persistedUngrouped);
+    EXPECT_EQ(0u, stats.diskQueueSize.load());
+
+    for (uint16_t vb = 0; vb < groupSize; ++vb) {
+        SCOPED_TRACE("vb:" + std::to_string(vb));
+        expectSamePersistedState(vb, vb + groupSize);
+    }
+}
+
+// While the group's commits are made durable the vBuckets of the group are
+// unlocked (but marked as awaiting the sync); once their data is synced only
+// their headers are synced, with a single sync for each file.
+TEST_F(GroupCommitTest, VBucketsUnlockedDuringSync) {
+    for (uint16_t vb = 0; vb < groupSize; ++vb) {
+        storeMutations(vb);
+    }
+
+    std::map<std::string, int> syncs;
+    int unlockedSyncs = 0;
+    ops.syncHook = [this, &syncs, &unlockedSyncs](const std::string& path) {
+        ++syncs[path];
+        auto vb = store->getLockedVBucket(0, std::try_to_lock);
+        if (vb.owns_lock()) {
+            EXPECT_TRUE(vb->isGroupSyncPending());
+            ++unlockedSyncs;
+        }
+    };
+
+    std::vector<uint16_t> vbids;
+    for (uint16_t vb = 0; vb < groupSize; ++vb) {
+        vbids.push_back(vb);
+    }
+    getEPBucket().flushVBuckets(vbids, std::chrono::hours(1));
+    ops.syncHook = nullptr;
+    EXPECT_TRUE(vbids.empty());
+
+    // Each file was synced twice (data, then header); the headers were
+    // synced with the vBuckets unlocked.
+    EXPECT_EQ(size_t(groupSize), syncs.size());
+    for (const auto& file : syncs) {
+        EXPECT_EQ(2, file.second) << file.first;
+    }
+    EXPECT_EQ(groupSize, unlockedSyncs);
+    EXPECT_FALSE(store->getVBucket(0)->isGroupSyncPending());
+}
+
+// A failed commit of one vBucket in a group should re-queue only that
+// vBucket's items (and leave its persisted seqno where it was); the other
+// vBuckets of the group are persisted as normal.
+TEST_F(GroupCommitTest, FailedCommitRequeuesOnlyThatVBucket) {
+    for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+        storeMutations(vb);
+    }
+    for (uint16_t vb = groupSize; vb < numVBuckets; ++vb) {
+        getEPBucket().flushVBucket(vb);
+    }
+
+    const uint16_t failVB = 2;
+    const auto persistenceSeqno =
+            store->getVBucket(failVB)->getPersistenceSeqno();
+    const auto persistedSeqno =
+            store->getRWUnderlying(failVB)->getLastPersistedSeqno(failVB);
+    ops.arm(failVB);
+
+    std::vector<uint16_t> vbids;
+    for (uint16_t vb = 0; vb < groupSize; ++vb) {
+        vbids.push_back(vb);
+    }
+    getEPBucket().flushVBuckets(vbids, std::chrono::hours(1));
+    EXPECT_EQ(std::vector<uint16_t>{failVB}, vbids);
+
+    for (uint16_t vb = 0; vb < groupSize; ++vb) {
+        if (vb != failVB) {
+            SCOPED_TRACE("vb:" + std::to_string(vb));
+            expectSamePersistedState(vb, vb + groupSize);
+        }
+    }
+    auto failed = store->getVBucket(failVB);
+    EXPECT_EQ(6u, failed->rejectQueue.size());
+    EXPECT_FALSE(allClean(failVB));
+    EXPECT_EQ(persistenceSeqno, failed->getPersistenceSeqno());
+    EXPECT_EQ(persistedSeqno,
+              store->getRWUnderlying(failVB)->getLastPersistedSeqno(failVB));
+    EXPECT_EQ(6u, engine->getEpStats().diskQueueSize.load());
+
+    // Once commits succeed again the re-queued items are persisted.
+    ops.disarm();
+    EXPECT_EQ(6, getEPBucket().flushVBuckets(vbids, std::chrono::hours(1)));
+    EXPECT_TRUE(vbids.empty());
+    expectSamePersistedState(failVB, failVB + groupSize);
+    EXPECT_EQ(0u, engine->getEpStats().diskQueueSize.load());
+}
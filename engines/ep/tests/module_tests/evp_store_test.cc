@@ -364,6 +364,43 @@ TEST_P(EPStoreEvictionTest, DeletedValue) {
     EXPECT_EQ("deleted value", result.item->getValue()->to_s());
 }
 
+// BG fetches for several vBuckets of the same shard are all completed by a
+// single run of the BgFetcher (even without its pipeline helper tasks), with
+// each vBucket's batch recorded in the pipeline histograms.
+TEST_P(EPStoreEvictionTest, BgFetchMultipleVBuckets) {
+    // Another vBucket in the same shard as vbid.
+    const uint16_t vbid2 = vbid + store->getVBuckets().getNumShards();
+    store->setVBucketState(vbid2, vbucket_state_active, false);
+
+    auto key = makeStoredDocKey("key");
+    for (auto vb : {vbid, vbid2}) {
+        auto item = make_item(vb, key, "value");
+        ASSERT_EQ(ENGINE_SUCCESS, store->set(item, cookie));
+        flush_vbucket_to_disk(vb);
+        evict_key(vb, key);
+    }
+
+    auto options = get_options_t(QUEUE_BG_FETCH | HONOR_STATES);
+    for (auto vb : {vbid, vbid2}) {
+        EXPECT_EQ(ENGINE_EWOULDBLOCK,
+                  store->get(key, vb, cookie, options).getStatus());
+    }
+
+    auto& stats = engine->getEpStats();
+    ASSERT_EQ(0, stats.bgFetchDiskHisto.total());
+    MockGlobalTask mockTask(engine->getTaskable(), TaskId::MultiBGFetcherTask);
+    store->getVBucket(vbid)->getShard()->getBgFetcher()->run(&mockTask);
+
+    EXPECT_EQ(2, stats.bgFetchPipelineWaitHisto.total());
+    EXPECT_EQ(2, stats.bgFetchDiskHisto.total());
+    EXPECT_EQ(2, stats.bgFetchCompleteHisto.total());
+    for (auto vb : {vbid, vbid2}) {
+        auto gv = store->get(key, vb, cookie, options);
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        EXPECT_EQ("value", gv.item->getValue()->to_s());
+    }
+}
+
 // Test to ensure all pendingBGfetches are deleted when the
 // VBucketMemoryDeletionTask is run
 TEST_P(EPStoreEvictionTest, MB_21976) {
@@ -265,4 +265,108 @@ TEST_F(SingleThreadedExecutorPoolTest, ignore_duplicate_schedule) {
             << "Task should only appear once in the taskQueue";
 
     pool->cancel(taskId, true);
-}
\ No newline at end of file
+}
+
+/// A task which works until its runtime budget is used up, twice.
+class YieldingTask : public GlobalTask {
+public:
+    YieldingTask(Taskable& t) : GlobalTask(t, TaskId::ItemPager, 0, true) {
+    }
+
+    bool run() override {
+        while (!shouldYield()) {
+            ++iterations;
+        }
+        return ++runs < 2;
+    }
+
+    cb::const_char_buffer getDescription() override {
+        return "Yielding Task";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() override {
+        return std::chrono::milliseconds(1);
+    }
+
+    size_t runs = 0;
+    size_t iterations = 0;
+};
+
+/* A task asked to yield when its budget is used up, which returns true, is
+ * rescheduled and run again, and its yield is counted.
+ */
+TEST_F(ExecutorPoolDynamicWorkerTest, task_yields_after_budget) {
+    auto task = std::make_shared<YieldingTask>(taskable);
+
+    const auto start = ProcessClock::now();
+    pool->schedule(task);
+    pool->waitForEmptyTaskLocator();
+
+    EXPECT_EQ(2, task->runs);
+    EXPECT_EQ(1, task->getNumYields());
+    EXPECT_GT(task->iterations, 0);
+    EXPECT_GE(ProcessClock::now() - start, std::chrono::milliseconds(2));
+}
+
+/* In work-stealing mode every scheduled task must still be run exactly once,
+ * however the tasks end up distributed between the threads' local queues.
+ */
+TEST_F(ExecutorPoolWorkStealingTest, runs_all_tasks) {
+    const size_t numTasks = 200;
+    std::atomic<size_t> runCount{0};
+
+    for (size_t i = 0; i < numTasks; ++i) {
+        pool->schedule(std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, 0, true, [&] {
+                    ++runCount;
+                    return false;
+                }));
+    }
+    pool->waitForEmptyTaskLocator();
+
+    EXPECT_EQ(numTasks, runCount);
+}
+
+/// A LambdaTask which is expected to be quick, so may be borrowed.
+class ShortLambdaTask : public LambdaTask {
+public:
+    using LambdaTask::LambdaTask;
+
+    std::chrono::microseconds maxExpectedDuration() override {
+        return std::chrono::milliseconds(1);
+    }
+};
+
+/* With every NonIO thread blocked, a short NonIO task should be borrowed and
+ * run by an idle thread of another type.
+ */
+TEST_F(ExecutorPoolWorkStealingTest, borrows_short_task) {
+    ThreadGate started(3); // both blocking tasks + the test
+    ThreadGate release(3);
+    ThreadGate done(1);
+
+    for (int i = 0; i < 2; ++i) {
+        pool->schedule(std::make_shared<LambdaTask>(
+                taskable, TaskId::ItemPager, 0, true, [&] {
+                    started.threadUp();
+                    release.threadUp();
+                    return false;
+                }));
+    }
+    started.threadUp();
+
+    pool->schedule(std::make_shared<ShortLambdaTask>(
+            taskable, TaskId::ExpiredItemPager, 0, true, [&] {
+                done.threadUp();
+                return false;
+            }));
+    done.waitFor(std::chrono::seconds(10));
+    const bool borrowed = done.isComplete();
+
+    release.threadUp();
+    pool->waitForEmptyTaskLocator();
+
+    EXPECT_TRUE(borrowed) << "short task did not run while NonIO threads "
+                             "were blocked";
+    EXPECT_EQ(1, pool->getNumBorrowedTasks());
+}
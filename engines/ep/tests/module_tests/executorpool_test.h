@@ -59,13 +59,15 @@ public:
                      size_t maxReaders,
                      size_t maxWriters,
                      size_t maxAuxIO,
-                     size_t maxNonIO)
+                     size_t maxNonIO,
+                     bool workStealing = false)
         : ExecutorPool(maxThreads,
                        nTaskSets,
                        maxReaders,
                        maxWriters,
                        maxAuxIO,
-                       maxNonIO) {
+                       maxNonIO,
+                       workStealing) {
     }
 
     size_t getNumBuckets() {
@@ -99,6 +101,10 @@ public:
         tMutex.wait(lh, [this] { return taskLocator.empty(); });
     }
 
+    uint64_t getNumBorrowedTasks() {
+        return numBorrowedTasks;
+    }
+
     ~TestExecutorPool() = default;
 };
 
@@ -154,6 +160,32 @@ protected:
     MockTaskable taskable;
 };
 
+class ExecutorPoolWorkStealingTest : public ExecutorPoolTest {
+protected:
+    void SetUp() override {
+        ExecutorPoolTest::SetUp();
+        pool = std::unique_ptr<TestExecutorPool>(new TestExecutorPool(
+                10, // MaxThreads
+                NUM_TASK_GROUPS,
+                2, // MaxNumReaders
+                2, // MaxNumWriters
+                2, // MaxNumAuxio
+                2, // MaxNumNonio
+                true // workStealing
+                ));
+        pool->registerTaskable(taskable);
+    }
+
+    void TearDown() override {
+        pool->unregisterTaskable(taskable, false);
+        pool->shutdown();
+        ExecutorPoolTest::TearDown();
+    }
+
+    std::unique_ptr<TestExecutorPool> pool;
+    MockTaskable taskable;
+};
+
 struct ExpectedThreadCounts {
     size_t maxThreads;
     size_t reader;
@@ -31,7 +31,10 @@
 
 #include <algorithm>
 #include <limits>
+#include <map>
+#include <set>
 #include <signal.h>
+#include <thread>
 
 EPStats global_stats;
 
@@ -281,6 +284,132 @@ private:
     std::atomic<size_t>       size;
 };
 
+/*
+ * Bucketized layout tests. A small table is used so most buckets exceed the
+ * TagBucket slot count, exercising the overflow fallback to the chain.
+ */
+TEST_F(HashTableTest, BucketizedFind) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                HashTable::Layout::Bucketized);
+    ASSERT_EQ(HashTable::Layout::Bucketized, h.getLayout());
+    testFind(h);
+}
+
+TEST_F(HashTableTest, BucketizedDeletions) {
+    size_t initialSize = global_stats.currentSize.load();
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                HashTable::Layout::Bucketized);
+    const int nkeys = 1000;
+
+    auto keys = generateKeys(nkeys);
+    storeMany(h, keys);
+    EXPECT_EQ(nkeys, count(h));
+
+    // Delete every other key; the remainder must still be found (whether
+    // they are held in a TagBucket or only in the overflowed chain).
+    std::vector<StoredDocKey> remaining;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2) {
+            EXPECT_TRUE(del(h, keys[i]));
+            EXPECT_FALSE(h.find(keys[i], TrackReference::No, WantsDeleted::Yes));
+        } else {
+            remaining.push_back(keys[i]);
+        }
+    }
+    verifyFound(h, remaining);
+
+    for (const auto& key : remaining) {
+        EXPECT_TRUE(del(h, key));
+    }
+    EXPECT_EQ(0, count(h));
+    EXPECT_EQ(initialSize, global_stats.currentSize.load());
+}
+
+TEST_F(HashTableTest, BucketizedResize) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                3,
+                HashTable::Layout::Bucketized);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+    verifyFound(h, keys);
+
+    const size_t chainedMemory = HashTable(global_stats, makeFactory(), 6143, 3)
+                                         .memorySize();
+    h.resize(6143);
+    EXPECT_EQ(6143, h.getSize());
+    EXPECT_GT(h.memorySize(), chainedMemory);
+    verifyFound(h, keys);
+
+    h.resize(769);
+    EXPECT_EQ(769, h.getSize());
+    verifyFound(h, keys);
+
+    h.clear();
+    EXPECT_EQ(0, count(h));
+    EXPECT_FALSE(h.find(keys[0], TrackReference::No, WantsDeleted::Yes));
+}
+
+TEST_F(HashTableTest, LayoutFromString) {
+    EXPECT_EQ(HashTable::Layout::Chained,
+              HashTable::layoutFromString("chained"));
+    EXPECT_EQ(HashTable::Layout::Bucketized,
+              HashTable::layoutFromString("bucketized"));
+    EXPECT_THROW(HashTable::layoutFromString("cuckoo"), std::invalid_argument);
+}
+
+TEST_F(HashTableTest, EvictionPolicyFromString) {
+    EXPECT_EQ(HashTable::EvictionPolicy::NRU,
+              HashTable::evictionPolicyFromString("nru"));
+    EXPECT_EQ(HashTable::EvictionPolicy::TinyLFU,
+              HashTable::evictionPolicyFromString("tinylfu"));
+    EXPECT_THROW(HashTable::evictionPolicyFromString("arc"),
+                 std::invalid_argument);
+}
+
+// Under TinyLFU a key's access frequency is tracked per StoredValue, and is
+// remembered (by the sketch) across the key being removed and re-added.
+TEST_F(HashTableTest, TinyLFUFrequency) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                HashTable::Layout::Chained,
+                HashTable::EvictionPolicy::TinyLFU);
+    const auto hot = makeStoredDocKey("hot");
+    const auto cold = makeStoredDocKey("cold");
+    store(h, hot);
+    store(h, cold);
+
+    for (int ii = 0; ii < 20; ++ii) {
+        h.find(hot, TrackReference::Yes, WantsDeleted::No);
+    }
+    // Not tracking references should leave the counter alone.
+    h.find(cold, TrackReference::No, WantsDeleted::No);
+
+    auto* hotSv = h.find(hot, TrackReference::No, WantsDeleted::No);
+    auto* coldSv = h.find(cold, TrackReference::No, WantsDeleted::No);
+    ASSERT_TRUE(hotSv);
+    ASSERT_TRUE(coldSv);
+    EXPECT_EQ(StoredValue::initialFreqCount, coldSv->getFreqCounterValue());
+    EXPECT_GT(hotSv->getFreqCounterValue(), StoredValue::initialFreqCount);
+
+    // Re-adding the hot key admits it with its previous frequency.
+    ASSERT_TRUE(del(h, hot));
+    store(h, hot);
+    hotSv = h.find(hot, TrackReference::No, WantsDeleted::No);
+    ASSERT_TRUE(hotSv);
+    EXPECT_GT(hotSv->getFreqCounterValue(), StoredValue::initialFreqCount);
+}
+
 TEST_F(HashTableTest, ConcurrentAccessResize) {
     HashTable h(global_stats, makeFactory(), 5, 3);
 
@@ -295,6 +424,258 @@ TEST_F(HashTableTest, ConcurrentAccessResize) {
     getCompletedThreads(4, &gen);
 }
 
+/*
+ * Incremental resize tests. Keys must be found (and visited exactly once)
+ * whether their old bucket has been migrated yet or not.
+ */
+TEST_F(HashTableTest, IncrementalResize) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    ASSERT_TRUE(h.beginIncrementalResize(6143));
+    EXPECT_TRUE(h.isResizing());
+    EXPECT_EQ(6143, h.getSize());
+    EXPECT_EQ(5, h.getResizeBucketsTotal());
+    EXPECT_EQ(1, h.getNumResizes());
+
+    // Can't start another (or a blocking) resize until this one completes.
+    EXPECT_FALSE(h.beginIncrementalResize(769));
+    h.resize(769);
+    EXPECT_EQ(6143, h.getSize());
+
+    verifyFound(h, keys);
+    EXPECT_EQ(1000, count(h));
+
+    // Lookups migrate the buckets they touch; every old bucket has been
+    // looked up by now.
+    EXPECT_EQ(5, h.getResizeBucketsMigrated());
+
+    EXPECT_TRUE(h.resizeStep(std::chrono::microseconds(1000)));
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(0, h.getResizeBucketsTotal());
+    EXPECT_FALSE(h.resizeStep(std::chrono::microseconds(1000)));
+    verifyFound(h, keys);
+    EXPECT_EQ(1000, count(h));
+}
+
+TEST_F(HashTableTest, IncrementalResizeSteps) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    auto keys = generateKeys(5000);
+    storeMany(h, keys);
+    h.resize(3079);
+    const size_t memOverhead = global_stats.memOverhead->load();
+
+    ASSERT_TRUE(h.beginIncrementalResize(769));
+    EXPECT_EQ(3079, h.getResizeBucketsTotal());
+
+    // Mutate while only some buckets have been migrated.
+    ASSERT_TRUE(h.resizeStep(std::chrono::microseconds(0)));
+    EXPECT_TRUE(h.isResizing());
+    EXPECT_LT(h.getResizeBucketsMigrated(), h.getResizeBucketsTotal());
+
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        EXPECT_TRUE(del(h, keys[i]));
+    }
+    auto newKeys = generateKeys(6000, 5000);
+    storeMany(h, newKeys);
+    EXPECT_EQ(3500, count(h));
+
+    // pauseResumeVisit must see every item exactly once, even when paused
+    // in the old buckets.
+    class PausingCounter : public HashTableVisitor {
+    public:
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            seen.insert(StoredDocKey(v.getKey()));
+            ++visited;
+            return (visited % 7) != 0;
+        }
+        std::set<StoredDocKey> seen;
+        size_t visited = 0;
+    } visitor;
+    HashTable::Position pos;
+    while (pos != h.endPosition()) {
+        pos = h.pauseResumeVisit(visitor, pos);
+    }
+    EXPECT_EQ(3500, visitor.seen.size());
+    EXPECT_EQ(3500, visitor.visited);
+
+    HashTableDepthStatVisitor depthCounter;
+    h.visitDepth(depthCounter);
+    EXPECT_EQ(3500, depthCounter.size);
+
+    while (h.isResizing()) {
+        ASSERT_TRUE(h.resizeStep(std::chrono::microseconds(0)));
+    }
+    EXPECT_EQ(769, h.getSize());
+    EXPECT_EQ(3500, count(h));
+    for (size_t i = 1; i < keys.size(); i += 2) {
+        EXPECT_TRUE(h.find(keys[i], TrackReference::No, WantsDeleted::No));
+    }
+    verifyFound(h, newKeys);
+
+    // Back to the same bucket count, so the same overhead.
+    h.resize(3079);
+    EXPECT_EQ(memOverhead, global_stats.memOverhead->load());
+}
+
+TEST_F(HashTableTest, BucketizedIncrementalResize) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                3,
+                HashTable::Layout::Bucketized);
+
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    ASSERT_TRUE(h.beginIncrementalResize(6143));
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        EXPECT_TRUE(del(h, keys[i]));
+    }
+    while (h.isResizing()) {
+        ASSERT_TRUE(h.resizeStep(std::chrono::microseconds(0)));
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(i % 3 != 0,
+                  h.find(keys[i], TrackReference::No, WantsDeleted::No) !=
+                          nullptr);
+    }
+}
+
+/*
+ * A pauseResumeVisit which is paused while the table is part way through a
+ * resize, and resumed after more buckets have been migrated (or the resize
+ * has begun or completed), must still visit every item at least once: the
+ * migration may move items from buckets it hasn't visited yet into buckets
+ * it has already passed.
+ */
+TEST_F(HashTableTest, PauseResumeVisitAcrossResizeStep) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    auto keys = generateKeys(5000);
+    storeMany(h, keys);
+    h.resize(3079);
+
+    class PausingVisitor : public HashTableVisitor {
+    public:
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            seen.insert(StoredDocKey(v.getKey()));
+            return (++visited % 50) != 0;
+        }
+        std::set<StoredDocKey> seen;
+        size_t visited = 0;
+    } visitor;
+
+    // Pause once before the resize begins, then take a step of the resize
+    // between every pause until it completes.
+    HashTable::Position pos = h.pauseResumeVisit(visitor, pos);
+    ASSERT_NE(h.endPosition(), pos);
+    ASSERT_TRUE(h.beginIncrementalResize(769));
+    size_t steps = 0;
+    while (pos != h.endPosition()) {
+        pos = h.pauseResumeVisit(visitor, pos);
+        if (h.isResizing()) {
+            // A budget of zero migrates 64 buckets per step.
+            ASSERT_TRUE(h.resizeStep(std::chrono::microseconds(0)));
+            ++steps;
+        }
+    }
+
+    EXPECT_GT(steps, 1);
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(keys.size(), visitor.seen.size());
+}
+
+/*
+ * Buckets migrated while a pauseResumeVisit is paused (by front-end lookups
+ * or a resize step) must not restart the visit: every item is still visited,
+ * and none more than twice (an item migrated out of an old bucket which was
+ * already visited is visited again in its new bucket).
+ */
+TEST_F(HashTableTest, PauseResumeVisitAcrossMigration) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    auto keys = generateKeys(5000);
+    storeMany(h, keys);
+    h.resize(3079);
+    ASSERT_TRUE(h.beginIncrementalResize(769));
+
+    class PausingVisitor : public HashTableVisitor {
+    public:
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            ++seen[StoredDocKey(v.getKey())];
+            return (++visited % 50) != 0;
+        }
+        std::map<StoredDocKey, int> seen;
+        size_t visited = 0;
+    } visitor;
+
+    HashTable::Position pos = h.pauseResumeVisit(visitor, pos);
+    ASSERT_NE(h.endPosition(), pos);
+    ASSERT_TRUE(h.resizeStep(std::chrono::microseconds(0)));
+    const size_t migratedAtPause = h.getResizeBucketsMigrated();
+
+    size_t next = 0;
+    while (pos != h.endPosition()) {
+        // Lookups migrate the old bucket of each key.
+        for (size_t i = 0; i < 100; ++i, next = (next + 37) % keys.size()) {
+            EXPECT_TRUE(h.find(keys[next], TrackReference::No,
+                               WantsDeleted::No));
+        }
+        pos = h.pauseResumeVisit(visitor, pos);
+    }
+
+    EXPECT_TRUE(h.isResizing());
+    EXPECT_GT(h.getResizeBucketsMigrated(), migratedAtPause);
+    EXPECT_EQ(keys.size(), visitor.seen.size());
+    for (const auto& entry : visitor.seen) {
+        EXPECT_LE(entry.second, 2) << entry.first.c_str();
+    }
+}
+
+TEST_F(HashTableTest, ConcurrentAccessIncrementalResize) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+
+    auto keys = generateKeys(4000);
+    storeMany(h, keys);
+
+    // Front-end threads delete and re-add keys while the table is resized
+    // back and forth in small steps.
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&h, &keys, &done, t]() {
+            while (!done) {
+                for (size_t i = t; i < keys.size(); i += 4) {
+                    EXPECT_TRUE(del(h, keys[i]));
+                    store(h, keys[i]);
+                }
+            }
+        });
+    }
+
+    for (size_t newSize : {3079, 769, 6143, 47}) {
+        ASSERT_TRUE(h.beginIncrementalResize(newSize));
+        while (h.isResizing()) {
+            h.resizeStep(std::chrono::microseconds(100));
+        }
+        EXPECT_EQ(newSize, h.getSize());
+    }
+
+    done = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    verifyFound(h, keys);
+    EXPECT_EQ(keys.size(), count(h));
+}
+
 TEST_F(HashTableTest, AutoResize) {
     HashTable h(global_stats, makeFactory(), 5, 3);
 
@@ -728,6 +1109,34 @@ TEST_F(HashTableTest, CopyItem) {
     EXPECT_EQ(statsCurrSizeBeforeCopy, global_stats.currentSize.load());
 }
 
+/* Test that a copy replacing an element is found via the TagBucket */
+TEST_F(HashTableTest, BucketizedCopyItem) {
+    HashTable ht(global_stats,
+                 makeFactory(true),
+                 2,
+                 1,
+                 HashTable::Layout::Bucketized);
+
+    auto keys = generateKeys(3);
+    storeMany(ht, keys);
+
+    StoredDocKey copyKey = makeStoredDocKey(std::string(std::to_string(0)));
+    auto hbl = ht.getLockedBucket(copyKey);
+    StoredValue* replaceSv = ht.unlocked_find(
+            copyKey, hbl.getBucketNum(), WantsDeleted::Yes, TrackReference::No);
+
+    auto res = ht.unlocked_replaceByCopy(hbl, *replaceSv);
+    EXPECT_EQ(replaceSv, res.second.get());
+
+    /* The copy (not the released original) must now be returned by find */
+    EXPECT_EQ(res.first,
+              ht.unlocked_find(copyKey,
+                               hbl.getBucketNum(),
+                               WantsDeleted::Yes,
+                               TrackReference::No));
+    EXPECT_EQ(keys.size(), ht.getNumItems());
+}
+
 /* Test copying a deleted element in HT */
 TEST_F(HashTableTest, CopyDeletedItem) {
     /* Setup with 2 hash buckets and 1 lock. Note: Copying is allowed only on
@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the TinyLFU eviction building blocks: FrequencySketch and
+ * ItemEviction.
+ */
+
+#include "frequency_sketch.h"
+#include "item_eviction.h"
+
+#include <gtest/gtest.h>
+
+TEST(FrequencySketchTest, WidthRoundedToPowerOfTwo) {
+    EXPECT_EQ(64, FrequencySketch(1).getWidth());
+    EXPECT_EQ(1024, FrequencySketch(1000).getWidth());
+    EXPECT_EQ(1024, FrequencySketch(1024).getWidth());
+}
+
+TEST(FrequencySketchTest, IncrementAndSaturate) {
+    FrequencySketch sketch(1024);
+    EXPECT_EQ(0, sketch.frequency(12345));
+
+    for (int ii = 1; ii <= FrequencySketch::MaxCount; ++ii) {
+        EXPECT_EQ(ii, sketch.increment(12345));
+    }
+    EXPECT_EQ(FrequencySketch::MaxCount, sketch.frequency(12345));
+    EXPECT_EQ(FrequencySketch::MaxCount, sketch.increment(12345));
+
+    // A single other key is very unlikely to collide in every row.
+    EXPECT_EQ(0, sketch.frequency(54321));
+}
+
+// After 10 * width increments the counters are halved.
+TEST(FrequencySketchTest, Aging) {
+    FrequencySketch sketch(64);
+    for (int ii = 0; ii < 10; ++ii) {
+        sketch.increment(1);
+    }
+    ASSERT_EQ(10, sketch.frequency(1));
+
+    // Spread further increments over other keys until the sketch ages.
+    // (Increments of saturated counters are not counted, so the exact
+    // number needed depends on collisions.)
+    for (uint32_t ii = 0; sketch.getNumResets() == 0 && ii < 10000; ++ii) {
+        sketch.increment(1000 + ii);
+    }
+    EXPECT_EQ(1, sketch.getNumResets());
+    // Even if other keys collided with every counter of key 1, halving
+    // leaves it below its previous count.
+    EXPECT_LE(sketch.frequency(1), FrequencySketch::MaxCount / 2);
+}
+
+TEST(ItemEvictionTest, EmptyThreshold) {
+    ItemEviction eviction;
+    auto threshold = eviction.getFreqThreshold(0.5);
+    EXPECT_EQ(0, threshold.value);
+    EXPECT_EQ(0, threshold.probabilityAtValue);
+    EXPECT_FALSE(ItemEviction::shouldEvict(0, threshold, 0.0));
+}
+
+TEST(ItemEvictionTest, Threshold) {
+    ItemEviction eviction;
+    // 100 items at each of frequency 0..9.
+    for (int freq = 0; freq < 10; ++freq) {
+        for (int ii = 0; ii < 100; ++ii) {
+            eviction.addFreqValue(freq);
+        }
+    }
+    EXPECT_EQ(1000, eviction.getPopulation());
+
+    auto threshold = eviction.getFreqThreshold(0.25);
+    EXPECT_EQ(2, threshold.value);
+    EXPECT_DOUBLE_EQ(0.5, threshold.probabilityAtValue);
+    EXPECT_TRUE(ItemEviction::shouldEvict(1, threshold, 0.99));
+    EXPECT_TRUE(ItemEviction::shouldEvict(2, threshold, 0.25));
+    EXPECT_FALSE(ItemEviction::shouldEvict(2, threshold, 0.75));
+    EXPECT_FALSE(ItemEviction::shouldEvict(3, threshold, 0.0));
+
+    threshold = eviction.getFreqThreshold(1.0);
+    EXPECT_EQ(9, threshold.value);
+    EXPECT_DOUBLE_EQ(1.0, threshold.probabilityAtValue);
+
+    eviction.reset();
+    EXPECT_EQ(0, eviction.getPopulation());
+}
+
+// Many items with the same frequency shouldn't all be evicted.
+TEST(ItemEvictionTest, SameFrequency) {
+    ItemEviction eviction;
+    for (int ii = 0; ii < 1000; ++ii) {
+        eviction.addFreqValue(4);
+    }
+    auto threshold = eviction.getFreqThreshold(0.1);
+    EXPECT_EQ(4, threshold.value);
+    EXPECT_DOUBLE_EQ(0.1, threshold.probabilityAtValue);
+}
@@ -32,6 +32,8 @@
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
+#include <map>
+
 /**
  * Test fixture for KVBucket tests running in single-threaded mode.
  *
@@ -234,14 +236,17 @@ protected:
         ASSERT_EQ(initialNonIoTasks, lpNonioQ.getFutureQueueSize());
 
         if (itemPagerScheduled) {
-            // Item pager consists of two Tasks - the parent ItemPager task,
-            // and then a per-vBucket task (via VCVBAdapter) - which there is
-            // just one of as we only have one vBucket online.
+            // Item pager consists of the parent ItemPager task, and then one
+            // or more visitor tasks (via VBCBAdaptor) which between them
+            // visit each online vBucket once.
             runNextTask(lpNonioQ, "Paging out items.");
             ASSERT_EQ(0, lpNonioQ.getReadyQueueSize());
-            ASSERT_EQ(initialNonIoTasks + 1, lpNonioQ.getFutureQueueSize());
+            const size_t numVisitors =
+                    lpNonioQ.getFutureQueueSize() - initialNonIoTasks;
+            ASSERT_GE(numVisitors, 1);
+            ASSERT_LE(numVisitors, online_vb_count);
             for (size_t ii = 0; ii < online_vb_count; ii++) {
-                runNextTask(lpNonioQ, "Item pager on vb 0");
+                runNextTask(lpNonioQ);
             }
         } else {
             runNextTask(lpNonioQ, "Paging expired items.");
@@ -441,6 +446,106 @@ TEST_P(STItemPagerTest, test_memory_limit) {
     }
 }
 
+// With several vBuckets the ItemPager splits them between concurrent
+// visitors, which between them get memory usage below the low watermark.
+TEST_P(STItemPagerTest, ParallelVisitors) {
+    if (!itemPagerScheduled) {
+        // fail_new_data buckets don't page out items.
+        return;
+    }
+    const uint16_t numVBuckets = 4;
+    for (uint16_t vb = 1; vb < numVBuckets; ++vb) {
+        store->setVBucketState(vb, vbucket_state_active, false);
+    }
+
+    // Spread documents over the vBuckets until we hit TMPFAIL.
+    auto& stats = engine->getEpStats();
+    const std::string value(512, 'x');
+    ENGINE_ERROR_CODE result = ENGINE_SUCCESS;
+    for (size_t count = 0; result == ENGINE_SUCCESS; ++count) {
+        auto key = makeStoredDocKey("xxx_" + std::to_string(count));
+        auto item = make_item(count % numVBuckets, key, value);
+        item.setNRUValue(MAX_NRU_VALUE);
+        result = storeItem(item);
+    }
+    ASSERT_EQ(ENGINE_TMPFAIL, result);
+    for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+        store->getVBucket(vb)->checkpointManager->createNewCheckpoint();
+        if (std::get<0>(GetParam()) == "persistent") {
+            getEPBucket().flushVBucket(vb);
+        }
+    }
+
+    runHighMemoryPager(numVBuckets);
+
+    EXPECT_LT(stats.getTotalMemoryUsed(), stats.mem_low_wat.load())
+            << "Expected to be below low watermark after running item pager";
+
+    std::map<std::string, std::string> pagerStats;
+    auto addStat = [](const char* key,
+                      const uint16_t klen,
+                      const char* val,
+                      const uint32_t vlen,
+                      gsl::not_null<const void*> cookie) {
+        auto& map = *static_cast<std::map<std::string, std::string>*>(
+                const_cast<void*>(cookie.get()));
+        map[std::string(key, klen)] = std::string(val, vlen);
+    };
+    store->addItemPagerStats(addStat, &pagerStats);
+
+    const size_t expectedVisitors = std::min(
+            {size_t(numVBuckets),
+             engine->getConfiguration().getPagerConcurrentVisitors(),
+             ExecutorPool::get()->getNumNonIO()});
+    ASSERT_EQ(std::to_string(expectedVisitors),
+              pagerStats["ep_pager_visitors"]);
+    size_t totalVBuckets = 0;
+    for (size_t ii = 0; ii < expectedVisitors; ++ii) {
+        const auto prefix = "ep_pager_visitor_" + std::to_string(ii);
+        totalVBuckets += std::stoul(pagerStats[prefix + "_vbuckets"]);
+        EXPECT_EQ("true", pagerStats[prefix + "_completed"]);
+    }
+    EXPECT_EQ(numVBuckets, totalVBuckets);
+}
+
+/**
+ * Test fixture for item pager tests using the TinyLFU eviction policy.
+ */
+class STTinyLFUItemPagerTest : public STItemPagerTest {
+protected:
+    void SetUp() override {
+        config_string += "ht_eviction_policy=tinylfu;";
+        STItemPagerTest::SetUp();
+    }
+};
+
+// Frequently accessed items should not be evicted by the TinyLFU policy,
+// whereas the random phase of the NRU policy could evict them.
+TEST_P(STTinyLFUItemPagerTest, HotItemsNotEvicted) {
+    size_t count = populateUntilTmpFail(vbid);
+    ASSERT_GE(count, 50) << "Too few documents stored";
+
+    const size_t numHot = 10;
+    for (int access = 0; access < 20; ++access) {
+        for (size_t ii = 0; ii < numHot; ++ii) {
+            auto key = makeStoredDocKey("xxx_" + std::to_string(ii));
+            auto result = store->get(key, vbid, cookie, TRACK_REFERENCE);
+            ASSERT_EQ(ENGINE_SUCCESS, result.getStatus());
+        }
+    }
+
+    runHighMemoryPager();
+
+    auto vb = store->getVBucket(vbid);
+    EXPECT_GT(vb->getNumNonResidentItems(), 0) << "Expected some evictions";
+    for (size_t ii = 0; ii < numHot; ++ii) {
+        auto key = makeStoredDocKey("xxx_" + std::to_string(ii));
+        auto* sv = vb->ht.find(key, TrackReference::No, WantsDeleted::No);
+        ASSERT_TRUE(sv);
+        EXPECT_TRUE(sv->isResident()) << "Hot item " << key << " evicted";
+    }
+}
+
 /**
  * Test fixture for Ephemeral-only item pager tests.
  */
@@ -885,6 +990,10 @@ INSTANTIATE_TEST_CASE_P(Persistent,
                         STPersistentExpiryPagerTest,
                         persistentConfigValues, );
 
+INSTANTIATE_TEST_CASE_P(Persistent,
+                        STTinyLFUItemPagerTest,
+                        persistentConfigValues, );
+
 INSTANTIATE_TEST_CASE_P(Ephemeral, STEphemeralItemPagerTest, ephConfigValues, );
 
 #endif
@@ -24,6 +24,7 @@
 
 #include <gtest/gtest.h>
 #include <memcached/protocol_binary.h>
+#include <platform/compress.h>
 #include <platform/make_unique.h>
 
 class ItemNoValuePruneTest : public ::testing::TestWithParam<
@@ -118,6 +119,75 @@ TEST_F(ItemTest, getAndSetCachedDataType) {
               (PROTOCOL_BINARY_DATATYPE_JSON & item->getDataType()));
 }
 
+TEST_F(ItemTest, getCompressedValueIsShared) {
+    std::string valueData(1024, 'x');
+    item = std::make_unique<Item>(
+            makeStoredDocKey("key"),
+            0,
+            0,
+            valueData.c_str(),
+            valueData.size());
+
+    // The first call compresses the value...
+    bool compressedNow = false;
+    auto compressed = item->getCompressedValue(compressedNow);
+    EXPECT_TRUE(compressedNow);
+    ASSERT_TRUE(compressed);
+    EXPECT_LT(compressed->valueSize(), valueData.size());
+
+    cb::compression::Buffer inflated;
+    ASSERT_TRUE(cb::compression::inflate(
+            cb::compression::Algorithm::Snappy,
+            {compressed->getData(), compressed->valueSize()},
+            inflated));
+    EXPECT_EQ(valueData, std::string(inflated.data(), inflated.size()));
+
+    // ...later calls share the same compressed copy.
+    auto again = item->getCompressedValue(compressedNow);
+    EXPECT_FALSE(compressedNow);
+    EXPECT_EQ(compressed.get(), again.get());
+
+    // The copy counts towards the item's size, and its memory can be
+    // claimed (to charge to the item's checkpoint) only once.
+    const size_t cacheSize = item->getCompressedValueMemSize();
+    EXPECT_GE(cacheSize, compressed->getSize());
+    EXPECT_EQ(item->sizeWithoutCompressedValue() + cacheSize, item->size());
+    EXPECT_EQ(cacheSize, item->claimCompressedValueMemSize());
+    EXPECT_EQ(0, item->claimCompressedValueMemSize());
+
+    // The item itself is unchanged, and copies don't share the cache.
+    EXPECT_EQ(valueData.size(), item->getNBytes());
+    EXPECT_FALSE(mcbp::datatype::is_snappy(item->getDataType()));
+    Item copy(*item);
+    EXPECT_EQ(copy.sizeWithoutCompressedValue(), copy.size());
+    copy.getCompressedValue(compressedNow);
+    EXPECT_TRUE(compressedNow);
+}
+
+TEST_F(ItemTest, getCompressedValueIncompressible) {
+    // A value which snappy can't shrink isn't worth sending compressed.
+    std::string valueData = "abc";
+    item = std::make_unique<Item>(
+            makeStoredDocKey("key"),
+            0,
+            0,
+            valueData.c_str(),
+            valueData.size());
+
+    const size_t size = item->size();
+    EXPECT_EQ(0, item->getCompressedValueMemSize());
+    EXPECT_EQ(0, item->claimCompressedValueMemSize());
+
+    bool compressedNow = false;
+    EXPECT_FALSE(item->getCompressedValue(compressedNow));
+    EXPECT_TRUE(compressedNow);
+    // Only the (empty) cache entry itself is added.
+    EXPECT_LT(0, item->getCompressedValueMemSize());
+    EXPECT_EQ(size + item->getCompressedValueMemSize(), item->size());
+    EXPECT_FALSE(item->getCompressedValue(compressedNow));
+    EXPECT_FALSE(compressedNow);
+}
+
 TEST_F(ItemPruneTest, testPruneNothing) {
     item->pruneValueAndOrXattrs(IncludeValue::Yes, IncludeXattrs::Yes);
 
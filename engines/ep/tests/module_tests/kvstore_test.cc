@@ -20,6 +20,8 @@
 #include <platform/dirutils.h>
 
 #include "callbacks.h"
+#include "couch-kvstore/couch-fs-deferred-sync.h"
+#include "couch-kvstore/couch-fs-uring.h"
 #include "couch-kvstore/couch-kvstore.h"
 #include "kvstore.h"
 #include "kvstore_config.h"
@@ -28,6 +30,7 @@
 #include "tests/test_fileops.h"
 #include "vbucket_bgfetch_item.h"
 
+#include <fcntl.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <kvstore.h>
@@ -376,6 +379,265 @@ TEST_F(CouchKVStoreTest, MB_18580_ENOENT) {
     EXPECT_THROW(kvstore.ro->getDbFileInfo(0), std::system_error);
 }
 
+/// @return true if io_uring reads are available in this build and kernel.
+static bool isAsyncIOAvailable() {
+    FileStats stats;
+    IoUringFileOps ops(stats, *couchstore_get_default_file_ops(), 1);
+    return ops.isAsync();
+}
+
+// Check that a getMulti reading via io_uring returns exactly what the
+// default (synchronous) FileOps do: for documents which span several
+// blocks, for the last document in the file (whose prefetch is a short
+// read), for meta-only fetches and for missing keys.
+TEST_F(CouchKVStoreTest, GetMultiAsyncIOMatchesDefault) {
+    KVStoreConfig config(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    auto kvstore = setup_kv_store(config);
+
+    const size_t numItems = 50;
+    kvstore->begin({});
+    WriteCallback wc;
+    for (size_t ii = 0; ii < numItems; ++ii) {
+        const std::string key("key" + std::to_string(ii));
+        // From a few bytes up to ~3 blocks, in no particular order.
+        const std::string value((ii * 7919) % 12000 + 1, char('a' + ii % 26));
+        Item item(makeStoredDocKey(key),
+                  0,
+                  0,
+                  value.data(),
+                  value.size(),
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  ii + 1);
+        kvstore->set(item, wc);
+    }
+    ASSERT_TRUE(kvstore->commit(nullptr /*no collections manifest*/));
+
+    const auto makeQueue = [numItems]() {
+        vb_bgfetch_queue_t itms;
+        for (size_t ii = 0; ii < numItems; ++ii) {
+            vb_bgfetch_item_ctx_t ctx;
+            ctx.isMetaOnly = (ii % 10 == 0) ? GetMetaOnly::Yes : GetMetaOnly::No;
+            itms[makeStoredDocKey("key" + std::to_string(ii))] = std::move(ctx);
+        }
+        itms[makeStoredDocKey("missing")].isMetaOnly = GetMetaOnly::No;
+        return itms;
+    };
+
+    auto expected = makeQueue();
+    kvstore->getMulti(0, expected);
+
+    KVStoreConfig asyncConfig(
+            1024, 4, data_dir, "couchdb", 0, false /*persistnamespace*/);
+    asyncConfig.setAsyncIO(true);
+    auto asyncStore = KVStoreFactory::create(asyncConfig);
+    ASSERT_NE(nullptr, asyncStore.rw);
+    auto actual = makeQueue();
+    asyncStore.rw->getMulti(0, actual);
+
+    ASSERT_EQ(expected.size(), actual.size());
+    for (auto& entry : expected) {
+        const auto& key = entry.first;
+        const auto& want = entry.second.value;
+        const auto& got = actual[key].value;
+        ASSERT_EQ(want.getStatus(), got.getStatus()) << key.c_str();
+        if (want.getStatus() != ENGINE_SUCCESS) {
+            continue;
+        }
+        ASSERT_TRUE(want.item);
+        ASSERT_TRUE(got.item);
+        EXPECT_EQ(want.item->getBySeqno(), got.item->getBySeqno());
+        EXPECT_EQ(want.item->getCas(), got.item->getCas());
+        EXPECT_EQ(want.item->getDataType(), got.item->getDataType());
+        EXPECT_EQ(std::string(want.item->getData(), want.item->getNBytes()),
+                  std::string(got.item->getData(), got.item->getNBytes()))
+                << key.c_str();
+    }
+    EXPECT_EQ(ENGINE_KEY_ENOENT,
+              actual[makeStoredDocKey("missing")].value.getStatus());
+
+    std::map<std::string, std::string> stats;
+    asyncStore.rw->addStats(add_stat_callback, &stats);
+    if (isAsyncIOAvailable()) {
+        EXPECT_NE("0", stats["rw_0:io_async_reads_submitted"]);
+        EXPECT_NE("0", stats["rw_0:io_async_read_hits"]);
+    } else {
+        // No kernel support: everything is read via the default FileOps.
+        EXPECT_EQ("0", stats["rw_0:io_async_reads_submitted"]);
+    }
+}
+
+// Check IoUringFileOps serves reads from prefetched ranges (including a
+// short read at the end of the file), falls back to the wrapped ops for
+// anything else, and only prefetches read-only handles.
+TEST_F(CouchKVStoreTest, IoUringFileOpsPrefetch) {
+    cb::io::mkdirp(data_dir);
+    const std::string path = data_dir + "/file";
+    std::string content(10000, '\0');
+    for (size_t ii = 0; ii < content.size(); ++ii) {
+        content[ii] = char(ii * 31);
+    }
+    {
+        FILE* fp = fopen(path.c_str(), "wb");
+        ASSERT_NE(nullptr, fp);
+        ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), fp));
+        fclose(fp);
+    }
+
+    FileStats stats;
+    IoUringFileOps ops(stats, *couchstore_get_default_file_ops(), 2);
+    couchstore_error_info_t errinfo;
+
+    const auto read = [&ops, &errinfo](couch_file_handle h,
+                                       cs_off_t offset,
+                                       size_t length) {
+        std::string buf(length, '\0');
+        EXPECT_EQ(ssize_t(length),
+                  ops.pread(&errinfo, h, &buf[0], length, offset));
+        return buf;
+    };
+
+    // The writer's handle is never prefetched.
+    auto writer = ops.constructor(&errinfo);
+    ASSERT_EQ(COUCHSTORE_SUCCESS, ops.open(&errinfo, &writer, path.c_str(),
+                                           O_RDWR));
+    EXPECT_EQ(0u, ops.prefetch(path, {{0, 100}}));
+    ops.close(&errinfo, writer);
+    ops.destructor(writer);
+
+    auto h = ops.constructor(&errinfo);
+    ASSERT_EQ(COUCHSTORE_SUCCESS, ops.open(&errinfo, &h, path.c_str(),
+                                           O_RDONLY));
+    // Two ranges in the first block merge into one read; the last runs
+    // past the end of the file.
+    const size_t reads =
+            ops.prefetch(path, {{100, 50}, {200, 10}, {9000, 2000}});
+    if (ops.isAsync()) {
+        EXPECT_EQ(2u, reads);
+        EXPECT_EQ(2u, stats.asyncReadsSubmitted.load());
+    } else {
+        EXPECT_EQ(0u, reads);
+    }
+
+    EXPECT_EQ(content.substr(100, 50), read(h, 100, 50));
+    EXPECT_EQ(content.substr(9500, 500), read(h, 9500, 500));
+    EXPECT_EQ(ops.isAsync() ? 2u : 0u, stats.asyncReadHits.load());
+
+    // Outside the prefetched ranges.
+    EXPECT_EQ(content.substr(5000, 100), read(h, 5000, 100));
+    EXPECT_EQ(ops.isAsync() ? 2u : 0u, stats.asyncReadHits.load());
+
+    ops.close(&errinfo, h);
+    ops.destructor(h);
+}
+
+// Check DeferredSyncFileOps issues none of a commit's syncs, and holds back
+// its header until the data written before it has been synced.
+TEST_F(CouchKVStoreTest, DeferredSyncFileOpsHoldsHeader) {
+    cb::io::mkdirp(data_dir);
+    const std::string path = data_dir + "/file";
+
+    FileStats stats;
+    auto statsOps =
+            getCouchstoreStatsOps(stats, *couchstore_get_default_file_ops());
+    DeferredSyncFileOps ops(*statsOps);
+
+    // Position of the file's last header, as seen by another reader.
+    const auto headerPosition = [&path]() {
+        Db* reader;
+        EXPECT_EQ(COUCHSTORE_SUCCESS,
+                  couchstore_open_db(
+                          path.c_str(), COUCHSTORE_OPEN_FLAG_RDONLY, &reader));
+        DbInfo info;
+        couchstore_db_info(reader, &info);
+        couchstore_close_file(reader);
+        couchstore_free_db(reader);
+        return info.header_position;
+    };
+
+    const auto saveDoc = [](Db* db, const std::string& value) {
+        LocalDoc doc;
+        doc.id.buf = const_cast<char*>("_local/doc");
+        doc.id.size = sizeof("_local/doc") - 1;
+        doc.json.buf = const_cast<char*>(value.data());
+        doc.json.size = value.size();
+        doc.deleted = 0;
+        EXPECT_EQ(COUCHSTORE_SUCCESS,
+                  couchstore_save_local_document(db, &doc));
+    };
+
+    Db* db;
+    ASSERT_EQ(COUCHSTORE_SUCCESS,
+              couchstore_open_db_ex(
+                      path.c_str(), COUCHSTORE_OPEN_FLAG_CREATE, &ops, &db));
+    // Syncs aren't deferred until deferSyncs().
+    saveDoc(db, "{\"a\":1}");
+    ASSERT_EQ(COUCHSTORE_SUCCESS, couchstore_commit(db));
+    EXPECT_LT(0u, stats.numSyncs.load());
+    const auto committedHeader = headerPosition();
+
+    // A deferred commit issues no syncs, and only writes its data.
+    const size_t syncs = stats.numSyncs;
+    saveDoc(db, "{\"a\":2}");
+    ops.deferSyncs(*db);
+    ASSERT_EQ(COUCHSTORE_SUCCESS, couchstore_commit(db));
+    EXPECT_EQ(syncs, stats.numSyncs.load());
+    EXPECT_EQ(committedHeader, headerPosition());
+
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.syncDeferred(*db));
+    EXPECT_EQ(syncs + 1, stats.numSyncs.load());
+    EXPECT_EQ(committedHeader, headerPosition());
+
+    // Once released, the new header is visible and synced by the next
+    // syncDeferred().
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.writeHeld(*db));
+    EXPECT_LT(committedHeader, headerPosition());
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.syncDeferred(*db));
+    EXPECT_EQ(syncs + 2, stats.numSyncs.load());
+    EXPECT_EQ(COUCHSTORE_SUCCESS, ops.syncDeferred(*db));
+    EXPECT_EQ(syncs + 2, stats.numSyncs.load());
+
+    // The next commit syncs as normal.
+    saveDoc(db, "{\"a\":3}");
+    ASSERT_EQ(COUCHSTORE_SUCCESS, couchstore_commit(db));
+    EXPECT_LT(syncs + 2, stats.numSyncs.load());
+
+    couchstore_close_file(db);
+    couchstore_free_db(db);
+}
+
+// Check WindowedRate reports the rate over the last windowSecs whole
+// seconds, forgetting anything older.
+TEST(WindowedRateTest, Rate) {
+    WindowedRate rate;
+    const auto start = ProcessClock::now();
+    const auto at = [start](int seconds) {
+        return start + std::chrono::seconds(seconds);
+    };
+
+    EXPECT_EQ(0, rate.getRate(at(0)));
+    rate.add(10, at(0));
+    rate.add(10, at(0));
+    // The current second isn't yet counted.
+    EXPECT_EQ(0, rate.getRate(at(0)));
+    EXPECT_EQ(2.0, rate.getRate(at(1)));
+
+    rate.add(30, at(5));
+    EXPECT_EQ(5.0, rate.getRate(at(6)));
+    EXPECT_EQ(5.0, rate.getRate(at(WindowedRate::windowSecs)));
+    // The first second has left the window.
+    EXPECT_EQ(3.0, rate.getRate(at(WindowedRate::windowSecs + 1)));
+    EXPECT_EQ(0, rate.getRate(at(WindowedRate::windowSecs + 6)));
+
+    // The first second's slot is reused, starting again from zero.
+    rate.add(1, at(WindowedRate::windowSecs + 1));
+    EXPECT_EQ(3.1, rate.getRate(at(WindowedRate::windowSecs + 2)));
+
+    rate.reset();
+    EXPECT_EQ(0, rate.getRate(at(WindowedRate::windowSecs + 2)));
+}
+
 /**
  * The CouchKVStoreErrorInjectionTest cases utilise GoogleMock to inject
  * errors into couchstore as if they come from the filesystem in order
@@ -270,8 +270,16 @@ struct dcp_message_producers {
     /**
      * Send a system event message to the other end
      *
+     * The key is sent straight from the engine's memory (without being
+     * copied into the connection's send buffer) if the engine provides an
+     * item which keeps it alive: the core takes ownership of the item and
+     * releases it once the message has been sent. The (small) event data
+     * is always copied.
+     *
      * @param cookie passed on the cookie provided by step
      * @param opaque what to use as the opaque in the buffer
+     * @param it an item owning the memory `key` refers to, or nullptr if
+     *           the key should be copied
      * @param vbucket the vbucket the event applies to
      * @param bySeqno the sequence number of the event
      * @param key the system event's key data
@@ -282,6 +290,7 @@ struct dcp_message_producers {
     ENGINE_ERROR_CODE(*system_event)
     (gsl::not_null<const void*> cookie,
      uint32_t opaque,
+     item* it,
      uint16_t vbucket,
      mcbp::systemevent::id event,
      uint64_t bySeqno,
@@ -596,6 +596,20 @@ TEST_F(SettingsTest, ConnectionIdleTime) {
     }
 }
 
+TEST_F(SettingsTest, ConnectionRebalanceThreshold) {
+    nonNumericValuesShouldFail("connection_rebalance_threshold");
+
+    unique_cJSON_ptr obj(cJSON_CreateObject());
+    cJSON_AddNumberToObject(obj.get(), "connection_rebalance_threshold", 40);
+    try {
+        Settings settings(obj);
+        EXPECT_EQ(40, settings.getConnectionRebalanceThreshold());
+        EXPECT_TRUE(settings.has.connection_rebalance_threshold);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, BioDrainBufferSize) {
     nonNumericValuesShouldFail("bio_drain_buffer_sz");
 
@@ -1283,6 +1297,23 @@ TEST(SettingsUpdateTest, ConnectionIdleTimeIsDynamic) {
               settings.getConnectionIdleTime());
 }
 
+TEST(SettingsUpdateTest, ConnectionRebalanceThresholdIsDynamic) {
+    Settings updated;
+    Settings settings;
+    // setting it to the same value should work
+    auto old = settings.getConnectionRebalanceThreshold();
+    updated.setConnectionRebalanceThreshold(old);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+
+    // changing it should work
+    updated.setConnectionRebalanceThreshold(old + 10);
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_EQ(old, settings.getConnectionRebalanceThreshold());
+    EXPECT_NO_THROW(settings.updateSettings(updated));
+    EXPECT_EQ(updated.getConnectionRebalanceThreshold(),
+              settings.getConnectionRebalanceThreshold());
+}
+
 TEST(SettingsUpdateTest, BioDrainBufferSzIsNotDynamic) {
     Settings updated;
     Settings settings;
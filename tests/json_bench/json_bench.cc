@@ -0,0 +1,222 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmark of JSON datatype detection of document values, as done on the
+ * write path: JSON_checker on its own versus cb::json::isObjectOrArray()
+ * (with each implementation the CPU supports) falling back to JSON_checker
+ * for values it rejects.
+ *
+ * The corpora are generated to resemble common documents: a small flat
+ * profile, a medium sized nested order, a large document of long text
+ * fields, a document of non-ASCII text, and a binary (non-JSON) value.
+ *
+ * Reports the rate at which values are checked (bytes/s, items/s).
+ */
+
+#include <utilities/json_validator.h>
+
+#include <JSON_checker.h>
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+enum class Corpus { Small, Medium, Large, Utf8, Binary };
+
+static const char* to_string(Corpus corpus) {
+    switch (corpus) {
+    case Corpus::Small:
+        return "Small";
+    case Corpus::Medium:
+        return "Medium";
+    case Corpus::Large:
+        return "Large";
+    case Corpus::Utf8:
+        return "Utf8";
+    case Corpus::Binary:
+        return "Binary";
+    }
+    return "Unknown";
+}
+
+static std::string makeProfile(size_t id) {
+    const auto n = std::to_string(id);
+    return R"({"type":"user","id":)" + n + R"(,"name":"User number )" + n +
+           R"(","email":"user)" + n +
+           R"(@example.com","active":true,"score":)" + n +
+           R"(.5,"created":"2017-06-01T12:00:00Z","tags":["a","b","c"]})";
+}
+
+static std::string makeOrder() {
+    std::string doc = R"({"type":"order","customer":)" + makeProfile(1) +
+                      R"(,"lines":[)";
+    for (size_t ii = 0; ii < 40; ++ii) {
+        if (ii > 0) {
+            doc += ",";
+        }
+        const auto n = std::to_string(ii);
+        doc += R"({"sku":"SKU-)" + n + R"(","quantity":)" + n +
+               R"(,"price":)" + n + R"(.99,"discount":null,)" +
+               R"("options":{"colour":"blue","size":"L"}})";
+    }
+    return doc + R"(],"total":1234.56,"paid":false})";
+}
+
+static std::string makeArticles() {
+    const std::string sentence =
+            "The quick brown fox jumps over the lazy dog, again and again. ";
+    std::string doc = R"({"type":"feed","articles":[)";
+    for (size_t ii = 0; ii < 32; ++ii) {
+        if (ii > 0) {
+            doc += ",";
+        }
+        std::string body;
+        while (body.size() < 2000) {
+            body += sentence;
+        }
+        doc += R"({"title":"Article )" + std::to_string(ii) +
+               R"(","body":")" + body + R"(\n","views":)" +
+               std::to_string(ii * 100) + "}";
+    }
+    return doc + "]}";
+}
+
+static std::string makeUtf8() {
+    // Cyrillic, CJK and emoji (2, 3 and 4 byte characters)
+    const std::string text =
+            "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 "
+            "\xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c "
+            "\xf0\x9f\x98\x80 ";
+    std::string doc = R"({"type":"messages","messages":[)";
+    for (size_t ii = 0; ii < 64; ++ii) {
+        if (ii > 0) {
+            doc += ",";
+        }
+        std::string body;
+        while (body.size() < 200) {
+            body += text;
+        }
+        doc += R"({"from":)" + std::to_string(ii) + R"(,"text":")" + body +
+               R"("})";
+    }
+    return doc + "]}";
+}
+
+static std::string makeBinary() {
+    std::mt19937 generator(0);
+    std::string doc(4096, '\0');
+    for (auto& c : doc) {
+        c = char(generator());
+    }
+    return doc;
+}
+
+static const std::string& getCorpus(Corpus corpus) {
+    static const std::vector<std::string> corpora = {makeProfile(12345),
+                                                     makeOrder(),
+                                                     makeArticles(),
+                                                     makeUtf8(),
+                                                     makeBinary()};
+    return corpora[size_t(corpus)];
+}
+
+static void run(benchmark::State& state,
+                const std::string& doc,
+                bool expected,
+                bool (*detect)(const uint8_t*, size_t)) {
+    auto* ptr = reinterpret_cast<const uint8_t*>(doc.data());
+    while (state.KeepRunning()) {
+        if (detect(ptr, doc.size()) != expected) {
+            state.SkipWithError("unexpected result");
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * doc.size());
+    state.SetItemsProcessed(state.iterations());
+}
+
+static JSON_checker::Validator validator;
+
+/*
+ * Variables:
+ *  - range(0) : Corpus
+ */
+static void BM_JSONChecker(benchmark::State& state) {
+    const auto corpus = Corpus(state.range(0));
+    state.SetLabel(to_string(corpus));
+    run(state,
+        getCorpus(corpus),
+        corpus != Corpus::Binary,
+        [](const uint8_t* ptr, size_t size) {
+            return validator.validate(ptr, size);
+        });
+}
+
+/*
+ * Variables:
+ *  - range(0) : Corpus
+ *  - range(1) : cb::json::Implementation
+ */
+static void BM_IsObjectOrArray(benchmark::State& state) {
+    const auto corpus = Corpus(state.range(0));
+    static cb::json::Implementation implementation;
+    implementation = cb::json::Implementation(state.range(1));
+    if (!cb::json::isSupported(implementation)) {
+        state.SkipWithError("implementation not supported");
+        return;
+    }
+    state.SetLabel(std::string(to_string(corpus)) + "/" +
+                   cb::json::to_string(implementation));
+    run(state,
+        getCorpus(corpus),
+        corpus != Corpus::Binary,
+        [](const uint8_t* ptr, size_t size) {
+            return cb::json::isObjectOrArray(ptr, size, implementation) ||
+                   validator.validate(ptr, size);
+        });
+}
+
+static void CorpusArguments(benchmark::internal::Benchmark* b) {
+    for (auto corpus : {Corpus::Small,
+                        Corpus::Medium,
+                        Corpus::Large,
+                        Corpus::Utf8,
+                        Corpus::Binary}) {
+        b->Arg(int(corpus));
+    }
+}
+
+static void ImplementationArguments(benchmark::internal::Benchmark* b) {
+    for (auto corpus : {Corpus::Small,
+                        Corpus::Medium,
+                        Corpus::Large,
+                        Corpus::Utf8,
+                        Corpus::Binary}) {
+        for (auto implementation : {cb::json::Implementation::Scalar,
+                                    cb::json::Implementation::SSE2,
+                                    cb::json::Implementation::AVX2}) {
+            b->Args({int(corpus), int(implementation)});
+        }
+    }
+}
+
+BENCHMARK(BM_JSONChecker)->Apply(CorpusArguments);
+BENCHMARK(BM_IsObjectOrArray)->Apply(ImplementationArguments);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,165 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Tests of how connections are spread over (and moved between) the worker
+ * threads: picking a thread for a new connection by load, and which
+ * connections may be moved to another thread.
+ */
+
+#include "config.h"
+
+#include <daemon/connection_mcbp.h>
+#include <daemon/memcached.h>
+#include <gtest/gtest.h>
+
+class SelectWorkerThreadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (int ii = 0; ii < numThreads; ++ii) {
+            threads[ii].index = ii;
+        }
+    }
+
+    void setLoad(int index, uint32_t load, uint32_t connections) {
+        threads[index].load.store(load);
+        threads[index].num_connections.store(connections);
+    }
+
+    int select(int start, uint32_t loadEstimate = 1) {
+        return select_least_loaded_thread(
+                       threads, numThreads, start, loadEstimate)
+                ->index;
+    }
+
+    static const int numThreads = 3;
+    LIBEVENT_THREAD threads[numThreads]{};
+};
+
+TEST_F(SelectWorkerThreadTest, PicksLeastLoaded) {
+    setLoad(0, 500, 1);
+    setLoad(1, 100, 10);
+    setLoad(2, 300, 1);
+    for (int start = 0; start < numThreads; ++start) {
+        EXPECT_EQ(1, select(start)) << start;
+    }
+}
+
+TEST_F(SelectWorkerThreadTest, CountsConnectionsDispatchedSinceTick) {
+    setLoad(0, 100, 1);
+    setLoad(1, 200, 1);
+    setLoad(2, 300, 1);
+
+    // Each connection dispatched since the load was measured counts as
+    // the estimated load of a connection
+    threads[0].dispatched_since_tick = 3;
+    EXPECT_EQ(0, select(0, 30));
+    EXPECT_EQ(1, select(0, 50));
+
+    // ... so a burst of connections is spread over the threads
+    threads[1].dispatched_since_tick = 2;
+    EXPECT_EQ(2, select(0, 50));
+}
+
+TEST_F(SelectWorkerThreadTest, TiesGoToFewestConnections) {
+    setLoad(0, 100, 5);
+    setLoad(1, 100, 2);
+    setLoad(2, 100, 2);
+    EXPECT_EQ(1, select(0));
+    EXPECT_EQ(1, select(1));
+    EXPECT_EQ(2, select(2));
+}
+
+TEST_F(SelectWorkerThreadTest, TiesGoRoundRobin) {
+    for (int ii = 0; ii < numThreads; ++ii) {
+        setLoad(ii, 0, 0);
+    }
+    EXPECT_EQ(0, select(0));
+    EXPECT_EQ(1, select(1));
+    EXPECT_EQ(2, select(2));
+    // start wraps around
+    EXPECT_EQ(0, select(3));
+}
+
+/**
+ * A connection which doesn't own a real socket and isn't bound to
+ * libevent, sitting idle waiting for its next command.
+ */
+class MockIdleConnection : public McbpConnection {
+public:
+    MockIdleConnection() : McbpConnection() {
+        // Any valid descriptor will do; it's never used
+        setSocketDescriptor(SOCKET(1));
+        // The reference held by the worker thread (see conn_new())
+        incrementRefcount();
+        setState(McbpStateMachine::State::waiting);
+    }
+
+    ~MockIdleConnection() override {
+        setSocketDescriptor(INVALID_SOCKET);
+    }
+};
+
+class ConnectionMigrationTest : public ::testing::Test {
+protected:
+    MockIdleConnection connection;
+};
+
+TEST_F(ConnectionMigrationTest, IdleConnectionIsMigratable) {
+    EXPECT_TRUE(connection.isMigratable());
+    connection.setState(McbpStateMachine::State::read_packet_header);
+    EXPECT_TRUE(connection.isMigratable());
+}
+
+TEST_F(ConnectionMigrationTest, BusyConnectionIsNotMigratable) {
+    connection.setState(McbpStateMachine::State::execute);
+    EXPECT_FALSE(connection.isMigratable());
+}
+
+TEST_F(ConnectionMigrationTest, EwouldblockConnectionIsNotMigratable) {
+    // The engine will notify the connection (on its current thread) when
+    // the operation completes
+    connection.setEwouldblock(true);
+    EXPECT_FALSE(connection.isMigratable());
+    connection.setEwouldblock(false);
+    EXPECT_TRUE(connection.isMigratable());
+}
+
+TEST_F(ConnectionMigrationTest, NotificationQueuedConnectionIsNotMigratable) {
+    // A queued connection is drained by the thread it was queued on
+    ConnectionNotificationQueue queue;
+    EXPECT_TRUE(queue.push(connection));
+    EXPECT_FALSE(connection.isMigratable());
+
+    EXPECT_EQ(1u, queue.drain([](Connection&) {}));
+    EXPECT_TRUE(connection.isMigratable());
+}
+
+TEST_F(ConnectionMigrationTest, ReferencedConnectionIsNotMigratable) {
+    connection.incrementRefcount();
+    EXPECT_FALSE(connection.isMigratable());
+    connection.decrementRefcount();
+    EXPECT_TRUE(connection.isMigratable());
+}
+
+TEST_F(ConnectionMigrationTest, PendingIOConnectionIsNotMigratable) {
+    MockIdleConnection other;
+    connection.setNext(&other);
+    EXPECT_FALSE(connection.isMigratable());
+    connection.setNext(nullptr);
+    EXPECT_TRUE(connection.isMigratable());
+}
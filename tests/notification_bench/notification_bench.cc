@@ -0,0 +1,276 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmark of notify_io_complete() style notifications: many engine
+ * threads notifying connections bound to one worker thread, which wakes up,
+ * collects the notified connections and "runs" them.
+ *
+ * LockedList models the original scheme (the notifier takes the thread
+ * lock, scans the pending_io list and adds the connection, waking the
+ * thread through a socketpair if the list was empty); LockFreeQueue the
+ * current one (a lock-free push onto the thread's NotificationQueue,
+ * waking the thread through an eventfd if the queue was empty).
+ *
+ * Reports the rate at which connections are run (CompletionsPerSec) and
+ * the rate at which the worker is woken up (WakeupsPerSec).
+ */
+
+#include <daemon/notification_queue.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+/// Number of connections each notifying thread cycles through
+static const size_t connectionsPerThread = 64;
+
+struct FakeConnection {
+    NotificationQueueHook<FakeConnection> hook;
+    std::atomic<int> notifiedStatus{0};
+    int status = 0;
+    FakeConnection* next = nullptr;
+};
+
+/**
+ * The channel used to wake the worker: an eventfd or (as for the original
+ * notify pipe) a socketpair with one byte sent per wakeup.
+ */
+class WakeupChannel {
+public:
+    explicit WakeupChannel(bool useEventfd) {
+#ifdef __linux__
+        if (useEventfd) {
+            fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (fds[0] == -1) {
+                throw std::system_error(errno, std::system_category(),
+                                        "WakeupChannel: eventfd");
+            }
+            return;
+        }
+#endif
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+            throw std::system_error(errno, std::system_category(),
+                                    "WakeupChannel: socketpair");
+        }
+    }
+
+    ~WakeupChannel() {
+        close(fds[0]);
+        if (fds[1] != fds[0]) {
+            close(fds[1]);
+        }
+    }
+
+    void wake() {
+        if (isEventfd()) {
+            const uint64_t one = 1;
+            (void)write(fds[1], &one, sizeof(one));
+        } else {
+            (void)send(fds[1], "", 1, 0);
+        }
+    }
+
+    /**
+     * Wait (up to 10ms) to be woken, and consume the wakeup(s).
+     *
+     * @return true if woken
+     */
+    bool wait() {
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        if (poll(&pfd, 1, 10) != 1) {
+            return false;
+        }
+        if (isEventfd()) {
+            uint64_t count;
+            (void)read(fds[0], &count, sizeof(count));
+        } else {
+            char devnull[512];
+            while (recv(fds[0], devnull, sizeof(devnull), MSG_DONTWAIT) ==
+                   sizeof(devnull)) {
+            }
+        }
+        return true;
+    }
+
+private:
+    bool isEventfd() const {
+        return fds[0] == fds[1];
+    }
+
+    int fds[2];
+};
+
+/// The original scheme: a mutex protected list, scanned for duplicates.
+class LockedList {
+public:
+    static const bool useEventfd = false;
+
+    /// @return true if the worker must be woken
+    bool notify(FakeConnection& c, int status) {
+        std::lock_guard<std::mutex> guard(mutex);
+        c.status = status;
+        for (auto* p = pending; p != nullptr; p = p->next) {
+            if (p == &c) {
+                return false;
+            }
+        }
+        const bool wasEmpty = pending == nullptr;
+        c.next = pending;
+        pending = &c;
+        return wasEmpty;
+    }
+
+    /// @return the number of connections run
+    size_t runPending() {
+        std::lock_guard<std::mutex> guard(mutex);
+        size_t count = 0;
+        while (pending != nullptr) {
+            auto* c = pending;
+            pending = c->next;
+            c->next = nullptr;
+            benchmark::DoNotOptimize(c->status);
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    std::mutex mutex;
+    FakeConnection* pending = nullptr;
+};
+
+/// The current scheme: a lock-free queue, drained under the worker's lock.
+class LockFreeQueue {
+public:
+    static const bool useEventfd = true;
+
+    bool notify(FakeConnection& c, int status) {
+        c.notifiedStatus.store(status);
+        return queue.push(c);
+    }
+
+    size_t runPending() {
+        std::lock_guard<std::mutex> guard(mutex);
+        return queue.drain([](FakeConnection& c) {
+            c.status = c.notifiedStatus.load();
+            benchmark::DoNotOptimize(c.status);
+        });
+    }
+
+private:
+    std::mutex mutex;
+    NotificationQueue<FakeConnection, &FakeConnection::hook> queue;
+};
+
+/// A worker thread, running connections as they are notified.
+template <typename Notifier>
+class Worker {
+public:
+    Worker() : channel(Notifier::useEventfd), thread([this] { run(); }) {
+    }
+
+    ~Worker() {
+        stop = true;
+        channel.wake();
+        thread.join();
+    }
+
+    void notify(FakeConnection& c) {
+        if (notifier.notify(c, 0)) {
+            channel.wake();
+        }
+    }
+
+    std::atomic<uint64_t> completions{0};
+    std::atomic<uint64_t> wakeups{0};
+
+private:
+    void run() {
+        while (!stop) {
+            if (channel.wait()) {
+                ++wakeups;
+                completions += notifier.runPending();
+            }
+        }
+    }
+
+    Notifier notifier;
+    WakeupChannel channel;
+    std::atomic<bool> stop{false};
+    std::thread thread;
+};
+
+template <typename Notifier>
+static void BM_Notify(benchmark::State& state) {
+    static std::unique_ptr<Worker<Notifier>> worker;
+    static std::vector<FakeConnection> connections;
+    static std::chrono::steady_clock::time_point start;
+
+    if (state.thread_index == 0) {
+        connections = std::vector<FakeConnection>(state.threads *
+                                                  connectionsPerThread);
+        worker.reset(new Worker<Notifier>());
+        start = std::chrono::steady_clock::now();
+    }
+
+    size_t next = 0;
+    size_t notifications = 0;
+    while (state.KeepRunning()) {
+        worker->notify(connections[state.thread_index * connectionsPerThread +
+                                   next]);
+        next = (next + 1) % connectionsPerThread;
+        ++notifications;
+    }
+    state.SetItemsProcessed(notifications);
+
+    if (state.thread_index == 0) {
+        const double seconds = std::chrono::duration<double>(
+                                       std::chrono::steady_clock::now() -
+                                       start)
+                                       .count();
+        const uint64_t completions = worker->completions;
+        const uint64_t wakeups = worker->wakeups;
+        worker.reset();
+        state.counters["CompletionsPerSec"] =
+                seconds > 0 ? completions / seconds : 0;
+        state.counters["WakeupsPerSec"] = seconds > 0 ? wakeups / seconds : 0;
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Notify, LockedList)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Notify, LockFreeQueue)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,190 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <daemon/notification_queue.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Item {
+    NotificationQueueHook<Item> hook;
+    int id = 0;
+    /// Number of times the consumer has seen the item
+    int drained = 0;
+};
+
+using ItemQueue = NotificationQueue<Item, &Item::hook>;
+
+static std::vector<int> drainIds(ItemQueue& queue) {
+    std::vector<int> ids;
+    queue.drain([&ids](Item& item) {
+        ++item.drained;
+        ids.push_back(item.id);
+    });
+    return ids;
+}
+
+TEST(NotificationQueueTest, Empty) {
+    ItemQueue queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(0u, queue.drain([](Item&) { FAIL(); }));
+}
+
+TEST(NotificationQueueTest, PushReturnsTrueOnlyWhenEmpty) {
+    ItemQueue queue;
+    Item items[3];
+
+    // Only the first push of a batch needs to wake the consumer
+    EXPECT_TRUE(queue.push(items[0]));
+    EXPECT_FALSE(queue.empty());
+    EXPECT_FALSE(queue.push(items[1]));
+    EXPECT_FALSE(queue.push(items[2]));
+
+    EXPECT_EQ(3u, queue.drain([](Item&) {}));
+    EXPECT_TRUE(queue.empty());
+
+    // ... and once drained the next push starts a new batch
+    EXPECT_TRUE(queue.push(items[1]));
+    EXPECT_FALSE(queue.push(items[0]));
+}
+
+TEST(NotificationQueueTest, PushQueuedItemIsIgnored) {
+    ItemQueue queue;
+    Item first;
+    Item second;
+
+    EXPECT_TRUE(queue.push(first));
+    EXPECT_TRUE(first.hook.queued);
+    EXPECT_FALSE(queue.push(second));
+    EXPECT_FALSE(queue.push(first));
+    EXPECT_FALSE(queue.push(second));
+    EXPECT_FALSE(queue.push(first));
+
+    EXPECT_EQ(2u, queue.drain([](Item& item) { ++item.drained; }));
+    EXPECT_EQ(1, first.drained);
+    EXPECT_EQ(1, second.drained);
+    EXPECT_FALSE(first.hook.queued);
+    EXPECT_EQ(nullptr, first.hook.next);
+}
+
+TEST(NotificationQueueTest, DrainIsFIFO) {
+    ItemQueue queue;
+    Item items[5];
+    for (int ii = 0; ii < 5; ++ii) {
+        items[ii].id = ii;
+    }
+
+    for (auto id : {3, 1, 4, 0, 2}) {
+        queue.push(items[id]);
+    }
+    // Re-pushing a queued item doesn't move it
+    queue.push(items[3]);
+    EXPECT_EQ(std::vector<int>({3, 1, 4, 0, 2}), drainIds(queue));
+
+    for (auto id : {2, 0}) {
+        queue.push(items[id]);
+    }
+    EXPECT_EQ(std::vector<int>({2, 0}), drainIds(queue));
+}
+
+TEST(NotificationQueueTest, PushFromCallbackIsQueuedAgain) {
+    // An item notified while the consumer is handling it must not be lost
+    ItemQueue queue;
+    Item item;
+    queue.push(item);
+
+    EXPECT_EQ(1u, queue.drain([&queue](Item& it) {
+        EXPECT_FALSE(it.hook.queued);
+        EXPECT_TRUE(queue.push(it));
+    }));
+    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ(1u, queue.drain([](Item&) {}));
+    EXPECT_TRUE(queue.empty());
+}
+
+/*
+ * Many producers notifying their own items against one consumer. Each
+ * producer waits for the consumer to see its item before notifying it
+ * again, so every notification must be seen exactly once, and the consumer
+ * must be woken (push() returning true) for every batch it drains.
+ */
+TEST(NotificationQueueTest, ConcurrentProducers) {
+    const int numProducers = 8;
+    const int itemsPerProducer = 16;
+    const int rounds = 1000;
+
+    ItemQueue queue;
+    std::vector<Item> items(numProducers * itemsPerProducer);
+    std::vector<std::atomic<int>> seen(items.size());
+    for (size_t ii = 0; ii < items.size(); ++ii) {
+        items[ii].id = int(ii);
+        seen[ii] = 0;
+    }
+
+    std::atomic<int> wakeups{0};
+    std::atomic<int> running{numProducers};
+    std::vector<std::thread> producers;
+    for (int pp = 0; pp < numProducers; ++pp) {
+        producers.emplace_back([&, pp]() {
+            for (int round = 1; round <= rounds; ++round) {
+                for (int ii = 0; ii < itemsPerProducer; ++ii) {
+                    auto& item = items[pp * itemsPerProducer + ii];
+                    if (queue.push(item)) {
+                        ++wakeups;
+                    }
+                }
+                for (int ii = 0; ii < itemsPerProducer; ++ii) {
+                    while (seen[pp * itemsPerProducer + ii].load() < round) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+            --running;
+        });
+    }
+
+    int batches = 0;
+    size_t total = 0;
+    while (running.load() > 0 || !queue.empty()) {
+        const auto count = queue.drain([&seen](Item& item) {
+            ++item.drained;
+            ++seen[item.id];
+        });
+        if (count > 0) {
+            ++batches;
+            total += count;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& thread : producers) {
+        thread.join();
+    }
+
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(items.size() * rounds, total);
+    for (const auto& item : items) {
+        EXPECT_EQ(rounds, item.drained) << item.id;
+        EXPECT_FALSE(item.hook.queued) << item.id;
+    }
+    // Only drain() empties the queue, so each batch drained was started
+    // by exactly one push which found the queue empty
+    EXPECT_EQ(wakeups.load(), batches);
+}
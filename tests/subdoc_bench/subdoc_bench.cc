@@ -0,0 +1,200 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of multi-path subdoc operations on a ~100KB document, with
+ * the paths spread evenly through it.
+ *
+ * Lookups: one subjson operation per path (each parsing the document up to
+ * its match) versus SubdocMultiPathLookup resolving all of the paths in
+ * one pass.
+ *
+ * Mutations: applying each mutation to the result of the previous one
+ * (building a new document every time) versus applying them all to the
+ * original document and merging the results with subdoc_merge_splices().
+ *
+ * Reports the rate at which paths are processed (items/s).
+ */
+
+#include <daemon/subdocument_multipath.h>
+
+#include <benchmark/benchmark.h>
+#include <subdoc/operations.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Number of top level entries in the document (~100 bytes each)
+static const size_t numEntries = 1000;
+
+static const std::string& getDocument() {
+    static std::string doc;
+    if (doc.empty()) {
+        doc = "{";
+        for (size_t ii = 0; ii < numEntries; ++ii) {
+            if (ii > 0) {
+                doc += ",";
+            }
+            const auto id = std::to_string(ii);
+            doc += "\"entry" + id + "\":{\"name\":\"name of entry " + id +
+                   "\",\"value\":" + id +
+                   ",\"tags\":[\"red\",\"green\",\"blue\"],\"enabled\":true}";
+        }
+        doc += "}";
+    }
+    return doc;
+}
+
+static std::vector<std::string> getPaths(size_t count) {
+    std::vector<std::string> paths;
+    for (size_t ii = 0; ii < count; ++ii) {
+        const size_t entry = (ii * numEntries + numEntries / 2) / count;
+        paths.push_back("entry" + std::to_string(entry) + ".value");
+    }
+    return paths;
+}
+
+/*
+ * Variables:
+ *  - range(0) : Number of paths
+ */
+static void BM_LookupPerPath(benchmark::State& state) {
+    const auto& doc = getDocument();
+    const auto paths = getPaths(state.range(0));
+    Subdoc::Operation op;
+    std::vector<Subdoc::Result> results(paths.size());
+
+    while (state.KeepRunning()) {
+        for (size_t ii = 0; ii < paths.size(); ++ii) {
+            op.clear();
+            op.set_result_buf(&results[ii]);
+            op.set_code(Subdoc::Command::GET);
+            op.set_doc(doc.data(), doc.size());
+            if (op.op_exec(paths[ii].data(), paths[ii].size()) !=
+                Subdoc::Error::SUCCESS) {
+                state.SkipWithError("GET failed");
+                return;
+            }
+            benchmark::DoNotOptimize(results[ii].matchloc().at);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+}
+
+static void BM_LookupSinglePass(benchmark::State& state) {
+    const auto& doc = getDocument();
+    const auto paths = getPaths(state.range(0));
+
+    while (state.KeepRunning()) {
+        SubdocMultiPathLookup lookup;
+        for (const auto& path : paths) {
+            lookup.addPath({path.data(), path.size()});
+        }
+        lookup.execute({doc.data(), doc.size()});
+        for (size_t ii = 0; ii < paths.size(); ++ii) {
+            if (lookup.getMatch(ii).buf == nullptr) {
+                state.SkipWithError("lookup failed");
+                return;
+            }
+            benchmark::DoNotOptimize(lookup.getMatch(ii).buf);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+}
+
+static bool replace(Subdoc::Operation& op,
+                    Subdoc::Result& result,
+                    cb::const_char_buffer doc,
+                    const std::string& path) {
+    op.clear();
+    op.set_result_buf(&result);
+    op.set_code(Subdoc::Command::REPLACE);
+    op.set_doc(doc.buf, doc.len);
+    op.set_value("42", 2);
+    return op.op_exec(path.data(), path.size()) == Subdoc::Error::SUCCESS;
+}
+
+static void BM_MutateSequential(benchmark::State& state) {
+    const auto& original = getDocument();
+    const auto paths = getPaths(state.range(0));
+    Subdoc::Operation op;
+    Subdoc::Result result;
+
+    while (state.KeepRunning()) {
+        cb::const_char_buffer doc{original.data(), original.size()};
+        std::unique_ptr<char[]> buffer;
+        for (const auto& path : paths) {
+            if (!replace(op, result, doc, path)) {
+                state.SkipWithError("REPLACE failed");
+                return;
+            }
+
+            size_t len = 0;
+            for (const auto& loc : result.newdoc()) {
+                len += loc.length;
+            }
+            std::unique_ptr<char[]> temp(new char[len + 1]);
+            size_t offset = 0;
+            for (const auto& loc : result.newdoc()) {
+                std::memcpy(temp.get() + offset, loc.at, loc.length);
+                offset += loc.length;
+            }
+            buffer.swap(temp);
+            doc = {buffer.get(), len};
+        }
+        benchmark::DoNotOptimize(doc.buf);
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+}
+
+static void BM_MutateBatched(benchmark::State& state) {
+    const auto& original = getDocument();
+    const cb::const_char_buffer doc{original.data(), original.size()};
+    const auto paths = getPaths(state.range(0));
+    Subdoc::Operation op;
+    std::vector<Subdoc::Result> results(paths.size());
+    std::vector<const Subdoc::Result*> pointers;
+    for (const auto& result : results) {
+        pointers.push_back(&result);
+    }
+
+    while (state.KeepRunning()) {
+        for (size_t ii = 0; ii < paths.size(); ++ii) {
+            if (!replace(op, results[ii], doc, paths[ii])) {
+                state.SkipWithError("REPLACE failed");
+                return;
+            }
+        }
+        std::unique_ptr<char[]> buffer;
+        size_t len;
+        if (!subdoc_merge_splices(doc, pointers, buffer, len)) {
+            state.SkipWithError("merge failed");
+            return;
+        }
+        benchmark::DoNotOptimize(buffer.get());
+    }
+    state.SetItemsProcessed(state.iterations() * paths.size());
+}
+
+BENCHMARK(BM_LookupPerPath)->RangeMultiplier(2)->Range(1, 16);
+BENCHMARK(BM_LookupSinglePass)->RangeMultiplier(2)->Range(1, 16);
+BENCHMARK(BM_MutateSequential)->RangeMultiplier(2)->Range(1, 16);
+BENCHMARK(BM_MutateBatched)->RangeMultiplier(2)->Range(1, 16);
+
+BENCHMARK_MAIN();
@@ -467,6 +467,60 @@ TEST_P(StatsTest, TestTracingStats) {
     EXPECT_NE(nullptr, enabled);
 }
 
+/**
+ * Sum one of the per worker thread counters of "stats threads" (for
+ * example "notifications" sums worker_0:notifications, worker_1:...)
+ */
+static uint64_t sumWorkerThreadStat(MemcachedConnection& conn,
+                                    const std::string& name) {
+    auto stats = conn.stats("threads");
+    const std::string suffix = ":" + name;
+    uint64_t total = 0;
+    for (auto* it = stats.get()->child; it != nullptr; it = it->next) {
+        const std::string key(it->string);
+        if (key.size() > suffix.size() &&
+            key.compare(key.size() - suffix.size(), suffix.size(), suffix) ==
+                    0) {
+            if (it->type == cJSON_Number) {
+                total += uint64_t(it->valuedouble);
+            } else {
+                total += std::stoull(it->valuestring);
+            }
+        }
+    }
+    return total;
+}
+
+/**
+ * An engine completing a blocked operation from one of its own threads
+ * (as the ewouldblock engine does) calls notify_io_complete(), which must
+ * wake the connection's worker thread through its notification eventfd
+ * for the operation to be retried and the response sent.
+ */
+TEST_P(StatsTest, TestThreadsNotifiedFromEngineThread) {
+    MemcachedConnection& conn = getConnection();
+    const auto notifications = sumWorkerThreadStat(conn, "notifications");
+    const auto wakeups = sumWorkerThreadStat(conn, "wakeups");
+
+    // Block the first call to each engine function, and have the engine's
+    // notification thread complete it
+    conn.configureEwouldBlockEngine(EWBEngineMode::First, ENGINE_EWOULDBLOCK);
+
+    Document doc;
+    doc.info.cas = mcbp::cas::Wildcard;
+    doc.info.flags = 0xcaffee;
+    doc.info.id = name;
+    doc.value = "notified";
+    conn.mutate(doc, 0, MutationType::Set);
+    EXPECT_EQ(doc.value, conn.get(name, 0).value);
+
+    conn.disableEwouldBlockEngine();
+
+    // At least one notification (and wakeup) each for the store and get
+    EXPECT_LE(notifications + 2, sumWorkerThreadStat(conn, "notifications"));
+    EXPECT_LE(wakeups + 2, sumWorkerThreadStat(conn, "wakeups"));
+}
+
 /**
  * Subclass of StatsTest which doesn't have a default bucket; hence connections
  * will intially not be associated with any bucket.
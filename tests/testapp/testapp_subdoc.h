@@ -129,6 +129,10 @@ template<typename Tc, typename Tr>
     return subdoc_verify_cmd(cmd, err, value, resp);
 }
 
+/* Encodes and sends a sub-document command, without waiting for any response.
+ */
+void send_subdoc_cmd(const BinprotSubdocCommand& cmd);
+
 uint64_t expect_subdoc_cmd(const SubdocMultiLookupCmd& cmd,
                            protocol_binary_response_status expected_status,
                            const std::vector<SubdocMultiLookupResult>& expected_results);
@@ -608,3 +608,292 @@ TEST_P(McdTestappTest, SubdocMultiMutation_AddDocFlagInavlidCas) {
                               "56"});
     expect_subdoc_cmd(mutation, PROTOCOL_BINARY_RESPONSE_EINVAL, {});
 }
+
+/*
+ * Multi-path lookups and mutations of the document body are done in one go
+ * where possible (falling back to one subjson operation per path). The
+ * following check that the results are byte for byte the same as those of
+ * doing each path with its own single path command.
+ */
+
+/* Sends a single path command, returning its status and value (the value
+ * being empty unless the command succeeded).
+ */
+static SubdocMultiLookupResult subdoc_single_path(
+        const BinprotSubdocCommand& cmd) {
+    send_subdoc_cmd(cmd);
+    std::vector<uint8_t> buf;
+    if (!safe_recv_packet(buf)) {
+        ADD_FAILURE() << "Failed to recv subdoc response";
+        return {PROTOCOL_BINARY_RESPONSE_EINTERNAL, ""};
+    }
+    BinprotSubdocResponse resp;
+    resp.assign(std::move(buf));
+    if (resp.getStatus() != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+        return {resp.getStatus(), ""};
+    }
+    return {resp.getStatus(), resp.getValue()};
+}
+
+/* Check that a multi-lookup of `doc` gives the same results as looking up
+ * each of the paths on its own.
+ */
+static void expect_lookup_as_single_paths(
+        const std::string& doc,
+        const std::vector<SubdocMultiLookupCmd::LookupSpec>& specs) {
+    store_object("dict", doc, /*JSON*/true, /*compress*/false);
+
+    SubdocMultiLookupCmd lookup;
+    lookup.key = "dict";
+    lookup.specs = specs;
+    std::vector<SubdocMultiLookupResult> expected;
+    auto status = PROTOCOL_BINARY_RESPONSE_SUCCESS;
+    for (const auto& spec : specs) {
+        expected.push_back(subdoc_single_path(BinprotSubdocCommand(
+                spec.opcode, "dict", spec.path, "", spec.flags)));
+        if (expected.back().first != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+            status = PROTOCOL_BINARY_RESPONSE_SUBDOC_MULTI_PATH_FAILURE;
+        }
+    }
+    expect_subdoc_cmd(lookup, status, expected);
+
+    delete_object("dict");
+}
+
+/* Check that a multi-mutation of `doc` has the same outcome as applying
+ * each of the paths in turn on their own: the same results and document if
+ * they all succeed, else the same path failing (and the document left as
+ * it was).
+ */
+static void expect_mutation_as_single_paths(
+        const std::string& doc,
+        const std::vector<SubdocMultiMutationCmd::LookupSpec>& specs) {
+    store_object("multi", doc, /*JSON*/true, /*compress*/false);
+    store_object("single", doc, /*JSON*/true, /*compress*/false);
+
+    std::vector<SubdocMultiMutationResult> expected;
+    auto status = PROTOCOL_BINARY_RESPONSE_SUCCESS;
+    for (size_t ii = 0; ii < specs.size(); ++ii) {
+        const auto& spec = specs[ii];
+        const auto result = subdoc_single_path(BinprotSubdocCommand(
+                spec.opcode, "single", spec.path, spec.value, spec.flags));
+        if (result.first != PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+            status = PROTOCOL_BINARY_RESPONSE_SUBDOC_MULTI_PATH_FAILURE;
+            expected = {{uint8_t(ii), result.first}};
+            break;
+        }
+        if (!result.second.empty()) {
+            expected.push_back(
+                    {uint8_t(ii), result.first, result.second});
+        }
+    }
+
+    SubdocMultiMutationCmd mutation;
+    mutation.key = "multi";
+    mutation.specs = specs;
+    expect_subdoc_cmd(mutation, status, expected);
+
+    const auto multi = fetch_value("multi");
+    EXPECT_EQ(PROTOCOL_BINARY_RESPONSE_SUCCESS, multi.first);
+    if (status == PROTOCOL_BINARY_RESPONSE_SUCCESS) {
+        EXPECT_EQ(fetch_value("single").second, multi.second);
+    } else {
+        EXPECT_EQ(doc, multi.second);
+    }
+
+    delete_object("multi");
+    delete_object("single");
+}
+
+TEST_P(McdTestappTest, SubdocMultiLookup_EscapedKeysAsSinglePaths) {
+    const std::string doc =
+            R"({"a.b":1,"a":{"b":2,"[0]":3},"`q`":4,"x\"y":5,)"
+            R"("a[0]":6,"":7,"c":{"d.e":{"f":8}}})";
+    const auto get = PROTOCOL_BINARY_CMD_SUBDOC_GET;
+    const auto exists = PROTOCOL_BINARY_CMD_SUBDOC_EXISTS;
+    expect_lookup_as_single_paths(doc,
+                                  {{get, SUBDOC_FLAG_NONE, "`a.b`"},
+                                   {get, SUBDOC_FLAG_NONE, "a.b"},
+                                   {get, SUBDOC_FLAG_NONE, "a.`[0]`"},
+                                   {get, SUBDOC_FLAG_NONE, "```q```"},
+                                   {get, SUBDOC_FLAG_NONE, "x\\\"y"},
+                                   {get, SUBDOC_FLAG_NONE, "`a[0]`"},
+                                   {get, SUBDOC_FLAG_NONE, "c.`d.e`.f"},
+                                   {exists, SUBDOC_FLAG_NONE, "`a.b`"},
+                                   {get, SUBDOC_FLAG_NONE, "a"}});
+}
+
+TEST_P(McdTestappTest, SubdocMultiLookup_ArrayIndicesAsSinglePaths) {
+    const std::string doc =
+            R"({"arr":[10,[20,21],{"k":30},"s"],"m":[[1,2],[3,4]],)"
+            R"("e":[],"n":{"arr":[true,false]}})";
+    const auto get = PROTOCOL_BINARY_CMD_SUBDOC_GET;
+    const auto exists = PROTOCOL_BINARY_CMD_SUBDOC_EXISTS;
+    expect_lookup_as_single_paths(doc,
+                                  {{get, SUBDOC_FLAG_NONE, "arr[0]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[-1]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[1][-1]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[1][0]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[2].k"},
+                                   {get, SUBDOC_FLAG_NONE, "m[-1][0]"},
+                                   {get, SUBDOC_FLAG_NONE, "m[1]"},
+                                   {get, SUBDOC_FLAG_NONE, "n.arr[-1]"},
+                                   {exists, SUBDOC_FLAG_NONE, "m[0][1]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr"}});
+    expect_lookup_as_single_paths(doc,
+                                  {{get, SUBDOC_FLAG_NONE, "arr[0]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[4]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[-5]"},
+                                   {get, SUBDOC_FLAG_NONE, "e[0]"},
+                                   {get, SUBDOC_FLAG_NONE, "e[-1]"},
+                                   {exists, SUBDOC_FLAG_NONE, "m[2]"},
+                                   {get, SUBDOC_FLAG_NONE, "arr[3]"}});
+}
+
+TEST_P(McdTestappTest, SubdocMultiLookup_MissingPathsAsSinglePaths) {
+    const std::string doc =
+            R"({"a":{"b":[1,2,3],"c":"str"},"d":null,"e":{}})";
+    const auto get = PROTOCOL_BINARY_CMD_SUBDOC_GET;
+    const auto exists = PROTOCOL_BINARY_CMD_SUBDOC_EXISTS;
+    expect_lookup_as_single_paths(doc,
+                                  {{get, SUBDOC_FLAG_NONE, "a.b"},
+                                   {get, SUBDOC_FLAG_NONE, "missing"},
+                                   {get, SUBDOC_FLAG_NONE, "a.c"},
+                                   {exists, SUBDOC_FLAG_NONE, "a.missing"},
+                                   {get, SUBDOC_FLAG_NONE, "a.b[1]"},
+                                   {get, SUBDOC_FLAG_NONE, "a.b[7]"},
+                                   {get, SUBDOC_FLAG_NONE, "a.b.c"},
+                                   {get, SUBDOC_FLAG_NONE, "a.c[0]"},
+                                   {get, SUBDOC_FLAG_NONE, "d"},
+                                   {get, SUBDOC_FLAG_NONE, "d.x"},
+                                   {exists, SUBDOC_FLAG_NONE, "e"},
+                                   {get, SUBDOC_FLAG_NONE, "e.x"},
+                                   {get, SUBDOC_FLAG_NONE, "a"}});
+}
+
+TEST_P(McdTestappTest, SubdocMultiMutation_OverlappingAsSinglePaths) {
+    const std::string doc = R"({"a":{"b":1,"c":[1,2]},"d":2})";
+    const auto replace = PROTOCOL_BINARY_CMD_SUBDOC_REPLACE;
+    const auto upsert = PROTOCOL_BINARY_CMD_SUBDOC_DICT_UPSERT;
+    const auto remove = PROTOCOL_BINARY_CMD_SUBDOC_DELETE;
+    const auto counter = PROTOCOL_BINARY_CMD_SUBDOC_COUNTER;
+
+    // The same path twice
+    expect_mutation_as_single_paths(doc,
+                                    {{replace, SUBDOC_FLAG_NONE, "d", "3"},
+                                     {replace, SUBDOC_FLAG_NONE, "d", "4"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{counter, SUBDOC_FLAG_NONE, "d", "1"},
+                                     {counter, SUBDOC_FLAG_NONE, "d", "1"}});
+    // A path within another one
+    expect_mutation_as_single_paths(doc,
+                                    {{replace, SUBDOC_FLAG_NONE, "a", "{}"},
+                                     {upsert, SUBDOC_FLAG_NONE, "a.b", "5"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{upsert, SUBDOC_FLAG_NONE, "a.b", "5"},
+                                     {replace, SUBDOC_FLAG_NONE, "a", "{}"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{remove, SUBDOC_FLAG_NONE, "a", ""},
+                                     {upsert, SUBDOC_FLAG_NONE, "a.e", "5"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{counter, SUBDOC_FLAG_NONE, "a.b", "7"},
+                                     {remove, SUBDOC_FLAG_NONE, "a", ""}});
+}
+
+TEST_P(McdTestappTest, SubdocMultiMutation_AdjacentAsSinglePaths) {
+    const std::string doc = R"({"x":1,"y":2,"z":{"w":3}})";
+    const auto replace = PROTOCOL_BINARY_CMD_SUBDOC_REPLACE;
+    const auto upsert = PROTOCOL_BINARY_CMD_SUBDOC_DICT_UPSERT;
+    const auto remove = PROTOCOL_BINARY_CMD_SUBDOC_DELETE;
+
+    expect_mutation_as_single_paths(doc,
+                                    {{replace, SUBDOC_FLAG_NONE, "x", "10"},
+                                     {replace, SUBDOC_FLAG_NONE, "y", "20"},
+                                     {replace, SUBDOC_FLAG_NONE, "z.w", "30"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{remove, SUBDOC_FLAG_NONE, "x", ""},
+                                     {remove, SUBDOC_FLAG_NONE, "y", ""}});
+    expect_mutation_as_single_paths(doc,
+                                    {{remove, SUBDOC_FLAG_NONE, "y", ""},
+                                     {remove, SUBDOC_FLAG_NONE, "x", ""},
+                                     {remove, SUBDOC_FLAG_NONE, "z", ""}});
+    expect_mutation_as_single_paths(doc,
+                                    {{remove, SUBDOC_FLAG_NONE, "z", ""},
+                                     {upsert, SUBDOC_FLAG_NONE, "n", "1"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{remove, SUBDOC_FLAG_NONE, "x", ""},
+                                     {replace, SUBDOC_FLAG_NONE, "y", "[]"},
+                                     {upsert, SUBDOC_FLAG_NONE, "z.v", "4"}});
+}
+
+TEST_P(McdTestappTest, SubdocMultiMutation_InsertsAtSameOffsetAsSinglePaths) {
+    const std::string doc = R"({"arr":[1,2],"e":[],"d":{}})";
+    const auto push_last = PROTOCOL_BINARY_CMD_SUBDOC_ARRAY_PUSH_LAST;
+    const auto push_first = PROTOCOL_BINARY_CMD_SUBDOC_ARRAY_PUSH_FIRST;
+    const auto add_unique = PROTOCOL_BINARY_CMD_SUBDOC_ARRAY_ADD_UNIQUE;
+    const auto add = PROTOCOL_BINARY_CMD_SUBDOC_DICT_ADD;
+    const auto upsert = PROTOCOL_BINARY_CMD_SUBDOC_DICT_UPSERT;
+
+    expect_mutation_as_single_paths(doc,
+                                    {{push_last, SUBDOC_FLAG_NONE, "arr", "3"},
+                                     {push_last, SUBDOC_FLAG_NONE, "arr", "4"},
+                                     {push_last, SUBDOC_FLAG_NONE, "arr", "5"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{push_first, SUBDOC_FLAG_NONE, "arr", "0"},
+                                     {push_first, SUBDOC_FLAG_NONE, "arr", "-1"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{push_last, SUBDOC_FLAG_NONE, "e", "1"},
+                                     {push_first, SUBDOC_FLAG_NONE, "e", "2"},
+                                     {push_last, SUBDOC_FLAG_NONE, "e", "3"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{add, SUBDOC_FLAG_NONE, "d.a", "1"},
+                                     {add, SUBDOC_FLAG_NONE, "d.b", "2"},
+                                     {upsert, SUBDOC_FLAG_NONE, "n", "3"},
+                                     {upsert, SUBDOC_FLAG_NONE, "o", "4"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{add, SUBDOC_FLAG_NONE, "d.a", "1"},
+                                     {add, SUBDOC_FLAG_NONE, "d.a", "2"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{add_unique, SUBDOC_FLAG_NONE, "e", "7"},
+                                     {add_unique, SUBDOC_FLAG_NONE, "e", "8"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{add_unique, SUBDOC_FLAG_NONE, "e", "7"},
+                                     {add_unique, SUBDOC_FLAG_NONE, "e", "7"}});
+}
+
+TEST_P(McdTestappTest, SubdocMultiMutation_FallbackAsSinglePaths) {
+    const std::string doc = R"({"arr":[1,2,3],"a":{"b":1},"c":5})";
+    const auto replace = PROTOCOL_BINARY_CMD_SUBDOC_REPLACE;
+    const auto upsert = PROTOCOL_BINARY_CMD_SUBDOC_DICT_UPSERT;
+    const auto remove = PROTOCOL_BINARY_CMD_SUBDOC_DELETE;
+    const auto push_first = PROTOCOL_BINARY_CMD_SUBDOC_ARRAY_PUSH_FIRST;
+    const auto insert = PROTOCOL_BINARY_CMD_SUBDOC_ARRAY_INSERT;
+    const auto counter = PROTOCOL_BINARY_CMD_SUBDOC_COUNTER;
+
+    // Creating parents
+    expect_mutation_as_single_paths(doc,
+                                    {{upsert, SUBDOC_FLAG_MKDIR_P, "p.q.r", "1"},
+                                     {upsert, SUBDOC_FLAG_MKDIR_P, "p.q.s", "2"},
+                                     {replace, SUBDOC_FLAG_NONE, "c", "6"}});
+    // Array indices after the array changes shape
+    expect_mutation_as_single_paths(doc,
+                                    {{push_first, SUBDOC_FLAG_NONE, "arr", "0"},
+                                     {replace, SUBDOC_FLAG_NONE, "arr[0]", "9"},
+                                     {remove, SUBDOC_FLAG_NONE, "arr[-1]", ""}});
+    expect_mutation_as_single_paths(doc,
+                                    {{remove, SUBDOC_FLAG_NONE, "arr[0]", ""},
+                                     {remove, SUBDOC_FLAG_NONE, "arr[0]", ""},
+                                     {counter, SUBDOC_FLAG_NONE, "arr[0]", "1"}});
+    // Operations not done in one go
+    expect_mutation_as_single_paths(doc,
+                                    {{insert, SUBDOC_FLAG_NONE, "arr[1]", "7"},
+                                     {replace, SUBDOC_FLAG_NONE, "c", "6"}});
+    // A failure part way through
+    expect_mutation_as_single_paths(doc,
+                                    {{replace, SUBDOC_FLAG_NONE, "c", "6"},
+                                     {replace, SUBDOC_FLAG_NONE, "missing", "1"},
+                                     {replace, SUBDOC_FLAG_NONE, "a.b", "2"}});
+    expect_mutation_as_single_paths(doc,
+                                    {{counter, SUBDOC_FLAG_NONE, "a.b", "1"},
+                                     {counter, SUBDOC_FLAG_NONE, "arr", "1"}});
+}
@@ -23,7 +23,11 @@
 #include <platform/platform.h>
 #include "basic_engine_testsuite.h"
 
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <thread>
 #include <vector>
 #include <sstream>
 
@@ -539,6 +543,511 @@ static enum test_result lru_test(ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
     return SUCCESS;
 }
 
+static const char* wanted_stat;
+static uint64_t wanted_stat_value;
+static void single_stat_handler(const char* key,
+                                const uint16_t klen,
+                                const char* val,
+                                const uint32_t vlen,
+                                gsl::not_null<const void*>) {
+    if (strlen(wanted_stat) == klen && strncmp(key, wanted_stat, klen) == 0) {
+        wanted_stat_value = strtoull(std::string(val, vlen).c_str(), nullptr, 10);
+    }
+}
+
+static uint64_t get_stat(ENGINE_HANDLE* h,
+                         ENGINE_HANDLE_V1* h1,
+                         const void* cookie,
+                         const char* group,
+                         const char* name) {
+    wanted_stat = name;
+    wanted_stat_value = 0;
+    cb_assert(h1->get_stats(h,
+                            cookie,
+                            {group, strlen(group)},
+                            single_stat_handler) == ENGINE_SUCCESS);
+    return wanted_stat_value;
+}
+
+static std::map<std::string, uint64_t> class_stat_totals;
+static void class_stat_totals_handler(const char* key,
+                                      const uint16_t klen,
+                                      const char* val,
+                                      const uint32_t vlen,
+                                      gsl::not_null<const void*>) {
+    const std::string name(key, klen);
+    const auto colon = name.rfind(':');
+    if (colon != std::string::npos) {
+        class_stat_totals[name.substr(colon + 1)] +=
+                strtoull(std::string(val, vlen).c_str(), nullptr, 10);
+    }
+}
+
+/*
+ * Get the per slab class stats of a group (such as "items:<class>:number"),
+ * each summed over all of the classes.
+ */
+static std::map<std::string, uint64_t> get_class_stat_totals(
+        ENGINE_HANDLE* h,
+        ENGINE_HANDLE_V1* h1,
+        const void* cookie,
+        const char* group) {
+    class_stat_totals.clear();
+    cb_assert(h1->get_stats(h,
+                            cookie,
+                            {group, strlen(group)},
+                            class_stat_totals_handler) == ENGINE_SUCCESS);
+    return class_stat_totals;
+}
+
+static DocKey lru_key(uint8_t* buffer, size_t size, const char* prefix,
+                      int ii) {
+    return DocKey(buffer,
+                  snprintf(reinterpret_cast<char*>(buffer), size, "%s_%08d",
+                           prefix, ii),
+                  test_harness.doc_namespace);
+}
+
+static void lru_store(ENGINE_HANDLE* h, ENGINE_HANDLE_V1* h1,
+                      const void* cookie, const char* prefix, int ii,
+                      size_t size) {
+    uint8_t buffer[64];
+    uint64_t cas = 0;
+    auto ret = h1->allocate(h, cookie,
+                            lru_key(buffer, sizeof(buffer), prefix, ii),
+                            size, 0, 0, PROTOCOL_BINARY_RAW_BYTES, 0);
+    cb_assert(ret.first == cb::engine_errc::success);
+    cb_assert(h1->store(h, cookie, ret.second.get(), cas, OPERATION_SET,
+                        DocumentState::Alive) == ENGINE_SUCCESS);
+}
+
+/* Look up (and so bump) an item, returning true if it was found */
+static bool lru_get(ENGINE_HANDLE* h, ENGINE_HANDLE_V1* h1,
+                    const void* cookie, const char* prefix, int ii) {
+    uint8_t buffer[64];
+    auto ret = h1->get(h, cookie, lru_key(buffer, sizeof(buffer), prefix, ii),
+                       0, DocStateFilter::Alive);
+    return ret.first == cb::engine_errc::success;
+}
+
+/*
+ * Wait for the LRU maintainer (which runs in the background) to bring the
+ * "items" stats to a state accepted by `done`, and return them.
+ */
+static std::map<std::string, uint64_t> wait_for_lru(
+        ENGINE_HANDLE* h,
+        ENGINE_HANDLE_V1* h1,
+        const void* cookie,
+        std::function<bool(std::map<std::string, uint64_t>&)> done) {
+    for (int ii = 0;; ++ii) {
+        auto stats = get_class_stat_totals(h, h1, cookie, "items");
+        if (done(stats)) {
+            return stats;
+        }
+        cb_assert(ii < 10000);
+        usleep(1000);
+    }
+}
+
+/* The HOT segment has been cut down to its share of the LRU */
+static bool lru_hot_trimmed(std::map<std::string, uint64_t>& stats) {
+    return stats["number_hot"] <= stats["number"] / 5;
+}
+
+static void check_lru_segments(ENGINE_HANDLE* h, ENGINE_HANDLE_V1* h1,
+                               const void* cookie,
+                               std::map<std::string, uint64_t>& stats) {
+    assert_equal(stats["number"],
+                 stats["number_hot"] + stats["number_warm"] +
+                 stats["number_cold"]);
+    assert_equal(get_stat(h, h1, cookie, "", "curr_items"), stats["number"]);
+}
+
+/*
+ * New items go to HOT, from where the LRU maintainer moves the ones which
+ * aren't accessed to COLD. Items accessed once in COLD are promoted to WARM.
+ * Check that the items and stats of each segment add up along the way.
+ */
+static enum test_result lru_segments_test(ENGINE_HANDLE *h,
+                                          ENGINE_HANDLE_V1 *h1) {
+    const int num_keys = 1000;
+    const int bumped = 100;
+    const auto* cookie = test_harness.create_cookie();
+
+    for (int ii = 0; ii < num_keys; ++ii) {
+        lru_store(h, h1, cookie, "lru", ii, 100);
+    }
+    auto stats = get_class_stat_totals(h, h1, cookie, "items");
+    check_lru_segments(h, h1, cookie, stats);
+    assert_equal(uint64_t(num_keys), stats["number"]);
+
+    /* Nothing has been accessed, so all goes from HOT to COLD */
+    stats = wait_for_lru(h, h1, cookie, lru_hot_trimmed);
+    check_lru_segments(h, h1, cookie, stats);
+    assert_equal(uint64_t(0), stats["number_warm"]);
+    assert_equal(uint64_t(num_keys) - stats["number_hot"],
+                 stats["number_cold"]);
+    assert_equal(stats["number_cold"], stats["moves_to_cold"]);
+    assert_equal(uint64_t(0), stats["moves_to_warm"]);
+
+    /* The oldest items are at the tail of COLD; bump them into WARM */
+    for (int ii = 0; ii < bumped; ++ii) {
+        cb_assert(lru_get(h, h1, cookie, "lru", ii));
+    }
+    stats = wait_for_lru(h, h1, cookie,
+                         [](std::map<std::string, uint64_t>& items) {
+                             return items["number_warm"] == uint64_t(bumped);
+                         });
+    check_lru_segments(h, h1, cookie, stats);
+    assert_equal(uint64_t(bumped), stats["moves_to_warm"]);
+    assert_equal(uint64_t(num_keys - bumped) - stats["number_hot"],
+                 stats["number_cold"]);
+
+    /* Deleting an item takes it out of its segment (WARM), and links the
+     * deleted item in its place at the head of HOT */
+    uint8_t buffer[64];
+    uint64_t cas = 0;
+    mutation_descr_t mut_info;
+    cb_assert(h1->remove(h, cookie, lru_key(buffer, sizeof(buffer), "lru", 0),
+                         cas, 0, mut_info) == ENGINE_SUCCESS);
+    stats = get_class_stat_totals(h, h1, cookie, "items");
+    check_lru_segments(h, h1, cookie, stats);
+    assert_equal(uint64_t(num_keys), stats["number"]);
+    assert_equal(uint64_t(bumped - 1), stats["number_warm"]);
+
+    test_harness.destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/* Slab pages (of item_size_max) in the cache of lru_eviction_test */
+static const uint64_t lru_eviction_test_pages = 4;
+
+/*
+ * Fill three quarters of the cache and promote the oldest items to WARM,
+ * then keep storing until items have to be evicted. The items evicted must
+ * be the oldest ones left in COLD, and not the ones in WARM or HOT.
+ */
+static enum test_result lru_eviction_test(ENGINE_HANDLE *h,
+                                          ENGINE_HANDLE_V1 *h1) {
+    const size_t value_size = 4000;
+    const auto* cookie = test_harness.create_cookie();
+
+    lru_store(h, h1, cookie, "lru", 0, value_size);
+    const uint64_t capacity =
+            lru_eviction_test_pages *
+            get_class_stat_totals(h, h1, cookie, "slabs")["chunks_per_page"];
+    const int num_keys = int(capacity * 3 / 4);
+    const int bumped = num_keys / 10;
+    const int num_evictions = num_keys / 4;
+
+    for (int ii = 1; ii < num_keys; ++ii) {
+        lru_store(h, h1, cookie, "lru", ii, value_size);
+    }
+    assert_equal(uint64_t(0), get_stat(h, h1, cookie, "", "evictions"));
+    wait_for_lru(h, h1, cookie, lru_hot_trimmed);
+
+    for (int ii = 0; ii < bumped; ++ii) {
+        cb_assert(lru_get(h, h1, cookie, "lru", ii));
+    }
+    wait_for_lru(h, h1, cookie,
+                 [bumped](std::map<std::string, uint64_t>& items) {
+                     return items["number_warm"] == uint64_t(bumped);
+                 });
+
+    int new_keys = 0;
+    while (get_stat(h, h1, cookie, "", "evictions") < uint64_t(num_evictions)) {
+        cb_assert(uint64_t(new_keys) < capacity);
+        lru_store(h, h1, cookie, "new", new_keys++, value_size);
+    }
+    assert_equal(uint64_t(num_evictions),
+                 get_stat(h, h1, cookie, "", "evictions"));
+
+    for (int ii = 0; ii < num_keys; ++ii) {
+        const bool evicted = ii >= bumped && ii < bumped + num_evictions;
+        assert_equal(!evicted, lru_get(h, h1, cookie, "lru", ii));
+    }
+    for (int ii = 0; ii < new_keys; ++ii) {
+        cb_assert(lru_get(h, h1, cookie, "new", ii));
+    }
+
+    test_harness.destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/*
+ * Fill the cache with small items, then switch to a working set of large
+ * items which doesn't fit in the single slab page their class can get.
+ * The slab rebalancer should move pages from the small items' class (which
+ * no longer evicts) to the large items' one, until the working set fits.
+ */
+static enum test_result slab_rebalance_test(ENGINE_HANDLE *h,
+                                            ENGINE_HANDLE_V1 *h1) {
+    const int small_size = 100;
+    const int large_size = 100 * 1024;
+    const int working_set = 30;
+    const auto* cookie = test_harness.create_cookie();
+    uint64_t cas = 0;
+    uint8_t key[64];
+
+    for (int ii = 0; get_stat(h, h1, cookie, "", "evictions") == 0; ++ii) {
+        cb_assert(ii < 1000000);
+        for (int jj = 0; jj < 1000; ++jj) {
+            DocKey small_key(key,
+                             snprintf(reinterpret_cast<char*>(key),
+                                      sizeof(key), "small_%08d",
+                                      ii * 1000 + jj),
+                             test_harness.doc_namespace);
+            auto ret = h1->allocate(h, cookie, small_key, small_size, 0, 0,
+                                    PROTOCOL_BINARY_RAW_BYTES, 0);
+            cb_assert(ret.first == cb::engine_errc::success);
+            cb_assert(h1->store(h, cookie, ret.second.get(), cas,
+                                OPERATION_SET,
+                                DocumentState::Alive) == ENGINE_SUCCESS);
+        }
+    }
+
+    int first_hits = -1;
+    int hits = 0;
+    for (int round = 0; round < 100 && hits < working_set; ++round) {
+        hits = 0;
+        for (int ii = 0; ii < working_set; ++ii) {
+            DocKey large_key(key,
+                             snprintf(reinterpret_cast<char*>(key),
+                                      sizeof(key), "large_%08d", ii),
+                             test_harness.doc_namespace);
+            auto ret = h1->get(h, cookie, large_key, 0, DocStateFilter::Alive);
+            if (ret.first == cb::engine_errc::success) {
+                ++hits;
+                continue;
+            }
+            ret = h1->allocate(h, cookie, large_key, large_size, 0, 0,
+                               PROTOCOL_BINARY_RAW_BYTES, 0);
+            cb_assert(ret.first == cb::engine_errc::success);
+            cb_assert(h1->store(h, cookie, ret.second.get(), cas,
+                                OPERATION_SET,
+                                DocumentState::Alive) == ENGINE_SUCCESS);
+        }
+        if (first_hits == -1 && round > 0) {
+            first_hits = hits;
+        }
+
+        /* Start a new rebalancer window, and give the maintainer time to
+         * run in it */
+        test_harness.time_travel(11);
+        usleep(250000);
+    }
+
+    /* The working set didn't fit to begin with, but does in the end */
+    assert_equal(0, first_hits);
+    assert_equal(working_set, hits);
+    assert_ge(get_stat(h, h1, cookie, "slabs", "slab_reassign_pages_moved"),
+              uint64_t(1));
+    assert_ge(get_stat(h, h1, cookie, "slabs", "slab_reassign_evictions"),
+              uint64_t(1));
+
+    test_harness.destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+static uint64_t expansion_test_value(int worker, int key) {
+    return (uint64_t(worker) << 32) | uint32_t(key);
+}
+
+static DocKey expansion_test_key(uint8_t* buffer, size_t size,
+                                 int worker, int key) {
+    return DocKey(buffer,
+                  snprintf(reinterpret_cast<char*>(buffer), size,
+                           "expand_%d_%08d", worker, key),
+                  test_harness.doc_namespace);
+}
+
+static void expansion_test_store(ENGINE_HANDLE* h, ENGINE_HANDLE_V1* h1,
+                                 const void* cookie, int worker, int key) {
+    uint8_t buffer[64];
+    uint64_t cas = 0;
+    const uint64_t value = expansion_test_value(worker, key);
+    auto ret = h1->allocate(h, cookie,
+                            expansion_test_key(buffer, sizeof(buffer),
+                                               worker, key),
+                            sizeof(value), 0, 0,
+                            PROTOCOL_BINARY_RAW_BYTES, 0);
+    cb_assert(ret.first == cb::engine_errc::success);
+    item_info info;
+    cb_assert(h1->get_item_info(h, ret.second.get(), &info));
+    memcpy(info.value[0].iov_base, &value, sizeof(value));
+    cb_assert(h1->store(h, cookie, ret.second.get(), cas, OPERATION_SET,
+                        DocumentState::Alive) == ENGINE_SUCCESS);
+}
+
+/*
+ * Look up (and optionally touch) a key, checking that the item found is
+ * the one stored for it.
+ *
+ * @return true if the key was found
+ */
+static bool expansion_test_check(ENGINE_HANDLE* h, ENGINE_HANDLE_V1* h1,
+                                 const void* cookie, int worker, int key,
+                                 bool touch) {
+    uint8_t buffer[64];
+    const DocKey dockey = expansion_test_key(buffer, sizeof(buffer),
+                                             worker, key);
+    auto ret = touch ? h1->get_and_touch(h, cookie, dockey, 0, 0)
+                     : h1->get(h, cookie, dockey, 0, DocStateFilter::Alive);
+    if (ret.first == cb::engine_errc::no_such_key) {
+        cb_assert(ret.second == nullptr);
+        return false;
+    }
+    cb_assert(ret.first == cb::engine_errc::success);
+    item_info info;
+    cb_assert(h1->get_item_info(h, ret.second.get(), &info));
+    cb_assert(info.value[0].iov_len == sizeof(uint64_t));
+    uint64_t value;
+    memcpy(&value, info.value[0].iov_base, sizeof(value));
+    assert_equal(expansion_test_value(worker, key), value);
+    return true;
+}
+
+static bool expansion_test_remove(ENGINE_HANDLE* h, ENGINE_HANDLE_V1* h1,
+                                  const void* cookie, int worker, int key) {
+    uint8_t buffer[64];
+    uint64_t cas = 0;
+    mutation_descr_t mut_info;
+    const auto ret = h1->remove(h, cookie,
+                                expansion_test_key(buffer, sizeof(buffer),
+                                                   worker, key),
+                                cas, 0, mut_info);
+    cb_assert(ret == ENGINE_SUCCESS || ret == ENGINE_KEY_ENOENT);
+    return ret == ENGINE_SUCCESS;
+}
+
+/*
+ * Run get/store/delete/touch (and then flush) from several threads at once
+ * against a bucket holding enough items to make the hash table grow, so
+ * that the operations race with the table being expanded.
+ * Every item found must be the one stored for its key, the item count must
+ * match the keys stored, and once the bucket is flushed all of the items
+ * must have been freed (none is left referenced).
+ */
+static enum test_result concurrent_expansion_test(ENGINE_HANDLE *h,
+                                                  ENGINE_HANDLE_V1 *h1) {
+    const int num_workers = 4;
+    const auto* cookie = test_harness.create_cookie();
+    const uint64_t hashpower = get_stat(h, h1, cookie, "", "hash_power_level");
+    /* The table grows at 1.5 items per bucket; with a fifth of the keys
+     * deleted this is comfortably past it */
+    const int num_keys = int((uint64_t(3) << hashpower) / num_workers);
+
+    test_harness.time_travel(3);
+
+    /* Each worker owns its keys, so knows which ones should be there */
+    std::vector<std::vector<bool>> stored(num_workers,
+                                          std::vector<bool>(num_keys));
+    std::vector<const void*> cookies(num_workers);
+    for (auto& c : cookies) {
+        c = test_harness.create_cookie();
+    }
+
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < num_workers; ++worker) {
+        workers.emplace_back([&, worker]() {
+            auto& mine = stored[worker];
+            for (int ii = 0; ii < num_keys; ++ii) {
+                expansion_test_store(h, h1, cookies[worker], worker, ii);
+                mine[ii] = true;
+                /* Older keys are the ones being moved to the new table */
+                const int old = ii / 2;
+                cb_assert(expansion_test_check(h, h1, cookies[worker], worker,
+                                               old, ii % 3 == 0) == mine[old]);
+                if (ii % 5 == 0) {
+                    const int victim = ii / 3;
+                    cb_assert(expansion_test_remove(h, h1, cookies[worker],
+                                                    worker, victim) ==
+                              mine[victim]);
+                    mine[victim] = false;
+                }
+            }
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    workers.clear();
+
+    assert_ge(get_stat(h, h1, cookie, "", "hash_power_level"), hashpower + 1);
+    assert_equal(uint64_t(0), get_stat(h, h1, cookie, "", "evictions"));
+
+    for (int worker = 0; worker < num_workers; ++worker) {
+        for (int ii = 0; ii < num_keys; ++ii) {
+            assert_equal(bool(stored[worker][ii]),
+                         expansion_test_check(h, h1, cookie, worker, ii,
+                                              false));
+        }
+    }
+    /* Deleted keys keep their (deleted) item, so there is one per key */
+    assert_equal(uint64_t(num_workers) * num_keys,
+                 get_stat(h, h1, cookie, "", "curr_items"));
+
+    /* Again, with the bucket being flushed underneath the workers */
+    std::atomic<bool> running{true};
+    std::thread flusher([&]() {
+        const auto* flush_cookie = test_harness.create_cookie();
+        while (running) {
+            cb_assert(h1->flush(h, flush_cookie) == ENGINE_SUCCESS);
+            usleep(1000);
+        }
+        test_harness.destroy_cookie(flush_cookie);
+    });
+    for (int worker = 0; worker < num_workers; ++worker) {
+        workers.emplace_back([&, worker]() {
+            for (int ii = 0; ii < num_keys; ++ii) {
+                expansion_test_store(h, h1, cookies[worker], worker, ii);
+                expansion_test_check(h, h1, cookies[worker], worker, ii / 2,
+                                     ii % 3 == 0);
+                if (ii % 5 == 0) {
+                    expansion_test_remove(h, h1, cookies[worker], worker,
+                                          ii / 3);
+                }
+            }
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    running = false;
+    flusher.join();
+
+    /* Flush everything, and look up every key to drop any items the flush
+     * left to be expired lazily; with no references left, every item must
+     * go back to the slabs */
+    test_harness.time_travel(3);
+    cb_assert(h1->flush(h, cookie) == ENGINE_SUCCESS);
+    for (int worker = 0; worker < num_workers; ++worker) {
+        for (int ii = 0; ii < num_keys; ++ii) {
+            uint8_t buffer[64];
+            auto ret = h1->get(h, cookie,
+                               expansion_test_key(buffer, sizeof(buffer),
+                                                  worker, ii),
+                               0, DocStateFilter::AliveOrDeleted);
+            cb_assert(ret.first == cb::engine_errc::no_such_key);
+        }
+    }
+    assert_equal(uint64_t(0), get_stat(h, h1, cookie, "", "curr_items"));
+    assert_equal(uint64_t(0),
+                 get_class_stat_totals(h, h1, cookie, "slabs")["used_chunks"]);
+
+    for (int ii = 0; get_stat(h, h1, cookie, "", "hash_is_expanding") != 0;
+         ++ii) {
+        cb_assert(ii < 10000);
+        usleep(1000);
+    }
+
+    for (auto& c : cookies) {
+        test_harness.destroy_cookie(c);
+    }
+    test_harness.destroy_cookie(cookie);
+    return SUCCESS;
+}
+
 static enum test_result get_stats_test(ENGINE_HANDLE *h, ENGINE_HANDLE_V1 *h1) {
     return PENDING;
 }
@@ -693,9 +1202,18 @@ engine_test_t* get_tests(void) {
         TEST_CASE("flush test", flush_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("get item info test", get_item_info_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("set cas test", item_set_cas_test, NULL, NULL, NULL, NULL, NULL),
+        TEST_CASE("LRU segments test", lru_segments_test, NULL, NULL, NULL, NULL, NULL),
 #ifndef VALGRIND
         // this test is disabled for VALGRIND because cache_size=48 and using malloc don't work.
         TEST_CASE("LRU test", lru_test, NULL, NULL, "cache_size=48", NULL, NULL),
+        TEST_CASE("LRU eviction test", lru_eviction_test, NULL, NULL,
+                  "cache_size=4194304;slab_automove=0", NULL, NULL),
+        // as is this one, as there are no slab pages to move when using malloc.
+        TEST_CASE("slab rebalance test", slab_rebalance_test, NULL, NULL,
+                  "cache_size=8388608;slab_automove=2", NULL, NULL),
+        // and this one stores too many items to be run under valgrind
+        TEST_CASE("concurrent hash expansion test", concurrent_expansion_test,
+                  NULL, NULL, "cache_size=268435456", NULL, NULL),
 #endif
         TEST_CASE("get stats test", get_stats_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("reset stats test", reset_stats_test, NULL, NULL, NULL, NULL, NULL),
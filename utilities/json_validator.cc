@@ -0,0 +1,483 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "json_validator.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JSON_VALIDATOR_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// AVX2 code is compiled (with the target attribute) alongside the baseline
+// code and only called if the CPU supports it
+#define JSON_VALIDATOR_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace cb {
+namespace json {
+
+/*
+ * A string scanner returns the first byte from p which needs looking at
+ * within a string: a quote, a backslash, a control character or a non-ASCII
+ * byte (or end, if there is none).
+ */
+typedef const uint8_t* (*StringScanner)(const uint8_t* p, const uint8_t* end);
+
+static bool isSpecialStringByte(uint8_t c) {
+    return c == '"' || c == '\\' || c < 0x20 || c >= 0x80;
+}
+
+static const uint8_t* scanStringScalar(const uint8_t* p, const uint8_t* end) {
+    while (p < end && !isSpecialStringByte(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef JSON_VALIDATOR_SSE2
+static unsigned int countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static const uint8_t* scanStringSSE2(const uint8_t* p, const uint8_t* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    // As signed bytes, both control characters and non-ASCII bytes are less
+    // than a space
+    const __m128i space = _mm_set1_epi8(0x20);
+
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i special =
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                          _mm_cmpeq_epi8(v, backslash)),
+                             _mm_cmplt_epi8(v, space));
+        const uint32_t mask = uint32_t(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            return p + countTrailingZeros(mask);
+        }
+        p += 16;
+    }
+    return scanStringScalar(p, end);
+}
+#endif
+
+#ifdef JSON_VALIDATOR_AVX2
+__attribute__((target("avx2"))) static const uint8_t* scanStringAVX2(
+        const uint8_t* p, const uint8_t* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i space = _mm256_set1_epi8(0x20);
+
+    while (end - p >= 32) {
+        const __m256i v =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i special = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                _mm256_cmpeq_epi8(v, backslash)),
+                _mm256_cmpgt_epi8(space, v));
+        const uint32_t mask = uint32_t(_mm256_movemask_epi8(special));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return scanStringScalar(p, end);
+}
+#endif
+
+static const uint8_t* skipWhitespace(const uint8_t* p, const uint8_t* end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+static bool isDigit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool isHexDigit(uint8_t c) {
+    return isDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+/**
+ * Skip the (multi-byte) UTF-8 encoded character at p, rejecting overlong
+ * encodings, surrogates and code points beyond U+10FFFF.
+ *
+ * @return the position after the character, or nullptr if invalid
+ */
+static const uint8_t* skipUtf8(const uint8_t* p, const uint8_t* end) {
+    const uint8_t c = *p;
+    size_t continuations;
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        continuations = 1;
+    } else if (c >= 0xe0 && c <= 0xef) {
+        continuations = 2;
+        if (c == 0xe0) {
+            low = 0xa0;
+        } else if (c == 0xed) {
+            high = 0x9f;
+        }
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        continuations = 3;
+        if (c == 0xf0) {
+            low = 0x90;
+        } else if (c == 0xf4) {
+            high = 0x8f;
+        }
+    } else {
+        return nullptr;
+    }
+
+    if (size_t(end - p) <= continuations || p[1] < low || p[1] > high) {
+        return nullptr;
+    }
+    for (size_t ii = 2; ii <= continuations; ++ii) {
+        if ((p[ii] & 0xc0) != 0x80) {
+            return nullptr;
+        }
+    }
+    return p + continuations + 1;
+}
+
+/**
+ * Skip the rest of the string whose opening quote precedes p.
+ *
+ * @return the position after the closing quote, or nullptr if invalid
+ */
+template <StringScanner scan>
+static const uint8_t* skipString(const uint8_t* p, const uint8_t* end) {
+    for (;;) {
+        p = scan(p, end);
+        if (p == end) {
+            return nullptr;
+        }
+
+        switch (*p) {
+        case '"':
+            return p + 1;
+        case '\\':
+            if (end - p < 2) {
+                return nullptr;
+            }
+            switch (p[1]) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                p += 2;
+                break;
+            case 'u':
+                if (end - p < 6 || !isHexDigit(p[2]) || !isHexDigit(p[3]) ||
+                    !isHexDigit(p[4]) || !isHexDigit(p[5])) {
+                    return nullptr;
+                }
+                p += 6;
+                break;
+            default:
+                return nullptr;
+            }
+            break;
+        default:
+            if (*p < 0x80) {
+                // Control characters must be escaped
+                return nullptr;
+            }
+            // Non-ASCII characters tend to come together; rather than going
+            // back to the vector scan after each one, go a byte at a time
+            // until the text has been plain ASCII for a while.
+            size_t ascii = 0;
+            while (p < end && ascii < 16) {
+                if (*p >= 0x80) {
+                    p = skipUtf8(p, end);
+                    if (p == nullptr) {
+                        return nullptr;
+                    }
+                    ascii = 0;
+                } else if (isSpecialStringByte(*p)) {
+                    break;
+                } else {
+                    ++p;
+                    ++ascii;
+                }
+            }
+        }
+    }
+}
+
+static const uint8_t* skipDigits(const uint8_t* p, const uint8_t* end) {
+    const uint8_t* start = p;
+    while (p < end && isDigit(*p)) {
+        ++p;
+    }
+    return p == start ? nullptr : p;
+}
+
+static const uint8_t* skipNumber(const uint8_t* p, const uint8_t* end) {
+    if (*p == '-') {
+        ++p;
+    }
+    if (p < end && *p == '0') {
+        ++p;
+    } else {
+        p = skipDigits(p, end);
+        if (p == nullptr) {
+            return nullptr;
+        }
+    }
+    if (p < end && *p == '.') {
+        p = skipDigits(p + 1, end);
+        if (p == nullptr) {
+            return nullptr;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p < end && (*p == '+' || *p == '-')) {
+            ++p;
+        }
+        p = skipDigits(p, end);
+    }
+    return p;
+}
+
+static const uint8_t* skipLiteral(const uint8_t* p,
+                                  const uint8_t* end,
+                                  const char* literal,
+                                  size_t length) {
+    if (size_t(end - p) < length || std::memcmp(p, literal, length) != 0) {
+        return nullptr;
+    }
+    return p + length;
+}
+
+/**
+ * Skip the key (and the colon after it) of an object member starting at p.
+ *
+ * @return the position after the colon, or nullptr if invalid
+ */
+template <StringScanner scan>
+static const uint8_t* skipKey(const uint8_t* p, const uint8_t* end) {
+    p = skipWhitespace(p, end);
+    if (p == end || *p != '"') {
+        return nullptr;
+    }
+    p = skipString<scan>(p + 1, end);
+    if (p == nullptr) {
+        return nullptr;
+    }
+    p = skipWhitespace(p, end);
+    if (p == end || *p != ':') {
+        return nullptr;
+    }
+    return p + 1;
+}
+
+template <StringScanner scan>
+static bool validate(const uint8_t* p, const uint8_t* end) {
+    // One bit per level of nesting; set for an object, clear for an array
+    uint64_t objects[maxDepth / 64] = {};
+    size_t depth = 0;
+
+    p = skipWhitespace(p, end);
+    if (p == end || (*p != '{' && *p != '[')) {
+        return false;
+    }
+
+    for (;;) {
+        // A value is expected at p
+        p = skipWhitespace(p, end);
+        if (p == end) {
+            return false;
+        }
+
+        switch (*p) {
+        case '{':
+        case '[': {
+            const bool object = *p == '{';
+            // Even an empty container counts towards the depth
+            if (depth == maxDepth) {
+                return false;
+            }
+            p = skipWhitespace(p + 1, end);
+            if (p < end && *p == (object ? '}' : ']')) {
+                ++p;
+                break;
+            }
+            const uint64_t bit = uint64_t(1) << (depth % 64);
+            if (object) {
+                objects[depth / 64] |= bit;
+            } else {
+                objects[depth / 64] &= ~bit;
+            }
+            ++depth;
+            if (object) {
+                p = skipKey<scan>(p, end);
+                if (p == nullptr) {
+                    return false;
+                }
+            }
+            // Carry on with the first value in the container
+            continue;
+        }
+        case '"':
+            p = skipString<scan>(p + 1, end);
+            break;
+        case 't':
+            p = skipLiteral(p, end, "true", 4);
+            break;
+        case 'f':
+            p = skipLiteral(p, end, "false", 5);
+            break;
+        case 'n':
+            p = skipLiteral(p, end, "null", 4);
+            break;
+        default:
+            if (*p != '-' && !isDigit(*p)) {
+                return false;
+            }
+            p = skipNumber(p, end);
+        }
+
+        if (p == nullptr) {
+            return false;
+        }
+
+        // Done with a value; close containers until the next one
+        for (;;) {
+            p = skipWhitespace(p, end);
+            if (depth == 0) {
+                return p == end;
+            }
+            if (p == end) {
+                return false;
+            }
+
+            const bool object =
+                    (objects[(depth - 1) / 64] >> ((depth - 1) % 64)) & 1;
+            if (*p == ',') {
+                ++p;
+                if (object) {
+                    p = skipKey<scan>(p, end);
+                    if (p == nullptr) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            if (*p != (object ? '}' : ']')) {
+                return false;
+            }
+            ++p;
+            --depth;
+        }
+    }
+}
+
+typedef bool (*Validator)(const uint8_t* p, const uint8_t* end);
+
+static Validator getValidator(Implementation implementation) {
+    switch (implementation) {
+    case Implementation::Scalar:
+        return validate<scanStringScalar>;
+    case Implementation::SSE2:
+#ifdef JSON_VALIDATOR_SSE2
+        return validate<scanStringSSE2>;
+#else
+        return nullptr;
+#endif
+    case Implementation::AVX2:
+#ifdef JSON_VALIDATOR_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return validate<scanStringAVX2>;
+        }
+#endif
+        return nullptr;
+    }
+    return nullptr;
+}
+
+static Implementation selectImplementation() {
+    for (auto implementation : {Implementation::AVX2, Implementation::SSE2}) {
+        if (getValidator(implementation) != nullptr) {
+            return implementation;
+        }
+    }
+    return Implementation::Scalar;
+}
+
+const char* to_string(Implementation implementation) {
+    switch (implementation) {
+    case Implementation::Scalar:
+        return "Scalar";
+    case Implementation::SSE2:
+        return "SSE2";
+    case Implementation::AVX2:
+        return "AVX2";
+    }
+    return "Unknown";
+}
+
+bool isSupported(Implementation implementation) {
+    return getValidator(implementation) != nullptr;
+}
+
+Implementation getImplementation() {
+    static const Implementation implementation = selectImplementation();
+    return implementation;
+}
+
+bool isObjectOrArray(const uint8_t* data, size_t size) {
+    static const Validator validator = getValidator(getImplementation());
+    return validator(data, data + size);
+}
+
+bool isObjectOrArray(const uint8_t* data,
+                     size_t size,
+                     Implementation implementation) {
+    auto validator = getValidator(implementation);
+    if (validator == nullptr) {
+        throw std::invalid_argument(
+                std::string("cb::json::isObjectOrArray: ") +
+                to_string(implementation) + " is not supported");
+    }
+    return validator(data, data + size);
+}
+
+} // namespace json
+} // namespace cb
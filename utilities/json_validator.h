@@ -0,0 +1,77 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/visibility.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A fast check of whether a value is a JSON document, for datatype
+ * detection on the write path.
+ *
+ * Strings (where documents spend most of their bytes) are scanned 16 or 32
+ * bytes at a time with SSE2 or AVX2, picked at runtime by what the CPU
+ * supports, with a scalar fallback. The rest of the grammar is checked
+ * inline in the same single pass, UTF-8 included.
+ *
+ * Only the common case is handled: a UTF-8 encoded object or array nested
+ * at most maxDepth deep. Anything else (a top level number or string, very
+ * deep nesting, or not JSON at all) is rejected, and should be confirmed
+ * with JSON_checker, which remains the authority on what is JSON:
+ *
+ *     if (cb::json::isObjectOrArray(ptr, len) || checkUTF8JSON(ptr, len))
+ */
+namespace cb {
+namespace json {
+
+/// Max depth of nesting accepted
+const size_t maxDepth = 1024;
+
+enum class Implementation { Scalar, SSE2, AVX2 };
+
+MEMCACHED_PUBLIC_API
+const char* to_string(Implementation implementation);
+
+/// Is the given implementation supported by this build and CPU?
+MEMCACHED_PUBLIC_API
+bool isSupported(Implementation implementation);
+
+/// The (fastest supported) implementation used by isObjectOrArray()
+MEMCACHED_PUBLIC_API
+Implementation getImplementation();
+
+/**
+ * Check if the data is a JSON object or array (RFC 7159), encoded as
+ * UTF-8 and optionally surrounded by whitespace.
+ */
+MEMCACHED_PUBLIC_API
+bool isObjectOrArray(const uint8_t* data, size_t size);
+
+/**
+ * As isObjectOrArray() but using the given implementation.
+ *
+ * @throws std::invalid_argument if the implementation isn't supported
+ */
+MEMCACHED_PUBLIC_API
+bool isObjectOrArray(const uint8_t* data,
+                     size_t size,
+                     Implementation implementation);
+
+} // namespace json
+} // namespace cb
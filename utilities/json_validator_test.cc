@@ -0,0 +1,183 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2017 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for json_validator.cc, run against each implementation the
+ * CPU supports.
+ */
+
+#include "json_validator.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using cb::json::Implementation;
+
+class JsonValidatorTest : public ::testing::TestWithParam<Implementation> {
+protected:
+    bool check(const std::string& value) {
+        return cb::json::isObjectOrArray(
+                reinterpret_cast<const uint8_t*>(value.data()),
+                value.size(),
+                GetParam());
+    }
+};
+
+TEST_P(JsonValidatorTest, Containers) {
+    EXPECT_TRUE(check("{}"));
+    EXPECT_TRUE(check("[]"));
+    EXPECT_TRUE(check(" \t\r\n{ } \n"));
+    EXPECT_TRUE(check(R"({"a":1,"b":[true,false,null],"c":{"d":"e"}})"));
+    EXPECT_TRUE(check(R"([ 1 , [ ] , { } , "x" ])"));
+
+    EXPECT_FALSE(check(""));
+    EXPECT_FALSE(check("   "));
+    EXPECT_FALSE(check("{"));
+    EXPECT_FALSE(check("[1,]"));
+    EXPECT_FALSE(check("[,1]"));
+    EXPECT_FALSE(check(R"({"a":1,})"));
+    EXPECT_FALSE(check(R"({"a" 1})"));
+    EXPECT_FALSE(check(R"({1:1})"));
+    EXPECT_FALSE(check(R"({"a":1])"));
+    EXPECT_FALSE(check(R"([1}])"));
+    EXPECT_FALSE(check("{}{}"));
+    EXPECT_FALSE(check("[] x"));
+}
+
+TEST_P(JsonValidatorTest, TopLevelScalarsAreLeftToJsonChecker) {
+    EXPECT_FALSE(check("1"));
+    EXPECT_FALSE(check(R"("string")"));
+    EXPECT_FALSE(check("true"));
+    EXPECT_FALSE(check("null"));
+}
+
+TEST_P(JsonValidatorTest, Numbers) {
+    for (const auto* number :
+         {"0", "-0", "1", "-12", "1.5", "0.25", "1e5", "1E+5", "-1.5e-5"}) {
+        EXPECT_TRUE(check(std::string("[") + number + "]")) << number;
+    }
+    for (const auto* number :
+         {"01", "+1", "1.", ".5", "1e", "1e+", "-", "--1", "0x10", "1.5.5"}) {
+        EXPECT_FALSE(check(std::string("[") + number + "]")) << number;
+    }
+}
+
+TEST_P(JsonValidatorTest, Literals) {
+    EXPECT_TRUE(check("[true,false,null]"));
+    EXPECT_FALSE(check("[tru]"));
+    EXPECT_FALSE(check("[True]"));
+    EXPECT_FALSE(check("[nul"));
+    EXPECT_FALSE(check("[nulll]"));
+}
+
+TEST_P(JsonValidatorTest, Strings) {
+    EXPECT_TRUE(check(R"(["\"\\\/\b\f\n\r\té😀"])"));
+    EXPECT_FALSE(check(R"(["\x"])"));
+    EXPECT_FALSE(check(R"(["\u00g0"])"));
+    EXPECT_FALSE(check(R"(["\u00"])"));
+    EXPECT_FALSE(check(R"(["abc)"));
+    EXPECT_FALSE(check(R"(["abc\"])"));
+    EXPECT_FALSE(check(std::string("[\"a\tb\"]")));
+    EXPECT_FALSE(check(std::string("[\"a\0b\"]", 6)));
+}
+
+TEST_P(JsonValidatorTest, Utf8) {
+    // 2, 3 and 4 byte characters (and the highest code point)
+    EXPECT_TRUE(check("[\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"]"));
+    EXPECT_TRUE(check("[\"\xf4\x8f\xbf\xbf\"]"));
+
+    EXPECT_FALSE(check("[\"\xc3\"]")); // truncated
+    EXPECT_FALSE(check("[\"\xc3\x28\"]")); // bad continuation
+    EXPECT_FALSE(check("[\"\xc0\xaf\"]")); // overlong
+    EXPECT_FALSE(check("[\"\xe0\x80\xaf\"]")); // overlong
+    EXPECT_FALSE(check("[\"\xed\xa0\x80\"]")); // surrogate
+    EXPECT_FALSE(check("[\"\xf4\x90\x80\x80\"]")); // beyond U+10FFFF
+    EXPECT_FALSE(check("[\"\xff\"]"));
+    EXPECT_FALSE(check("[\"\x80\"]"));
+    // Non-ASCII is only valid within strings
+    EXPECT_FALSE(check("[\xc3\xa9]"));
+}
+
+TEST_P(JsonValidatorTest, LongStrings) {
+    // Put the interesting byte at every offset of the vector scans
+    for (size_t length = 0; length < 100; ++length) {
+        const std::string body(length, 'x');
+        EXPECT_TRUE(check("[\"" + body + "\"]")) << length;
+        EXPECT_TRUE(check("[\"" + body + "\\n" + body + "\"]")) << length;
+        EXPECT_TRUE(check("[\"" + body + "\xc3\xa9" + body + "\"]")) << length;
+        EXPECT_FALSE(check("[\"" + body + "\n" + body + "\"]")) << length;
+        EXPECT_FALSE(check("[\"" + body + "\xc3" + "\"]")) << length;
+        EXPECT_FALSE(check("[\"" + body)) << length;
+    }
+}
+
+TEST_P(JsonValidatorTest, Depth) {
+    const auto nest = [](size_t depth) {
+        std::string value;
+        for (size_t ii = 0; ii < depth; ++ii) {
+            value += (ii % 2) ? "{\"k\":" : "[";
+        }
+        value += "1";
+        for (size_t ii = depth; ii > 0; --ii) {
+            value += ((ii - 1) % 2) ? "}" : "]";
+        }
+        return value;
+    };
+    EXPECT_TRUE(check(nest(cb::json::maxDepth)));
+    EXPECT_FALSE(check(nest(cb::json::maxDepth + 1)));
+}
+
+TEST_P(JsonValidatorTest, DepthOfEmptyContainers) {
+    // The innermost container counts towards the depth even when empty
+    const auto nest = [](size_t depth, const std::string& innermost) {
+        return std::string(depth - 1, '[') + innermost +
+               std::string(depth - 1, ']');
+    };
+    EXPECT_TRUE(check(nest(cb::json::maxDepth, "[]")));
+    EXPECT_FALSE(check(nest(cb::json::maxDepth + 1, "[]")));
+    EXPECT_TRUE(check(nest(cb::json::maxDepth, "{}")));
+    EXPECT_FALSE(check(nest(cb::json::maxDepth + 1, "{}")));
+}
+
+static std::vector<Implementation> getSupportedImplementations() {
+    std::vector<Implementation> implementations;
+    for (auto implementation : {Implementation::Scalar,
+                                Implementation::SSE2,
+                                Implementation::AVX2}) {
+        if (cb::json::isSupported(implementation)) {
+            implementations.push_back(implementation);
+        }
+    }
+    return implementations;
+}
+
+INSTANTIATE_TEST_CASE_P(
+        Implementations,
+        JsonValidatorTest,
+        ::testing::ValuesIn(getSupportedImplementations()),
+        [](const ::testing::TestParamInfo<Implementation>& info) {
+            return std::string(cb::json::to_string(info.param));
+        });
+
+TEST(JsonValidatorImplementationTest, Selection) {
+    EXPECT_TRUE(cb::json::isSupported(Implementation::Scalar));
+    EXPECT_TRUE(cb::json::isSupported(cb::json::getImplementation()));
+    EXPECT_TRUE(cb::json::isObjectOrArray(
+            reinterpret_cast<const uint8_t*>("[1]"), 3));
+}